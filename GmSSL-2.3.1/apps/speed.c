@@ -122,6 +122,9 @@
 #ifndef OPENSSL_NO_SMS4
 # include <openssl/sms4.h>
 #endif
+#ifndef OPENSSL_NO_ZUC
+# include <openssl/zuc.h>
+#endif
 #include <openssl/modes.h>
 
 #ifndef HAVE_FORK
@@ -142,7 +145,7 @@
 #define BUFSIZE (1024*16+1)
 #define MAX_MISALIGNMENT 63
 
-#define ALGOR_NUM       32
+#define ALGOR_NUM       39
 #define SIZE_NUM        6
 #define PRIME_NUM       3
 #define RSA_NUM         7
@@ -187,10 +190,10 @@ typedef struct loopargs_st {
 #ifndef OPENSSL_NO_SM2
     EC_KEY *sm2[SM2_NUM];
     size_t cipherlen;
-# if 0
+    EC_KEY *sm2dh_key_a[SM2_NUM];
+    EC_KEY *sm2dh_key_b[SM2_NUM];
     unsigned char *sm2dh_a;
     unsigned char *sm2dh_b;
-# endif
 #endif
     EVP_CIPHER_CTX *ctx;
     HMAC_CTX *hctx;
@@ -280,7 +283,8 @@ static const char *names[ALGOR_NUM] = {
     "camellia-128 cbc", "camellia-192 cbc", "camellia-256 cbc",
     "evp", "sha256", "sha512", "whirlpool",
     "aes-128 ige", "aes-192 ige", "aes-256 ige", "ghash",
-    "sm3", "sms4 cbc"
+    "sm3", "sms4 cbc", "sms4 ctr", "sms4 gcm", "hmac(sm3)", "sm3 x8",
+    "zuc eea3", "zuc x8", "zuc eia3"
 };
 
 static double results[ALGOR_NUM][SIZE_NUM];
@@ -302,6 +306,7 @@ static double ecdh_results[EC_NUM][1];
 #ifndef OPENSSL_NO_SM2
 static double sm2sign_results[SM2_NUM][2];
 static double sm2enc_results[SM2_NUM][2];
+static double sm2dh_results[SM2_NUM][1];
 #endif
 
 #if !defined(OPENSSL_NO_DSA) || !defined(OPENSSL_NO_EC)
@@ -461,6 +466,13 @@ OPTIONS speed_options[] = {
 #define D_GHASH         29
 #define D_SM3           30
 #define D_CBC_SMS4      31
+#define D_CTR_SMS4      32
+#define D_GCM_SMS4      33
+#define D_HMAC_SM3      34
+#define D_SM3_MB        35
+#define D_ZUC           36
+#define D_ZUC_MB        37
+#define D_ZUC_EIA3      38
 static OPT_PAIR doit_choices[] = {
 #ifndef OPENSSL_NO_MD2
     {"md2", D_MD2},
@@ -532,10 +544,19 @@ static OPT_PAIR doit_choices[] = {
     {"ghash", D_GHASH},
 #ifndef OPENSSL_NO_SM3
     {"sm3", D_SM3},
+    {"sm3-hmac", D_HMAC_SM3},
+    {"sm3-mb", D_SM3_MB},
 #endif
 #ifndef OPENSSL_NO_SMS4
     {"sms4-cbc", D_CBC_SMS4},
     {"sms4", D_CBC_SMS4},
+    {"sms4-ctr", D_CTR_SMS4},
+    {"sms4-gcm", D_GCM_SMS4},
+#endif
+#ifndef OPENSSL_NO_ZUC
+    {"zuc", D_ZUC},
+    {"zuc-mb", D_ZUC_MB},
+    {"zuc-eia3", D_ZUC_EIA3},
 #endif
     {NULL}
 };
@@ -643,6 +664,11 @@ static OPT_PAIR sm2enc_choices[] = {
     {"sm2enc", R_SM2_P256},
     {NULL}
 };
+
+static OPT_PAIR sm2dh_choices[] = {
+    {"sm2dh", R_SM2_P256},
+    {NULL}
+};
 #endif
 
 #ifndef SIGALRM
@@ -1165,6 +1191,23 @@ static int SM2_decrypt_loop(void *args)
     }
     return count;
 }
+
+static long sm2dh_c[SM2_NUM][1];
+static int SM2DH_compute_key_loop(void *args)
+{
+    loopargs_t *tempargs = *(loopargs_t **)args;
+    EC_KEY **sm2dh_a = tempargs->sm2dh_key_a;
+    EC_KEY **sm2dh_b = tempargs->sm2dh_key_b;
+    unsigned char *secret_a = tempargs->sm2dh_a;
+    int count;
+
+    for (count = 0; COND(sm2dh_c[testnum][0]); count++) {
+        ECDH_compute_key(secret_a, 32,
+                EC_KEY_get0_public_key(sm2dh_b[testnum]),
+                sm2dh_a[testnum], NULL);
+    }
+    return count;
+}
 #endif
 
 #ifndef OPENSSL_NO_EC
@@ -1559,6 +1602,7 @@ int speed_main(int argc, char **argv)
     };
     int sm2sign_doit[SM2_NUM] = { 0 };
     int sm2enc_doit[SM2_NUM] = { 0 };
+    int sm2dh_doit[SM2_NUM] = { 0 };
 #endif
 
     prog = opt_init(argc, argv, speed_options);
@@ -1729,7 +1773,7 @@ int speed_main(int argc, char **argv)
 #ifndef OPENSSL_NO_SM2
         if (strcmp(*argv, "sm2") == 0) {
             for (i = 0; i < SM2_NUM; i++)
-                sm2sign_doit[i] = sm2enc_doit[i] = 1;
+                sm2sign_doit[i] = sm2enc_doit[i] = sm2dh_doit[i] = 1;
             continue;
         }
         if (strcmp(*argv, "sm2sign") == 0) {
@@ -1750,6 +1794,10 @@ int speed_main(int argc, char **argv)
             sm2enc_doit[i] = 2;
             continue;
         }
+        if (found(*argv, sm2dh_choices, &i)) {
+            sm2dh_doit[i] = 2;
+            continue;
+        }
 #endif
         BIO_printf(bio_err, "%s: Unknown algorithm %s\n", prog, *argv);
         goto end;
@@ -1787,10 +1835,8 @@ int speed_main(int argc, char **argv)
         loopargs[i].secret_b = app_malloc(MAX_ECDH_SIZE, "ECDH secret b");
 #endif
 #ifndef OPENSSL_NO_SM2
-/*
         loopargs[i].sm2dh_a = app_malloc(MAX_ECDH_SIZE, "SM2DH secret a");
         loopargs[i].sm2dh_b = app_malloc(MAX_ECDH_SIZE, "SM2DH secret b");
-*/
 #endif
     }
 
@@ -1826,6 +1872,8 @@ int speed_main(int argc, char **argv)
             sm2sign_doit[i] = 1;
         for (i = 0; i < SM2_NUM; i++)
             sm2enc_doit[i] = 1;
+        for (i = 0; i < SM2_NUM; i++)
+            sm2dh_doit[i] = 1;
 #endif
     }
     for (i = 0; i < ALGOR_NUM; i++)
@@ -1942,7 +1990,14 @@ int speed_main(int argc, char **argv)
     c[D_IGE_256_AES][0] = count;
     c[D_GHASH][0] = count;
     c[D_SM3][0] = count;
+    c[D_HMAC_SM3][0] = count;
+    c[D_SM3_MB][0] = count;
     c[D_CBC_SMS4][0] = count;
+    c[D_CTR_SMS4][0] = count;
+    c[D_GCM_SMS4][0] = count;
+    c[D_ZUC][0] = count;
+    c[D_ZUC_MB][0] = count;
+    c[D_ZUC_EIA3][0] = count;
 
     for (i = 1; i < SIZE_NUM; i++) {
         long l0, l1;
@@ -1962,6 +2017,8 @@ int speed_main(int argc, char **argv)
         c[D_WHIRLPOOL][i] = c[D_WHIRLPOOL][0] * 4 * l0 / l1;
         c[D_GHASH][i] = c[D_GHASH][0] * 4 * l0 / l1;
         c[D_SM3][i] = c[D_SM3][0] * 4 * l0 / l1;
+        c[D_HMAC_SM3][i] = c[D_HMAC_SM3][0] * 4 * l0 / l1;
+        c[D_SM3_MB][i] = c[D_SM3_MB][0] * 4 * l0 / l1;
 
         l0 = (long)lengths[i - 1];
 
@@ -1984,6 +2041,11 @@ int speed_main(int argc, char **argv)
         c[D_IGE_192_AES][i] = c[D_IGE_192_AES][i - 1] * l0 / l1;
         c[D_IGE_256_AES][i] = c[D_IGE_256_AES][i - 1] * l0 / l1;
         c[D_CBC_SMS4][i] = c[D_CBC_SMS4][i - 1] * l0 / l1;
+        c[D_CTR_SMS4][i] = c[D_CTR_SMS4][i - 1] * l0 / l1;
+        c[D_GCM_SMS4][i] = c[D_GCM_SMS4][i - 1] * l0 / l1;
+        c[D_ZUC][i] = c[D_ZUC][i - 1] * l0 / l1;
+        c[D_ZUC_MB][i] = c[D_ZUC_MB][i - 1] * l0 / l1;
+        c[D_ZUC_EIA3][i] = c[D_ZUC_EIA3][i - 1] * l0 / l1;
     }
 
 #  ifndef OPENSSL_NO_RSA
@@ -2025,6 +2087,7 @@ int speed_main(int argc, char **argv)
     sm2sign_c[R_SM2_P256][1] = count / 1000 / 8 / 2;
     sm2enc_c[R_SM2_P256][0] = count / 1000 / 8;
     sm2enc_c[R_SM2_P256][1] = count / 1000 / 8;
+    sm2dh_c[R_SM2_P256][0] = count / 1000 / 8;
 #  endif
 #  ifndef OPENSSL_NO_EC
     ecdsa_c[R_EC_P160][0] = count / 1000;
@@ -2196,6 +2259,58 @@ int speed_main(int argc, char **argv)
             print_result(D_SM3, testnum, count, d);
         }
     }
+    if (doit[D_HMAC_SM3]) {
+        sm3_hmac_key_t hkey;
+        sm3_hmac_ctx_t hctx;
+        unsigned char mac[SM3_HMAC_SIZE];
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_HMAC_SM3]);
+            doit[D_HMAC_SM3] = 0;
+        }
+        /* One key, a new MAC for every buffer like an SRTP tag */
+        sm3_hmac_set_key(&hkey, (unsigned char *)"This is a key...", 16);
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            print_message(names[D_HMAC_SM3], c[D_HMAC_SM3][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_HMAC_SM3][testnum]); count++) {
+                sm3_hmac_init_key(&hctx, &hkey);
+                sm3_hmac_update(&hctx, loopargs[0].buf, lengths[testnum]);
+                sm3_hmac_final(&hctx, mac);
+            }
+            d = Time_F(STOP);
+            print_result(D_HMAC_SM3, testnum, count, d);
+        }
+    }
+    if (doit[D_SM3_MB]) {
+        const unsigned char *mb_data[SM3_MB_LANES];
+        size_t mb_len[SM3_MB_LANES];
+        unsigned char mb_md[SM3_MB_LANES][SM3_DIGEST_LENGTH];
+        unsigned char *mb_out[SM3_MB_LANES];
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_SM3_MB]);
+            doit[D_SM3_MB] = 0;
+        }
+        for (i = 0; i < SM3_MB_LANES; i++) {
+            mb_data[i] = loopargs[0].buf;
+            mb_out[i] = mb_md[i];
+        }
+        /* count is in buffers, SM3_MB_LANES of them per call */
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            for (i = 0; i < SM3_MB_LANES; i++)
+                mb_len[i] = lengths[testnum];
+            print_message(names[D_SM3_MB], c[D_SM3_MB][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_SM3_MB][testnum]);
+                 count += SM3_MB_LANES)
+                sm3_mb(mb_data, mb_len, mb_out, SM3_MB_LANES);
+            d = Time_F(STOP);
+            print_result(D_SM3_MB, testnum, count, d);
+        }
+    }
 #endif
 #ifndef OPENSSL_NO_SHA
     if (doit[D_SHA1]) {
@@ -2477,6 +2592,140 @@ int speed_main(int argc, char **argv)
             print_result(D_CBC_SMS4, testnum, count, d);
         }
     }
+    if (doit[D_CTR_SMS4]) {
+        unsigned char ecount[SMS4_BLOCK_SIZE];
+        unsigned int num = 0;
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_CTR_SMS4]);
+            doit[D_CTR_SMS4] = 0;
+        }
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            print_message(names[D_CTR_SMS4], c[D_CTR_SMS4][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_CTR_SMS4][testnum]); count++)
+                sms4_ctr128_encrypt(loopargs[0].buf, loopargs[0].buf,
+                                    (size_t)lengths[testnum], &sms4_ks, iv,
+                                    ecount, &num);
+            d = Time_F(STOP);
+            print_result(D_CTR_SMS4, testnum, count, d);
+        }
+    }
+    if (doit[D_GCM_SMS4]) {
+        GCM128_CONTEXT *gcm_ctx;
+        unsigned char tag[16];
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_GCM_SMS4]);
+            doit[D_GCM_SMS4] = 0;
+        }
+        gcm_ctx = CRYPTO_gcm128_new(&sms4_ks, (block128_f)sms4_encrypt);
+        /* Every packet gets its own IV and tag, like a TLS record */
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            print_message(names[D_GCM_SMS4], c[D_GCM_SMS4][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_GCM_SMS4][testnum]); count++) {
+                CRYPTO_gcm128_setiv(gcm_ctx, (unsigned char *)"0123456789ab", 12);
+                CRYPTO_gcm128_encrypt_ctr32(gcm_ctx, loopargs[0].buf,
+                                            loopargs[0].buf,
+                                            (size_t)lengths[testnum],
+                                            (ctr128_f)sms4_ctr32_encrypt_blocks);
+                CRYPTO_gcm128_tag(gcm_ctx, tag, sizeof(tag));
+            }
+            d = Time_F(STOP);
+            print_result(D_GCM_SMS4, testnum, count, d);
+        }
+        CRYPTO_gcm128_release(gcm_ctx);
+    }
+#endif
+#ifndef OPENSSL_NO_ZUC
+    /* every packet gets its own COUNT and hence its own keystream */
+    if (doit[D_ZUC]) {
+        ZUC_128EEA3 eea3;
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_ZUC]);
+            doit[D_ZUC] = 0;
+        }
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            print_message(names[D_ZUC], c[D_ZUC][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_ZUC][testnum]); count++) {
+                ZUC_128eea3_set_key(&eea3, key16, (ZUC_UINT32)count, 0, 0);
+                ZUC_128eea3_encrypt(&eea3, (size_t)lengths[testnum],
+                                    loopargs[0].buf, loopargs[0].buf);
+            }
+            d = Time_F(STOP);
+            print_result(D_ZUC, testnum, count, d);
+        }
+    }
+    if (doit[D_ZUC_MB]) {
+        ZUC_KEY mb_ks[ZUC_MB_LANES];
+        ZUC_KEY *mb_key[ZUC_MB_LANES];
+        uint32_t *mb_words[ZUC_MB_LANES];
+        size_t mb_nwords[ZUC_MB_LANES];
+        unsigned char mb_iv[ZUC_IV_LENGTH] = {0};
+        uint32_t *mb_buf, *p;
+        size_t maxwords = lengths[SIZE_NUM - 1] / 4;
+        size_t j;
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_ZUC_MB]);
+            doit[D_ZUC_MB] = 0;
+        }
+        mb_buf = app_malloc(ZUC_MB_LANES * maxwords * sizeof(uint32_t),
+                            "zuc keystream");
+        for (i = 0; i < ZUC_MB_LANES; i++) {
+            mb_key[i] = &mb_ks[i];
+            mb_words[i] = mb_buf + i * maxwords;
+        }
+        /* count is in packets, ZUC_MB_LANES of them per call */
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            for (i = 0; i < ZUC_MB_LANES; i++)
+                mb_nwords[i] = lengths[testnum] / 4;
+            print_message(names[D_ZUC_MB], c[D_ZUC_MB][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_ZUC_MB][testnum]);
+                 count += ZUC_MB_LANES) {
+                for (i = 0; i < ZUC_MB_LANES; i++) {
+                    mb_iv[0] = (unsigned char)(count + i);
+                    ZUC_set_key(&mb_ks[i], key16, mb_iv);
+                }
+                ZUC_generate_keystream_mb(mb_key, mb_nwords, mb_words,
+                                          ZUC_MB_LANES);
+                for (i = 0; i < ZUC_MB_LANES; i++) {
+                    p = (uint32_t *)loopargs[0].buf;
+                    for (j = 0; j < mb_nwords[i]; j++)
+                        p[j] ^= mb_words[i][j];
+                }
+            }
+            d = Time_F(STOP);
+            print_result(D_ZUC_MB, testnum, count, d);
+        }
+        OPENSSL_free(mb_buf);
+    }
+    if (doit[D_ZUC_EIA3]) {
+        uint32_t mac;
+
+        if (async_jobs > 0) {
+            BIO_printf(bio_err, "Async mode is not supported with %s\n",
+                       names[D_ZUC_EIA3]);
+            doit[D_ZUC_EIA3] = 0;
+        }
+        for (testnum = 0; testnum < SIZE_NUM && async_init == 0; testnum++) {
+            print_message(names[D_ZUC_EIA3], c[D_ZUC_EIA3][testnum], lengths[testnum]);
+            Time_F(START);
+            for (count = 0, run = 1; COND(c[D_ZUC_EIA3][testnum]); count++)
+                ZUC_128eia3(key16, (ZUC_UINT32)count, 0, 0, loopargs[0].buf,
+                            (size_t)lengths[testnum], &mac);
+            d = Time_F(STOP);
+            print_result(D_ZUC_EIA3, testnum, count, d);
+        }
+    }
 #endif
 #ifndef OPENSSL_NO_RC2
     if (doit[D_CBC_RC2]) {
@@ -3111,6 +3360,73 @@ int speed_main(int argc, char **argv)
         }
     }
 
+    if (RAND_status() != 1) {
+        RAND_seed(rnd_seed, sizeof rnd_seed);
+    }
+    for (testnum = 0; testnum < SM2_NUM; testnum++) {
+        int st = 1;
+
+        if (!sm2dh_doit[testnum])
+            continue;
+        for (i = 0; i < loopargs_len; i++) {
+            loopargs[i].sm2dh_key_a[testnum] = EC_KEY_new_by_curve_name(
+                                                test_sm2_curves[testnum]);
+            loopargs[i].sm2dh_key_b[testnum] = EC_KEY_new_by_curve_name(
+                                                test_sm2_curves[testnum]);
+            if (loopargs[i].sm2dh_key_a[testnum] == NULL ||
+                loopargs[i].sm2dh_key_b[testnum] == NULL) {
+                st = 0;
+                break;
+            }
+        }
+        if (st == 0) {
+            BIO_printf(bio_err, "SM2DH failure.\n");
+            ERR_print_errors(bio_err);
+            rsa_count = 1;
+        } else {
+            for (i = 0; i < loopargs_len; i++) {
+                /* generate two key pairs and check the shared secrets */
+                if (!EC_KEY_generate_key(loopargs[i].sm2dh_key_a[testnum]) ||
+                    !EC_KEY_generate_key(loopargs[i].sm2dh_key_b[testnum]) ||
+                    ECDH_compute_key(loopargs[i].sm2dh_a, 32,
+                        EC_KEY_get0_public_key(loopargs[i].sm2dh_key_b[testnum]),
+                        loopargs[i].sm2dh_key_a[testnum], NULL) != 32 ||
+                    ECDH_compute_key(loopargs[i].sm2dh_b, 32,
+                        EC_KEY_get0_public_key(loopargs[i].sm2dh_key_a[testnum]),
+                        loopargs[i].sm2dh_key_b[testnum], NULL) != 32 ||
+                    memcmp(loopargs[i].sm2dh_a, loopargs[i].sm2dh_b, 32) != 0) {
+                    st = 0;
+                    break;
+                }
+            }
+            if (st == 0) {
+                BIO_printf(bio_err,
+                           "SM2DH computations don't match.  No SM2DH will be done.\n");
+                ERR_print_errors(bio_err);
+                rsa_count = 1;
+            } else {
+                pkey_print_message("", "sm2dh",
+                                   sm2dh_c[testnum][0],
+                                   test_sm2_curves_bits[testnum], ECDH_SECONDS);
+                Time_F(START);
+                count = run_benchmark(async_jobs, SM2DH_compute_key_loop, loopargs);
+                d = Time_F(STOP);
+                BIO_printf(bio_err,
+                           mr ? "+R9:%ld:%d:%.2f\n" :
+                           "%ld %d bit SM2DH ops in %.2fs\n",
+                           count, test_sm2_curves_bits[testnum], d);
+                sm2dh_results[testnum][0] = d / (double)count;
+                rsa_count = count;
+            }
+        }
+
+        if (rsa_count <= 1) {
+            /* if longer than 10s, don't do any more */
+            for (testnum++; testnum < SM2_NUM; testnum++)
+                sm2dh_doit[testnum] = 0;
+        }
+    }
+
 #endif /* OPENSSL_NO_SM2 */
 #ifndef NO_FORK
  show_res:
@@ -3296,6 +3612,26 @@ int speed_main(int argc, char **argv)
                    1.0 / sm2enc_results[k][0], 1.0 / sm2enc_results[k][1]);
     }
 
+    testnum = 1;
+    for (k = 0; k < SM2_NUM; k++) {
+        if (!sm2dh_doit[k])
+            continue;
+        if (testnum && !mr) {
+            printf("%30sop      op/s\n", " ");
+            testnum = 0;
+        }
+
+        if (mr)
+            printf("+F8:%u:%u:%f:%f\n",
+                   k, test_sm2_curves_bits[k],
+                   sm2dh_results[k][0], 1.0 / sm2dh_results[k][0]);
+        else
+            printf("%4u bit sm2dh (%s) %8.4fs %8.1f\n",
+                   test_sm2_curves_bits[k],
+                   test_sm2_curves_names[k],
+                   sm2dh_results[k][0], 1.0 / sm2dh_results[k][0]);
+    }
+
 #endif
 
     ret = 0;
@@ -3326,11 +3662,11 @@ int speed_main(int argc, char **argv)
 #ifndef OPENSSL_NO_SM2
         for (k = 0; k < SM2_NUM; k++) {
             EC_KEY_free(loopargs[i].sm2[k]);
+            EC_KEY_free(loopargs[i].sm2dh_key_a[k]);
+            EC_KEY_free(loopargs[i].sm2dh_key_b[k]);
         }
-# if 0
         OPENSSL_free(loopargs[i].sm2dh_a);
         OPENSSL_free(loopargs[i].sm2dh_b);
-# endif
 #endif
     }
 
@@ -3606,6 +3942,20 @@ static int do_multi(int multi)
                         1 / (1 / sm2enc_results[k][1] + 1 / d);
                 else
                     sm2enc_results[k][1] = d;
+            } else if (strncmp(buf, "+F8:", 4) == 0) {
+                int k;
+                double d;
+
+                p = buf + 4;
+                k = atoi(sstrsep(&p, sep));
+                sstrsep(&p, sep);
+
+                d = atof(sstrsep(&p, sep));
+                if (n)
+                    sm2dh_results[k][0] =
+                        1 / (1 / sm2dh_results[k][0] + 1 / d);
+                else
+                    sm2dh_results[k][0] = d;
             }
 # endif
             else if (strncmp(buf, "+H:", 3) == 0) {
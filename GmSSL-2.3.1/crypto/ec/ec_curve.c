@@ -3090,7 +3090,12 @@ static const ec_list_element curve_list[] = {
     {NID_brainpoolP512t1, &_EC_brainpoolP512t1.h, 0,
      "RFC 5639 curve over a 512 bit prime field"},
 #ifndef OPENSSL_NO_SM2
-    {NID_sm2p256v1, &_EC_SM2_PRIME_256V1.h, 0,
+    {NID_sm2p256v1, &_EC_SM2_PRIME_256V1.h,
+# if defined(ECP_SM2P256)
+     EC_GFp_sm2p256_method,
+# else
+     0,
+# endif
      "SM2 curve over a 256 bit prime field"},
     {NID_wapip192v1, &_EC_WAPI_PRIME_192V1.h, 0,
      "WAPI curve over a 192 bit prime field"},
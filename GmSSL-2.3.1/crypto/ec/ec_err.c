@@ -62,6 +62,12 @@ static ERR_STRING_DATA EC_str_functs[] = {
     {ERR_FUNC(EC_F_ECP_NISTZ256_POINTS_MUL), "ecp_nistz256_points_mul"},
     {ERR_FUNC(EC_F_ECP_NISTZ256_PRE_COMP_NEW), "ecp_nistz256_pre_comp_new"},
     {ERR_FUNC(EC_F_ECP_NISTZ256_WINDOWED_MUL), "ecp_nistz256_windowed_mul"},
+    {ERR_FUNC(EC_F_ECP_SM2P256_GET_AFFINE), "ecp_sm2p256_get_affine"},
+    {ERR_FUNC(EC_F_ECP_SM2P256_POINTS_MUL), "ecp_sm2p256_points_mul"},
+    {ERR_FUNC(EC_F_ECP_SM2P256_SCALAR_TO_WORDS),
+     "ecp_sm2p256_scalar_to_words"},
+    {ERR_FUNC(EC_F_ECP_SM2P256_WINDOWED_MUL), "ecp_sm2p256_windowed_mul"},
+    {ERR_FUNC(EC_F_ECP_SM2P256_WNAF_MUL), "ecp_sm2p256_wnaf_mul"},
     {ERR_FUNC(EC_F_ECX_KEY_OP), "ecx_key_op"},
     {ERR_FUNC(EC_F_ECX_PRIV_ENCODE), "ecx_priv_encode"},
     {ERR_FUNC(EC_F_ECX_PUB_ENCODE), "ecx_pub_encode"},
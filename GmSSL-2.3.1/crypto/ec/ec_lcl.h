@@ -549,6 +549,16 @@ int ec_group_simple_order_bits(const EC_GROUP *group);
 const EC_METHOD *EC_GFp_nistz256_method(void);
 #endif
 
+#if !defined(OPENSSL_NO_SM2) && BN_BITS2 == 64 && \
+    defined(__SIZEOF_INT128__) && __SIZEOF_INT128__ == 16
+# define ECP_SM2P256
+/** Returns GFp methods using montgomery multiplication, with 64-bit
+ * optimized SM2 P256.
+ *  \return  EC_METHOD object
+ */
+const EC_METHOD *EC_GFp_sm2p256_method(void);
+#endif
+
 size_t ec_key_simple_priv2oct(const EC_KEY *eckey,
                               unsigned char *buf, size_t len);
 int ec_key_simple_oct2priv(EC_KEY *eckey, const unsigned char *buf, size_t len);
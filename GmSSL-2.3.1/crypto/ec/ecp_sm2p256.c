@@ -0,0 +1,1608 @@
+/* ====================================================================
+ * Copyright (c) 2014 - 2018 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * EC_METHOD for the SM2 curve sm2p256v1. Field elements are four 64-bit
+ * limbs in the Montgomery domain with R = 2^256, which is the form the
+ * ec_GFp_mont functions keep the BIGNUM coordinates in, so points move
+ * between the two representations with plain word copies.
+ *
+ * The SM2 prime p = 2^256 - 2^224 - 2^96 + 2^64 - 1 has -p^-1 = 1 mod 2^64,
+ * so a Montgomery reduction step takes the low limb itself as multiplier
+ * and adds m*p as a handful of shifted additions instead of a 4x1 product.
+ *
+ * Multiplication of the generator uses a hard-coded comb table and runs in
+ * constant time, as does multiplication of a single variable point (ECDH,
+ * key exchange and decryption). Combined G and point multiplications only
+ * happen in signature verification, where the scalars are public, and use
+ * interleaved wNAF instead.
+ */
+
+#include <string.h>
+
+#include "internal/cryptlib.h"
+#include "internal/bn_int.h"
+#include "ec_lcl.h"
+
+#ifdef ECP_SM2P256
+
+# define TOBN(hi,lo)    ((BN_ULONG)hi<<32|lo)
+# define P256_LIMBS     4
+
+/* Window width of the wNAF used for verification */
+# define WNAF_WINDOW    5
+# define WNAF_TABLE     (1 << (WNAF_WINDOW - 2))
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    BN_ULONG X[P256_LIMBS];
+    BN_ULONG Y[P256_LIMBS];
+    BN_ULONG Z[P256_LIMBS];
+} P256_POINT;
+
+typedef struct {
+    BN_ULONG X[P256_LIMBS];
+    BN_ULONG Y[P256_LIMBS];
+} P256_POINT_AFFINE;
+
+static const BN_ULONG SM2_P[P256_LIMBS] = {
+    TOBN(0xffffffff, 0xffffffff), TOBN(0xffffffff, 0x00000000),
+    TOBN(0xffffffff, 0xffffffff), TOBN(0xfffffffe, 0xffffffff)
+};
+
+/* One converted into the Montgomery domain */
+static const BN_ULONG ONE[P256_LIMBS] = {
+    TOBN(0x00000000, 0x00000001), TOBN(0x00000000, 0xffffffff),
+    TOBN(0x00000000, 0x00000000), TOBN(0x00000001, 0x00000000)
+};
+
+static const BN_ULONG ZERO[P256_LIMBS] = { 0, 0, 0, 0 };
+
+/* Coordinates of G in the Montgomery domain */
+static const BN_ULONG def_xG[P256_LIMBS] = {
+    TOBN(0x61328990, 0xf418029e), TOBN(0x3e7981ed, 0xdca6c050),
+    TOBN(0xd6a1ed99, 0xac24c3c3), TOBN(0x91167a5e, 0xe1c13b05)
+};
+
+static const BN_ULONG def_yG[P256_LIMBS] = {
+    TOBN(0xc1354e59, 0x3c2d0ddd), TOBN(0xc1f5e578, 0x8d3295fa),
+    TOBN(0x8d4cfb06, 0x6e2a48f8), TOBN(0x63cd65d4, 0x81d735bd)
+};
+
+/*
+ * Comb table for G: ecp_sm2p256_precomputed[j][i] is the sum of
+ * 2^(64*j + 16*m) * G over the bits m set in i, in affine Montgomery form.
+ * Entry 0 is the point at infinity, encoded as (0,0).
+ */
+static const P256_POINT_AFFINE ecp_sm2p256_precomputed[4][16] = {
+    {
+        {{0, 0, 0, 0},
+         {0, 0, 0, 0}},
+        {{TOBN(0x61328990, 0xf418029e), TOBN(0x3e7981ed, 0xdca6c050),
+          TOBN(0xd6a1ed99, 0xac24c3c3), TOBN(0x91167a5e, 0xe1c13b05)},
+         {TOBN(0xc1354e59, 0x3c2d0ddd), TOBN(0xc1f5e578, 0x8d3295fa),
+          TOBN(0x8d4cfb06, 0x6e2a48f8), TOBN(0x63cd65d4, 0x81d735bd)}},
+        {{TOBN(0xec250455, 0x11c09289), TOBN(0x83042ba7, 0x164079c9),
+          TOBN(0x4881640c, 0x6e3879a2), TOBN(0x77c5babc, 0x802452ee)},
+         {TOBN(0x7a7759a6, 0x7088f360), TOBN(0x02da352c, 0xb74be7e9),
+          TOBN(0x15800cdb, 0xe0338289), TOBN(0xad69f7c9, 0x501688c6)}},
+        {{TOBN(0xfd27cdba, 0x0c8d9f2e), TOBN(0x90703c13, 0xa7c35396),
+          TOBN(0x03164cd4, 0x74b80e2d), TOBN(0x1e08bb9e, 0xbc637692)},
+         {TOBN(0x95bb415b, 0x4bc321ac), TOBN(0x4abfb785, 0xf460eb4c),
+          TOBN(0xe7017b28, 0x879fb7f0), TOBN(0x9c5df02e, 0x0a9a9cbf)}},
+        {{TOBN(0xecb8f92d, 0x0cf4efe5), TOBN(0x88c47214, 0x960e2d22),
+          TOBN(0xca9549ef, 0x6059f079), TOBN(0xd0a3774a, 0x7016da7c)},
+         {TOBN(0xd51c95f6, 0x1d001cab), TOBN(0x2d744def, 0xa3feeec1),
+          TOBN(0xb7c20cc2, 0x0afedf2b), TOBN(0xbf16c5f1, 0x71d144a5)}},
+        {{TOBN(0x6684ea0b, 0xad9c635e), TOBN(0x48a44a56, 0x85246e15),
+          TOBN(0x16926cc4, 0x56bb6373), TOBN(0xb9966ebd, 0x43efef8e)},
+         {TOBN(0xace57f14, 0x350e7f7d), TOBN(0x5c026c95, 0xa25bdfd6),
+          TOBN(0xf30be375, 0x9ed4a592), TOBN(0x74dde4e5, 0x51234a24)}},
+        {{TOBN(0xe593da16, 0xd72e101f), TOBN(0x3c2b6e78, 0x8f284213),
+          TOBN(0xafa34230, 0x0e9ffca8), TOBN(0x45610691, 0xe58916e2)},
+         {TOBN(0xb263feed, 0x5b2783ce), TOBN(0x6d5b1548, 0x24293af4),
+          TOBN(0x7b11f244, 0xeecded72), TOBN(0x1051db7f, 0xdc46c5d7)}},
+        {{TOBN(0xf53a65df, 0xec55b03c), TOBN(0x4f20d16c, 0x2f079ae6),
+          TOBN(0x11b1af9f, 0x0dfac6bd), TOBN(0x483f3e8c, 0xcd41d3d6)},
+         {TOBN(0x274da03e, 0xacf418e1), TOBN(0x7aeef409, 0xf931562a),
+          TOBN(0xc8d39d12, 0x75fe532d), TOBN(0xdb260cfb, 0xd7e12831)}},
+        {{TOBN(0x8487eb90, 0x68755cf3), TOBN(0x1887394e, 0x7fe12541),
+          TOBN(0x2e4c65d4, 0x46af8ca8), TOBN(0x72aae645, 0xb9e119dc)},
+         {TOBN(0x958e0094, 0x1ec6ad73), TOBN(0x84a7eec4, 0x8ce4573e),
+          TOBN(0x3d6d00d4, 0xf9254b96), TOBN(0x4ef44f58, 0x8e421732)}},
+        {{TOBN(0x491f2945, 0x1d8ef7ca), TOBN(0x377a2f82, 0xe142b376),
+          TOBN(0x310839f6, 0xcde70ec1), TOBN(0x6c13a74e, 0x26515def)},
+         {TOBN(0x6860fa20, 0x010a0b68), TOBN(0xc10f00b3, 0x945c7787),
+          TOBN(0xc566032c, 0xf3851d0e), TOBN(0x1ce939ee, 0x55385da7)}},
+        {{TOBN(0xa75e8d0d, 0xbc4de7dd), TOBN(0x9abb136b, 0xfbaede81),
+          TOBN(0x614c8c13, 0x3ab594c6), TOBN(0xe4f4b855, 0x0ed92f99)},
+         {TOBN(0x2e4f3e0f, 0x773bcb9e), TOBN(0x7fb391f5, 0x115ace73),
+          TOBN(0xb63a5b8b, 0x4c194fb9), TOBN(0x68ad2745, 0xe0adf6f0)}},
+        {{TOBN(0x9ca4f930, 0xc50ca0ba), TOBN(0x264ae2b4, 0xd1165cd7),
+          TOBN(0x249ab26e, 0xd995cf8d), TOBN(0x605fcb6e, 0xc8a5ba7b)},
+         {TOBN(0x346fcc49, 0x57d5ce55), TOBN(0x52d8d56e, 0x69aaf472),
+          TOBN(0xa5fec486, 0xe3f4f72e), TOBN(0xcb67f52f, 0x15a970c5)}},
+        {{TOBN(0x4896b318, 0x283648c9), TOBN(0x18a12f2b, 0x30a5e39c),
+          TOBN(0x318c09fa, 0x6464cf27), TOBN(0xdb0f8890, 0xcb5f75f6)},
+         {TOBN(0xe84b1399, 0x829f2c53), TOBN(0x399e0337, 0x42ba1832),
+          TOBN(0xa37ec6cd, 0x172347ff), TOBN(0xc3cffdad, 0x3adb16ea)}},
+        {{TOBN(0xd1adbe4f, 0xed6122cb), TOBN(0x42af7426, 0xd8c457dd),
+          TOBN(0x1e1ba7d3, 0xb640a676), TOBN(0x672653ec, 0xf734c0f3)},
+         {TOBN(0x9da2580b, 0xd1e607b0), TOBN(0x81fe854f, 0xe3b8cc88),
+          TOBN(0x15d34bec, 0x690e5faf), TOBN(0x3f747fc6, 0xccc064fa)}},
+        {{TOBN(0x46e6919a, 0x4c2aa70c), TOBN(0x4ea784a9, 0xb51e125a),
+          TOBN(0xd0cb2540, 0x23d889ac), TOBN(0x9a686a9b, 0x49b2478e)},
+         {TOBN(0x65bb4d3b, 0xcfdcd3cf), TOBN(0xdcef3264, 0x70618534),
+          TOBN(0xffe77f20, 0x3f18c6d4), TOBN(0x04d9ad53, 0xed83e560)}},
+        {{TOBN(0x76867687, 0x7672b822), TOBN(0xc80ecf5b, 0xf94113aa),
+          TOBN(0x99508b5c, 0x05a43423), TOBN(0xec5de433, 0x9103d86f)},
+         {TOBN(0x41a435f5, 0x59008efd), TOBN(0xd58b5336, 0x97bc53a9),
+          TOBN(0x35a5f5ac, 0x75367fe1), TOBN(0x0ccdf3d0, 0x6c51c3e1)}},
+    },
+    {
+        {{0, 0, 0, 0},
+         {0, 0, 0, 0}},
+        {{TOBN(0x4b33e020, 0xbad830d2), TOBN(0x5c101f9e, 0x590dffb3),
+          TOBN(0xcd0e0498, 0xbc80ecb0), TOBN(0x302787f8, 0x52aa293e)},
+         {TOBN(0xbfd64ced, 0x220f8fc8), TOBN(0xcf5cebe0, 0xbe0ee377),
+          TOBN(0xdc03a038, 0x8913b128), TOBN(0x4b096971, 0xfde23279)}},
+        {{TOBN(0x8348ca15, 0x587feffa), TOBN(0x585d0740, 0x7d69e4ad),
+          TOBN(0x6fbe5619, 0x885a0745), TOBN(0x04ee9eba, 0xb10b24dd)},
+         {TOBN(0x5c27075c, 0x0f4c12d7), TOBN(0xacf4acdc, 0x3c51c605),
+          TOBN(0x782fa52b, 0xfce336d0), TOBN(0x6e1d078f, 0x483621d2)}},
+        {{TOBN(0xacde2fe5, 0xc155ec54), TOBN(0x46fda9c7, 0x0fb30ef4),
+          TOBN(0x0a6d0bd9, 0xcf6b0f65), TOBN(0x02b824ef, 0x641c7902)},
+         {TOBN(0x66e4a877, 0x7fdaa0ee), TOBN(0x9028d782, 0x6921b3d2),
+          TOBN(0x0f1203a1, 0xc954247f), TOBN(0x1c289efb, 0x9fe2faae)}},
+        {{TOBN(0x4599b894, 0x1abd31f0), TOBN(0xdb34198d, 0x9a1da7d3),
+          TOBN(0xa8b89523, 0xa0f0217d), TOBN(0x2014cc43, 0xe56b884e)},
+         {TOBN(0x6fb94f88, 0x49efd4ee), TOBN(0xf1b81710, 0x287f4ae0),
+          TOBN(0x89d38a9a, 0x99fd2deb), TOBN(0x8179277a, 0x72b67a53)}},
+        {{TOBN(0x676c1049, 0x36aed763), TOBN(0x8c871299, 0xd4a079be),
+          TOBN(0xdfafad16, 0xda194f33), TOBN(0x2ab29161, 0xc5d4925c)},
+         {TOBN(0x2264761c, 0x1970c4f8), TOBN(0xc768d934, 0x8312b03a),
+          TOBN(0x187f2050, 0x5b580022), TOBN(0x16406b19, 0xd13363c0)}},
+        {{TOBN(0xe361bd10, 0xb8aa56e1), TOBN(0x4e862675, 0xd09e1284),
+          TOBN(0x506947ec, 0x76664924), TOBN(0xa5aa46a7, 0x242d10e0)},
+         {TOBN(0x984ed418, 0xd383bf3f), TOBN(0x6e0e1052, 0xfac49b17),
+          TOBN(0x317e3c6f, 0xc9325843), TOBN(0x1ec2045e, 0xc8d518f0)}},
+        {{TOBN(0x2dd20d6e, 0xec705299), TOBN(0xd24bd2cd, 0xba2087f9),
+          TOBN(0x7748292b, 0x9ba2132e), TOBN(0x2d628289, 0x387a328b)},
+         {TOBN(0xc9f7ae82, 0x24bf862d), TOBN(0x65b5341c, 0xd8734974),
+          TOBN(0xaed9017d, 0x06c34bca), TOBN(0x7c808417, 0xa7927b18)}},
+        {{TOBN(0x9ad2cbd7, 0xab6cf0b4), TOBN(0x7a1e67f4, 0xf13d1ddf),
+          TOBN(0xa58f0c73, 0x746003ba), TOBN(0x8263e888, 0xa64a8fcc)},
+         {TOBN(0x535cbe37, 0xbe2452f7), TOBN(0x93125766, 0x6ae81a76),
+          TOBN(0x7d2ed0ab, 0x3a553701), TOBN(0x93d7e7df, 0xb0717d78)}},
+        {{TOBN(0xceeb0908, 0x8532d8e4), TOBN(0xa786a322, 0x9e861243),
+          TOBN(0xfcff8dfd, 0x7856ae7b), TOBN(0xd1288482, 0x92650241)},
+         {TOBN(0x9e1eaeee, 0x88d52144), TOBN(0x99333c0c, 0x9e74255c),
+          TOBN(0x0f39f854, 0xc68ce78f), TOBN(0x71de2ac3, 0x721a407d)}},
+        {{TOBN(0x1c7a7a52, 0x2c3007f4), TOBN(0xb8c9fb45, 0x88c53460),
+          TOBN(0x39795d82, 0xd206f804), TOBN(0xa6df7cdc, 0x3efd252e)},
+         {TOBN(0x2820bf1d, 0xb00678b8), TOBN(0x8dfa8119, 0xc697c051),
+          TOBN(0x407f8d5b, 0xd1480ef2), TOBN(0x7000d329, 0x67eb5872)}},
+        {{TOBN(0x84e94204, 0x6c2d6356), TOBN(0x3deb1ed7, 0x5e9d2717),
+          TOBN(0xab83d12a, 0x10103c4c), TOBN(0xf9db26ac, 0xb361000a)},
+         {TOBN(0x3bf21eff, 0xb325bbbb), TOBN(0xa63a873e, 0x2895add2),
+          TOBN(0x45aa2e25, 0x78c3689d), TOBN(0xf5b5718a, 0x6c4bb0a5)}},
+        {{TOBN(0xf520b8cd, 0xc425677d), TOBN(0x85e7730b, 0x05908c5e),
+          TOBN(0xaea7a116, 0x98d721fb), TOBN(0x7cc0cb35, 0x21e9ae87)},
+         {TOBN(0x82c084c4, 0x7a99bd80), TOBN(0xbe86e083, 0x9ed4f686),
+          TOBN(0x7a9e0641, 0x90111e9b), TOBN(0x35e9f076, 0x385c4dc4)}},
+        {{TOBN(0x37327c48, 0x5e7203ee), TOBN(0x84c4f291, 0xff9938ac),
+          TOBN(0xd536f193, 0x6b0878ef), TOBN(0x8068645d, 0xee568599)},
+         {TOBN(0x5236f1a1, 0x707fccf2), TOBN(0xf3e0ea98, 0x36b6c21e),
+          TOBN(0x4c2a7b6d, 0x8d843bfe), TOBN(0x32c952ab, 0x5f7d3bae)}},
+        {{TOBN(0x341ea803, 0xc27c65f5), TOBN(0x6615740e, 0xb6be106b),
+          TOBN(0xd0fce6fd, 0x754e0dae), TOBN(0xe56a9e9e, 0x5ee36c26)},
+         {TOBN(0xf7ed662d, 0x79b452be), TOBN(0xd89df0c1, 0xb4e8c242),
+          TOBN(0xe69b649e, 0xddd21b87), TOBN(0x30dae2a5, 0xe6bf4207)}},
+        {{TOBN(0xf843a641, 0xf912b42c), TOBN(0xb041b82b, 0x4d00e4e4),
+          TOBN(0xd7e85841, 0xae140f67), TOBN(0xd6235d07, 0xa316e463)},
+         {TOBN(0xa61bf81e, 0xab169f8e), TOBN(0x0071b2cc, 0x35adc946),
+          TOBN(0x57d175d8, 0x205a1fe1), TOBN(0x6560d186, 0x7232b92c)}},
+    },
+    {
+        {{0, 0, 0, 0},
+         {0, 0, 0, 0}},
+        {{TOBN(0x7b9f561a, 0x8a914b50), TOBN(0x2bf7130e, 0x9154d377),
+          TOBN(0x6800f696, 0x519b4c35), TOBN(0xc9e65040, 0x568b4c56)},
+         {TOBN(0x30706e00, 0x6d98a331), TOBN(0x781a12f6, 0xe211ce1e),
+          TOBN(0x1fff9e3d, 0x40562e5f), TOBN(0x6356cf46, 0x8c166747)}},
+        {{TOBN(0xee031587, 0x9c34971b), TOBN(0x5829eb07, 0xe76545cf),
+          TOBN(0xb7a3a6ae, 0x33a81bb9), TOBN(0xff42daff, 0x49c9f710)},
+         {TOBN(0x894eae85, 0xbffb951b), TOBN(0x815fe3e2, 0xce70f324),
+          TOBN(0x636564cb, 0x428b1f12), TOBN(0x722e0050, 0xa029b0bd)}},
+        {{TOBN(0xebfacf72, 0x24e4263d), TOBN(0x2f0541a3, 0xf53ca04f),
+          TOBN(0xde064bf3, 0x2cef8f7b), TOBN(0xdf8efda9, 0xc91c9a6b)},
+         {TOBN(0x428c01cf, 0xa56983db), TOBN(0xce337b7e, 0x4165ac2b),
+          TOBN(0x92fa0f4d, 0x803ac0ae), TOBN(0x4883515f, 0x14023713)}},
+        {{TOBN(0x11cf4c2e, 0x24424a48), TOBN(0x843c73ee, 0x37d4471c),
+          TOBN(0xb3047fc5, 0x617a488b), TOBN(0xf2a91709, 0xe3cf861c)},
+         {TOBN(0x84444421, 0x1c3a60f7), TOBN(0x74787a36, 0x26679148),
+          TOBN(0x115fbd06, 0x53d9404b), TOBN(0x70fd3365, 0x6244cef0)}},
+        {{TOBN(0x015385c6, 0x47c08a1a), TOBN(0x928d3e73, 0xb0a4c2b7),
+          TOBN(0x95f60e9c, 0xa745f557), TOBN(0x6584670e, 0xa969f6ba)},
+         {TOBN(0xc0d92f36, 0x190948d2), TOBN(0x9d79c98d, 0xebbe384d),
+          TOBN(0x6bcc8320, 0x971fa585), TOBN(0x7793c296, 0x36f0ceaf)}},
+        {{TOBN(0xce4adc1d, 0xef113c10), TOBN(0xd3a8215b, 0x75dd4a9b),
+          TOBN(0x43ef1587, 0x5147366e), TOBN(0x819e7611, 0xfdfcb0cf)},
+         {TOBN(0x4b79abe0, 0x42b760bc), TOBN(0x9080306d, 0x6fa9e21f),
+          TOBN(0x98519907, 0xf1a78ffe), TOBN(0x87878021, 0x581e6ef2)}},
+        {{TOBN(0x47ef9468, 0xacb891c0), TOBN(0xfac9ea0d, 0x965e1401),
+          TOBN(0x02979214, 0x4090d70f), TOBN(0xd35b70ab, 0xd1e49430)},
+         {TOBN(0xeb5f0c52, 0x135a31e4), TOBN(0xffd5f1d3, 0xe4a61057),
+          TOBN(0x1d016fcd, 0x83104e55), TOBN(0xb36f9a35, 0x75c4857c)}},
+        {{TOBN(0xa06d20bc, 0x9ff262fb), TOBN(0xcba032fd, 0xd075868b),
+          TOBN(0x70376026, 0x943fd973), TOBN(0x81c57cba, 0xe35c5e02)},
+         {TOBN(0x1964e700, 0xba871f1b), TOBN(0xf03a8c04, 0x6b265f57),
+          TOBN(0xc8ebc912, 0x0b950259), TOBN(0xd2b0ee30, 0xad32ca8b)}},
+        {{TOBN(0x50cc879d, 0x94566bf1), TOBN(0xb2be42df, 0x1cec42fe),
+          TOBN(0x71e90430, 0xa08bb006), TOBN(0x80441b75, 0x773d13d2)},
+         {TOBN(0xd6bb386c, 0xa6672f42), TOBN(0xbc783b65, 0x61653462),
+          TOBN(0x7d4c4d8a, 0x7955c3fe), TOBN(0xe0b5ed6f, 0xdafde27e)}},
+        {{TOBN(0xf4d977e9, 0x28764051), TOBN(0x3ead26a0, 0xbbbbd6aa),
+          TOBN(0x0ef4088e, 0xe4acdcf2), TOBN(0x4353d5ac, 0xbf1a3e06)},
+         {TOBN(0x929663d3, 0x720de6c2), TOBN(0x69f434b0, 0x85b76a9b),
+          TOBN(0xe64540b2, 0xd70c46c6), TOBN(0x46fa0b9c, 0x52e97c12)}},
+        {{TOBN(0x2fdd7343, 0xf3f862b6), TOBN(0xe4b1e20b, 0x3473ffa9),
+          TOBN(0x6c829b68, 0x591ef108), TOBN(0x549dd987, 0x963fbb7e)},
+         {TOBN(0xdcba2a97, 0x41d0cdb4), TOBN(0x3d58ba5e, 0x2a66e256),
+          TOBN(0x8304b161, 0x5b750a59), TOBN(0x5742c9af, 0xa1f976b9)}},
+        {{TOBN(0xb29a337b, 0x09f20782), TOBN(0x1b6b9fed, 0x9279fdd9),
+          TOBN(0x4e4d209f, 0x0c55db4b), TOBN(0xb515d239, 0x675f1eac)},
+         {TOBN(0x85718273, 0x4328e859), TOBN(0x78448eaa, 0x049454d6),
+          TOBN(0x25f360b0, 0xbcaa19dd), TOBN(0xd5e6dcce, 0x61f4215d)}},
+        {{TOBN(0x65c2a1ce, 0x7e6db1ba), TOBN(0x02e40f54, 0xfc47c4c2),
+          TOBN(0x0af032e3, 0x4b4b48cf), TOBN(0x941de697, 0x7d4c0b99)},
+         {TOBN(0x21df74ca, 0xdd746630), TOBN(0xd5d0c909, 0xc2605a78),
+          TOBN(0x13207137, 0x5d376081), TOBN(0x743c5099, 0x35c83539)}},
+        {{TOBN(0xe259ded1, 0x74a43551), TOBN(0xb5162c13, 0x209b7780),
+          TOBN(0xd1c4b19c, 0xccff72e6), TOBN(0x46a41a6c, 0x1f4a6be8)},
+         {TOBN(0xafdccaac, 0x58eaace2), TOBN(0x9b0cd022, 0x14e7a776),
+          TOBN(0x56c15872, 0xbbd91951), TOBN(0x544f1515, 0x2e99446b)}},
+        {{TOBN(0x07038082, 0x9821dd49), TOBN(0xd00108ba, 0x3481b0cf),
+          TOBN(0x67eefb7d, 0x5d8aba3f), TOBN(0x1f7bff31, 0x3d509825)},
+         {TOBN(0x6f758cf6, 0x08e0f577), TOBN(0xbfe7fdc4, 0xaffa67c6),
+          TOBN(0xc14b0525, 0xb1edeb7a), TOBN(0xaa08646b, 0x8fbbbcd3)}},
+    },
+    {
+        {{0, 0, 0, 0},
+         {0, 0, 0, 0}},
+        {{TOBN(0xfb3992a4, 0x202bde39), TOBN(0x2549f564, 0x3d6bab98),
+          TOBN(0x0b564642, 0x87712512), TOBN(0xd52442b4, 0x7fde7e50)},
+         {TOBN(0xa6cefd08, 0xa3d3e16e), TOBN(0x5b194f0a, 0xc83b29bd),
+          TOBN(0x6db0edd8, 0x906dec8c), TOBN(0x7a090959, 0x02570c1e)}},
+        {{TOBN(0x22de9979, 0x17a86e18), TOBN(0xe2ac2321, 0xbe029111),
+          TOBN(0xbfd34397, 0x35cc5a17), TOBN(0x7a93461f, 0x525e13cf)},
+         {TOBN(0xd433542c, 0x5122d6f1), TOBN(0x41d2d9de, 0x833982c7),
+          TOBN(0xe9f1f29a, 0x8ec24d27), TOBN(0x4ae251f3, 0xf3b99d58)}},
+        {{TOBN(0x8ce88b5f, 0x98961eaf), TOBN(0xc0524006, 0x068bd809),
+          TOBN(0xe8a970e1, 0x96b13715), TOBN(0xf93a15cc, 0x5bef8230)},
+         {TOBN(0x72f68223, 0xbc06389f), TOBN(0x12da2506, 0x01c8c626),
+          TOBN(0x02875289, 0x5187e869), TOBN(0xa4b22c13, 0xc7fdd73a)}},
+        {{TOBN(0xe74e265b, 0xc25dfad3), TOBN(0xd03630b9, 0x493f44b6),
+          TOBN(0xb3270892, 0xbfd6d473), TOBN(0x5b2d9543, 0x1c5ee992)},
+         {TOBN(0xeeb94537, 0xa36f7c5f), TOBN(0x9befc01d, 0x8ab0b81d),
+          TOBN(0x483cdb08, 0x188b45e5), TOBN(0x44c753b7, 0x01e4648b)}},
+        {{TOBN(0xcc2f2cf4, 0xda638608), TOBN(0xb2144397, 0xe7b68ac0),
+          TOBN(0x7f18bf77, 0xdb95ff63), TOBN(0xd0bf3e2a, 0x39846917)},
+         {TOBN(0x4105e86e, 0xa7315aff), TOBN(0x65a0a552, 0x2f3bf9e5),
+          TOBN(0x3109f61c, 0x92351199), TOBN(0xf0119421, 0xc464d33a)}},
+        {{TOBN(0x8bbd92d6, 0x91c04f79), TOBN(0x746a809b, 0x0f4cc032),
+          TOBN(0xe9c3e30d, 0xc59150d7), TOBN(0xaa17cd8c, 0xbab66ba7)},
+         {TOBN(0x1930ae14, 0x329e400e), TOBN(0x1ff862d8, 0xed4f2036),
+          TOBN(0xe8ec4276, 0xe4597210), TOBN(0x08ac4681, 0xc4531d07)}},
+        {{TOBN(0xc3480151, 0x84a2c4eb), TOBN(0x51ea449b, 0xa0412b5d),
+          TOBN(0xf06b5aec, 0x7be60fc9), TOBN(0x86df7f7e, 0x579a496a)},
+         {TOBN(0x1b3f2056, 0x460f78ff), TOBN(0xb01e29f9, 0x83156091),
+          TOBN(0x4d1f71c4, 0xbb8c3d1f), TOBN(0xa0455c2a, 0x0a3108c3)}},
+        {{TOBN(0x6f154f09, 0xa9e0eeae), TOBN(0x2246e6fe, 0xab05a657),
+          TOBN(0x4d7c1c81, 0x1045b85d), TOBN(0xde99ea37, 0xd3bb7432)},
+         {TOBN(0x058f8187, 0x63184ff4), TOBN(0x2a223421, 0xd134bfc3),
+          TOBN(0x1560dbed, 0x23120320), TOBN(0x37243c95, 0x76a3de9c)}},
+        {{TOBN(0x0276da1c, 0x36407c91), TOBN(0xcf745782, 0x5fb44d85),
+          TOBN(0xc2740514, 0xf3f21df1), TOBN(0xfefa8bd5, 0x63da0a48)},
+         {TOBN(0x1ff576bf, 0x045d9b0f), TOBN(0xd17a0f0d, 0xc9b06f03),
+          TOBN(0x5be15a8c, 0xc21c1906), TOBN(0x6c461cd7, 0xcad012ad)}},
+        {{TOBN(0x52ac9fd0, 0x3ef41358), TOBN(0xa1908141, 0x24fd0c9c),
+          TOBN(0x03b1957f, 0x2091bdc6), TOBN(0x3b059c6e, 0x187bc928)},
+         {TOBN(0xc7438e53, 0xd17cf436), TOBN(0xe9c92a74, 0xa6b804e7),
+          TOBN(0x0c361fec, 0x8bf919d4), TOBN(0xd195f95c, 0x46de7ed7)}},
+        {{TOBN(0x220eec9c, 0x4ed4479c), TOBN(0x19fb465f, 0xf70af62d),
+          TOBN(0x63d9e37e, 0xc0afc97a), TOBN(0x5414b6bb, 0x6be89ace)},
+         {TOBN(0x086add7a, 0x367180f9), TOBN(0x7d41481f, 0x2937273d),
+          TOBN(0x3f2398ae, 0xc6707883), TOBN(0x167861f5, 0xff36766e)}},
+        {{TOBN(0xfcb90a81, 0xee79465e), TOBN(0x83c8aaf8, 0x613b4234),
+          TOBN(0xd3e0802d, 0x8890d3f5), TOBN(0xa525ffbe, 0x87a2d0a5)},
+         {TOBN(0x409c0a39, 0x9a7ca008), TOBN(0xd2cba741, 0x912c5cc2),
+          TOBN(0x3b9d7fd4, 0x8869b0cd), TOBN(0x2ce3376d, 0xbd430291)}},
+        {{TOBN(0x5397730d, 0xd47fd6c0), TOBN(0xa50f0a59, 0x441f3726),
+          TOBN(0xb61fd0b4, 0xf8de7344), TOBN(0x82134985, 0xf52d5dc4)},
+         {TOBN(0xa85f9e60, 0x96cb2186), TOBN(0x7492518b, 0x310cd449),
+          TOBN(0x900fa232, 0x3b0dd00d), TOBN(0xeed9e2c9, 0xcfc25512)}},
+        {{TOBN(0x31b0d8e1, 0x30da523d), TOBN(0x8604aa9f, 0x781f9df5),
+          TOBN(0xe760a838, 0xe5cc3ea8), TOBN(0x680ac250, 0x4dc36c8f)},
+         {TOBN(0x3669d42f, 0x06a8c1b2), TOBN(0xb65ade98, 0x63f1ec6a),
+          TOBN(0x765390aa, 0xef554387), TOBN(0x0912aef2, 0x857e401c)}},
+        {{TOBN(0x0b0689dc, 0x10dd3de8), TOBN(0x43248fb4, 0x3381cfdb),
+          TOBN(0x2839e549, 0xe6cddd16), TOBN(0x4b5e49b3, 0x1c95ecc7)},
+         {TOBN(0x3a7d963c, 0x643e4588), TOBN(0x9634b5bc, 0x370db3e6),
+          TOBN(0x18f763e5, 0x35af7c50), TOBN(0xc2ef2639, 0xe9eee14f)}},
+    },
+};
+
+static void copy_conditional(BN_ULONG dst[P256_LIMBS],
+                             const BN_ULONG src[P256_LIMBS], BN_ULONG move)
+{
+    BN_ULONG mask1 = 0-move;
+    BN_ULONG mask2 = ~mask1;
+
+    dst[0] = (src[0] & mask1) ^ (dst[0] & mask2);
+    dst[1] = (src[1] & mask1) ^ (dst[1] & mask2);
+    dst[2] = (src[2] & mask1) ^ (dst[2] & mask2);
+    dst[3] = (src[3] & mask1) ^ (dst[3] & mask2);
+}
+
+static BN_ULONG is_zero(BN_ULONG in)
+{
+    in |= (0 - in);
+    in = ~in;
+    in >>= BN_BITS2 - 1;
+    return in;
+}
+
+static BN_ULONG is_equal(const BN_ULONG a[P256_LIMBS],
+                         const BN_ULONG b[P256_LIMBS])
+{
+    BN_ULONG res;
+
+    res = a[0] ^ b[0];
+    res |= a[1] ^ b[1];
+    res |= a[2] ^ b[2];
+    res |= a[3] ^ b[3];
+
+    return is_zero(res);
+}
+
+static BN_ULONG is_one(const BIGNUM *z)
+{
+    BN_ULONG res = 0;
+    BN_ULONG *a = bn_get_words(z);
+
+    if (bn_get_top(z) == P256_LIMBS) {
+        res = a[0] ^ ONE[0];
+        res |= a[1] ^ ONE[1];
+        res |= a[2] ^ ONE[2];
+        res |= a[3] ^ ONE[3];
+        res = is_zero(res);
+    }
+
+    return res;
+}
+
+/* r = (carry:a) - p if that is not negative, otherwise r = a */
+static void ecp_sm2p256_reduce_once(BN_ULONG r[P256_LIMBS],
+                                    const BN_ULONG a[P256_LIMBS],
+                                    BN_ULONG carry)
+{
+    BN_ULONG t[P256_LIMBS], borrow = 0, mask;
+    u128 acc;
+    int i;
+
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc = (u128)a[i] - SM2_P[i] - borrow;
+        t[i] = (BN_ULONG)acc;
+        borrow = (BN_ULONG)(acc >> 127);
+    }
+
+    mask = 0 - (carry | (borrow ^ 1));
+    for (i = 0; i < P256_LIMBS; i++)
+        r[i] = (t[i] & mask) | (a[i] & ~mask);
+}
+
+/* r = a + b mod p */
+static void ecp_sm2p256_add(BN_ULONG r[P256_LIMBS],
+                            const BN_ULONG a[P256_LIMBS],
+                            const BN_ULONG b[P256_LIMBS])
+{
+    BN_ULONG t[P256_LIMBS];
+    u128 acc = 0;
+    int i;
+
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc += (u128)a[i] + b[i];
+        t[i] = (BN_ULONG)acc;
+        acc >>= 64;
+    }
+    ecp_sm2p256_reduce_once(r, t, (BN_ULONG)acc);
+}
+
+/* r = a - b mod p */
+static void ecp_sm2p256_sub(BN_ULONG r[P256_LIMBS],
+                            const BN_ULONG a[P256_LIMBS],
+                            const BN_ULONG b[P256_LIMBS])
+{
+    BN_ULONG t[P256_LIMBS], borrow = 0, mask;
+    u128 acc;
+    int i;
+
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc = (u128)a[i] - b[i] - borrow;
+        t[i] = (BN_ULONG)acc;
+        borrow = (BN_ULONG)(acc >> 127);
+    }
+
+    /* add p back if the difference went negative */
+    mask = 0 - borrow;
+    acc = 0;
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc += (u128)t[i] + (SM2_P[i] & mask);
+        r[i] = (BN_ULONG)acc;
+        acc >>= 64;
+    }
+}
+
+static void ecp_sm2p256_neg(BN_ULONG r[P256_LIMBS],
+                            const BN_ULONG a[P256_LIMBS])
+{
+    ecp_sm2p256_sub(r, ZERO, a);
+}
+
+static void ecp_sm2p256_mul_by_2(BN_ULONG r[P256_LIMBS],
+                                 const BN_ULONG a[P256_LIMBS])
+{
+    ecp_sm2p256_add(r, a, a);
+}
+
+static void ecp_sm2p256_mul_by_3(BN_ULONG r[P256_LIMBS],
+                                 const BN_ULONG a[P256_LIMBS])
+{
+    BN_ULONG t[P256_LIMBS];
+
+    ecp_sm2p256_add(t, a, a);
+    ecp_sm2p256_add(r, t, a);
+}
+
+/* r = a / 2 mod p */
+static void ecp_sm2p256_div_by_2(BN_ULONG r[P256_LIMBS],
+                                 const BN_ULONG a[P256_LIMBS])
+{
+    BN_ULONG t[P256_LIMBS], mask = 0 - (a[0] & 1), top;
+    u128 acc = 0;
+    int i;
+
+    /* make a even by adding p if it is odd */
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc += (u128)a[i] + (SM2_P[i] & mask);
+        t[i] = (BN_ULONG)acc;
+        acc >>= 64;
+    }
+    top = (BN_ULONG)acc;
+
+    r[0] = (t[0] >> 1) | (t[1] << 63);
+    r[1] = (t[1] >> 1) | (t[2] << 63);
+    r[2] = (t[2] >> 1) | (t[3] << 63);
+    r[3] = (t[3] >> 1) | (top << 63);
+}
+
+/*
+ * One Montgomery reduction step: (t0..t4) = ((t0..t5) + m*p) / 2^64 with
+ * m = t0, as -p^-1 = 1 mod 2^64. Shifted down by one limb, m*p is
+ * m + m*2^192 - m*2^32 - m*2^160, which is added as a single 256-bit d.
+ */
+#define SM2P256_REDUCE_STEP(t0, t1, t2, t3, t4, t5) do { \
+        BN_ULONG m_ = t0, lo_ = m_ << 32, hi_ = m_ >> 32; \
+        BN_ULONG d0_, d1_, d2_, d3_; \
+        u128 acc_; \
+        acc_ = (u128)m_ - lo_; \
+        d0_ = (BN_ULONG)acc_; \
+        acc_ = (u128)0 - hi_ - (BN_ULONG)(acc_ >> 127); \
+        d1_ = (BN_ULONG)acc_; \
+        acc_ = (u128)0 - lo_ - (BN_ULONG)(acc_ >> 127); \
+        d2_ = (BN_ULONG)acc_; \
+        d3_ = m_ - hi_ - (BN_ULONG)(acc_ >> 127); \
+        acc_ = (u128)t1 + d0_; \
+        t0 = (BN_ULONG)acc_; \
+        acc_ = (u128)t2 + d1_ + (acc_ >> 64); \
+        t1 = (BN_ULONG)acc_; \
+        acc_ = (u128)t3 + d2_ + (acc_ >> 64); \
+        t2 = (BN_ULONG)acc_; \
+        acc_ = (u128)t4 + d3_ + (acc_ >> 64); \
+        t3 = (BN_ULONG)acc_; \
+        t4 = t5 + (BN_ULONG)(acc_ >> 64); \
+    } while (0)
+
+/* r = a * b * 2^-256 mod p, reducing after each row of the product */
+static void ecp_sm2p256_mul_mont(BN_ULONG r[P256_LIMBS],
+                                 const BN_ULONG a[P256_LIMBS],
+                                 const BN_ULONG b[P256_LIMBS])
+{
+    BN_ULONG t0 = 0, t1 = 0, t2 = 0, t3 = 0, t4 = 0, t5, res[P256_LIMBS];
+    u128 acc;
+    int i;
+
+    for (i = 0; i < P256_LIMBS; i++) {
+        acc = (u128)a[i] * b[0] + t0;
+        t0 = (BN_ULONG)acc;
+        acc = (u128)a[i] * b[1] + t1 + (acc >> 64);
+        t1 = (BN_ULONG)acc;
+        acc = (u128)a[i] * b[2] + t2 + (acc >> 64);
+        t2 = (BN_ULONG)acc;
+        acc = (u128)a[i] * b[3] + t3 + (acc >> 64);
+        t3 = (BN_ULONG)acc;
+        acc = (u128)t4 + (acc >> 64);
+        t4 = (BN_ULONG)acc;
+        t5 = (BN_ULONG)(acc >> 64);
+
+        SM2P256_REDUCE_STEP(t0, t1, t2, t3, t4, t5);
+    }
+
+    res[0] = t0;
+    res[1] = t1;
+    res[2] = t2;
+    res[3] = t3;
+    ecp_sm2p256_reduce_once(r, res, t4);
+}
+
+/* r = a^2 * 2^-256 mod p */
+static void ecp_sm2p256_sqr_mont(BN_ULONG r[P256_LIMBS],
+                                 const BN_ULONG a[P256_LIMBS])
+{
+    BN_ULONG t0, t1, t2, t3, t4, t5, t6, t7, c = 0, z = 0;
+    BN_ULONG res[P256_LIMBS];
+    u128 acc;
+
+    /* cross products a[i]*a[j], i < j */
+    acc = (u128)a[0] * a[1];
+    t1 = (BN_ULONG)acc;
+    acc = (u128)a[0] * a[2] + (acc >> 64);
+    t2 = (BN_ULONG)acc;
+    acc = (u128)a[0] * a[3] + (acc >> 64);
+    t3 = (BN_ULONG)acc;
+    t4 = (BN_ULONG)(acc >> 64);
+    acc = (u128)a[1] * a[2] + t3;
+    t3 = (BN_ULONG)acc;
+    acc = (u128)a[1] * a[3] + t4 + (acc >> 64);
+    t4 = (BN_ULONG)acc;
+    t5 = (BN_ULONG)(acc >> 64);
+    acc = (u128)a[2] * a[3] + t5;
+    t5 = (BN_ULONG)acc;
+    t6 = (BN_ULONG)(acc >> 64);
+
+    /* double them */
+    t7 = t6 >> 63;
+    t6 = (t6 << 1) | (t5 >> 63);
+    t5 = (t5 << 1) | (t4 >> 63);
+    t4 = (t4 << 1) | (t3 >> 63);
+    t3 = (t3 << 1) | (t2 >> 63);
+    t2 = (t2 << 1) | (t1 >> 63);
+    t1 <<= 1;
+
+    /* and add the squares */
+    acc = (u128)a[0] * a[0];
+    t0 = (BN_ULONG)acc;
+    acc = (u128)t1 + (acc >> 64);
+    t1 = (BN_ULONG)acc;
+    acc = (u128)a[1] * a[1] + t2 + (acc >> 64);
+    t2 = (BN_ULONG)acc;
+    acc = (u128)t3 + (acc >> 64);
+    t3 = (BN_ULONG)acc;
+    acc = (u128)a[2] * a[2] + t4 + (acc >> 64);
+    t4 = (BN_ULONG)acc;
+    acc = (u128)t5 + (acc >> 64);
+    t5 = (BN_ULONG)acc;
+    acc = (u128)a[3] * a[3] + t6 + (acc >> 64);
+    t6 = (BN_ULONG)acc;
+    t7 += (BN_ULONG)(acc >> 64);
+
+    /*
+     * Reduce the low half to at most p, then add the high half, which is
+     * below p as the product is below p^2.
+     */
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+
+    acc = (u128)t0 + t4;
+    res[0] = (BN_ULONG)acc;
+    acc = (u128)t1 + t5 + (acc >> 64);
+    res[1] = (BN_ULONG)acc;
+    acc = (u128)t2 + t6 + (acc >> 64);
+    res[2] = (BN_ULONG)acc;
+    acc = (u128)t3 + t7 + (acc >> 64);
+    res[3] = (BN_ULONG)acc;
+    ecp_sm2p256_reduce_once(r, res, c + (BN_ULONG)(acc >> 64));
+}
+
+static void ecp_sm2p256_sqr_mont_n(BN_ULONG r[P256_LIMBS],
+                                   const BN_ULONG a[P256_LIMBS], int n)
+{
+    ecp_sm2p256_sqr_mont(r, a);
+    while (--n > 0)
+        ecp_sm2p256_sqr_mont(r, r);
+}
+
+/* r = a * 2^-256 mod p, i.e. out of the Montgomery domain */
+static void ecp_sm2p256_from_mont(BN_ULONG r[P256_LIMBS],
+                                  const BN_ULONG a[P256_LIMBS])
+{
+    BN_ULONG t0 = a[0], t1 = a[1], t2 = a[2], t3 = a[3], c = 0, z = 0;
+    BN_ULONG res[P256_LIMBS];
+
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+    SM2P256_REDUCE_STEP(t0, t1, t2, t3, c, z);
+
+    res[0] = t0;
+    res[1] = t1;
+    res[2] = t2;
+    res[3] = t3;
+    ecp_sm2p256_reduce_once(r, res, c);
+}
+
+/* r = in^-1 mod p, as in^(p-2) */
+static void ecp_sm2p256_mod_inverse(BN_ULONG r[P256_LIMBS],
+                                    const BN_ULONG in[P256_LIMBS])
+{
+    /*
+     * p-2 = fffffffe ffffffff ... fffffffd is, from the top, 31 ones, a
+     * zero, 128 ones, 32 zeros, 62 ones, a zero and a one. xN below is
+     * in^(2^N - 1).
+     */
+    BN_ULONG x2[P256_LIMBS], x3[P256_LIMBS], x6[P256_LIMBS];
+    BN_ULONG x12[P256_LIMBS], x15[P256_LIMBS], x30[P256_LIMBS];
+    BN_ULONG x31[P256_LIMBS], x32[P256_LIMBS], t[P256_LIMBS];
+    int i;
+
+    ecp_sm2p256_sqr_mont(x2, in);
+    ecp_sm2p256_mul_mont(x2, x2, in);
+    ecp_sm2p256_sqr_mont(x3, x2);
+    ecp_sm2p256_mul_mont(x3, x3, in);
+    ecp_sm2p256_sqr_mont_n(x6, x3, 3);
+    ecp_sm2p256_mul_mont(x6, x6, x3);
+    ecp_sm2p256_sqr_mont_n(x12, x6, 6);
+    ecp_sm2p256_mul_mont(x12, x12, x6);
+    ecp_sm2p256_sqr_mont_n(x15, x12, 3);
+    ecp_sm2p256_mul_mont(x15, x15, x3);
+    ecp_sm2p256_sqr_mont_n(x30, x15, 15);
+    ecp_sm2p256_mul_mont(x30, x30, x15);
+    ecp_sm2p256_sqr_mont(x31, x30);
+    ecp_sm2p256_mul_mont(x31, x31, in);
+    ecp_sm2p256_sqr_mont(x32, x31);
+    ecp_sm2p256_mul_mont(x32, x32, in);
+
+    ecp_sm2p256_sqr_mont(t, x31);
+    for (i = 0; i < 4; i++) {
+        ecp_sm2p256_sqr_mont_n(t, t, 32);
+        ecp_sm2p256_mul_mont(t, t, x32);
+    }
+    ecp_sm2p256_sqr_mont_n(t, t, 32);
+    ecp_sm2p256_sqr_mont_n(t, t, 32);
+    ecp_sm2p256_mul_mont(t, t, x32);
+    ecp_sm2p256_sqr_mont_n(t, t, 30);
+    ecp_sm2p256_mul_mont(t, t, x30);
+    ecp_sm2p256_sqr_mont_n(t, t, 2);
+    ecp_sm2p256_mul_mont(r, t, in);
+}
+
+/* Point double: r = 2*a */
+static void ecp_sm2p256_point_double(P256_POINT *r, const P256_POINT *a)
+{
+    BN_ULONG S[P256_LIMBS];
+    BN_ULONG M[P256_LIMBS];
+    BN_ULONG Zsqr[P256_LIMBS];
+    BN_ULONG tmp0[P256_LIMBS];
+
+    const BN_ULONG *in_x = a->X;
+    const BN_ULONG *in_y = a->Y;
+    const BN_ULONG *in_z = a->Z;
+
+    BN_ULONG *res_x = r->X;
+    BN_ULONG *res_y = r->Y;
+    BN_ULONG *res_z = r->Z;
+
+    ecp_sm2p256_mul_by_2(S, in_y);
+
+    ecp_sm2p256_sqr_mont(Zsqr, in_z);
+
+    ecp_sm2p256_sqr_mont(S, S);
+
+    ecp_sm2p256_mul_mont(res_z, in_z, in_y);
+    ecp_sm2p256_mul_by_2(res_z, res_z);
+
+    ecp_sm2p256_add(M, in_x, Zsqr);
+    ecp_sm2p256_sub(Zsqr, in_x, Zsqr);
+
+    ecp_sm2p256_sqr_mont(res_y, S);
+    ecp_sm2p256_div_by_2(res_y, res_y);
+
+    ecp_sm2p256_mul_mont(M, M, Zsqr);
+    ecp_sm2p256_mul_by_3(M, M);
+
+    ecp_sm2p256_mul_mont(S, S, in_x);
+    ecp_sm2p256_mul_by_2(tmp0, S);
+
+    ecp_sm2p256_sqr_mont(res_x, M);
+
+    ecp_sm2p256_sub(res_x, res_x, tmp0);
+    ecp_sm2p256_sub(S, S, res_x);
+
+    ecp_sm2p256_mul_mont(S, S, M);
+    ecp_sm2p256_sub(res_y, S, res_y);
+}
+
+/* Point addition: r = a+b */
+static void ecp_sm2p256_point_add(P256_POINT *r,
+                                  const P256_POINT *a, const P256_POINT *b)
+{
+    BN_ULONG U2[P256_LIMBS], S2[P256_LIMBS];
+    BN_ULONG U1[P256_LIMBS], S1[P256_LIMBS];
+    BN_ULONG Z1sqr[P256_LIMBS];
+    BN_ULONG Z2sqr[P256_LIMBS];
+    BN_ULONG H[P256_LIMBS], R[P256_LIMBS];
+    BN_ULONG Hsqr[P256_LIMBS];
+    BN_ULONG Rsqr[P256_LIMBS];
+    BN_ULONG Hcub[P256_LIMBS];
+
+    BN_ULONG res_x[P256_LIMBS];
+    BN_ULONG res_y[P256_LIMBS];
+    BN_ULONG res_z[P256_LIMBS];
+
+    BN_ULONG in1infty, in2infty;
+
+    const BN_ULONG *in1_x = a->X;
+    const BN_ULONG *in1_y = a->Y;
+    const BN_ULONG *in1_z = a->Z;
+
+    const BN_ULONG *in2_x = b->X;
+    const BN_ULONG *in2_y = b->Y;
+    const BN_ULONG *in2_z = b->Z;
+
+    /*
+     * Infinity in encoded as (,,0)
+     */
+    in1infty = is_zero(in1_z[0] | in1_z[1] | in1_z[2] | in1_z[3]);
+    in2infty = is_zero(in2_z[0] | in2_z[1] | in2_z[2] | in2_z[3]);
+
+    ecp_sm2p256_sqr_mont(Z2sqr, in2_z);         /* Z2^2 */
+    ecp_sm2p256_sqr_mont(Z1sqr, in1_z);         /* Z1^2 */
+
+    ecp_sm2p256_mul_mont(S1, Z2sqr, in2_z);     /* S1 = Z2^3 */
+    ecp_sm2p256_mul_mont(S2, Z1sqr, in1_z);     /* S2 = Z1^3 */
+
+    ecp_sm2p256_mul_mont(S1, S1, in1_y);        /* S1 = Y1*Z2^3 */
+    ecp_sm2p256_mul_mont(S2, S2, in2_y);        /* S2 = Y2*Z1^3 */
+    ecp_sm2p256_sub(R, S2, S1);                 /* R = S2 - S1 */
+
+    ecp_sm2p256_mul_mont(U1, in1_x, Z2sqr);     /* U1 = X1*Z2^2 */
+    ecp_sm2p256_mul_mont(U2, in2_x, Z1sqr);     /* U2 = X2*Z1^2 */
+    ecp_sm2p256_sub(H, U2, U1);                 /* H = U2 - U1 */
+
+    /*
+     * This should not happen during sign/ecdh, so no constant time violation
+     */
+    if (is_equal(U1, U2) && !in1infty && !in2infty) {
+        if (is_equal(S1, S2)) {
+            ecp_sm2p256_point_double(r, a);
+            return;
+        } else {
+            memset(r, 0, sizeof(*r));
+            return;
+        }
+    }
+
+    ecp_sm2p256_sqr_mont(Rsqr, R);              /* R^2 */
+    ecp_sm2p256_mul_mont(res_z, H, in1_z);      /* Z3 = H*Z1*Z2 */
+    ecp_sm2p256_sqr_mont(Hsqr, H);              /* H^2 */
+    ecp_sm2p256_mul_mont(res_z, res_z, in2_z);  /* Z3 = H*Z1*Z2 */
+    ecp_sm2p256_mul_mont(Hcub, Hsqr, H);        /* H^3 */
+
+    ecp_sm2p256_mul_mont(U2, U1, Hsqr);         /* U1*H^2 */
+    ecp_sm2p256_mul_by_2(Hsqr, U2);             /* 2*U1*H^2 */
+
+    ecp_sm2p256_sub(res_x, Rsqr, Hsqr);
+    ecp_sm2p256_sub(res_x, res_x, Hcub);
+
+    ecp_sm2p256_sub(res_y, U2, res_x);
+
+    ecp_sm2p256_mul_mont(S2, S1, Hcub);
+    ecp_sm2p256_mul_mont(res_y, R, res_y);
+    ecp_sm2p256_sub(res_y, res_y, S2);
+
+    copy_conditional(res_x, in2_x, in1infty);
+    copy_conditional(res_y, in2_y, in1infty);
+    copy_conditional(res_z, in2_z, in1infty);
+
+    copy_conditional(res_x, in1_x, in2infty);
+    copy_conditional(res_y, in1_y, in2infty);
+    copy_conditional(res_z, in1_z, in2infty);
+
+    memcpy(r->X, res_x, sizeof(res_x));
+    memcpy(r->Y, res_y, sizeof(res_y));
+    memcpy(r->Z, res_z, sizeof(res_z));
+}
+
+/* Point addition when b is known to be affine: r = a+b */
+static void ecp_sm2p256_point_add_affine(P256_POINT *r,
+                                         const P256_POINT *a,
+                                         const P256_POINT_AFFINE *b)
+{
+    BN_ULONG U2[P256_LIMBS], S2[P256_LIMBS];
+    BN_ULONG Z1sqr[P256_LIMBS];
+    BN_ULONG H[P256_LIMBS], R[P256_LIMBS];
+    BN_ULONG Hsqr[P256_LIMBS];
+    BN_ULONG Rsqr[P256_LIMBS];
+    BN_ULONG Hcub[P256_LIMBS];
+
+    BN_ULONG res_x[P256_LIMBS];
+    BN_ULONG res_y[P256_LIMBS];
+    BN_ULONG res_z[P256_LIMBS];
+
+    BN_ULONG in1infty, in2infty;
+
+    const BN_ULONG *in1_x = a->X;
+    const BN_ULONG *in1_y = a->Y;
+    const BN_ULONG *in1_z = a->Z;
+
+    const BN_ULONG *in2_x = b->X;
+    const BN_ULONG *in2_y = b->Y;
+
+    /*
+     * Infinity in encoded as (,,0)
+     */
+    in1infty = is_zero(in1_z[0] | in1_z[1] | in1_z[2] | in1_z[3]);
+
+    /*
+     * In affine representation we encode infinity as (0,0), which is
+     * not on the curve, so it is OK
+     */
+    in2infty = is_zero(in2_x[0] | in2_x[1] | in2_x[2] | in2_x[3] |
+                       in2_y[0] | in2_y[1] | in2_y[2] | in2_y[3]);
+
+    ecp_sm2p256_sqr_mont(Z1sqr, in1_z);         /* Z1^2 */
+
+    ecp_sm2p256_mul_mont(U2, in2_x, Z1sqr);     /* U2 = X2*Z1^2 */
+    ecp_sm2p256_sub(H, U2, in1_x);              /* H = U2 - U1 */
+
+    ecp_sm2p256_mul_mont(S2, Z1sqr, in1_z);     /* S2 = Z1^3 */
+
+    ecp_sm2p256_mul_mont(res_z, H, in1_z);      /* Z3 = H*Z1*Z2 */
+
+    ecp_sm2p256_mul_mont(S2, S2, in2_y);        /* S2 = Y2*Z1^3 */
+    ecp_sm2p256_sub(R, S2, in1_y);              /* R = S2 - S1 */
+
+    /*
+     * The comb only adds a multiple of G equal to the accumulator for a
+     * negligible set of scalars, so as with point_add this is not a
+     * constant time concern, but the formulas below would get it wrong.
+     */
+    if (is_equal(U2, in1_x) && !in1infty && !in2infty) {
+        if (is_equal(S2, in1_y)) {
+            ecp_sm2p256_point_double(r, a);
+            return;
+        } else {
+            memset(r, 0, sizeof(*r));
+            return;
+        }
+    }
+
+    ecp_sm2p256_sqr_mont(Hsqr, H);              /* H^2 */
+    ecp_sm2p256_sqr_mont(Rsqr, R);              /* R^2 */
+    ecp_sm2p256_mul_mont(Hcub, Hsqr, H);        /* H^3 */
+
+    ecp_sm2p256_mul_mont(U2, in1_x, Hsqr);      /* U1*H^2 */
+    ecp_sm2p256_mul_by_2(Hsqr, U2);             /* 2*U1*H^2 */
+
+    ecp_sm2p256_sub(res_x, Rsqr, Hsqr);
+    ecp_sm2p256_sub(res_x, res_x, Hcub);
+    ecp_sm2p256_sub(H, U2, res_x);
+
+    ecp_sm2p256_mul_mont(S2, in1_y, Hcub);
+    ecp_sm2p256_mul_mont(H, H, R);
+    ecp_sm2p256_sub(res_y, H, S2);
+
+    copy_conditional(res_x, in2_x, in1infty);
+    copy_conditional(res_x, in1_x, in2infty);
+
+    copy_conditional(res_y, in2_y, in1infty);
+    copy_conditional(res_y, in1_y, in2infty);
+
+    copy_conditional(res_z, ONE, in1infty);
+    copy_conditional(res_z, in1_z, in2infty);
+
+    memcpy(r->X, res_x, sizeof(res_x));
+    memcpy(r->Y, res_y, sizeof(res_y));
+    memcpy(r->Z, res_z, sizeof(res_z));
+}
+
+/*
+ * ecp_sm2p256_bignum_to_field_elem copies the contents of |in| to |out| and
+ * returns one if it fits. Otherwise it returns zero.
+ */
+__owur static int ecp_sm2p256_bignum_to_field_elem(BN_ULONG out[P256_LIMBS],
+                                                   const BIGNUM *in)
+{
+    return bn_copy_words(out, in, P256_LIMBS);
+}
+
+/*
+ * Copies |in| to |out| as four little-endian words, reducing it modulo the
+ * group order first if it is negative or longer than 256 bits. This is an
+ * unusual input, we don't guarantee constant-timeness for it.
+ */
+__owur static int ecp_sm2p256_scalar_to_words(BN_ULONG out[P256_LIMBS],
+                                              const EC_GROUP *group,
+                                              const BIGNUM *in, BN_CTX *ctx)
+{
+    if ((BN_num_bits(in) > 256) || BN_is_negative(in)) {
+        BIGNUM *mod;
+
+        if ((mod = BN_CTX_get(ctx)) == NULL)
+            return 0;
+        if (!BN_nnmod(mod, in, group->order, ctx)) {
+            ECerr(EC_F_ECP_SM2P256_SCALAR_TO_WORDS, ERR_R_BN_LIB);
+            return 0;
+        }
+        in = mod;
+    }
+
+    return bn_copy_words(out, in, P256_LIMBS);
+}
+
+/* out = table[idx], or out = (0,0) for idx = 0, in constant time */
+static void ecp_sm2p256_select_affine(P256_POINT_AFFINE *out,
+                                      const P256_POINT_AFFINE table[16],
+                                      BN_ULONG idx)
+{
+    BN_ULONG i;
+
+    memset(out, 0, sizeof(*out));
+    for (i = 1; i < 16; i++) {
+        BN_ULONG mask = 0 - is_zero(i ^ idx);
+
+        out->X[0] |= table[i].X[0] & mask;
+        out->X[1] |= table[i].X[1] & mask;
+        out->X[2] |= table[i].X[2] & mask;
+        out->X[3] |= table[i].X[3] & mask;
+        out->Y[0] |= table[i].Y[0] & mask;
+        out->Y[1] |= table[i].Y[1] & mask;
+        out->Y[2] |= table[i].Y[2] & mask;
+        out->Y[3] |= table[i].Y[3] & mask;
+    }
+}
+
+/* out = table[idx - 1], or out = (0,0,0) for idx = 0, in constant time */
+static void ecp_sm2p256_select_w5(P256_POINT *out, const P256_POINT table[16],
+                                  BN_ULONG idx)
+{
+    BN_ULONG i;
+    int j;
+
+    memset(out, 0, sizeof(*out));
+    for (i = 1; i <= 16; i++) {
+        BN_ULONG mask = 0 - is_zero(i ^ idx);
+
+        for (j = 0; j < P256_LIMBS; j++) {
+            out->X[j] |= table[i - 1].X[j] & mask;
+            out->Y[j] |= table[i - 1].Y[j] & mask;
+            out->Z[j] |= table[i - 1].Z[j] & mask;
+        }
+    }
+}
+
+/*
+ * r = k*G with the comb table. Bit 16*m + i of k[j] selects the m-th tooth
+ * of table j in column i, so there are 16 columns of 4 additions each and
+ * 15 doublings in between.
+ */
+static void ecp_sm2p256_mul_g(P256_POINT *r, const BN_ULONG k[P256_LIMBS])
+{
+    P256_POINT_AFFINE t;
+    BN_ULONG idx;
+    int i, j;
+
+    memset(r, 0, sizeof(*r));
+    for (i = 15; i >= 0; i--) {
+        if (i != 15)
+            ecp_sm2p256_point_double(r, r);
+
+        for (j = 0; j < 4; j++) {
+            idx = ((k[j] >> i) & 1)
+                | ((k[j] >> (i + 16 - 1)) & 2)
+                | ((k[j] >> (i + 32 - 2)) & 4)
+                | ((k[j] >> (i + 48 - 3)) & 8);
+
+            ecp_sm2p256_select_affine(&t, ecp_sm2p256_precomputed[j], idx);
+            ecp_sm2p256_point_add_affine(r, r, &t);
+        }
+    }
+
+    OPENSSL_cleanse(&t, sizeof(t));
+}
+
+/* Recode window to a signed digit, see ecp_nistputil.c for details */
+static unsigned int _booth_recode_w5(unsigned int in)
+{
+    unsigned int s, d;
+
+    s = ~((in >> 5) - 1);
+    d = (1 << 6) - in - 1;
+    d = (d & s) | (in & ~s);
+    d = (d >> 1) + (d & 1);
+
+    return (d << 1) + (s & 1);
+}
+
+/* r = sum(scalar[i]*point[i]) in constant time */
+__owur static int ecp_sm2p256_windowed_mul(const EC_GROUP *group,
+                                           P256_POINT *r,
+                                           const BIGNUM **scalar,
+                                           const EC_POINT **point,
+                                           size_t num, BN_CTX *ctx)
+{
+    size_t i;
+    int j, ret = 0;
+    unsigned int idx;
+    unsigned char (*p_str)[33] = NULL;
+    const unsigned int window_size = 5;
+    const unsigned int mask = (1 << (window_size + 1)) - 1;
+    unsigned int wvalue;
+    BN_ULONG k[P256_LIMBS];
+    P256_POINT temp[5];
+    P256_POINT (*table)[16] = NULL;
+
+    if ((num * 16) > OPENSSL_MALLOC_MAX_NELEMS(P256_POINT)
+        || (table = OPENSSL_malloc(num * sizeof(*table))) == NULL
+        || (p_str = OPENSSL_malloc(num * sizeof(*p_str))) == NULL) {
+        ECerr(EC_F_ECP_SM2P256_WINDOWED_MUL, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    for (i = 0; i < num; i++) {
+        P256_POINT *row = table[i];
+
+        if (!ecp_sm2p256_scalar_to_words(k, group, scalar[i], ctx))
+            goto err;
+
+        for (j = 0; j < 32; j++)
+            p_str[i][j] = (unsigned char)(k[j / 8] >> (8 * (j % 8)));
+        p_str[i][32] = 0;
+
+        if (!ecp_sm2p256_bignum_to_field_elem(temp[0].X, point[i]->X)
+            || !ecp_sm2p256_bignum_to_field_elem(temp[0].Y, point[i]->Y)
+            || !ecp_sm2p256_bignum_to_field_elem(temp[0].Z, point[i]->Z)) {
+            ECerr(EC_F_ECP_SM2P256_WINDOWED_MUL,
+                  EC_R_COORDINATES_OUT_OF_RANGE);
+            goto err;
+        }
+
+        /*
+         * row[0] is implicitly (0,0,0) (the point at infinity), therefore it
+         * is not stored. All other values are actually stored with an offset
+         * of -1 in table.
+         */
+        row[0] = temp[0];
+        ecp_sm2p256_point_double(&temp[1], &temp[0]);               /*1+1=2  */
+        row[1] = temp[1];
+        ecp_sm2p256_point_add   (&temp[2], &temp[1], &temp[0]);     /*2+1=3  */
+        row[2] = temp[2];
+        ecp_sm2p256_point_double(&temp[1], &temp[1]);               /*2*2=4  */
+        row[3] = temp[1];
+        ecp_sm2p256_point_double(&temp[2], &temp[2]);               /*2*3=6  */
+        row[5] = temp[2];
+        ecp_sm2p256_point_add   (&temp[3], &temp[1], &temp[0]);     /*4+1=5  */
+        row[4] = temp[3];
+        ecp_sm2p256_point_add   (&temp[4], &temp[2], &temp[0]);     /*6+1=7  */
+        row[6] = temp[4];
+        ecp_sm2p256_point_double(&temp[1], &temp[1]);               /*2*4=8  */
+        row[7] = temp[1];
+        ecp_sm2p256_point_double(&temp[2], &temp[2]);               /*2*6=12 */
+        row[11] = temp[2];
+        ecp_sm2p256_point_double(&temp[3], &temp[3]);               /*2*5=10 */
+        row[9] = temp[3];
+        ecp_sm2p256_point_double(&temp[4], &temp[4]);               /*2*7=14 */
+        row[13] = temp[4];
+        ecp_sm2p256_point_add   (&temp[2], &temp[2], &temp[0]);     /*12+1=13*/
+        row[12] = temp[2];
+        ecp_sm2p256_point_add   (&temp[3], &temp[3], &temp[0]);     /*10+1=11*/
+        row[10] = temp[3];
+        ecp_sm2p256_point_add   (&temp[4], &temp[4], &temp[0]);     /*14+1=15*/
+        row[14] = temp[4];
+        ecp_sm2p256_point_add   (&temp[2], &temp[1], &temp[0]);     /*8+1=9  */
+        row[8] = temp[2];
+        ecp_sm2p256_point_double(&temp[1], &temp[1]);               /*2*8=16 */
+        row[15] = temp[1];
+    }
+
+    idx = 255;
+
+    wvalue = p_str[0][(idx - 1) / 8];
+    wvalue = (wvalue >> ((idx - 1) % 8)) & mask;
+
+    ecp_sm2p256_select_w5(r, table[0], _booth_recode_w5(wvalue) >> 1);
+
+    while (idx >= 5) {
+        for (i = (idx == 255 ? 1 : 0); i < num; i++) {
+            unsigned int off = (idx - 1) / 8;
+
+            wvalue = p_str[i][off] | p_str[i][off + 1] << 8;
+            wvalue = (wvalue >> ((idx - 1) % 8)) & mask;
+
+            wvalue = _booth_recode_w5(wvalue);
+
+            ecp_sm2p256_select_w5(&temp[0], table[i], wvalue >> 1);
+
+            ecp_sm2p256_neg(temp[1].Y, temp[0].Y);
+            copy_conditional(temp[0].Y, temp[1].Y, (wvalue & 1));
+
+            ecp_sm2p256_point_add(r, r, &temp[0]);
+        }
+
+        idx -= window_size;
+
+        ecp_sm2p256_point_double(r, r);
+        ecp_sm2p256_point_double(r, r);
+        ecp_sm2p256_point_double(r, r);
+        ecp_sm2p256_point_double(r, r);
+        ecp_sm2p256_point_double(r, r);
+    }
+
+    /* Final window */
+    for (i = 0; i < num; i++) {
+        wvalue = p_str[i][0];
+        wvalue = (wvalue << 1) & mask;
+
+        wvalue = _booth_recode_w5(wvalue);
+
+        ecp_sm2p256_select_w5(&temp[0], table[i], wvalue >> 1);
+
+        ecp_sm2p256_neg(temp[1].Y, temp[0].Y);
+        copy_conditional(temp[0].Y, temp[1].Y, wvalue & 1);
+
+        ecp_sm2p256_point_add(r, r, &temp[0]);
+    }
+
+    ret = 1;
+ err:
+    OPENSSL_cleanse(k, sizeof(k));
+    OPENSSL_cleanse(temp, sizeof(temp));
+    if (table != NULL)
+        OPENSSL_clear_free(table, num * sizeof(*table));
+    if (p_str != NULL)
+        OPENSSL_clear_free(p_str, num * sizeof(*p_str));
+    return ret;
+}
+
+/*
+ * Width-w NAF of the 256-bit k: odd digits below 2^(w-1) in absolute value,
+ * least significant first, with at most one non-zero digit in any w
+ * consecutive ones. Returns the number of digits, at most 257.
+ */
+static int ecp_sm2p256_compute_wnaf(signed char digits[257],
+                                    const BN_ULONG k[P256_LIMBS])
+{
+    BN_ULONG d[P256_LIMBS + 1];
+    u128 acc;
+    int i, j, len = 0, digit;
+
+    memcpy(d, k, P256_LIMBS * sizeof(BN_ULONG));
+    d[P256_LIMBS] = 0;
+
+    while ((d[0] | d[1] | d[2] | d[3] | d[4]) != 0) {
+        digit = 0;
+        if (d[0] & 1) {
+            digit = (int)(d[0] & ((1 << WNAF_WINDOW) - 1));
+            if (digit >= (1 << (WNAF_WINDOW - 1)))
+                digit -= 1 << WNAF_WINDOW;
+
+            /* d -= digit, which clears the low w bits */
+            if (digit > 0) {
+                BN_ULONG borrow = (BN_ULONG)digit;
+
+                for (j = 0; j <= P256_LIMBS; j++) {
+                    acc = (u128)d[j] - borrow;
+                    d[j] = (BN_ULONG)acc;
+                    borrow = (BN_ULONG)(acc >> 127);
+                }
+            } else {
+                BN_ULONG carry = (BN_ULONG)-digit;
+
+                for (j = 0; j <= P256_LIMBS; j++) {
+                    acc = (u128)d[j] + carry;
+                    d[j] = (BN_ULONG)acc;
+                    carry = (BN_ULONG)(acc >> 64);
+                }
+            }
+        }
+        digits[len++] = (signed char)digit;
+
+        for (i = 0; i < P256_LIMBS; i++)
+            d[i] = (d[i] >> 1) | (d[i + 1] << 63);
+        d[P256_LIMBS] >>= 1;
+    }
+
+    return len;
+}
+
+/*
+ * r = sum(scalar[i]*point[i]) with interleaved wNAF. This is not constant
+ * time and is only used when the scalars are public, i.e. for verification.
+ */
+__owur static int ecp_sm2p256_wnaf_mul(const EC_GROUP *group, P256_POINT *r,
+                                       const BIGNUM **scalar,
+                                       const EC_POINT **point,
+                                       size_t num, BN_CTX *ctx)
+{
+    size_t i;
+    int j, len = 0, ret = 0;
+    BN_ULONG k[P256_LIMBS];
+    P256_POINT dbl, neg;
+    P256_POINT (*table)[WNAF_TABLE] = NULL;
+    signed char (*wnaf)[257] = NULL;
+    int *wnaf_len = NULL;
+
+    if ((num * WNAF_TABLE) > OPENSSL_MALLOC_MAX_NELEMS(P256_POINT)
+        || (table = OPENSSL_malloc(num * sizeof(*table))) == NULL
+        || (wnaf = OPENSSL_malloc(num * sizeof(*wnaf))) == NULL
+        || (wnaf_len = OPENSSL_malloc(num * sizeof(*wnaf_len))) == NULL) {
+        ECerr(EC_F_ECP_SM2P256_WNAF_MUL, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    for (i = 0; i < num; i++) {
+        P256_POINT *row = table[i];
+
+        if (!ecp_sm2p256_scalar_to_words(k, group, scalar[i], ctx))
+            goto err;
+        wnaf_len[i] = ecp_sm2p256_compute_wnaf(wnaf[i], k);
+        if (wnaf_len[i] > len)
+            len = wnaf_len[i];
+
+        if (!ecp_sm2p256_bignum_to_field_elem(row[0].X, point[i]->X)
+            || !ecp_sm2p256_bignum_to_field_elem(row[0].Y, point[i]->Y)
+            || !ecp_sm2p256_bignum_to_field_elem(row[0].Z, point[i]->Z)) {
+            ECerr(EC_F_ECP_SM2P256_WNAF_MUL, EC_R_COORDINATES_OUT_OF_RANGE);
+            goto err;
+        }
+
+        /* row[j] = (2*j + 1) * point[i] */
+        ecp_sm2p256_point_double(&dbl, &row[0]);
+        for (j = 1; j < WNAF_TABLE; j++)
+            ecp_sm2p256_point_add(&row[j], &row[j - 1], &dbl);
+    }
+
+    memset(r, 0, sizeof(*r));
+    for (j = len - 1; j >= 0; j--) {
+        ecp_sm2p256_point_double(r, r);
+
+        for (i = 0; i < num; i++) {
+            int digit = j < wnaf_len[i] ? wnaf[i][j] : 0;
+
+            if (digit > 0) {
+                ecp_sm2p256_point_add(r, r, &table[i][digit >> 1]);
+            } else if (digit < 0) {
+                neg = table[i][(-digit) >> 1];
+                ecp_sm2p256_neg(neg.Y, neg.Y);
+                ecp_sm2p256_point_add(r, r, &neg);
+            }
+        }
+    }
+
+    ret = 1;
+ err:
+    OPENSSL_free(table);
+    OPENSSL_free(wnaf);
+    OPENSSL_free(wnaf_len);
+    return ret;
+}
+
+/*
+ * ecp_sm2p256_is_affine_G returns one if |generator| is the standard, SM2
+ * generator.
+ */
+static int ecp_sm2p256_is_affine_G(const EC_POINT *generator)
+{
+    return (bn_get_top(generator->X) == P256_LIMBS) &&
+        (bn_get_top(generator->Y) == P256_LIMBS) &&
+        is_equal(bn_get_words(generator->X), def_xG) &&
+        is_equal(bn_get_words(generator->Y), def_yG) &&
+        is_one(generator->Z);
+}
+
+/* r = scalar*G + sum(scalars[i]*points[i]) */
+__owur static int ecp_sm2p256_points_mul(const EC_GROUP *group,
+                                         EC_POINT *r,
+                                         const BIGNUM *scalar,
+                                         size_t num,
+                                         const EC_POINT *points[],
+                                         const BIGNUM *scalars[], BN_CTX *ctx)
+{
+    int ret = 0, no_precomp_for_generator = 0, p_is_infinity = 0;
+    int public_scalars;
+    size_t j;
+    const EC_POINT *generator = NULL;
+    BN_CTX *new_ctx = NULL;
+    const BIGNUM **new_scalars = NULL;
+    const EC_POINT **new_points = NULL;
+    BN_ULONG k[P256_LIMBS];
+    P256_POINT t, p;
+
+    if ((num + 1) == 0 || (num + 1) > OPENSSL_MALLOC_MAX_NELEMS(void *)) {
+        ECerr(EC_F_ECP_SM2P256_POINTS_MUL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    if (group->meth != r->meth) {
+        ECerr(EC_F_ECP_SM2P256_POINTS_MUL, EC_R_INCOMPATIBLE_OBJECTS);
+        return 0;
+    }
+
+    if ((scalar == NULL) && (num == 0))
+        return EC_POINT_set_to_infinity(group, r);
+
+    for (j = 0; j < num; j++) {
+        if (group->meth != points[j]->meth) {
+            ECerr(EC_F_ECP_SM2P256_POINTS_MUL, EC_R_INCOMPATIBLE_OBJECTS);
+            return 0;
+        }
+    }
+
+    /*
+     * Sign, key generation, ECDH, key exchange and decryption all multiply
+     * a secret scalar by either G or a single point. Only verification
+     * passes both, and its scalars are public.
+     */
+    public_scalars = (scalar != NULL && num > 0);
+
+    if (ctx == NULL) {
+        ctx = new_ctx = BN_CTX_new();
+        if (ctx == NULL)
+            goto err;
+    }
+
+    BN_CTX_start(ctx);
+
+    if (scalar) {
+        generator = EC_GROUP_get0_generator(group);
+        if (generator == NULL) {
+            ECerr(EC_F_ECP_SM2P256_POINTS_MUL, EC_R_UNDEFINED_GENERATOR);
+            goto err;
+        }
+
+        if (ecp_sm2p256_is_affine_G(generator)) {
+            if (!ecp_sm2p256_scalar_to_words(k, group, scalar, ctx))
+                goto err;
+            ecp_sm2p256_mul_g(&p, k);
+        } else {
+            p_is_infinity = 1;
+            no_precomp_for_generator = 1;
+        }
+    } else
+        p_is_infinity = 1;
+
+    if (no_precomp_for_generator) {
+        /*
+         * Without a precomputed table for the generator, it has to be
+         * handled like a normal point.
+         */
+        new_scalars = OPENSSL_malloc((num + 1) * sizeof(BIGNUM *));
+        if (new_scalars == NULL) {
+            ECerr(EC_F_ECP_SM2P256_POINTS_MUL, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+
+        new_points = OPENSSL_malloc((num + 1) * sizeof(EC_POINT *));
+        if (new_points == NULL) {
+            ECerr(EC_F_ECP_SM2P256_POINTS_MUL, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+
+        memcpy(new_scalars, scalars, num * sizeof(BIGNUM *));
+        new_scalars[num] = scalar;
+        memcpy(new_points, points, num * sizeof(EC_POINT *));
+        new_points[num] = generator;
+
+        scalars = new_scalars;
+        points = new_points;
+        num++;
+    }
+
+    if (num) {
+        P256_POINT *out = &t;
+        if (p_is_infinity)
+            out = &p;
+
+        if (public_scalars) {
+            if (!ecp_sm2p256_wnaf_mul(group, out, scalars, points, num, ctx))
+                goto err;
+        } else {
+            if (!ecp_sm2p256_windowed_mul(group, out, scalars, points, num,
+                                          ctx))
+                goto err;
+        }
+
+        if (!p_is_infinity)
+            ecp_sm2p256_point_add(&p, &p, out);
+    }
+
+    /* Not constant-time, but we're only operating on the public output. */
+    if (!bn_set_words(r->X, p.X, P256_LIMBS) ||
+        !bn_set_words(r->Y, p.Y, P256_LIMBS) ||
+        !bn_set_words(r->Z, p.Z, P256_LIMBS)) {
+        goto err;
+    }
+    r->Z_is_one = is_one(r->Z) & 1;
+
+    ret = 1;
+
+err:
+    if (ctx)
+        BN_CTX_end(ctx);
+    BN_CTX_free(new_ctx);
+    OPENSSL_free(new_points);
+    OPENSSL_free(new_scalars);
+    OPENSSL_cleanse(k, sizeof(k));
+    OPENSSL_cleanse(&t, sizeof(t));
+    OPENSSL_cleanse(&p, sizeof(p));
+    return ret;
+}
+
+__owur static int ecp_sm2p256_get_affine(const EC_GROUP *group,
+                                         const EC_POINT *point,
+                                         BIGNUM *x, BIGNUM *y, BN_CTX *ctx)
+{
+    BN_ULONG z_inv2[P256_LIMBS];
+    BN_ULONG z_inv3[P256_LIMBS];
+    BN_ULONG x_aff[P256_LIMBS];
+    BN_ULONG y_aff[P256_LIMBS];
+    BN_ULONG point_x[P256_LIMBS], point_y[P256_LIMBS], point_z[P256_LIMBS];
+    BN_ULONG x_ret[P256_LIMBS], y_ret[P256_LIMBS];
+
+    if (EC_POINT_is_at_infinity(group, point)) {
+        ECerr(EC_F_ECP_SM2P256_GET_AFFINE, EC_R_POINT_AT_INFINITY);
+        return 0;
+    }
+
+    if (!ecp_sm2p256_bignum_to_field_elem(point_x, point->X) ||
+        !ecp_sm2p256_bignum_to_field_elem(point_y, point->Y) ||
+        !ecp_sm2p256_bignum_to_field_elem(point_z, point->Z)) {
+        ECerr(EC_F_ECP_SM2P256_GET_AFFINE, EC_R_COORDINATES_OUT_OF_RANGE);
+        return 0;
+    }
+
+    ecp_sm2p256_mod_inverse(z_inv3, point_z);
+    ecp_sm2p256_sqr_mont(z_inv2, z_inv3);
+    ecp_sm2p256_mul_mont(x_aff, z_inv2, point_x);
+
+    if (x != NULL) {
+        ecp_sm2p256_from_mont(x_ret, x_aff);
+        if (!bn_set_words(x, x_ret, P256_LIMBS))
+            return 0;
+    }
+
+    if (y != NULL) {
+        ecp_sm2p256_mul_mont(z_inv3, z_inv3, z_inv2);
+        ecp_sm2p256_mul_mont(y_aff, z_inv3, point_y);
+        ecp_sm2p256_from_mont(y_ret, y_aff);
+        if (!bn_set_words(y, y_ret, P256_LIMBS))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int ecp_sm2p256_have_precompute_mult(const EC_GROUP *group)
+{
+    /* There is a hard-coded table for the default generator. */
+    const EC_POINT *generator = EC_GROUP_get0_generator(group);
+
+    return generator != NULL && ecp_sm2p256_is_affine_G(generator);
+}
+
+const EC_METHOD *EC_GFp_sm2p256_method(void)
+{
+    static const EC_METHOD ret = {
+        EC_FLAGS_DEFAULT_OCT,
+        NID_X9_62_prime_field,
+        ec_GFp_mont_group_init,
+        ec_GFp_mont_group_finish,
+        ec_GFp_mont_group_clear_finish,
+        ec_GFp_mont_group_copy,
+        ec_GFp_mont_group_set_curve,
+        ec_GFp_simple_group_get_curve,
+        ec_GFp_simple_group_get_degree,
+        ec_group_simple_order_bits,
+        ec_GFp_simple_group_check_discriminant,
+        ec_GFp_simple_point_init,
+        ec_GFp_simple_point_finish,
+        ec_GFp_simple_point_clear_finish,
+        ec_GFp_simple_point_copy,
+        ec_GFp_simple_point_set_to_infinity,
+        ec_GFp_simple_set_Jprojective_coordinates_GFp,
+        ec_GFp_simple_get_Jprojective_coordinates_GFp,
+        ec_GFp_simple_point_set_affine_coordinates,
+        ecp_sm2p256_get_affine,
+        0, 0, 0,
+        ec_GFp_simple_add,
+        ec_GFp_simple_dbl,
+        ec_GFp_simple_invert,
+        ec_GFp_simple_is_at_infinity,
+        ec_GFp_simple_is_on_curve,
+        ec_GFp_simple_cmp,
+        ec_GFp_simple_make_affine,
+        ec_GFp_simple_points_make_affine,
+        ecp_sm2p256_points_mul,                     /* mul */
+        0,                                          /* precompute_mult */
+        ecp_sm2p256_have_precompute_mult,           /* have_precompute_mult */
+        ec_GFp_mont_field_mul,
+        ec_GFp_mont_field_sqr,
+        0,                                          /* field_div */
+        ec_GFp_mont_field_encode,
+        ec_GFp_mont_field_decode,
+        ec_GFp_mont_field_set_to_one,
+        ec_key_simple_priv2oct,
+        ec_key_simple_oct2priv,
+        0, /* set private */
+        ec_key_simple_generate_key,
+        ec_key_simple_check_key,
+        ec_key_simple_generate_public_key,
+        0, /* keycopy */
+        0, /* keyfinish */
+        ecdh_simple_compute_key
+    };
+
+    return &ret;
+}
+
+#endif                          /* ECP_SM2P256 */
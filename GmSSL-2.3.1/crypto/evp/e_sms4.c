@@ -90,7 +90,12 @@ static int sms4_init_key(EVP_CIPHER_CTX *ctx, const unsigned char *key,
 		sms4_set_encrypt_key(&dat->ks, key);
 	}
 	dat->block = (block128_f)sms4_encrypt;
-	dat->stream.cbc = mode == EVP_CIPH_CBC_MODE ? (cbc128_f) sms4_cbc_encrypt : NULL;
+	if (mode == EVP_CIPH_CBC_MODE)
+		dat->stream.cbc = (cbc128_f)sms4_cbc_encrypt;
+	else if (mode == EVP_CIPH_CTR_MODE)
+		dat->stream.ctr = (ctr128_f)sms4_ctr32_encrypt_blocks;
+	else
+		dat->stream.cbc = NULL;
 
 	return 1;
 }
@@ -179,10 +184,16 @@ static int sms4_ctr_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
 	unsigned int num = EVP_CIPHER_CTX_num(ctx);
 	EVP_SMS4_KEY *sms4 = (EVP_SMS4_KEY *)ctx->cipher_data;
 
-	CRYPTO_ctr128_encrypt(in, out, len, &sms4->ks,
-		EVP_CIPHER_CTX_iv_noconst(ctx),
-		EVP_CIPHER_CTX_buf_noconst(ctx), &num,
-		sms4->block);
+	if (sms4->stream.ctr)
+		CRYPTO_ctr128_encrypt_ctr32(in, out, len, &sms4->ks,
+			EVP_CIPHER_CTX_iv_noconst(ctx),
+			EVP_CIPHER_CTX_buf_noconst(ctx), &num,
+			sms4->stream.ctr);
+	else
+		CRYPTO_ctr128_encrypt(in, out, len, &sms4->ks,
+			EVP_CIPHER_CTX_iv_noconst(ctx),
+			EVP_CIPHER_CTX_buf_noconst(ctx), &num,
+			sms4->block);
 
 	EVP_CIPHER_CTX_set_num(ctx, num);
 	return 1;
@@ -258,7 +258,7 @@ static int sms4_gcm_init_key(EVP_CIPHER_CTX *ctx, const unsigned char *key,
             sms4_set_encrypt_key(&gctx->ks.ks, key);
             CRYPTO_gcm128_init(&gctx->gcm, &gctx->ks,
                                (block128_f)sms4_encrypt);
-            gctx->ctr = NULL;
+            gctx->ctr = (ctr128_f)sms4_ctr32_encrypt_blocks;
         } while (0);
 
         /*
@@ -132,8 +132,13 @@ SM2CiphertextValue *SM2_do_encrypt(const EVP_MD *md,
 
 	nbytes = (EC_GROUP_get_degree(group) + 7) / 8;
 
-	/* check [h]P_B != O */
-	if (!EC_POINT_mul(group, share_point, NULL, pub_key, h, bn_ctx)) {
+	/* check [h]P_B != O, for h == 1 this is P_B itself */
+	if (BN_is_one(h)) {
+		if (!EC_POINT_copy(share_point, pub_key)) {
+			SM2err(SM2_F_SM2_DO_ENCRYPT, ERR_R_EC_LIB);
+			goto end;
+		}
+	} else if (!EC_POINT_mul(group, share_point, NULL, pub_key, h, bn_ctx)) {
 		SM2err(SM2_F_SM2_DO_ENCRYPT, ERR_R_EC_LIB);
 		goto end;
 	}
@@ -416,8 +421,13 @@ int SM2_do_decrypt(const EVP_MD *md, const SM2CiphertextValue *cv,
 		}
 	}
 
-	/* check [h]C1 != O */
-	if (!EC_POINT_mul(group, tmp_point, NULL, point, h, bn_ctx)) {
+	/* check [h]C1 != O, for h == 1 this is C1 itself */
+	if (BN_is_one(h)) {
+		if (!EC_POINT_copy(tmp_point, point)) {
+			SM2err(SM2_F_SM2_DO_DECRYPT, ERR_R_EC_LIB);
+			goto end;
+		}
+	} else if (!EC_POINT_mul(group, tmp_point, NULL, point, h, bn_ctx)) {
 		SM2err(SM2_F_SM2_DO_DECRYPT, ERR_R_EC_LIB);
 		goto end;
 	}
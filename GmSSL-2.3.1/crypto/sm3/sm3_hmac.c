@@ -71,26 +71,59 @@
 #define IPAD	0x36
 #define OPAD	0x5C
 
-void sm3_hmac_init(sm3_hmac_ctx_t *ctx, const unsigned char *key, size_t key_len)
+/*
+ * The padded key blocks are compressed once here, every message then
+ * starts from the saved states and saves two compressions per MAC.
+ */
+void sm3_hmac_set_key(sm3_hmac_key_t *key, const unsigned char *raw_key, size_t key_len)
 {
+	sm3_ctx_t ctx;
+	unsigned char block[SM3_BLOCK_SIZE];
 	int i;
 
 	if (key_len <= SM3_BLOCK_SIZE) {
-		memcpy(ctx->key, key, key_len);
-		memset(ctx->key + key_len, 0, SM3_BLOCK_SIZE - key_len);
+		memcpy(block, raw_key, key_len);
+		memset(block + key_len, 0, SM3_BLOCK_SIZE - key_len);
 	} else {
-		sm3_init(&ctx->sm3_ctx);
-		sm3_update(&ctx->sm3_ctx, key, key_len);
-		sm3_final(&ctx->sm3_ctx, ctx->key);
-		memset(ctx->key + SM3_DIGEST_LENGTH, 0,
+		sm3_init(&ctx);
+		sm3_update(&ctx, raw_key, key_len);
+		sm3_final(&ctx, block);
+		memset(block + SM3_DIGEST_LENGTH, 0,
 			SM3_BLOCK_SIZE - SM3_DIGEST_LENGTH);
 	}
+
 	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
-		ctx->key[i] ^= IPAD;
+		block[i] ^= IPAD;
+	}
+	sm3_init(&ctx);
+	sm3_compress(ctx.digest, block);
+	memcpy(key->ipad_digest, ctx.digest, sizeof(key->ipad_digest));
+
+	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
+		block[i] ^= (IPAD ^ OPAD);
+	}
+	sm3_init(&ctx);
+	sm3_compress(ctx.digest, block);
+	memcpy(key->opad_digest, ctx.digest, sizeof(key->opad_digest));
+
+	memset(block, 0, sizeof(block));
+	memset(&ctx, 0, sizeof(ctx));
+}
+
+void sm3_hmac_init_key(sm3_hmac_ctx_t *ctx, const sm3_hmac_key_t *key)
+{
+	if (&ctx->key != key) {
+		memcpy(&ctx->key, key, sizeof(sm3_hmac_key_t));
 	}
+	memcpy(ctx->sm3_ctx.digest, key->ipad_digest, sizeof(key->ipad_digest));
+	ctx->sm3_ctx.nblocks = 1;
+	ctx->sm3_ctx.num = 0;
+}
 
-	sm3_init(&ctx->sm3_ctx);
-	sm3_update(&ctx->sm3_ctx, ctx->key, SM3_BLOCK_SIZE);
+void sm3_hmac_init(sm3_hmac_ctx_t *ctx, const unsigned char *key, size_t key_len)
+{
+	sm3_hmac_set_key(&ctx->key, key, key_len);
+	sm3_hmac_init_key(ctx, &ctx->key);
 }
 
 void sm3_hmac_update(sm3_hmac_ctx_t *ctx,
@@ -101,13 +134,10 @@ void sm3_hmac_update(sm3_hmac_ctx_t *ctx,
 
 void sm3_hmac_final(sm3_hmac_ctx_t *ctx, unsigned char mac[SM3_HMAC_SIZE])
 {
-	int i;
-	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
-		ctx->key[i] ^= (IPAD ^ OPAD);
-	}
 	sm3_final(&ctx->sm3_ctx, mac);
-	sm3_init(&ctx->sm3_ctx);
-	sm3_update(&ctx->sm3_ctx, ctx->key, SM3_BLOCK_SIZE);
+	memcpy(ctx->sm3_ctx.digest, ctx->key.opad_digest, sizeof(ctx->key.opad_digest));
+	ctx->sm3_ctx.nblocks = 1;
+	ctx->sm3_ctx.num = 0;
 	sm3_update(&ctx->sm3_ctx, mac, SM3_DIGEST_LENGTH);
 	sm3_final(&ctx->sm3_ctx, mac);
 }
@@ -0,0 +1,197 @@
+/* ====================================================================
+ * Copyright (c) 2014 - 2017 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+#include <string.h>
+#include <openssl/sm3.h>
+#include <openssl/crypto.h>
+#include "sm3_lcl.h"
+
+#define PUT32(p, v)					\
+	(p)[0] = (unsigned char)((v) >> 24);		\
+	(p)[1] = (unsigned char)((v) >> 16);		\
+	(p)[2] = (unsigned char)((v) >>  8);		\
+	(p)[3] = (unsigned char)(v)
+
+/*
+ * Compress one block into each of SM3_MB_LANES states, lanes with a NULL
+ * block are idle. The AVX2 kernel is picked at runtime from the cpuid
+ * capability vector, otherwise the lanes are compressed one by one.
+ */
+static void sm3_compress_8lanes(uint32_t *digest[SM3_MB_LANES],
+	const unsigned char *block[SM3_MB_LANES])
+{
+	int i;
+
+#ifdef SM3_AVX2
+	if (SM3_AVX2_CAPABLE) {
+		sm3_avx2_compress_8lanes(digest, block);
+		return;
+	}
+#endif
+	for (i = 0; i < SM3_MB_LANES; i++) {
+		if (block[i]) {
+			sm3_compress(digest[i], block[i]);
+		}
+	}
+}
+
+/*
+ * Hash up to SM3_MB_LANES messages, each continuing from state[i] after
+ * prefix_blocks blocks (0 for SM3, 1 for the HMAC-SM3 key block). The
+ * full blocks are read in place and only the padded tail is copied, so
+ * digest[i] may point into data[i].
+ */
+static void sm3_mb_lanes(uint32_t state[][8], size_t prefix_blocks,
+	const unsigned char *data[], const size_t datalen[],
+	unsigned char *digest[], size_t num)
+{
+	unsigned char tail[SM3_MB_LANES][SM3_BLOCK_SIZE * 2];
+	size_t nfull[SM3_MB_LANES];
+	size_t nblocks[SM3_MB_LANES];
+	uint32_t *lane_digest[SM3_MB_LANES];
+	const unsigned char *lane_block[SM3_MB_LANES];
+	size_t maxblocks = 0;
+	size_t i, j;
+
+	for (i = 0; i < num; i++) {
+		size_t rem = datalen[i] % SM3_BLOCK_SIZE;
+		size_t tail_len = (rem + 9 <= SM3_BLOCK_SIZE) ?
+			SM3_BLOCK_SIZE : SM3_BLOCK_SIZE * 2;
+		uint64_t nbits = ((uint64_t)prefix_blocks * SM3_BLOCK_SIZE
+			+ datalen[i]) << 3;
+
+		nfull[i] = datalen[i] / SM3_BLOCK_SIZE;
+		nblocks[i] = nfull[i] + tail_len / SM3_BLOCK_SIZE;
+		if (nblocks[i] > maxblocks) {
+			maxblocks = nblocks[i];
+		}
+
+		memcpy(tail[i], data[i] + nfull[i] * SM3_BLOCK_SIZE, rem);
+		tail[i][rem] = 0x80;
+		memset(tail[i] + rem + 1, 0, tail_len - rem - 9);
+		PUT32(tail[i] + tail_len - 8, (uint32_t)(nbits >> 32));
+		PUT32(tail[i] + tail_len - 4, (uint32_t)nbits);
+	}
+
+	for (j = 0; j < maxblocks; j++) {
+		for (i = 0; i < SM3_MB_LANES; i++) {
+			lane_digest[i] = i < num ? state[i] : NULL;
+			if (i >= num || j >= nblocks[i]) {
+				lane_block[i] = NULL;
+			} else if (j < nfull[i]) {
+				lane_block[i] = data[i] + j * SM3_BLOCK_SIZE;
+			} else {
+				lane_block[i] = tail[i] + (j - nfull[i]) * SM3_BLOCK_SIZE;
+			}
+		}
+		sm3_compress_8lanes(lane_digest, lane_block);
+	}
+
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < 8; j++) {
+			PUT32(digest[i] + 4 * j, state[i][j]);
+		}
+	}
+	OPENSSL_cleanse(tail, sizeof(tail));
+}
+
+void sm3_mb(const unsigned char *data[], const size_t datalen[],
+	unsigned char *digest[], size_t num)
+{
+	uint32_t state[SM3_MB_LANES][8];
+	sm3_ctx_t ctx;
+	size_t i, n;
+
+	sm3_init(&ctx);
+	for (; num > 0; num -= n) {
+		n = num < SM3_MB_LANES ? num : SM3_MB_LANES;
+		for (i = 0; i < n; i++) {
+			memcpy(state[i], ctx.digest, sizeof(ctx.digest));
+		}
+		sm3_mb_lanes(state, 0, data, datalen, digest, n);
+		data += n;
+		datalen += n;
+		digest += n;
+	}
+}
+
+/*
+ * The inner hashes of all lanes are computed first and then fed, 32 bytes
+ * each, to the outer hashes, so both passes keep every lane busy.
+ */
+void sm3_hmac_mb(const sm3_hmac_key_t *key[], const unsigned char *data[],
+	const size_t datalen[], unsigned char *mac[], size_t num)
+{
+	uint32_t state[SM3_MB_LANES][8];
+	const unsigned char *inner[SM3_MB_LANES];
+	size_t inner_len[SM3_MB_LANES];
+	size_t i, n;
+
+	for (; num > 0; num -= n) {
+		n = num < SM3_MB_LANES ? num : SM3_MB_LANES;
+		for (i = 0; i < n; i++) {
+			memcpy(state[i], key[i]->ipad_digest, sizeof(state[i]));
+		}
+		sm3_mb_lanes(state, 1, data, datalen, mac, n);
+
+		for (i = 0; i < n; i++) {
+			memcpy(state[i], key[i]->opad_digest, sizeof(state[i]));
+			inner[i] = mac[i];
+			inner_len[i] = SM3_DIGEST_LENGTH;
+		}
+		sm3_mb_lanes(state, 1, inner, inner_len, mac, n);
+
+		key += n;
+		data += n;
+		datalen += n;
+		mac += n;
+	}
+	OPENSSL_cleanse(state, sizeof(state));
+}
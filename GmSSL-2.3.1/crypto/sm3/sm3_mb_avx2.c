@@ -0,0 +1,250 @@
+/* ====================================================================
+ * Copyright (c) 2014 - 2017 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ *
+ */
+
+#include <openssl/sm3.h>
+#include "sm3_lcl.h"
+
+#ifdef SM3_AVX2
+#include <immintrin.h>
+
+/*
+ * Eight independent SM3 compressions, lane i of every register holds the
+ * state or message word of block[i]. Like the SMS4 kernels the function is
+ * compiled with the avx2 target attribute, the caller is responsible for
+ * checking SM3_AVX2_CAPABLE before calling it.
+ */
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/* T(j) <<< (j mod 32) */
+static const uint32_t K[64] = {
+	0x79CC4519, 0xF3988A32, 0xE7311465, 0xCE6228CB,
+	0x9CC45197, 0x3988A32F, 0x7311465E, 0xE6228CBC,
+	0xCC451979, 0x988A32F3, 0x311465E7, 0x6228CBCE,
+	0xC451979C, 0x88A32F39, 0x11465E73, 0x228CBCE6,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C,
+	0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC,
+	0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+	0x7A879D8A, 0xF50F3B14, 0xEA1E7629, 0xD43CEC53,
+	0xA879D8A7, 0x50F3B14F, 0xA1E7629E, 0x43CEC53D,
+	0x879D8A7A, 0x0F3B14F5, 0x1E7629EA, 0x3CEC53D4,
+	0x79D8A7A8, 0xF3B14F50, 0xE7629EA1, 0xCEC53D43,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C,
+	0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC,
+	0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+};
+
+#define ROTL(x, n)							\
+	_mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+#define P0(x)	_mm256_xor_si256(x, _mm256_xor_si256(ROTL(x, 9), ROTL(x, 17)))
+#define P1(x)	_mm256_xor_si256(x, _mm256_xor_si256(ROTL(x, 15), ROTL(x, 23)))
+
+#define XOR3(x, y, z)	_mm256_xor_si256(x, _mm256_xor_si256(y, z))
+#define FF1(x, y, z)							\
+	_mm256_or_si256(_mm256_and_si256(x, y),				\
+		_mm256_and_si256(_mm256_or_si256(x, y), z))
+#define GG1(x, y, z)							\
+	_mm256_or_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+
+/* 8x8 transpose of 32-bit words, r0..r7 in and out, t0..t7 scratch */
+#define TRANSPOSE8()							\
+	t0 = _mm256_unpacklo_epi32(r0, r1);				\
+	t1 = _mm256_unpackhi_epi32(r0, r1);				\
+	t2 = _mm256_unpacklo_epi32(r2, r3);				\
+	t3 = _mm256_unpackhi_epi32(r2, r3);				\
+	t4 = _mm256_unpacklo_epi32(r4, r5);				\
+	t5 = _mm256_unpackhi_epi32(r4, r5);				\
+	t6 = _mm256_unpacklo_epi32(r6, r7);				\
+	t7 = _mm256_unpackhi_epi32(r6, r7);				\
+	r0 = _mm256_unpacklo_epi64(t0, t2);				\
+	r1 = _mm256_unpackhi_epi64(t0, t2);				\
+	r2 = _mm256_unpacklo_epi64(t1, t3);				\
+	r3 = _mm256_unpackhi_epi64(t1, t3);				\
+	r4 = _mm256_unpacklo_epi64(t4, t6);				\
+	r5 = _mm256_unpackhi_epi64(t4, t6);				\
+	r6 = _mm256_unpacklo_epi64(t5, t7);				\
+	r7 = _mm256_unpackhi_epi64(t5, t7);				\
+	t0 = _mm256_permute2x128_si256(r0, r4, 0x20);			\
+	t1 = _mm256_permute2x128_si256(r1, r5, 0x20);			\
+	t2 = _mm256_permute2x128_si256(r2, r6, 0x20);			\
+	t3 = _mm256_permute2x128_si256(r3, r7, 0x20);			\
+	t4 = _mm256_permute2x128_si256(r0, r4, 0x31);			\
+	t5 = _mm256_permute2x128_si256(r1, r5, 0x31);			\
+	t6 = _mm256_permute2x128_si256(r2, r6, 0x31);			\
+	t7 = _mm256_permute2x128_si256(r3, r7, 0x31);			\
+	r0 = t0; r1 = t1; r2 = t2; r3 = t3;				\
+	r4 = t4; r5 = t5; r6 = t6; r7 = t7
+
+#define LOAD8(p, off)							\
+	r0 = _mm256_loadu_si256((const __m256i *)((p)[0] + (off)));	\
+	r1 = _mm256_loadu_si256((const __m256i *)((p)[1] + (off)));	\
+	r2 = _mm256_loadu_si256((const __m256i *)((p)[2] + (off)));	\
+	r3 = _mm256_loadu_si256((const __m256i *)((p)[3] + (off)));	\
+	r4 = _mm256_loadu_si256((const __m256i *)((p)[4] + (off)));	\
+	r5 = _mm256_loadu_si256((const __m256i *)((p)[5] + (off)));	\
+	r6 = _mm256_loadu_si256((const __m256i *)((p)[6] + (off)));	\
+	r7 = _mm256_loadu_si256((const __m256i *)((p)[7] + (off)))
+
+#define ROUND(j, FF, GG)						\
+	a12 = ROTL(A, 12);						\
+	SS1 = _mm256_add_epi32(_mm256_add_epi32(a12, E),		\
+		_mm256_set1_epi32((int)K[j]));				\
+	SS1 = ROTL(SS1, 7);						\
+	SS2 = _mm256_xor_si256(SS1, a12);				\
+	TT1 = _mm256_add_epi32(_mm256_add_epi32(FF(A, B, C), D),	\
+		_mm256_add_epi32(SS2, _mm256_xor_si256(W[j], W[(j) + 4]))); \
+	TT2 = _mm256_add_epi32(_mm256_add_epi32(GG(E, F, G), H),	\
+		_mm256_add_epi32(SS1, W[j]));				\
+	D = C;								\
+	C = ROTL(B, 9);							\
+	B = A;								\
+	A = TT1;							\
+	H = G;								\
+	G = ROTL(F, 19);						\
+	F = E;								\
+	E = P0(TT2)
+
+AVX2_TARGET
+void sm3_avx2_compress_8lanes(uint32_t *digest[8], const unsigned char *block[8])
+{
+	static const unsigned char zero_block[SM3_BLOCK_SIZE];
+	const __m256i bswap = _mm256_setr_epi8(
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+	uint32_t idle[8] = {0};
+	uint32_t *dgst[8];
+	const unsigned char *blk[8];
+	const unsigned char *state[8];
+	__m256i W[68];
+	__m256i A, B, C, D, E, F, G, H;
+	__m256i A0, B0, C0, D0, E0, F0, G0, H0;
+	__m256i SS1, SS2, TT1, TT2, a12;
+	__m256i r0, r1, r2, r3, r4, r5, r6, r7;
+	__m256i t0, t1, t2, t3, t4, t5, t6, t7;
+	int i, j;
+
+	/* idle lanes hash a zero block into a throw-away state */
+	for (i = 0; i < 8; i++) {
+		if (block[i]) {
+			dgst[i] = digest[i];
+			blk[i] = block[i];
+		} else {
+			dgst[i] = idle;
+			blk[i] = zero_block;
+		}
+		state[i] = (const unsigned char *)dgst[i];
+	}
+
+	LOAD8(blk, 0);
+	TRANSPOSE8();
+	W[0] = _mm256_shuffle_epi8(r0, bswap);
+	W[1] = _mm256_shuffle_epi8(r1, bswap);
+	W[2] = _mm256_shuffle_epi8(r2, bswap);
+	W[3] = _mm256_shuffle_epi8(r3, bswap);
+	W[4] = _mm256_shuffle_epi8(r4, bswap);
+	W[5] = _mm256_shuffle_epi8(r5, bswap);
+	W[6] = _mm256_shuffle_epi8(r6, bswap);
+	W[7] = _mm256_shuffle_epi8(r7, bswap);
+	LOAD8(blk, 32);
+	TRANSPOSE8();
+	W[8] = _mm256_shuffle_epi8(r0, bswap);
+	W[9] = _mm256_shuffle_epi8(r1, bswap);
+	W[10] = _mm256_shuffle_epi8(r2, bswap);
+	W[11] = _mm256_shuffle_epi8(r3, bswap);
+	W[12] = _mm256_shuffle_epi8(r4, bswap);
+	W[13] = _mm256_shuffle_epi8(r5, bswap);
+	W[14] = _mm256_shuffle_epi8(r6, bswap);
+	W[15] = _mm256_shuffle_epi8(r7, bswap);
+
+	for (j = 16; j < 68; j++) {
+		t0 = XOR3(W[j - 16], W[j - 9], ROTL(W[j - 3], 15));
+		W[j] = XOR3(P1(t0), ROTL(W[j - 13], 7), W[j - 6]);
+	}
+
+	LOAD8(state, 0);
+	TRANSPOSE8();
+	A = A0 = r0;
+	B = B0 = r1;
+	C = C0 = r2;
+	D = D0 = r3;
+	E = E0 = r4;
+	F = F0 = r5;
+	G = G0 = r6;
+	H = H0 = r7;
+
+	for (j = 0; j < 16; j++) {
+		ROUND(j, XOR3, XOR3);
+	}
+	for (j = 16; j < 64; j++) {
+		ROUND(j, FF1, GG1);
+	}
+
+	r0 = _mm256_xor_si256(A, A0);
+	r1 = _mm256_xor_si256(B, B0);
+	r2 = _mm256_xor_si256(C, C0);
+	r3 = _mm256_xor_si256(D, D0);
+	r4 = _mm256_xor_si256(E, E0);
+	r5 = _mm256_xor_si256(F, F0);
+	r6 = _mm256_xor_si256(G, G0);
+	r7 = _mm256_xor_si256(H, H0);
+	TRANSPOSE8();
+	_mm256_storeu_si256((__m256i *)dgst[0], r0);
+	_mm256_storeu_si256((__m256i *)dgst[1], r1);
+	_mm256_storeu_si256((__m256i *)dgst[2], r2);
+	_mm256_storeu_si256((__m256i *)dgst[3], r3);
+	_mm256_storeu_si256((__m256i *)dgst[4], r4);
+	_mm256_storeu_si256((__m256i *)dgst[5], r5);
+	_mm256_storeu_si256((__m256i *)dgst[6], r6);
+	_mm256_storeu_si256((__m256i *)dgst[7], r7);
+}
+
+#endif /* SM3_AVX2 */
@@ -47,13 +47,61 @@
  * ====================================================================
  */
 
+#include <string.h>
 #include <openssl/sms4.h>
 #include <openssl/modes.h>
+#include <openssl/crypto.h>
+#include "sms4_lcl.h"
+
+/*
+ * ctr128_f keystream generator for CRYPTO_ctr128_encrypt_ctr32() and the
+ * GCM ctr32 functions: only the low 32 bits of the counter are incremented
+ * and the caller advances iv. Counter blocks are encrypted 16 at a time so
+ * that sms4_encrypt_16blocks() and sms4_encrypt_8blocks() can use the
+ * widest kernel the CPU supports.
+ */
+void sms4_ctr32_encrypt_blocks(const unsigned char *in, unsigned char *out,
+	size_t blocks, const sms4_key_t *key, const unsigned char iv[SMS4_BLOCK_SIZE])
+{
+	unsigned char ctr[SMS4_BLOCK_SIZE * 16];
+	unsigned char buf[SMS4_BLOCK_SIZE * 16];
+	uint32_t c = GET32(iv + 12);
+	size_t i, n;
+
+	for (i = 0; i < 16; i++) {
+		memcpy(ctr + SMS4_BLOCK_SIZE * i, iv, 12);
+	}
+
+	while (blocks) {
+		n = blocks < 16 ? blocks : 16;
+		for (i = 0; i < n; i++, c++) {
+			PUT32(c, ctr + SMS4_BLOCK_SIZE * i + 12);
+		}
+		if (n > 8) {
+			sms4_encrypt_16blocks(ctr, buf, key);
+		} else if (n > 2) {
+			sms4_encrypt_8blocks(ctr, buf, key);
+		} else {
+			for (i = 0; i < n; i++) {
+				sms4_encrypt(ctr + SMS4_BLOCK_SIZE * i,
+					buf + SMS4_BLOCK_SIZE * i, key);
+			}
+		}
+		for (i = 0; i < SMS4_BLOCK_SIZE * n; i++) {
+			out[i] = in[i] ^ buf[i];
+		}
+		in += SMS4_BLOCK_SIZE * n;
+		out += SMS4_BLOCK_SIZE * n;
+		blocks -= n;
+	}
+
+	OPENSSL_cleanse(buf, sizeof(buf));
+}
 
 void sms4_ctr128_encrypt(const unsigned char *in, unsigned char *out,
 	size_t len, const sms4_key_t *key, unsigned char *iv,
 	unsigned char ecount_buf[SMS4_BLOCK_SIZE], unsigned int *num)
 {
-	CRYPTO_ctr128_encrypt(in, out, len, key, iv, ecount_buf, num,
-		(block128_f)sms4_encrypt);
+	CRYPTO_ctr128_encrypt_ctr32(in, out, len, key, iv, ecount_buf, num,
+		(ctr128_f)sms4_ctr32_encrypt_blocks);
 }
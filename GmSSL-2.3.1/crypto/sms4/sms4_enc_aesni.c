@@ -0,0 +1,283 @@
+/* ====================================================================
+ * Copyright (c) 2014 - 2018 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+
+
+#include <openssl/sms4.h>
+#include "sms4_lcl.h"
+
+#ifdef SMS4_AESNI
+#include <immintrin.h>
+
+/*
+ * Table-free SMS4 on AES-NI. The SMS4 and AES S-boxes are both affine
+ * transforms of the inversion in GF(2^8), so with an isomorphism between
+ * the two fields the SMS4 S-box becomes
+ *
+ *	S(x) = post(AES_SubBytes(pre(x)))
+ *
+ * where pre() and post() are affine maps, each applied as two PSHUFB
+ * nibble lookups. AESENCLAST with a zero round key does SubBytes after
+ * ShiftRows, the ShiftRows is undone by permuting the bytes beforehand.
+ * The S-box is evaluated without memory lookups, so the kernel runs in
+ * constant time.
+ *
+ * Each register holds the same word of 4 blocks, and two groups of 4
+ * blocks are interleaved to hide the AESENCLAST latency.
+ */
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+
+#define GET_BLKS(x0, x1, x2, x3, in)					\
+	t0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in)), vindex_swap); \
+	t1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+16)), vindex_swap); \
+	t2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+32)), vindex_swap); \
+	t3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+48)), vindex_swap); \
+	TRANSPOSE(x0, x1, x2, x3, t0, t1, t2, t3)
+
+#define PUT_BLKS(out, x0, x1, x2, x3)					\
+	TRANSPOSE(t0, t1, t2, t3, x0, x1, x2, x3);			\
+	_mm_storeu_si128((__m128i *)(out), _mm_shuffle_epi8(t0, vindex_swap)); \
+	_mm_storeu_si128((__m128i *)(out+16), _mm_shuffle_epi8(t1, vindex_swap)); \
+	_mm_storeu_si128((__m128i *)(out+32), _mm_shuffle_epi8(t2, vindex_swap)); \
+	_mm_storeu_si128((__m128i *)(out+48), _mm_shuffle_epi8(t3, vindex_swap))
+
+#define TRANSPOSE(x0, x1, x2, x3, y0, y1, y2, y3)			\
+	t4 = _mm_unpacklo_epi32(y0, y1);				\
+	t5 = _mm_unpackhi_epi32(y0, y1);				\
+	t6 = _mm_unpacklo_epi32(y2, y3);				\
+	t7 = _mm_unpackhi_epi32(y2, y3);				\
+	x0 = _mm_unpacklo_epi64(t4, t6);				\
+	x1 = _mm_unpackhi_epi64(t4, t6);				\
+	x2 = _mm_unpacklo_epi64(t5, t7);				\
+	x3 = _mm_unpackhi_epi64(t5, t7)
+
+#define AFFINE(x, lo, hi)						\
+	_mm_xor_si128(							\
+		_mm_shuffle_epi8(lo, _mm_and_si128(x, mask_0f)),	\
+		_mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi32(x, 4), mask_0f)))
+
+#define S(x)								\
+	x = AFFINE(x, pre_lo, pre_hi);					\
+	x = _mm_shuffle_epi8(x, vindex_inv_shift_row);			\
+	x = _mm_aesenclast_si128(x, zero);				\
+	x = AFFINE(x, post_lo, post_hi)
+
+/* x ^ (x <<< 2) ^ (x <<< 10) ^ (x <<< 18) ^ (x <<< 24) */
+#define L(x, t)								\
+	t = _mm_xor_si128(x, _mm_shuffle_epi8(x, vindex_rol8));		\
+	t = _mm_xor_si128(t, _mm_shuffle_epi8(x, vindex_rol16));	\
+	t = _mm_xor_si128(_mm_slli_epi32(t, 2), _mm_srli_epi32(t, 30));	\
+	t = _mm_xor_si128(t, _mm_shuffle_epi8(x, vindex_rol24));	\
+	x = _mm_xor_si128(x, t)
+
+#define ROUND(x0, x1, x2, x3, x4, i)					\
+	t0 = _mm_set1_epi32(rk[i]);					\
+	a = _mm_xor_si128(_mm_xor_si128(x1[0], x2[0]), _mm_xor_si128(x3[0], t0)); \
+	b = _mm_xor_si128(_mm_xor_si128(x1[1], x2[1]), _mm_xor_si128(x3[1], t0)); \
+	S(a);								\
+	S(b);								\
+	L(a, t1);							\
+	L(b, t2);							\
+	x4[0] = _mm_xor_si128(x0[0], a);				\
+	x4[1] = _mm_xor_si128(x0[1], b)
+
+AESNI_TARGET
+void sms4_aesni_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
+{
+	const int *rk = (int *)key->rk;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask_0f = _mm_set1_epi8(0x0f);
+	const __m128i pre_lo = _mm_setr_epi8(
+		0x3e, 0xb2, 0x0e, 0x82, 0xbb, 0x37, 0x8b, 0x07,
+		0xa1, 0x2d, 0x91, 0x1d, 0x24, 0xa8, 0x14, 0x98);
+	const __m128i pre_hi = _mm_setr_epi8(
+		0x00, 0xdc, 0x2e, 0xf2, 0xc5, 0x19, 0xeb, 0x37,
+		0x08, 0xd4, 0x26, 0xfa, 0xcd, 0x11, 0xe3, 0x3f);
+	const __m128i post_lo = _mm_setr_epi8(
+		0x6c, 0xd4, 0xa6, 0x1e, 0x52, 0xea, 0x98, 0x20,
+		0x0b, 0xb3, 0xc1, 0x79, 0x35, 0x8d, 0xff, 0x47);
+	const __m128i post_hi = _mm_setr_epi8(
+		0x00, 0xe0, 0x50, 0xb0, 0x9d, 0x7d, 0xcd, 0x2d,
+		0xc0, 0x20, 0x90, 0x70, 0x5d, 0xbd, 0x0d, 0xed);
+	const __m128i vindex_inv_shift_row = _mm_setr_epi8(
+		0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+	const __m128i vindex_swap = _mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i vindex_rol8 = _mm_setr_epi8(
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+	const __m128i vindex_rol16 = _mm_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m128i vindex_rol24 = _mm_setr_epi8(
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	__m128i x0[2], x1[2], x2[2], x3[2], x4[2];
+	__m128i t0, t1, t2, t3, t4, t5, t6, t7;
+	__m128i a, b;
+
+	GET_BLKS(x0[0], x1[0], x2[0], x3[0], in);
+	GET_BLKS(x0[1], x1[1], x2[1], x3[1], in + 16*4);
+	ROUNDS(x0, x1, x2, x3, x4);
+	PUT_BLKS(out, x0[0], x4[0], x3[0], x2[0]);
+	PUT_BLKS(out + 16*4, x0[1], x4[1], x3[1], x2[1]);
+}
+
+/*
+ * The same kernel on 256-bit registers for 16 blocks. Each 128-bit lane is
+ * laid out like the SSE kernel so no cross-lane shuffles are needed, only
+ * AESENCLAST is done per lane as VAES cannot be assumed with AVX2.
+ */
+#define AESNI_AVX2_TARGET __attribute__((target("aes,avx2")))
+
+#define GET_BLKS_256(x0, x1, x2, x3, in)				\
+	t0 = LOAD2(in, in+64);						\
+	t1 = LOAD2(in+16, in+80);					\
+	t2 = LOAD2(in+32, in+96);					\
+	t3 = LOAD2(in+48, in+112);					\
+	TRANSPOSE_256(x0, x1, x2, x3, t0, t1, t2, t3)
+
+#define PUT_BLKS_256(out, x0, x1, x2, x3)				\
+	TRANSPOSE_256(t0, t1, t2, t3, x0, x1, x2, x3);			\
+	STORE2(out, out+64, t0);					\
+	STORE2(out+16, out+80, t1);					\
+	STORE2(out+32, out+96, t2);					\
+	STORE2(out+48, out+112, t3)
+
+#define LOAD2(lo, hi)							\
+	_mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256( \
+		_mm_loadu_si128((const __m128i *)(lo))),		\
+		_mm_loadu_si128((const __m128i *)(hi)), 1), vindex_swap)
+
+#define STORE2(lo, hi, x)						\
+	x = _mm256_shuffle_epi8(x, vindex_swap);			\
+	_mm_storeu_si128((__m128i *)(lo), _mm256_castsi256_si128(x));	\
+	_mm_storeu_si128((__m128i *)(hi), _mm256_extracti128_si256(x, 1))
+
+#define TRANSPOSE_256(x0, x1, x2, x3, y0, y1, y2, y3)			\
+	t4 = _mm256_unpacklo_epi32(y0, y1);				\
+	t5 = _mm256_unpackhi_epi32(y0, y1);				\
+	t6 = _mm256_unpacklo_epi32(y2, y3);				\
+	t7 = _mm256_unpackhi_epi32(y2, y3);				\
+	x0 = _mm256_unpacklo_epi64(t4, t6);				\
+	x1 = _mm256_unpackhi_epi64(t4, t6);				\
+	x2 = _mm256_unpacklo_epi64(t5, t7);				\
+	x3 = _mm256_unpackhi_epi64(t5, t7)
+
+#define AFFINE_256(x, lo, hi)						\
+	_mm256_xor_si256(						\
+		_mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask_0f)),	\
+		_mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi32(x, 4), mask_0f)))
+
+#define S_256(x)							\
+	x = AFFINE_256(x, pre_lo, pre_hi);				\
+	x = _mm256_shuffle_epi8(x, vindex_inv_shift_row);		\
+	x = _mm256_inserti128_si256(_mm256_castsi128_si256(		\
+		_mm_aesenclast_si128(_mm256_castsi256_si128(x), zero)),	\
+		_mm_aesenclast_si128(_mm256_extracti128_si256(x, 1), zero), 1); \
+	x = AFFINE_256(x, post_lo, post_hi)
+
+#define L_256(x, t)							\
+	t = _mm256_xor_si256(x, _mm256_shuffle_epi8(x, vindex_rol8));	\
+	t = _mm256_xor_si256(t, _mm256_shuffle_epi8(x, vindex_rol16));	\
+	t = _mm256_xor_si256(_mm256_slli_epi32(t, 2), _mm256_srli_epi32(t, 30)); \
+	t = _mm256_xor_si256(t, _mm256_shuffle_epi8(x, vindex_rol24));	\
+	x = _mm256_xor_si256(x, t)
+
+#undef ROUND
+#define ROUND(x0, x1, x2, x3, x4, i)					\
+	t0 = _mm256_set1_epi32(rk[i]);					\
+	a = _mm256_xor_si256(_mm256_xor_si256(x1[0], x2[0]), _mm256_xor_si256(x3[0], t0)); \
+	b = _mm256_xor_si256(_mm256_xor_si256(x1[1], x2[1]), _mm256_xor_si256(x3[1], t0)); \
+	S_256(a);							\
+	S_256(b);							\
+	L_256(a, t1);							\
+	L_256(b, t2);							\
+	x4[0] = _mm256_xor_si256(x0[0], a);				\
+	x4[1] = _mm256_xor_si256(x0[1], b)
+
+#define BCAST(x)	_mm256_broadcastsi128_si256(x)
+
+AESNI_AVX2_TARGET
+void sms4_aesni_avx2_encrypt_16blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
+{
+	const int *rk = (int *)key->rk;
+	const __m128i zero = _mm_setzero_si128();
+	const __m256i mask_0f = _mm256_set1_epi8(0x0f);
+	const __m256i pre_lo = BCAST(_mm_setr_epi8(
+		0x3e, 0xb2, 0x0e, 0x82, 0xbb, 0x37, 0x8b, 0x07,
+		0xa1, 0x2d, 0x91, 0x1d, 0x24, 0xa8, 0x14, 0x98));
+	const __m256i pre_hi = BCAST(_mm_setr_epi8(
+		0x00, 0xdc, 0x2e, 0xf2, 0xc5, 0x19, 0xeb, 0x37,
+		0x08, 0xd4, 0x26, 0xfa, 0xcd, 0x11, 0xe3, 0x3f));
+	const __m256i post_lo = BCAST(_mm_setr_epi8(
+		0x6c, 0xd4, 0xa6, 0x1e, 0x52, 0xea, 0x98, 0x20,
+		0x0b, 0xb3, 0xc1, 0x79, 0x35, 0x8d, 0xff, 0x47));
+	const __m256i post_hi = BCAST(_mm_setr_epi8(
+		0x00, 0xe0, 0x50, 0xb0, 0x9d, 0x7d, 0xcd, 0x2d,
+		0xc0, 0x20, 0x90, 0x70, 0x5d, 0xbd, 0x0d, 0xed));
+	const __m256i vindex_inv_shift_row = BCAST(_mm_setr_epi8(
+		0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3));
+	const __m256i vindex_swap = BCAST(_mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+	const __m256i vindex_rol8 = BCAST(_mm_setr_epi8(
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+	const __m256i vindex_rol16 = BCAST(_mm_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+	const __m256i vindex_rol24 = BCAST(_mm_setr_epi8(
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+	__m256i x0[2], x1[2], x2[2], x3[2], x4[2];
+	__m256i t0, t1, t2, t3, t4, t5, t6, t7;
+	__m256i a, b;
+
+	GET_BLKS_256(x0[0], x1[0], x2[0], x3[0], in);
+	GET_BLKS_256(x0[1], x1[1], x2[1], x3[1], in + 16*8);
+	ROUNDS(x0, x1, x2, x3, x4);
+	PUT_BLKS_256(out, x0[0], x4[0], x3[0], x2[0]);
+	PUT_BLKS_256(out + 16*8, x0[1], x4[1], x3[1], x2[1]);
+}
+
+#endif /* SMS4_AESNI */
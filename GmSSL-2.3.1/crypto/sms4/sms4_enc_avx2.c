@@ -48,28 +48,25 @@
  */
 
 
-#include <immintrin.h>
 #include <openssl/sms4.h>
+#include <openssl/crypto.h>
 #include "sms4_lcl.h"
 
-static __m256i mask_ffff;
-static __m256i vindex_0s;
-static __m256i vindex_4i;
-static __m256i vindex_swap;
-static __m256i vindex_read;
+#ifdef SMS4_AVX2
+#include <immintrin.h>
+
+/*
+ * The kernel is compiled with the avx2 target attribute so that the rest
+ * of libcrypto can still be built for the baseline ISA, the caller is
+ * responsible for checking SMS4_AVX2_CAPABLE before calling it.
+ */
+#define AVX2_TARGET __attribute__((target("avx2")))
 
+static CRYPTO_ONCE sms4_avx2_once = CRYPTO_ONCE_STATIC_INIT;
 
 void sms4_avx2_encrypt_init(sms4_key_t *key)
 {
-	mask_ffff = _mm256_set1_epi32(0xffff);
-	vindex_0s = _mm256_set1_epi32(0);
-	vindex_4i = _mm256_setr_epi32(0,4,8,12,16,20,24,28);
-	vindex_read = _mm256_setr_epi32(0,8,16,24,1,9,17,25);
-	vindex_swap = _mm256_setr_epi8(
-		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
-		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
-	);
-	sms4_init_sbox32();
+	CRYPTO_THREAD_run_once(&sms4_avx2_once, sms4_init_sbox32);
 }
 
 #define GET_BLKS(x0, x1, x2, x3, in)					\
@@ -82,29 +79,30 @@ void sms4_avx2_encrypt_init(sms4_key_t *key)
 	x2 = _mm256_shuffle_epi8(t2, vindex_swap);			\
 	x3 = _mm256_shuffle_epi8(t3, vindex_swap)
 
+/* transpose the 4 word-sliced registers back into 8 consecutive blocks */
 #define PUT_BLKS(out, x0, x1, x2, x3)					\
-	t0 = _mm256_shuffle_epi8(x0, vindex_swap);			\
-	t1 = _mm256_shuffle_epi8(x1, vindex_swap);			\
-	t2 = _mm256_shuffle_epi8(x2, vindex_swap);			\
-	t3 = _mm256_shuffle_epi8(x3, vindex_swap);			\
-	_mm256_storeu_si256((__m256i *)(out+32*0), t0);			\
-	_mm256_storeu_si256((__m256i *)(out+32*1), t1);			\
-	_mm256_storeu_si256((__m256i *)(out+32*2), t2);			\
-	_mm256_storeu_si256((__m256i *)(out+32*3), t3);			\
-	x0 = _mm256_i32gather_epi32((int *)(in+32*0), vindex_read, 4);	\
-	x1 = _mm256_i32gather_epi32((int *)(in+32*1), vindex_read, 4);	\
-	x2 = _mm256_i32gather_epi32((int *)(in+32*2), vindex_read, 4);	\
-	x3 = _mm256_i32gather_epi32((int *)(in+32*3), vindex_read, 4);	\
-	_mm256_storeu_si256((__m256i *)(out+2*0), x0);			\
-	_mm256_storeu_si256((__m256i *)(out+2*1), x1);			\
-	_mm256_storeu_si256((__m256i *)(out+2*2), x2);			\
-	_mm256_storeu_si256((__m256i *)(out+2*3), x3)
+	t0 = _mm256_unpacklo_epi32(x0, x1);				\
+	t1 = _mm256_unpackhi_epi32(x0, x1);				\
+	t2 = _mm256_unpacklo_epi32(x2, x3);				\
+	t3 = _mm256_unpackhi_epi32(x2, x3);				\
+	x0 = _mm256_unpacklo_epi64(t0, t2);				\
+	x1 = _mm256_unpackhi_epi64(t0, t2);				\
+	x2 = _mm256_unpacklo_epi64(t1, t3);				\
+	x3 = _mm256_unpackhi_epi64(t1, t3);				\
+	t0 = _mm256_permute2x128_si256(x0, x1, 0x20);			\
+	t1 = _mm256_permute2x128_si256(x2, x3, 0x20);			\
+	t2 = _mm256_permute2x128_si256(x0, x1, 0x31);			\
+	t3 = _mm256_permute2x128_si256(x2, x3, 0x31);			\
+	_mm256_storeu_si256((__m256i *)(out+32*0), _mm256_shuffle_epi8(t0, vindex_swap)); \
+	_mm256_storeu_si256((__m256i *)(out+32*1), _mm256_shuffle_epi8(t1, vindex_swap)); \
+	_mm256_storeu_si256((__m256i *)(out+32*2), _mm256_shuffle_epi8(t2, vindex_swap)); \
+	_mm256_storeu_si256((__m256i *)(out+32*3), _mm256_shuffle_epi8(t3, vindex_swap))
 
 #define S(x0, t0, t1, t2)					\
 	t0 = _mm256_and_si256(x0, mask_ffff);			\
-	t1 = _mm256_i32gather_epi32(SBOX32L, t0, 4);		\
+	t1 = _mm256_i32gather_epi32((int *)SBOX32L, t0, 4);	\
 	t0 = _mm256_srli_epi32(x0, 16);				\
-	t2 = _mm256_i32gather_epi32(SBOX32H, t0, 4);		\
+	t2 = _mm256_i32gather_epi32((int *)SBOX32H, t0, 4);	\
 	x0 = _mm256_xor_si256(t1, t2)
 
 #define ROT(r0, x0, i, t0, t1)					\
@@ -123,7 +121,7 @@ void sms4_avx2_encrypt_init(sms4_key_t *key)
 	x0 = _mm256_xor_si256(t2, t4)
 
 #define ROUND(x0, x1, x2, x3, x4, i)				\
-	t0 = _mm256_i32gather_epi32(rk+i, vindex_0s, 4);	\
+	t0 = _mm256_set1_epi32(rk[i]);				\
 	t1 = _mm256_xor_si256(x1, x2);				\
 	t2 = _mm256_xor_si256(x3, t0);				\
 	t0 = _mm256_xor_si256(t1, t2);				\
@@ -132,18 +130,29 @@ void sms4_avx2_encrypt_init(sms4_key_t *key)
 	x4 = _mm256_xor_si256(x0, t0);
 
 
+AVX2_TARGET
 void sms4_avx2_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
 {
 	const int *rk = (int *)key->rk;
+	const __m256i mask_ffff = _mm256_set1_epi32(0xffff);
+	const __m256i vindex_4i = _mm256_setr_epi32(0,4,8,12,16,20,24,28);
+	const __m256i vindex_swap = _mm256_setr_epi8(
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+		3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
+	);
 	__m256i x0, x1, x2, x3, x4;
 	__m256i t0, t1, t2, t3, t4;
+
 	GET_BLKS(x0, x1, x2, x3, in);
 	ROUNDS(x0, x1, x2, x3, x4);
 	PUT_BLKS(out, x0, x4, x3, x2);
 }
 
+AVX2_TARGET
 void sms4_avx2_encrypt_16blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
 {
-	sms4_encrypt_8blocks(key, in, out);
-	sms4_encrypt_8blocks(key, in + 16*8, out + 16*8);
+	sms4_avx2_encrypt_8blocks(in, out, key);
+	sms4_avx2_encrypt_8blocks(in + 16*8, out + 16*8, key);
 }
+
+#endif /* SMS4_AVX2 */
@@ -49,12 +49,18 @@
 
 
 #include <openssl/sms4.h>
+#include "sms4_lcl.h"
 
 void sms4_encrypt_init(sms4_key_t *key)
 {
+#ifdef SMS4_AVX2
+	if (SMS4_AVX2_CAPABLE)
+		sms4_avx2_encrypt_init(key);
+#endif
 }
 
-void sms4_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
+static void sms4_generic_encrypt_8blocks(const unsigned char *in,
+	unsigned char *out, const sms4_key_t *key)
 {
 	sms4_encrypt(in, out, key);
 	sms4_encrypt(in + 16, out + 16, key);
@@ -66,8 +72,37 @@ void sms4_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms
 	sms4_encrypt(in + 16 * 7, out + 16 * 7, key);
 }
 
+/*
+ * The AVX2 kernel is picked at runtime from the cpuid capability vector,
+ * so the same libcrypto runs on hosts with and without AVX2. Its tables
+ * are set up by sms4_encrypt_init(), called once with the key schedule,
+ * not here for every 8 blocks.
+ */
+void sms4_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
+{
+#ifdef SMS4_AESNI
+	if (SMS4_AESNI_CAPABLE) {
+		sms4_aesni_encrypt_8blocks(in, out, key);
+		return;
+	}
+#endif
+#ifdef SMS4_AVX2
+	if (SMS4_AVX2_CAPABLE) {
+		sms4_avx2_encrypt_8blocks(in, out, key);
+		return;
+	}
+#endif
+	sms4_generic_encrypt_8blocks(in, out, key);
+}
+
 void sms4_encrypt_16blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key)
 {
+#if defined(SMS4_AESNI) && defined(SMS4_AVX2)
+	if (SMS4_AESNI_CAPABLE && SMS4_AVX2_CAPABLE) {
+		sms4_aesni_avx2_encrypt_16blocks(in, out, key);
+		return;
+	}
+#endif
 	sms4_encrypt_8blocks(in, out, key);
 	sms4_encrypt_8blocks(in + 16 * 8, out + 16 * 8, key);
 }
@@ -51,6 +51,7 @@
 #define HEADER_SMS4_LCL_H
 
 #include <openssl/e_os2.h>
+#include <openssl/sms4.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -118,6 +119,35 @@ extern uint32_t SBOX32H[256 * 256];
 
 void sms4_init_sbox32(void);
 
+/*
+ * x86_64 kernels, only built with a compiler that supports per-function
+ * target attributes. The AVX2 kernels are in sms4_enc_avx2.c.
+ */
+#if !defined(OPENSSL_NO_ASM) && defined(OPENSSL_CPUID_OBJ) && \
+	(defined(__x86_64) || defined(__x86_64__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && \
+	(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+# define SMS4_AVX2
+extern unsigned int OPENSSL_ia32cap_P[];
+# define SMS4_AVX2_CAPABLE	(OPENSSL_ia32cap_P[2] & (1 << 5))
+
+void sms4_avx2_encrypt_init(sms4_key_t *key);
+void sms4_avx2_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key);
+void sms4_avx2_encrypt_16blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key);
+
+/*
+ * Table-free AES-NI kernels in sms4_enc_aesni.c, they need AES-NI for the
+ * S-box and SSSE3 for the byte shuffles, the 16-block one also AVX2.
+ */
+# define SMS4_AESNI
+# define SMS4_AESNI_CAPABLE						\
+	((OPENSSL_ia32cap_P[1] & ((1 << (57 - 32)) | (1 << (41 - 32)))) ==	\
+		((1 << (57 - 32)) | (1 << (41 - 32))))
+
+void sms4_aesni_encrypt_8blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key);
+void sms4_aesni_avx2_encrypt_16blocks(const unsigned char *in, unsigned char *out, const sms4_key_t *key);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -96,6 +96,8 @@ void sms4_set_encrypt_key(sms4_key_t *key, const unsigned char *user_key)
 	ROUNDS(x0, x1, x2, x3, x4);
 
 	x0 = x1 = x2 = x3 = x4 = 0;
+
+	sms4_encrypt_init(key);
 }
 
 void sms4_set_decrypt_key(sms4_key_t *key, const unsigned char *user_key)
@@ -113,4 +115,6 @@ void sms4_set_decrypt_key(sms4_key_t *key, const unsigned char *user_key)
 	ROUNDS(x0, x1, x2, x3, x4);
 
 	x0 = x1 = x2 = x3 = x4 = 0;
+
+	sms4_encrypt_init(key);
 }
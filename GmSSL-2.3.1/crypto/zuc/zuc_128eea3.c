@@ -47,23 +47,83 @@
  * ====================================================================
  */
 
+#include <string.h>
 #include <openssl/zuc.h>
+#include <openssl/crypto.h>
+
+#define GETU32(p)				\
+	((uint32_t)(p)[0] << 24 |		\
+	 (uint32_t)(p)[1] << 16 |		\
+	 (uint32_t)(p)[2] <<  8 |		\
+	 (uint32_t)(p)[3])
+
+#define PUTU32(p,v)				\
+	((p)[0] = (uint8_t)((v) >> 24),		\
+	 (p)[1] = (uint8_t)((v) >> 16),		\
+	 (p)[2] = (uint8_t)((v) >>  8),		\
+	 (p)[3] = (uint8_t)(v))
+
+/* keystream words generated per ZUC_generate_keystream() call */
+#define ZUC_128EEA3_CHUNK_WORDS	64
 
 void ZUC_128eea3_set_key(ZUC_128EEA3 *ctx, const unsigned char user_key[16],
 	ZUC_UINT32 count, ZUC_UINT5 bearer, ZUC_UINT1 direction)
 {
-	//TODO
+	unsigned char iv[16];
+
+	PUTU32(iv, count);
+	iv[4] = (unsigned char)(((bearer << 3) | ((direction & 1) << 2)) & 0xfc);
+	iv[5] = iv[6] = iv[7] = 0;
+	memcpy(iv + 8, iv, 8);
+
+	ZUC_set_key(&ctx->ks, user_key, iv);
 }
 
+/*
+ * The message is processed in bytes; the keystream words are used in big
+ * endian order, so the result is 128-EEA3 with LENGTH = 8 * len. Only one
+ * message can be encrypted after each ZUC_128eea3_set_key().
+ */
 void ZUC_128eea3_encrypt(ZUC_128EEA3 *ctx, size_t len,
 	const unsigned char *in, unsigned char *out)
 {
-	//TODO
+	uint32_t z[ZUC_128EEA3_CHUNK_WORDS];
+	unsigned char tail[4];
+	size_t nwords, i;
+
+	while (len >= 4) {
+		nwords = len / 4;
+		if (nwords > ZUC_128EEA3_CHUNK_WORDS) {
+			nwords = ZUC_128EEA3_CHUNK_WORDS;
+		}
+		ZUC_generate_keystream(&ctx->ks, nwords, z);
+		for (i = 0; i < nwords; i++) {
+			uint32_t w = GETU32(in) ^ z[i];
+			PUTU32(out, w);
+			in += 4;
+			out += 4;
+		}
+		len -= nwords * 4;
+	}
+
+	if (len > 0) {
+		uint32_t w = ZUC_generate_keyword(&ctx->ks);
+		PUTU32(tail, w);
+		for (i = 0; i < len; i++) {
+			out[i] = in[i] ^ tail[i];
+		}
+		OPENSSL_cleanse(tail, sizeof(tail));
+	}
+	OPENSSL_cleanse(z, sizeof(z));
 }
 
 void ZUC_128eea3(const unsigned char key[ZUC_KEY_LENGTH],
 	ZUC_UINT32 count, ZUC_UINT5 bearer, ZUC_UINT1 direction,
 	size_t len, const unsigned char *in, unsigned char *out)
 {
-	//TODO
+	ZUC_128EEA3 ctx;
+
+	ZUC_128eea3_set_key(&ctx, key, count, bearer, direction);
+	ZUC_128eea3_encrypt(&ctx, len, in, out);
+	OPENSSL_cleanse(&ctx, sizeof(ctx));
 }
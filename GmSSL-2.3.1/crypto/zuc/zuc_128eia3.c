@@ -47,28 +47,126 @@
  * ====================================================================
  */
 
+#include <string.h>
 #include <openssl/zuc.h>
+#include <openssl/crypto.h>
+
+#define GETU32(p)				\
+	((uint32_t)(p)[0] << 24 |		\
+	 (uint32_t)(p)[1] << 16 |		\
+	 (uint32_t)(p)[2] <<  8 |		\
+	 (uint32_t)(p)[3])
+
+#define PUTU32(p,v)				\
+	((p)[0] = (uint8_t)((v) >> 24),		\
+	 (p)[1] = (uint8_t)((v) >> 16),		\
+	 (p)[2] = (uint8_t)((v) >>  8),		\
+	 (p)[3] = (uint8_t)(v))
 
 void ZUC_128eia3_set_key(ZUC_128EIA3 *ctx, const unsigned char *user_key,
 	ZUC_UINT32 count, ZUC_UINT5 bearer, ZUC_UINT1 direction)
 {
-	//TODO
+	unsigned char iv[16];
+
+	PUTU32(iv, count);
+	iv[4] = (unsigned char)((bearer << 3) & 0xf8);
+	iv[5] = iv[6] = iv[7] = 0;
+	PUTU32(iv + 8, count);
+	iv[8] ^= (unsigned char)((direction & 1) << 7);
+	iv[12] = iv[4];
+	iv[13] = iv[5];
+	iv[14] = (unsigned char)((direction & 1) << 7);
+	iv[15] = iv[7];
+
+	ZUC_set_key(&ctx->ks, user_key, iv);
+	ctx->T = 0;
+	ctx->z[0] = ZUC_generate_keyword(&ctx->ks);
+	ctx->z[1] = ZUC_generate_keyword(&ctx->ks);
+	ctx->num = 0;
+}
+
+/*
+ * Bit i of the message (counting from the most significant bit of the
+ * first byte) adds the keystream word starting at bit i to T. The two
+ * keystream words in ctx->z cover every bit of the current message word,
+ * so T is accumulated one 32-bit message word at a time. The bits are
+ * applied through a mask so the timing does not depend on the message.
+ */
+static uint32_t eia3_word(uint32_t T, uint32_t m, const uint32_t z[2])
+{
+	uint64_t k = ((uint64_t)z[0] << 32) | z[1];
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		T ^= (uint32_t)(k >> (32 - i)) & (0U - ((m >> (31 - i)) & 1));
+	}
+	return T;
 }
 
 void ZUC_128eia3_update(ZUC_128EIA3 *ctx, const unsigned char *data,
 	size_t datalen)
 {
-	//TODO
+	if (ctx->num) {
+		size_t left = 4 - ctx->num;
+
+		if (datalen < left) {
+			memcpy(ctx->buf + ctx->num, data, datalen);
+			ctx->num += datalen;
+			return;
+		}
+		memcpy(ctx->buf + ctx->num, data, left);
+		ctx->T = eia3_word(ctx->T, GETU32(ctx->buf), ctx->z);
+		ctx->z[0] = ctx->z[1];
+		ctx->z[1] = ZUC_generate_keyword(&ctx->ks);
+		data += left;
+		datalen -= left;
+		ctx->num = 0;
+	}
+
+	while (datalen >= 4) {
+		ctx->T = eia3_word(ctx->T, GETU32(data), ctx->z);
+		ctx->z[0] = ctx->z[1];
+		ctx->z[1] = ZUC_generate_keyword(&ctx->ks);
+		data += 4;
+		datalen -= 4;
+	}
+
+	if (datalen) {
+		memcpy(ctx->buf, data, datalen);
+		ctx->num = datalen;
+	}
 }
 
+/*
+ * With LENGTH = 32 * w + r message bits, T is finished with the keystream
+ * word at bit LENGTH and masked with keystream word z[w + 1] when r == 0,
+ * or z[w + 2] otherwise.
+ */
 void ZUC_128eia3_final(ZUC_128EIA3 *ctx, uint32_t *mac)
 {
-	//TODO
+	uint32_t T = ctx->T;
+	int r = (int)ctx->num * 8;
+
+	if (r) {
+		memset(ctx->buf + ctx->num, 0, 4 - ctx->num);
+		T = eia3_word(T, GETU32(ctx->buf), ctx->z);
+		T ^= (ctx->z[0] << r) | (ctx->z[1] >> (32 - r));
+		T ^= ZUC_generate_keyword(&ctx->ks);
+	} else {
+		T ^= ctx->z[0];
+		T ^= ctx->z[1];
+	}
+	*mac = T;
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
 }
 
 void ZUC_128eia3(const unsigned char key[ZUC_KEY_LENGTH],
 	ZUC_UINT32 count, ZUC_UINT5 bearer, ZUC_UINT1 direction,
 	const unsigned char *data, size_t dlen, uint32_t *mac)
 {
-	//TODO
+	ZUC_128EIA3 ctx;
+
+	ZUC_128eia3_set_key(&ctx, key, count, bearer, direction);
+	ZUC_128eia3_update(&ctx, data, dlen);
+	ZUC_128eia3_final(&ctx, mac);
 }
@@ -0,0 +1,131 @@
+/* ====================================================================
+ * Copyright (c) 2015 - 2018 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#include <openssl/zuc.h>
+#include "zuc_lcl.h"
+
+/*
+ * Generate nwords words for every lane with a non-NULL key. The AVX2
+ * kernel is picked at runtime from the cpuid capability vector, otherwise
+ * the lanes are run one after the other.
+ */
+static void zuc_generate_keystream_8lanes(ZUC_KEY *key[ZUC_MB_LANES],
+	size_t nwords, uint32_t *words[ZUC_MB_LANES])
+{
+	int i;
+
+#ifdef ZUC_AVX2
+	if (ZUC_AVX2_CAPABLE) {
+		zuc_avx2_generate_keystream_8lanes(key, nwords, words);
+		return;
+	}
+#endif
+	for (i = 0; i < ZUC_MB_LANES; i++) {
+		if (key[i]) {
+			ZUC_generate_keystream(key[i], nwords, words[i]);
+		}
+	}
+}
+
+/*
+ * Each group of up to ZUC_MB_LANES streams is advanced by the shortest
+ * remaining length of its lanes, then the finished lanes drop out, so
+ * every lane ends exactly nwords[i] words further, as with
+ * ZUC_generate_keystream().
+ */
+void ZUC_generate_keystream_mb(ZUC_KEY *key[], const size_t nwords[],
+	uint32_t *words[], size_t num)
+{
+	ZUC_KEY *lane_key[ZUC_MB_LANES];
+	uint32_t *lane_words[ZUC_MB_LANES];
+	size_t left[ZUC_MB_LANES];
+	size_t i, n, step;
+
+	for (; num > 0; num -= n) {
+		n = num < ZUC_MB_LANES ? num : ZUC_MB_LANES;
+
+		for (i = 0; i < ZUC_MB_LANES; i++) {
+			lane_key[i] = NULL;
+			lane_words[i] = NULL;
+			left[i] = 0;
+			if (i < n && nwords[i] > 0) {
+				lane_key[i] = key[i];
+				lane_words[i] = words[i];
+				left[i] = nwords[i];
+			}
+		}
+
+		for (;;) {
+			step = 0;
+			for (i = 0; i < ZUC_MB_LANES; i++) {
+				if (lane_key[i] && (!step || left[i] < step)) {
+					step = left[i];
+				}
+			}
+			if (!step) {
+				break;
+			}
+
+			zuc_generate_keystream_8lanes(lane_key, step, lane_words);
+
+			for (i = 0; i < ZUC_MB_LANES; i++) {
+				if (lane_key[i]) {
+					lane_words[i] += step;
+					if (!(left[i] -= step)) {
+						lane_key[i] = NULL;
+					}
+				}
+			}
+		}
+
+		key += n;
+		nwords += n;
+		words += n;
+	}
+}
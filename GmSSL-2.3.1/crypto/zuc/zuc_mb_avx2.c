@@ -0,0 +1,279 @@
+/* ====================================================================
+ * Copyright (c) 2015 - 2018 The GmSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the GmSSL Project.
+ *    (http://gmssl.org/)"
+ *
+ * 4. The name "GmSSL Project" must not be used to endorse or promote
+ *    products derived from this software without prior written
+ *    permission. For written permission, please contact
+ *    guanzhi1980@gmail.com.
+ *
+ * 5. Products derived from this software may not be called "GmSSL"
+ *    nor may "GmSSL" appear in their names without prior written
+ *    permission of the GmSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the GmSSL Project
+ *    (http://gmssl.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE GmSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE GmSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#include <string.h>
+#include <openssl/zuc.h>
+#include <openssl/crypto.h>
+#include "zuc_lcl.h"
+
+#ifdef ZUC_AVX2
+#include <immintrin.h>
+
+/*
+ * Eight independent ZUC streams, lane i of every register holds the LFSR
+ * cell, R1 or R2 of key[i]. The S-boxes are looked up with gathers from
+ * 32-bit copies of the tables in zuc_core.c. The function is compiled
+ * with the avx2 target attribute, the caller is responsible for checking
+ * ZUC_AVX2_CAPABLE before calling it.
+ */
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static const uint32_t S0_32[256] = {
+	0x3e,0x72,0x5b,0x47,0xca,0xe0,0x00,0x33,
+	0x04,0xd1,0x54,0x98,0x09,0xb9,0x6d,0xcb,
+	0x7b,0x1b,0xf9,0x32,0xaf,0x9d,0x6a,0xa5,
+	0xb8,0x2d,0xfc,0x1d,0x08,0x53,0x03,0x90,
+	0x4d,0x4e,0x84,0x99,0xe4,0xce,0xd9,0x91,
+	0xdd,0xb6,0x85,0x48,0x8b,0x29,0x6e,0xac,
+	0xcd,0xc1,0xf8,0x1e,0x73,0x43,0x69,0xc6,
+	0xb5,0xbd,0xfd,0x39,0x63,0x20,0xd4,0x38,
+	0x76,0x7d,0xb2,0xa7,0xcf,0xed,0x57,0xc5,
+	0xf3,0x2c,0xbb,0x14,0x21,0x06,0x55,0x9b,
+	0xe3,0xef,0x5e,0x31,0x4f,0x7f,0x5a,0xa4,
+	0x0d,0x82,0x51,0x49,0x5f,0xba,0x58,0x1c,
+	0x4a,0x16,0xd5,0x17,0xa8,0x92,0x24,0x1f,
+	0x8c,0xff,0xd8,0xae,0x2e,0x01,0xd3,0xad,
+	0x3b,0x4b,0xda,0x46,0xeb,0xc9,0xde,0x9a,
+	0x8f,0x87,0xd7,0x3a,0x80,0x6f,0x2f,0xc8,
+	0xb1,0xb4,0x37,0xf7,0x0a,0x22,0x13,0x28,
+	0x7c,0xcc,0x3c,0x89,0xc7,0xc3,0x96,0x56,
+	0x07,0xbf,0x7e,0xf0,0x0b,0x2b,0x97,0x52,
+	0x35,0x41,0x79,0x61,0xa6,0x4c,0x10,0xfe,
+	0xbc,0x26,0x95,0x88,0x8a,0xb0,0xa3,0xfb,
+	0xc0,0x18,0x94,0xf2,0xe1,0xe5,0xe9,0x5d,
+	0xd0,0xdc,0x11,0x66,0x64,0x5c,0xec,0x59,
+	0x42,0x75,0x12,0xf5,0x74,0x9c,0xaa,0x23,
+	0x0e,0x86,0xab,0xbe,0x2a,0x02,0xe7,0x67,
+	0xe6,0x44,0xa2,0x6c,0xc2,0x93,0x9f,0xf1,
+	0xf6,0xfa,0x36,0xd2,0x50,0x68,0x9e,0x62,
+	0x71,0x15,0x3d,0xd6,0x40,0xc4,0xe2,0x0f,
+	0x8e,0x83,0x77,0x6b,0x25,0x05,0x3f,0x0c,
+	0x30,0xea,0x70,0xb7,0xa1,0xe8,0xa9,0x65,
+	0x8d,0x27,0x1a,0xdb,0x81,0xb3,0xa0,0xf4,
+	0x45,0x7a,0x19,0xdf,0xee,0x78,0x34,0x60,
+};
+
+static const uint32_t S1_32[256] = {
+	0x55,0xc2,0x63,0x71,0x3b,0xc8,0x47,0x86,
+	0x9f,0x3c,0xda,0x5b,0x29,0xaa,0xfd,0x77,
+	0x8c,0xc5,0x94,0x0c,0xa6,0x1a,0x13,0x00,
+	0xe3,0xa8,0x16,0x72,0x40,0xf9,0xf8,0x42,
+	0x44,0x26,0x68,0x96,0x81,0xd9,0x45,0x3e,
+	0x10,0x76,0xc6,0xa7,0x8b,0x39,0x43,0xe1,
+	0x3a,0xb5,0x56,0x2a,0xc0,0x6d,0xb3,0x05,
+	0x22,0x66,0xbf,0xdc,0x0b,0xfa,0x62,0x48,
+	0xdd,0x20,0x11,0x06,0x36,0xc9,0xc1,0xcf,
+	0xf6,0x27,0x52,0xbb,0x69,0xf5,0xd4,0x87,
+	0x7f,0x84,0x4c,0xd2,0x9c,0x57,0xa4,0xbc,
+	0x4f,0x9a,0xdf,0xfe,0xd6,0x8d,0x7a,0xeb,
+	0x2b,0x53,0xd8,0x5c,0xa1,0x14,0x17,0xfb,
+	0x23,0xd5,0x7d,0x30,0x67,0x73,0x08,0x09,
+	0xee,0xb7,0x70,0x3f,0x61,0xb2,0x19,0x8e,
+	0x4e,0xe5,0x4b,0x93,0x8f,0x5d,0xdb,0xa9,
+	0xad,0xf1,0xae,0x2e,0xcb,0x0d,0xfc,0xf4,
+	0x2d,0x46,0x6e,0x1d,0x97,0xe8,0xd1,0xe9,
+	0x4d,0x37,0xa5,0x75,0x5e,0x83,0x9e,0xab,
+	0x82,0x9d,0xb9,0x1c,0xe0,0xcd,0x49,0x89,
+	0x01,0xb6,0xbd,0x58,0x24,0xa2,0x5f,0x38,
+	0x78,0x99,0x15,0x90,0x50,0xb8,0x95,0xe4,
+	0xd0,0x91,0xc7,0xce,0xed,0x0f,0xb4,0x6f,
+	0xa0,0xcc,0xf0,0x02,0x4a,0x79,0xc3,0xde,
+	0xa3,0xef,0xea,0x51,0xe6,0x6b,0x18,0xec,
+	0x1b,0x2c,0x80,0xf7,0x74,0xe7,0xff,0x21,
+	0x5a,0x6a,0x54,0x1e,0x41,0x31,0x92,0x35,
+	0xc4,0x33,0x07,0x0a,0xba,0x7e,0x0e,0x34,
+	0x88,0xb1,0x98,0x7c,0xf3,0x3d,0x60,0x6c,
+	0x7b,0xca,0xd3,0x1f,0x32,0x65,0x04,0x28,
+	0x64,0xbe,0x85,0x9b,0x2f,0x59,0x8a,0xd7,
+	0xb0,0x25,0xac,0xaf,0x12,0x03,0xe2,0xf2,
+};
+
+#define ROT32(x, k)							\
+	_mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32 - (k)))
+
+#define ROT31(x, k)							\
+	_mm256_and_si256(_mm256_or_si256(_mm256_slli_epi32(x, k),	\
+		_mm256_srli_epi32(x, 31 - (k))), M31)
+
+#define ADD31(a, b)							\
+	a = _mm256_add_epi32(a, b);					\
+	a = _mm256_add_epi32(_mm256_and_si256(a, M31), _mm256_srli_epi32(a, 31))
+
+#define XOR5(a, b, c, d, e)						\
+	_mm256_xor_si256(_mm256_xor_si256(a, b),			\
+		_mm256_xor_si256(_mm256_xor_si256(c, d), e))
+
+#define L1(x)	XOR5(x, ROT32(x, 2), ROT32(x, 10), ROT32(x, 18), ROT32(x, 24))
+#define L2(x)	XOR5(x, ROT32(x, 8), ROT32(x, 14), ROT32(x, 22), ROT32(x, 30))
+
+#define GATHER(t, i)	_mm256_i32gather_epi32((const int *)(t), i, 4)
+
+/* S = (S0, S1, S0, S1) applied to the bytes of each lane, high byte first */
+static AVX2_TARGET __m256i zuc_avx2_sbox(__m256i x)
+{
+	const __m256i ff = _mm256_set1_epi32(0xff);
+	__m256i y;
+
+	y = _mm256_slli_epi32(GATHER(S0_32, _mm256_srli_epi32(x, 24)), 24);
+	y = _mm256_or_si256(y, _mm256_slli_epi32(GATHER(S1_32,
+		_mm256_and_si256(_mm256_srli_epi32(x, 16), ff)), 16));
+	y = _mm256_or_si256(y, _mm256_slli_epi32(GATHER(S0_32,
+		_mm256_and_si256(_mm256_srli_epi32(x, 8), ff)), 8));
+	y = _mm256_or_si256(y, GATHER(S1_32, _mm256_and_si256(x, ff)));
+	return y;
+}
+
+#define SET8(field)							\
+	_mm256_setr_epi32((int)k[0]->field, (int)k[1]->field,		\
+		(int)k[2]->field, (int)k[3]->field, (int)k[4]->field,	\
+		(int)k[5]->field, (int)k[6]->field, (int)k[7]->field)
+
+/*
+ * The LFSR is kept as a ring of 16 registers, cell i of the specification
+ * being s[(o + i) & 15] after o steps, so that a step only overwrites the
+ * cell that drops out.
+ */
+AVX2_TARGET
+void zuc_avx2_generate_keystream_8lanes(ZUC_KEY *key[8], size_t nwords,
+	uint32_t *words[8])
+{
+	const __m256i M31 = _mm256_set1_epi32(0x7fffffff);
+	const __m256i M16 = _mm256_set1_epi32(0xffff);
+	const __m256i MX0 = _mm256_set1_epi32(0x7fff8000);
+	__m256i s[16];
+	__m256i R1, R2, X0, X1, X2, X3, W1, W2, U, V, Z;
+	uint32_t out[8];
+	uint32_t lanes[16][8];
+	ZUC_KEY idle;
+	ZUC_KEY *k[8];
+	size_t n;
+	unsigned int o = 0;
+	int i, j;
+
+	memset(&idle, 0, sizeof(idle));
+	for (i = 0; i < 8; i++) {
+		k[i] = key[i] ? key[i] : &idle;
+	}
+	for (j = 0; j < 16; j++) {
+		s[j] = SET8(LFSR[j]);
+	}
+	R1 = SET8(R1);
+	R2 = SET8(R2);
+
+#define S(i)	s[(o + (i)) & 15]
+
+	for (n = 0; n < nwords; n++) {
+		o = (unsigned int)n & 15;
+
+		/* bit reorganization */
+		X0 = _mm256_or_si256(
+			_mm256_slli_epi32(_mm256_and_si256(S(15), MX0), 1),
+			_mm256_and_si256(S(14), M16));
+		X1 = _mm256_or_si256(_mm256_slli_epi32(S(11), 16),
+			_mm256_srli_epi32(S(9), 15));
+		X2 = _mm256_or_si256(_mm256_slli_epi32(S(7), 16),
+			_mm256_srli_epi32(S(5), 15));
+		X3 = _mm256_or_si256(_mm256_slli_epi32(S(2), 16),
+			_mm256_srli_epi32(S(0), 15));
+
+		/* F and the keystream word */
+		Z = _mm256_xor_si256(X3,
+			_mm256_add_epi32(_mm256_xor_si256(X0, R1), R2));
+		W1 = _mm256_add_epi32(R1, X1);
+		W2 = _mm256_xor_si256(R2, X2);
+		U = _mm256_or_si256(_mm256_slli_epi32(W1, 16),
+			_mm256_srli_epi32(W2, 16));
+		V = _mm256_or_si256(_mm256_slli_epi32(W2, 16),
+			_mm256_srli_epi32(W1, 16));
+		R1 = zuc_avx2_sbox(L1(U));
+		R2 = zuc_avx2_sbox(L2(V));
+
+		/* LFSR in work mode, the new cell 15 replaces cell 0 */
+		U = S(0);
+		ADD31(U, ROT31(S(0), 8));
+		ADD31(U, ROT31(S(4), 20));
+		ADD31(U, ROT31(S(10), 21));
+		ADD31(U, ROT31(S(13), 17));
+		ADD31(U, ROT31(S(15), 15));
+		S(0) = U;
+
+		_mm256_storeu_si256((__m256i *)out, Z);
+		for (i = 0; i < 8; i++) {
+			if (key[i]) {
+				words[i][n] = out[i];
+			}
+		}
+	}
+	o = (unsigned int)nwords & 15;
+
+	for (j = 0; j < 16; j++) {
+		_mm256_storeu_si256((__m256i *)lanes[j], S(j));
+	}
+#undef S
+	_mm256_storeu_si256((__m256i *)out, R1);
+	for (i = 0; i < 8; i++) {
+		if (key[i]) {
+			for (j = 0; j < 16; j++) {
+				key[i]->LFSR[j] = lanes[j][i];
+			}
+			key[i]->R1 = out[i];
+		}
+	}
+	_mm256_storeu_si256((__m256i *)out, R2);
+	for (i = 0; i < 8; i++) {
+		if (key[i]) {
+			key[i]->R2 = out[i];
+		}
+	}
+
+	OPENSSL_cleanse(s, sizeof(s));
+	OPENSSL_cleanse(lanes, sizeof(lanes));
+	OPENSSL_cleanse(out, sizeof(out));
+}
+#endif
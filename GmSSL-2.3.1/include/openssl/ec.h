@@ -1408,6 +1408,11 @@ int ERR_load_EC_strings(void);
 # define EC_F_ECP_NISTZ256_POINTS_MUL                     137
 # define EC_F_ECP_NISTZ256_PRE_COMP_NEW                   138
 # define EC_F_ECP_NISTZ256_WINDOWED_MUL                   139
+# define EC_F_ECP_SM2P256_GET_AFFINE                      274
+# define EC_F_ECP_SM2P256_POINTS_MUL                      275
+# define EC_F_ECP_SM2P256_SCALAR_TO_WORDS                 276
+# define EC_F_ECP_SM2P256_WINDOWED_MUL                    277
+# define EC_F_ECP_SM2P256_WNAF_MUL                        278
 # define EC_F_ECX_KEY_OP                                  140
 # define EC_F_ECX_PRIV_ENCODE                             141
 # define EC_F_ECX_PUB_ENCODE                              142
@@ -83,16 +83,33 @@ void sm3(const unsigned char *data, size_t datalen,
 	unsigned char digest[SM3_DIGEST_LENGTH]);
 
 
+/* number of messages hashed in parallel by sm3_mb() and sm3_hmac_mb() */
+#define SM3_MB_LANES		8
+
+void sm3_mb(const unsigned char *data[], const size_t datalen[],
+	unsigned char *digest[], size_t num);
+
+
+/* HMAC-SM3 key as the compressed (key ^ ipad) and (key ^ opad) blocks */
+typedef struct {
+	uint32_t ipad_digest[8];
+	uint32_t opad_digest[8];
+} sm3_hmac_key_t;
+
 typedef struct {
 	sm3_ctx_t sm3_ctx;
-	unsigned char key[SM3_BLOCK_SIZE];
+	sm3_hmac_key_t key;
 } sm3_hmac_ctx_t;
 
+void sm3_hmac_set_key(sm3_hmac_key_t *key, const unsigned char *raw_key, size_t key_len);
+void sm3_hmac_init_key(sm3_hmac_ctx_t *ctx, const sm3_hmac_key_t *key);
 void sm3_hmac_init(sm3_hmac_ctx_t *ctx, const unsigned char *key, size_t key_len);
 void sm3_hmac_update(sm3_hmac_ctx_t *ctx, const unsigned char *data, size_t data_len);
 void sm3_hmac_final(sm3_hmac_ctx_t *ctx, unsigned char mac[SM3_HMAC_SIZE]);
 void sm3_hmac(const unsigned char *data, size_t data_len,
 	const unsigned char *key, size_t key_len, unsigned char mac[SM3_HMAC_SIZE]);
+void sm3_hmac_mb(const sm3_hmac_key_t *key[], const unsigned char *data[],
+	const size_t datalen[], unsigned char *mac[], size_t num);
 
 #ifdef __cplusplus
 }
@@ -82,6 +82,16 @@ void ZUC_set_key(ZUC_KEY *key, const unsigned char *user_key, const unsigned cha
 void ZUC_generate_keystream(ZUC_KEY *key, size_t nwords, uint32_t *words);
 uint32_t ZUC_generate_keyword(ZUC_KEY *key);
 
+/*
+ * Multi-buffer keystream: lane i continues key[i] for nwords[i] words.
+ * Up to ZUC_MB_LANES independent streams are generated side by side
+ * (AVX2 when available), more are processed in groups.
+ */
+# define ZUC_MB_LANES	8
+
+void ZUC_generate_keystream_mb(ZUC_KEY *key[], const size_t nwords[],
+	uint32_t *words[], size_t num);
+
 # define ZUC_128EEA3_MIN_BITS	1
 # define ZUC_128EEA3_MAX_BITS	65504
 # define ZUC_128EEA3_MIN_BYTES	((ZUC_128EEA3_MIN_BITS + 7)/8)
@@ -105,12 +115,15 @@ void ZUC_128eea3(const unsigned char key[ZUC_KEY_LENGTH],
 
 /* ZUC 128-EIA3 */
 
-# define ZUC_128EIA3_MIN_BYTES	EEA3_MIN_BYTES
-# define ZUC_128EIA3_MAX_BYTES	EEA3_MAX_BYTES
+# define ZUC_128EIA3_MIN_BYTES	ZUC_128EEA3_MIN_BYTES
+# define ZUC_128EIA3_MAX_BYTES	ZUC_128EEA3_MAX_BYTES
 # define ZUC_128EIA3_MAC_SIZE	4
 
+/* lengths are in bytes, LENGTH of the specification is 8 * len */
 typedef struct zuc_128eia3_st {
 	ZUC_KEY ks;
+	uint32_t T;
+	uint32_t z[2];
 	unsigned char buf[4];
 	size_t num;
 } ZUC_128EIA3;
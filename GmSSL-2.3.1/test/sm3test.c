@@ -195,6 +195,103 @@ static char *pt(unsigned char *md)
 	return (buf);
 }
 
+/*
+ * Reference HMAC straight from the definition, to check sm3_hmac() with
+ * its cached key states and the multi-lane sm3_hmac_mb().
+ */
+static void hmac_ref(const unsigned char *key, size_t keylen,
+	const unsigned char *msg, size_t msglen, unsigned char mac[SM3_HMAC_SIZE])
+{
+	unsigned char k[SM3_BLOCK_SIZE];
+	unsigned char buf[SM3_BLOCK_SIZE + 512];
+	int i;
+
+	memset(k, 0, sizeof(k));
+	if (keylen > SM3_BLOCK_SIZE) {
+		sm3(key, keylen, k);
+	} else {
+		memcpy(k, key, keylen);
+	}
+
+	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
+		buf[i] = k[i] ^ 0x36;
+	}
+	memcpy(buf + SM3_BLOCK_SIZE, msg, msglen);
+	sm3(buf, SM3_BLOCK_SIZE + msglen, mac);
+
+	for (i = 0; i < SM3_BLOCK_SIZE; i++) {
+		buf[i] = k[i] ^ 0x5c;
+	}
+	memcpy(buf + SM3_BLOCK_SIZE, mac, SM3_DIGEST_LENGTH);
+	sm3(buf, SM3_BLOCK_SIZE + SM3_DIGEST_LENGTH, mac);
+}
+
+/* messages covering every padding case, more than one group of lanes */
+#define MB_MSGS		19
+
+static int test_sm3_mb(void)
+{
+	unsigned char msg[MB_MSGS][300];
+	unsigned char key[MB_MSGS][80];
+	unsigned char dgst[MB_MSGS][SM3_DIGEST_LENGTH];
+	unsigned char ref[SM3_DIGEST_LENGTH];
+	const unsigned char *data[MB_MSGS];
+	size_t datalen[MB_MSGS];
+	size_t keylen[MB_MSGS];
+	unsigned char *out[MB_MSGS];
+	sm3_hmac_key_t hkey[MB_MSGS];
+	const sm3_hmac_key_t *hkeys[MB_MSGS];
+	int i, j, err = 0;
+
+	for (i = 0; i < MB_MSGS; i++) {
+		for (j = 0; j < sizeof(msg[i]); j++) {
+			msg[i][j] = (unsigned char)(i * 31 + j * 7);
+		}
+		for (j = 0; j < sizeof(key[i]); j++) {
+			key[i][j] = (unsigned char)(i + j * 13);
+		}
+		data[i] = msg[i];
+		datalen[i] = (i * 37) % 140 + (i == 5 ? 55 : 0);
+		keylen[i] = (i % 3 == 2) ? sizeof(key[i]) : 16 + i;
+		out[i] = dgst[i];
+	}
+
+	sm3_mb(data, datalen, out, MB_MSGS);
+	for (i = 0; i < MB_MSGS; i++) {
+		sm3(msg[i], datalen[i], ref);
+		if (memcmp(dgst[i], ref, sizeof(ref)) != 0) {
+			printf("sm3_mb lane %d (%d bytes) failed\n", i, (int)datalen[i]);
+			err++;
+		}
+	}
+
+	for (i = 0; i < MB_MSGS; i++) {
+		sm3_hmac_set_key(&hkey[i], key[i], keylen[i]);
+		hkeys[i] = &hkey[i];
+
+		hmac_ref(key[i], keylen[i], msg[i], datalen[i], ref);
+		sm3_hmac(msg[i], datalen[i], key[i], keylen[i], dgst[i]);
+		if (memcmp(dgst[i], ref, sizeof(ref)) != 0) {
+			printf("sm3_hmac message %d failed\n", i);
+			err++;
+		}
+	}
+
+	sm3_hmac_mb(hkeys, data, datalen, out, MB_MSGS);
+	for (i = 0; i < MB_MSGS; i++) {
+		hmac_ref(key[i], keylen[i], msg[i], datalen[i], ref);
+		if (memcmp(dgst[i], ref, sizeof(ref)) != 0) {
+			printf("sm3_hmac_mb lane %d failed\n", i);
+			err++;
+		}
+	}
+
+	if (!err) {
+		printf("sm3 multi-buffer and hmac ok\n");
+	}
+	return err;
+}
+
 int main(int argc, char **argv)
 {
 	int err = 0;
@@ -236,6 +333,7 @@ int main(int argc, char **argv)
 
 	OPENSSL_free(testbuf);
 	OPENSSL_free(dgstbuf);
+	err += test_sm3_mb();
 	EXIT(err);
 }
 #endif
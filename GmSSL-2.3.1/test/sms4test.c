@@ -61,13 +61,19 @@ int main(int argc, char **argv)
 #else
 # include <openssl/evp.h>
 # include <openssl/sms4.h>
+# include <openssl/modes.h>
 
 int main(int argc, char **argv)
 {
 	int err = 0;
 	int i;
+	size_t len;
 	sms4_key_t key;
 	unsigned char buf[16];
+	unsigned char blocks[16 * 16];
+	unsigned char iv1[16], iv2[16], ecount1[16], ecount2[16];
+	unsigned char in[16 * 40], out1[16 * 40], out2[16 * 40];
+	unsigned int num1, num2;
 
 	unsigned char user_key[16] = {
 		0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
@@ -129,6 +135,57 @@ int main(int argc, char **argv)
 		goto end;
 	}
 	printf("sms4 encrypt 1000000 times pass!\n");
+
+	/* test the multi-block kernels */
+	for (i = 0; i < 16; i++) {
+		memcpy(blocks + 16 * i, plaintext, sizeof(plaintext));
+	}
+	sms4_encrypt_init(&key);
+	sms4_encrypt_16blocks(blocks, blocks, &key);
+	for (i = 0; i < 16; i++) {
+		if (memcmp(blocks + 16 * i, ciphertext1, sizeof(ciphertext1)) != 0) {
+			printf("sms4 encrypt 16 blocks not pass!\n");
+			goto end;
+		}
+	}
+	sms4_encrypt_8blocks(blocks, blocks, &key);
+	sms4_encrypt(plaintext, buf, &key);
+	sms4_encrypt(buf, buf, &key);
+	for (i = 0; i < 8; i++) {
+		if (memcmp(blocks + 16 * i, buf, sizeof(buf)) != 0) {
+			printf("sms4 encrypt 8 blocks not pass!\n");
+			goto end;
+		}
+	}
+	printf("sms4 encrypt 8/16 blocks pass!\n");
+
+	/* test ctr mode against the single block reference, with the
+	 * low 32 bits of the counter wrapping in the middle */
+	for (i = 0; i < (int)sizeof(in); i++) {
+		in[i] = (unsigned char)(i * 7);
+	}
+	for (len = 0; len <= sizeof(in); len += 13) {
+		memset(iv1, 0x5a, sizeof(iv1));
+		memset(iv1 + 12, 0xff, 4);
+		iv1[15] = 0xf0;
+		memcpy(iv2, iv1, sizeof(iv1));
+		num1 = num2 = 0;
+
+		CRYPTO_ctr128_encrypt(in, out1, len / 3, &key, iv1, ecount1,
+			&num1, (block128_f)sms4_encrypt);
+		CRYPTO_ctr128_encrypt(in + len / 3, out1 + len / 3, len - len / 3,
+			&key, iv1, ecount1, &num1, (block128_f)sms4_encrypt);
+		sms4_ctr128_encrypt(in, out2, len / 3, &key, iv2, ecount2, &num2);
+		sms4_ctr128_encrypt(in + len / 3, out2 + len / 3, len - len / 3,
+			&key, iv2, ecount2, &num2);
+
+		if (memcmp(out1, out2, len) != 0 || memcmp(iv1, iv2, 16) != 0
+			|| num1 != num2) {
+			printf("sms4 ctr %d bytes not pass!\n", (int)len);
+			goto end;
+		}
+	}
+	printf("sms4 ctr pass!\n");
 	printf("sms4 all test vectors pass!\n");
 
 	return err;
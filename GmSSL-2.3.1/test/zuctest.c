@@ -119,6 +119,143 @@ static int zuc_eia3_test2(int verbose)
 }
 */
 
+/* 128-EEA3 test set 1 of the specification, first 192 bits */
+static int test_zuc_128eea3(void)
+{
+	unsigned char key[16] = {
+		0x17,0x3d,0x14,0xba,0x50,0x03,0x73,0x1d,
+		0x7a,0x60,0x04,0x94,0x70,0xf0,0x0a,0x29,
+	};
+	unsigned char ibs[24] = {
+		0x6c,0xf6,0x53,0x40,0x73,0x55,0x52,0xab,
+		0x0c,0x97,0x52,0xfa,0x6f,0x90,0x25,0xfe,
+		0x0b,0xd6,0x75,0xd9,0x00,0x58,0x75,0xb2,
+	};
+	unsigned char obs[24] = {
+		0xa6,0xc8,0x5f,0xc6,0x6a,0xfb,0x85,0x33,
+		0xaa,0xfc,0x25,0x18,0xdf,0xe7,0x84,0x94,
+		0x0e,0xe1,0xe4,0xb0,0x30,0x23,0x8c,0xc8,
+	};
+	unsigned char buf[24];
+	size_t len;
+	int err = 0;
+
+	/* every prefix length exercises the partial last word */
+	for (len = 1; len <= sizeof(ibs); len++) {
+		ZUC_128eea3(key, 0x66035492, 0x0f, 0, len, ibs, buf);
+		if (memcmp(buf, obs, len) != 0) {
+			fprintf(stderr, "error in ZUC 128-EEA3 with %d bytes\n",
+				(int)len);
+			err++;
+		}
+	}
+	if (!err) {
+		fprintf(stderr, "ZUC 128-EEA3 test success\n");
+	}
+	return err;
+}
+
+static int test_zuc_128eia3(void)
+{
+	unsigned char key1[16] = {
+		0x47,0x05,0x41,0x25,0x56,0x1e,0xb2,0xdd,
+		0xa9,0x40,0x59,0xda,0x05,0x09,0x78,0x50,
+	};
+	unsigned char msg1[12] = {0};
+	unsigned char key2[16] = {
+		0xc9,0xe6,0xce,0xc4,0x60,0x7c,0x72,0xdb,
+		0x00,0x0a,0xef,0xa8,0x83,0x85,0xab,0x0a,
+	};
+	unsigned char msg2[75] = {
+		0x16,0x58,0x4c,0x05,0xae,0x93,0x8d,0xd9,
+		0x46,0xce,0xcf,0xad,0xdf,0x0a,0x11,0x81,
+		0x77,0x45,0x53,0x55,0x0f,0x80,0x95,0x29,
+		0xa7,0xbb,0xd6,0xfd,0x3f,0xf7,0x18,0xd1,
+		0xd8,0x32,0x5a,0xa5,0x70,0x6d,0x9c,0x79,
+		0x08,0xa8,0xde,0x4d,0xa0,0xe4,0x20,0x21,
+		0x39,0x1f,0x61,0xf5,0xd1,0x5a,0xa3,0xc9,
+		0x69,0x95,0xe5,0x9d,0x01,0xd1,0x27,0x71,
+		0x9a,0x0c,0x69,0x45,0x32,0x47,0xab,0x19,
+		0xca,0x82,0xec,
+	};
+	ZUC_128EIA3 ctx;
+	uint32_t mac;
+	size_t i;
+	int err = 0;
+
+	ZUC_128eia3(key1, 0x561eb2dd, 0x14, 0, msg1, sizeof(msg1), &mac);
+	if (mac != 0x89a58b47) {
+		fprintf(stderr, "error in ZUC 128-EIA3 test 1\n");
+		err++;
+	}
+	ZUC_128eia3(key2, 0xa94059da, 0x0a, 1, msg2, 64, &mac);
+	if (mac != 0x53f691b1) {
+		fprintf(stderr, "error in ZUC 128-EIA3 test 2\n");
+		err++;
+	}
+
+	/* the same message fed in uneven pieces */
+	ZUC_128eia3_set_key(&ctx, key2, 0xa94059da, 0x0a, 1);
+	for (i = 0; i < sizeof(msg2); i += i % 7 + 1) {
+		size_t n = i % 7 + 1;
+		if (n > sizeof(msg2) - i) {
+			n = sizeof(msg2) - i;
+		}
+		ZUC_128eia3_update(&ctx, msg2 + i, n);
+	}
+	ZUC_128eia3_final(&ctx, &mac);
+	if (mac != 0xf4ff0680) {
+		fprintf(stderr, "error in ZUC 128-EIA3 test 3\n");
+		err++;
+	}
+	if (!err) {
+		fprintf(stderr, "ZUC 128-EIA3 test success\n");
+	}
+	return err;
+}
+
+/* the multi-buffer keystream must match the one-stream generator */
+static int test_zuc_mb(void)
+{
+	ZUC_KEY keys[19], refs[19];
+	ZUC_KEY *kp[19];
+	uint32_t out[19][100], ref[100];
+	uint32_t *op[19];
+	size_t nwords[19];
+	unsigned char key[16], iv[16];
+	size_t i, j;
+	int err = 0;
+
+	for (i = 0; i < 19; i++) {
+		for (j = 0; j < 16; j++) {
+			key[j] = (unsigned char)(i * 16 + j);
+			iv[j] = (unsigned char)(i * 7 + j * 3);
+		}
+		ZUC_set_key(&keys[i], key, iv);
+		refs[i] = keys[i];
+		kp[i] = &keys[i];
+		op[i] = out[i];
+		nwords[i] = (i * 37) % 100;
+	}
+
+	ZUC_generate_keystream_mb(kp, nwords, op, 19);
+
+	for (i = 0; i < 19; i++) {
+		ZUC_generate_keystream(&refs[i], nwords[i], ref);
+		if (memcmp(out[i], ref, nwords[i] * sizeof(uint32_t)) != 0
+			|| ZUC_generate_keyword(&refs[i])
+				!= ZUC_generate_keyword(&keys[i])) {
+			fprintf(stderr, "error in ZUC multi-buffer lane %d\n",
+				(int)i);
+			err++;
+		}
+	}
+	if (!err) {
+		fprintf(stderr, "ZUC multi-buffer test success\n");
+	}
+	return err;
+}
+
 int main(int argc, char **argv)
 {
 	int err = 0;
@@ -155,6 +292,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	err += test_zuc_128eea3();
+	err += test_zuc_128eia3();
+	err += test_zuc_mb();
+
 	return err;
 }
 #endif
@@ -52,6 +52,33 @@
 #include "aes_icm.h"
 #include "alloc.h"
 
+/*
+ * AES instructions are used for the keystream when the compiler can
+ * generate them; whether the processor has them is checked at run time
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+    #define SRTP_AES_ICM_AESNI 1
+    #define SRTP_AESNI_TARGET __attribute__((target("aes,sse2")))
+    #include <cpuid.h>
+    #include <wmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define SRTP_AES_ICM_AESNI 1
+    #define SRTP_AESNI_TARGET
+    #include <intrin.h>
+    #include <wmmintrin.h>
+#elif defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+    #define SRTP_AES_ICM_ARMV8_CE 1
+    #include <arm_neon.h>
+    #if defined(__linux__)
+        #include <sys/auxv.h>
+        #ifndef HWCAP_AES
+            #define HWCAP_AES (1 << 3)
+        #endif
+    #endif
+#endif
+
 
 srtp_debug_module_t srtp_mod_aes_icm = {
     0,               /* debugging is off by default */
@@ -143,6 +170,9 @@ static srtp_err_status_t srtp_aes_icm_alloc (srtp_cipher_t **c, int key_len, int
     icm->key_size = key_len;
     (*c)->key_len = key_len;
 
+    /* pick the keystream generator when the first cipher is allocated */
+    srtp_aes_icm_get_impl();
+
     return srtp_err_status_ok;
 }
 
@@ -278,61 +308,27 @@ static void srtp_aes_icm_advance (srtp_aes_icm_ctx_t *c)
     }
 }
 
-/*e
- * icm_encrypt deals with the following cases:
- *
- * bytes_to_encr < bytes_in_buffer
- *  - add keystream into data
+/*
+ * keystream generators
  *
- * bytes_to_encr > bytes_in_buffer
- *  - add keystream into data until keystream_buffer is depleted
- *  - loop over blocks, filling keystream_buffer and then
- *    adding keystream into data
- *  - fill buffer then add in remaining (< 16) bytes of keystream
+ * a generator encrypts num_blocks consecutive counter blocks starting
+ * at c->counter, adds the keystream into buf and advances the block
+ * index by num_blocks.  the block index is the last 16 bits of the
+ * counter and wraps around like the one in srtp_aes_icm_advance();
+ * srtp_aes_icm_encrypt() makes sure that it never does.
  */
+typedef void (*srtp_aes_icm_blocks_func_t)(srtp_aes_icm_ctx_t *c,
+                                           uint8_t *buf,
+                                           unsigned int num_blocks);
 
-static srtp_err_status_t srtp_aes_icm_encrypt (void *cv,
-                                               unsigned char *buf, unsigned int *enc_len)
+static void srtp_aes_icm_blocks_generic(srtp_aes_icm_ctx_t *c,
+                                        uint8_t *buf,
+                                        unsigned int num_blocks)
 {
-    srtp_aes_icm_ctx_t *c = (srtp_aes_icm_ctx_t*)cv;
-    unsigned int bytes_to_encr = *enc_len;
     unsigned int i;
     uint32_t *b;
 
-    /* check that there's enough segment left*/
-    if ((bytes_to_encr + htons(c->counter.v16[7])) > 0xffff) {
-        return srtp_err_status_terminus;
-    }
-
-    debug_print(srtp_mod_aes_icm, "block index: %d",
-                htons(c->counter.v16[7]));
-    if (bytes_to_encr <= (unsigned int)c->bytes_in_buffer) {
-
-        /* deal with odd case of small bytes_to_encr */
-        for (i = (sizeof(v128_t) - c->bytes_in_buffer);
-             i < (sizeof(v128_t) - c->bytes_in_buffer + bytes_to_encr); i++) {
-            *buf++ ^= c->keystream_buffer.v8[i];
-        }
-
-        c->bytes_in_buffer -= bytes_to_encr;
-
-        /* return now to avoid the main loop */
-        return srtp_err_status_ok;
-
-    } else {
-
-        /* encrypt bytes until the remaining data is 16-byte aligned */
-        for (i = (sizeof(v128_t) - c->bytes_in_buffer); i < sizeof(v128_t); i++) {
-            *buf++ ^= c->keystream_buffer.v8[i];
-        }
-
-        bytes_to_encr -= c->bytes_in_buffer;
-        c->bytes_in_buffer = 0;
-
-    }
-
-    /* now loop over entire 16-byte blocks of keystream */
-    for (i = 0; i < (bytes_to_encr / sizeof(v128_t)); i++) {
+    for (i = 0; i < num_blocks; i++) {
 
         /* fill buffer with new keystream */
         srtp_aes_icm_advance(c);
@@ -378,12 +374,261 @@ static srtp_err_status_t srtp_aes_icm_encrypt (void *cv,
 #endif  /* #if ALIGN_32 */
 
     }
+}
+
+#ifdef SRTP_AES_ICM_AESNI
+
+/* number of counter blocks that are encrypted together */
+#define AESNI_PARALLEL_BLOCKS 8
+
+static int srtp_aes_icm_aesni_supported(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[2] & (1 << 25)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ecx & bit_AES) != 0;
+#endif
+}
+
+SRTP_AESNI_TARGET
+static void srtp_aes_icm_blocks_aesni(srtp_aes_icm_ctx_t *c,
+                                      uint8_t *buf,
+                                      unsigned int num_blocks)
+{
+    __m128i k[15], x[AESNI_PARALLEL_BLOCKS], counter;
+    int num_rounds = c->expanded_key.num_rounds;
+    uint16_t index;
+    unsigned int i, j, n;
+    int r;
+
+    for (r = 0; r <= num_rounds; r++)
+        k[r] = _mm_loadu_si128((const __m128i *)&c->expanded_key.round[r]);
+
+    counter = _mm_loadu_si128((const __m128i *)&c->counter);
+    index = (uint16_t)((c->counter.v8[14] << 8) | c->counter.v8[15]);
+
+    for (i = 0; i < num_blocks; i += n) {
+        n = num_blocks - i;
+        if (n > AESNI_PARALLEL_BLOCKS)
+            n = AESNI_PARALLEL_BLOCKS;
+
+        /* the block index is big-endian, the vector lanes little-endian */
+        for (j = 0; j < n; j++) {
+            uint16_t idx = (uint16_t)(index + j);
+            x[j] = _mm_insert_epi16(counter, (idx >> 8) | (idx << 8), 7);
+            x[j] = _mm_xor_si128(x[j], k[0]);
+        }
+        for (r = 1; r < num_rounds; r++) {
+            for (j = 0; j < n; j++)
+                x[j] = _mm_aesenc_si128(x[j], k[r]);
+        }
+        for (j = 0; j < n; j++) {
+            __m128i *p = (__m128i *)(buf + 16 * j);
+            x[j] = _mm_aesenclast_si128(x[j], k[num_rounds]);
+            _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), x[j]));
+        }
+
+        index = (uint16_t)(index + n);
+        buf += 16 * n;
+    }
+
+    c->counter.v8[14] = (uint8_t)(index >> 8);
+    c->counter.v8[15] = (uint8_t)index;
+}
+
+#endif /* SRTP_AES_ICM_AESNI */
+
+#ifdef SRTP_AES_ICM_ARMV8_CE
+
+/* number of counter blocks that are encrypted together */
+#define ARMV8_CE_PARALLEL_BLOCKS 4
+
+static int srtp_aes_icm_armv8_ce_supported(void)
+{
+#if defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    /* the build targets a processor with the crypto extensions */
+    return 1;
+#endif
+}
+
+static void srtp_aes_icm_blocks_armv8_ce(srtp_aes_icm_ctx_t *c,
+                                         uint8_t *buf,
+                                         unsigned int num_blocks)
+{
+    uint8x16_t k[15], x[ARMV8_CE_PARALLEL_BLOCKS];
+    int num_rounds = c->expanded_key.num_rounds;
+    v128_t counter;
+    uint16_t index;
+    unsigned int i, j, n;
+    int r;
+
+    for (r = 0; r <= num_rounds; r++)
+        k[r] = vld1q_u8(c->expanded_key.round[r].v8);
+
+    v128_copy(&counter, &c->counter);
+    index = (uint16_t)((c->counter.v8[14] << 8) | c->counter.v8[15]);
+
+    for (i = 0; i < num_blocks; i += n) {
+        n = num_blocks - i;
+        if (n > ARMV8_CE_PARALLEL_BLOCKS)
+            n = ARMV8_CE_PARALLEL_BLOCKS;
+
+        for (j = 0; j < n; j++) {
+            uint16_t idx = (uint16_t)(index + j);
+            counter.v8[14] = (uint8_t)(idx >> 8);
+            counter.v8[15] = (uint8_t)idx;
+            x[j] = vld1q_u8(counter.v8);
+        }
+        /* AESE adds the round key before SubBytes and ShiftRows */
+        for (r = 0; r < num_rounds - 1; r++) {
+            for (j = 0; j < n; j++)
+                x[j] = vaesmcq_u8(vaeseq_u8(x[j], k[r]));
+        }
+        for (j = 0; j < n; j++) {
+            uint8_t *p = buf + 16 * j;
+            x[j] = veorq_u8(vaeseq_u8(x[j], k[num_rounds - 1]), k[num_rounds]);
+            vst1q_u8(p, veorq_u8(vld1q_u8(p), x[j]));
+        }
+
+        index = (uint16_t)(index + n);
+        buf += 16 * n;
+    }
+
+    c->counter.v8[14] = (uint8_t)(index >> 8);
+    c->counter.v8[15] = (uint8_t)index;
+}
+
+#endif /* SRTP_AES_ICM_ARMV8_CE */
+
+static srtp_aes_icm_impl_t srtp_aes_icm_impl = srtp_aes_icm_impl_auto;
+static srtp_aes_icm_blocks_func_t srtp_aes_icm_blocks =
+    srtp_aes_icm_blocks_generic;
+
+srtp_err_status_t srtp_aes_icm_set_impl(srtp_aes_icm_impl_t impl)
+{
+    if (impl == srtp_aes_icm_impl_auto) {
+#ifdef SRTP_AES_ICM_AESNI
+        if (srtp_aes_icm_set_impl(srtp_aes_icm_impl_aesni) ==
+            srtp_err_status_ok)
+            return srtp_err_status_ok;
+#endif
+#ifdef SRTP_AES_ICM_ARMV8_CE
+        if (srtp_aes_icm_set_impl(srtp_aes_icm_impl_armv8_ce) ==
+            srtp_err_status_ok)
+            return srtp_err_status_ok;
+#endif
+        return srtp_aes_icm_set_impl(srtp_aes_icm_impl_generic);
+    }
+
+    switch (impl) {
+    case srtp_aes_icm_impl_generic:
+        srtp_aes_icm_blocks = srtp_aes_icm_blocks_generic;
+        break;
+#ifdef SRTP_AES_ICM_AESNI
+    case srtp_aes_icm_impl_aesni:
+        if (!srtp_aes_icm_aesni_supported())
+            return srtp_err_status_bad_param;
+        srtp_aes_icm_blocks = srtp_aes_icm_blocks_aesni;
+        break;
+#endif
+#ifdef SRTP_AES_ICM_ARMV8_CE
+    case srtp_aes_icm_impl_armv8_ce:
+        if (!srtp_aes_icm_armv8_ce_supported())
+            return srtp_err_status_bad_param;
+        srtp_aes_icm_blocks = srtp_aes_icm_blocks_armv8_ce;
+        break;
+#endif
+    default:
+        return srtp_err_status_bad_param;
+    }
+
+    srtp_aes_icm_impl = impl;
+    debug_print(srtp_mod_aes_icm, "using keystream generator %d", impl);
+
+    return srtp_err_status_ok;
+}
+
+srtp_aes_icm_impl_t srtp_aes_icm_get_impl(void)
+{
+    if (srtp_aes_icm_impl == srtp_aes_icm_impl_auto)
+        srtp_aes_icm_set_impl(srtp_aes_icm_impl_auto);
+
+    return srtp_aes_icm_impl;
+}
+
+/*e
+ * icm_encrypt deals with the following cases:
+ *
+ * bytes_to_encr < bytes_in_buffer
+ *  - add keystream into data
+ *
+ * bytes_to_encr > bytes_in_buffer
+ *  - add keystream into data until keystream_buffer is depleted
+ *  - loop over blocks, filling keystream_buffer and then
+ *    adding keystream into data
+ *  - fill buffer then add in remaining (< 16) bytes of keystream
+ */
+
+static srtp_err_status_t srtp_aes_icm_encrypt (void *cv,
+                                               unsigned char *buf, unsigned int *enc_len)
+{
+    srtp_aes_icm_ctx_t *c = (srtp_aes_icm_ctx_t*)cv;
+    unsigned int bytes_to_encr = *enc_len;
+    unsigned int i;
+    v128_t keystream;
+
+    /* check that there's enough segment left*/
+    if ((bytes_to_encr + htons(c->counter.v16[7])) > 0xffff) {
+        return srtp_err_status_terminus;
+    }
+
+    debug_print(srtp_mod_aes_icm, "block index: %d",
+                htons(c->counter.v16[7]));
+    if (bytes_to_encr <= (unsigned int)c->bytes_in_buffer) {
+
+        /* deal with odd case of small bytes_to_encr */
+        for (i = (sizeof(v128_t) - c->bytes_in_buffer);
+             i < (sizeof(v128_t) - c->bytes_in_buffer + bytes_to_encr); i++) {
+            *buf++ ^= c->keystream_buffer.v8[i];
+        }
+
+        c->bytes_in_buffer -= bytes_to_encr;
+
+        /* return now to avoid the main loop */
+        return srtp_err_status_ok;
+
+    } else {
+
+        /* encrypt bytes until the remaining data is 16-byte aligned */
+        for (i = (sizeof(v128_t) - c->bytes_in_buffer); i < sizeof(v128_t); i++) {
+            *buf++ ^= c->keystream_buffer.v8[i];
+        }
+
+        bytes_to_encr -= c->bytes_in_buffer;
+        c->bytes_in_buffer = 0;
+
+    }
+
+    /* now add keystream into entire 16-byte blocks of data at once */
+    srtp_aes_icm_blocks(c, buf, bytes_to_encr / sizeof(v128_t));
+    buf += bytes_to_encr & ~0xf;
 
     /* if there is a tail end of the data, process it */
     if ((bytes_to_encr & 0xf) != 0) {
 
         /* fill buffer with new keystream */
-        srtp_aes_icm_advance(c);
+        v128_set_to_zero(&keystream);
+        srtp_aes_icm_blocks(c, keystream.v8, 1);
+        v128_copy(&c->keystream_buffer, &keystream);
 
         for (i = 0; i < (bytes_to_encr & 0xf); i++) {
             *buf++ ^= c->keystream_buffer.v8[i];
@@ -145,6 +145,42 @@ srtp_err_status_t srtp_cipher_set_aad (srtp_cipher_t *c, const uint8_t *aad, uin
     return (((c)->type)->set_aad(((c)->state), aad, aad_len));
 }
 
+srtp_err_status_t srtp_cipher_process_batch (srtp_cipher_t *c, srtp_cipher_batch_entry_t *entries, unsigned int num_entries, int direction)
+{
+    srtp_err_status_t status, first = srtp_err_status_ok;
+    unsigned int i;
+
+    if (!c || !c->type || !c->state || (!entries && num_entries)) {
+	return (srtp_err_status_bad_param);
+    }
+    if (direction != srtp_direction_encrypt && direction != srtp_direction_decrypt) {
+	return (srtp_err_status_bad_param);
+    }
+
+    if (((c)->type)->process_batch) {
+	return (((c)->type)->process_batch(((c)->state), entries, num_entries,
+	                                   (srtp_cipher_direction_t)direction));
+    }
+
+    for (i = 0; i < num_entries; i++) {
+	status = ((c)->type)->set_iv(((c)->state), (uint8_t*)&entries[i].iv,
+	                             (srtp_cipher_direction_t)direction);
+	if (!status) {
+	    if (direction == srtp_direction_encrypt) {
+		status = ((c)->type)->encrypt(((c)->state), entries[i].buffer, &entries[i].len);
+	    } else {
+		status = ((c)->type)->decrypt(((c)->state), entries[i].buffer, &entries[i].len);
+	    }
+	}
+	entries[i].status = status;
+	if (status && !first) {
+	    first = status;
+	}
+    }
+
+    return first;
+}
+
 /* some bookkeeping functions */
 
 int srtp_cipher_get_key_length (const srtp_cipher_t *c)
@@ -53,6 +53,8 @@
 #include "err.h"                /* for srtp_debug */
 #include "alloc.h"
 
+#include <time.h>
+
 
 /* the sdt_cipher uses the cipher debug module  */
 extern srtp_debug_module_t srtp_mod_cipher;
@@ -61,153 +63,192 @@ extern const srtp_cipher_type_t srtp_sdt_SM4_ECB_cipher;
 extern const srtp_cipher_type_t srtp_sdt_SM4_CBC_cipher;
 extern const srtp_cipher_type_t srtp_sdt_SM4_OFB_cipher;
 
-static srtp_err_status_t srtp_sdt_cipher_sm4_ecb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+/*
+ * process-wide SDF device handle and session pool
+ *
+ * opening the device and a session are both slow round trips to the
+ * card, and the card only supports a limited number of sessions, so the
+ * device is opened once on first use and sessions are recycled between
+ * ciphers.  sessions are opened lazily up to SRTP_SDT_SDF_POOL_MAX_SESSIONS;
+ * past that, a lease waits until another cipher returns one.
+ */
+static pthread_mutex_t sdf_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sdf_pool_cond = PTHREAD_COND_INITIALIZER;
+static SGD_HANDLE sdf_pool_device_handle = NULL;
+static SGD_HANDLE sdf_pool_free_sessions[SRTP_SDT_SDF_POOL_MAX_SESSIONS];
+static srtp_sdt_sdf_pool_stats_t sdf_pool_stats;
+
+static unsigned long long sdf_pool_now_usec (void)
 {
+	struct timespec ts;
 
-    srtp_sdt_sm4_ctx_t* sdt_ctx;
-    debug_print(srtp_mod_cipher,
-                "allocating cipher with key length %d", key_len);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
+/* called with sdf_pool_lock held */
+static srtp_err_status_t sdf_pool_open_device (void)
+{
+	DEVICEINFO dev_info;
+	SGD_HANDLE session_handle;
+	int rv;
 
-    if (key_len != SRTP_SDT_SM4_KEY_LEN) {
-        return srtp_err_status_bad_param;
-    }
+	if(SDR_OK!=(rv=SDF_OpenDevice(&sdf_pool_device_handle)))
+	{
+		printf("open device failed, error code=[0x%08x]\n",rv);
+		sdf_pool_device_handle = NULL;
+		return srtp_err_status_alloc_fail;
+	}
 
-    /* allocate memory a cipher of type null_cipher */
-    *c = (srtp_cipher_t *)srtp_crypto_alloc(sizeof(srtp_cipher_t));
-    if (*c == NULL) {
-        return srtp_err_status_alloc_fail;
-    }
-    memset(*c, 0x0, sizeof(srtp_cipher_t));
+	/* the first session is used to report the device and then kept */
+	if(SDR_OK!=(rv=SDF_OpenSession(sdf_pool_device_handle, &session_handle)))
+	{
+		printf("open session failed, error code=[0x%08x]\n",rv);
+		SDF_CloseDevice(sdf_pool_device_handle);
+		sdf_pool_device_handle = NULL;
+		return srtp_err_status_alloc_fail;
+	}
 
-    //allocate memory for sdt cipher
-    sdt_ctx = (srtp_sdt_sm4_ctx_t *)srtp_crypto_alloc(sizeof(srtp_sdt_sm4_ctx_t));
-    if (sdt_ctx == NULL)
-    {
-    	srtp_crypto_free(*c);
-        return srtp_err_status_alloc_fail;
-    }
-    memset(sdt_ctx, 0x0, sizeof(srtp_sdt_sm4_ctx_t));
-    sdt_ctx->mode = SMS4_ECB;
+	if(SDR_OK==(rv=SDF_GetDeviceInfo(session_handle, &dev_info)))
+	{
+		debug_print(srtp_mod_cipher, "sdf device %.16s opened", (char *)dev_info.DeviceName);
+	}
+	else
+	{
+		printf("get dev_info failed, error code=[0x%08x]\n",rv);
+	}
 
-    (*c)->state = sdt_ctx;
-    /* set pointers */
-    (*c)->algorithm = SRTP_SDT_SM4_ECB;
-    (*c)->type = &srtp_sdt_SM4_ECB_cipher;
-//    (*c)->state = (void *) 0x1; /* The null cipher does not maintain state */
+	sdf_pool_free_sessions[sdf_pool_stats.free++] = session_handle;
+	sdf_pool_stats.opened++;
 
-    /* set key size */
-    (*c)->key_len = key_len;
+	return srtp_err_status_ok;
+}
 
-    //added sanweixinan JMK init //
-    int rv;
-  	if(SDR_OK!=(rv=SDF_OpenDevice(&(sdt_ctx->device_handle))))
-  	{
-  		printf("open device failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-  	if(SDR_OK!=(rv=SDF_OpenSession(sdt_ctx->device_handle, &(sdt_ctx->session_handle))))
-  	{
-  		printf("open session failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	if(SDR_OK!=(rv=SDF_GetDeviceInfo(sdt_ctx->session_handle, &(sdt_ctx->dev_info))))
-  	{
-  		printf("get dev_info failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	printf( "IssuerName= %s\n, DeviceName=%s\n, DeviceSerial=%d\n,DeviceVersion=%d\n" ,
-  			sdt_ctx->dev_info.IssuerName,
-  			sdt_ctx->dev_info.DeviceName,
-  			sdt_ctx->dev_info.DeviceSerial,
-  			sdt_ctx->dev_info.DeviceVersion );
-
-	printf("JMK init, choose SM4 mode is %d OK\n", SMS4_ECB);
+srtp_err_status_t srtp_sdt_sdf_pool_lease (SGD_HANDLE *session_handle)
+{
+	srtp_err_status_t status = srtp_err_status_ok;
+	unsigned long long wait_start = 0;
+	int rv;
 
-    return srtp_err_status_ok;
+	pthread_mutex_lock(&sdf_pool_lock);
 
+	if (sdf_pool_device_handle == NULL) {
+		status = sdf_pool_open_device();
+		if (status) {
+			pthread_mutex_unlock(&sdf_pool_lock);
+			return status;
+		}
+	}
+
+	while (sdf_pool_stats.free == 0 &&
+		   sdf_pool_stats.opened >= SRTP_SDT_SDF_POOL_MAX_SESSIONS) {
+		if (wait_start == 0) {
+			wait_start = sdf_pool_now_usec();
+			sdf_pool_stats.wait_count++;
+		}
+		pthread_cond_wait(&sdf_pool_cond, &sdf_pool_lock);
+	}
+	if (wait_start != 0) {
+		sdf_pool_stats.wait_usec += sdf_pool_now_usec() - wait_start;
+	}
+
+	if (sdf_pool_stats.free > 0) {
+		*session_handle = sdf_pool_free_sessions[--sdf_pool_stats.free];
+	} else if(SDR_OK==(rv=SDF_OpenSession(sdf_pool_device_handle, session_handle))) {
+		sdf_pool_stats.opened++;
+	} else {
+		printf("open session failed, error code=[0x%08x]\n",rv);
+		status = srtp_err_status_alloc_fail;
+	}
+
+	if (status == srtp_err_status_ok) {
+		sdf_pool_stats.leased++;
+		sdf_pool_stats.lease_count++;
+	}
+
+	pthread_mutex_unlock(&sdf_pool_lock);
+
+	return status;
 }
 
+void srtp_sdt_sdf_pool_release (SGD_HANDLE session_handle)
+{
+	pthread_mutex_lock(&sdf_pool_lock);
+
+	sdf_pool_free_sessions[sdf_pool_stats.free++] = session_handle;
+	sdf_pool_stats.leased--;
+	pthread_cond_signal(&sdf_pool_cond);
 
-static srtp_err_status_t srtp_sdt_cipher_sm4_cbc_alloc (srtp_cipher_t **c, int key_len, int tlen)
+	pthread_mutex_unlock(&sdf_pool_lock);
+}
+
+void srtp_sdt_sdf_pool_get_stats (srtp_sdt_sdf_pool_stats_t *stats)
 {
+	pthread_mutex_lock(&sdf_pool_lock);
+	*stats = sdf_pool_stats;
+	pthread_mutex_unlock(&sdf_pool_lock);
+}
 
-    srtp_sdt_sm4_ctx_t* sdt_ctx;
-    debug_print(srtp_mod_cipher,
-                "allocating cipher with key length %d", key_len);
+int srtp_sdt_sdf_pool_in_use (void)
+{
+	int in_use;
 
+	pthread_mutex_lock(&sdf_pool_lock);
+	in_use = sdf_pool_device_handle != NULL;
+	pthread_mutex_unlock(&sdf_pool_lock);
 
-    if (key_len != SRTP_SDT_SM4_KEY_LEN) {
-        return srtp_err_status_bad_param;
-    }
+	return in_use;
+}
 
-    /* allocate memory a cipher of type null_cipher */
-    *c = (srtp_cipher_t *)srtp_crypto_alloc(sizeof(srtp_cipher_t));
-    if (*c == NULL) {
-        return srtp_err_status_alloc_fail;
-    }
-    memset(*c, 0x0, sizeof(srtp_cipher_t));
+/*
+ * closes the idle sessions and the device; fails while ciphers still
+ * hold sessions
+ */
+srtp_err_status_t srtp_sdt_sdf_pool_shutdown (void)
+{
+	srtp_err_status_t status = srtp_err_status_ok;
+	int rv;
 
-    //allocate memory for sdt cipher
-    sdt_ctx = (srtp_sdt_sm4_ctx_t *)srtp_crypto_alloc(sizeof(srtp_sdt_sm4_ctx_t));
-    if (sdt_ctx == NULL)
-    {
-    	srtp_crypto_free(*c);
-        return srtp_err_status_alloc_fail;
-    }
-    memset(sdt_ctx, 0x0, sizeof(srtp_sdt_sm4_ctx_t));
-    sdt_ctx->mode = SMS4_CBC;
+	pthread_mutex_lock(&sdf_pool_lock);
 
-    (*c)->state = sdt_ctx;
-    /* set pointers */
-    (*c)->algorithm = SRTP_SDT_SM4_CBC;
-    (*c)->type = &srtp_sdt_SM4_CBC_cipher;
-//    (*c)->state = (void *) 0x1; /* The null cipher does not maintain state */
+	if (sdf_pool_stats.leased > 0) {
+		pthread_mutex_unlock(&sdf_pool_lock);
+		return srtp_err_status_dealloc_fail;
+	}
 
-    /* set key size */
-    (*c)->key_len = key_len;
+	while (sdf_pool_stats.free > 0) {
+		if(SDR_OK!=(rv=SDF_CloseSession(sdf_pool_free_sessions[--sdf_pool_stats.free])))
+		{
+			printf("CloseSession failed, error code=[0x%08x]\n",rv);
+			status = srtp_err_status_dealloc_fail;
+		}
+		sdf_pool_stats.opened--;
+	}
 
-    //added sanweixinan JMK init //
-    int rv;
-  	if(SDR_OK!=(rv=SDF_OpenDevice(&(sdt_ctx->device_handle))))
-  	{
-  		printf("open device failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-  	if(SDR_OK!=(rv=SDF_OpenSession(sdt_ctx->device_handle, &(sdt_ctx->session_handle))))
-  	{
-  		printf("open session failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	if(SDR_OK!=(rv=SDF_GetDeviceInfo(sdt_ctx->session_handle, &(sdt_ctx->dev_info))))
-  	{
-  		printf("get dev_info failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	printf( "IssuerName= %s\n, DeviceName=%s\n, DeviceSerial=%d\n,DeviceVersion=%d\n" ,
-  			sdt_ctx->dev_info.IssuerName,
-  			sdt_ctx->dev_info.DeviceName,
-  			sdt_ctx->dev_info.DeviceSerial,
-  			sdt_ctx->dev_info.DeviceVersion );
-
-	printf("JMK init, choose SM4 mode is %d OK\n", SMS4_CBC);
+	if (sdf_pool_device_handle != NULL) {
+		if(SDR_OK!=(rv=SDF_CloseDevice(sdf_pool_device_handle)))
+		{
+			printf("CloseDevice failed, error code=[0x%08x]\n",rv);
+			status = srtp_err_status_dealloc_fail;
+		}
+		sdf_pool_device_handle = NULL;
+	}
 
-    return srtp_err_status_ok;
+	pthread_mutex_unlock(&sdf_pool_lock);
 
+	return status;
 }
 
-static srtp_err_status_t srtp_sdt_cipher_sm4_ofb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+static srtp_err_status_t srtp_sdt_cipher_alloc (srtp_cipher_t **c, int key_len,
+                                                sdt_sm4_mode mode, int algorithm,
+                                                const srtp_cipher_type_t *type)
 {
-
     srtp_sdt_sm4_ctx_t* sdt_ctx;
+    srtp_err_status_t status;
+
     debug_print(srtp_mod_cipher,
                 "allocating cipher with key length %d", key_len);
 
-
     if (key_len != SRTP_SDT_SM4_KEY_LEN) {
         return srtp_err_status_bad_param;
     }
@@ -224,80 +265,63 @@ static srtp_err_status_t srtp_sdt_cipher_sm4_ofb_alloc (srtp_cipher_t **c, int k
     if (sdt_ctx == NULL)
     {
     	srtp_crypto_free(*c);
+    	*c = NULL;
         return srtp_err_status_alloc_fail;
     }
     memset(sdt_ctx, 0x0, sizeof(srtp_sdt_sm4_ctx_t));
-    sdt_ctx->mode = SMS4_OFB;
+    sdt_ctx->mode = mode;
+
+    status = srtp_sdt_sdf_pool_lease(&sdt_ctx->session_handle);
+    if (status) {
+    	srtp_crypto_free(sdt_ctx);
+    	srtp_crypto_free(*c);
+    	*c = NULL;
+    	return status;
+    }
 
     (*c)->state = sdt_ctx;
     /* set pointers */
-    (*c)->algorithm = SRTP_SDT_SM4_OFB;
-    (*c)->type = &srtp_sdt_SM4_OFB_cipher;
-//    (*c)->state = (void *) 0x1; /* The null cipher does not maintain state */
+    (*c)->algorithm = algorithm;
+    (*c)->type = type;
 
     /* set key size */
     (*c)->key_len = key_len;
 
-    //added sanweixinan JMK init //
-    int rv;
-  	if(SDR_OK!=(rv=SDF_OpenDevice(&(sdt_ctx->device_handle))))
-  	{
-  		printf("open device failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-  	if(SDR_OK!=(rv=SDF_OpenSession(sdt_ctx->device_handle, &(sdt_ctx->session_handle))))
-  	{
-  		printf("open session failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	if(SDR_OK!=(rv=SDF_GetDeviceInfo(sdt_ctx->session_handle, &(sdt_ctx->dev_info))))
-  	{
-  		printf("get dev_info failed, error code=[0x%08x]\n",rv);
-  		return srtp_err_status_alloc_fail;
-  	}
-
-  	printf( "IssuerName= %s\n, DeviceName=%s\n, DeviceSerial=%d\n,DeviceVersion=%d\n" ,
-  			sdt_ctx->dev_info.IssuerName,
-  			sdt_ctx->dev_info.DeviceName,
-  			sdt_ctx->dev_info.DeviceSerial,
-  			sdt_ctx->dev_info.DeviceVersion );
-
-	printf("JMK init, choose SM4 mode is %d OK\n", SMS4_OFB);
-
     return srtp_err_status_ok;
+}
 
+static srtp_err_status_t srtp_sdt_cipher_sm4_ecb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_cipher_alloc(c, key_len, SMS4_ECB, SRTP_SDT_SM4_ECB, &srtp_sdt_SM4_ECB_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_cipher_sm4_cbc_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_cipher_alloc(c, key_len, SMS4_CBC, SRTP_SDT_SM4_CBC, &srtp_sdt_SM4_CBC_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_cipher_sm4_ofb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_cipher_alloc(c, key_len, SMS4_OFB, SRTP_SDT_SM4_OFB, &srtp_sdt_SM4_OFB_cipher);
 }
 
 
 static srtp_err_status_t srtp_sdt_cipher_dealloc (srtp_cipher_t *c)
 {
 	srtp_sdt_sm4_ctx_t* sdt_ctx = (srtp_sdt_sm4_ctx_t *)c->state;
-//////////////////close JMK ////////////////////////////////////////
+	srtp_err_status_t status = srtp_err_status_ok;
 	int rv;
 
-	if(SDR_OK!=(rv=SDF_DestroyKey(sdt_ctx->session_handle, sdt_ctx->hKeyHandle)))
-	{
-		printf("DestroyKey failed, error code=[0x%08x]\n",rv);
-		return srtp_err_status_dealloc_fail;
-	}
-
-	if(SDR_OK!=(rv=SDF_CloseSession(sdt_ctx->session_handle)))
-	{
-		printf("CloseSession failed, error code=[0x%08x]\n",rv);
-		return srtp_err_status_dealloc_fail;
-	}
-
-	if(SDR_OK!=(rv=SDF_CloseDevice(sdt_ctx->device_handle)))
-	{
-		printf("CloseDevice failed, error code=[0x%08x]\n",rv);
-		return srtp_err_status_dealloc_fail;
-	}
+	if (sdt_ctx) {
+		/* the key belongs to this cipher, the session goes back to the pool */
+		if (sdt_ctx->hKeyHandle != NULL &&
+			SDR_OK!=(rv=SDF_DestroyKey(sdt_ctx->session_handle, sdt_ctx->hKeyHandle)))
+		{
+			printf("DestroyKey failed, error code=[0x%08x]\n",rv);
+			status = srtp_err_status_dealloc_fail;
+		}
+		srtp_sdt_sdf_pool_release(sdt_ctx->session_handle);
 
-	printf("JMK close OK\n");
-//////////////////close JMK ////////////////////////////////////////
-
-    if (sdt_ctx) {
         /* zeroize the key material */
         octet_string_set_to_zero(sdt_ctx, sizeof(srtp_sdt_sm4_ctx_t));
         srtp_crypto_free(sdt_ctx);
@@ -309,7 +333,7 @@ static srtp_err_status_t srtp_sdt_cipher_dealloc (srtp_cipher_t *c)
     /* free memory of type null_cipher */
     srtp_crypto_free(c);
 
-    return srtp_err_status_ok;
+    return status;
 
 }
 
@@ -331,6 +355,12 @@ static srtp_err_status_t srtp_sdt_cipher_init (void *cv, const uint8_t *key)
 //    printf("\n");
 
 //	unsigned char pbKeyValue[16] = {0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10};
+	/* the session outlives this cipher, so a previous key must not leak into it */
+	if (sdt_ctx->hKeyHandle != NULL) {
+		SDF_DestroyKey(sdt_ctx->session_handle, sdt_ctx->hKeyHandle);
+		sdt_ctx->hKeyHandle = NULL;
+	}
+
 	rv = SDF_ImportKey(sdt_ctx->session_handle, key, 16, &(sdt_ctx->hKeyHandle));
 	if(rv != SDR_OK)
 	{
@@ -360,24 +390,23 @@ static srtp_err_status_t srtp_sdt_cipher_set_iv (void *cv, uint8_t *iv, srtp_cip
     return srtp_err_status_ok;
 }
 
-static srtp_err_status_t srtp_sdt_cipher_encrypt (void *cv,
-                                            unsigned char *buf, unsigned int *bytes_to_encr)
+/*
+ * runs the device cipher over buf in place.  the SDF interface updates
+ * pucIV after each call, so CBC and OFB keep chaining across the
+ * SRTP_SDT_MAX_CHUNK_LEN sized chunks of a long payload.
+ */
+static srtp_err_status_t srtp_sdt_cipher_crypt (srtp_sdt_sm4_ctx_t *sdt_ctx,
+                                                int encrypt,
+                                                unsigned char *buf, unsigned int len)
 {
-
-	srtp_sdt_sm4_ctx_t *sdt_ctx = (srtp_sdt_sm4_ctx_t *)cv;
-	//added sanweixinan JMK encrypt //
+	unsigned int AlgID;
+	unsigned int chunk_len;
+	SGD_UINT32 out_len;
 	int rv;
-	unsigned char pbTempData[2048] = {0};
-	unsigned int  ulTempDataLen;
 
-	if(*bytes_to_encr > 2048)
+	if(len % 16 !=0)
 		return srtp_err_status_bad_param;
 
-//	printf("to be encrypt is %02x, len=%d\n",buf,*bytes_to_encr);
-	if(*bytes_to_encr % 16 !=0)
-		return srtp_err_status_bad_param;
-
-	unsigned int AlgID;
 	switch(sdt_ctx->mode)
 	{
 	case SMS4_CBC:
@@ -390,63 +419,41 @@ static srtp_err_status_t srtp_sdt_cipher_encrypt (void *cv,
 		AlgID = SGD_SMS4_ECB;
 	}
 
-
-	rv = SDF_Encrypt(sdt_ctx->session_handle, sdt_ctx->hKeyHandle, AlgID, sdt_ctx->in_Iv, buf, *bytes_to_encr, pbTempData, &ulTempDataLen);
-	if(rv != SDR_OK)
-	{
-		printf("encrypto error，error[0x%08x]\n", rv);
-		return srtp_err_status_cipher_fail;
+	while (len > 0) {
+		chunk_len = len < SRTP_SDT_MAX_CHUNK_LEN ? len : SRTP_SDT_MAX_CHUNK_LEN;
+		out_len = chunk_len;
+
+		if (encrypt)
+			rv = SDF_Encrypt(sdt_ctx->session_handle, sdt_ctx->hKeyHandle, AlgID, sdt_ctx->in_Iv, buf, chunk_len, buf, &out_len);
+		else
+			rv = SDF_Decrypt(sdt_ctx->session_handle, sdt_ctx->hKeyHandle, AlgID, sdt_ctx->out_Iv, buf, chunk_len, buf, &out_len);
+		if(rv != SDR_OK)
+		{
+			printf("%s error，error[0x%08x]\n", encrypt ? "encrypto" : "decrypto", rv);
+			return srtp_err_status_cipher_fail;
+		}
+
+		/* no padding, so the device must hand back exactly what it was given */
+		if (out_len != chunk_len)
+			return srtp_err_status_cipher_fail;
+
+		buf += chunk_len;
+		len -= chunk_len;
 	}
-	memcpy(buf, pbTempData, ulTempDataLen);
-	*bytes_to_encr = ulTempDataLen;
 
-//	printf("sm4 encrypt success\n");
-    return srtp_err_status_ok;
+	return srtp_err_status_ok;
 }
 
-static srtp_err_status_t srtp_sdt_cipher_decrypt (void *cv,
+static srtp_err_status_t srtp_sdt_cipher_encrypt (void *cv,
                                             unsigned char *buf, unsigned int *bytes_to_encr)
 {
+	return srtp_sdt_cipher_crypt((srtp_sdt_sm4_ctx_t *)cv, 1, buf, *bytes_to_encr);
+}
 
-	srtp_sdt_sm4_ctx_t *sdt_ctx = (srtp_sdt_sm4_ctx_t *)cv;
-
-	unsigned char pbOutData[2048] = {0};
-	unsigned int  ulOutDataLen;
-	int rv;
-
-	if(*bytes_to_encr > 2048)
-		return srtp_err_status_bad_param;
-
-//	printf("to be decrypt is %02x, len=%d\n",buf,*bytes_to_encr);
-	if(*bytes_to_encr % 16 !=0)
-		return srtp_err_status_bad_param;
-
-
-	unsigned int AlgID;
-	switch(sdt_ctx->mode)
-	{
-	case SMS4_CBC:
-		AlgID = SGD_SMS4_CBC;
-		break;
-	case SMS4_OFB:
-		AlgID = SGD_SMS4_OFB;
-		break;
-	default:
-		AlgID = SGD_SMS4_ECB;
-	}
-
-	rv = SDF_Decrypt(sdt_ctx->session_handle, sdt_ctx->hKeyHandle, AlgID, sdt_ctx->out_Iv, buf, *bytes_to_encr, pbOutData, &ulOutDataLen);
-	if(rv != SDR_OK)
-	{
-		printf("decrypto error，error[0x%08x]\n", rv);
-		return srtp_err_status_cipher_fail;
-	}
-
-	memcpy(buf, pbOutData, ulOutDataLen);
-	*bytes_to_encr = ulOutDataLen;
-
-//	printf("sm4 decrypt success\n");
-    return srtp_err_status_ok;
+static srtp_err_status_t srtp_sdt_cipher_decrypt (void *cv,
+                                            unsigned char *buf, unsigned int *bytes_to_encr)
+{
+	return srtp_sdt_cipher_crypt((srtp_sdt_sm4_ctx_t *)cv, 0, buf, *bytes_to_encr);
 }
 
 static const char srtp_sdt_cipher_sm4_ecb_description[] = "sdt cipher sm4_ecb";
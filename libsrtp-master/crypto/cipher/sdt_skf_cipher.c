@@ -54,6 +54,7 @@
 #include "err.h"                /* for srtp_debug */
 #include "alloc.h"
 #include "skf.h"
+#include "openssl/sm3.h"      /* sm3() for check_hash */
 #define check_hash 					0
 #define sm3_hard					1
 #define INIT_APP_NAME             "SJW07A_SDT"
@@ -68,183 +69,6 @@ extern const srtp_cipher_type_t srtp_sdt_skf_SM4_ECB_DEC_cipher;
 extern const srtp_cipher_type_t srtp_sdt_skf_SM4_ECB_AUDIO_ENC_cipher;
 extern const srtp_cipher_type_t srtp_sdt_skf_SM4_ECB_AUDIO_DEC_cipher;
 extern const srtp_cipher_type_t srtp_sdt_skf_SM4_CBC_cipher;
-/*-----------------------------------------------------------------------------------------------------*/
-#define SM3_BLOCK_SIZE		64
-#define SM3_DIGEST_LENGTH	32
-#define cpu_to_be32(v) (((v)>>24) | (((v)>>8)&0xff00) | (((v)<<8)&0xff0000) | ((v)<<24))
-
-#define ROTATELEFT(X,n)  (((X)<<(n)) | ((X)>>(32-(n))))
-
-#define P0(x) ((x) ^  ROTATELEFT((x),9)  ^ ROTATELEFT((x),17))
-#define P1(x) ((x) ^  ROTATELEFT((x),15) ^ ROTATELEFT((x),23))
-
-#define FF0(x,y,z) ( (x) ^ (y) ^ (z))
-#define FF1(x,y,z) (((x) & (y)) | ( (x) & (z)) | ( (y) & (z)))
-
-#define GG0(x,y,z) ( (x) ^ (y) ^ (z))
-#define GG1(x,y,z) (((x) & (y)) | ( (~(x)) & (z)) )
-
-typedef struct {
-	uint32_t digest[8];
-	int nblocks;
-	unsigned char block[64];
-	int num;
-} sm3_ctx_t;
-
-void sm3_init(sm3_ctx_t *ctx)
-{
-	ctx->digest[0] = 0x7380166F;
-	ctx->digest[1] = 0x4914B2B9;
-	ctx->digest[2] = 0x172442D7;
-	ctx->digest[3] = 0xDA8A0600;
-	ctx->digest[4] = 0xA96F30BC;
-	ctx->digest[5] = 0x163138AA;
-	ctx->digest[6] = 0xE38DEE4D;
-	ctx->digest[7] = 0xB0FB0E4E;
-
-	ctx->nblocks = 0;
-	ctx->num = 0;
-}
-
-void sm3_update(sm3_ctx_t *ctx, const unsigned char* data, size_t data_len)
-{
-	if (ctx->num) {
-		unsigned int left = SM3_BLOCK_SIZE - ctx->num;
-		if (data_len < left) {
-			memcpy(ctx->block + ctx->num, data, data_len);
-			ctx->num += data_len;
-			return;
-		} else {
-			memcpy(ctx->block + ctx->num, data, left);
-			sm3_compress(ctx->digest, ctx->block);
-			ctx->nblocks++;
-			data += left;
-			data_len -= left;
-		}
-	}
-	while (data_len >= SM3_BLOCK_SIZE) {
-		sm3_compress(ctx->digest, data);
-		ctx->nblocks++;
-		data += SM3_BLOCK_SIZE;
-		data_len -= SM3_BLOCK_SIZE;
-	}
-	ctx->num = data_len;
-	if (data_len) {
-		memcpy(ctx->block, data, data_len);
-	}
-}
-
-void sm3_final(sm3_ctx_t *ctx, unsigned char *digest)
-{
-	int i;
-	uint32_t *pdigest = (uint32_t *)digest;
-	uint32_t *count = (uint32_t *)(ctx->block + SM3_BLOCK_SIZE - 8);
-
-	ctx->block[ctx->num] = 0x80;
-
-	if (ctx->num + 9 <= SM3_BLOCK_SIZE) {
-		memset(ctx->block + ctx->num + 1, 0, SM3_BLOCK_SIZE - ctx->num - 9);
-	} else {
-		memset(ctx->block + ctx->num + 1, 0, SM3_BLOCK_SIZE - ctx->num - 1);
-		sm3_compress(ctx->digest, ctx->block);
-		memset(ctx->block, 0, SM3_BLOCK_SIZE - 8);
-	}
-
-	count[0] = cpu_to_be32((ctx->nblocks) >> 23);
-	count[1] = cpu_to_be32((ctx->nblocks << 9) + (ctx->num << 3));
-
-	sm3_compress(ctx->digest, ctx->block);
-	for (i = 0; i < sizeof(ctx->digest)/sizeof(ctx->digest[0]); i++) {
-		pdigest[i] = cpu_to_be32(ctx->digest[i]);
-	}
-}
-
-
-
-
-void sm3_compress(uint32_t digest[8], const unsigned char block[64])
-{
-	int j;
-	uint32_t W[68], W1[64];
-	const uint32_t *pblock = (const uint32_t *)block;
-
-	uint32_t A = digest[0];
-	uint32_t B = digest[1];
-	uint32_t C = digest[2];
-	uint32_t D = digest[3];
-	uint32_t E = digest[4];
-	uint32_t F = digest[5];
-	uint32_t G = digest[6];
-	uint32_t H = digest[7];
-	uint32_t SS1,SS2,TT1,TT2,T[64];
-
-	for (j = 0; j < 16; j++) {
-		W[j] = cpu_to_be32(pblock[j]);
-	}
-	for (j = 16; j < 68; j++) {
-		W[j] = P1( W[j-16] ^ W[j-9] ^ ROTATELEFT(W[j-3],15)) ^ ROTATELEFT(W[j - 13],7 ) ^ W[j-6];;
-	}
-	for( j = 0; j < 64; j++) {
-		W1[j] = W[j] ^ W[j+4];
-	}
-
-	for(j =0; j < 16; j++) {
-
-		T[j] = 0x79CC4519;
-		SS1 = ROTATELEFT((ROTATELEFT(A,12) + E + ROTATELEFT(T[j],j)), 7);
-		SS2 = SS1 ^ ROTATELEFT(A,12);
-		TT1 = FF0(A,B,C) + D + SS2 + W1[j];
-		TT2 = GG0(E,F,G) + H + SS1 + W[j];
-		D = C;
-		C = ROTATELEFT(B,9);
-		B = A;
-		A = TT1;
-		H = G;
-		G = ROTATELEFT(F,19);
-		F = E;
-		E = P0(TT2);
-	}
-
-	for(j =16; j < 64; j++) {
-
-		T[j] = 0x7A879D8A;
-		SS1 = ROTATELEFT((ROTATELEFT(A,12) + E + ROTATELEFT(T[j],j)), 7);
-		SS2 = SS1 ^ ROTATELEFT(A,12);
-		TT1 = FF1(A,B,C) + D + SS2 + W1[j];
-		TT2 = GG1(E,F,G) + H + SS1 + W[j];
-		D = C;
-		C = ROTATELEFT(B,9);
-		B = A;
-		A = TT1;
-		H = G;
-		G = ROTATELEFT(F,19);
-		F = E;
-		E = P0(TT2);
-	}
-
-	digest[0] ^= A;
-	digest[1] ^= B;
-	digest[2] ^= C;
-	digest[3] ^= D;
-	digest[4] ^= E;
-	digest[5] ^= F;
-	digest[6] ^= G;
-	digest[7] ^= H;
-}
-
-void sm3(const unsigned char *msg, size_t msglen,
-	unsigned char dgst[SM3_DIGEST_LENGTH])
-{
-	sm3_ctx_t ctx;
-
-	sm3_init(&ctx);
-	sm3_update(&ctx, msg, msglen);
-	sm3_final(&ctx, dgst);
-
-	memset(&ctx, 0, sizeof(sm3_ctx_t));
-}
-
-/*-----------------------------------------------------------------------------------------------------*/
 
 static srtp_err_status_t srtp_sdt_skf_cipher_sm4_ecb_alloc (srtp_cipher_t **c, int key_len, int tlen)
 {
@@ -852,6 +676,43 @@ static srtp_err_status_t srtp_sdt_skf_cipher_set_iv (void *cv, uint8_t *iv, srtp
 
     return srtp_err_status_ok;
 }
+/*
+ * feeds buf to the key's update function in place, in chunks of at most
+ * SRTP_SDT_MAX_CHUNK_LEN; the device keeps the chaining state between
+ * update calls, so CBC continues across chunks
+ */
+static srtp_err_status_t srtp_sdt_skf_cipher_update (HANDLE hKeyHandle, int encrypt,
+                                                     unsigned char *buf, unsigned int len)
+{
+	ULONG skf_rv;
+	ULONG out_len;
+	unsigned int chunk_len;
+
+	while (len > 0) {
+		chunk_len = len < SRTP_SDT_MAX_CHUNK_LEN ? len : SRTP_SDT_MAX_CHUNK_LEN;
+		out_len = chunk_len;
+
+		if (encrypt)
+			skf_rv = SKF_EncryptUpdate(hKeyHandle, buf, chunk_len, buf, &out_len);
+		else
+			skf_rv = SKF_DecryptUpdate(hKeyHandle, buf, chunk_len, buf, &out_len);
+		if(skf_rv != SAR_OK)
+		{
+			printf("%s error，error[0x%08x]\n", encrypt ? "encrypt" : "decrypt", skf_rv);
+			return srtp_err_status_cipher_fail;
+		}
+
+		/* no padding, so the device must hand back exactly what it was given */
+		if (out_len != chunk_len)
+			return srtp_err_status_cipher_fail;
+
+		buf += chunk_len;
+		len -= chunk_len;
+	}
+
+	return srtp_err_status_ok;
+}
+
 //unsigned long int encrypt_count = 0;
 static srtp_err_status_t srtp_sdt_skf_cipher_encrypt (void *cv,
                                             unsigned char *buf, unsigned int *bytes_to_encr)
@@ -860,10 +721,7 @@ static srtp_err_status_t srtp_sdt_skf_cipher_encrypt (void *cv,
 	srtp_sdt_skf_sm4_ctx_t *sdt_skf_ctx = (srtp_sdt_skf_sm4_ctx_t *)cv;
 	//added sanweixinan JMK encrypt //
 	int skf_rv;
-	unsigned char pbTempData[2048] = {0};
-	ULONG ulTempDataLen;
-	if(*bytes_to_encr > 2048)
-		return srtp_err_status_bad_param;
+	srtp_err_status_t status;
 
 //	printf("to be encrypt len=%d\n", *bytes_to_encr);
 	if(*bytes_to_encr % 16 !=0)
@@ -937,26 +795,19 @@ static srtp_err_status_t srtp_sdt_skf_cipher_encrypt (void *cv,
 		return srtp_err_status_cipher_fail;
 	}
 
-	skf_rv = SKF_EncryptUpdate(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, pbTempData, &ulTempDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("encrypt error，error[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
+	status = srtp_sdt_skf_cipher_update(sdt_skf_ctx->hKeyHandle, 1, buf, *bytes_to_encr);
+	if (status)
+		return status;
 
 #if check_hash
-	memcpy(buf, pbTempData, ulTempDataLen);
 #if sm3_hard
-	memcpy(buf + ulTempDataLen, sdt_skf_ctx->HashData_enc, 32);
-	*bytes_to_encr = ulTempDataLen + 32;
+	memcpy(buf + *bytes_to_encr, sdt_skf_ctx->HashData_enc, 32);
+	*bytes_to_encr += 32;
 #else
-	memcpy(buf + ulTempDataLen, dgst, SM3_DIGEST_LENGTH);
-	*bytes_to_encr = ulTempDataLen + SM3_DIGEST_LENGTH;
+	memcpy(buf + *bytes_to_encr, dgst, SM3_DIGEST_LENGTH);
+	*bytes_to_encr += SM3_DIGEST_LENGTH;
 #endif
 //	printf("encrypt, output len = %d\n", *bytes_to_encr);
-#else
-	memcpy(buf, pbTempData, ulTempDataLen);
-	*bytes_to_encr = ulTempDataLen;
 #endif
 
 	if(sdt_skf_ctx->encrypt_count == 65535)
@@ -975,12 +826,8 @@ static srtp_err_status_t srtp_sdt_skf_cipher_decrypt (void *cv,
 
 	srtp_sdt_skf_sm4_ctx_t *sdt_skf_ctx = (srtp_sdt_skf_sm4_ctx_t *)cv;
 
-	unsigned char pbOutData[2048] = {0};
-	ULONG  ulOutDataLen;
 	int skf_rv;
-
-	if(*bytes_to_encr > 2048)
-		return srtp_err_status_bad_param;
+	srtp_err_status_t status;
 
 //	printf("to be decrypt len=%d\n", *bytes_to_encr);
 
@@ -1029,12 +876,9 @@ static srtp_err_status_t srtp_sdt_skf_cipher_decrypt (void *cv,
 		return srtp_err_status_cipher_fail;
 	}
 
-	skf_rv = SKF_DecryptUpdate(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, pbOutData, &ulOutDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("decrypt error，error[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
+	status = srtp_sdt_skf_cipher_update(sdt_skf_ctx->hKeyHandle, 0, buf, *bytes_to_encr);
+	if (status)
+		return status;
 
 #if check_hash
 #if sm3_hard
@@ -1044,7 +888,7 @@ static srtp_err_status_t srtp_sdt_skf_cipher_decrypt (void *cv,
 		printf("skf decrypt, SKF_DigestInit error, errorcode=[0x%08x]\n", skf_rv);
 		return srtp_err_status_cipher_fail;
 	}
-	skf_rv = SKF_DigestUpdate(sdt_skf_ctx->phHash, pbOutData, ulOutDataLen);
+	skf_rv = SKF_DigestUpdate(sdt_skf_ctx->phHash, buf, *bytes_to_encr);
 	if(skf_rv != SAR_OK)
 	{
 		printf("skf decrypt, SKF_DigestUpdate error, errorcode=[0x%08x]\n", skf_rv);
@@ -1078,7 +922,7 @@ static srtp_err_status_t srtp_sdt_skf_cipher_decrypt (void *cv,
 #else
 	unsigned char dgst[SM3_DIGEST_LENGTH];
 	memset(dgst, 0 , sizeof(dgst));
-	sm3(pbOutData, ulOutDataLen, dgst);
+	sm3(buf, *bytes_to_encr, dgst);
 
 	if(strncmp(dgst, sdt_skf_ctx->HashData_enc, 32) != 0)
 	{
@@ -1088,8 +932,6 @@ static srtp_err_status_t srtp_sdt_skf_cipher_decrypt (void *cv,
 #endif
 
 #endif
-	memcpy(buf, pbOutData, ulOutDataLen);
-	*bytes_to_encr = ulOutDataLen;
 
 	if(sdt_skf_ctx->decrypt_count == 65535)
 		sdt_skf_ctx->decrypt_count = 0;
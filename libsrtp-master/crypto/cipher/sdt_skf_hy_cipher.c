@@ -150,7 +150,7 @@ int Init_SDkey()
 //	printf("MaxECCBufferSize:%0x\n",dev_info.MaxECCBufferSize);
 //	printf("MaxBufferSize:%0x\n",dev_info.MaxBufferSize);
 
-	printf("--sdt skf hy get handle ok--\n");
+	debug_print(srtp_mod_cipher, "SD_key device handle opened", NULL);
 	get_hd = 1;
 	return 0;
 }
@@ -164,17 +164,97 @@ int Close_dev_handle()
 		skf_rv = SKF_DisConnectDev(hd_sd_hy);
 		if(skf_rv != SAR_OK)
 		{
-			printf("SKF_DisConnectDev error\n");
+			debug_print(srtp_mod_cipher, "SKF_DisConnectDev error 0x%08x", skf_rv);
 			return -1;
 		}
 		hd_sd_hy = NULL;
 		get_hd = 0;
 	}
-	printf("--sdt skf hy close handle ok--\n");
+	debug_print(srtp_mod_cipher, "SD_key device handle closed", NULL);
 	return 0;
 }
 /*---------------------------------------------------------------------------------------------*/
 
+#define SDT_SKF_HY_OP_NONE		0
+#define SDT_SKF_HY_OP_ENCRYPT	1
+#define SDT_SKF_HY_OP_DECRYPT	2
+
+/*
+ * runs the SD_key cipher from in to out, which may be the same buffer.
+ * SM4 without padding never changes the length, so there is no need to
+ * ask the device for the output size first.
+ *
+ * ECB has no chaining state, so its key context is initialised once and
+ * left open: each chunk is then a single update call.  CBC restarts from
+ * the packet IV, so each chunk of at most SRTP_SDT_MAX_CHUNK_LEN bytes is
+ * an init plus one finishing call, with the last ciphertext block of a
+ * chunk carried into the IV of the next.
+ */
+static srtp_err_status_t srtp_sdt_skf_hy_cipher_crypt (srtp_sdt_skf_hy_SM4_ctx_t *sdt_skf_ctx,
+                                                       int encrypt, unsigned char *in,
+                                                       unsigned char *out, unsigned int len)
+{
+	int op = encrypt ? SDT_SKF_HY_OP_ENCRYPT : SDT_SKF_HY_OP_DECRYPT;
+	BLOCKCIPHERPARAM param = encrypt ? sdt_skf_ctx->Param_in : sdt_skf_ctx->Param_out;
+	unsigned char next_iv[16];
+	unsigned int chunk_len;
+	ULONG out_len;
+	ULONG skf_rv;
+
+	while (len > 0) {
+		chunk_len = len < SRTP_SDT_MAX_CHUNK_LEN ? len : SRTP_SDT_MAX_CHUNK_LEN;
+
+		/* the device accepts SKF_EncryptInit for both directions */
+		if (sdt_skf_ctx->mode != SMS4_ECB || sdt_skf_ctx->op_ready != op) {
+			skf_rv = SKF_EncryptInit(sdt_skf_ctx->hKeyHandle, param);
+			if(skf_rv != SAR_OK)
+			{
+				sdt_skf_ctx->op_ready = SDT_SKF_HY_OP_NONE;
+				debug_print(srtp_mod_cipher, "SKF_EncryptInit error 0x%08x", skf_rv);
+				return srtp_err_status_cipher_fail;
+			}
+			sdt_skf_ctx->op_ready = op;
+		}
+
+		/* decrypting in place overwrites the ciphertext the next chunk chains on */
+		if (!encrypt && sdt_skf_ctx->mode == SMS4_CBC)
+			memcpy(next_iv, in + chunk_len - 16, 16);
+
+		out_len = chunk_len;
+		if (sdt_skf_ctx->mode == SMS4_ECB) {
+			if (encrypt)
+				skf_rv = SKF_EncryptUpdate(sdt_skf_ctx->hKeyHandle, in, chunk_len, out, &out_len);
+			else
+				skf_rv = SKF_DecryptUpdate(sdt_skf_ctx->hKeyHandle, in, chunk_len, out, &out_len);
+		} else {
+			if (encrypt)
+				skf_rv = SKF_Encrypt(sdt_skf_ctx->hKeyHandle, in, chunk_len, out, &out_len);
+			else
+				skf_rv = SKF_Decrypt(sdt_skf_ctx->hKeyHandle, in, chunk_len, out, &out_len);
+			sdt_skf_ctx->op_ready = SDT_SKF_HY_OP_NONE;
+		}
+		if(skf_rv != SAR_OK)
+		{
+			sdt_skf_ctx->op_ready = SDT_SKF_HY_OP_NONE;
+			debug_print2(srtp_mod_cipher, "%s error 0x%08x", encrypt ? "encrypt" : "decrypt", skf_rv);
+			return srtp_err_status_cipher_fail;
+		}
+
+		/* no padding, so the device must hand back exactly what it was given */
+		if (out_len != chunk_len)
+			return srtp_err_status_cipher_fail;
+
+		if (sdt_skf_ctx->mode == SMS4_CBC)
+			memcpy(param.IV, encrypt ? out + chunk_len - 16 : next_iv, 16);
+
+		in += chunk_len;
+		out += chunk_len;
+		len -= chunk_len;
+	}
+
+	return srtp_err_status_ok;
+}
+
 int Sdt_skf_hy_sd_crypt_init(void** cv, unsigned int ulAlgID, unsigned char *key, int enc)
 {
 	ULONG skf_rv;
@@ -182,13 +262,16 @@ int Sdt_skf_hy_sd_crypt_init(void** cv, unsigned int ulAlgID, unsigned char *key
 	*cv = ctx;
     if (ctx == NULL)
     {
-    	printf("srtp_sdt_skf_hy_SM4_ctx_t malloc failed\n");
+    	debug_print(srtp_mod_cipher, "srtp_sdt_skf_hy_SM4_ctx_t malloc failed", NULL);
         return -1;
     }
+    memset(ctx, 0, sizeof(srtp_sdt_skf_hy_SM4_ctx_t));
+    ctx->mode = (ulAlgID == SGD_SM4_CBC) ? SMS4_CBC : SMS4_ECB;
+
   	skf_rv = SKF_SetSymmKey(hd_sd_hy, (BYTE*)key, ulAlgID, &(ctx->hKeyHandle));
 	if(skf_rv != SAR_OK)
 	{
-		printf("skf, Import sm4 key error, errorcode=[0x%08x]\n", skf_rv);
+		debug_print(srtp_mod_cipher, "Import sm4 key error 0x%08x", skf_rv);
 		return -1;
 	}
 	if(enc)
@@ -218,7 +301,7 @@ void Sdt_skf_hy_sd_crypt_cleanup(void* cv)
 	skf_rv = SKF_CloseHandle(ctx->hKeyHandle);
 	if(skf_rv != SAR_OK)
 	{
-		printf("SKF_CloseHandle hKeyHandle error\n");
+		debug_print(srtp_mod_cipher, "SKF_CloseHandle hKeyHandle error 0x%08x", skf_rv);
 		return ;
 	}
 
@@ -228,75 +311,123 @@ void Sdt_skf_hy_sd_crypt_cleanup(void* cv)
 //		ctx = NULL;
 	}
 }
-//unsigned long int Length_to_enc = 0;
 int Sdt_skf_hy_sd_encrypt(void* cv, unsigned char *plain, unsigned int palin_len, unsigned char *enc, unsigned int* enc_len)
 {
-	ULONG skf_rv;
 	srtp_sdt_skf_hy_SM4_ctx_t* ctx = (srtp_sdt_skf_hy_SM4_ctx_t*)cv;
-	printf("Sdt_skf_hy_sd_encrypt, 111, plain_len = %d\n", palin_len);
-//for test
-//	Length_to_enc += palin_len;
-//	printf("Length_to_enc = %ld\n", Length_to_enc);
-	skf_rv = SKF_EncryptInit(ctx->hKeyHandle, ctx->Param_in);
-	if(skf_rv != SAR_OK)
-	{
-		printf("skf encrypt, SKF_EncryptInit error, errorcode=[0x%08x]\n", skf_rv);
-		return -1;
-	}
-	printf("Sdt_skf_hy_sd_encrypt, 222\n");
-	skf_rv = SKF_Encrypt(ctx->hKeyHandle, plain, palin_len, NULL, enc_len);
-	if(skf_rv != SAR_OK)
-	{
-		printf("encrypt 1 error，error[0x%08x]\n", skf_rv);
-		return -1;
-	}
-	printf("Sdt_skf_hy_sd_encrypt, 333\n");
-	skf_rv = SKF_Encrypt(ctx->hKeyHandle, plain, palin_len, enc, enc_len);
-	if(skf_rv != SAR_OK)
-	{
-		printf("encrypt 2 error，error[0x%08x]\n", skf_rv);
+
+	if (srtp_sdt_skf_hy_cipher_crypt(ctx, 1, plain, enc, palin_len) != srtp_err_status_ok)
 		return -1;
-	}
+	*enc_len = palin_len;
+
 	if(ctx->encrypt_count == 65535)
 		ctx->encrypt_count = 0;
 	++(ctx->encrypt_count);
-	if(ctx->encrypt_count % 5000 == 0)
-		printf("Sdt_skf_hy_sd_encrypt success, encrypt_count = %d\n", ctx->encrypt_count);
+	if(ctx->encrypt_count % 5000 == 0) {
+		debug_print(srtp_mod_cipher, "Sdt_skf_hy_sd_encrypt %lu packets", ctx->encrypt_count);
+	}
 	return 0;
 }
 
 int Sdt_skf_hy_sd_decrypt(void *cv, unsigned char *enc, unsigned int enc_len, unsigned char *dec, unsigned int* dec_len)
 {
-	ULONG skf_rv;
 	srtp_sdt_skf_hy_SM4_ctx_t* ctx = (srtp_sdt_skf_hy_SM4_ctx_t*)cv;
-	skf_rv = SKF_EncryptInit(ctx->hKeyHandle, ctx->Param_out);
-	if(skf_rv != SAR_OK)
-	{
-		printf("skf, SKF_EncryptInit error, errorcode=[0x%08x]\n", skf_rv);
-		return -1;
-	}
 
-	skf_rv = SKF_Decrypt(ctx->hKeyHandle, enc, enc_len, NULL, dec_len);
-	if(skf_rv != SAR_OK)
-	{
-		printf("decrypt 1 error，error[0x%08x]\n", skf_rv);
+	if (srtp_sdt_skf_hy_cipher_crypt(ctx, 0, enc, dec, enc_len) != srtp_err_status_ok)
 		return -1;
-	}
+	*dec_len = enc_len;
 
-	skf_rv = SKF_Decrypt(ctx->hKeyHandle, enc, enc_len, dec, dec_len);
-	if(skf_rv != SAR_OK)
-	{
-		printf("decrypt 2 error，error[0x%08x]\n", skf_rv);
-		return -1;
-	}
 	if(ctx->decrypt_count == 65535)
 		ctx->decrypt_count = 0;
 	++(ctx->decrypt_count);
-	if(ctx->decrypt_count % 5000 == 0)
-		printf("Sdt_skf_hy_sd_decrypt success, decrypt_count = %d\n", ctx->decrypt_count);
+	if(ctx->decrypt_count % 5000 == 0) {
+		debug_print(srtp_mod_cipher, "Sdt_skf_hy_sd_decrypt %lu packets", ctx->decrypt_count);
+	}
 	return 0;
 }
 
+/*
+ * hands the entries lo..hi-1, staged back to back in buf, to the device
+ * in one call and copies the results back into the packets
+ */
+static srtp_err_status_t srtp_sdt_skf_hy_ecb_flush (srtp_sdt_skf_hy_SM4_ctx_t *sdt_skf_ctx, int encrypt,
+                                                    unsigned char *buf, unsigned int staged,
+                                                    srtp_cipher_batch_entry_t *entries,
+                                                    unsigned int lo, unsigned int hi)
+{
+	srtp_err_status_t status;
+	unsigned int i;
+
+	if (staged == 0)
+		return srtp_err_status_ok;
+
+	status = srtp_sdt_skf_hy_cipher_crypt(sdt_skf_ctx, encrypt, buf, buf, staged);
+	for (i = lo; i < hi; i++) {
+		if (entries[i].len == 0 || entries[i].status != srtp_err_status_ok)
+			continue;
+		if (status == srtp_err_status_ok)
+			memcpy(entries[i].buffer, buf, entries[i].len);
+		entries[i].status = status;
+		buf += entries[i].len;
+	}
+	return status;
+}
+
+/*
+ * ECB packets carry no IV, so the payloads of a whole batch are
+ * concatenated and submitted together, SRTP_SDT_MAX_CHUNK_LEN bytes per
+ * device call, instead of paying the SD_key round trip per packet.
+ * payloads longer than a chunk go to the device directly, in place.
+ */
+static srtp_err_status_t srtp_sdt_skf_hy_cipher_ecb_batch (void *cv,
+                                                           srtp_cipher_batch_entry_t *entries,
+                                                           unsigned int num_entries,
+                                                           srtp_cipher_direction_t dir)
+{
+	srtp_sdt_skf_hy_SM4_ctx_t *sdt_skf_ctx = (srtp_sdt_skf_hy_SM4_ctx_t *)cv;
+	unsigned char staged[SRTP_SDT_MAX_CHUNK_LEN];
+	int encrypt = (dir != srtp_direction_decrypt);
+	srtp_err_status_t status, first = srtp_err_status_ok;
+	unsigned int i, lo = 0, len = 0;
+
+	for (i = 0; i < num_entries; i++) {
+		entries[i].status = srtp_err_status_ok;
+		if (entries[i].len % 16 != 0) {
+			debug_print(srtp_mod_cipher, "batch length %u is not a multiple of 16", entries[i].len);
+			entries[i].status = srtp_err_status_bad_param;
+			if (!first)
+				first = srtp_err_status_bad_param;
+			continue;
+		}
+
+		if (len + entries[i].len > SRTP_SDT_MAX_CHUNK_LEN) {
+			status = srtp_sdt_skf_hy_ecb_flush(sdt_skf_ctx, encrypt, staged, len, entries, lo, i);
+			if (status && !first)
+				first = status;
+			lo = i;
+			len = 0;
+		}
+
+		if (entries[i].len > SRTP_SDT_MAX_CHUNK_LEN) {
+			status = srtp_sdt_skf_hy_cipher_crypt(sdt_skf_ctx, encrypt, entries[i].buffer,
+			                                      entries[i].buffer, entries[i].len);
+			entries[i].status = status;
+			if (status && !first)
+				first = status;
+			lo = i + 1;
+			continue;
+		}
+
+		memcpy(staged + len, entries[i].buffer, entries[i].len);
+		len += entries[i].len;
+	}
+	status = srtp_sdt_skf_hy_ecb_flush(sdt_skf_ctx, encrypt, staged, len, entries, lo, num_entries);
+	if (status && !first)
+		first = status;
+
+	octet_string_set_to_zero(staged, sizeof(staged));
+	return first;
+}
+
 /*---------------------------------------------------------------------------------------------*/
 //
 static srtp_err_status_t srtp_sdt_skf_hy_cipher_sm4_ecb_alloc (srtp_cipher_t **c, int key_len, int tlen)
@@ -342,7 +473,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_sm4_ecb_alloc (srtp_cipher_t **c
 //    		printf("ecb mode get sdt skf hy handle failed\n");
 //    }
 
-	printf("SDT_SKF SD_key ECB mode init ok\n");
+	debug_print(srtp_mod_cipher, "SD_key ECB mode allocated", NULL);
     return srtp_err_status_ok;
 }
 
@@ -393,7 +524,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_sm4_cbc_alloc (srtp_cipher_t **c
 //    		printf("cbc mode get sdt skf hy handle failed\n");
 //    }
 
-	printf("SDT_SKF SD_key CBC mode init ok\n");
+	debug_print(srtp_mod_cipher, "SD_key CBC mode allocated", NULL);
 
     return srtp_err_status_ok;
 
@@ -408,7 +539,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_dealloc (srtp_cipher_t *c)
 	skf_rv = SKF_CloseHandle(sdt_skf_ctx->hKeyHandle);
 	if(skf_rv != SAR_OK)
 	{
-		printf("SKF_CloseHandle hKeyHandle error\n");
+		debug_print(srtp_mod_cipher, "SKF_CloseHandle hKeyHandle error 0x%08x", skf_rv);
 		return srtp_err_status_dealloc_fail;
 	}
 //	printf("SKF_CloseHandle hKeyHandle ok, index_count = %d\n", sdt_skf_ctx->count_index);
@@ -494,7 +625,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_init (void *cv, const uint8_t *k
   	skf_rv = SKF_SetSymmKey(hd_sd_hy, (BYTE*)key, ulAlgID, &(sdt_skf_ctx->hKeyHandle));
 	if(skf_rv != SAR_OK)
 	{
-		printf("skf, Import sm4 key error, errorcode=[0x%08x]\n", skf_rv);
+		debug_print(srtp_mod_cipher, "Import sm4 key error 0x%08x", skf_rv);
 		return srtp_err_status_init_fail;
 	}
 //	++(sdt_skf_ctx->count_index);
@@ -512,6 +643,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_init (void *cv, const uint8_t *k
 	}
 #endif
 
+	sdt_skf_ctx->op_ready = SDT_SKF_HY_OP_NONE;
 	sdt_skf_ctx->encrypt_count = 0;
 	sdt_skf_ctx->decrypt_count = 0;
 
@@ -558,15 +690,12 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_encrypt (void *cv,
 	srtp_sdt_skf_hy_SM4_ctx_t *sdt_skf_ctx = (srtp_sdt_skf_hy_SM4_ctx_t *)cv;
 	//added sanweixinan JMK encrypt //
 	int skf_rv;
-	unsigned char pbTempData[2048] = {0};
-	ULONG ulTempDataLen;
-	if(*bytes_to_encr > 2048)
-		return srtp_err_status_bad_param;
+	srtp_err_status_t status;
 
 //	printf("to be encrypt len=%d\n", *bytes_to_encr);
 	if(*bytes_to_encr % 16 !=0)
 	{
-		printf("enc_len = %d, encrypt len error\n", *bytes_to_encr);
+		debug_print(srtp_mod_cipher, "encrypt length %u is not a multiple of 16", *bytes_to_encr);
 		return srtp_err_status_bad_param;
 	}
 
@@ -628,47 +757,27 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_encrypt (void *cv,
 //  get the sm3 hash of plaintext, added by bruce, end
 #endif
 
-	skf_rv = SKF_EncryptInit(sdt_skf_ctx->hKeyHandle, sdt_skf_ctx->Param_in);
-	if(skf_rv != SAR_OK)
-	{
-		printf("skf encrypt, SKF_EncryptInit error, errorcode=[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
-
-	skf_rv = SKF_Encrypt(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, NULL, &ulTempDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("encrypt 1 error，error[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
-
-	skf_rv = SKF_Encrypt(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, pbTempData, &ulTempDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("encrypt 2 error，error[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
+	status = srtp_sdt_skf_hy_cipher_crypt(sdt_skf_ctx, 1, buf, buf, *bytes_to_encr);
+	if (status)
+		return status;
 
 #if check_hash
-	memcpy(buf, pbTempData, ulTempDataLen);
 #if sm3_hard
-	memcpy(buf + ulTempDataLen, sdt_skf_ctx->HashData_enc, 32);
-	*bytes_to_encr = ulTempDataLen + 32;
+	memcpy(buf + *bytes_to_encr, sdt_skf_ctx->HashData_enc, 32);
+	*bytes_to_encr += 32;
 #else
-	memcpy(buf + ulTempDataLen, dgst, SM3_DIGEST_LENGTH);
-	*bytes_to_encr = ulTempDataLen + SM3_DIGEST_LENGTH;
+	memcpy(buf + *bytes_to_encr, dgst, SM3_DIGEST_LENGTH);
+	*bytes_to_encr += SM3_DIGEST_LENGTH;
 #endif
 //	printf("encrypt, output len = %d\n", *bytes_to_encr);
-#else
-	memcpy(buf, pbTempData, ulTempDataLen);
-	*bytes_to_encr = ulTempDataLen;
 #endif
 
 	if(sdt_skf_ctx->encrypt_count == 65535)
 		sdt_skf_ctx->encrypt_count = 0;
 	++(sdt_skf_ctx->encrypt_count);
-	if(sdt_skf_ctx->encrypt_count % 5000 == 0)
-		printf("skf sm4 encrypt %ld packets success\n", sdt_skf_ctx->encrypt_count);
+	if(sdt_skf_ctx->encrypt_count % 5000 == 0) {
+		debug_print(srtp_mod_cipher, "skf sm4 encrypt %lu packets", sdt_skf_ctx->encrypt_count);
+	}
 
 //	printf("skf sm4 encrypt success\n");
     return srtp_err_status_ok;
@@ -680,12 +789,8 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 
 	srtp_sdt_skf_hy_SM4_ctx_t *sdt_skf_ctx = (srtp_sdt_skf_hy_SM4_ctx_t *)cv;
 
-	unsigned char pbOutData[2048] = {0};
-	ULONG  ulOutDataLen;
 	int skf_rv;
-
-	if(*bytes_to_encr > 2048)
-		return srtp_err_status_bad_param;
+	srtp_err_status_t status;
 
 //	printf("to be decrypt len=%d\n", *bytes_to_encr);
 
@@ -713,7 +818,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 #endif
 	if((*bytes_to_encr) % 16 !=0)
 	{
-		printf("dec_len = %d, decrypt length error\n", *bytes_to_encr);
+		debug_print(srtp_mod_cipher, "decrypt length %u is not a multiple of 16", *bytes_to_encr);
 		return srtp_err_status_bad_param;
 	}
 
@@ -727,28 +832,9 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 		ulAlgID = SGD_SM4_ECB;
 	}
 
-	skf_rv = SKF_EncryptInit(sdt_skf_ctx->hKeyHandle, sdt_skf_ctx->Param_out);
-	if(skf_rv != SAR_OK)
-	{
-		printf("skf, SKF_EncryptInit error, errorcode=[0x%08x]\n", skf_rv);
-		return srtp_err_status_cipher_fail;
-	}
-
-	skf_rv = SKF_Decrypt(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, NULL, &ulOutDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("decrypt 1 error，error[0x%08x]\n", skf_rv);
-		exit(-1);
-		return srtp_err_status_cipher_fail;
-	}
-
-	skf_rv = SKF_Decrypt(sdt_skf_ctx->hKeyHandle, buf, *bytes_to_encr, pbOutData, &ulOutDataLen);
-	if(skf_rv != SAR_OK)
-	{
-		printf("decrypt 2 error，error[0x%08x]\n", skf_rv);
-		exit(-1);
-		return srtp_err_status_cipher_fail;
-	}
+	status = srtp_sdt_skf_hy_cipher_crypt(sdt_skf_ctx, 0, buf, buf, *bytes_to_encr);
+	if (status)
+		return status;
 
 #if check_hash
 #if sm3_hard
@@ -758,7 +844,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 		printf("skf decrypt, SKF_DigestInit error, errorcode=[0x%08x]\n", skf_rv);
 		return srtp_err_status_cipher_fail;
 	}
-	skf_rv = SKF_DigestUpdate(sdt_skf_ctx->phHash, pbOutData, ulOutDataLen);
+	skf_rv = SKF_DigestUpdate(sdt_skf_ctx->phHash, buf, *bytes_to_encr);
 	if(skf_rv != SAR_OK)
 	{
 		printf("skf decrypt, SKF_DigestUpdate error, errorcode=[0x%08x]\n", skf_rv);
@@ -792,7 +878,7 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 #else
 	unsigned char dgst[SM3_DIGEST_LENGTH];
 	memset(dgst, 0 , sizeof(dgst));
-	sm3(pbOutData, ulOutDataLen, dgst);
+	sm3(buf, *bytes_to_encr, dgst);
 
 	if(strncmp(dgst, sdt_skf_ctx->HashData_enc, 32) != 0)
 	{
@@ -802,14 +888,13 @@ static srtp_err_status_t srtp_sdt_skf_hy_cipher_decrypt (void *cv,
 #endif
 
 #endif
-	memcpy(buf, pbOutData, ulOutDataLen);
-	*bytes_to_encr = ulOutDataLen;
 
 	if(sdt_skf_ctx->decrypt_count == 65535)
 		sdt_skf_ctx->decrypt_count = 0;
 	++(sdt_skf_ctx->decrypt_count);
-	if(sdt_skf_ctx->decrypt_count % 5000 == 0)
-		printf("skf sm4 decrypt %ld packets success\n", sdt_skf_ctx->decrypt_count);
+	if(sdt_skf_ctx->decrypt_count % 5000 == 0) {
+		debug_print(srtp_mod_cipher, "skf sm4 decrypt %lu packets", sdt_skf_ctx->decrypt_count);
+	}
 //	printf("skf sm4 decrypt success\n");
     return srtp_err_status_ok;
 }
@@ -885,7 +970,8 @@ const srtp_cipher_type_t srtp_sdt_skf_hy_SM4_ECB_cipher = {
     0,                     /* get_tag */
     srtp_sdt_skf_hy_cipher_sm4_ecb_description,
     &srtp_sdt_cipher_sm4_ecb_test_0,
-    SRTP_SDT_SKF_HY_SM4_ECB
+    SRTP_SDT_SKF_HY_SM4_ECB,
+    srtp_sdt_skf_hy_cipher_ecb_batch
 };
 
 const srtp_cipher_type_t srtp_sdt_skf_hy_SM4_CBC_cipher = {
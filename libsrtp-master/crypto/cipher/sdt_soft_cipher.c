@@ -0,0 +1,724 @@
+/*
+ * sdt_soft_cipher.c
+ *
+ * software SM4 cipher in ECB, CBC, OFB and CTR mode.  The block
+ * function comes from GmSSL's sms4 module; sms4_encrypt_8blocks()
+ * selects the AVX2 kernel at runtime when the CPU supports it.
+ *
+ * The ECB, CBC and OFB ciphers reset their chaining value to zero on
+ * every set_iv, exactly like the SDF/SKF device ciphers, so that the
+ * output matches the hardware byte for byte and either side of a call
+ * may run without a crypto card.
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2017 Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+    #include <config.h>
+#endif
+
+#include "datatypes.h"
+#include "sdt_soft_cipher.h"
+#include "err.h"                /* for srtp_debug */
+#include "alloc.h"
+
+
+/* the sdt_soft cipher uses the cipher debug module  */
+extern srtp_debug_module_t srtp_mod_cipher;
+
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_ECB_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_CBC_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_OFB_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_CTR_cipher;
+
+static srtp_err_status_t srtp_sdt_soft_cipher_alloc (srtp_cipher_t **c,
+                                                     int key_len,
+                                                     sdt_sm4_mode mode,
+                                                     int algorithm,
+                                                     const srtp_cipher_type_t *type)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx;
+
+    debug_print(srtp_mod_cipher,
+                "allocating cipher with key length %d", key_len);
+
+    if (key_len != SRTP_SDT_SM4_KEY_LEN) {
+        return srtp_err_status_bad_param;
+    }
+
+    *c = (srtp_cipher_t *)srtp_crypto_alloc(sizeof(srtp_cipher_t));
+    if (*c == NULL) {
+        return srtp_err_status_alloc_fail;
+    }
+    memset(*c, 0x0, sizeof(srtp_cipher_t));
+
+    soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)srtp_crypto_alloc(sizeof(srtp_sdt_soft_sm4_ctx_t));
+    if (soft_ctx == NULL) {
+        srtp_crypto_free(*c);
+        *c = NULL;
+        return srtp_err_status_alloc_fail;
+    }
+    memset(soft_ctx, 0x0, sizeof(srtp_sdt_soft_sm4_ctx_t));
+    soft_ctx->mode = mode;
+
+    /* set pointers */
+    (*c)->state = soft_ctx;
+    (*c)->algorithm = algorithm;
+    (*c)->type = type;
+
+    /* set key size */
+    (*c)->key_len = key_len;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_sm4_ecb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_soft_cipher_alloc(c, key_len, SMS4_ECB, SRTP_SDT_SOFT_SM4_ECB,
+                                      &srtp_sdt_soft_SM4_ECB_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_sm4_cbc_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_soft_cipher_alloc(c, key_len, SMS4_CBC, SRTP_SDT_SOFT_SM4_CBC,
+                                      &srtp_sdt_soft_SM4_CBC_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_sm4_ofb_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_soft_cipher_alloc(c, key_len, SMS4_OFB, SRTP_SDT_SOFT_SM4_OFB,
+                                      &srtp_sdt_soft_SM4_OFB_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_sm4_ctr_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    return srtp_sdt_soft_cipher_alloc(c, key_len, SMS4_CTR, SRTP_SDT_SOFT_SM4_CTR,
+                                      &srtp_sdt_soft_SM4_CTR_cipher);
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_dealloc (srtp_cipher_t *c)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)c->state;
+
+    if (soft_ctx) {
+        /* zeroize the key material */
+        octet_string_set_to_zero(soft_ctx, sizeof(srtp_sdt_soft_sm4_ctx_t));
+        srtp_crypto_free(soft_ctx);
+    }
+
+    /* zeroize entire state*/
+    octet_string_set_to_zero(c, sizeof(srtp_cipher_t));
+
+    srtp_crypto_free(c);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_init (void *cv, const uint8_t *key)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)cv;
+
+    debug_print(srtp_mod_cipher, "initializing sdt soft cipher", NULL);
+
+    /*
+     * both schedules are expanded here, since the init call does not
+     * tell us which direction the cipher will be used in
+     */
+    sms4_set_encrypt_key(&soft_ctx->enc_key, key);
+    sms4_set_decrypt_key(&soft_ctx->dec_key, key);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_set_iv (void *cv, uint8_t *iv, srtp_cipher_direction_t dir)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)cv;
+
+    if (soft_ctx->mode == SMS4_CTR) {
+        memcpy(soft_ctx->iv, iv, SMS4_BLOCK_SIZE);
+    } else {
+        /* the device ciphers always restart from a zero IV */
+        memset(soft_ctx->iv, 0, SMS4_BLOCK_SIZE);
+    }
+
+    return srtp_err_status_ok;
+}
+
+static void srtp_sdt_soft_xor_block (uint8_t *out, const uint8_t *in)
+{
+    int i;
+
+    for (i = 0; i < SMS4_BLOCK_SIZE; i++) {
+        out[i] ^= in[i];
+    }
+}
+
+/* increment the 128-bit big-endian counter block */
+static void srtp_sdt_soft_ctr_inc (uint8_t *ctr)
+{
+    int i;
+
+    for (i = SMS4_BLOCK_SIZE - 1; i >= 0; i--) {
+        if (++ctr[i] != 0) {
+            break;
+        }
+    }
+}
+
+static void srtp_sdt_soft_ecb (const sms4_key_t *key, uint8_t *buf, unsigned int len)
+{
+    while (len >= SRTP_SDT_SOFT_SM4_BATCH_OCTETS) {
+        sms4_encrypt_8blocks(buf, buf, key);
+        buf += SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+        len -= SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+    }
+    while (len >= SMS4_BLOCK_SIZE) {
+        sms4_encrypt(buf, buf, key);
+        buf += SMS4_BLOCK_SIZE;
+        len -= SMS4_BLOCK_SIZE;
+    }
+}
+
+static void srtp_sdt_soft_cbc_encrypt (srtp_sdt_soft_sm4_ctx_t *soft_ctx,
+                                       uint8_t *buf, unsigned int len)
+{
+    const uint8_t *iv = soft_ctx->iv;
+
+    /* CBC encryption is inherently serial */
+    while (len >= SMS4_BLOCK_SIZE) {
+        srtp_sdt_soft_xor_block(buf, iv);
+        sms4_encrypt(buf, buf, &soft_ctx->enc_key);
+        iv = buf;
+        buf += SMS4_BLOCK_SIZE;
+        len -= SMS4_BLOCK_SIZE;
+    }
+    if (iv != soft_ctx->iv) {
+        memcpy(soft_ctx->iv, iv, SMS4_BLOCK_SIZE);
+    }
+}
+
+static void srtp_sdt_soft_cbc_decrypt (srtp_sdt_soft_sm4_ctx_t *soft_ctx,
+                                       uint8_t *buf, unsigned int len)
+{
+    uint8_t saved[SRTP_SDT_SOFT_SM4_BATCH_OCTETS];
+    int i;
+
+    /*
+     * CBC decryption runs the block function on independent ciphertext
+     * blocks, so it is done eight at a time; the ciphertext is saved
+     * first because it is the chaining value for the next block
+     */
+    while (len >= SRTP_SDT_SOFT_SM4_BATCH_OCTETS) {
+        memcpy(saved, buf, SRTP_SDT_SOFT_SM4_BATCH_OCTETS);
+        sms4_encrypt_8blocks(buf, buf, &soft_ctx->dec_key);
+        srtp_sdt_soft_xor_block(buf, soft_ctx->iv);
+        for (i = 1; i < SRTP_SDT_SOFT_SM4_BATCH_BLOCKS; i++) {
+            srtp_sdt_soft_xor_block(buf + i * SMS4_BLOCK_SIZE,
+                                    saved + (i - 1) * SMS4_BLOCK_SIZE);
+        }
+        memcpy(soft_ctx->iv, saved + SRTP_SDT_SOFT_SM4_BATCH_OCTETS - SMS4_BLOCK_SIZE,
+               SMS4_BLOCK_SIZE);
+        buf += SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+        len -= SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+    }
+    while (len >= SMS4_BLOCK_SIZE) {
+        memcpy(saved, buf, SMS4_BLOCK_SIZE);
+        sms4_decrypt(buf, buf, &soft_ctx->dec_key);
+        srtp_sdt_soft_xor_block(buf, soft_ctx->iv);
+        memcpy(soft_ctx->iv, saved, SMS4_BLOCK_SIZE);
+        buf += SMS4_BLOCK_SIZE;
+        len -= SMS4_BLOCK_SIZE;
+    }
+    octet_string_set_to_zero(saved, sizeof(saved));
+}
+
+static void srtp_sdt_soft_ofb (srtp_sdt_soft_sm4_ctx_t *soft_ctx,
+                               uint8_t *buf, unsigned int len)
+{
+    unsigned int i;
+
+    while (len > 0) {
+        unsigned int n = len < SMS4_BLOCK_SIZE ? len : SMS4_BLOCK_SIZE;
+
+        sms4_encrypt(soft_ctx->iv, soft_ctx->iv, &soft_ctx->enc_key);
+        for (i = 0; i < n; i++) {
+            buf[i] ^= soft_ctx->iv[i];
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+static void srtp_sdt_soft_ctr (srtp_sdt_soft_sm4_ctx_t *soft_ctx,
+                               uint8_t *buf, unsigned int len)
+{
+    uint8_t keystream[SRTP_SDT_SOFT_SM4_BATCH_OCTETS];
+    unsigned int i;
+
+    /* counter blocks are independent, so the keystream is made in batches */
+    while (len > 0) {
+        unsigned int n = len < SRTP_SDT_SOFT_SM4_BATCH_OCTETS ?
+                         len : SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+        unsigned int blocks = (n + SMS4_BLOCK_SIZE - 1) / SMS4_BLOCK_SIZE;
+
+        for (i = 0; i < blocks; i++) {
+            memcpy(keystream + i * SMS4_BLOCK_SIZE, soft_ctx->iv, SMS4_BLOCK_SIZE);
+            srtp_sdt_soft_ctr_inc(soft_ctx->iv);
+        }
+        if (blocks == SRTP_SDT_SOFT_SM4_BATCH_BLOCKS) {
+            sms4_encrypt_8blocks(keystream, keystream, &soft_ctx->enc_key);
+        } else {
+            for (i = 0; i < blocks; i++) {
+                sms4_encrypt(keystream + i * SMS4_BLOCK_SIZE,
+                             keystream + i * SMS4_BLOCK_SIZE, &soft_ctx->enc_key);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            buf[i] ^= keystream[i];
+        }
+        buf += n;
+        len -= n;
+    }
+    octet_string_set_to_zero(keystream, sizeof(keystream));
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_encrypt (void *cv,
+                                                       unsigned char *buf, unsigned int *bytes_to_encr)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)cv;
+
+    switch (soft_ctx->mode) {
+    case SMS4_ECB:
+        if (*bytes_to_encr % SMS4_BLOCK_SIZE != 0) {
+            return srtp_err_status_bad_param;
+        }
+        srtp_sdt_soft_ecb(&soft_ctx->enc_key, buf, *bytes_to_encr);
+        break;
+    case SMS4_CBC:
+        if (*bytes_to_encr % SMS4_BLOCK_SIZE != 0) {
+            return srtp_err_status_bad_param;
+        }
+        srtp_sdt_soft_cbc_encrypt(soft_ctx, buf, *bytes_to_encr);
+        break;
+    case SMS4_OFB:
+        srtp_sdt_soft_ofb(soft_ctx, buf, *bytes_to_encr);
+        break;
+    case SMS4_CTR:
+        srtp_sdt_soft_ctr(soft_ctx, buf, *bytes_to_encr);
+        break;
+    default:
+        return srtp_err_status_bad_param;
+    }
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_sdt_soft_cipher_decrypt (void *cv,
+                                                       unsigned char *buf, unsigned int *bytes_to_encr)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)cv;
+
+    switch (soft_ctx->mode) {
+    case SMS4_ECB:
+        if (*bytes_to_encr % SMS4_BLOCK_SIZE != 0) {
+            return srtp_err_status_bad_param;
+        }
+        srtp_sdt_soft_ecb(&soft_ctx->dec_key, buf, *bytes_to_encr);
+        break;
+    case SMS4_CBC:
+        if (*bytes_to_encr % SMS4_BLOCK_SIZE != 0) {
+            return srtp_err_status_bad_param;
+        }
+        srtp_sdt_soft_cbc_decrypt(soft_ctx, buf, *bytes_to_encr);
+        break;
+    case SMS4_OFB:
+        srtp_sdt_soft_ofb(soft_ctx, buf, *bytes_to_encr);
+        break;
+    case SMS4_CTR:
+        srtp_sdt_soft_ctr(soft_ctx, buf, *bytes_to_encr);
+        break;
+    default:
+        return srtp_err_status_bad_param;
+    }
+
+    return srtp_err_status_ok;
+}
+
+/*
+ * ECB has no chaining value, so the blocks of all packets in a batch are
+ * independent; the whole-batch runs of each packet are done in place and
+ * the remaining blocks of several packets are staged together so that
+ * short (audio) payloads also go through the eight block kernel
+ */
+static srtp_err_status_t srtp_sdt_soft_cipher_ecb_batch (void *cv,
+                                                         srtp_cipher_batch_entry_t *entries,
+                                                         unsigned int num_entries,
+                                                         srtp_cipher_direction_t dir)
+{
+    srtp_sdt_soft_sm4_ctx_t *soft_ctx = (srtp_sdt_soft_sm4_ctx_t *)cv;
+    const sms4_key_t *key;
+    uint8_t staged[SRTP_SDT_SOFT_SM4_BATCH_OCTETS];
+    uint8_t *owner[SRTP_SDT_SOFT_SM4_BATCH_BLOCKS];
+    srtp_err_status_t first = srtp_err_status_ok;
+    unsigned int i, n, len, nstaged = 0;
+    uint8_t *buf;
+
+    key = (dir == srtp_direction_decrypt) ? &soft_ctx->dec_key : &soft_ctx->enc_key;
+
+    for (i = 0; i < num_entries; i++) {
+        buf = entries[i].buffer;
+        len = entries[i].len;
+        if (len % SMS4_BLOCK_SIZE != 0) {
+            entries[i].status = srtp_err_status_bad_param;
+            if (!first) {
+                first = srtp_err_status_bad_param;
+            }
+            continue;
+        }
+        entries[i].status = srtp_err_status_ok;
+
+        n = len - len % SRTP_SDT_SOFT_SM4_BATCH_OCTETS;
+        srtp_sdt_soft_ecb(key, buf, n);
+        for (buf += n, len -= n; len > 0; buf += SMS4_BLOCK_SIZE, len -= SMS4_BLOCK_SIZE) {
+            memcpy(staged + nstaged * SMS4_BLOCK_SIZE, buf, SMS4_BLOCK_SIZE);
+            owner[nstaged++] = buf;
+            if (nstaged == SRTP_SDT_SOFT_SM4_BATCH_BLOCKS) {
+                sms4_encrypt_8blocks(staged, staged, key);
+                for (n = 0; n < nstaged; n++) {
+                    memcpy(owner[n], staged + n * SMS4_BLOCK_SIZE, SMS4_BLOCK_SIZE);
+                }
+                nstaged = 0;
+            }
+        }
+    }
+    for (n = 0; n < nstaged; n++) {
+        sms4_encrypt(staged + n * SMS4_BLOCK_SIZE, owner[n], key);
+    }
+    octet_string_set_to_zero(staged, sizeof(staged));
+
+    return first;
+}
+
+static const char srtp_sdt_soft_cipher_sm4_ecb_description[] = "sdt soft cipher sm4_ecb";
+static const char srtp_sdt_soft_cipher_sm4_cbc_description[] = "sdt soft cipher sm4_cbc";
+static const char srtp_sdt_soft_cipher_sm4_ofb_description[] = "sdt soft cipher sm4_ofb";
+static const char srtp_sdt_soft_cipher_sm4_ctr_description[] = "sdt soft cipher sm4_ctr";
+
+/*
+ * test case 0 is the single block vector shared with the device ciphers
+ * in sdt_sdf_cipher.c; test case 1 covers a full eight block batch
+ */
+static const uint8_t srtp_sdt_soft_sm4_test_case_0_key[SRTP_SDT_SM4_KEY_LEN] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+
+static uint8_t srtp_sdt_soft_sm4_test_case_0_nonce[16] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static const uint8_t srtp_sdt_soft_sm4_test_case_0_plaintext[16] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+
+static const uint8_t srtp_sdt_soft_sm4_ecb_test_case_0_ciphertext[16] = {
+    0x68, 0x1e, 0xdf, 0x34, 0xd2, 0x06, 0x96, 0x5e,
+    0x86, 0xb3, 0xe9, 0x4f, 0x53, 0x6e, 0x42, 0x46
+};
+
+static const uint8_t srtp_sdt_soft_sm4_ofb_test_case_0_ciphertext[16] = {
+    0x27, 0x54, 0xb1, 0x0c, 0x80, 0x6a, 0xef, 0x23,
+    0x69, 0x89, 0x89, 0x88, 0x2d, 0x80, 0x90, 0x3a
+};
+
+static const uint8_t srtp_sdt_soft_sm4_test_case_1_plaintext[128] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+    0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+    0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f,
+    0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57,
+    0x58, 0x59, 0x5a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f,
+    0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+    0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f
+};
+
+static const uint8_t srtp_sdt_soft_sm4_ecb_test_case_1_ciphertext[128] = {
+    0x06, 0x98, 0x9c, 0x61, 0x3d, 0xa6, 0x68, 0xad,
+    0x2a, 0x8d, 0xf7, 0x82, 0xe1, 0xa8, 0xf9, 0x6a,
+    0x4b, 0x91, 0x06, 0x51, 0x75, 0x4b, 0x55, 0x53,
+    0xf1, 0x0c, 0xfa, 0x0c, 0x8a, 0x09, 0xe9, 0xe5,
+    0xf4, 0x29, 0x52, 0xcf, 0x94, 0xac, 0x83, 0x68,
+    0x84, 0x37, 0xc9, 0xb6, 0x71, 0xd6, 0xc7, 0xfa,
+    0xd5, 0x5b, 0xfd, 0x68, 0xe7, 0x90, 0x12, 0x19,
+    0xf4, 0x1f, 0xab, 0x48, 0x42, 0x7a, 0xb5, 0x8d,
+    0x71, 0x8e, 0x20, 0x43, 0xba, 0xc7, 0xec, 0x8b,
+    0xfd, 0x57, 0xa9, 0x07, 0x11, 0x86, 0x50, 0x15,
+    0x0c, 0x2c, 0x0f, 0xab, 0x0b, 0x4e, 0x22, 0xee,
+    0x8d, 0xe3, 0x02, 0x8b, 0x16, 0x1a, 0x7c, 0x37,
+    0x1c, 0xd7, 0x85, 0x5a, 0xfd, 0x87, 0xef, 0x60,
+    0x6b, 0xcf, 0xed, 0xad, 0x65, 0xc8, 0x6b, 0x5b,
+    0x59, 0x68, 0x49, 0xdc, 0x7c, 0x7a, 0x6d, 0x63,
+    0xca, 0x3a, 0x76, 0x75, 0x38, 0xd1, 0x5e, 0xf6
+};
+
+static const uint8_t srtp_sdt_soft_sm4_cbc_test_case_1_ciphertext[128] = {
+    0x06, 0x98, 0x9c, 0x61, 0x3d, 0xa6, 0x68, 0xad,
+    0x2a, 0x8d, 0xf7, 0x82, 0xe1, 0xa8, 0xf9, 0x6a,
+    0x1d, 0xc1, 0xaf, 0xac, 0xd5, 0xe2, 0xd7, 0x24,
+    0xe1, 0x22, 0x6e, 0x42, 0x77, 0x2a, 0x63, 0xf8,
+    0xfb, 0x7b, 0x75, 0x21, 0x29, 0x4a, 0xf2, 0xa8,
+    0x50, 0xe5, 0x59, 0x86, 0x6c, 0x6e, 0x71, 0x68,
+    0xb1, 0x65, 0xc3, 0xb6, 0x4b, 0x16, 0x4b, 0xed,
+    0x31, 0x47, 0x8d, 0xbb, 0xe0, 0x45, 0x2b, 0xcf,
+    0xda, 0x24, 0xce, 0x08, 0xb9, 0x04, 0xd2, 0x27,
+    0xee, 0xff, 0xcc, 0x57, 0x98, 0x4c, 0x5f, 0x3a,
+    0xf8, 0x4a, 0x53, 0xed, 0x8b, 0x3c, 0xc9, 0xdb,
+    0xf8, 0xd6, 0x71, 0xfe, 0x5d, 0xfb, 0x37, 0xe8,
+    0x4e, 0x26, 0x85, 0x12, 0x1a, 0xb4, 0x85, 0xf7,
+    0xc6, 0x38, 0x03, 0xcf, 0x92, 0xa3, 0x11, 0x56,
+    0x0b, 0xb3, 0x19, 0x00, 0x92, 0x65, 0x50, 0x7b,
+    0x12, 0xe9, 0x90, 0xed, 0x05, 0x0c, 0x90, 0xe6
+};
+
+static const uint8_t srtp_sdt_soft_sm4_ofb_test_case_1_ciphertext[128] = {
+    0x26, 0x76, 0xf6, 0x68, 0x0d, 0xc4, 0x24, 0xcb,
+    0x9f, 0x5c, 0x39, 0x1b, 0x57, 0xd9, 0xac, 0x25,
+    0x3c, 0x01, 0x29, 0xfd, 0x3d, 0xa7, 0x7f, 0x2b,
+    0xc7, 0xa3, 0xde, 0x56, 0xd1, 0xe5, 0xa1, 0x73,
+    0x40, 0xe6, 0x8a, 0xab, 0x88, 0xe5, 0x7a, 0x09,
+    0x5d, 0xa0, 0x68, 0x8f, 0xf4, 0x68, 0x2b, 0x9e,
+    0x9b, 0xf0, 0x54, 0x72, 0xde, 0xec, 0x16, 0xfa,
+    0x01, 0xd6, 0x46, 0xb5, 0x2f, 0xd0, 0x08, 0x52,
+    0x76, 0xe2, 0x15, 0xe4, 0x78, 0xa6, 0xce, 0x11,
+    0x8b, 0x62, 0xda, 0xa9, 0x6a, 0xef, 0x59, 0xd4,
+    0xa6, 0x64, 0xa3, 0x22, 0xbc, 0xae, 0xce, 0xc5,
+    0x24, 0x2e, 0x27, 0xd5, 0x43, 0xba, 0x3c, 0xa2,
+    0xbb, 0xe4, 0xb3, 0xd2, 0x65, 0xff, 0x3a, 0x96,
+    0x02, 0xed, 0x19, 0xd3, 0x03, 0x5a, 0x5d, 0x93,
+    0x1d, 0xe8, 0x9b, 0xc8, 0xc9, 0x4b, 0x9a, 0x32,
+    0x23, 0xbd, 0x82, 0xe3, 0xdc, 0x07, 0x78, 0x60
+};
+
+static uint8_t srtp_sdt_soft_sm4_ctr_test_case_0_nonce[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+
+static const uint8_t srtp_sdt_soft_sm4_ctr_test_case_0_ciphertext[128] = {
+    0x5e, 0x23, 0xe4, 0xc4, 0x86, 0xc0, 0xb6, 0xba,
+    0xf9, 0x69, 0x1f, 0x81, 0xcb, 0x74, 0x76, 0xb8,
+    0x9e, 0x22, 0x5b, 0xa2, 0x6d, 0x56, 0x17, 0x4c,
+    0x43, 0xee, 0x04, 0xdb, 0x76, 0xe8, 0xd9, 0xdb,
+    0x39, 0xf8, 0x96, 0x0f, 0xff, 0x38, 0xea, 0x42,
+    0xe4, 0x64, 0xaa, 0x1f, 0xe0, 0x50, 0x9f, 0x99,
+    0x64, 0x61, 0x7f, 0x01, 0x05, 0x26, 0xd7, 0x64,
+    0x9c, 0x32, 0xc0, 0x08, 0xfc, 0x8d, 0x19, 0xd6,
+    0x01, 0xd7, 0xbf, 0x95, 0x5e, 0xde, 0x72, 0xa4,
+    0xa6, 0x1a, 0xc0, 0x92, 0x3e, 0x51, 0xc5, 0x53,
+    0x28, 0x6a, 0x1c, 0x4b, 0xa7, 0x08, 0x75, 0x01,
+    0x35, 0x21, 0xe4, 0x69, 0x55, 0xf4, 0xd8, 0x0a,
+    0x97, 0x48, 0xff, 0x24, 0x8c, 0x59, 0x24, 0xae,
+    0xb4, 0xbf, 0x5b, 0x71, 0x93, 0x9e, 0xf1, 0xed,
+    0x11, 0xa6, 0x6f, 0xe3, 0xcc, 0x00, 0x8c, 0x17,
+    0x43, 0xa2, 0xb7, 0x15, 0xe6, 0x76, 0xe5, 0x5f
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_ecb_test_1 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    128,
+    srtp_sdt_soft_sm4_test_case_1_plaintext,
+    128,
+    srtp_sdt_soft_sm4_ecb_test_case_1_ciphertext,
+    0,
+    NULL,
+    0,
+    NULL
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_ecb_test_0 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    16,
+    srtp_sdt_soft_sm4_test_case_0_plaintext,
+    16,
+    srtp_sdt_soft_sm4_ecb_test_case_0_ciphertext,
+    0,
+    NULL,
+    0,
+    &srtp_sdt_soft_cipher_sm4_ecb_test_1
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_cbc_test_1 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    128,
+    srtp_sdt_soft_sm4_test_case_1_plaintext,
+    128,
+    srtp_sdt_soft_sm4_cbc_test_case_1_ciphertext,
+    0,
+    NULL,
+    0,
+    NULL
+};
+
+/* with a zero IV a single CBC block is the same as ECB */
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_cbc_test_0 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    16,
+    srtp_sdt_soft_sm4_test_case_0_plaintext,
+    16,
+    srtp_sdt_soft_sm4_ecb_test_case_0_ciphertext,
+    0,
+    NULL,
+    0,
+    &srtp_sdt_soft_cipher_sm4_cbc_test_1
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_ofb_test_1 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    128,
+    srtp_sdt_soft_sm4_test_case_1_plaintext,
+    128,
+    srtp_sdt_soft_sm4_ofb_test_case_1_ciphertext,
+    0,
+    NULL,
+    0,
+    NULL
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_ofb_test_0 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_test_case_0_nonce,
+    16,
+    srtp_sdt_soft_sm4_test_case_0_plaintext,
+    16,
+    srtp_sdt_soft_sm4_ofb_test_case_0_ciphertext,
+    0,
+    NULL,
+    0,
+    &srtp_sdt_soft_cipher_sm4_ofb_test_1
+};
+
+static const srtp_cipher_test_case_t srtp_sdt_soft_cipher_sm4_ctr_test_0 = {
+    SRTP_SDT_SM4_KEY_LEN,
+    srtp_sdt_soft_sm4_test_case_0_key,
+    srtp_sdt_soft_sm4_ctr_test_case_0_nonce,
+    128,
+    srtp_sdt_soft_sm4_test_case_1_plaintext,
+    128,
+    srtp_sdt_soft_sm4_ctr_test_case_0_ciphertext,
+    0,
+    NULL,
+    0,
+    NULL
+};
+
+const srtp_cipher_type_t srtp_sdt_soft_SM4_ECB_cipher = {
+    srtp_sdt_soft_cipher_sm4_ecb_alloc,
+    srtp_sdt_soft_cipher_dealloc,
+    srtp_sdt_soft_cipher_init,
+    0,                     /* set_aad */
+    srtp_sdt_soft_cipher_encrypt,
+    srtp_sdt_soft_cipher_decrypt,
+    srtp_sdt_soft_cipher_set_iv,
+    0,                     /* get_tag */
+    srtp_sdt_soft_cipher_sm4_ecb_description,
+    &srtp_sdt_soft_cipher_sm4_ecb_test_0,
+    SRTP_SDT_SOFT_SM4_ECB,
+    srtp_sdt_soft_cipher_ecb_batch
+};
+
+const srtp_cipher_type_t srtp_sdt_soft_SM4_CBC_cipher = {
+    srtp_sdt_soft_cipher_sm4_cbc_alloc,
+    srtp_sdt_soft_cipher_dealloc,
+    srtp_sdt_soft_cipher_init,
+    0,                     /* set_aad */
+    srtp_sdt_soft_cipher_encrypt,
+    srtp_sdt_soft_cipher_decrypt,
+    srtp_sdt_soft_cipher_set_iv,
+    0,                     /* get_tag */
+    srtp_sdt_soft_cipher_sm4_cbc_description,
+    &srtp_sdt_soft_cipher_sm4_cbc_test_0,
+    SRTP_SDT_SOFT_SM4_CBC
+};
+
+const srtp_cipher_type_t srtp_sdt_soft_SM4_OFB_cipher = {
+    srtp_sdt_soft_cipher_sm4_ofb_alloc,
+    srtp_sdt_soft_cipher_dealloc,
+    srtp_sdt_soft_cipher_init,
+    0,                     /* set_aad */
+    srtp_sdt_soft_cipher_encrypt,
+    srtp_sdt_soft_cipher_decrypt,
+    srtp_sdt_soft_cipher_set_iv,
+    0,                     /* get_tag */
+    srtp_sdt_soft_cipher_sm4_ofb_description,
+    &srtp_sdt_soft_cipher_sm4_ofb_test_0,
+    SRTP_SDT_SOFT_SM4_OFB
+};
+
+const srtp_cipher_type_t srtp_sdt_soft_SM4_CTR_cipher = {
+    srtp_sdt_soft_cipher_sm4_ctr_alloc,
+    srtp_sdt_soft_cipher_dealloc,
+    srtp_sdt_soft_cipher_init,
+    0,                     /* set_aad */
+    srtp_sdt_soft_cipher_encrypt,
+    srtp_sdt_soft_cipher_decrypt,
+    srtp_sdt_soft_cipher_set_iv,
+    0,                     /* get_tag */
+    srtp_sdt_soft_cipher_sm4_ctr_description,
+    &srtp_sdt_soft_cipher_sm4_ctr_test_0,
+    SRTP_SDT_SOFT_SM4_CTR
+};
@@ -0,0 +1,326 @@
+/*
+ * zuc_cipher.c
+ *
+ * ZUC-128 stream cipher.  The 16-octet SRTP IV is loaded as the ZUC
+ * IV of each packet, and the 32-bit keystream words are used most
+ * significant byte first, as in 128-EEA3.  Batches of packets run
+ * ZUC_MB_LANES keystreams side by side through
+ * ZUC_generate_keystream_mb(), which uses AVX2 when the CPU has it.
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2017 Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+    #include <config.h>
+#endif
+
+#include "datatypes.h"
+#include "zuc_cipher.h"
+#include "err.h"                /* for srtp_debug */
+#include "alloc.h"
+
+
+/* the zuc cipher uses the cipher debug module  */
+extern srtp_debug_module_t srtp_mod_cipher;
+
+extern const srtp_cipher_type_t srtp_zuc_128_cipher;
+
+static srtp_err_status_t srtp_zuc_cipher_alloc (srtp_cipher_t **c, int key_len, int tlen)
+{
+    srtp_zuc_ctx_t *zuc_ctx;
+
+    debug_print(srtp_mod_cipher,
+                "allocating cipher with key length %d", key_len);
+
+    if (key_len != ZUC_KEY_LENGTH) {
+        return srtp_err_status_bad_param;
+    }
+
+    *c = (srtp_cipher_t *)srtp_crypto_alloc(sizeof(srtp_cipher_t));
+    if (*c == NULL) {
+        return srtp_err_status_alloc_fail;
+    }
+    memset(*c, 0x0, sizeof(srtp_cipher_t));
+
+    zuc_ctx = (srtp_zuc_ctx_t *)srtp_crypto_alloc(sizeof(srtp_zuc_ctx_t));
+    if (zuc_ctx == NULL) {
+        srtp_crypto_free(*c);
+        *c = NULL;
+        return srtp_err_status_alloc_fail;
+    }
+    memset(zuc_ctx, 0x0, sizeof(srtp_zuc_ctx_t));
+
+    /* set pointers */
+    (*c)->state = zuc_ctx;
+    (*c)->algorithm = SRTP_ZUC_128;
+    (*c)->type = &srtp_zuc_128_cipher;
+
+    /* set key size */
+    (*c)->key_len = key_len;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_cipher_dealloc (srtp_cipher_t *c)
+{
+    srtp_zuc_ctx_t *zuc_ctx = (srtp_zuc_ctx_t *)c->state;
+
+    if (zuc_ctx) {
+        /* zeroize the key material */
+        octet_string_set_to_zero(zuc_ctx, sizeof(srtp_zuc_ctx_t));
+        srtp_crypto_free(zuc_ctx);
+    }
+
+    /* zeroize entire state*/
+    octet_string_set_to_zero(c, sizeof(srtp_cipher_t));
+
+    srtp_crypto_free(c);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_cipher_init (void *cv, const uint8_t *key)
+{
+    srtp_zuc_ctx_t *zuc_ctx = (srtp_zuc_ctx_t *)cv;
+
+    debug_print(srtp_mod_cipher, "initializing zuc cipher", NULL);
+
+    /* the key is loaded together with the IV, see set_iv */
+    memcpy(zuc_ctx->key, key, ZUC_KEY_LENGTH);
+    zuc_ctx->num_left = 0;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_cipher_set_iv (void *cv, uint8_t *iv, srtp_cipher_direction_t dir)
+{
+    srtp_zuc_ctx_t *zuc_ctx = (srtp_zuc_ctx_t *)cv;
+
+    debug_print(srtp_mod_cipher, "setting iv: %s",
+                srtp_octet_string_hex_string(iv, ZUC_IV_LENGTH));
+
+    ZUC_set_key(&zuc_ctx->ks, zuc_ctx->key, iv);
+    zuc_ctx->num_left = 0;
+
+    return srtp_err_status_ok;
+}
+
+/* exor len octets of the big-endian keystream words into buf */
+static void srtp_zuc_xor_words (uint8_t *buf, const uint32_t *words, unsigned int len)
+{
+    unsigned int i;
+
+    for (i = 0; i + 4 <= len; i += 4, words++) {
+        buf[i] ^= (uint8_t)(*words >> 24);
+        buf[i + 1] ^= (uint8_t)(*words >> 16);
+        buf[i + 2] ^= (uint8_t)(*words >> 8);
+        buf[i + 3] ^= (uint8_t)*words;
+    }
+    for (; i < len; i++) {
+        buf[i] ^= (uint8_t)(*words >> (24 - 8 * (i & 3)));
+    }
+}
+
+/*
+ * encrypt and decrypt are the same operation.  the bytes of a word that
+ * are not used by one call are kept for the next, so that the keystream
+ * prefix of a universal hash and the payload come from one stream.
+ */
+static srtp_err_status_t srtp_zuc_cipher_encrypt (void *cv,
+                                                  unsigned char *buf, unsigned int *bytes_to_encr)
+{
+    srtp_zuc_ctx_t *zuc_ctx = (srtp_zuc_ctx_t *)cv;
+    uint32_t words[SRTP_ZUC_CHUNK_WORDS];
+    unsigned int len = *bytes_to_encr;
+    unsigned int n;
+
+    while (len > 0 && zuc_ctx->num_left > 0) {
+        *buf++ ^= zuc_ctx->left[4 - zuc_ctx->num_left--];
+        len--;
+    }
+
+    while (len >= 4) {
+        n = len / 4 < SRTP_ZUC_CHUNK_WORDS ? len / 4 : SRTP_ZUC_CHUNK_WORDS;
+        ZUC_generate_keystream(&zuc_ctx->ks, n, words);
+        srtp_zuc_xor_words(buf, words, n * 4);
+        buf += n * 4;
+        len -= n * 4;
+    }
+
+    if (len > 0) {
+        words[0] = ZUC_generate_keyword(&zuc_ctx->ks);
+        zuc_ctx->left[0] = (uint8_t)(words[0] >> 24);
+        zuc_ctx->left[1] = (uint8_t)(words[0] >> 16);
+        zuc_ctx->left[2] = (uint8_t)(words[0] >> 8);
+        zuc_ctx->left[3] = (uint8_t)words[0];
+        srtp_zuc_xor_words(buf, words, len);
+        zuc_ctx->num_left = 4 - len;
+    }
+
+    octet_string_set_to_zero(words, sizeof(words));
+
+    return srtp_err_status_ok;
+}
+
+/*
+ * every entry starts a keystream of its own from the entry IV, so the
+ * packets of a batch are independent and are run ZUC_MB_LANES at a
+ * time; each round produces up to SRTP_ZUC_CHUNK_WORDS words per lane.
+ * the shared generator in the cipher state is not used.
+ */
+static srtp_err_status_t srtp_zuc_cipher_batch (void *cv,
+                                                srtp_cipher_batch_entry_t *entries,
+                                                unsigned int num_entries,
+                                                srtp_cipher_direction_t dir)
+{
+    srtp_zuc_ctx_t *zuc_ctx = (srtp_zuc_ctx_t *)cv;
+    ZUC_KEY ks[ZUC_MB_LANES];
+    ZUC_KEY *key[ZUC_MB_LANES];
+    uint32_t words[ZUC_MB_LANES][SRTP_ZUC_CHUNK_WORDS];
+    uint32_t *out[ZUC_MB_LANES];
+    size_t nwords[ZUC_MB_LANES];
+    unsigned int done[ZUC_MB_LANES];
+    unsigned int base, i, n, len;
+    int more;
+
+    for (i = 0; i < ZUC_MB_LANES; i++) {
+        key[i] = &ks[i];
+        out[i] = words[i];
+    }
+
+    for (base = 0; base < num_entries; base += n) {
+        n = num_entries - base;
+        if (n > ZUC_MB_LANES) {
+            n = ZUC_MB_LANES;
+        }
+
+        for (i = 0; i < n; i++) {
+            ZUC_set_key(&ks[i], zuc_ctx->key, (const uint8_t *)&entries[base + i].iv);
+            done[i] = 0;
+        }
+
+        do {
+            more = 0;
+            for (i = 0; i < n; i++) {
+                len = entries[base + i].len - done[i];
+                nwords[i] = (len + 3) / 4;
+                if (nwords[i] > SRTP_ZUC_CHUNK_WORDS) {
+                    nwords[i] = SRTP_ZUC_CHUNK_WORDS;
+                    more = 1;
+                }
+            }
+
+            ZUC_generate_keystream_mb(key, nwords, out, n);
+
+            for (i = 0; i < n; i++) {
+                len = entries[base + i].len - done[i];
+                if (len > nwords[i] * 4) {
+                    len = (unsigned int)nwords[i] * 4;
+                }
+                srtp_zuc_xor_words(entries[base + i].buffer + done[i], words[i], len);
+                done[i] += len;
+            }
+        } while (more);
+
+        for (i = 0; i < n; i++) {
+            entries[base + i].status = srtp_err_status_ok;
+        }
+    }
+
+    octet_string_set_to_zero(ks, sizeof(ks));
+    octet_string_set_to_zero(words, sizeof(words));
+
+    return srtp_err_status_ok;
+}
+
+static const char srtp_zuc_cipher_description[] = "zuc-128 stream cipher";
+
+/*
+ * 3GPP 128-EEA3 test set 1: the nonce is the EEA3 IV for COUNT
+ * 0x66035492, BEARER 0x0f and DIRECTION 0, so the output is the first
+ * 24 octets of the EEA3 ciphertext
+ */
+static const uint8_t srtp_zuc_test_case_0_key[ZUC_KEY_LENGTH] = {
+    0x17, 0x3d, 0x14, 0xba, 0x50, 0x03, 0x73, 0x1d,
+    0x7a, 0x60, 0x04, 0x94, 0x70, 0xf0, 0x0a, 0x29
+};
+
+static uint8_t srtp_zuc_test_case_0_nonce[ZUC_IV_LENGTH] = {
+    0x66, 0x03, 0x54, 0x92, 0x78, 0x00, 0x00, 0x00,
+    0x66, 0x03, 0x54, 0x92, 0x78, 0x00, 0x00, 0x00
+};
+
+static const uint8_t srtp_zuc_test_case_0_plaintext[24] = {
+    0x6c, 0xf6, 0x53, 0x40, 0x73, 0x55, 0x52, 0xab,
+    0x0c, 0x97, 0x52, 0xfa, 0x6f, 0x90, 0x25, 0xfe,
+    0x0b, 0xd6, 0x75, 0xd9, 0x00, 0x58, 0x75, 0xb2
+};
+
+static const uint8_t srtp_zuc_test_case_0_ciphertext[24] = {
+    0xa6, 0xc8, 0x5f, 0xc6, 0x6a, 0xfb, 0x85, 0x33,
+    0xaa, 0xfc, 0x25, 0x18, 0xdf, 0xe7, 0x84, 0x94,
+    0x0e, 0xe1, 0xe4, 0xb0, 0x30, 0x23, 0x8c, 0xc8
+};
+
+static const srtp_cipher_test_case_t srtp_zuc_test_case_0 = {
+    ZUC_KEY_LENGTH,
+    srtp_zuc_test_case_0_key,
+    srtp_zuc_test_case_0_nonce,
+    24,
+    srtp_zuc_test_case_0_plaintext,
+    24,
+    srtp_zuc_test_case_0_ciphertext,
+    0,
+    NULL,
+    0,
+    NULL
+};
+
+const srtp_cipher_type_t srtp_zuc_128_cipher = {
+    srtp_zuc_cipher_alloc,
+    srtp_zuc_cipher_dealloc,
+    srtp_zuc_cipher_init,
+    0,                     /* set_aad */
+    srtp_zuc_cipher_encrypt,
+    srtp_zuc_cipher_encrypt,
+    srtp_zuc_cipher_set_iv,
+    0,                     /* get_tag */
+    srtp_zuc_cipher_description,
+    &srtp_zuc_test_case_0,
+    SRTP_ZUC_128,
+    srtp_zuc_cipher_batch
+};
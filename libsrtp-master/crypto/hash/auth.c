@@ -74,6 +74,37 @@ int srtp_auth_get_prefix_length (const srtp_auth_t *a)
     return a->prefix_len;
 }
 
+srtp_err_status_t srtp_auth_compute_batch (const srtp_auth_type_t *at,
+                                           srtp_auth_batch_entry_t *entries,
+                                           unsigned int num_entries)
+{
+    srtp_err_status_t status, first = srtp_err_status_ok;
+    unsigned int i;
+
+    if (!at || (!entries && num_entries)) {
+        return srtp_err_status_bad_param;
+    }
+
+    if (at->compute_batch) {
+        return at->compute_batch(entries, num_entries);
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        status = at->start(entries[i].state);
+        if (!status) {
+            status = at->compute(entries[i].state, entries[i].buffer,
+                                 entries[i].len, entries[i].tag_len,
+                                 entries[i].tag);
+        }
+        entries[i].status = status;
+        if (status && !first) {
+            first = status;
+        }
+    }
+
+    return first;
+}
+
 /*
  * srtp_auth_type_test() tests an auth function of type ct against
  * test cases provided in a list test_data of values of key, data, and tag
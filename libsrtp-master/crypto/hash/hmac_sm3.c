@@ -0,0 +1,300 @@
+/*
+ * hmac_sm3.c
+ *
+ * implementation of the hmac-sm3 srtp_auth_type_t on GmSSL sm3.  the
+ * key schedule is the pair of compressed ipad/opad blocks, and batches
+ * of tags are computed SM3_MB_LANES at a time with sm3_hmac_mb().
+ */
+/*
+ *
+ * Copyright(c) 2001-2017 Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+    #include <config.h>
+#endif
+
+#include "hmac_sm3.h"
+#include "alloc.h"
+
+/* the debug module for authentiation */
+
+srtp_debug_module_t srtp_mod_hmac_sm3 = {
+    0,                /* debugging is off by default */
+    "hmac sm3"        /* printable name for module   */
+};
+
+
+static srtp_err_status_t srtp_hmac_sm3_alloc (srtp_auth_t **a, int key_len, int out_len)
+{
+    extern const srtp_auth_type_t srtp_hmac_sm3;
+    uint8_t *pointer;
+
+    debug_print(srtp_mod_hmac_sm3, "allocating auth func with key length %d", key_len);
+    debug_print(srtp_mod_hmac_sm3, "                          tag length %d", out_len);
+
+    /* longer keys would be hashed first, srtp never derives them */
+    if (key_len > SM3_BLOCK_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    if (out_len > SM3_HMAC_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    /* allocate memory for auth and srtp_hmac_sm3_ctx_t structures */
+    pointer = (uint8_t*)srtp_crypto_alloc(sizeof(srtp_hmac_sm3_ctx_t) + sizeof(srtp_auth_t));
+    if (pointer == NULL) {
+        return srtp_err_status_alloc_fail;
+    }
+
+    /* set pointers */
+    *a = (srtp_auth_t*)pointer;
+    (*a)->type = &srtp_hmac_sm3;
+    (*a)->state = pointer + sizeof(srtp_auth_t);
+    (*a)->out_len = out_len;
+    (*a)->key_len = key_len;
+    (*a)->prefix_len = 0;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_hmac_sm3_dealloc (srtp_auth_t *a)
+{
+    /* zeroize entire state*/
+    octet_string_set_to_zero(a, sizeof(srtp_hmac_sm3_ctx_t) + sizeof(srtp_auth_t));
+
+    /* free memory */
+    srtp_crypto_free(a);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_hmac_sm3_init (void *statev, const uint8_t *key, int key_len)
+{
+    srtp_hmac_sm3_ctx_t *state = (srtp_hmac_sm3_ctx_t *)statev;
+
+    if (key_len > SM3_BLOCK_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    sm3_hmac_set_key(&state->key, key, key_len);
+    sm3_hmac_init_key(&state->ctx, &state->key);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_hmac_sm3_start (void *statev)
+{
+    srtp_hmac_sm3_ctx_t *state = (srtp_hmac_sm3_ctx_t *)statev;
+
+    sm3_hmac_init_key(&state->ctx, &state->key);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_hmac_sm3_update (void *statev, const uint8_t *message, int msg_octets)
+{
+    srtp_hmac_sm3_ctx_t *state = (srtp_hmac_sm3_ctx_t *)statev;
+
+    debug_print(srtp_mod_hmac_sm3, "input: %s",
+                srtp_octet_string_hex_string(message, msg_octets));
+
+    sm3_hmac_update(&state->ctx, message, msg_octets);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_hmac_sm3_compute (void *statev, const uint8_t *message,
+                                                int msg_octets, int tag_len, uint8_t *result)
+{
+    srtp_hmac_sm3_ctx_t *state = (srtp_hmac_sm3_ctx_t *)statev;
+    uint8_t mac[SM3_HMAC_SIZE];
+
+    /* check tag length, return error if we can't provide the value expected */
+    if (tag_len > SM3_HMAC_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    srtp_hmac_sm3_update(state, message, msg_octets);
+    sm3_hmac_final(&state->ctx, mac);
+    memcpy(result, mac, tag_len);
+
+    debug_print(srtp_mod_hmac_sm3, "output: %s",
+                srtp_octet_string_hex_string(mac, tag_len));
+
+    octet_string_set_to_zero(mac, sizeof(mac));
+
+    return srtp_err_status_ok;
+}
+
+/*
+ * the entries are taken SM3_MB_LANES at a time; each lane reads its
+ * whole message before any tag is written, so a tag may overwrite the
+ * end of its own message
+ */
+static srtp_err_status_t srtp_hmac_sm3_compute_batch (srtp_auth_batch_entry_t *entries,
+                                                      unsigned int num_entries)
+{
+    const sm3_hmac_key_t *key[SM3_MB_LANES];
+    const unsigned char *data[SM3_MB_LANES];
+    size_t len[SM3_MB_LANES];
+    uint8_t mac[SM3_MB_LANES][SM3_HMAC_SIZE];
+    unsigned char *out[SM3_MB_LANES];
+    srtp_err_status_t first = srtp_err_status_ok;
+    unsigned int base, i, n, m;
+    unsigned int slot[SM3_MB_LANES];
+
+    for (i = 0; i < SM3_MB_LANES; i++) {
+        out[i] = mac[i];
+    }
+
+    for (base = 0; base < num_entries; base += n) {
+        n = num_entries - base;
+        if (n > SM3_MB_LANES) {
+            n = SM3_MB_LANES;
+        }
+
+        m = 0;
+        for (i = base; i < base + n; i++) {
+            if (entries[i].tag_len > SM3_HMAC_SIZE || entries[i].len < 0) {
+                entries[i].status = srtp_err_status_bad_param;
+                if (!first) {
+                    first = srtp_err_status_bad_param;
+                }
+                continue;
+            }
+            key[m] = &((srtp_hmac_sm3_ctx_t *)entries[i].state)->key;
+            data[m] = entries[i].buffer;
+            len[m] = (size_t)entries[i].len;
+            slot[m++] = i;
+        }
+
+        sm3_hmac_mb(key, data, len, out, m);
+
+        for (i = 0; i < m; i++) {
+            memcpy(entries[slot[i]].tag, mac[i], entries[slot[i]].tag_len);
+            entries[slot[i]].status = srtp_err_status_ok;
+        }
+    }
+
+    octet_string_set_to_zero(mac, sizeof(mac));
+
+    return first;
+}
+
+
+/* begin test case 0 */
+
+static const uint8_t srtp_hmac_sm3_test_case_0_key[20] = {
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+    0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+    0x0b, 0x0b, 0x0b, 0x0b
+};
+
+static const uint8_t srtp_hmac_sm3_test_case_0_data[8] = {
+    0x48, 0x69, 0x20, 0x54, 0x68, 0x65, 0x72, 0x65 /* "Hi There" */
+};
+
+static const uint8_t srtp_hmac_sm3_test_case_0_tag[32] = {
+    0x51, 0xb0, 0x0d, 0x1f, 0xb4, 0x98, 0x32, 0xbf,
+    0xb0, 0x1c, 0x3c, 0xe2, 0x78, 0x48, 0xe5, 0x9f,
+    0x87, 0x1d, 0x9b, 0xa9, 0x38, 0xdc, 0x56, 0x3b,
+    0x33, 0x8c, 0xa9, 0x64, 0x75, 0x5c, 0xce, 0x70
+};
+
+/* begin test case 1, the 32-octet key and 80-bit tag used for srtp */
+
+static const uint8_t srtp_hmac_sm3_test_case_1_key[32] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+    0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20
+};
+
+static const uint8_t srtp_hmac_sm3_test_case_1_data[50] = {
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd, 0xcd,
+    0xcd, 0xcd
+};
+
+static const uint8_t srtp_hmac_sm3_test_case_1_tag[10] = {
+    0x08, 0xc4, 0x94, 0x1e, 0xb7, 0xc3, 0xab, 0x36,
+    0x1c, 0xfd
+};
+
+static const srtp_auth_test_case_t srtp_hmac_sm3_test_case_1 = {
+    32,                             /* octets in key            */
+    srtp_hmac_sm3_test_case_1_key,  /* key                      */
+    50,                             /* octets in data           */
+    srtp_hmac_sm3_test_case_1_data, /* data                     */
+    10,                             /* octets in tag            */
+    srtp_hmac_sm3_test_case_1_tag,  /* tag                      */
+    NULL                            /* pointer to next testcase */
+};
+
+static const srtp_auth_test_case_t srtp_hmac_sm3_test_case_0 = {
+    20,                             /* octets in key            */
+    srtp_hmac_sm3_test_case_0_key,  /* key                      */
+    8,                              /* octets in data           */
+    srtp_hmac_sm3_test_case_0_data, /* data                     */
+    32,                             /* octets in tag            */
+    srtp_hmac_sm3_test_case_0_tag,  /* tag                      */
+    &srtp_hmac_sm3_test_case_1      /* pointer to next testcase */
+};
+
+/* end test cases */
+
+static const char srtp_hmac_sm3_description[] = "hmac sm3 authentication function";
+
+/*
+ * srtp_auth_type_t hmac_sm3 is the hmac-sm3 metaobject
+ */
+
+const srtp_auth_type_t srtp_hmac_sm3 = {
+    srtp_hmac_sm3_alloc,
+    srtp_hmac_sm3_dealloc,
+    srtp_hmac_sm3_init,
+    srtp_hmac_sm3_compute,
+    srtp_hmac_sm3_update,
+    srtp_hmac_sm3_start,
+    srtp_hmac_sm3_description,
+    &srtp_hmac_sm3_test_case_0,
+    SRTP_HMAC_SM3,
+    srtp_hmac_sm3_compute_batch
+};
@@ -0,0 +1,235 @@
+/*
+ * zuc_eia3.c
+ *
+ * ZUC 128-EIA3 as an srtp_auth_type_t.  srtp gives an authentication
+ * function no per-packet IV, so the EIA3 keystream is derived once from
+ * the auth key (COUNT, BEARER and DIRECTION all zero) and EIA3 is used
+ * as the universal hash it is built on: the 32-bit tag is masked with
+ * a 4-octet keystream prefix of the packet's cipher, which srtp puts
+ * into the tag before compute() exors the hash into it.
+ */
+/*
+ *
+ * Copyright (c) 2001-2017 Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+    #include <config.h>
+#endif
+
+#include "zuc_eia3.h"
+#include "alloc.h"
+
+/* the debug module for authentiation */
+
+srtp_debug_module_t srtp_mod_zuc_eia3 = {
+    0,                /* debugging is off by default */
+    "zuc eia3"        /* printable name for module   */
+};
+
+
+static srtp_err_status_t srtp_zuc_eia3_alloc (srtp_auth_t **a, int key_len, int out_len)
+{
+    extern const srtp_auth_type_t srtp_zuc_eia3;
+    uint8_t *pointer;
+
+    debug_print(srtp_mod_zuc_eia3, "allocating auth func with key length %d", key_len);
+    debug_print(srtp_mod_zuc_eia3, "                          tag length %d", out_len);
+
+    if (key_len != ZUC_KEY_LENGTH) {
+        return srtp_err_status_bad_param;
+    }
+
+    if (out_len != ZUC_128EIA3_MAC_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    /* allocate memory for auth and srtp_zuc_eia3_ctx_t structures */
+    pointer = (uint8_t*)srtp_crypto_alloc(sizeof(srtp_zuc_eia3_ctx_t) + sizeof(srtp_auth_t));
+    if (pointer == NULL) {
+        return srtp_err_status_alloc_fail;
+    }
+
+    /* set pointers */
+    *a = (srtp_auth_t*)pointer;
+    (*a)->type = &srtp_zuc_eia3;
+    (*a)->state = pointer + sizeof(srtp_auth_t);
+    (*a)->out_len = out_len;
+    (*a)->key_len = key_len;
+    (*a)->prefix_len = ZUC_128EIA3_MAC_SIZE;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_eia3_dealloc (srtp_auth_t *a)
+{
+    /* zeroize entire state*/
+    octet_string_set_to_zero(a, sizeof(srtp_zuc_eia3_ctx_t) + sizeof(srtp_auth_t));
+
+    /* free memory */
+    srtp_crypto_free(a);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_eia3_init (void *statev, const uint8_t *key, int key_len)
+{
+    srtp_zuc_eia3_ctx_t *state = (srtp_zuc_eia3_ctx_t *)statev;
+
+    if (key_len != ZUC_KEY_LENGTH) {
+        return srtp_err_status_bad_param;
+    }
+
+    ZUC_128eia3_set_key(&state->key, key, 0, 0, 0);
+    state->ctx = state->key;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_eia3_start (void *statev)
+{
+    srtp_zuc_eia3_ctx_t *state = (srtp_zuc_eia3_ctx_t *)statev;
+
+    state->ctx = state->key;
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_zuc_eia3_update (void *statev, const uint8_t *message, int msg_octets)
+{
+    srtp_zuc_eia3_ctx_t *state = (srtp_zuc_eia3_ctx_t *)statev;
+
+    debug_print(srtp_mod_zuc_eia3, "input: %s",
+                srtp_octet_string_hex_string(message, msg_octets));
+
+    ZUC_128eia3_update(&state->ctx, message, msg_octets);
+
+    return srtp_err_status_ok;
+}
+
+/*
+ * the hash is exored into result, which holds the keystream prefix when
+ * called from srtp, and zeros in the self test
+ */
+static srtp_err_status_t srtp_zuc_eia3_compute (void *statev, const uint8_t *message,
+                                                int msg_octets, int tag_len, uint8_t *result)
+{
+    srtp_zuc_eia3_ctx_t *state = (srtp_zuc_eia3_ctx_t *)statev;
+    uint32_t mac;
+
+    if (tag_len != ZUC_128EIA3_MAC_SIZE) {
+        return srtp_err_status_bad_param;
+    }
+
+    srtp_zuc_eia3_update(state, message, msg_octets);
+    ZUC_128eia3_final(&state->ctx, &mac);
+    result[0] ^= (uint8_t)(mac >> 24);
+    result[1] ^= (uint8_t)(mac >> 16);
+    result[2] ^= (uint8_t)(mac >> 8);
+    result[3] ^= (uint8_t)mac;
+
+    debug_print(srtp_mod_zuc_eia3, "output: %s",
+                srtp_octet_string_hex_string(result, tag_len));
+
+    return srtp_err_status_ok;
+}
+
+
+/* begin test case 0, the message of 3GPP 128-EIA3 test set 3 */
+
+static const uint8_t srtp_zuc_eia3_test_case_0_key[ZUC_KEY_LENGTH] = {
+    0xc9, 0xe6, 0xce, 0xc4, 0x60, 0x7c, 0x72, 0xdb,
+    0x00, 0x0a, 0xef, 0xa8, 0x83, 0x85, 0xab, 0x0a
+};
+
+static const uint8_t srtp_zuc_eia3_test_case_0_data[64] = {
+    0x16, 0x58, 0x4c, 0x05, 0xae, 0x93, 0x8d, 0xd9,
+    0x46, 0xce, 0xcf, 0xad, 0xdf, 0x0a, 0x11, 0x81,
+    0x77, 0x45, 0x53, 0x55, 0x0f, 0x80, 0x95, 0x29,
+    0xa7, 0xbb, 0xd6, 0xfd, 0x3f, 0xf7, 0x18, 0xd1,
+    0xd8, 0x32, 0x5a, 0xa5, 0x70, 0x6d, 0x9c, 0x79,
+    0x08, 0xa8, 0xde, 0x4d, 0xa0, 0xe4, 0x20, 0x21,
+    0x39, 0x1f, 0x61, 0xf5, 0xd1, 0x5a, 0xa3, 0xc9,
+    0x69, 0x95, 0xe5, 0x9d, 0x01, 0xd1, 0x27, 0x71
+};
+
+static const uint8_t srtp_zuc_eia3_test_case_0_tag[4] = {
+    0xff, 0x17, 0x3a, 0x5d
+};
+
+/* begin test case 1, an odd length ends in a partial word */
+
+static const uint8_t srtp_zuc_eia3_test_case_1_tag[4] = {
+    0x50, 0x25, 0xab, 0x34
+};
+
+static const srtp_auth_test_case_t srtp_zuc_eia3_test_case_1 = {
+    ZUC_KEY_LENGTH,                 /* octets in key            */
+    srtp_zuc_eia3_test_case_0_key,  /* key                      */
+    13,                             /* octets in data           */
+    srtp_zuc_eia3_test_case_0_data, /* data                     */
+    4,                              /* octets in tag            */
+    srtp_zuc_eia3_test_case_1_tag,  /* tag                      */
+    NULL                            /* pointer to next testcase */
+};
+
+static const srtp_auth_test_case_t srtp_zuc_eia3_test_case_0 = {
+    ZUC_KEY_LENGTH,                 /* octets in key            */
+    srtp_zuc_eia3_test_case_0_key,  /* key                      */
+    64,                             /* octets in data           */
+    srtp_zuc_eia3_test_case_0_data, /* data                     */
+    4,                              /* octets in tag            */
+    srtp_zuc_eia3_test_case_0_tag,  /* tag                      */
+    &srtp_zuc_eia3_test_case_1      /* pointer to next testcase */
+};
+
+/* end test cases */
+
+static const char srtp_zuc_eia3_description[] = "zuc 128-eia3 authentication function";
+
+/*
+ * srtp_auth_type_t zuc_eia3 is the zuc 128-eia3 metaobject
+ */
+
+const srtp_auth_type_t srtp_zuc_eia3 = {
+    srtp_zuc_eia3_alloc,
+    srtp_zuc_eia3_dealloc,
+    srtp_zuc_eia3_init,
+    srtp_zuc_eia3_compute,
+    srtp_zuc_eia3_update,
+    srtp_zuc_eia3_start,
+    srtp_zuc_eia3_description,
+    &srtp_zuc_eia3_test_case_0,
+    SRTP_ZUC_EIA3
+};
@@ -59,5 +59,40 @@ typedef struct {
     int key_size;                         /* AES key size + 14 byte SALT */
 } srtp_aes_icm_ctx_t;
 
+/*
+ * srtp_aes_icm_impl_t enumerates the keystream generators of aes_icm.
+ * the generic one uses the table driven srtp_aes_encrypt() a block at a
+ * time; the others encrypt several counter blocks per call with the AES
+ * instructions of the processor and are only available when both the
+ * compiler and the processor support them.
+ */
+typedef enum {
+    srtp_aes_icm_impl_generic = 0,
+    srtp_aes_icm_impl_aesni = 1,     /* x86 AES-NI              */
+    srtp_aes_icm_impl_armv8_ce = 2,  /* ARMv8 Crypto Extensions */
+    srtp_aes_icm_impl_auto = 3       /* fastest one available   */
+} srtp_aes_icm_impl_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * srtp_aes_icm_set_impl(impl) selects the keystream generator used by
+ * all aes_icm ciphers from now on; by default the fastest available one
+ * is selected.  returns srtp_err_status_bad_param if impl is not
+ * available on this build or processor.
+ */
+srtp_err_status_t srtp_aes_icm_set_impl(srtp_aes_icm_impl_t impl);
+
+/*
+ * srtp_aes_icm_get_impl() returns the keystream generator in use
+ */
+srtp_aes_icm_impl_t srtp_aes_icm_get_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* AES_ICM_H */
 
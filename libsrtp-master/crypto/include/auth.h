@@ -73,6 +73,30 @@ typedef srtp_err_status_t (*srtp_auth_update_func)
 
 typedef srtp_err_status_t (*srtp_auth_start_func)(void *state);
 
+/*
+ * a srtp_auth_batch_entry_t describes one message of a batched tag
+ * computation: a tag_len octet tag over buffer[0..len) is computed with
+ * the given auth state and written to tag, and the per-entry result is
+ * left in status.  tag may point into buffer.
+ */
+typedef struct srtp_auth_batch_entry_t {
+    void *state;
+    const uint8_t *buffer;
+    int len;
+    uint8_t *tag;
+    int tag_len;
+    srtp_err_status_t status;
+} srtp_auth_batch_entry_t;
+
+/*
+ * a srtp_auth_batch_func_t computes the tags of a set of independent
+ * messages, possibly under different keys of the same auth type, so that
+ * a multi-buffer hash can process them side by side.  it returns the
+ * first per-entry failure, if any.
+ */
+typedef srtp_err_status_t (*srtp_auth_batch_func_t)
+    (srtp_auth_batch_entry_t *entries, unsigned int num_entries);
+
 /* some syntactic sugar on these function types */
 #define srtp_auth_type_alloc(at, a, klen, outlen)                        \
     ((at)->alloc((a), (klen), (outlen)))
@@ -125,6 +149,7 @@ typedef struct srtp_auth_type_t {
     const char                *description;
     const srtp_auth_test_case_t    *test_data;
     srtp_auth_type_id_t id;
+    srtp_auth_batch_func_t compute_batch;   /* optional, may be NULL */
 } srtp_auth_type_t;
 
 typedef struct srtp_auth_t {
@@ -135,6 +160,15 @@ typedef struct srtp_auth_t {
     int prefix_len;               /* length of keystream prefix     */
 } srtp_auth_t;
 
+/*
+ * srtp_auth_compute_batch(at, e, n) computes the tags of the n entries of
+ * e, whose states all belong to auth type at.  auth types that provide a
+ * compute_batch hook get the whole set, the others are run entry by entry.
+ */
+srtp_err_status_t srtp_auth_compute_batch(const srtp_auth_type_t *at,
+                                          srtp_auth_batch_entry_t *entries,
+                                          unsigned int num_entries);
+
 /*
  * srtp_auth_type_self_test() tests an auth_type against test cases
  * provided in an array of values of key/message/tag that is known to
@@ -48,6 +48,7 @@
 
 #include "srtp.h"
 #include "crypto_types.h"       /* for values of cipher_type_id_t */
+#include "datatypes.h"          /* for v128_t */
 
 
 #ifdef __cplusplus
@@ -116,6 +117,27 @@ typedef srtp_err_status_t (*srtp_cipher_set_iv_func_t)
 typedef srtp_err_status_t (*srtp_cipher_get_tag_func_t)
     (void *state, uint8_t *tag, uint32_t *len);
 
+/*
+ * a srtp_cipher_batch_entry_t describes one packet payload of a batched
+ * cipher operation: the buffer is transformed in place using the given
+ * initialization vector, and the per-entry result is left in status
+ */
+typedef struct srtp_cipher_batch_entry_t {
+    uint8_t *buffer;
+    unsigned int len;
+    v128_t iv;
+    srtp_err_status_t status;
+} srtp_cipher_batch_entry_t;
+
+/*
+ * a srtp_cipher_batch_func_t encrypts or decrypts a set of independent
+ * buffers with one key, so that an engine with a high per-call cost can
+ * submit them together.  it returns the first per-entry failure, if any.
+ */
+typedef srtp_err_status_t (*srtp_cipher_batch_func_t)
+    (void *state, srtp_cipher_batch_entry_t *entries, unsigned int num_entries,
+     srtp_cipher_direction_t direction);
+
 
 /*
  * srtp_cipher_test_case_t is a (list of) key, salt, plaintext, ciphertext,
@@ -151,6 +173,7 @@ typedef struct srtp_cipher_type_t {
     const char                       *description;
     const srtp_cipher_test_case_t         *test_data;
     srtp_cipher_type_id_t id;
+    srtp_cipher_batch_func_t process_batch;   /* optional, may be NULL */
 } srtp_cipher_type_t;
 
 /*
@@ -206,6 +229,14 @@ srtp_err_status_t srtp_cipher_decrypt(srtp_cipher_t *c, uint8_t *buffer, uint32_
 srtp_err_status_t srtp_cipher_get_tag(srtp_cipher_t *c, uint8_t *buffer, uint32_t *tag_len);
 srtp_err_status_t srtp_cipher_set_aad(srtp_cipher_t *c, const uint8_t *aad, uint32_t aad_len);
 
+/*
+ * srtp_cipher_process_batch(c, e, n, dir) encrypts or decrypts the n
+ * entries of e in place.  ciphers that provide a process_batch hook get
+ * the whole set in one call; all others fall back to one set_iv and
+ * encrypt/decrypt per entry.
+ */
+srtp_err_status_t srtp_cipher_process_batch(srtp_cipher_t *c, srtp_cipher_batch_entry_t *entries, unsigned int num_entries, int direction);
+
 /*
  * srtp_replace_cipher_type(ct, id)
  *
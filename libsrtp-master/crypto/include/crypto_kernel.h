@@ -203,6 +203,74 @@ srtp_err_status_t srtp_crypto_kernel_alloc_auth(srtp_auth_type_id_t id, srtp_aut
  */
 srtp_err_status_t srtp_crypto_kernel_set_debug_module(const char *mod_name, int v);
 
+/*
+ * asynchronous cipher offload
+ *
+ * a srtp_crypto_async_queue_t owns one offload thread, meant to front one
+ * crypto device (an SDF card, an SKF key, or the software SM4 cipher
+ * standing in for one).  media threads submit jobs without blocking; the
+ * offload thread takes whatever is pending, hands the jobs of each cipher
+ * to srtp_cipher_process_batch() together and queues them as completed.
+ * completion callbacks run in whichever thread calls
+ * srtp_crypto_kernel_async_poll(), never on the offload thread, and the
+ * descriptor from srtp_crypto_kernel_async_get_fd() becomes readable
+ * whenever completions are waiting, so the poll can be driven from an
+ * event loop.
+ *
+ * while a job is outstanding its buffer and cipher belong to the offload
+ * thread: the cipher must not be used, re-keyed or freed elsewhere.
+ */
+typedef struct srtp_crypto_async_queue_t srtp_crypto_async_queue_t;
+
+typedef struct srtp_crypto_async_job_t srtp_crypto_async_job_t;
+
+typedef void (*srtp_crypto_async_done_func_t)(srtp_crypto_async_job_t *job);
+
+struct srtp_crypto_async_job_t {
+    srtp_cipher_t *cipher;                /* NULL: nothing to run, just complete */
+    srtp_cipher_direction_t direction;
+    srtp_cipher_batch_entry_t entry;      /* buffer, len and iv in, status out */
+    srtp_crypto_async_done_func_t done;
+    void *user_data;
+    struct srtp_crypto_async_job_t *next; /* used by the queue */
+};
+
+/*
+ * srtp_crypto_kernel_async_start(q) creates a queue and starts its
+ * offload thread
+ */
+srtp_err_status_t srtp_crypto_kernel_async_start(srtp_crypto_async_queue_t **q);
+
+/*
+ * srtp_crypto_kernel_async_submit(q, job) queues job, which is owned by
+ * the caller and must stay valid until its done callback has run
+ */
+srtp_err_status_t srtp_crypto_kernel_async_submit(srtp_crypto_async_queue_t *q, srtp_crypto_async_job_t *job);
+
+/*
+ * srtp_crypto_kernel_async_poll(q, max) runs the done callbacks of up to
+ * max completed jobs (all of them if max is 0) and returns their number
+ */
+unsigned int srtp_crypto_kernel_async_poll(srtp_crypto_async_queue_t *q, unsigned int max_jobs);
+
+/*
+ * srtp_crypto_kernel_async_pending(q) returns the number of jobs that
+ * were submitted but whose callbacks have not run yet
+ */
+unsigned int srtp_crypto_kernel_async_pending(srtp_crypto_async_queue_t *q);
+
+/*
+ * srtp_crypto_kernel_async_get_fd(q) returns a descriptor that is
+ * readable while completed jobs are waiting to be polled
+ */
+int srtp_crypto_kernel_async_get_fd(srtp_crypto_async_queue_t *q);
+
+/*
+ * srtp_crypto_kernel_async_stop(q) lets the offload thread finish the
+ * jobs already submitted, runs their callbacks and frees the queue
+ */
+srtp_err_status_t srtp_crypto_kernel_async_stop(srtp_crypto_async_queue_t *q);
+
 #ifdef __cplusplus
 }
 #endif
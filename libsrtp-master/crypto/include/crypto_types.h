@@ -139,4 +139,40 @@
 
 #define SRTP_SDT_SKF_HY_SM4_MAC		20
 
+/*
+ * software SM4, no crypto device needed; ECB/CBC/OFB give the same
+ * output as the device ciphers above
+ */
+#define SRTP_SDT_SOFT_SM4_ECB		21
+
+#define SRTP_SDT_SOFT_SM4_CBC		22
+
+#define SRTP_SDT_SOFT_SM4_OFB		23
+
+#define SRTP_SDT_SOFT_SM4_CTR		24
+
+/*
+ * HMAC-SM3
+ *
+ * SRTP_HMAC_SM3 implements the Hash-based MAC using the GM/T 0004
+ * SM3 hash, with tags of up to 32 octets.
+ */
+#define SRTP_HMAC_SM3			25
+
+/*
+ * ZUC-128
+ *
+ * SRTP_ZUC_128 is the ZUC stream cipher with a 16-octet key; the
+ * 16-octet IV is formed like the AES ICM counter block.
+ */
+#define SRTP_ZUC_128			26
+
+/*
+ * ZUC 128-EIA3
+ *
+ * SRTP_ZUC_EIA3 is the 32-bit 128-EIA3 universal hash, masked with the
+ * keystream prefix of the cipher; it needs a stream cipher.
+ */
+#define SRTP_ZUC_EIA3			27
+
 #endif  /* SRTP_CRYPTO_TYPES_H */
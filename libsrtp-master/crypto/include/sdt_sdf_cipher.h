@@ -50,6 +50,7 @@
 
 #include "datatypes.h"
 #include "cipher.h"
+#include "sdt_sdf_pool.h"
 
 ////////added for JMK///////////
 #include <sys/types.h>
@@ -72,11 +73,31 @@
 
 ////////added for JMK///////////
 
+/*
+ * the SDF device is opened once per process and its sessions are kept
+ * in a bounded pool; a cipher leases a session at alloc and returns it
+ * at dealloc instead of opening and closing the device itself
+ */
+#ifndef SRTP_SDT_SDF_POOL_MAX_SESSIONS
+#define SRTP_SDT_SDF_POOL_MAX_SESSIONS	64
+#endif
+
+typedef struct {
+	unsigned int opened;		/* sessions opened on the device */
+	unsigned int leased;		/* sessions held by ciphers */
+	unsigned int free;			/* opened sessions idle in the pool */
+	unsigned long lease_count;	/* successful leases */
+	unsigned long wait_count;	/* leases that had to wait for a session */
+	unsigned long long wait_usec;	/* total time spent waiting */
+} srtp_sdt_sdf_pool_stats_t;
+
+srtp_err_status_t srtp_sdt_sdf_pool_lease(SGD_HANDLE *session_handle);
+void srtp_sdt_sdf_pool_release(SGD_HANDLE session_handle);
+void srtp_sdt_sdf_pool_get_stats(srtp_sdt_sdf_pool_stats_t *stats);
+
 typedef struct {
 //    char foo; /* empty, for now */
-	SGD_HANDLE device_handle; /*全局设备句柄*/
-	SGD_HANDLE session_handle;
-	DEVICEINFO dev_info;
+	SGD_HANDLE session_handle;	/* leased from the session pool */
 	SGD_HANDLE hKeyHandle;
 	sdt_sm4_mode mode;
 	unsigned char in_Iv[16];
@@ -0,0 +1,23 @@
+/*
+ * sdt_sdf_pool.h
+ *
+ * process-wide SDF device and session pool, as seen from outside the
+ * SDF ciphers; kept apart from sdt_sdf_cipher.h so that callers do not
+ * pull in the device and openssl headers
+ */
+
+#ifndef SDT_SDF_POOL_H
+#define SDT_SDF_POOL_H
+
+#include "srtp.h"
+
+/* returns nonzero once an SDF cipher has opened the shared device */
+int srtp_sdt_sdf_pool_in_use(void);
+
+/*
+ * closes the idle sessions and the device; fails while ciphers still
+ * hold sessions
+ */
+srtp_err_status_t srtp_sdt_sdf_pool_shutdown(void);
+
+#endif /* SDT_SDF_POOL_H */
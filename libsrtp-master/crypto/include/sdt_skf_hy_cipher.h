@@ -93,6 +93,7 @@ typedef struct {
 	BLOCKCIPHERPARAM Param_in;
 	BLOCKCIPHERPARAM Param_out;
 	sdt_sm4_mode mode;
+	int op_ready;		/* ECB only: key context left open for update, see srtp_sdt_skf_hy_cipher_crypt */
 	unsigned char HashData_enc[32];
 	unsigned char HashData_dec[32];
 	unsigned long int encrypt_count;
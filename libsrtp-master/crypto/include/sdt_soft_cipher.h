@@ -0,0 +1,63 @@
+/*
+ * sdt_soft_cipher.h
+ *
+ * header file for the software SM4 cipher, which needs no SDF/SKF
+ * device and produces the same output as the sdt hardware ciphers
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2017 Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SDT_SOFT_CIPHER_H
+#define SDT_SOFT_CIPHER_H
+
+#include "datatypes.h"
+#include "cipher.h"
+#include "openssl/sms4.h"
+
+/* number of blocks handed to the wide sms4 kernel at once */
+#define SRTP_SDT_SOFT_SM4_BATCH_BLOCKS 8
+#define SRTP_SDT_SOFT_SM4_BATCH_OCTETS                                        \
+    (SRTP_SDT_SOFT_SM4_BATCH_BLOCKS * SMS4_BLOCK_SIZE)
+
+typedef struct {
+    sms4_key_t enc_key;                  /* encryption key schedule      */
+    sms4_key_t dec_key;                  /* decryption key schedule      */
+    sdt_sm4_mode mode;                   /* SMS4_ECB/CBC/OFB/CTR         */
+    unsigned char iv[SMS4_BLOCK_SIZE];   /* chaining value or counter    */
+} srtp_sdt_soft_sm4_ctx_t;
+
+#endif /* SDT_SOFT_CIPHER_H */
@@ -51,6 +51,10 @@
 
 #include "crypto_kernel.h"
 
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
 /* the debug module for the crypto_kernel */
 
 srtp_debug_module_t srtp_mod_crypto_kernel = {
@@ -84,6 +88,12 @@ extern srtp_cipher_type_t srtp_sdt_skf_SM4_CBC_cipher;
 extern const srtp_cipher_type_t srtp_sdt_skf_hy_SM4_ECB_cipher;
 extern const srtp_cipher_type_t srtp_sdt_skf_hy_SM4_CBC_cipher;
 
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_ECB_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_CBC_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_OFB_cipher;
+extern const srtp_cipher_type_t srtp_sdt_soft_SM4_CTR_cipher;
+extern const srtp_cipher_type_t srtp_zuc_128_cipher;
+
 extern srtp_cipher_type_t srtp_aes_icm_128;
 extern srtp_cipher_type_t srtp_aes_icm_256;
 #ifdef OPENSSL
@@ -104,9 +114,13 @@ extern srtp_debug_module_t srtp_mod_aes_gcm;
 
 extern srtp_auth_type_t srtp_null_auth;
 extern srtp_auth_type_t srtp_hmac;
+extern const srtp_auth_type_t srtp_hmac_sm3;
+extern const srtp_auth_type_t srtp_zuc_eia3;
 
 /* debug modules for auth types */
 extern srtp_debug_module_t srtp_mod_hmac;
+extern srtp_debug_module_t srtp_mod_hmac_sm3;
+extern srtp_debug_module_t srtp_mod_zuc_eia3;
 
 /* crypto_kernel is a global variable, the only one of its datatype */
 
@@ -221,6 +235,32 @@ srtp_err_status_t srtp_crypto_kernel_init ()
 //        }
         printf("init sdt cipher ok\n");
 #endif
+
+    /* software SM4, always available */
+    status = srtp_crypto_kernel_load_cipher_type(&srtp_sdt_soft_SM4_ECB_cipher, SRTP_SDT_SOFT_SM4_ECB);
+    if (status) {
+        return status;
+    }
+
+    status = srtp_crypto_kernel_load_cipher_type(&srtp_sdt_soft_SM4_CBC_cipher, SRTP_SDT_SOFT_SM4_CBC);
+    if (status) {
+        return status;
+    }
+
+    status = srtp_crypto_kernel_load_cipher_type(&srtp_sdt_soft_SM4_OFB_cipher, SRTP_SDT_SOFT_SM4_OFB);
+    if (status) {
+        return status;
+    }
+
+    status = srtp_crypto_kernel_load_cipher_type(&srtp_sdt_soft_SM4_CTR_cipher, SRTP_SDT_SOFT_SM4_CTR);
+    if (status) {
+        return status;
+    }
+
+    status = srtp_crypto_kernel_load_cipher_type(&srtp_zuc_128_cipher, SRTP_ZUC_128);
+    if (status) {
+        return status;
+    }
     //added by bruce, for sdt sm4 cipher
 
     status = srtp_crypto_kernel_load_cipher_type(&srtp_null_cipher, SRTP_NULL_CIPHER);
@@ -272,6 +312,22 @@ srtp_err_status_t srtp_crypto_kernel_init ()
     if (status) {
         return status;
     }
+    status = srtp_crypto_kernel_load_auth_type(&srtp_hmac_sm3, SRTP_HMAC_SM3);
+    if (status) {
+        return status;
+    }
+    status = srtp_crypto_kernel_load_debug_module(&srtp_mod_hmac_sm3);
+    if (status) {
+        return status;
+    }
+    status = srtp_crypto_kernel_load_auth_type(&srtp_zuc_eia3, SRTP_ZUC_EIA3);
+    if (status) {
+        return status;
+    }
+    status = srtp_crypto_kernel_load_debug_module(&srtp_mod_zuc_eia3);
+    if (status) {
+        return status;
+    }
 
     /* change state to secure */
     crypto_kernel.state = srtp_crypto_kernel_state_secure;
@@ -647,3 +703,280 @@ srtp_err_status_t srtp_crypto_kernel_set_debug_module (const char *name, int on)
 
     return srtp_err_status_fail;
 }
+
+/*
+ * asynchronous cipher offload
+ *
+ * pending jobs wait on a singly linked FIFO until the offload thread
+ * takes up to SRTP_MAX_BATCH_PKTS of them at a time; finished jobs move
+ * to a second FIFO that srtp_crypto_kernel_async_poll() drains.  one
+ * byte is written to the wakeup pipe when the completed list goes from
+ * empty to non-empty, and read back by the poll that empties it.
+ */
+struct srtp_crypto_async_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    srtp_crypto_async_job_t *pending_head;
+    srtp_crypto_async_job_t *pending_tail;
+    srtp_crypto_async_job_t *done_head;
+    srtp_crypto_async_job_t *done_tail;
+    unsigned int outstanding;
+    int stopping;
+    int signalled;
+    int wake_fd[2];
+};
+
+static void srtp_crypto_kernel_async_run (srtp_crypto_async_job_t **jobs, unsigned int num_jobs)
+{
+    srtp_cipher_batch_entry_t entries[SRTP_MAX_BATCH_PKTS];
+    srtp_crypto_async_job_t *group[SRTP_MAX_BATCH_PKTS];
+    srtp_crypto_async_job_t *job;
+    unsigned int i, j, n;
+
+    for (i = 0; i < num_jobs; i++) {
+        job = jobs[i];
+        if (job == NULL) {
+            continue;
+        }
+        if (job->cipher == NULL) {
+            job->entry.status = srtp_err_status_ok;
+            continue;
+        }
+
+        /* gather every job for this cipher and direction */
+        n = 0;
+        for (j = i; j < num_jobs; j++) {
+            if (jobs[j] && jobs[j]->cipher == job->cipher &&
+                jobs[j]->direction == job->direction) {
+                entries[n] = jobs[j]->entry;
+                group[n++] = jobs[j];
+                jobs[j] = NULL;
+            }
+        }
+
+        srtp_cipher_process_batch(job->cipher, entries, n, job->direction);
+
+        for (j = 0; j < n; j++) {
+            group[j]->entry.status = entries[j].status;
+        }
+    }
+}
+
+static void *srtp_crypto_kernel_async_thread (void *arg)
+{
+    srtp_crypto_async_queue_t *q = (srtp_crypto_async_queue_t *)arg;
+    srtp_crypto_async_job_t *jobs[SRTP_MAX_BATCH_PKTS];
+    srtp_crypto_async_job_t *head, *tail;
+    unsigned int i, n;
+    char c = 0;
+
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (q->pending_head == NULL && !q->stopping) {
+            pthread_cond_wait(&q->cond, &q->lock);
+        }
+        if (q->pending_head == NULL) {
+            break;
+        }
+
+        for (n = 0; n < SRTP_MAX_BATCH_PKTS && q->pending_head; n++) {
+            jobs[n] = q->pending_head;
+            q->pending_head = q->pending_head->next;
+        }
+        if (q->pending_head == NULL) {
+            q->pending_tail = NULL;
+        }
+        pthread_mutex_unlock(&q->lock);
+
+        /* the run order is lost by the grouping, so link the list first */
+        head = jobs[0];
+        tail = jobs[n - 1];
+        for (i = 0; i + 1 < n; i++) {
+            jobs[i]->next = jobs[i + 1];
+        }
+        tail->next = NULL;
+
+        srtp_crypto_kernel_async_run(jobs, n);
+
+        pthread_mutex_lock(&q->lock);
+        if (q->done_tail) {
+            q->done_tail->next = head;
+        } else {
+            q->done_head = head;
+        }
+        q->done_tail = tail;
+        if (!q->signalled) {
+            q->signalled = 1;
+            if (write(q->wake_fd[1], &c, 1) != 1) {
+                debug_print(srtp_mod_crypto_kernel, "async wakeup write failed", NULL);
+            }
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+srtp_err_status_t srtp_crypto_kernel_async_start (srtp_crypto_async_queue_t **q)
+{
+    srtp_crypto_async_queue_t *aq;
+
+    if (q == NULL) {
+        return srtp_err_status_bad_param;
+    }
+
+    aq = (srtp_crypto_async_queue_t *)srtp_crypto_alloc(sizeof(srtp_crypto_async_queue_t));
+    if (aq == NULL) {
+        return srtp_err_status_alloc_fail;
+    }
+    memset(aq, 0, sizeof(srtp_crypto_async_queue_t));
+
+    if (pipe(aq->wake_fd) != 0) {
+        srtp_crypto_free(aq);
+        return srtp_err_status_init_fail;
+    }
+    fcntl(aq->wake_fd[0], F_SETFL, fcntl(aq->wake_fd[0], F_GETFL) | O_NONBLOCK);
+
+    pthread_mutex_init(&aq->lock, NULL);
+    pthread_cond_init(&aq->cond, NULL);
+    if (pthread_create(&aq->thread, NULL, srtp_crypto_kernel_async_thread, aq) != 0) {
+        pthread_cond_destroy(&aq->cond);
+        pthread_mutex_destroy(&aq->lock);
+        close(aq->wake_fd[0]);
+        close(aq->wake_fd[1]);
+        srtp_crypto_free(aq);
+        return srtp_err_status_init_fail;
+    }
+
+    debug_print(srtp_mod_crypto_kernel, "async offload thread started", NULL);
+    *q = aq;
+    return srtp_err_status_ok;
+}
+
+srtp_err_status_t srtp_crypto_kernel_async_submit (srtp_crypto_async_queue_t *q, srtp_crypto_async_job_t *job)
+{
+    if (q == NULL || job == NULL || job->done == NULL) {
+        return srtp_err_status_bad_param;
+    }
+
+    job->next = NULL;
+    job->entry.status = srtp_err_status_ok;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->stopping) {
+        pthread_mutex_unlock(&q->lock);
+        return srtp_err_status_fail;
+    }
+    if (q->pending_tail) {
+        q->pending_tail->next = job;
+    } else {
+        q->pending_head = job;
+        pthread_cond_signal(&q->cond);
+    }
+    q->pending_tail = job;
+    q->outstanding++;
+    pthread_mutex_unlock(&q->lock);
+
+    return srtp_err_status_ok;
+}
+
+unsigned int srtp_crypto_kernel_async_poll (srtp_crypto_async_queue_t *q, unsigned int max_jobs)
+{
+    srtp_crypto_async_job_t *job, *next;
+    unsigned int n = 0;
+    char buf[16];
+
+    if (q == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    job = q->done_head;
+    if (job == NULL) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+
+    /* detach at most max_jobs completed jobs */
+    if (max_jobs == 0) {
+        q->done_head = q->done_tail = NULL;
+    } else {
+        for (next = job, n = 1; n < max_jobs && next->next; n++) {
+            next = next->next;
+        }
+        q->done_head = next->next;
+        if (q->done_head == NULL) {
+            q->done_tail = NULL;
+        }
+        next->next = NULL;
+    }
+    if (q->done_head == NULL && q->signalled) {
+        while (read(q->wake_fd[0], buf, sizeof(buf)) > 0) {
+            ;
+        }
+        q->signalled = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    /* the callbacks may submit again, so they run without the lock */
+    for (n = 0; job != NULL; job = next, n++) {
+        next = job->next;
+        job->done(job);
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->outstanding -= n;
+    pthread_mutex_unlock(&q->lock);
+
+    return n;
+}
+
+unsigned int srtp_crypto_kernel_async_pending (srtp_crypto_async_queue_t *q)
+{
+    unsigned int n;
+
+    if (q == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    n = q->outstanding;
+    pthread_mutex_unlock(&q->lock);
+
+    return n;
+}
+
+int srtp_crypto_kernel_async_get_fd (srtp_crypto_async_queue_t *q)
+{
+    if (q == NULL) {
+        return -1;
+    }
+    return q->wake_fd[0];
+}
+
+srtp_err_status_t srtp_crypto_kernel_async_stop (srtp_crypto_async_queue_t *q)
+{
+    if (q == NULL) {
+        return srtp_err_status_bad_param;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->stopping = 1;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->thread, NULL);
+
+    /* everything submitted has now completed */
+    srtp_crypto_kernel_async_poll(q, 0);
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    close(q->wake_fd[0]);
+    close(q->wake_fd[1]);
+    srtp_crypto_free(q);
+
+    debug_print(srtp_mod_crypto_kernel, "async offload thread stopped", NULL);
+    return srtp_err_status_ok;
+}
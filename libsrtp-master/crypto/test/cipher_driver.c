@@ -77,6 +77,16 @@ cipher_driver_self_test(srtp_cipher_type_t *ct);
 srtp_err_status_t
 cipher_driver_test_buffering(srtp_cipher_t *c);
 
+/*
+ * cipher_driver_test_aes_icm(ct, klen, key, ...) runs the self-test, the
+ * buffering test and/or the throughput test of an aes_icm cipher once
+ * for each keystream generator available on this processor
+ */
+
+void
+cipher_driver_test_aes_icm(srtp_cipher_type_t *ct, int klen, uint8_t *key,
+                           unsigned do_timing_test, unsigned do_validation);
+
 
 /*
  * functions for testing cipher cache thrash
@@ -124,6 +134,10 @@ extern srtp_cipher_type_t srtp_null_cipher;
 extern srtp_cipher_type_t srtp_sdt_cipher;
 extern srtp_cipher_type_t srtp_aes_icm_128;
 extern srtp_cipher_type_t srtp_aes_icm_256;
+extern srtp_cipher_type_t srtp_sdt_soft_SM4_ECB_cipher;
+extern srtp_cipher_type_t srtp_sdt_soft_SM4_CBC_cipher;
+extern srtp_cipher_type_t srtp_sdt_soft_SM4_OFB_cipher;
+extern srtp_cipher_type_t srtp_sdt_soft_SM4_CTR_cipher;
 #ifdef OPENSSL
 extern srtp_cipher_type_t srtp_aes_icm_192;
 extern srtp_cipher_type_t srtp_aes_gcm_128_openssl;
@@ -188,6 +202,9 @@ main(int argc, char *argv[]) {
     for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
       cipher_driver_test_array_throughput(&srtp_aes_icm_256, SRTP_AES_ICM_256_KEY_LEN_WSALT, num_cipher);
 
+    for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
+      cipher_driver_test_array_throughput(&srtp_sdt_soft_SM4_CTR_cipher, SRTP_SDT_SM4_KEY_LEN, num_cipher);
+
 #ifdef OPENSSL
     for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
       cipher_driver_test_array_throughput(&srtp_aes_icm_192, SRTP_AES_ICM_192_KEY_LEN_WSALT, num_cipher);
@@ -206,6 +223,10 @@ main(int argc, char *argv[]) {
     cipher_driver_self_test(&srtp_null_cipher);
     cipher_driver_self_test(&srtp_aes_icm_128);
     cipher_driver_self_test(&srtp_aes_icm_256);
+    cipher_driver_self_test(&srtp_sdt_soft_SM4_ECB_cipher);
+    cipher_driver_self_test(&srtp_sdt_soft_SM4_CBC_cipher);
+    cipher_driver_self_test(&srtp_sdt_soft_SM4_OFB_cipher);
+    cipher_driver_self_test(&srtp_sdt_soft_SM4_CTR_cipher);
 #ifdef OPENSSL
     cipher_driver_self_test(&srtp_aes_icm_192);
     cipher_driver_self_test(&srtp_aes_gcm_128_openssl);
@@ -231,7 +252,11 @@ main(int argc, char *argv[]) {
   
 
   /* run the throughput test on the aes_icm cipher (128-bit key) */
-    status = srtp_cipher_type_alloc(&srtp_aes_icm_128, &c, SRTP_AES_ICM_128_KEY_LEN_WSALT, 0);
+    cipher_driver_test_aes_icm(&srtp_aes_icm_128, SRTP_AES_ICM_128_KEY_LEN_WSALT,
+                               test_key, do_timing_test, do_validation);
+
+  /* run the throughput test on the software sm4 ctr cipher */
+    status = srtp_cipher_type_alloc(&srtp_sdt_soft_SM4_CTR_cipher, &c, SRTP_SDT_SM4_KEY_LEN, 0);
     if (status) {
       fprintf(stderr, "error: can't allocate cipher\n");
       exit(status);
@@ -242,35 +267,13 @@ main(int argc, char *argv[]) {
 
     if (do_timing_test)
       cipher_driver_test_throughput(c);
-    
-    if (do_validation) {
-      status = cipher_driver_test_buffering(c);
-      check_status(status);
-    }
-    
+
     status = srtp_cipher_dealloc(c);
     check_status(status);
 
   /* repeat the tests with 256-bit keys */
-    status = srtp_cipher_type_alloc(&srtp_aes_icm_256, &c, SRTP_AES_ICM_256_KEY_LEN_WSALT, 0);
-    if (status) {
-      fprintf(stderr, "error: can't allocate cipher\n");
-      exit(status);
-    }
-
-    status = srtp_cipher_init(c, test_key);
-    check_status(status);
-
-    if (do_timing_test)
-      cipher_driver_test_throughput(c);
-    
-    if (do_validation) {
-      status = cipher_driver_test_buffering(c);
-      check_status(status);
-    }
-    
-    status = srtp_cipher_dealloc(c);
-    check_status(status);
+    cipher_driver_test_aes_icm(&srtp_aes_icm_256, SRTP_AES_ICM_256_KEY_LEN_WSALT,
+                               test_key, do_timing_test, do_validation);
 
 #ifdef OPENSSL
     /* run the throughput test on the aes_gcm_128_openssl cipher */
@@ -330,6 +333,62 @@ cipher_driver_test_throughput(srtp_cipher_t *c) {
 
 }
 
+#ifndef OPENSSL
+static const struct {
+  srtp_aes_icm_impl_t impl;
+  const char *name;
+} aes_icm_impls[] = {
+  { srtp_aes_icm_impl_generic, "generic" },
+  { srtp_aes_icm_impl_aesni, "AES-NI" },
+  { srtp_aes_icm_impl_armv8_ce, "ARMv8 crypto extensions" },
+};
+#endif
+
+void
+cipher_driver_test_aes_icm(srtp_cipher_type_t *ct, int klen, uint8_t *key,
+                           unsigned do_timing_test, unsigned do_validation) {
+  srtp_cipher_t *c = NULL;
+  srtp_err_status_t status;
+#ifndef OPENSSL
+  srtp_aes_icm_impl_t impl_in_use = srtp_aes_icm_get_impl();
+  unsigned i;
+
+  for (i = 0; i < sizeof(aes_icm_impls) / sizeof(aes_icm_impls[0]); i++) {
+    if (srtp_aes_icm_set_impl(aes_icm_impls[i].impl) != srtp_err_status_ok) {
+      printf("%s keystream generator not available\n", aes_icm_impls[i].name);
+      continue;
+    }
+    printf("using %s keystream generator\n", aes_icm_impls[i].name);
+    if (do_validation)
+      cipher_driver_self_test(ct);
+#endif
+
+    status = srtp_cipher_type_alloc(ct, &c, klen, 0);
+    if (status) {
+      fprintf(stderr, "error: can't allocate cipher\n");
+      exit(status);
+    }
+
+    status = srtp_cipher_init(c, key);
+    check_status(status);
+
+    if (do_timing_test)
+      cipher_driver_test_throughput(c);
+
+    if (do_validation) {
+      status = cipher_driver_test_buffering(c);
+      check_status(status);
+    }
+
+    status = srtp_cipher_dealloc(c);
+    check_status(status);
+
+#ifndef OPENSSL
+  }
+  srtp_aes_icm_set_impl(impl_in_use);
+#endif
+}
+
 srtp_err_status_t
 cipher_driver_self_test(srtp_cipher_type_t *ct) {
   srtp_err_status_t status;
@@ -127,6 +127,24 @@ extern "C" {
     (SRTP_AEAD_SALT_LEN + SRTP_AES_256_KEY_LEN)
 
 #define SRTP_SDT_SM4_KEY_LEN 	16
+
+#define SRTP_ZUC_128_KEY_LEN 	16
+
+/*
+ * largest payload handed to the SDF/SKF device in one call; the sdt
+ * hardware ciphers split longer (video) payloads into chunks of this size
+ */
+#define SRTP_SDT_MAX_CHUNK_LEN	2048
+
+/*
+ * number of packets srtp_protect_batch()/srtp_unprotect_batch() gather
+ * before submitting them to the cipher; longer batches are processed in
+ * rounds of this size
+ */
+#ifndef SRTP_MAX_BATCH_PKTS
+#define SRTP_MAX_BATCH_PKTS	32
+#endif
+
 /**
  *  @brief A srtp_cipher_type_id_t is an identifier for a particular cipher
  *  type.
@@ -590,6 +608,137 @@ srtp_err_status_t srtp_unprotect_mki(srtp_t ctx,
                                      int *len_ptr,
                                      unsigned int use_mki);
 
+/**
+ * @brief srtp_protect_batch() applies srtp_protect() to a set of RTP
+ * packets at once.
+ *
+ * The function call srtp_protect_batch(ctx, rtp_hdr, len, status, n)
+ * protects the n packets rtp_hdr[0..n-1], which may belong to different
+ * streams of ctx.  Each packet is processed as by srtp_protect(), except
+ * that the payload encryption of all packets which use the same cipher
+ * is submitted to that cipher in a single call, so that a crypto engine
+ * with a high per-call cost (an SKF key or SDF card) is invoked once per
+ * batch rather than once per packet.  Ciphers without batch support are
+ * driven one packet at a time.
+ *
+ * @param ctx is the SRTP context to use in processing the packets.
+ *
+ * @param rtp_hdr is an array of n pointers to RTP packets, each of which
+ * must have room for the authentication tag as for srtp_protect().
+ *
+ * @param len is an array of n packet lengths, updated as for
+ * srtp_protect().
+ *
+ * @param status is an array of n results, one per packet; it may be
+ * NULL if the caller does not need them.
+ *
+ * @param num_pkts is the number of packets.
+ *
+ * @return
+ *    - srtp_err_status_ok          if every packet was protected.
+ *    - [other]                     the first failure, in packet order;
+ *                                  see status for the individual results.
+ */
+srtp_err_status_t srtp_protect_batch(srtp_t ctx,
+                                     void *rtp_hdr[],
+                                     int len[],
+                                     srtp_err_status_t status[],
+                                     unsigned int num_pkts);
+
+/**
+ * @brief srtp_unprotect_batch() applies srtp_unprotect() to a set of
+ * SRTP packets at once.
+ *
+ * The function call srtp_unprotect_batch(ctx, srtp_hdr, len, status, n)
+ * is the receiver-side counterpart of srtp_protect_batch().  Each packet
+ * is authenticated and checked against the replay database individually;
+ * the payload decryption of all packets which use the same cipher is
+ * then submitted to that cipher in a single call.
+ *
+ * @param ctx is the SRTP context to use in processing the packets.
+ *
+ * @param srtp_hdr is an array of n pointers to SRTP packets.
+ *
+ * @param len is an array of n packet lengths, updated as for
+ * srtp_unprotect().
+ *
+ * @param status is an array of n results, one per packet; it may be
+ * NULL if the caller does not need them.
+ *
+ * @param num_pkts is the number of packets.
+ *
+ * @return
+ *    - srtp_err_status_ok          if every packet was valid.
+ *    - [other]                     the first failure, in packet order;
+ *                                  see status for the individual results.
+ */
+srtp_err_status_t srtp_unprotect_batch(srtp_t ctx,
+                                       void *srtp_hdr[],
+                                       int len[],
+                                       srtp_err_status_t status[],
+                                       unsigned int num_pkts);
+
+/*
+ * an offload queue of the crypto kernel, see crypto_kernel.h
+ */
+struct srtp_crypto_async_queue_t;
+
+/**
+ * @brief srtp_async_done_func_t is the completion callback of
+ * srtp_protect_async() and srtp_unprotect_async().
+ *
+ * It is called with the packet pointer that was submitted, the packet
+ * length after protection (or unprotection), the result, and the
+ * user_data pointer that was submitted with the packet.
+ */
+typedef void (*srtp_async_done_func_t)(void *hdr,
+                                       int len,
+                                       srtp_err_status_t status,
+                                       void *user_data);
+
+/**
+ * @brief srtp_protect_async() is srtp_protect() with the payload
+ * encryption done on an offload thread.
+ *
+ * The function call srtp_protect_async(ctx, queue, rtp_hdr, len, done,
+ * user_data) does the header, replay and key-limit processing of the
+ * packet at once, then hands its payload to the offload thread of queue
+ * and returns.  When the payload has been encrypted (and, if the policy
+ * asks for it, authenticated), done is called from the thread that
+ * calls srtp_crypto_kernel_async_poll() on queue.  Packets of a policy
+ * that cannot be deferred complete through the same callback.
+ *
+ * The packet buffer, which must have room for the trailer as for
+ * srtp_protect(), belongs to the library until done has been called,
+ * and ctx must not be deallocated while packets are outstanding.
+ *
+ * @return
+ *    - srtp_err_status_ok          if the packet was queued; the result
+ *                                  is reported through done.
+ *    - [other]                     if the packet was rejected; done is
+ *                                  not called.
+ */
+srtp_err_status_t srtp_protect_async(srtp_t ctx,
+                                     struct srtp_crypto_async_queue_t *queue,
+                                     void *rtp_hdr,
+                                     int len,
+                                     srtp_async_done_func_t done,
+                                     void *user_data);
+
+/**
+ * @brief srtp_unprotect_async() is srtp_unprotect() with the payload
+ * decryption done on an offload thread.
+ *
+ * Authentication and the replay check happen before the function
+ * returns; only the decryption is deferred.  See srtp_protect_async().
+ */
+srtp_err_status_t srtp_unprotect_async(srtp_t ctx,
+                                       struct srtp_crypto_async_queue_t *queue,
+                                       void *srtp_hdr,
+                                       int len,
+                                       srtp_async_done_func_t done,
+                                       void *user_data);
+
 /**
  * @brief srtp_create() allocates and initializes an SRTP session.
 
@@ -913,6 +1062,35 @@ void srtp_crypto_policy_set_sdt_skf_hy_sm4_ecb(srtp_crypto_policy_t *p);
 
 void srtp_crypto_policy_set_sdt_skf_hy_sm4_cbc(srtp_crypto_policy_t *p);
 
+/*
+ * software sm4 on GmSSL, no SDF/SKF device needed.  ecb, cbc and ofb
+ * interoperate with the device ciphers; ctr uses the packet index and
+ * ssrc as counter like aes-icm
+ */
+void srtp_crypto_policy_set_sdt_soft_sm4_ecb(srtp_crypto_policy_t *p);
+
+void srtp_crypto_policy_set_sdt_soft_sm4_cbc(srtp_crypto_policy_t *p);
+
+void srtp_crypto_policy_set_sdt_soft_sm4_ofb(srtp_crypto_policy_t *p);
+
+void srtp_crypto_policy_set_sdt_soft_sm4_ctr(srtp_crypto_policy_t *p);
+
+/*
+ * sm4 ctr as above, authenticated with an 80-bit hmac-sm3 tag
+ */
+void srtp_crypto_policy_set_sdt_soft_sm4_ctr_hmac_sm3_80(srtp_crypto_policy_t *p);
+
+/*
+ * zuc-128 with the packet index and ssrc as IV like aes-icm, authenticated
+ * with an 80-bit hmac-sm3 tag, or with the 32-bit 128-eia3 hash masked by
+ * the zuc keystream.  only the hmac-sm3 variant is deferred by
+ * srtp_protect_batch(), where the zuc keystreams of a batch are run side
+ * by side.
+ */
+void srtp_crypto_policy_set_zuc_128_hmac_sm3_80(srtp_crypto_policy_t *p);
+
+void srtp_crypto_policy_set_zuc_128_eia3_32(srtp_crypto_policy_t *p);
+
 //added by bruce, for sdt sm4
 
 void srtp_crypto_policy_set_aes_cm_256_hmac_sha1_80(srtp_crypto_policy_t *p);
@@ -1239,7 +1417,14 @@ typedef enum {
     srtp_profile_sdt_skf_sm4_ecb_audio_enc = 15,
     srtp_profile_sdt_skf_sm4_ecb_audio_dec = 16,
     srtp_profile_sdt_skf_hy_sm4_ecb = 17,
-    srtp_profile_sdt_skf_hy_sm4_cbc = 18
+    srtp_profile_sdt_skf_hy_sm4_cbc = 18,
+    srtp_profile_sdt_soft_sm4_ecb = 19,
+    srtp_profile_sdt_soft_sm4_cbc = 20,
+    srtp_profile_sdt_soft_sm4_ofb = 21,
+    srtp_profile_sdt_soft_sm4_ctr = 22,
+    srtp_profile_sdt_soft_sm4_ctr_hmac_sm3_80 = 23,
+    srtp_profile_zuc_128_hmac_sm3_80 = 24,
+    srtp_profile_zuc_128_eia3_32 = 25
 } srtp_profile_t;
 
 /**
@@ -157,13 +157,46 @@ typedef struct srtp_stream_ctx_t_ {
 /*
  * an srtp_ctx_t holds a stream list and a service description
  */
+/*
+ * the streams of a session are kept in stream_list and are also indexed
+ * by ssrc in stream_index, an open addressing hash table with linear
+ * probing that is never more than half full.  when several streams
+ * share an ssrc, the index refers to the first one in stream_list, so
+ * lookups behave exactly as a walk down the list.  last_stream caches
+ * the result of the latest lookup, since consecutive packets usually
+ * belong to the same stream.
+ */
+#define SRTP_STREAM_INDEX_MIN_SIZE 8
+
 typedef struct srtp_ctx_t_ {
     struct srtp_stream_ctx_t_ *stream_list;     /* linked list of streams     */
     struct srtp_stream_ctx_t_ *stream_template; /* act as template for other  */
                                                 /* streams                    */
+    struct srtp_stream_ctx_t_ **stream_index;   /* streams hashed by ssrc     */
+    unsigned int stream_index_size;             /* slots, power of two or 0   */
+    unsigned int stream_count;                  /* streams in stream_index    */
+    struct srtp_stream_ctx_t_ *last_stream;     /* latest lookup result       */
     void *user_data;                            /* user custom data           */
 } srtp_ctx_t_;
 
+/*
+ * an srtp_deferred_cipher_t records the payload cipher operation of one
+ * packet of srtp_protect_batch()/srtp_unprotect_batch(), to be submitted
+ * together with the other packets that use the same cipher; cipher is
+ * NULL when the packet was processed completely in the first pass.  when
+ * rtp_auth is set, the tag is computed over auth_start/auth_len once the
+ * payload has been encrypted.
+ */
+typedef struct srtp_deferred_cipher_t {
+    srtp_cipher_t *cipher;
+    srtp_cipher_batch_entry_t entry;
+    srtp_auth_t *rtp_auth;
+    uint8_t *auth_start;
+    int auth_len;
+    uint8_t *auth_tag;
+    srtp_xtd_seq_num_t est;
+} srtp_deferred_cipher_t;
+
 /*
  * srtp_hdr_t represents an RTP or SRTP header.  The bit-fields in
  * this structure should be declared "unsigned int" instead of
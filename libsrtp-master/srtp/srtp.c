@@ -67,6 +67,7 @@
 #endif
 
 #include "sdt_skf_hy_cipher.h"		//added by bruce, for close hangye SD_key handle//
+#include "sdt_sdf_pool.h"
 
 /* the debug module for srtp */
 srtp_debug_module_t mod_srtp = {
@@ -605,6 +606,176 @@ srtp_err_status_t srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
     return srtp_err_status_ok;
 }
 
+/*
+ * stream index functions, internal to libSRTP
+ *
+ * srtp_stream_index_slot(ctx, ssrc) returns the slot of stream_index
+ * that holds the stream for ssrc, or the empty slot where it belongs
+ *
+ * srtp_stream_index_add(ctx, str) makes str the stream that is found
+ * for its ssrc, growing the index when needed
+ *
+ * srtp_stream_index_del(ctx, str) removes str from the index; if another
+ * stream in stream_list shares its ssrc, that one is indexed instead
+ *
+ * srtp_stream_index_rebuild(ctx) indexes stream_list from scratch
+ *
+ * srtp_insert_stream(ctx, str) adds str to the head of stream_list
+ */
+
+static inline unsigned int srtp_stream_index_home(unsigned int mask,
+                                                  uint32_t ssrc)
+{
+    /* ssrc values are random, but tests and some endpoints count them up */
+    uint32_t h = ssrc * 0x9e3779b1;
+
+    return (h ^ (h >> 16)) & mask;
+}
+
+static unsigned int srtp_stream_index_slot(const srtp_ctx_t *ctx,
+                                           uint32_t ssrc)
+{
+    unsigned int mask = ctx->stream_index_size - 1;
+    unsigned int i = srtp_stream_index_home(mask, ssrc);
+
+    while (ctx->stream_index[i] != NULL && ctx->stream_index[i]->ssrc != ssrc)
+        i = (i + 1) & mask;
+
+    return i;
+}
+
+static srtp_err_status_t srtp_stream_index_grow(srtp_ctx_t *ctx)
+{
+    srtp_stream_ctx_t **old_index = ctx->stream_index;
+    unsigned int old_size = ctx->stream_index_size;
+    unsigned int size, i;
+
+    size = old_size ? 2 * old_size : SRTP_STREAM_INDEX_MIN_SIZE;
+    ctx->stream_index = (srtp_stream_ctx_t **)srtp_crypto_alloc(
+        size * sizeof(srtp_stream_ctx_t *));
+    if (ctx->stream_index == NULL) {
+        ctx->stream_index = old_index;
+        return srtp_err_status_alloc_fail;
+    }
+    memset(ctx->stream_index, 0, size * sizeof(srtp_stream_ctx_t *));
+    ctx->stream_index_size = size;
+
+    for (i = 0; i < old_size; i++) {
+        if (old_index[i] != NULL) {
+            ctx->stream_index[srtp_stream_index_slot(ctx, old_index[i]->ssrc)] =
+                old_index[i];
+        }
+    }
+    if (old_index != NULL)
+        srtp_crypto_free(old_index);
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_stream_index_add(srtp_ctx_t *ctx,
+                                               srtp_stream_ctx_t *str)
+{
+    srtp_err_status_t status;
+    unsigned int i;
+
+    if (2 * (ctx->stream_count + 1) > ctx->stream_index_size) {
+        status = srtp_stream_index_grow(ctx);
+        if (status)
+            return status;
+    }
+
+    i = srtp_stream_index_slot(ctx, str->ssrc);
+    if (ctx->stream_index[i] == NULL)
+        ctx->stream_count++;
+    ctx->stream_index[i] = str;
+    ctx->last_stream = str;
+
+    return srtp_err_status_ok;
+}
+
+static void srtp_stream_index_del(srtp_ctx_t *ctx, srtp_stream_ctx_t *str)
+{
+    unsigned int mask, i, j, home;
+    srtp_stream_ctx_t *shadowed;
+
+    if (ctx->stream_index_size == 0)
+        return;
+
+    if (ctx->last_stream == str)
+        ctx->last_stream = NULL;
+
+    i = srtp_stream_index_slot(ctx, str->ssrc);
+    if (ctx->stream_index[i] != str)
+        return;
+
+    /* a stream with the same ssrc further down the list becomes visible */
+    for (shadowed = ctx->stream_list; shadowed != NULL;
+         shadowed = shadowed->next) {
+        if (shadowed != str && shadowed->ssrc == str->ssrc) {
+            ctx->stream_index[i] = shadowed;
+            return;
+        }
+    }
+
+    ctx->stream_index[i] = NULL;
+    ctx->stream_count--;
+
+    /* move the rest of the probe sequence back over the hole */
+    mask = ctx->stream_index_size - 1;
+    for (j = (i + 1) & mask; ctx->stream_index[j] != NULL; j = (j + 1) & mask) {
+        home = srtp_stream_index_home(mask, ctx->stream_index[j]->ssrc);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            ctx->stream_index[i] = ctx->stream_index[j];
+            ctx->stream_index[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+static srtp_err_status_t srtp_stream_index_rebuild(srtp_ctx_t *ctx)
+{
+    srtp_err_status_t status;
+    srtp_stream_ctx_t *str;
+    unsigned int i;
+
+    if (ctx->stream_index_size != 0)
+        memset(ctx->stream_index, 0,
+               ctx->stream_index_size * sizeof(srtp_stream_ctx_t *));
+    ctx->stream_count = 0;
+    ctx->last_stream = NULL;
+
+    for (str = ctx->stream_list; str != NULL; str = str->next) {
+        if (2 * (ctx->stream_count + 1) > ctx->stream_index_size) {
+            status = srtp_stream_index_grow(ctx);
+            if (status)
+                return status;
+        }
+        /* the first stream in the list wins */
+        i = srtp_stream_index_slot(ctx, str->ssrc);
+        if (ctx->stream_index[i] == NULL) {
+            ctx->stream_index[i] = str;
+            ctx->stream_count++;
+        }
+    }
+
+    return srtp_err_status_ok;
+}
+
+static srtp_err_status_t srtp_insert_stream(srtp_ctx_t *ctx,
+                                            srtp_stream_ctx_t *str)
+{
+    srtp_err_status_t status;
+
+    status = srtp_stream_index_add(ctx, str);
+    if (status)
+        return status;
+
+    str->next = ctx->stream_list;
+    ctx->stream_list = str;
+
+    return srtp_err_status_ok;
+}
+
 /*
  * key derivation functions, internal to libSRTP
  *
@@ -2059,8 +2230,11 @@ static srtp_err_status_t srtp_unprotect_aead(srtp_ctx_t *ctx,
         }
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        status = srtp_insert_stream(ctx, new_stream);
+        if (status) {
+            srtp_stream_dealloc(new_stream, ctx->stream_template);
+            return status;
+        }
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -2087,11 +2261,21 @@ srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len)
     return srtp_protect_mki(ctx, rtp_hdr, pkt_octet_len, 0, 0);
 }
 
-srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
-                                   void *rtp_hdr,
-                                   int *pkt_octet_len,
-                                   unsigned int use_mki,
-                                   unsigned int mki_index)
+/*
+ * srtp_protect_rtp(ctx, hdr, len, use_mki, mki_index, defer)
+ *
+ * does the work of srtp_protect_mki().  if defer is non-NULL and the
+ * payload cipher can run after everything else has been decided, the
+ * payload encryption (and the authentication tag over its output) is not
+ * performed here but recorded in *defer for srtp_protect_batch() to
+ * submit together with other packets; defer->cipher stays NULL otherwise.
+ */
+static srtp_err_status_t srtp_protect_rtp(srtp_ctx_t *ctx,
+                                          void *rtp_hdr,
+                                          int *pkt_octet_len,
+                                          unsigned int use_mki,
+                                          unsigned int mki_index,
+                                          srtp_deferred_cipher_t *defer)
 {
     srtp_hdr_t *hdr = (srtp_hdr_t *)rtp_hdr;
     uint32_t *enc_start;      /* pointer to start of encrypted portion  */
@@ -2109,6 +2293,8 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
     srtp_session_keys_t *session_keys = NULL;
     uint8_t *mki_location = NULL;
     int advance_packet_index = 0;
+    int defer_payload;
+    v128_t iv;
 
     debug_print(mod_srtp, "function srtp_protect", NULL);
 
@@ -2142,8 +2328,11 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
                 return status;
 
             /* add new stream to the head of the stream_list */
-            new_stream->next = ctx->stream_list;
-            ctx->stream_list = new_stream;
+            status = srtp_insert_stream(ctx, new_stream);
+            if (status) {
+                srtp_stream_dealloc(new_stream, ctx->stream_template);
+                return status;
+            }
 
             /* set direction to outbound */
             new_stream->direction = dir_srtp_sender;
@@ -2282,14 +2471,24 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
     debug_print(mod_srtp, "estimated packet index: %016llx", est);
 #endif
 
+    /*
+     * a deferred payload is encrypted later, possibly on another thread,
+     * with its own copy of the IV, so the shared cipher is not touched
+     * here; a universal hash needs the keystream prefix now, so it is
+     * never deferred
+     */
+    defer_payload = defer && enc_start &&
+                    !(auth_start &&
+                      srtp_auth_get_prefix_length(session_keys->rtp_auth));
+
     /*
      * if we're using rindael counter mode, set nonce and seq
      */
     if (session_keys->rtp_cipher->type->id == SRTP_AES_ICM_128 ||
         session_keys->rtp_cipher->type->id == SRTP_AES_ICM_192 ||
-        session_keys->rtp_cipher->type->id == SRTP_AES_ICM_256) {
-        v128_t iv;
-
+        session_keys->rtp_cipher->type->id == SRTP_AES_ICM_256 ||
+        session_keys->rtp_cipher->type->id == SRTP_SDT_SOFT_SM4_CTR ||
+        session_keys->rtp_cipher->type->id == SRTP_ZUC_128) {
         iv.v32[0] = 0;
         iv.v32[1] = hdr->ssrc;
 #ifdef NO_64BIT_MATH
@@ -2298,15 +2497,15 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
 #else
         iv.v64[1] = be64_to_cpu(est << 16);
 #endif
-        status = srtp_cipher_set_iv(session_keys->rtp_cipher, (uint8_t *)&iv,
-                                    srtp_direction_encrypt);
+        status = defer_payload ? srtp_err_status_ok
+                               : srtp_cipher_set_iv(session_keys->rtp_cipher,
+                                                    (uint8_t *)&iv,
+                                                    srtp_direction_encrypt);
         if (!status && session_keys->rtp_xtn_hdr_cipher) {
             status = srtp_cipher_set_iv(session_keys->rtp_xtn_hdr_cipher,
                                         (uint8_t *)&iv, srtp_direction_encrypt);
         }
     } else {
-        v128_t iv;
-
 /* otherwise, set the index to est */
 #ifdef NO_64BIT_MATH
         iv.v32[0] = 0;
@@ -2315,8 +2514,10 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
         iv.v64[0] = 0;
 #endif
         iv.v64[1] = be64_to_cpu(est);
-        status = srtp_cipher_set_iv(session_keys->rtp_cipher, (uint8_t *)&iv,
-                                    srtp_direction_encrypt);
+        status = defer_payload ? srtp_err_status_ok
+                               : srtp_cipher_set_iv(session_keys->rtp_cipher,
+                                                    (uint8_t *)&iv,
+                                                    srtp_direction_encrypt);
         if (!status && session_keys->rtp_xtn_hdr_cipher) {
             status = srtp_cipher_set_iv(session_keys->rtp_xtn_hdr_cipher,
                                         (uint8_t *)&iv, srtp_direction_encrypt);
@@ -2366,7 +2567,14 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
     }
 
     /* if we're encrypting, exor keystream into the message */
-    if (enc_start) {
+    if (defer_payload) {
+        defer->cipher = session_keys->rtp_cipher;
+        defer->entry.buffer = (uint8_t *)enc_start;
+        defer->entry.len = (unsigned int)enc_octet_len;
+        defer->entry.iv = iv;
+        defer->entry.status = srtp_err_status_ok;
+        defer->rtp_auth = NULL;
+    } else if (enc_start) {
         status =
             srtp_cipher_encrypt(session_keys->rtp_cipher, (uint8_t *)enc_start,
                                 (unsigned int *)&enc_octet_len);
@@ -2380,9 +2588,16 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
 
     /*
      *  if we're authenticating, run authentication function and put result
-     *  into the auth_tag
+     *  into the auth_tag; a deferred payload is authenticated once it has
+     *  been encrypted
      */
-    if (auth_start) {
+    if (auth_start && defer_payload) {
+        defer->rtp_auth = session_keys->rtp_auth;
+        defer->auth_start = (uint8_t *)auth_start;
+        defer->auth_len = *pkt_octet_len;
+        defer->auth_tag = auth_tag;
+        defer->est = est;
+    } else if (auth_start) {
         /* initialize auth func context */
         status = srtp_auth_start(session_keys->rtp_auth);
         if (status)
@@ -2424,16 +2639,36 @@ srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
     return srtp_err_status_ok;
 }
 
+srtp_err_status_t srtp_protect_mki(srtp_ctx_t *ctx,
+                                   void *rtp_hdr,
+                                   int *pkt_octet_len,
+                                   unsigned int use_mki,
+                                   unsigned int mki_index)
+{
+    return srtp_protect_rtp(ctx, rtp_hdr, pkt_octet_len, use_mki, mki_index,
+                            NULL);
+}
+
 srtp_err_status_t
 srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len)
 {
     return srtp_unprotect_mki(ctx, srtp_hdr, pkt_octet_len, 0);
 }
 
-srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
-                                     void *srtp_hdr,
-                                     int *pkt_octet_len,
-                                     unsigned int use_mki)
+/*
+ * srtp_unprotect_rtp(ctx, hdr, len, use_mki, defer)
+ *
+ * does the work of srtp_unprotect_mki().  if defer is non-NULL, the
+ * payload decryption is recorded in *defer instead of being performed;
+ * authentication, the replay database and the stream list have all been
+ * updated by the time this returns, so a packet whose deferred decryption
+ * later fails still counts as received.
+ */
+static srtp_err_status_t srtp_unprotect_rtp(srtp_ctx_t *ctx,
+                                            void *srtp_hdr,
+                                            int *pkt_octet_len,
+                                            unsigned int use_mki,
+                                            srtp_deferred_cipher_t *defer)
 {
     srtp_hdr_t *hdr = (srtp_hdr_t *)srtp_hdr;
     uint32_t *enc_start;            /* pointer to start of encrypted portion  */
@@ -2453,6 +2688,7 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
     int advance_packet_index = 0;
     uint32_t roc_to_set = 0;
     uint16_t seq_to_set = 0;
+    int defer_payload;
 
     debug_print(mod_srtp, "function srtp_unprotect", NULL);
 
@@ -2552,13 +2788,20 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
     /* get tag length from stream */
     tag_len = srtp_auth_get_tag_length(session_keys->rtp_auth);
 
+    /* see srtp_protect_rtp() */
+    defer_payload = defer && (stream->rtp_services & sec_serv_conf) &&
+                    !((stream->rtp_services & sec_serv_auth) &&
+                      session_keys->rtp_auth->prefix_len);
+
     /*
      * set the cipher's IV properly, depending on whatever cipher we
      * happen to be using
      */
     if (session_keys->rtp_cipher->type->id == SRTP_AES_ICM_128 ||
         session_keys->rtp_cipher->type->id == SRTP_AES_ICM_192 ||
-        session_keys->rtp_cipher->type->id == SRTP_AES_ICM_256) {
+        session_keys->rtp_cipher->type->id == SRTP_AES_ICM_256 ||
+        session_keys->rtp_cipher->type->id == SRTP_SDT_SOFT_SM4_CTR ||
+        session_keys->rtp_cipher->type->id == SRTP_ZUC_128) {
         /* aes counter mode */
         iv.v32[0] = 0;
         iv.v32[1] = hdr->ssrc; /* still in network order */
@@ -2568,8 +2811,10 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
 #else
         iv.v64[1] = be64_to_cpu(est << 16);
 #endif
-        status = srtp_cipher_set_iv(session_keys->rtp_cipher, (uint8_t *)&iv,
-                                    srtp_direction_decrypt);
+        status = defer_payload ? srtp_err_status_ok
+                               : srtp_cipher_set_iv(session_keys->rtp_cipher,
+                                                    (uint8_t *)&iv,
+                                                    srtp_direction_decrypt);
         if (!status && session_keys->rtp_xtn_hdr_cipher) {
             status = srtp_cipher_set_iv(session_keys->rtp_xtn_hdr_cipher,
                                         (uint8_t *)&iv, srtp_direction_decrypt);
@@ -2583,8 +2828,10 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
         iv.v64[0] = 0;
 #endif
         iv.v64[1] = be64_to_cpu(est);
-        status = srtp_cipher_set_iv(session_keys->rtp_cipher, (uint8_t *)&iv,
-                                    srtp_direction_decrypt);
+        status = defer_payload ? srtp_err_status_ok
+                               : srtp_cipher_set_iv(session_keys->rtp_cipher,
+                                                    (uint8_t *)&iv,
+                                                    srtp_direction_decrypt);
         if (!status && session_keys->rtp_xtn_hdr_cipher) {
             status = srtp_cipher_set_iv(session_keys->rtp_xtn_hdr_cipher,
                                         (uint8_t *)&iv, srtp_direction_decrypt);
@@ -2716,7 +2963,14 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
     }
 
     /* if we're decrypting, add keystream into ciphertext */
-    if (enc_start) {
+    if (enc_start && defer_payload) {
+        defer->cipher = session_keys->rtp_cipher;
+        defer->entry.buffer = (uint8_t *)enc_start;
+        defer->entry.len = enc_octet_len;
+        defer->entry.iv = iv;
+        defer->entry.status = srtp_err_status_ok;
+        defer->rtp_auth = NULL;
+    } else if (enc_start) {
         status = srtp_cipher_decrypt(session_keys->rtp_cipher,
                                      (uint8_t *)enc_start, &enc_octet_len);
         if (status)
@@ -2767,8 +3021,11 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
             return status;
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        status = srtp_insert_stream(ctx, new_stream);
+        if (status) {
+            srtp_stream_dealloc(new_stream, ctx->stream_template);
+            return status;
+        }
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -2801,6 +3058,321 @@ srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
 
     return srtp_err_status_ok;
 }
+srtp_err_status_t srtp_unprotect_mki(srtp_ctx_t *ctx,
+                                     void *srtp_hdr,
+                                     int *pkt_octet_len,
+                                     unsigned int use_mki)
+{
+    return srtp_unprotect_rtp(ctx, srtp_hdr, pkt_octet_len, use_mki, NULL);
+}
+
+/*
+ * srtp_finish_deferred(d) completes a packet once its deferred payload
+ * operation has run: a cipher error is reported as cipher_fail, and a
+ * sender-side tag that was waiting for the ciphertext is computed
+ */
+static void srtp_finish_deferred(srtp_deferred_cipher_t *d)
+{
+    srtp_err_status_t status;
+
+    if (d->entry.status) {
+        d->entry.status = srtp_err_status_cipher_fail;
+        return;
+    }
+    if (d->rtp_auth == NULL)
+        return;
+
+    status = srtp_auth_start(d->rtp_auth);
+    if (!status)
+        status = srtp_auth_update(d->rtp_auth, d->auth_start, d->auth_len);
+    if (status) {
+        d->entry.status = status;
+        return;
+    }
+    if (srtp_auth_compute(d->rtp_auth, (uint8_t *)&d->est, 4, d->auth_tag))
+        d->entry.status = srtp_err_status_auth_fail;
+}
+
+/*
+ * srtp_batch_auth_ok(d) tells whether the tag of a deferred packet can be
+ * left to the auth type's compute_batch hook: the roc is then written
+ * into the tag field, so that packet and roc form one contiguous buffer,
+ * which needs a tag of at least 4 octets right behind the packet (no mki)
+ */
+static int srtp_batch_auth_ok(const srtp_deferred_cipher_t *d)
+{
+    return d->cipher != NULL && !d->entry.status && d->rtp_auth != NULL &&
+           d->rtp_auth->type->compute_batch != NULL &&
+           d->auth_tag == d->auth_start + d->auth_len &&
+           srtp_auth_get_prefix_length(d->rtp_auth) == 0 &&
+           srtp_auth_get_tag_length(d->rtp_auth) >= 4;
+}
+
+/*
+ * srtp_run_deferred(defer, n, direction)
+ *
+ * submits the payloads recorded in defer[0..n-1], grouped by cipher, and
+ * finishes any authentication tags that had to wait for the ciphertext.
+ * tags whose auth type has a compute_batch hook are computed afterwards,
+ * grouped by auth type. the per-packet results are written back into
+ * defer[i].entry.status.
+ */
+static void srtp_run_deferred(srtp_deferred_cipher_t *defer,
+                              unsigned int num_pkts,
+                              srtp_cipher_direction_t direction)
+{
+    srtp_cipher_batch_entry_t entries[SRTP_MAX_BATCH_PKTS];
+    srtp_auth_batch_entry_t auth_entries[SRTP_MAX_BATCH_PKTS];
+    unsigned int slot[SRTP_MAX_BATCH_PKTS];
+    uint8_t done[SRTP_MAX_BATCH_PKTS];
+    uint8_t batch_auth[SRTP_MAX_BATCH_PKTS];
+    srtp_cipher_t *cipher;
+    const srtp_auth_type_t *auth_type;
+    srtp_deferred_cipher_t *d;
+    unsigned int i, j, n;
+
+    memset(done, 0, sizeof(done));
+    memset(batch_auth, 0, sizeof(batch_auth));
+    for (i = 0; i < num_pkts; i++) {
+        if (done[i] || defer[i].cipher == NULL)
+            continue;
+
+        /* gather every packet that uses this cipher */
+        cipher = defer[i].cipher;
+        n = 0;
+        for (j = i; j < num_pkts; j++) {
+            if (!done[j] && defer[j].cipher == cipher) {
+                entries[n] = defer[j].entry;
+                slot[n++] = j;
+                done[j] = 1;
+            }
+        }
+
+        debug_print(mod_srtp, "batch of %d packets", n);
+        srtp_cipher_process_batch(cipher, entries, n, direction);
+
+        /* scatter the results back */
+        for (j = 0; j < n; j++) {
+            defer[slot[j]].entry.status = entries[j].status;
+            if (srtp_batch_auth_ok(&defer[slot[j]]))
+                batch_auth[slot[j]] = 1;
+            else
+                srtp_finish_deferred(&defer[slot[j]]);
+        }
+    }
+
+    for (i = 0; i < num_pkts; i++) {
+        if (!batch_auth[i])
+            continue;
+
+        /* gather every packet authenticated with this auth type */
+        auth_type = defer[i].rtp_auth->type;
+        n = 0;
+        for (j = i; j < num_pkts; j++) {
+            d = &defer[j];
+            if (!batch_auth[j] || d->rtp_auth->type != auth_type)
+                continue;
+            memcpy(d->auth_tag, &d->est, 4);
+            auth_entries[n].state = d->rtp_auth->state;
+            auth_entries[n].buffer = d->auth_start;
+            auth_entries[n].len = d->auth_len + 4;
+            auth_entries[n].tag = d->auth_tag;
+            auth_entries[n].tag_len = srtp_auth_get_tag_length(d->rtp_auth);
+            auth_entries[n].status = srtp_err_status_ok;
+            slot[n++] = j;
+            batch_auth[j] = 0;
+        }
+
+        debug_print(mod_srtp, "batch of %d tags", n);
+        srtp_auth_compute_batch(auth_type, auth_entries, n);
+
+        for (j = 0; j < n; j++) {
+            if (auth_entries[j].status)
+                defer[slot[j]].entry.status = srtp_err_status_auth_fail;
+        }
+    }
+}
+
+srtp_err_status_t srtp_protect_batch(srtp_ctx_t *ctx,
+                                     void *rtp_hdr[],
+                                     int len[],
+                                     srtp_err_status_t status[],
+                                     unsigned int num_pkts)
+{
+    srtp_deferred_cipher_t defer[SRTP_MAX_BATCH_PKTS];
+    srtp_err_status_t result[SRTP_MAX_BATCH_PKTS];
+    srtp_err_status_t first = srtp_err_status_ok;
+    unsigned int base, i, n;
+
+    if (ctx == NULL || (num_pkts && (rtp_hdr == NULL || len == NULL)))
+        return srtp_err_status_bad_param;
+
+    for (base = 0; base < num_pkts; base += n) {
+        n = num_pkts - base;
+        if (n > SRTP_MAX_BATCH_PKTS)
+            n = SRTP_MAX_BATCH_PKTS;
+
+        for (i = 0; i < n; i++) {
+            defer[i].cipher = NULL;
+            result[i] = srtp_protect_rtp(ctx, rtp_hdr[base + i], &len[base + i],
+                                         0, 0, &defer[i]);
+            if (result[i])
+                defer[i].cipher = NULL;
+        }
+
+        srtp_run_deferred(defer, n, srtp_direction_encrypt);
+
+        for (i = 0; i < n; i++) {
+            if (!result[i] && defer[i].cipher)
+                result[i] = defer[i].entry.status;
+            if (status)
+                status[base + i] = result[i];
+            if (result[i] && !first)
+                first = result[i];
+        }
+    }
+
+    return first;
+}
+
+srtp_err_status_t srtp_unprotect_batch(srtp_ctx_t *ctx,
+                                       void *srtp_hdr[],
+                                       int len[],
+                                       srtp_err_status_t status[],
+                                       unsigned int num_pkts)
+{
+    srtp_deferred_cipher_t defer[SRTP_MAX_BATCH_PKTS];
+    srtp_err_status_t result[SRTP_MAX_BATCH_PKTS];
+    srtp_err_status_t first = srtp_err_status_ok;
+    unsigned int base, i, n;
+
+    if (ctx == NULL || (num_pkts && (srtp_hdr == NULL || len == NULL)))
+        return srtp_err_status_bad_param;
+
+    for (base = 0; base < num_pkts; base += n) {
+        n = num_pkts - base;
+        if (n > SRTP_MAX_BATCH_PKTS)
+            n = SRTP_MAX_BATCH_PKTS;
+
+        for (i = 0; i < n; i++) {
+            defer[i].cipher = NULL;
+            result[i] = srtp_unprotect_rtp(ctx, srtp_hdr[base + i],
+                                           &len[base + i], 0, &defer[i]);
+            if (result[i])
+                defer[i].cipher = NULL;
+        }
+
+        srtp_run_deferred(defer, n, srtp_direction_decrypt);
+
+        for (i = 0; i < n; i++) {
+            if (!result[i] && defer[i].cipher)
+                result[i] = defer[i].entry.status;
+            if (status)
+                status[base + i] = result[i];
+            if (result[i] && !first)
+                first = result[i];
+        }
+    }
+
+    return first;
+}
+
+/*
+ * an srtp_async_packet_t carries one packet of srtp_protect_async() or
+ * srtp_unprotect_async() through the offload queue
+ */
+typedef struct {
+    srtp_crypto_async_job_t job;
+    srtp_deferred_cipher_t defer;
+    void *hdr;
+    int len;
+    srtp_async_done_func_t done;
+    void *user_data;
+} srtp_async_packet_t;
+
+static void srtp_async_packet_done(srtp_crypto_async_job_t *job)
+{
+    srtp_async_packet_t *pkt = (srtp_async_packet_t *)job->user_data;
+    srtp_err_status_t status = srtp_err_status_ok;
+
+    if (pkt->defer.cipher) {
+        pkt->defer.entry.status = job->entry.status;
+        srtp_finish_deferred(&pkt->defer);
+        status = pkt->defer.entry.status;
+    }
+
+    pkt->done(pkt->hdr, pkt->len, status, pkt->user_data);
+    srtp_crypto_free(pkt);
+}
+
+static srtp_err_status_t srtp_submit_async(srtp_ctx_t *ctx,
+                                           srtp_crypto_async_queue_t *queue,
+                                           void *hdr,
+                                           int len,
+                                           srtp_async_done_func_t done,
+                                           void *user_data,
+                                           srtp_cipher_direction_t direction)
+{
+    srtp_async_packet_t *pkt;
+    srtp_err_status_t status;
+
+    if (ctx == NULL || queue == NULL || hdr == NULL || done == NULL)
+        return srtp_err_status_bad_param;
+
+    pkt = (srtp_async_packet_t *)srtp_crypto_alloc(sizeof(srtp_async_packet_t));
+    if (pkt == NULL)
+        return srtp_err_status_alloc_fail;
+
+    memset(pkt, 0, sizeof(srtp_async_packet_t));
+    pkt->hdr = hdr;
+    pkt->len = len;
+    pkt->done = done;
+    pkt->user_data = user_data;
+
+    if (direction == srtp_direction_encrypt)
+        status = srtp_protect_rtp(ctx, hdr, &pkt->len, 0, 0, &pkt->defer);
+    else
+        status = srtp_unprotect_rtp(ctx, hdr, &pkt->len, 0, &pkt->defer);
+    if (status) {
+        srtp_crypto_free(pkt);
+        return status;
+    }
+
+    pkt->job.cipher = pkt->defer.cipher;
+    pkt->job.direction = direction;
+    pkt->job.entry = pkt->defer.entry;
+    pkt->job.done = srtp_async_packet_done;
+    pkt->job.user_data = pkt;
+
+    status = srtp_crypto_kernel_async_submit(queue, &pkt->job);
+    if (status)
+        srtp_crypto_free(pkt);
+
+    return status;
+}
+
+srtp_err_status_t srtp_protect_async(srtp_ctx_t *ctx,
+                                     srtp_crypto_async_queue_t *queue,
+                                     void *rtp_hdr,
+                                     int len,
+                                     srtp_async_done_func_t done,
+                                     void *user_data)
+{
+    return srtp_submit_async(ctx, queue, rtp_hdr, len, done, user_data,
+                             srtp_direction_encrypt);
+}
+
+srtp_err_status_t srtp_unprotect_async(srtp_ctx_t *ctx,
+                                       srtp_crypto_async_queue_t *queue,
+                                       void *srtp_hdr,
+                                       int len,
+                                       srtp_async_done_func_t done,
+                                       void *user_data)
+{
+    return srtp_submit_async(ctx, queue, srtp_hdr, len, done, user_data,
+                             srtp_direction_decrypt);
+}
+
 //added by bruce---/
 srtp_err_status_t set_hy_sd_handle(void* dev_hd, int* value)
 {
@@ -2866,6 +3438,7 @@ srtp_err_status_t srtp_init()
 srtp_err_status_t srtp_shutdown()
 {
     srtp_err_status_t status;
+    srtp_err_status_t result = srtp_err_status_ok;
 
     /* shut down crypto kernel */
     status = srtp_crypto_kernel_shutdown();
@@ -2874,6 +3447,16 @@ srtp_err_status_t srtp_shutdown()
 
     /* shutting down crypto kernel frees the srtp debug module as well */
 
+    /*
+     * all sdf ciphers are gone by now, close the shared device if one was
+     * opened; a failure is reported, but the SD_key teardown still runs
+     */
+    if (srtp_sdt_sdf_pool_in_use()) {
+        status = srtp_sdt_sdf_pool_shutdown();
+        if (status)
+            result = status;
+    }
+
 //added by bruce, for close SD_key dev_handle once at last//
     if(Get_dev_handle_status() == 0)
     {
@@ -2886,7 +3469,7 @@ srtp_err_status_t srtp_shutdown()
 
 //added by bruce, for close SD_key dev_handle once at last//
 
-    return srtp_err_status_ok;
+    return result;
 }
 
 /*
@@ -2919,16 +3502,20 @@ srtp_stream_ctx_t *srtp_get_stream(srtp_t srtp, uint32_t ssrc)
 {
     srtp_stream_ctx_t *stream;
 
-    /* walk down list until ssrc is found */
-    stream = srtp->stream_list;
-    while (stream != NULL) {
-        if (stream->ssrc == ssrc)
-            return stream;
-        stream = stream->next;
-    }
+    /* most packets belong to the same stream as the previous one */
+    stream = srtp->last_stream;
+    if (stream != NULL && stream->ssrc == ssrc)
+        return stream;
 
-    /* we haven't found our ssrc, so return a null */
-    return NULL;
+    if (srtp->stream_index_size == 0)
+        return NULL;
+
+    /* look ssrc up in the index; a null means that we haven't seen it */
+    stream = srtp->stream_index[srtp_stream_index_slot(srtp, ssrc)];
+    if (stream != NULL)
+        srtp->last_stream = stream;
+
+    return stream;
 }
 
 srtp_err_status_t srtp_dealloc(srtp_t session)
@@ -2959,7 +3546,9 @@ srtp_err_status_t srtp_dealloc(srtp_t session)
             return status;
     }
 
-    /* deallocate session context */
+    /* deallocate the stream index and session context */
+    if (session->stream_index != NULL)
+        srtp_crypto_free(session->stream_index);
     srtp_crypto_free(session);
 
     return srtp_err_status_ok;
@@ -3012,8 +3601,11 @@ srtp_err_status_t srtp_add_stream(srtp_t session, const srtp_policy_t *policy)
         session->stream_template->direction = dir_srtp_receiver;
         break;
     case (ssrc_specific):
-        tmp->next = session->stream_list;
-        session->stream_list = tmp;
+        status = srtp_insert_stream(session, tmp);
+        if (status) {
+            srtp_stream_dealloc(tmp, NULL);
+            return status;
+        }
         break;
     case (ssrc_undefined):
     default:
@@ -3046,6 +3638,10 @@ srtp_err_status_t srtp_create(srtp_t *session, /* handle for session     */
      */
     ctx->stream_template = NULL;
     ctx->stream_list = NULL;
+    ctx->stream_index = NULL;
+    ctx->stream_index_size = 0;
+    ctx->stream_count = 0;
+    ctx->last_stream = NULL;
     ctx->user_data = NULL;
     while (policy != NULL) {
         stat = srtp_add_stream(ctx, policy);
@@ -3081,7 +3677,8 @@ srtp_err_status_t srtp_remove_stream(srtp_t session, uint32_t ssrc)
     if (stream == NULL)
         return srtp_err_status_no_ctx;
 
-    /* remove stream from the list */
+    /* remove stream from the index and the list */
+    srtp_stream_index_del(session, stream);
     if (last_stream == stream)
         /* stream was first in list */
         session->stream_list = stream->next;
@@ -3211,6 +3808,7 @@ static srtp_err_status_t update_template_streams(srtp_t session,
         }
         tail->next = session->stream_list;
         session->stream_list = new_stream_list;
+        status = srtp_stream_index_rebuild(session);
     }
     return status;
 }
@@ -3523,6 +4121,105 @@ void srtp_crypto_policy_set_sdt_skf_hy_sm4_cbc(srtp_crypto_policy_t *p)
     p->sec_serv = sec_serv_conf;
 }
 
+void srtp_crypto_policy_set_sdt_soft_sm4_ecb(srtp_crypto_policy_t *p)
+{
+    /*
+     * software sm4, no crypto device needed
+     */
+
+    p->cipher_type = SRTP_SDT_SOFT_SM4_ECB;
+    p->cipher_key_len = 16;
+    p->auth_type = SRTP_NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 0;
+    p->sec_serv = sec_serv_conf;
+}
+
+void srtp_crypto_policy_set_sdt_soft_sm4_cbc(srtp_crypto_policy_t *p)
+{
+    /*
+     * software sm4, no crypto device needed
+     */
+
+    p->cipher_type = SRTP_SDT_SOFT_SM4_CBC;
+    p->cipher_key_len = 16;
+    p->auth_type = SRTP_NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 0;
+    p->sec_serv = sec_serv_conf;
+}
+
+void srtp_crypto_policy_set_sdt_soft_sm4_ofb(srtp_crypto_policy_t *p)
+{
+    /*
+     * software sm4, no crypto device needed
+     */
+
+    p->cipher_type = SRTP_SDT_SOFT_SM4_OFB;
+    p->cipher_key_len = 16;
+    p->auth_type = SRTP_NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 0;
+    p->sec_serv = sec_serv_conf;
+}
+
+void srtp_crypto_policy_set_sdt_soft_sm4_ctr(srtp_crypto_policy_t *p)
+{
+    /*
+     * software sm4, no crypto device needed
+     */
+
+    p->cipher_type = SRTP_SDT_SOFT_SM4_CTR;
+    p->cipher_key_len = 16;
+    p->auth_type = SRTP_NULL_AUTH;
+    p->auth_key_len = 0;
+    p->auth_tag_len = 0;
+    p->sec_serv = sec_serv_conf;
+}
+
+void srtp_crypto_policy_set_sdt_soft_sm4_ctr_hmac_sm3_80(srtp_crypto_policy_t *p)
+{
+    /*
+     * software sm4 ctr with an 80-bit hmac-sm3 tag
+     */
+
+    p->cipher_type = SRTP_SDT_SOFT_SM4_CTR;
+    p->cipher_key_len = 16;
+    p->auth_type = SRTP_HMAC_SM3;
+    p->auth_key_len = 32; /* 256 bit key               */
+    p->auth_tag_len = 10; /* 80 bit tag                */
+    p->sec_serv = sec_serv_conf_and_auth;
+}
+
+void srtp_crypto_policy_set_zuc_128_hmac_sm3_80(srtp_crypto_policy_t *p)
+{
+    /*
+     * zuc-128 with an 80-bit hmac-sm3 tag
+     */
+
+    p->cipher_type = SRTP_ZUC_128;
+    p->cipher_key_len = SRTP_ZUC_128_KEY_LEN;
+    p->auth_type = SRTP_HMAC_SM3;
+    p->auth_key_len = 32; /* 256 bit key               */
+    p->auth_tag_len = 10; /* 80 bit tag                */
+    p->sec_serv = sec_serv_conf_and_auth;
+}
+
+void srtp_crypto_policy_set_zuc_128_eia3_32(srtp_crypto_policy_t *p)
+{
+    /*
+     * zuc-128 with a 32-bit 128-eia3 tag; the tag is masked with the
+     * zuc keystream, so authentication requires confidentiality
+     */
+
+    p->cipher_type = SRTP_ZUC_128;
+    p->cipher_key_len = SRTP_ZUC_128_KEY_LEN;
+    p->auth_type = SRTP_ZUC_EIA3;
+    p->auth_key_len = 16; /* 128 bit key               */
+    p->auth_tag_len = 4;  /* 32 bit tag                */
+    p->sec_serv = sec_serv_conf_and_auth;
+}
+
 
 void srtp_crypto_policy_set_aes_cm_256_hmac_sha1_80(srtp_crypto_policy_t *p)
 {
@@ -4119,8 +4816,11 @@ srtp_unprotect_rtcp_aead(srtp_t ctx,
         }
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        status = srtp_insert_stream(ctx, new_stream);
+        if (status) {
+            srtp_stream_dealloc(new_stream, ctx->stream_template);
+            return status;
+        }
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -4183,8 +4883,11 @@ srtp_err_status_t srtp_protect_rtcp_mki(srtp_t ctx,
                 return status;
 
             /* add new stream to the head of the stream_list */
-            new_stream->next = ctx->stream_list;
-            ctx->stream_list = new_stream;
+            status = srtp_insert_stream(ctx, new_stream);
+            if (status) {
+                srtp_stream_dealloc(new_stream, ctx->stream_template);
+                return status;
+            }
 
             /* set stream (the pointer used in this function) */
             stream = new_stream;
@@ -4285,7 +4988,9 @@ srtp_err_status_t srtp_protect_rtcp_mki(srtp_t ctx,
      */
     if (session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_128 ||
         session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_192 ||
-        session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_256) {
+        session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_256 ||
+        session_keys->rtcp_cipher->type->id == SRTP_SDT_SOFT_SM4_CTR ||
+        session_keys->rtcp_cipher->type->id == SRTP_ZUC_128) {
         v128_t iv;
 
         iv.v32[0] = 0;
@@ -4550,7 +5255,9 @@ srtp_err_status_t srtp_unprotect_rtcp_mki(srtp_t ctx,
      */
     if (session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_128 ||
         session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_192 ||
-        session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_256) {
+        session_keys->rtcp_cipher->type->id == SRTP_AES_ICM_256 ||
+        session_keys->rtcp_cipher->type->id == SRTP_SDT_SOFT_SM4_CTR ||
+        session_keys->rtcp_cipher->type->id == SRTP_ZUC_128) {
         v128_t iv;
 
         iv.v32[0] = 0;
@@ -4574,6 +5281,21 @@ srtp_err_status_t srtp_unprotect_rtcp_mki(srtp_t ctx,
     if (status)
         return srtp_err_status_cipher_fail;
 
+    /*
+     * if we're authenticating using a universal hash, put the keystream
+     * prefix into tmp_tag, where the hash is added to it; this has to
+     * come before the payload is decrypted, as in srtp_protect_rtcp()
+     */
+    prefix_len = srtp_auth_get_prefix_length(session_keys->rtcp_auth);
+    if (prefix_len) {
+        status = srtp_cipher_output(session_keys->rtcp_cipher, tmp_tag,
+                                    &prefix_len);
+        debug_print(mod_srtp, "keystream prefix: %s",
+                    srtp_octet_string_hex_string(tmp_tag, prefix_len));
+        if (status)
+            return srtp_err_status_cipher_fail;
+    }
+
     /* initialize auth func context */
     srtp_auth_start(session_keys->rtcp_auth);
 
@@ -4591,20 +5313,6 @@ srtp_err_status_t srtp_unprotect_rtcp_mki(srtp_t ctx,
     if (octet_string_is_eq(tmp_tag, auth_tag, tag_len))
         return srtp_err_status_auth_fail;
 
-    /*
-     * if we're authenticating using a universal hash, put the keystream
-     * prefix into the authentication tag
-     */
-    prefix_len = srtp_auth_get_prefix_length(session_keys->rtcp_auth);
-    if (prefix_len) {
-        status = srtp_cipher_output(session_keys->rtcp_cipher, auth_tag,
-                                    &prefix_len);
-        debug_print(mod_srtp, "keystream prefix: %s",
-                    srtp_octet_string_hex_string(auth_tag, prefix_len));
-        if (status)
-            return srtp_err_status_cipher_fail;
-    }
-
     /* if we're decrypting, exor keystream into the message */
     if (enc_start) {
         status = srtp_cipher_decrypt(session_keys->rtcp_cipher,
@@ -4664,8 +5372,11 @@ srtp_err_status_t srtp_unprotect_rtcp_mki(srtp_t ctx,
             return status;
 
         /* add new stream to the head of the stream_list */
-        new_stream->next = ctx->stream_list;
-        ctx->stream_list = new_stream;
+        status = srtp_insert_stream(ctx, new_stream);
+        if (status) {
+            srtp_stream_dealloc(new_stream, ctx->stream_template);
+            return status;
+        }
 
         /* set stream (the pointer used in this function) */
         stream = new_stream;
@@ -4760,6 +5471,34 @@ srtp_crypto_policy_set_from_profile_for_rtp(srtp_crypto_policy_t *policy,
      	srtp_crypto_policy_set_sdt_skf_hy_sm4_cbc(policy);
      	break;
 
+    case srtp_profile_sdt_soft_sm4_ecb:
+        srtp_crypto_policy_set_sdt_soft_sm4_ecb(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_cbc:
+        srtp_crypto_policy_set_sdt_soft_sm4_cbc(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ofb:
+        srtp_crypto_policy_set_sdt_soft_sm4_ofb(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ctr:
+        srtp_crypto_policy_set_sdt_soft_sm4_ctr(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ctr_hmac_sm3_80:
+        srtp_crypto_policy_set_sdt_soft_sm4_ctr_hmac_sm3_80(policy);
+        break;
+
+    case srtp_profile_zuc_128_hmac_sm3_80:
+        srtp_crypto_policy_set_zuc_128_hmac_sm3_80(policy);
+        break;
+
+    case srtp_profile_zuc_128_eia3_32:
+        srtp_crypto_policy_set_zuc_128_eia3_32(policy);
+        break;
+
 /* the following profiles are not (yet) supported */
     case srtp_profile_null_sha1_32:
     default:
@@ -4836,6 +5575,34 @@ srtp_crypto_policy_set_from_profile_for_rtcp(srtp_crypto_policy_t *policy,
      	srtp_crypto_policy_set_sdt_skf_hy_sm4_cbc(policy);
      	break;
 
+    case srtp_profile_sdt_soft_sm4_ecb:
+        srtp_crypto_policy_set_sdt_soft_sm4_ecb(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_cbc:
+        srtp_crypto_policy_set_sdt_soft_sm4_cbc(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ofb:
+        srtp_crypto_policy_set_sdt_soft_sm4_ofb(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ctr:
+        srtp_crypto_policy_set_sdt_soft_sm4_ctr(policy);
+        break;
+
+    case srtp_profile_sdt_soft_sm4_ctr_hmac_sm3_80:
+        srtp_crypto_policy_set_sdt_soft_sm4_ctr_hmac_sm3_80(policy);
+        break;
+
+    case srtp_profile_zuc_128_hmac_sm3_80:
+        srtp_crypto_policy_set_zuc_128_hmac_sm3_80(policy);
+        break;
+
+    case srtp_profile_zuc_128_eia3_32:
+        srtp_crypto_policy_set_zuc_128_eia3_32(policy);
+        break;
+
     /* the following profiles are not (yet) supported */
 
     case srtp_profile_null_sha1_32:
@@ -4881,6 +5648,17 @@ unsigned int srtp_profile_get_master_key_length(srtp_profile_t profile)
     case srtp_profile_sdt_sm4_ofb:
     	return SRTP_SDT_SM4_KEY_LEN;
     	break;
+    case srtp_profile_sdt_soft_sm4_ecb:
+    case srtp_profile_sdt_soft_sm4_cbc:
+    case srtp_profile_sdt_soft_sm4_ofb:
+    case srtp_profile_sdt_soft_sm4_ctr:
+    case srtp_profile_sdt_soft_sm4_ctr_hmac_sm3_80:
+        return SRTP_SDT_SM4_KEY_LEN;
+        break;
+    case srtp_profile_zuc_128_hmac_sm3_80:
+    case srtp_profile_zuc_128_eia3_32:
+        return SRTP_ZUC_128_KEY_LEN;
+        break;
     /* the following profiles are not (yet) supported */
     case srtp_profile_null_sha1_32:
     default:
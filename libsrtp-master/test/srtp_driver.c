@@ -49,6 +49,7 @@
 #include <time.h>     /* for clock()           */
 #include <stdlib.h>   /* for malloc(), free()  */
 #include <stdio.h>    /* for print(), fflush() */
+#include <unistd.h>   /* for usleep()          */
 #include "getopt_s.h" /* for local getopt()    */
 
 #include "srtp_priv.h"
@@ -128,12 +129,24 @@ srtp_do_timing(const srtp_policy_t *policy);
 void
 srtp_do_rejection_timing(const srtp_policy_t *policy);
 
+double
+srtp_packets_per_second(int num_streams, const srtp_policy_t *policy);
+
+void
+srtp_do_ssrc_timing(const srtp_policy_t *policy);
+
 srtp_err_status_t
 srtp_test(const srtp_policy_t *policy, int extension_header, int mki_index);
 
 srtp_err_status_t
 srtcp_test(const srtp_policy_t *policy, int mki_index);
 
+srtp_err_status_t
+srtp_test_batch(const srtp_policy_t *policy);
+
+srtp_err_status_t
+srtp_test_async(const srtp_policy_t *policy);
+
 srtp_err_status_t
 srtp_session_print_policy(srtp_t srtp);
 
@@ -173,10 +186,11 @@ srtp_master_key_t *test_keys[2] = {
 void
 usage (char *prog_name)
 {
-    printf("usage: %s [ -t ][ -c ][ -v ][ -o ][-d <debug_module> ]* [ -l ]\n"
+    printf("usage: %s [ -t ][ -c ][ -s ][ -v ][ -o ][-d <debug_module> ]* [ -l ]\n"
            "  -t         run timing test\n"
            "  -r         run rejection timing test\n"
            "  -c         run codec timing test\n"
+           "  -s         run ssrc lookup timing test\n"
            "  -v         run validation tests\n"
            "  -o         output logging to stdout\n"
            "  -d <mod>   turn on debugging module <mod>\n"
@@ -228,6 +242,7 @@ main (int argc, char *argv[])
     unsigned do_timing_test    = 0;
     unsigned do_rejection_test = 0;
     unsigned do_codec_timing   = 0;
+    unsigned do_ssrc_timing    = 0;
     unsigned do_validation     = 0;
     unsigned do_list_mods      = 0;
     unsigned do_log_stdout     = 0;
@@ -261,7 +276,7 @@ main (int argc, char *argv[])
 
     /* process input arguments */
     while (1) {
-        q = getopt_s(argc, argv, "trcvold:");
+        q = getopt_s(argc, argv, "trcsvold:");
         if (q == -1) {
             break;
         }
@@ -275,6 +290,9 @@ main (int argc, char *argv[])
         case 'c':
             do_codec_timing = 1;
             break;
+        case 's':
+            do_ssrc_timing = 1;
+            break;
         case 'v':
             do_validation = 1;
             break;
@@ -297,7 +315,7 @@ main (int argc, char *argv[])
     }
 
     if (!do_validation && !do_timing_test && !do_codec_timing
-        && !do_list_mods && !do_rejection_test) {
+        && !do_list_mods && !do_rejection_test && !do_ssrc_timing) {
         usage(argv[0]);
     }
 
@@ -374,6 +392,20 @@ main (int argc, char *argv[])
                 printf("failed\n");
                 exit(1);
             }
+            printf("testing srtp_protect_batch and srtp_unprotect_batch\n");
+            if (srtp_test_batch(*policy) == srtp_err_status_ok) {
+                printf("passed\n\n");
+            } else{
+                printf("failed\n");
+                exit(1);
+            }
+            printf("testing srtp_protect_async and srtp_unprotect_async\n");
+            if (srtp_test_async(*policy) == srtp_err_status_ok) {
+                printf("passed\n\n");
+            } else{
+                printf("failed\n");
+                exit(1);
+            }
             policy++;
         }
 
@@ -590,6 +622,23 @@ main (int argc, char *argv[])
         }
     }
 
+    if (do_ssrc_timing) {
+        srtp_policy_t policy;
+
+        memset(&policy, 0, sizeof(policy));
+        srtp_crypto_policy_set_rtp_default(&policy.rtp);
+        srtp_crypto_policy_set_rtcp_default(&policy.rtcp);
+        policy.ssrc.type  = ssrc_specific;
+        policy.key = test_key;
+        policy.ekt = NULL;
+        policy.window_size = 128;
+        policy.allow_repeat_tx = 0;
+        policy.next = NULL;
+
+        srtp_print_policy(&policy);
+        srtp_do_ssrc_timing(&policy);
+    }
+
     if (do_codec_timing) {
         srtp_policy_t policy;
         int ignore;
@@ -826,6 +875,30 @@ srtp_do_rejection_timing (const srtp_policy_t *policy)
 
 }
 
+void
+srtp_do_ssrc_timing (const srtp_policy_t *policy)
+{
+    int num_streams;
+
+    /*
+     * note: the output of this function is formatted so that it
+     * can be used in gnuplot.  '#' indicates a comment, and "\r\n"
+     * terminates a record
+     */
+
+    printf("# testing srtp throughput with many streams per session:\r\n");
+    printf("# number of ssrcs\tpackets per second\r\n");
+
+    for (num_streams = 1; num_streams <= 4096; num_streams *= 16) {
+        printf("%d\t\t\t%e\r\n", num_streams,
+               srtp_packets_per_second(num_streams, policy));
+    }
+
+    /* these extra linefeeds let gnuplot know that a dataset is done */
+    printf("\r\n\r\n");
+
+}
+
 
 #define MAX_MSG_LEN 1024
 
@@ -897,6 +970,88 @@ srtp_bits_per_second (int msg_len_octets, const srtp_policy_t *policy)
            num_trials * CLOCKS_PER_SEC / timer;
 }
 
+/*
+ * srtp_packets_per_second(num_streams, policy) adds num_streams streams
+ * with consecutive ssrc values to one session and protects short packets
+ * for all of them in turn, so that every packet needs a stream lookup
+ */
+
+#define SSRC_TIMING_MSG_LEN 160
+
+double
+srtp_packets_per_second (int num_streams, const srtp_policy_t *policy)
+{
+    srtp_t srtp;
+    srtp_policy_t stream_policy;
+    srtp_hdr_t **mesg;
+    int i, len;
+    clock_t timer;
+    int num_trials = 1000000;
+    srtp_err_status_t status;
+
+    status = srtp_create(&srtp, NULL);
+    if (status) {
+        printf("error: srtp_create() failed with error code %d\n", status);
+        exit(1);
+    }
+
+    mesg = (srtp_hdr_t **)malloc(num_streams * sizeof(srtp_hdr_t *));
+    if (mesg == NULL) {
+        return 0.0; /* indicate failure by returning zero */
+    }
+
+    stream_policy = *policy;
+    stream_policy.next = NULL;
+    for (i = 0; i < num_streams; i++) {
+        stream_policy.ssrc.value = policy->ssrc.value + i;
+        status = srtp_add_stream(srtp, &stream_policy);
+        if (status) {
+            printf("error: srtp_add_stream() failed with error code %d\n",
+                   status);
+            exit(1);
+        }
+        mesg[i] = srtp_create_test_packet(SSRC_TIMING_MSG_LEN,
+                                          stream_policy.ssrc.value, &len);
+        if (mesg[i] == NULL) {
+            return 0.0; /* indicate failure by returning zero */
+        }
+    }
+
+    timer = clock();
+    for (i = 0; i < num_trials; i++) {
+        srtp_hdr_t *hdr = mesg[i % num_streams];
+
+        /* the test packet has room for one trailer only */
+        len = SSRC_TIMING_MSG_LEN + 12;
+        status = srtp_protect(srtp, hdr, &len);
+        if (status) {
+            printf("error: srtp_protect() failed with error code %d\n", status);
+            exit(1);
+        }
+
+        /* increment message number */
+        {
+            /* hack sequence to avoid problems with macros for htons/ntohs on some systems */
+            short new_seq = ntohs(hdr->seq) + 1;
+            hdr->seq = htons(new_seq);
+        }
+    }
+    timer = clock() - timer;
+
+    for (i = 0; i < num_streams; i++) {
+        free(mesg[i]);
+    }
+    free(mesg);
+
+    status = srtp_dealloc(srtp);
+    if (status) {
+        printf("error: srtp_dealloc() failed with error code %d\n", status);
+        exit(1);
+    }
+
+    return (double)num_trials * CLOCKS_PER_SEC / timer;
+}
+
 double
 srtp_rejections_per_second (int msg_len_octets, const srtp_policy_t *policy)
 {
@@ -1223,6 +1378,218 @@ srtp_test (const srtp_policy_t *policy, int extension_header, int mki_index)
 }
 
 
+/*
+ * srtp_test_batch(policy) protects a run of packets of different lengths
+ * once with srtp_protect() and once with srtp_protect_batch() and checks
+ * that the results are identical, then checks that srtp_unprotect_batch()
+ * recovers the original packets and rejects the batch when replayed
+ */
+#define BATCH_TEST_PKTS 8
+
+srtp_err_status_t
+srtp_test_batch (const srtp_policy_t *policy)
+{
+    int i, j;
+    srtp_t srtp_sender, srtp_batch_sender, srtp_rcvr;
+    srtp_err_status_t status = srtp_err_status_ok;
+    srtp_err_status_t pkt_status[BATCH_TEST_PKTS];
+    srtp_hdr_t *ref[BATCH_TEST_PKTS], *pkt[BATCH_TEST_PKTS], *orig[BATCH_TEST_PKTS];
+    void *batch[BATCH_TEST_PKTS];
+    int ref_len[BATCH_TEST_PKTS], len[BATCH_TEST_PKTS], orig_len[BATCH_TEST_PKTS];
+    srtp_policy_t rcvr_policy;
+    uint32_t ssrc;
+
+    if (policy->ssrc.type != ssrc_specific) {
+        ssrc = 0xdecafbad;
+    } else{
+        ssrc = policy->ssrc.value;
+    }
+
+    err_check(srtp_create(&srtp_sender, policy));
+    err_check(srtp_create(&srtp_batch_sender, policy));
+    memcpy(&rcvr_policy, policy, sizeof(srtp_policy_t));
+    if (policy->ssrc.type == ssrc_any_outbound) {
+        rcvr_policy.ssrc.type = ssrc_any_inbound;
+    }
+    err_check(srtp_create(&srtp_rcvr, &rcvr_policy));
+
+    /* payload lengths are multiples of the SM4 block size */
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        ref[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &ref_len[i]);
+        pkt[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &len[i]);
+        orig[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &orig_len[i]);
+        if (ref[i] == NULL || pkt[i] == NULL || orig[i] == NULL) {
+            return srtp_err_status_alloc_fail;
+        }
+        batch[i] = pkt[i];
+    }
+
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        err_check(srtp_protect(srtp_sender, ref[i], &ref_len[i]));
+    }
+    err_check(srtp_protect_batch(srtp_batch_sender, batch, len, pkt_status, BATCH_TEST_PKTS));
+
+    for (i = 0; i < BATCH_TEST_PKTS && !status; i++) {
+        if (pkt_status[i] != srtp_err_status_ok || len[i] != ref_len[i] ||
+            memcmp(pkt[i], ref[i], len[i])) {
+            fprintf(stdout, "batch protect mismatch in packet %d\n", i);
+            status = srtp_err_status_algo_fail;
+        }
+    }
+
+    if (!status) {
+        err_check(srtp_unprotect_batch(srtp_rcvr, batch, len, pkt_status, BATCH_TEST_PKTS));
+        for (i = 0; i < BATCH_TEST_PKTS && !status; i++) {
+            if (len[i] != orig_len[i] || memcmp(pkt[i], orig[i], len[i])) {
+                fprintf(stdout, "batch unprotect mismatch in packet %d\n", i);
+                status = srtp_err_status_algo_fail;
+            }
+        }
+    }
+
+    /* a replayed batch must be rejected packet by packet */
+    if (!status) {
+        for (i = 0; i < BATCH_TEST_PKTS; i++) {
+            memcpy(pkt[i], ref[i], ref_len[i]);
+            len[i] = ref_len[i];
+        }
+        if (srtp_unprotect_batch(srtp_rcvr, batch, len, pkt_status, BATCH_TEST_PKTS) !=
+            srtp_err_status_replay_fail) {
+            status = srtp_err_status_algo_fail;
+        }
+        for (j = 0; j < BATCH_TEST_PKTS; j++) {
+            if (pkt_status[j] != srtp_err_status_replay_fail) {
+                fprintf(stdout, "replayed packet %d not rejected\n", j);
+                status = srtp_err_status_algo_fail;
+            }
+        }
+    }
+
+    err_check(srtp_dealloc(srtp_sender));
+    err_check(srtp_dealloc(srtp_batch_sender));
+    err_check(srtp_dealloc(srtp_rcvr));
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        free(ref[i]);
+        free(pkt[i]);
+        free(orig[i]);
+    }
+    return status;
+}
+
+/*
+ * srtp_test_async(policy) sends a run of packets through an offload
+ * queue, checks them against srtp_protect(), and then unprotects them
+ * through the queue again
+ */
+static int async_test_len[BATCH_TEST_PKTS];
+static srtp_err_status_t async_test_status[BATCH_TEST_PKTS];
+static unsigned int async_test_completed;
+
+static void
+srtp_test_async_done (void *hdr, int len, srtp_err_status_t status, void *user_data)
+{
+    int i = (int)(intptr_t)user_data;
+
+    async_test_len[i] = len;
+    async_test_status[i] = status;
+    async_test_completed++;
+}
+
+static srtp_err_status_t
+srtp_test_async_wait (srtp_crypto_async_queue_t *queue)
+{
+    int tries;
+
+    for (tries = 0; async_test_completed < BATCH_TEST_PKTS && tries < 1000; tries++) {
+        if (srtp_crypto_kernel_async_poll(queue, 0) == 0) {
+            usleep(1000);
+        }
+    }
+    return async_test_completed == BATCH_TEST_PKTS ? srtp_err_status_ok
+                                                   : srtp_err_status_algo_fail;
+}
+
+srtp_err_status_t
+srtp_test_async (const srtp_policy_t *policy)
+{
+    int i;
+    srtp_t srtp_sender, srtp_async_sender, srtp_rcvr;
+    srtp_err_status_t status = srtp_err_status_ok;
+    srtp_hdr_t *ref[BATCH_TEST_PKTS], *pkt[BATCH_TEST_PKTS], *orig[BATCH_TEST_PKTS];
+    int ref_len[BATCH_TEST_PKTS], len, orig_len[BATCH_TEST_PKTS];
+    srtp_crypto_async_queue_t *queue;
+    srtp_policy_t rcvr_policy;
+    uint32_t ssrc;
+
+    if (policy->ssrc.type != ssrc_specific) {
+        ssrc = 0xdecafbad;
+    } else{
+        ssrc = policy->ssrc.value;
+    }
+
+    err_check(srtp_crypto_kernel_async_start(&queue));
+    err_check(srtp_create(&srtp_sender, policy));
+    err_check(srtp_create(&srtp_async_sender, policy));
+    memcpy(&rcvr_policy, policy, sizeof(srtp_policy_t));
+    if (policy->ssrc.type == ssrc_any_outbound) {
+        rcvr_policy.ssrc.type = ssrc_any_inbound;
+    }
+    err_check(srtp_create(&srtp_rcvr, &rcvr_policy));
+
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        ref[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &ref_len[i]);
+        pkt[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &len);
+        orig[i] = srtp_create_test_packet_extended(32 * (i + 1), ssrc, i, 0, &orig_len[i]);
+        if (ref[i] == NULL || pkt[i] == NULL || orig[i] == NULL) {
+            return srtp_err_status_alloc_fail;
+        }
+        err_check(srtp_protect(srtp_sender, ref[i], &ref_len[i]));
+    }
+
+    async_test_completed = 0;
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        err_check(srtp_protect_async(srtp_async_sender, queue, pkt[i], orig_len[i],
+                                     srtp_test_async_done, (void *)(intptr_t)i));
+    }
+    status = srtp_test_async_wait(queue);
+    for (i = 0; i < BATCH_TEST_PKTS && !status; i++) {
+        if (async_test_status[i] != srtp_err_status_ok ||
+            async_test_len[i] != ref_len[i] ||
+            memcmp(pkt[i], ref[i], ref_len[i])) {
+            fprintf(stdout, "async protect mismatch in packet %d\n", i);
+            status = srtp_err_status_algo_fail;
+        }
+    }
+
+    if (!status) {
+        async_test_completed = 0;
+        for (i = 0; i < BATCH_TEST_PKTS; i++) {
+            err_check(srtp_unprotect_async(srtp_rcvr, queue, pkt[i], ref_len[i],
+                                           srtp_test_async_done, (void *)(intptr_t)i));
+        }
+        status = srtp_test_async_wait(queue);
+        for (i = 0; i < BATCH_TEST_PKTS && !status; i++) {
+            if (async_test_status[i] != srtp_err_status_ok ||
+                async_test_len[i] != orig_len[i] ||
+                memcmp(pkt[i], orig[i], orig_len[i])) {
+                fprintf(stdout, "async unprotect mismatch in packet %d\n", i);
+                status = srtp_err_status_algo_fail;
+            }
+        }
+    }
+
+    err_check(srtp_crypto_kernel_async_stop(queue));
+    err_check(srtp_dealloc(srtp_sender));
+    err_check(srtp_dealloc(srtp_async_sender));
+    err_check(srtp_dealloc(srtp_rcvr));
+    for (i = 0; i < BATCH_TEST_PKTS; i++) {
+        free(ref[i]);
+        free(pkt[i]);
+        free(orig[i]);
+    }
+    return status;
+}
+
 srtp_err_status_t
 srtcp_test (const srtp_policy_t *policy, int mki_index)
 {
@@ -2533,7 +2900,8 @@ srtp_test_remove_stream ()
     srtp_err_status_t status;
     srtp_policy_t *policy_list, policy;
     srtp_t session;
-    srtp_stream_t stream;
+    srtp_stream_t stream, old_stream;
+    uint32_t i;
 
     /*
      * srtp_get_stream() is a libSRTP internal function that we declare
@@ -2621,6 +2989,72 @@ srtp_test_remove_stream ()
         return status;
     }
 
+    /*
+     * Now test a session with enough streams to grow the stream index,
+     * removing every other stream
+     */
+    status = srtp_create(&session, NULL);
+    if (status != srtp_err_status_ok) {
+        return status;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        policy.ssrc.value = i;
+        status = srtp_add_stream(session, &policy);
+        if (status != srtp_err_status_ok) {
+            return status;
+        }
+    }
+    for (i = 0; i < 1000; i += 2) {
+        status = srtp_remove_stream(session, htonl(i));
+        if (status != srtp_err_status_ok) {
+            return srtp_err_status_fail;
+        }
+    }
+    for (i = 0; i < 1000; i++) {
+        stream = srtp_get_stream(session, htonl(i));
+        if ((i % 2) && (stream == NULL || stream->ssrc != htonl(i))) {
+            return srtp_err_status_fail;
+        }
+        if (!(i % 2) && stream != NULL) {
+            return srtp_err_status_fail;
+        }
+    }
+
+    /*
+     * a stream added with an ssrc that is already in use hides the old
+     * one, which is found again once the new stream has been removed
+     */
+    old_stream = srtp_get_stream(session, htonl(1));
+    policy.ssrc.value = 1;
+    status = srtp_add_stream(session, &policy);
+    if (status != srtp_err_status_ok) {
+        return status;
+    }
+    stream = srtp_get_stream(session, htonl(1));
+    if (stream == NULL || stream == old_stream) {
+        return srtp_err_status_fail;
+    }
+    status = srtp_remove_stream(session, htonl(1));
+    if (status != srtp_err_status_ok) {
+        return status;
+    }
+    if (srtp_get_stream(session, htonl(1)) != old_stream) {
+        return srtp_err_status_fail;
+    }
+    status = srtp_remove_stream(session, htonl(1));
+    if (status != srtp_err_status_ok) {
+        return status;
+    }
+    if (srtp_get_stream(session, htonl(1)) != NULL) {
+        return srtp_err_status_fail;
+    }
+
+    status = srtp_dealloc(session);
+    if (status != srtp_err_status_ok) {
+        return status;
+    }
+
     return srtp_err_status_ok;
 }
 
@@ -3743,6 +4177,94 @@ const srtp_policy_t hmac_only_with_ekt_policy = {
 };
 
 
+const srtp_policy_t sm4_ctr_hmac_sm3_policy = {
+    { ssrc_any_outbound, 0 }, /* SSRC                           */
+    {                         /* SRTP policy                    */
+        SRTP_SDT_SOFT_SM4_CTR, /* cipher type                 */
+        SRTP_SDT_SM4_KEY_LEN,  /* cipher key length in octets */
+        SRTP_HMAC_SM3,         /* authentication func type    */
+        32,                    /* auth key length in octets   */
+        10,                    /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    {                         /* SRTCP policy                   */
+        SRTP_SDT_SOFT_SM4_CTR, /* cipher type                 */
+        SRTP_SDT_SM4_KEY_LEN,  /* cipher key length in octets */
+        SRTP_HMAC_SM3,         /* authentication func type    */
+        32,                    /* auth key length in octets   */
+        10,                    /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    NULL,
+    (srtp_master_key_t **)test_keys,
+    2,    /* indicates the number of Master keys */
+    NULL, /* indicates that EKT is not in use */
+    128,  /* replay window size */
+    0,    /* retransmission not allowed */
+    NULL, /* no encrypted extension headers */
+    0,    /* list of encrypted extension headers is empty */
+    NULL
+};
+
+const srtp_policy_t zuc_hmac_sm3_policy = {
+    { ssrc_any_outbound, 0 }, /* SSRC                           */
+    {                         /* SRTP policy                    */
+        SRTP_ZUC_128,          /* cipher type                 */
+        SRTP_ZUC_128_KEY_LEN,  /* cipher key length in octets */
+        SRTP_HMAC_SM3,         /* authentication func type    */
+        32,                    /* auth key length in octets   */
+        10,                    /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    {                         /* SRTCP policy                   */
+        SRTP_ZUC_128,          /* cipher type                 */
+        SRTP_ZUC_128_KEY_LEN,  /* cipher key length in octets */
+        SRTP_HMAC_SM3,         /* authentication func type    */
+        32,                    /* auth key length in octets   */
+        10,                    /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    NULL,
+    (srtp_master_key_t **)test_keys,
+    2,    /* indicates the number of Master keys */
+    NULL, /* indicates that EKT is not in use */
+    128,  /* replay window size */
+    0,    /* retransmission not allowed */
+    NULL, /* no encrypted extension headers */
+    0,    /* list of encrypted extension headers is empty */
+    NULL
+};
+
+const srtp_policy_t zuc_eia3_policy = {
+    { ssrc_any_outbound, 0 }, /* SSRC                           */
+    {                         /* SRTP policy                    */
+        SRTP_ZUC_128,          /* cipher type                 */
+        SRTP_ZUC_128_KEY_LEN,  /* cipher key length in octets */
+        SRTP_ZUC_EIA3,         /* authentication func type    */
+        16,                    /* auth key length in octets   */
+        4,                     /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    {                         /* SRTCP policy                   */
+        SRTP_ZUC_128,          /* cipher type                 */
+        SRTP_ZUC_128_KEY_LEN,  /* cipher key length in octets */
+        SRTP_ZUC_EIA3,         /* authentication func type    */
+        16,                    /* auth key length in octets   */
+        4,                     /* auth tag length in octets   */
+        sec_serv_conf_and_auth /* security services flag      */
+    },
+    NULL,
+    (srtp_master_key_t **)test_keys,
+    2,    /* indicates the number of Master keys */
+    NULL, /* indicates that EKT is not in use */
+    128,  /* replay window size */
+    0,    /* retransmission not allowed */
+    NULL, /* no encrypted extension headers */
+    0,    /* list of encrypted extension headers is empty */
+    NULL
+};
+
+
 /*
  * an array of pointers to the policies listed above
  *
@@ -3767,6 +4289,9 @@ policy_array[] = {
     &null_policy,
     &aes_256_hmac_policy,
     &hmac_only_with_ekt_policy,
+    &sm4_ctr_hmac_sm3_policy,
+    &zuc_hmac_sm3_policy,
+    &zuc_eia3_policy,
     NULL
 };
 
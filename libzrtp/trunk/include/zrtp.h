@@ -176,6 +176,17 @@ typedef struct zrtp_config_t
 	/** ZRTP DB-based cache configuration, used if \c cache_type if ZRTP_CACHE_SQLITE */
 	zrtp_cache_db_config_t cache_db_cfg;
 #endif
+
+	/**
+	 * @brief Number of pre-computed DH/ECDH key pairs to keep for every scheme in \c pk_pool_schemes
+	 *
+	 * libzrtp computes key pairs in background and streams take them instead of computing ones
+	 * during the handshake. 0 disables the pool. Default is ZRTP_PK_POOL_SIZE.
+	 */
+	uint32_t				pk_pool_size;
+
+	/** @brief Zero-terminated list of PK schemes (\ref zrtp_pktype_id_t) served by the key pairs pool */
+	uint8_t					pk_pool_schemes[ZRTP_MAX_COMP_COUNT+1];
 } zrtp_config_t;
 
 /**
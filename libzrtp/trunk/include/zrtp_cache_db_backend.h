@@ -15,6 +15,23 @@ extern "C"
 #define IDENTIFIER_LEN      12
 #define RS_LENGTH           32
 
+/**
+ * Group commit of cache updates.
+ *
+ * Backends that support it collect cache updates in one open transaction and
+ * commit it once @c DB_CACHE_COMMIT_BATCH updates are pending or the oldest
+ * pending update is @c DB_CACHE_COMMIT_DELAY_MS milliseconds old, whichever
+ * comes first. Closing the cache always commits. Reads on the same handle see
+ * pending updates. Set the delay to 0 to commit every update on its own.
+ */
+#ifndef DB_CACHE_COMMIT_DELAY_MS
+#define DB_CACHE_COMMIT_DELAY_MS    50
+#endif
+
+#ifndef DB_CACHE_COMMIT_BATCH
+#define DB_CACHE_COMMIT_BATCH       64
+#endif
+
 /**
  * Internal structure that holds the non-key data of a remote ZID record.
  *
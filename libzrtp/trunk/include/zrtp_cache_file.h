@@ -30,6 +30,15 @@ extern "C"
 #define ZRTP_DEF_CACHE_VERSION_STR	"libZRTP cache version="
 #define ZRTP_DEF_CACHE_VERSION_VAL	"1.0"
 
+/*
+ * File cache format version. 2.0 is an append-only log of checksummed entry records, 1.0 is the
+ * legacy fixed-layout file which is still accepted on load and converted on the first flush.
+ * Kept apart from ZRTP_DEF_CACHE_VERSION_* which are redefined by zrtp_cache_db.h.
+ */
+#define ZRTP_CACHE_FILE_VERSION_STR	"libZRTP cache version="
+#define ZRTP_CACHE_FILE_VERSION_VAL	"2.0"
+#define ZRTP_CACHE_FILE_LEGACY_VAL	"1.0"
+
 #define ZRTP_CACHE_FILE_DEF_PATH	"./zrtp_def_cache_path.dat"
 
 #define ZRTP_CACHE_STRLEN			256
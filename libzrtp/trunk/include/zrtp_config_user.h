@@ -110,6 +110,27 @@
 #define ZRTP_USE_BUILTIN_SCEHDULER	1
 #endif
 
+/**
+ * \brief Number of worker threads used by the built-in scheduler
+ *
+ * When 0, retry callbacks run directly on the scheduler thread. Otherwise expired tasks are
+ * handed to a pool of ZRTP_SCHED_WORKERS threads, so a slow callback (DH computation, for example)
+ * doesn't delay retries of other streams.
+ */
+#ifndef ZRTP_SCHED_WORKERS
+#define ZRTP_SCHED_WORKERS			0
+#endif
+
+/**
+ * \brief Default number of pre-computed key pairs per PK scheme, see zrtp_config_t#pk_pool_size
+ *
+ * Every pair costs one DH or ECDH exponentiation on a background thread at start-up and after
+ * each handshake which used one.
+ */
+#ifndef ZRTP_PK_POOL_SIZE
+#define ZRTP_PK_POOL_SIZE			2
+#endif
+
 #ifndef ZRTP_USE_BUILTIN_CACHE
 #	if defined(_WIN32) || defined(__WIN32__) || defined(_WIN64) || defined(WIN32) || defined(__TOS_WIN__)
 #		if defined(__BUILDMACHINE__) && (__BUILDMACHINE__ == WinDDK)
@@ -647,6 +647,40 @@ char* zrtp_comp_id2type(zrtp_crypto_comp_t type, uint8_t id);
 uint8_t zrtp_comp_type2id(zrtp_crypto_comp_t type, char* name);
 
 
+/*============================================================================*/
+/* 	  DH/ECDH key pairs pool												  */
+/*============================================================================*/
+
+/*!
+ * \brief Start the key pairs pool
+ * Starts a background thread which keeps \c size ready (sv, pv) pairs for every PK scheme from
+ * the zero-terminated list \c schemes. Does nothing if \c size is 0 or libzrtp can't create
+ * threads on this platform. Called by zrtp_init() after the PK schemes have been registered.
+ */
+zrtp_status_t zrtp_pk_pool_init(zrtp_global_t* zrtp, uint32_t size, const uint8_t* schemes);
+
+/*! \brief Stop the generator and wipe all ready key pairs. Called by zrtp_down(). */
+void zrtp_pk_pool_down(zrtp_global_t* zrtp);
+
+/*!
+ * \brief Initialize DH crypto context with a key pair
+ * Moves a ready key pair of scheme \c self from the pool into \c dh_cc and lets the generator
+ * compute a replacement. Falls back to zrtp_pk_scheme_t#initialize() if the pool is empty or
+ * doesn't serve the scheme.
+ */
+zrtp_status_t zrtp_pk_pool_take(zrtp_pk_scheme_t *self, zrtp_dh_crypto_context_t *dh_cc);
+
+/*!
+ * \brief Get pool counters of PK scheme \c id
+ * \param hits - number of streams which got a ready key pair;
+ * \param misses - number of streams which had to compute the key pair on the handshake path.
+ * \return
+ *	- zrtp_status_ok - if the pool serves the scheme;
+ *	- zrtp_status_fail - otherwise.
+ */
+zrtp_status_t zrtp_pk_pool_get_stats(zrtp_global_t* zrtp, uint8_t id, uint32_t* hits, uint32_t* misses);
+
+
 /*! \} */
 
 #if defined(__cplusplus)
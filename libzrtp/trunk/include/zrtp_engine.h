@@ -377,6 +377,9 @@ void _zrtp_packet_insert_crc(char* packet, uint32_t length);
  *	- -1 if CRC validation failed.
  */
 int8_t _zrtp_packet_validate_crc(const char* packet, uint32_t length);
+
+/** @brief Computes CRC32c (RFC 3309) of the buffer, used for ZRTP packets and cache records. */
+uint32_t zrtp_generate_crc(const uint8_t* buff, uint32_t length);
 		
 /*  \} */
 
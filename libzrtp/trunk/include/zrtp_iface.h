@@ -100,6 +100,16 @@ struct zrtp_retry_task_t
 	 * when there are no callbacks in progress - no tasks with \c _is_busy enabled.
 	 */
 	uint8_t					_is_busy;
+	
+	/**
+	 * \brief Scheduler node bound to the task.
+	 *
+	 * Built-in scheduler keeps a pointer to the timer entry of the pending call here, so cancel
+	 * and re-arm are O(1). NULL when the task isn't scheduled.
+	 * \note
+	 * For internal use only. Don't' modify this field in implementation.
+	 */
+	void*					_sched;
 };
 
 /**
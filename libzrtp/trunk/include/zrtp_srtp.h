@@ -43,16 +43,18 @@ struct zrtp_srtp_ctx_t
 {
    zrtp_srtp_stream_ctx_t *outgoing_srtp; /*!< pointer to outgoing SRTP stream context */
    zrtp_srtp_stream_ctx_t *incoming_srtp; /*!< pointer to incoming SRTP stream context */
+   zrtp_rp_ctx_t *rp_ctx; /*!< replay protection data of the session streams */
 };
 
 /*!
  * \brief Global context of an internal SRTP implementation.
  * It is created by calling zrtp_srtp_init() and destroyed by calling zrtp_srtp_down().
- * This context is used for holding replay protection mechanism data.
+ * Replay protection data is kept per session in zrtp_srtp_ctx_t, the global context only holds
+ * its parameters.
  */
 typedef struct
 {   
-   zrtp_rp_ctx_t *rp_ctx; /*!< pointer to replay protection context. */
+   uint32_t rp_table_size; /*!< initial size of session replay protection tables */
 } zrtp_srtp_global_t;
 
 #else
@@ -114,34 +114,50 @@ typedef enum
 typedef zrtp_srtp_cipher_t zrtp_dk_ctx;
 
 
+/*!
+ * \brief Initial number of slots in the replay protection table.
+ * A session usually carries a single SSRC in each direction, the table grows by doubling when it
+ * gets half full. Must be a power of two.
+ */
+#define ZRTP_SRTP_RP_TABLE_SIZE 4
+
 /*!
  * \brief Structure describing a protection node.
  * Each node keeps data for protecting RTP and RTCP packets against replays
  * within streams with a given SSRC. There are two replay protection nodes for
- * each SSRC value in the two lists. One is used for incoming packets and
+ * each SSRC value in the two tables. One is used for incoming packets and
  * the other for outgoing packets. 
 */
 typedef struct
 {    
     zrtp_srtp_rp_t rtp_rp;    /*!< RTP replay protection data */
     zrtp_srtp_rp_t rtcp_rp;    /*!< RTCP replay protection data */    
-    uint32_t ssrc;            /*!< RTP media SSRC for nodes searching in the linked list */    
-	zrtp_srtp_ctx_t *srtp_ctx; /*!< SRTP context related with current node*/
-    mlist_t mlist;
+    uint32_t ssrc;            /*!< RTP media SSRC, key of the node in the table */    
 } zrtp_rp_node_t;
 
 
+/*!
+ * \brief Open addressing hash table of replay protection nodes keyed by SSRC.
+ * Slots hold pointers so nodes never move when the table grows and callers may keep them.
+ */
+typedef struct
+{
+    zrtp_rp_node_t  **slots;    /*!< table slots, NULL for an empty one */
+    uint32_t        size;       /*!< number of slots, power of two */
+    uint32_t        count;      /*!< number of nodes in the table */
+    zrtp_rp_node_t  *last;      /*!< node found by the latest lookup */
+} zrtp_rp_table_t;
+
+
 /*!
 * \brief Structure describing replay protection context.
-* This structure holds two linked list's heads and two mutexes for
-* synchronization access to appropriate lists.
+* Every SRTP session owns one context with a table for each direction. A direction is processed
+* by one media thread at a time, so the tables are accessed without locking.
 */
 typedef struct
 {    
-    zrtp_rp_node_t  inc_head;    /*!< head of replay protection nodes list for incoming packets */
-    zrtp_mutex_t*   inc_sync;    /*!< mutex for incoming list access synchronization */
-    zrtp_rp_node_t  out_head;    /*!< head of replay protection nodes list for outgoing packets */    
-    zrtp_mutex_t*   out_sync;    /*!< mutex for outgoing list access synchronization */
+    zrtp_rp_table_t inc;    /*!< replay protection nodes for incoming packets */
+    zrtp_rp_table_t out;    /*!< replay protection nodes for outgoing packets */
 } zrtp_rp_ctx_t;
 
 /* \} */
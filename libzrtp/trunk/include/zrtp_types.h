@@ -333,6 +333,7 @@ struct zrtp_global_t
     mlist_t					pktype_head;		/** Head of public key exchange schemes list */
     mlist_t					sas_head;			/** SAS schemes list */
     void*					srtp_global;		/** Storage for some SRTP global data */
+    void*					pk_pool;			/** Pre-computed DH/ECDH key pairs, see zrtp_pk_pool_take() */
     mlist_t					sessions_head;		/** Head of ZRTP sessions list */
 	uint32_t				sessions_count;		/** Global sessions count used to create ZRTP session IDs. For debug purposes mostly. */
 	uint32_t				streams_count;		/** Global streams count used to create ZRTP session IDs. For debug purposes mostly. */
@@ -54,6 +54,12 @@ void zrtp_config_defaults(zrtp_config_t* config)
     config->cb.sched_cb.on_cancel_call_later    = zrtp_def_scheduler_cancel_call_later;
     config->cb.sched_cb.on_wait_call_later      = zrtp_def_scheduler_wait_call_later;
 #endif
+
+    /* Keep key pairs for the PK schemes of the default profile */
+    config->pk_pool_size = ZRTP_PK_POOL_SIZE;
+    config->pk_pool_schemes[0] = ZRTP_PKTYPE_EC256P;
+    config->pk_pool_schemes[1] = ZRTP_PKTYPE_DH3072;
+    config->pk_pool_schemes[2] = ZRTP_PKTYPE_DH2048;
 }
 
 zrtp_status_t zrtp_init(zrtp_config_t* config, zrtp_global_t** zrtp)
@@ -162,6 +168,14 @@ zrtp_status_t zrtp_init(zrtp_config_t* config, zrtp_global_t** zrtp)
     zrtp_defaults_aes_cipher(new_zrtp);
     zrtp_defaults_hash(new_zrtp);
 
+    s = zrtp_pk_pool_init(new_zrtp, config->pk_pool_size, config->pk_pool_schemes);
+    if (zrtp_status_ok != s) {
+        ZRTP_LOG(1, (_ZTU_,"ERROR! zrtp_pk_pool_init() failed:<%s>\n", zrtp_log_status2str(s)));
+        /* Everything else is up by now, and a failed init leaves no pool behind */
+        zrtp_down(new_zrtp);
+        return s;
+    }
+
     *zrtp = new_zrtp;
     
     ZRTP_LOG(3, (_ZTU_,"INITIALIZING LIBZRTP - DONE\n"));
@@ -178,6 +192,9 @@ zrtp_status_t zrtp_down(zrtp_global_t* zrtp)
         return zrtp_status_bad_param;
     }
 
+    /* The generator uses PK schemes and the RNG, stop it first */
+    zrtp_pk_pool_down(zrtp);
+
     zrtp_comp_done(ZRTP_CC_HASH, zrtp);
     zrtp_comp_done(ZRTP_CC_SAS, zrtp);
     zrtp_comp_done(ZRTP_CC_CIPHER, zrtp);
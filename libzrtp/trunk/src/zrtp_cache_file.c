@@ -16,22 +16,28 @@
 #include <stdio.h>	/* for file operations*/
 #include <string.h> /* for strlen() and other string operations*/
 
+#if (ZRTP_PLATFORM == ZP_LINUX) || (ZRTP_PLATFORM == ZP_DARWIN) || (ZRTP_PLATFORM == ZP_BSD) || (ZRTP_PLATFORM == ZP_ANDROID)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#define ZRTP_CACHE_USE_MMAP			1
+#else
+#define ZRTP_CACHE_USE_MMAP			0
+#endif
 
-#define _ZTU_ "zrtp cache"
+/* Log compaction runs on a separate thread where libzrtp knows how to create one */
+#if (defined(ZRTP_USE_BUILTIN_SCEHDULER) && (ZRTP_USE_BUILTIN_SCEHDULER == 1)) && \
+	(ZRTP_PLATFORM != ZP_SYMBIAN) && (ZRTP_PLATFORM != ZP_WIN32_KERNEL)
+#define ZRTP_CACHE_BG_COMPACTION	1
+#else
+#define ZRTP_CACHE_BG_COMPACTION	0
+#endif
 
-/**  ZRTP file-based cache */
-struct zrtp_cache_file_t {
-	zrtp_cache_t	super_;						/**! ZRTP cache super class. @warning must be the first field. */
-	zrtp_string16_t	local_zid;					/**! local ZID */
-	zrtp_cache_file_config_t	config;			/**! copy of initialization config */
-	zrtp_global_t	*zrtp;						/**! zrtp context */
-	mlist_t 		cache_head;					/**! head of mian cache list */
-	uint32_t		cache_elems_counter;		/**! global counter of zrtp cache entries create by this cache  */
-	mlist_t 		mitmcache_head;				/**! PBX cache entries list */
-	uint32_t		mitmcache_elems_counter;	/**! global counter of MiTM cache entries create by this cache  */
-	uint8_t 		needs_rewriting;
-	zrtp_mutex_t 	*cache_protector;			/**! mutex to protect operations with cache elemnts list */
-};
+
+#define _ZTU_ "zrtp cache"
 
 /**
  * @brief Cache element identifier type
@@ -63,10 +69,72 @@ typedef struct
 	mlist_t            	_mlist;
 } zrtp_cache_entry_t;
 
+/**
+ * @brief Cache entries index
+ * Open addressing hash table keyed by the entry ID, plus the list of entries modified since the
+ * last flush. Entries are never removed from the cache, so the table needs no tombstones.
+ */
+typedef struct
+{
+	zrtp_cache_entry_t	**slots;		/** hash table, size is a power of two */
+	uint32_t			size;			/** number of slots */
+	uint32_t			count;			/** number of entries */
+	zrtp_cache_entry_t	**dirty;		/** entries to be appended on the next flush, room for size entries */
+	uint32_t			dirty_count;
+} zrtp_cache_index_t;
+
+/**  ZRTP file-based cache */
+struct zrtp_cache_file_t {
+	zrtp_cache_t	super_;						/**! ZRTP cache super class. @warning must be the first field. */
+	zrtp_string16_t	local_zid;					/**! local ZID */
+	zrtp_cache_file_config_t	config;			/**! copy of initialization config */
+	zrtp_global_t	*zrtp;						/**! zrtp context */
+	mlist_t 		cache_head;					/**! head of mian cache list */
+	uint32_t		cache_elems_counter;		/**! global counter of zrtp cache entries create by this cache  */
+	mlist_t 		mitmcache_head;				/**! PBX cache entries list */
+	uint32_t		mitmcache_elems_counter;	/**! global counter of MiTM cache entries create by this cache  */
+	zrtp_cache_index_t	cache_index;			/**! index of regular cache entries */
+	zrtp_cache_index_t	mitmcache_index;		/**! index of MiTM cache entries */
+	uint8_t 		needs_rewriting;			/**! the log can't be appended to and must be rewritten */
+	FILE			*log;						/**! cache log opened for appending, NULL until the first flush */
+	uint32_t		log_size;					/**! length of the valid part of the log */
+	uint8_t			is_compacting;				/**! background compaction is in progress */
+	uint8_t			is_closing;					/**! the cache is being destroyed, don't start compaction */
+	uint8_t			*compact_buff;				/**! snapshot of all entries to be written by the compaction */
+	uint32_t		compact_length;
+	uint32_t		compact_mark;				/**! log size when the snapshot was taken */
+#if ZRTP_CACHE_BG_COMPACTION
+	zrtp_sem_t		*compact_done;				/**! posted by every compaction thread when it's done */
+	uint32_t		compact_threads;			/**! compaction threads which haven't been waited for */
+#endif
+	zrtp_mutex_t 	*cache_protector;			/**! mutex to protect operations with cache elemnts list */
+};
+
 
 #define ZRTP_MITMCACHE_ELEM_LENGTH ( sizeof(zrtp_cache_entry_id_t) + sizeof(zrtp_string64_t) )
 #define ZRTP_CACHE_ELEM_LENGTH ( sizeof(zrtp_cache_entry_t) - sizeof(mlist_t) - (sizeof(uint32_t)*2) )
 
+/*
+ * Log record: <type><payload length><payload><CRC32c of all previous fields>, integers in
+ * network byte-order. Payload is an entry in the same layout as in the legacy cache file.
+ */
+#define ZRTP_CACHE_REC_RS			0x52530000	/* "RS" */
+#define ZRTP_CACHE_REC_MITM			0x4D490000	/* "MI" */
+#define ZRTP_CACHE_REC_HDR_LENGTH	8
+#define ZRTP_CACHE_REC_LENGTH(len)	(ZRTP_CACHE_REC_HDR_LENGTH + (len) + 4)
+
+#define ZRTP_CACHE_HDR_LENGTH		(strlen(ZRTP_CACHE_FILE_VERSION_STR)+strlen(ZRTP_CACHE_FILE_VERSION_VAL))
+
+/** The log is compacted when it grows ZRTP_CACHE_COMPACT_RATIO times over the live data... */
+#define ZRTP_CACHE_COMPACT_RATIO	2
+/** ...and there are at least ZRTP_CACHE_COMPACT_MIN bytes to reclaim */
+#define ZRTP_CACHE_COMPACT_MIN		(64*1024)
+
+#define ZRTP_CACHE_INDEX_MIN_SIZE	64
+
+/** Limit of the compaction semaphore: compactions don't overlap and finished threads are reaped */
+#define ZRTP_CACHE_COMPACT_MAX_THREADS	16
+
 
 #define ZRTP_CACHE_CHECK_ZID(zid) \
 	if (zid->length != sizeof(zrtp_zid_t)) \
@@ -82,6 +150,14 @@ static void zrtp_cache_create_id(const zrtp_stringn_t* first_ZID,
 /** Searching for cache element by cache ID */
 static zrtp_cache_entry_t* get_elem(zrtp_cache_file_t *cache_file, const zrtp_cache_entry_id_t id, uint8_t is_mitm);
 
+/** Adds a new element to the cache lists and index */
+static zrtp_status_t add_elem(zrtp_cache_file_t *cache_file, zrtp_cache_entry_t* elem, uint8_t is_mitm);
+
+static void index_free(zrtp_cache_index_t* index);
+
+/** Queues modified element for the next flush */
+static void mark_dirty(zrtp_cache_file_t *cache_file, zrtp_cache_entry_t* elem, uint8_t is_mitm);
+
 static void zrtp_cache_entry_make_cross(zrtp_cache_entry_t* from, zrtp_cache_entry_t* to, uint8_t is_upload);
 
 /** Opens zrtp cache file and upload all entries  */
@@ -129,13 +205,11 @@ static zrtp_status_t cache_put(zrtp_cache_file_t *cache_file,
 
 			new_elem->secure_since = (uint32_t)(zrtp_time_now()/1000);
 
-			mlist_add_tail(is_mitm ? &cache_file->mitmcache_head : &cache_file->cache_head, &new_elem->_mlist);
 			zrtp_memcpy(new_elem->id, id, sizeof(zrtp_cache_entry_id_t));
-
-			if (is_mitm) {
-				new_elem->_index = cache_file->mitmcache_elems_counter++;
-			} else {
-				new_elem->_index = cache_file->cache_elems_counter++;
+			if (zrtp_status_ok != add_elem(cache_file, new_elem, is_mitm)) {
+				zrtp_sys_free(new_elem);
+				new_elem = NULL;
+				break;
 			}
 
 			ZRTP_LOG(3,(_ZTU_,"\tcache_put() can't find element in the cache - create a new entry index=%u.\n", new_elem->_index));
@@ -157,10 +231,7 @@ static zrtp_status_t cache_put(zrtp_cache_file_t *cache_file,
 			new_elem->ttl		= rss->ttl;
 		}
 
-		new_elem->_is_dirty = 1;
-		if (is_mitm) {
-			cache_file->needs_rewriting = 1;
-		}
+		mark_dirty(cache_file, new_elem, is_mitm);
 	} while (0);
 
 	if (cache_file->config.cache_auto_store) zrtp_cache_store_to_file(cache_file);
@@ -261,7 +332,7 @@ static zrtp_status_t zrtp_file_cache_set_verified(zrtp_cache_t *cache,
 	if (new_elem) {
 		new_elem->verified = verified;
 
-		new_elem->_is_dirty = 1;
+		mark_dirty(cache_file, new_elem, 0);
 		if (cache_file->config.cache_auto_store) zrtp_cache_store_to_file(cache_file);
 	}
 
@@ -330,7 +401,7 @@ static zrtp_status_t zrtp_file_cache_reset_since(zrtp_cache_t *cache,
 	new_elem = get_elem(cache_file, id, 0);
 	if (new_elem) {
 		new_elem->secure_since = (uint32_t)(zrtp_time_now()/1000);
-		new_elem->_is_dirty = 1;
+		mark_dirty(cache_file, new_elem, 0);
 	}
 
 	if (cache_file->config.cache_auto_store) zrtp_cache_store_to_file(cache_file);
@@ -386,7 +457,7 @@ static zrtp_status_t zrtp_file_cache_put_name(zrtp_cache_t *cache,
 		zrtp_memset(new_elem->name, 0, sizeof(new_elem->name));
 		zrtp_memcpy(new_elem->name, name->buffer, new_elem->name_length);
 
-		new_elem->_is_dirty = 1;
+		mark_dirty(cache_file, new_elem, 0);
 	} while (0);
 
 	if (cache_file->config.cache_auto_store) zrtp_cache_store_to_file(cache_file);
@@ -407,7 +478,7 @@ static zrtp_status_t zrtp_file_cache_set_presh_counter(zrtp_cache_t *cache,
 	if (new_elem) {
 		new_elem->presh_counter = counter;
 
-		new_elem->_is_dirty = 1;
+		mark_dirty(cache_file, new_elem, 0);
 	}
 
 	if (cache_file->config.cache_auto_store) zrtp_cache_store_to_file(cache_file);
@@ -476,6 +547,13 @@ zrtp_status_t zrtp_cache_file_create(zrtp_stringn_t *local_zid,
 		init_mlist(&new_cache->cache_head);
 		init_mlist(&new_cache->mitmcache_head);
 
+#if ZRTP_CACHE_BG_COMPACTION
+		s = zrtp_sem_init(&new_cache->compact_done, 0, ZRTP_CACHE_COMPACT_MAX_THREADS);
+		if (zrtp_status_ok != s) {
+			break;
+		}
+#endif
+
 		/* let's upload cache entries form the file */
 		s = zrtp_cache_read_from_file(new_cache);
 		if (zrtp_status_ok != s) {
@@ -487,8 +565,23 @@ zrtp_status_t zrtp_cache_file_create(zrtp_stringn_t *local_zid,
 
 	if (zrtp_status_ok != s) {
 		if (new_cache) {
+			mlist_t *node = NULL, *tmp = NULL;
+
+			mlist_for_each_safe(node, tmp, &new_cache->cache_head) {
+				zrtp_sys_free(mlist_get_struct(zrtp_cache_entry_t, _mlist, node));
+			}
+			mlist_for_each_safe(node, tmp, &new_cache->mitmcache_head) {
+				zrtp_sys_free(mlist_get_struct(zrtp_cache_entry_t, _mlist, node));
+			}
+			index_free(&new_cache->cache_index);
+			index_free(&new_cache->mitmcache_index);
+
 			if (new_cache->cache_protector)
 				zrtp_mutex_destroy(new_cache->cache_protector);
+#if ZRTP_CACHE_BG_COMPACTION
+			if (new_cache->compact_done)
+				zrtp_sem_destroy(new_cache->compact_done);
+#endif
 
 			zrtp_sys_free(new_cache);
 		}
@@ -505,11 +598,27 @@ zrtp_status_t zrtp_cache_file_destroy(zrtp_cache_file_t *cache) {
 	if (!cache)
 		return zrtp_status_bad_param;
 
+	/* Let compaction threads replace the log and quit first */
+	zrtp_mutex_lock(cache->cache_protector);
+	cache->is_closing = 1;
+	zrtp_mutex_unlock(cache->cache_protector);
+#if ZRTP_CACHE_BG_COMPACTION
+	while (cache->compact_threads > 0) {
+		zrtp_sem_wait(cache->compact_done);
+		cache->compact_threads--;
+	}
+#endif
+
 	zrtp_mutex_lock(cache->cache_protector);
 
-	/* If automatic cache flushing enabled we don't need to store it in a disk as it should be already in sync. */
-	if (!cache->config.cache_auto_store) {
-		zrtp_cache_store_to_file(cache);
+	/*
+	 * With automatic cache flushing enabled the cache should be already in sync, this only stores
+	 * changes a failed flush left behind.
+	 */
+	zrtp_cache_store_to_file(cache);
+	if (cache->log) {
+		fclose(cache->log);
+		cache->log = NULL;
 	}
 
 	mlist_for_each_safe(node, tmp, &cache->cache_head) {
@@ -519,9 +628,15 @@ zrtp_status_t zrtp_cache_file_destroy(zrtp_cache_file_t *cache) {
 		zrtp_sys_free(mlist_get_struct(zrtp_cache_entry_t, _mlist, node));
 	}
 
+	index_free(&cache->cache_index);
+	index_free(&cache->mitmcache_index);
+
 	zrtp_mutex_unlock(cache->cache_protector);
 
 	zrtp_mutex_destroy(cache->cache_protector);
+#if ZRTP_CACHE_BG_COMPACTION
+	zrtp_sem_destroy(cache->compact_done);
+#endif
 
 	zrtp_sys_free(cache);
 
@@ -530,339 +645,560 @@ zrtp_status_t zrtp_cache_file_destroy(zrtp_cache_file_t *cache) {
 
 /******************************************************************************
  * File storage operations
+ *
+ * The cache file is a version header followed by a log of entry records. Every flush appends
+ * records of the modified entries only; the last record of an entry wins on load. When the log
+ * grows too much over the live data, it's compacted: a snapshot of all entries is written to a
+ * temporary file, records appended meanwhile are copied after it and the file replaces the log.
  */
 
-#define ZRTP_INT_CACHE_BREAK(s, status) \
-{ \
-	if (!s) s = status; \
-	break; \
+static FILE* cache_fopen(const char* path, const char* mode)
+{
+	FILE* f = NULL;
+#if (ZRTP_PLATFORM == ZP_WIN32)
+	if (0 != fopen_s(&f, path, mode)) {
+		f = NULL;
+	}
+#else
+	f = fopen(path, mode);
+#endif
+	return f;
 }
 
-static zrtp_status_t zrtp_cache_read_from_file(zrtp_cache_file_t *cache)
+static uint32_t cache_put_header(uint8_t* buff)
 {
-	FILE* 	cache_file = 0;
-	zrtp_cache_entry_t* new_elem = 0;
-	zrtp_status_t s = zrtp_status_ok;
-	uint32_t cache_elems_count = 0;
-	uint32_t mitmcache_elems_count = 0;
-	uint32_t i = 0;
-	unsigned is_unsupported = 0;
+	zrtp_memcpy(buff, ZRTP_CACHE_FILE_VERSION_STR, strlen(ZRTP_CACHE_FILE_VERSION_STR));
+	zrtp_memcpy(buff+strlen(ZRTP_CACHE_FILE_VERSION_STR), ZRTP_CACHE_FILE_VERSION_VAL, strlen(ZRTP_CACHE_FILE_VERSION_VAL));
+	return (uint32_t)ZRTP_CACHE_HDR_LENGTH;
+}
 
-	ZRTP_LOG(3,(_ZTU_,"\tLoad ZRTP cache from <%s>...\n", cache->config.cache_path));
+static uint32_t cache_put_record(uint8_t* buff, zrtp_cache_entry_t* elem, unsigned is_mitm)
+{
+	zrtp_cache_entry_t tmp_elem;
+	uint32_t length = is_mitm ? ZRTP_MITMCACHE_ELEM_LENGTH : ZRTP_CACHE_ELEM_LENGTH;
+	uint32_t field;
 
-	cache->cache_elems_counter = 0;
-	cache->mitmcache_elems_counter = 0;
-	cache->needs_rewriting = 0;
+	/* Prepare element for storing, convert all fields to the network byte-order. */
+	zrtp_cache_entry_make_cross(elem, &tmp_elem, 0);
 
-    /* Try to open existing file. If there is no cache file - start with empty cache */
-#if (ZRTP_PLATFORM == ZP_WIN32)
-    if (0 != fopen_s(&cache_file, cache->config.cache_path, "rb")) {
-		return zrtp_status_ok;
-    }
-#else
-    if (0 == (cache_file = fopen(cache->config.cache_path , "rb"))) {
-		ZRTP_LOG(3,(_ZTU_,"\tCan't open file for reading.\n"));
-		return zrtp_status_ok;
-	}
-#endif
-	/*
-	 * Check for the cache file version number. Current version of libzrtp doesn't support
-	 * backward compatibility in zrtp cache file structure, so we just remove the old cache file.
-	 *
-	 * Version field format: $ZRTP_DEF_CACHE_VERSION_STR$ZRTP_DEF_CACHE_VERSION_VAL
-	 */
-	do {
-		char version_buff[256];
-		zrtp_memset(version_buff, 0, sizeof(version_buff));
+	field = zrtp_hton32(is_mitm ? ZRTP_CACHE_REC_MITM : ZRTP_CACHE_REC_RS);
+	zrtp_memcpy(buff, &field, 4);
+	field = zrtp_hton32(length);
+	zrtp_memcpy(buff+4, &field, 4);
+	zrtp_memcpy(buff+ZRTP_CACHE_REC_HDR_LENGTH, &tmp_elem, length);
+	field = zrtp_hton32(zrtp_generate_crc(buff, ZRTP_CACHE_REC_HDR_LENGTH+length));
+	zrtp_memcpy(buff+ZRTP_CACHE_REC_HDR_LENGTH+length, &field, 4);
 
-		if (fread(version_buff, strlen(ZRTP_DEF_CACHE_VERSION_STR)+strlen(ZRTP_DEF_CACHE_VERSION_VAL), 1, cache_file) <= 0) {
-			ZRTP_LOG(2,(_ZTU_,"\tCache Error: Can't get ZRTP cache version string: file is too small.\n"));
-			is_unsupported = 1;
-			break;
-		}
+	return ZRTP_CACHE_REC_LENGTH(length);
+}
 
-		if (0 != zrtp_memcmp(version_buff, ZRTP_DEF_CACHE_VERSION_STR, strlen(ZRTP_DEF_CACHE_VERSION_STR))) {
-			ZRTP_LOG(2,(_ZTU_,"\tCache Error: malformed cache file: can't find ZRTP Version tag.\n"));
-			is_unsupported = 1;
-			break;
+/** Creates or updates an entry from its stored image */
+static zrtp_status_t cache_load_elem(zrtp_cache_file_t *cache, const uint8_t* data, uint32_t length, unsigned is_mitm)
+{
+	zrtp_cache_entry_t tmp_elem;
+	zrtp_cache_entry_t* elem = NULL;
+
+	zrtp_memset(&tmp_elem, 0, sizeof(tmp_elem));
+	zrtp_memcpy(&tmp_elem, data, length);
+	zrtp_cache_entry_make_cross(NULL, &tmp_elem, 1);
+
+	elem = get_elem(cache, tmp_elem.id, is_mitm);
+	if (!elem) {
+		elem = (zrtp_cache_entry_t*) zrtp_sys_alloc(sizeof(zrtp_cache_entry_t));
+		if (!elem) {
+			return zrtp_status_alloc_fail;
 		}
+		zrtp_memset(elem, 0, sizeof(zrtp_cache_entry_t));
+		zrtp_memcpy(elem->id, tmp_elem.id, sizeof(zrtp_cache_entry_id_t));
+		if (zrtp_status_ok != add_elem(cache, elem, is_mitm)) {
+			zrtp_sys_free(elem);
+			return zrtp_status_alloc_fail;
+		}
+	}
 
-		ZRTP_LOG(3,(_ZTU_,"\tZRTP cache file has version=%s\n", version_buff+strlen(ZRTP_DEF_CACHE_VERSION_STR)));
+	/* Stored image covers the leading fields only, keep the service ones */
+	zrtp_memcpy(elem, &tmp_elem, length);
+	return zrtp_status_ok;
+}
 
-		if (0 != zrtp_memcmp(version_buff+strlen(ZRTP_DEF_CACHE_VERSION_STR), ZRTP_DEF_CACHE_VERSION_VAL, strlen(ZRTP_DEF_CACHE_VERSION_VAL))) {
-			ZRTP_LOG(2,(_ZTU_,"\tCache Error: Unsupported ZRTP cache version.\n"));
-			is_unsupported = 1;
-			break;
+/** Uploads version 1.0 cache: MiTM secrets count and secrets, then regular ones */
+static zrtp_status_t cache_load_legacy(zrtp_cache_file_t *cache, const uint8_t* buff, uint32_t size)
+{
+	uint32_t pos = strlen(ZRTP_CACHE_FILE_VERSION_STR)+strlen(ZRTP_CACHE_FILE_LEGACY_VAL);
+	uint32_t count = 0, i = 0;
+	unsigned is_mitm = 1;
+	zrtp_status_t s = zrtp_status_ok;
+
+	for (is_mitm=1; ; is_mitm=0) {
+		uint32_t length = is_mitm ? ZRTP_MITMCACHE_ELEM_LENGTH : ZRTP_CACHE_ELEM_LENGTH;
+
+		if (pos + 4 > size) {
+			return zrtp_status_read_fail;
+		}
+		zrtp_memcpy(&count, buff+pos, 4);
+		count = zrtp_ntoh32(count);
+		pos += 4;
+
+		for (i=0; i<count; i++, pos+=length) {
+			if (pos + length > size) {
+				ZRTP_LOG(3,(_ZTU_,"\tERROR! %s cache element read fail (id=%u).\n", is_mitm ? "MiTM" : "RS", i));
+				return zrtp_status_read_fail;
+			}
+			if (zrtp_status_ok != (s = cache_load_elem(cache, buff+pos, length, is_mitm))) {
+				return s;
+			}
 		}
-	} while (0);
 
-	if (is_unsupported) {
-		ZRTP_LOG(2,(_ZTU_,"\tCache Error: Unsupported version of ZRTP cache file detected - white-out the cache.\n"));
-		fclose(cache_file);
-		return zrtp_status_ok;
+		if (!is_mitm) {
+			break;
+		}
 	}
 
-	/*
-	 *  Load MitM caches: first 32 bits is a MiTM secrets counter. Read it and then
-	 *  upload appropriate number of MitM secrets.
-	 */
-	do {
-		cache_elems_count = 0;
-		if (fread(&mitmcache_elems_count, 4, 1, cache_file) <= 0) {
-			ZRTP_INT_CACHE_BREAK(s, zrtp_status_read_fail);
-		}
-		mitmcache_elems_count = zrtp_ntoh32(mitmcache_elems_count);
+	/* Convert to the log format on the first flush */
+	cache->needs_rewriting = 1;
+	return zrtp_status_ok;
+}
 
-		for (i=0; i<mitmcache_elems_count; i++)
-		{
-			new_elem = (zrtp_cache_entry_t*) zrtp_sys_alloc(sizeof(zrtp_cache_entry_t));
-			if (!new_elem) {
-				ZRTP_INT_CACHE_BREAK(s, zrtp_status_alloc_fail);
-			}
+static zrtp_status_t cache_load_log(zrtp_cache_file_t *cache, const uint8_t* buff, uint32_t size)
+{
+	uint32_t pos = (uint32_t)ZRTP_CACHE_HDR_LENGTH;
+	zrtp_status_t s = zrtp_status_ok;
 
-			if (fread(new_elem, ZRTP_MITMCACHE_ELEM_LENGTH, 1, cache_file) <= 0) {
-				ZRTP_LOG(3,(_ZTU_,"\tERROR! MiTM cache element read fail (id=%u).\n", i));
+	while (pos + ZRTP_CACHE_REC_HDR_LENGTH <= size) {
+		uint32_t type, length, crc;
+		unsigned is_mitm;
 
-				zrtp_sys_free(new_elem);
-				ZRTP_INT_CACHE_BREAK(s, zrtp_status_read_fail);
-			}
+		zrtp_memcpy(&type, buff+pos, 4);
+		zrtp_memcpy(&length, buff+pos+4, 4);
+		type	= zrtp_ntoh32(type);
+		length	= zrtp_ntoh32(length);
 
-			zrtp_cache_entry_make_cross(NULL, new_elem, 1);
+		if (ZRTP_CACHE_REC_MITM == type) {
+			is_mitm = 1;
+		} else if (ZRTP_CACHE_REC_RS == type) {
+			is_mitm = 0;
+		} else {
+			break;
+		}
+		if ( (length != (is_mitm ? ZRTP_MITMCACHE_ELEM_LENGTH : ZRTP_CACHE_ELEM_LENGTH)) ||
+			 (pos + ZRTP_CACHE_REC_LENGTH(length) > size) ) {
+			break;
+		}
 
-			new_elem->_index =  cache->mitmcache_elems_counter++;
-			new_elem->_is_dirty = 0;
+		zrtp_memcpy(&crc, buff+pos+ZRTP_CACHE_REC_HDR_LENGTH+length, 4);
+		if (zrtp_ntoh32(crc) != zrtp_generate_crc(buff+pos, ZRTP_CACHE_REC_HDR_LENGTH+length)) {
+			break;
+		}
 
-			mlist_add_tail(&cache->mitmcache_head, &new_elem->_mlist);
+		if (zrtp_status_ok != (s = cache_load_elem(cache, buff+pos+ZRTP_CACHE_REC_HDR_LENGTH, length, is_mitm))) {
+			return s;
 		}
+		pos += ZRTP_CACHE_REC_LENGTH(length);
+	}
 
-		if (i != mitmcache_elems_count)
-			ZRTP_INT_CACHE_BREAK(s, zrtp_status_read_fail);
-	} while(0);
-	if (s != zrtp_status_ok) {
-		fclose(cache_file);
-		return s;
+	if (pos != size) {
+		/* Interrupted write or damaged file: drop the tail with the next flush */
+		ZRTP_LOG(2,(_ZTU_,"\tCache Error: %u bytes of broken records at the end of the cache file.\n", size - pos));
+		cache->needs_rewriting = 1;
 	}
+	cache->log_size = pos;
 
-	ZRTP_LOG(3,(_ZTU_,"\tAll %u MiTM Cache entries have been uploaded.\n", cache->mitmcache_elems_counter));
+	return zrtp_status_ok;
+}
+
+static zrtp_status_t cache_load(zrtp_cache_file_t *cache, const uint8_t* buff, uint32_t size)
+{
+	uint32_t str_length = strlen(ZRTP_CACHE_FILE_VERSION_STR);
 
 	/*
-	 * Load regular caches: first 32 bits is a secrets counter. Read it and then
-	 * upload appropriate number of regular secrets.
+	 * Check for the cache file version number. Unknown versions are not supported: start
+	 * with an empty cache and rewrite the file.
+	 *
+	 * Version field format: $ZRTP_CACHE_FILE_VERSION_STR$ZRTP_CACHE_FILE_VERSION_VAL
 	 */
-	cache_elems_count = 0;
-	if (fread(&cache_elems_count, 4, 1, cache_file) <= 0) {
-		fclose(cache_file);
-		return zrtp_status_read_fail;
+	if (size < ZRTP_CACHE_HDR_LENGTH) {
+		ZRTP_LOG(2,(_ZTU_,"\tCache Error: Can't get ZRTP cache version string: file is too small.\n"));
+	} else if (0 != zrtp_memcmp(buff, ZRTP_CACHE_FILE_VERSION_STR, str_length)) {
+		ZRTP_LOG(2,(_ZTU_,"\tCache Error: malformed cache file: can't find ZRTP Version tag.\n"));
+	} else if (0 == zrtp_memcmp(buff+str_length, ZRTP_CACHE_FILE_VERSION_VAL, strlen(ZRTP_CACHE_FILE_VERSION_VAL))) {
+		return cache_load_log(cache, buff, size);
+	} else if (0 == zrtp_memcmp(buff+str_length, ZRTP_CACHE_FILE_LEGACY_VAL, strlen(ZRTP_CACHE_FILE_LEGACY_VAL))) {
+		ZRTP_LOG(3,(_ZTU_,"\tZRTP cache file has legacy version=%s\n", ZRTP_CACHE_FILE_LEGACY_VAL));
+		return cache_load_legacy(cache, buff, size);
+	} else {
+		ZRTP_LOG(2,(_ZTU_,"\tCache Error: Unsupported ZRTP cache version.\n"));
 	}
-	cache_elems_count = zrtp_ntoh32(cache_elems_count);
 
-	for (i=0; i<cache_elems_count; i++)
+	ZRTP_LOG(2,(_ZTU_,"\tCache Error: Unsupported version of ZRTP cache file detected - white-out the cache.\n"));
+	cache->needs_rewriting = 1;
+	return zrtp_status_ok;
+}
+
+static zrtp_status_t zrtp_cache_read_from_file(zrtp_cache_file_t *cache)
+{
+	uint8_t* buff = NULL;
+	uint32_t size = 0;
+	zrtp_status_t s = zrtp_status_ok;
+
+	ZRTP_LOG(3,(_ZTU_,"\tLoad ZRTP cache from <%s>...\n", cache->config.cache_path));
+
+	cache->cache_elems_counter = 0;
+	cache->mitmcache_elems_counter = 0;
+	cache->needs_rewriting = 0;
+	cache->log_size = 0;
+
+	/* Try to open existing file. If there is no cache file - start with empty cache */
+#if ZRTP_CACHE_USE_MMAP
 	{
-		new_elem = (zrtp_cache_entry_t*) zrtp_sys_alloc(sizeof(zrtp_cache_entry_t));
-		if (!new_elem) {
-			ZRTP_INT_CACHE_BREAK(s, zrtp_status_alloc_fail);
+		struct stat st;
+		int fd = open(cache->config.cache_path, O_RDONLY);
+		if (fd < 0) {
+			ZRTP_LOG(3,(_ZTU_,"\tCan't open file for reading.\n"));
+			return zrtp_status_ok;
 		}
 
-		if (fread(new_elem, ZRTP_CACHE_ELEM_LENGTH, 1, cache_file) <= 0) {
-			ZRTP_LOG(3,(_ZTU_,"\tERROR! RS cache element read fail (id=%u).\n", i));
-			zrtp_sys_free(new_elem);
-			ZRTP_INT_CACHE_BREAK(s, zrtp_status_read_fail);
+		if (0 != fstat(fd, &st)) {
+			close(fd);
+			return zrtp_status_read_fail;
 		}
 
-		zrtp_cache_entry_make_cross(NULL, new_elem, 1);
+		size = (uint32_t)st.st_size;
+		if (size > 0) {
+			void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (MAP_FAILED == map) {
+				close(fd);
+				return zrtp_status_read_fail;
+			}
+			buff = (uint8_t*)map;
+		}
+		close(fd);
 
-		new_elem->_index = cache->cache_elems_counter++;
-		new_elem->_is_dirty = 0;
+		s = cache_load(cache, buff, size);
 
-		mlist_add_tail(&cache->cache_head, &new_elem->_mlist);
-	}
-	if (i != cache_elems_count) {
-		s = zrtp_status_read_fail;
+		if (buff) {
+			munmap(buff, size);
+		}
 	}
+#else
+	{
+		FILE* cache_file = cache_fopen(cache->config.cache_path, "rb");
+		if (!cache_file) {
+			ZRTP_LOG(3,(_ZTU_,"\tCan't open file for reading.\n"));
+			return zrtp_status_ok;
+		}
 
-    if (0 != fclose(cache_file)) {
-		return zrtp_status_fail;
-    }
-
-	ZRTP_LOG(3,(_ZTU_,"\tAll of %u RS Cache entries have been uploaded.\n", cache->cache_elems_counter));
+		fseek(cache_file, 0, SEEK_END);
+		size = (uint32_t)ftell(cache_file);
+		fseek(cache_file, 0, SEEK_SET);
 
-	return s;
-}
+		if (size > 0) {
+			buff = zrtp_sys_alloc(size);
+			if (!buff) {
+				fclose(cache_file);
+				return zrtp_status_alloc_fail;
+			}
+			if (fread(buff, size, 1, cache_file) != 1) {
+				zrtp_sys_free(buff);
+				fclose(cache_file);
+				return zrtp_status_read_fail;
+			}
+		}
+		fclose(cache_file);
 
+		s = cache_load(cache, buff, size);
 
-#define ZRTP_DOWN_CACHE_RETURN(s, f, c) \
-{\
-	if (zrtp_status_ok != s) \
-		ZRTP_LOG(3,(_ZTU_,"\tERROR! Unable to writing to ZRTP cache file.\n")); \
-	if (f) \
-		fclose(f);\
-	return s;\
-};
+		if (buff) {
+			zrtp_sys_free(buff);
+		}
+	}
+#endif
 
-static zrtp_status_t flush_elem_(zrtp_cache_file_t *cache, zrtp_cache_entry_t *elem, FILE *cache_file, unsigned is_mitm) {
-	zrtp_cache_entry_t tmp_elem;
-	uint32_t pos;
+	ZRTP_LOG(3,(_ZTU_,"\tAll %u MiTM and %u RS Cache entries have been uploaded.\n",
+				cache->mitmcache_elems_counter, cache->cache_elems_counter));
 
-	/*
-	 * Let's calculate cache element position in the file
-	 */
+	return s;
+}
 
-	/* Skip the header */
-	pos = 0;
-	pos += strlen(ZRTP_DEF_CACHE_VERSION_STR)+strlen(ZRTP_DEF_CACHE_VERSION_VAL); /* Skip cache version string */
-	pos += sizeof(uint32_t); /* Skip MiTM secretes count. */
+/** Size of the log holding exactly one record per entry */
+static uint32_t cache_live_size(zrtp_cache_file_t *cache)
+{
+	return (uint32_t)ZRTP_CACHE_HDR_LENGTH +
+		   cache->mitmcache_index.count * ZRTP_CACHE_REC_LENGTH(ZRTP_MITMCACHE_ELEM_LENGTH) +
+		   cache->cache_index.count * ZRTP_CACHE_REC_LENGTH(ZRTP_CACHE_ELEM_LENGTH);
+}
 
-	//printf("flush_elem_(): \t pos=%u (Header, MiTM Count).\n", pos);
+/** Serializes all entries for the compaction. All pending changes go to the snapshot. */
+static zrtp_status_t cache_take_snapshot(zrtp_cache_file_t *cache)
+{
+	mlist_t *node = 0;
+	uint32_t pos = 0;
+	uint32_t i = 0;
+	uint8_t* buff = zrtp_sys_alloc(cache_live_size(cache));
 
-	if (is_mitm) {
-		/* position within MiTM secrets block. */
-		pos += (elem->_index * ZRTP_MITMCACHE_ELEM_LENGTH);
-		//printf("flush_elem_(): \t pos=%u (Header, MiTM Count + %u MiTM Secrets).\n", pos, elem->_index);
-	} else {
-		/* Skip MiTM Secrets block */
-		pos += (cache->mitmcache_elems_counter * ZRTP_MITMCACHE_ELEM_LENGTH);
+	if (!buff) {
+		return zrtp_status_alloc_fail;
+	}
 
-		pos += sizeof(uint32_t); /* Skip RS elements count. */
+	pos = cache_put_header(buff);
 
-		pos += (elem->_index * ZRTP_CACHE_ELEM_LENGTH); /* Skip previous RS elements */
+	/* MiTM secrets first, for the same load order as in the legacy format */
+	mlist_for_each(node, &cache->mitmcache_head) {
+		pos += cache_put_record(buff+pos, mlist_get_struct(zrtp_cache_entry_t, _mlist, node), 1);
+	}
+	mlist_for_each(node, &cache->cache_head) {
+		pos += cache_put_record(buff+pos, mlist_get_struct(zrtp_cache_entry_t, _mlist, node), 0);
+	}
 
-		//printf("flush_elem_(): \t pos=%u (Header, MiTM Count + ALL %u Secrets, RS counter and %u prev. RS).\n", pos, cache->mitmcache_elems_counter, elem->_index);
+	for (i=0; i<cache->mitmcache_index.dirty_count; i++) {
+		cache->mitmcache_index.dirty[i]->_is_dirty = 0;
+	}
+	for (i=0; i<cache->cache_index.dirty_count; i++) {
+		cache->cache_index.dirty[i]->_is_dirty = 0;
 	}
+	cache->mitmcache_index.dirty_count = 0;
+	cache->cache_index.dirty_count = 0;
 
-	fseek(cache_file, pos, SEEK_SET);
+	cache->compact_buff		= buff;
+	cache->compact_length	= pos;
+	cache->compact_mark		= cache->log_size;
+	cache->needs_rewriting	= 0;
 
-	/* Prepare element for storing, convert all fields to the network byte-order. */
-	zrtp_cache_entry_make_cross(elem, &tmp_elem, 0);
+	return zrtp_status_ok;
+}
 
-	//printf("flush_elem_(): write to offset=%lu\n", ftell(cache_file));
+/** Copies log records appended after the snapshot to the new log file */
+static zrtp_status_t cache_copy_tail(zrtp_cache_file_t *cache, FILE* to)
+{
+	uint8_t buff[4096];
+	uint32_t left = cache->log_size - cache->compact_mark;
+	FILE* from = NULL;
 
-	/* Flush the element. */
-	if (fwrite(&tmp_elem, (is_mitm ? ZRTP_MITMCACHE_ELEM_LENGTH : ZRTP_CACHE_ELEM_LENGTH), 1, cache_file) != 1) {
-		//printf("flush_elem_(): ERROR!!! write failed!\n");
-		return zrtp_status_write_fail;
-	} else {
-		elem->_is_dirty = 0;
-		//printf("flush_elem_(): OK! %lu bytes were written\n", (is_mitm ? ZRTP_MITMCACHE_ELEM_LENGTH : ZRTP_CACHE_ELEM_LENGTH));
+	if (0 == left) {
 		return zrtp_status_ok;
 	}
+
+	fflush(cache->log);
+	if (!(from = cache_fopen(cache->config.cache_path, "rb"))) {
+		return zrtp_status_open_fail;
+	}
+
+	fseek(from, cache->compact_mark, SEEK_SET);
+	while (left > 0) {
+		uint32_t chunk = ZRTP_MIN(left, sizeof(buff));
+		if ((fread(buff, chunk, 1, from) != 1) || (fwrite(buff, chunk, 1, to) != 1)) {
+			fclose(from);
+			return zrtp_status_write_fail;
+		}
+		left -= chunk;
+	}
+
+	fclose(from);
+	return zrtp_status_ok;
 }
 
-static zrtp_status_t zrtp_cache_store_to_file(zrtp_cache_file_t *cache)
+/**
+ * Writes the snapshot to a temporary file and replaces the log with it. The snapshot is written
+ * without the protector when \c is_background is set.
+ */
+static zrtp_status_t cache_compact(zrtp_cache_file_t *cache, unsigned is_background)
 {
-	FILE* cache_file = 0;
-	mlist_t *node = 0;
-	uint32_t count = 0, dirty_count=0;
-	uint32_t pos = 0;
+	char tmp_path[sizeof(cache->config.cache_path)+8];
+	FILE* tmp_file = NULL;
+	zrtp_status_t s = zrtp_status_ok;
 
-	ZRTP_LOG(3,(_ZTU_,"\tStoring ZRTP cache to <%s>...\n",  cache->config.cache_path));
+	zrtp_memcpy(tmp_path, cache->config.cache_path, strlen(cache->config.cache_path));
+	zrtp_memcpy(tmp_path+strlen(cache->config.cache_path), ".tmp", sizeof(".tmp"));
 
-    /* Open/create file for writing */
-#if (ZRTP_PLATFORM == ZP_WIN32)
-    if (g_needs_rewriting || 0 != fopen_s(&cache_file, cache->config.cache_path, "r+")) {
-		if (0 != fopen_s(&cache_file, cache->config.cache_path, "w+")) {
-			ZRTP_LOG(2,(_ZTU_,"\tERROR! unable to open ZRTP cache file <%s>.\n", cache->config.cache_path));
-			ZRTP_DOWN_CACHE_RETURN(zrtp_status_open_fail, cache_file, cache);
+	if (!(tmp_file = cache_fopen(tmp_path, "wb"))) {
+		s = zrtp_status_open_fail;
+	} else if (fwrite(cache->compact_buff, cache->compact_length, 1, tmp_file) != 1) {
+		s = zrtp_status_write_fail;
+	}
+
+	if (is_background) {
+		zrtp_mutex_lock(cache->cache_protector);
+	}
+
+	do {
+		if (zrtp_status_ok != s) {
+			break;
 		}
-    }
-#else
-	if (cache->needs_rewriting || !(cache_file = fopen(cache->config.cache_path, "r+"))) {
-		cache_file = fopen(cache->config.cache_path, "w+");
-		if (!cache_file) {
-			ZRTP_LOG(2,(_ZTU_,"\tERROR! unable to open ZRTP cache file <%s>.\n", cache->config.cache_path));
-			ZRTP_DOWN_CACHE_RETURN(zrtp_status_open_fail, cache_file, cache);
+		if (zrtp_status_ok != (s = cache_copy_tail(cache, tmp_file))) {
+			break;
 		}
-	}
+		if (0 != fclose(tmp_file)) {
+			tmp_file = NULL;
+			s = zrtp_status_write_fail;
+			break;
+		}
+		tmp_file = NULL;
+
+		if (cache->log) {
+			fclose(cache->log);
+			cache->log = NULL;
+		}
+#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
+		remove(cache->config.cache_path);
 #endif
+		if (0 != rename(tmp_path, cache->config.cache_path)) {
+			s = zrtp_status_write_fail;
+			break;
+		}
 
-	fseek(cache_file, 0, SEEK_SET);
+		cache->log_size = cache->compact_length + (cache->log_size - cache->compact_mark);
+		if ((cache->log = cache_fopen(cache->config.cache_path, "r+b"))) {
+			fseek(cache->log, cache->log_size, SEEK_SET);
+		}
+
+		ZRTP_LOG(3,(_ZTU_,"\tZRTP cache log compacted to %u bytes.\n", cache->log_size));
+	} while (0);
 
-	/* Store version string first. Format: &ZRTP_DEF_CACHE_VERSION_STR&ZRTP_DEF_CACHE_VERSION_VAL */
-	if (1 != fwrite(ZRTP_DEF_CACHE_VERSION_STR, strlen(ZRTP_DEF_CACHE_VERSION_STR), 1, cache_file)) {
-		ZRTP_LOG(2,(_ZTU_,"\tERROR! unable to write header to the cache file\n"));
-		ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
+	if (zrtp_status_ok != s) {
+		ZRTP_LOG(2,(_ZTU_,"\tERROR! Unable to compact ZRTP cache file <%s>.\n", cache->config.cache_path));
+		if (tmp_file) {
+			fclose(tmp_file);
+		}
+		remove(tmp_path);
+		/* Changes taken to the snapshot are not on the disk: rewrite everything next time */
+		cache->needs_rewriting = 1;
 	}
-	if (1 != fwrite(ZRTP_DEF_CACHE_VERSION_VAL, strlen(ZRTP_DEF_CACHE_VERSION_VAL), 1, cache_file)) {
-		ZRTP_LOG(2,(_ZTU_,"\tERROR! unable to write header to the cache file\n"));
-		ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
+
+	zrtp_sys_free(cache->compact_buff);
+	cache->compact_buff = NULL;
+	cache->is_compacting = 0;
+
+	if (is_background) {
+		zrtp_mutex_unlock(cache->cache_protector);
 	}
 
-    /*
-	 * Store PBX secrets first. Format: <secrets count>, <secrets' data>
-	 *
-	 * NOTE!!! It's IMPORTANT to store PBX secrets before the Regular secrets!!!
-	 */
-	pos = ftell(cache_file);
+	return s;
+}
 
-	count = 0; dirty_count = 0;
-	fwrite(&count, sizeof(count), 1, cache_file);
+#if ZRTP_CACHE_BG_COMPACTION
+#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
+static DWORD WINAPI cache_compact_thread(void* param)
+#else
+static void* cache_compact_thread(void* param)
+#endif
+{
+	zrtp_cache_file_t *cache = (zrtp_cache_file_t *)param;
 
-	mlist_for_each(node, &cache->mitmcache_head) {
-		zrtp_cache_entry_t* elem = mlist_get_struct(zrtp_cache_entry_t, _mlist, node);
-		/* Store dirty values only. */
-		if (cache->needs_rewriting || elem->_is_dirty) {
-			//printf("zrtp_cache_store_to_file: Store MiTM elem index=%u.\n", elem->_index);
-			dirty_count++;
-			if (zrtp_status_ok != flush_elem_(cache, elem, cache_file, 1)) {
-				ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
-			}
-		} else {
-			//printf("zrtp_cache_store_to_file: Skip MiTM elem index=%u, not modified.\n", elem->_index);
-		}
+#if ZRTP_CACHE_USE_MMAP
+	pthread_detach(pthread_self());
+#endif
+
+	cache_compact(cache, 1);
+	zrtp_sem_post(cache->compact_done);
+
+#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
+	return 0;
+#else
+	return NULL;
+#endif
+}
+#endif
+
+/** Starts background compaction if the log has grown too much. */
+static void cache_compact_if_needed(zrtp_cache_file_t *cache)
+{
+	uint32_t live_size = cache_live_size(cache);
+
+	if ( cache->is_compacting || cache->is_closing ||
+		(cache->log_size < live_size*ZRTP_CACHE_COMPACT_RATIO) ||
+		(cache->log_size - live_size < ZRTP_CACHE_COMPACT_MIN) ) {
+		return;
+	}
+
+	if (zrtp_status_ok != cache_take_snapshot(cache)) {
+		return;
 	}
+	cache->is_compacting = 1;
 
-	fseek(cache_file, pos, SEEK_SET);
+#if ZRTP_CACHE_BG_COMPACTION
+	/* Reap threads of finished compactions */
+	while ((cache->compact_threads > 0) && (zrtp_status_ok == zrtp_sem_trtwait(cache->compact_done))) {
+		cache->compact_threads--;
+	}
 
-	count = zrtp_hton32(cache->mitmcache_elems_counter);
-	if (fwrite(&count, sizeof(count), 1, cache_file) != 1) {
-		ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
+	if (0 == zrtp_thread_create(cache_compact_thread, cache)) {
+		cache->compact_threads++;
+		return;
 	}
+#endif
+	cache_compact(cache, 0);
+}
 
-	if (dirty_count > 0)
-		ZRTP_LOG(3,(_ZTU_,"\t%u out of %u MiTM cache entries have been flushed successfully.\n", dirty_count, zrtp_ntoh32(count)));
+static zrtp_status_t zrtp_cache_store_to_file(zrtp_cache_file_t *cache)
+{
+	zrtp_cache_index_t* indexes[2];
+	uint8_t record[ZRTP_CACHE_REC_LENGTH(ZRTP_CACHE_ELEM_LENGTH)];
+	uint32_t i = 0, j = 0;
+	uint32_t dirty_count = 0;
 
-	/*
-	 * Store regular secrets. Format: <secrets count>, <secrets' data>
-	 */
+	indexes[0] = &cache->mitmcache_index;
+	indexes[1] = &cache->cache_index;
+	dirty_count = indexes[0]->dirty_count + indexes[1]->dirty_count;
+
+	if (!dirty_count && !cache->needs_rewriting) {
+		return zrtp_status_ok;
+	}
 
-	/* Seek to the beginning of the Regular secrets block */
-	pos = strlen(ZRTP_DEF_CACHE_VERSION_STR)+strlen(ZRTP_DEF_CACHE_VERSION_VAL);
-	pos += sizeof(uint32_t); /* Skip MiTM secrets count. */
-	pos += (cache->mitmcache_elems_counter * ZRTP_MITMCACHE_ELEM_LENGTH); /* Skip MiTM Secrets block */
+	ZRTP_LOG(3,(_ZTU_,"\tStoring ZRTP cache to <%s>...\n",  cache->config.cache_path));
 
-	fseek(cache_file, pos, SEEK_SET);
+	/* Open the log: the snapshot of a running compaction doesn't have these changes, append them */
+	if (!cache->log && !cache->needs_rewriting) {
+		if ((cache->log = cache_fopen(cache->config.cache_path, "r+b"))) {
+			fseek(cache->log, cache->log_size, SEEK_SET);
+		}
+	}
 
-	count = 0; dirty_count=0;
-	fwrite(&count, sizeof(count), 1, cache_file);
+	if (!cache->log || cache->needs_rewriting) {
+		zrtp_status_t s = zrtp_status_ok;
+		if (cache->is_compacting) {
+			/* Keep changes dirty till the compaction ends */
+			return zrtp_status_ok;
+		}
 
-	mlist_for_each(node, &cache->cache_head) {
-		zrtp_cache_entry_t* elem = mlist_get_struct(zrtp_cache_entry_t, _mlist, node);
-
-		/* Store dirty values only. */
-		if (cache->needs_rewriting || elem->_is_dirty) {
-			//printf("zrtp_cache_user_down: Store RS elem index=%u.\n", elem->_index);
-			dirty_count++;
-			if (zrtp_status_ok != flush_elem_(cache, elem, cache_file, 0)) {
-				ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
+		/* New, damaged or legacy cache file: write all entries from scratch */
+		if (zrtp_status_ok != (s = cache_take_snapshot(cache))) {
+			return s;
+		}
+		cache->is_compacting = 1;
+		cache->log_size = 0;
+		cache->compact_mark = 0;
+		return cache_compact(cache, 0);
+	}
+
+	for (i=0; i<2; i++) {
+		zrtp_cache_index_t* index = indexes[i];
+		for (j=0; j<index->dirty_count; j++) {
+			uint32_t length = cache_put_record(record, index->dirty[j], (0 == i));
+			if (fwrite(record, length, 1, cache->log) != 1) {
+				ZRTP_LOG(3,(_ZTU_,"\tERROR! Unable to writing to ZRTP cache file.\n"));
+				/* The log may end with a partial record now */
+				cache->needs_rewriting = 1;
+				return zrtp_status_write_fail;
 			}
+			cache->log_size += length;
 		}
- 		else {
- 			//printf("zrtp_cache_user_down: Skip RS elem index=%u, not modified.\n", elem->_index);
-		 }
 	}
 
-	fseek(cache_file, pos, SEEK_SET);
+	if (0 != fflush(cache->log)) {
+		cache->needs_rewriting = 1;
+		return zrtp_status_write_fail;
+	}
 
-	count = zrtp_hton32(cache->cache_elems_counter);
-	if (fwrite(&count, sizeof(count), 1, cache_file) != 1) {
-		ZRTP_DOWN_CACHE_RETURN(zrtp_status_write_fail, cache_file, cache);
+	for (i=0; i<2; i++) {
+		for (j=0; j<indexes[i]->dirty_count; j++) {
+			indexes[i]->dirty[j]->_is_dirty = 0;
+		}
+		indexes[i]->dirty_count = 0;
 	}
 
-	if (dirty_count > 0)
-		ZRTP_LOG(3,(_ZTU_,"\t%u out of %u regular cache entries have been flushed successfully.\n", dirty_count, zrtp_ntoh32(count)));
+	ZRTP_LOG(3,(_ZTU_,"\t%u cache entries have been flushed successfully.\n", dirty_count));
 
-	cache->needs_rewriting = 0;
+	cache_compact_if_needed(cache);
 
-	ZRTP_DOWN_CACHE_RETURN(zrtp_status_ok, cache_file, cache);
 	return zrtp_status_ok;
 }
 
@@ -885,20 +1221,132 @@ static void zrtp_cache_create_id(const zrtp_stringn_t* first_ZID,
 	zrtp_memcpy((char*)id+sizeof(zrtp_zid_t), second_ZID->buffer, sizeof(zrtp_zid_t));
 }
 
+/** FNV-1a over the whole ID: one half of it is the same local ZID for all entries */
+static uint32_t index_hash(const zrtp_cache_entry_id_t id)
+{
+	uint32_t hash = 2166136261U;
+	uint32_t i = 0;
+	for (i=0; i<sizeof(zrtp_cache_entry_id_t); i++) {
+		hash = (hash ^ id[i]) * 16777619U;
+	}
+	return hash;
+}
+
+static zrtp_cache_index_t* get_index(zrtp_cache_file_t *cache_file, uint8_t is_mitm)
+{
+	return is_mitm ? &cache_file->mitmcache_index : &cache_file->cache_index;
+}
+
+static zrtp_status_t index_grow(zrtp_cache_index_t* index)
+{
+	uint32_t size = index->size ? index->size*2 : ZRTP_CACHE_INDEX_MIN_SIZE;
+	zrtp_cache_entry_t** slots = zrtp_sys_alloc(size * sizeof(zrtp_cache_entry_t*));
+	zrtp_cache_entry_t** dirty = zrtp_sys_alloc(size * sizeof(zrtp_cache_entry_t*));
+	uint32_t i = 0;
+
+	if (!slots || !dirty) {
+		if (slots) zrtp_sys_free(slots);
+		if (dirty) zrtp_sys_free(dirty);
+		return zrtp_status_alloc_fail;
+	}
+	zrtp_memset(slots, 0, size * sizeof(zrtp_cache_entry_t*));
+
+	for (i=0; i<index->size; i++) {
+		zrtp_cache_entry_t* elem = index->slots[i];
+		if (elem) {
+			uint32_t pos = index_hash(elem->id) & (size - 1);
+			while (slots[pos]) {
+				pos = (pos + 1) & (size - 1);
+			}
+			slots[pos] = elem;
+		}
+	}
+
+	if (index->dirty_count) {
+		zrtp_memcpy(dirty, index->dirty, index->dirty_count * sizeof(zrtp_cache_entry_t*));
+	}
+	if (index->slots) {
+		zrtp_sys_free(index->slots);
+		zrtp_sys_free(index->dirty);
+	}
+
+	index->slots = slots;
+	index->dirty = dirty;
+	index->size	 = size;
+	return zrtp_status_ok;
+}
+
+static void index_free(zrtp_cache_index_t* index)
+{
+	if (index->slots) {
+		zrtp_sys_free(index->slots);
+		zrtp_sys_free(index->dirty);
+	}
+	zrtp_memset(index, 0, sizeof(zrtp_cache_index_t));
+}
+
 static zrtp_cache_entry_t* get_elem(zrtp_cache_file_t *cache_file,
 		const zrtp_cache_entry_id_t id,
 		uint8_t is_mitm)
 {
-	mlist_t* node = NULL;
-	mlist_t* head = is_mitm ? &cache_file->mitmcache_head : &cache_file->cache_head;
-	mlist_for_each(node, head) {
-		zrtp_cache_entry_t* elem = mlist_get_struct(zrtp_cache_entry_t, _mlist, node);
-		if (!zrtp_memcmp(elem->id, id, sizeof(zrtp_cache_entry_id_t))) {
-			return elem;
+	zrtp_cache_index_t* index = get_index(cache_file, is_mitm);
+	uint32_t pos = 0;
+
+	if (!index->size) {
+		return NULL;
+	}
+
+	pos = index_hash(id) & (index->size - 1);
+	while (index->slots[pos]) {
+		if (!zrtp_memcmp(index->slots[pos]->id, id, sizeof(zrtp_cache_entry_id_t))) {
+			return index->slots[pos];
+		}
+		pos = (pos + 1) & (index->size - 1);
+	}
+
+	return NULL;
+}
+
+static zrtp_status_t add_elem(zrtp_cache_file_t *cache_file, zrtp_cache_entry_t* elem, uint8_t is_mitm)
+{
+	zrtp_cache_index_t* index = get_index(cache_file, is_mitm);
+	uint32_t pos = 0;
+
+	/* Keep load factor under 1/2 */
+	if ((index->count + 1)*2 > index->size) {
+		zrtp_status_t s = index_grow(index);
+		if (zrtp_status_ok != s) {
+			return s;
 		}
-   }
+	}
+
+	pos = index_hash(elem->id) & (index->size - 1);
+	while (index->slots[pos]) {
+		pos = (pos + 1) & (index->size - 1);
+	}
+	index->slots[pos] = elem;
+	index->count++;
+
+	if (is_mitm) {
+		elem->_index = cache_file->mitmcache_elems_counter++;
+		mlist_add_tail(&cache_file->mitmcache_head, &elem->_mlist);
+	} else {
+		elem->_index = cache_file->cache_elems_counter++;
+		mlist_add_tail(&cache_file->cache_head, &elem->_mlist);
+	}
 
-   return NULL;
+	return zrtp_status_ok;
+}
+
+static void mark_dirty(zrtp_cache_file_t *cache_file, zrtp_cache_entry_t* elem, uint8_t is_mitm)
+{
+	zrtp_cache_index_t* index = get_index(cache_file, is_mitm);
+
+	/* Dirty list has room for every entry, so it can't overflow */
+	if (!elem->_is_dirty) {
+		elem->_is_dirty = 1;
+		index->dirty[index->dirty_count++] = elem;
+	}
 }
 
 static void zrtp_cache_entry_make_cross(zrtp_cache_entry_t* from, zrtp_cache_entry_t* to, uint8_t is_upload)
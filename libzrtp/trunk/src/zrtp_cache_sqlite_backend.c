@@ -1,11 +1,20 @@
 /*
  */
 
+/*
+ * -std=c99 hides CLOCK_MONOTONIC, clock_gettime(), pthread_condattr_setclock() and
+ * random(). This must come before any system header.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include <sqlite3.h>
 
 #include "zrtp_b64_encode.h"
@@ -13,10 +22,20 @@
 
 #include "zrtp_cache_db_backend.h"
 
-#ifdef TRANSACTIONS
-static const char *beginTransactionSql  = "BEGIN TRANSACTION;";
-static const char *commitTransactionSql = "COMMIT;";
-#endif
+static char *beginTransactionSql  = "BEGIN IMMEDIATE TRANSACTION;";
+static char *commitTransactionSql = "COMMIT;";
+
+/*
+ * WAL lets readers run concurrently with the writer and appends commits to the
+ * log instead of rewriting database pages. With synchronous=NORMAL SQLite
+ * syncs the log only at checkpoints, a commit survives an application crash
+ * and may be lost only on power failure.
+ */
+static char *journalModeSql = "PRAGMA journal_mode=WAL;";
+static char *synchronousSql = "PRAGMA synchronous=NORMAL;";
+
+/* How long a write waits for another process that holds the database lock */
+#define DB_CACHE_BUSY_TIMEOUT_MS    2000
 
 /*
  * The database backend uses the following definitions if it implements the localZid storage.
@@ -121,6 +140,50 @@ static char *updateZrtpNames =
     "WHERE remoteZid=?1 AND localZid=?2 AND accountInfo=?3;";
 
 
+/* *****************************************************************************
+ * Statements prepared once per database handle.
+ *
+ * openCache prepares the statements, the methods reset them and clear their
+ * bindings after use, closeCache finalizes them.
+ */
+enum {
+    STMT_BEGIN = 0,
+    STMT_COMMIT,
+    STMT_SELECT_ID_OWN,
+    STMT_INSERT_ID_OWN,
+    STMT_SELECT_ID_REMOTE,
+    STMT_INSERT_ID_REMOTE,
+    STMT_UPDATE_ID_REMOTE,
+    STMT_SELECT_NAMES,
+    STMT_INSERT_NAMES,
+    STMT_UPDATE_NAMES,
+    STMT_COUNT
+};
+
+#if defined(__APPLE__)
+#define DB_CACHE_CLOCK  CLOCK_REALTIME      /* no pthread_condattr_setclock() */
+#else
+#define DB_CACHE_CLOCK  CLOCK_MONOTONIC
+#endif
+
+/**
+ * The database handle that openCache returns to libzrtp.
+ *
+ * The mutex serializes all methods and the commit thread: they share the
+ * SQLite connection, its prepared statements and the open transaction.
+ */
+typedef struct {
+    sqlite3         *db;
+    sqlite3_stmt    *stmts[STMT_COUNT];
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;         /* wakes the commit thread up */
+    pthread_t       committer;
+    int             hasCommitter;   /* zero: commit every update on its own */
+    int             closing;
+    int             pending;        /* updates in the open transaction */
+    struct timespec deadline;       /* commit the open transaction at this time at the latest */
+} sqliteCache_t;
+
 /* *****************************************************************************
  * A few helping macros. 
  * These macros require some names/patterns in the methods that use these 
@@ -134,6 +197,9 @@ static char *updateZrtpNames =
  * - a cleanup label, the macro goes to that label in case of error
  * - an integer (int) variable with name "rc" that stores return codes from sqlite
  * - ERRMSG
+ *
+ * STMT_RELEASE returns a cached statement to its initial state, ready for
+ * the next call.
  */
 #define ERRMSG  {if (errString) snprintf(errString, DB_CACHE_ERR_BUFF_SIZE, \
                                          "SQLite3 error: %s, line: %d, error message: %s\n", __FILE__, __LINE__, sqlite3_errmsg(db));}
@@ -145,6 +211,13 @@ static char *updateZrtpNames =
         }                                                               \
     }
 
+#define STMT_RELEASE(stmt) {                                            \
+        if (stmt) {                                                     \
+            sqlite3_reset(stmt);                                        \
+            sqlite3_clear_bindings(stmt);                               \
+        }                                                               \
+    }
+
 static int b64Encode(const uint8_t *binData, int32_t binLength, char *b64Data, int32_t b64Length)
 {
     base64_encodestate _state;
@@ -167,47 +240,140 @@ static int b64Decode(const char *b64Data, int32_t b64length, uint8_t *binData, i
     return codelength;
 }
 
-#ifdef TRANSACTIONS
-static int beginTransaction(sqlite3 *db, char* errString)
+static int stepStatement(sqlite3 *db, sqlite3_stmt *stmt, char *errString)
 {
-    sqlite3_stmt *stmt;
-    int rc;
-
-    SQLITE_CHK(sqlite3_prepare_v2(db, beginTransactionSql, strlen(beginTransactionSql)+1, &stmt, NULL));
-
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(stmt);
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
     }
-    return SQLITE_OK;
+    sqlite3_reset(stmt);
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
 
- cleanup:
-    sqlite3_finalize(stmt);
-    return rc;
+/*
+ * Group commit helpers. The caller holds the handle lock.
+ *
+ * Every update runs in the open transaction, beginUpdate opens one if there
+ * is none. finishUpdate accounts for the update and commits the transaction
+ * if the batch is full, otherwise the commit thread commits it when the
+ * deadline of the oldest pending update expires.
+ */
+static int beginUpdate(sqliteCache_t *cache, char *errString)
+{
+    sqlite3 *db = cache->db;
+
+    if (!sqlite3_get_autocommit(db)) {
+        return SQLITE_OK;
+    }
+    return stepStatement(db, cache->stmts[STMT_BEGIN], errString);
 }
 
-static int commitTransaction(sqlite3 *db, char* errString)
+static int commitUpdates(sqliteCache_t *cache, char *errString)
 {
-    sqlite3_stmt *stmt;
-    int rc;
+    sqlite3 *db = cache->db;
+    int rc = SQLITE_OK;
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, commitTransactionSql, strlen(commitTransactionSql)+1, &stmt, NULL));
+    if (!sqlite3_get_autocommit(db)) {
+        rc = stepStatement(db, cache->stmts[STMT_COMMIT], errString);
+    }
+    /* A failed statement may have rolled back the transaction with everything in it */
+    if (rc == SQLITE_OK || sqlite3_get_autocommit(db)) {
+        cache->pending = 0;
+    }
+    return rc;
+}
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    if (rc != SQLITE_DONE) {
-        ERRMSG;
+static int finishUpdate(sqliteCache_t *cache, int rc, char *errString)
+{
+    if (rc != SQLITE_OK) {
+        /* Don't keep the write lock for a transaction without updates */
+        if (cache->pending == 0) {
+            commitUpdates(cache, NULL);
+        }
         return rc;
     }
+
+    if (!cache->hasCommitter || ++cache->pending >= DB_CACHE_COMMIT_BATCH) {
+        return commitUpdates(cache, errString);
+    }
+    if (cache->pending == 1) {
+        clock_gettime(DB_CACHE_CLOCK, &cache->deadline);
+        cache->deadline.tv_sec  += DB_CACHE_COMMIT_DELAY_MS / 1000;
+        cache->deadline.tv_nsec += (DB_CACHE_COMMIT_DELAY_MS % 1000) * 1000000L;
+        if (cache->deadline.tv_nsec >= 1000000000L) {
+            cache->deadline.tv_sec++;
+            cache->deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_signal(&cache->wakeup);
+    }
     return SQLITE_OK;
+}
+
+static int deadlineExpired(const struct timespec *deadline)
+{
+    struct timespec now;
+
+    clock_gettime(DB_CACHE_CLOCK, &now);
+    return (now.tv_sec > deadline->tv_sec) ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+static void *commitThread(void *arg)
+{
+    sqliteCache_t *cache = (sqliteCache_t*)arg;
+
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->closing) {
+        if (cache->pending == 0) {
+            pthread_cond_wait(&cache->wakeup, &cache->lock);
+        }
+        else {
+            pthread_cond_timedwait(&cache->wakeup, &cache->lock, &cache->deadline);
+            if (cache->pending > 0 && deadlineExpired(&cache->deadline)) {
+                commitUpdates(cache, NULL);
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+
+static int prepareStatements(sqliteCache_t *cache, char *errString)
+{
+    sqlite3 *db = cache->db;
+    const char *sql[STMT_COUNT];
+    int rc = SQLITE_OK;
+    int i;
+
+    sql[STMT_BEGIN] =            beginTransactionSql;
+    sql[STMT_COMMIT] =           commitTransactionSql;
+    sql[STMT_SELECT_ID_OWN] =    selectZrtpIdOwn;
+    sql[STMT_INSERT_ID_OWN] =    insertZrtpIdOwn;
+    sql[STMT_SELECT_ID_REMOTE] = selectZrtpIdRemoteAll;
+    sql[STMT_INSERT_ID_REMOTE] = insertZrtpIdRemote;
+    sql[STMT_UPDATE_ID_REMOTE] = updateZrtpIdRemote;
+    sql[STMT_SELECT_NAMES] =     selectZrtpNames;
+    sql[STMT_INSERT_NAMES] =     insertZrtpNames;
+    sql[STMT_UPDATE_NAMES] =     updateZrtpNames;
+
+    for (i = 0; i < STMT_COUNT; i++) {
+        SQLITE_CHK(sqlite3_prepare_v2(db, sql[i], strlen(sql[i])+1, &cache->stmts[i], NULL));
+    }
 
  cleanup:
-    sqlite3_finalize(stmt);
     return rc;
 }
-#endif
+
+static void freeCache(sqliteCache_t *cache)
+{
+    int i;
+
+    for (i = 0; i < STMT_COUNT; i++) {
+        sqlite3_finalize(cache->stmts[i]);
+    }
+    sqlite3_close(cache->db);
+    free(cache);
+}
 
 /**
  * Create ZRTP cache tables in database.
@@ -268,8 +434,9 @@ static int createTables(sqlite3 *db, char* errString)
 static int insertRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid, 
                                  const remoteZidRecord_t *remZid, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_INSERT_ID_REMOTE];
     int rc = 0;
 
     char b64RemoteZid[IDENTIFIER_LEN*2] = {0};
@@ -281,7 +448,8 @@ static int insertRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint
     /* Get B64 code for localZid now */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, insertZrtpIdRemote, strlen(insertZrtpIdRemote)+1, &stmt, NULL));
+    pthread_mutex_lock(&cache->lock);
+    SQLITE_CHK(beginUpdate(cache, errString));
 
     /* For *_bind_* methods: column index starts with 1 (one), not zero */
     SQLITE_CHK(sqlite3_bind_text(stmt,   1, b64RemoteZid, strlen(b64RemoteZid), SQLITE_STATIC));
@@ -299,24 +467,26 @@ static int insertRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint
     SQLITE_CHK(sqlite3_bind_int(stmt,   13, remZid->preshCounter));
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
     }
-    return SQLITE_OK;
+    else {
+        rc = SQLITE_OK;
+    }
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    rc = finishUpdate(cache, rc, errString);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
-
 }
 
 static int updateRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid, 
                                  const remoteZidRecord_t *remZid, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_UPDATE_ID_REMOTE];
     int rc;
 
     char b64RemoteZid[IDENTIFIER_LEN*2] = {0};
@@ -328,7 +498,8 @@ static int updateRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint
     /* Get B64 code for localZid now */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, updateZrtpIdRemote, strlen(updateZrtpIdRemote)+1, &stmt, NULL));
+    pthread_mutex_lock(&cache->lock);
+    SQLITE_CHK(beginUpdate(cache, errString));
 
     /* For *_bind_* methods: column index starts with 1 (one), not zero */
     /* Select for update with the following keys */
@@ -349,23 +520,26 @@ static int updateRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint
     SQLITE_CHK(sqlite3_bind_int(stmt,   13, remZid->preshCounter));
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
     }
-    return SQLITE_OK;
+    else {
+        rc = SQLITE_OK;
+    }
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    rc = finishUpdate(cache, rc, errString);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
 }
 
 static int readRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid, 
                                remoteZidRecord_t *remZid, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_SELECT_ID_REMOTE];
     int rc;
     int found = 0;
 
@@ -378,7 +552,8 @@ static int readRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint8_
     /* Get B64 code for localZid */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, selectZrtpIdRemoteAll, strlen(selectZrtpIdRemoteAll)+1, &stmt, NULL));
+    /* Reads on this connection see the updates that wait for the group commit */
+    pthread_mutex_lock(&cache->lock);
     SQLITE_CHK(sqlite3_bind_text(stmt, 1, b64RemoteZid, strlen(b64RemoteZid), SQLITE_STATIC));
     SQLITE_CHK(sqlite3_bind_text(stmt, 2, b64LocalZid, strlen(b64LocalZid), SQLITE_STATIC));
 
@@ -397,32 +572,33 @@ static int readRemoteZidRecord(void *vdb, const uint8_t *remoteZid, const uint8_
         remZid->preshCounter =  sqlite3_column_int(stmt,   10);
         found++;
     }
-    sqlite3_finalize(stmt);
 
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
+        goto cleanup;
     }
+    rc = SQLITE_OK;
     if (found == 0) {
         remZid->flags = 0;
     }
     else if (found > 1) {
         if (errString) 
             snprintf(errString, DB_CACHE_ERR_BUFF_SIZE, "ZRTP cache inconsistent. More than one remote ZID found: %d\n", found);
-        return 1;
+        rc = 1;
     }
-    return SQLITE_OK;
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
 }
 
 
 static int readLocalZid(void *vdb, uint8_t *localZid, const char *accountInfo, char *errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_SELECT_ID_OWN];
     char *zidBase64Text;
     int rc = 0;
     int found = 0;
@@ -433,9 +609,9 @@ static int readLocalZid(void *vdb, uint8_t *localZid, const char *accountInfo, c
         type = localZidStandard;
     }
 
-    /* Find a localZid record for this combination */
-    SQLITE_CHK(sqlite3_prepare_v2(db, selectZrtpIdOwn, strlen(selectZrtpIdOwn)+1, &stmt, NULL));
+    pthread_mutex_lock(&cache->lock);
 
+    /* Find a localZid record for this combination */
     SQLITE_CHK(sqlite3_bind_int(stmt,  1, type));
     SQLITE_CHK(sqlite3_bind_text(stmt, 2, accountInfo, strlen(accountInfo), SQLITE_STATIC));
 
@@ -447,12 +623,14 @@ static int readLocalZid(void *vdb, uint8_t *localZid, const char *accountInfo, c
         }
         found++;
     }
-    sqlite3_finalize(stmt);
 
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
+        goto cleanup;
     }
+    STMT_RELEASE(stmt);
+    rc = SQLITE_OK;
+
     /* No matching record found, create new local ZID for this combination and store in DB */
     if (found == 0) {
         int32_t *ptmp = (int32_t*)localZid;
@@ -467,29 +645,34 @@ static int readLocalZid(void *vdb, uint8_t *localZid, const char *accountInfo, c
         *ptmp = random();
         b64len = b64Encode(localZid, IDENTIFIER_LEN, b64zid, IDENTIFIER_LEN+IDENTIFIER_LEN);
 
-        SQLITE_CHK(sqlite3_prepare_v2(db, insertZrtpIdOwn, strlen(insertZrtpIdOwn)+1, &stmt, NULL));
+        stmt = cache->stmts[STMT_INSERT_ID_OWN];
+        SQLITE_CHK(beginUpdate(cache, errString));
 
         SQLITE_CHK(sqlite3_bind_text(stmt, 1, b64zid, b64len, SQLITE_STATIC));
         SQLITE_CHK(sqlite3_bind_int(stmt,  2, type));
         SQLITE_CHK(sqlite3_bind_text(stmt, 3, accountInfo, strlen(accountInfo), SQLITE_STATIC));
 
         rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
         if (rc != SQLITE_DONE) {
             ERRMSG;
-            return rc;
+            STMT_RELEASE(stmt);
+            finishUpdate(cache, rc, NULL);
+            goto cleanup;
         }
+        STMT_RELEASE(stmt);
+
+        /* Don't wait for the group commit with a new local ZID */
+        rc = commitUpdates(cache, errString);
     }
     else if (found > 1) {
         if (errString) 
             snprintf(errString, DB_CACHE_ERR_BUFF_SIZE,
                      "ZRTP cache inconsistent. Found %d matching local ZID for account: %s\n", found, accountInfo);
-        rc = 1;
     }
-    return SQLITE_OK;
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
 }
 
@@ -507,55 +690,105 @@ static int readLocalZid(void *vdb, uint8_t *localZid, const char *accountInfo, c
 
 static int openCache(char* name, void **vpdb, char *errString)
 {
-    sqlite3_stmt *stmt;
+    sqlite3_stmt *stmt = NULL;
     int found = 0;
-    sqlite3 **pdb = (sqlite3**)vpdb;
+    sqliteCache_t *cache;
     sqlite3 *db;
+    pthread_condattr_t attr;
+    int rc;
+
+    *vpdb = NULL;
+    cache = (sqliteCache_t*)calloc(1, sizeof(sqliteCache_t));
+    if (cache == NULL) {
+        if (errString)
+            snprintf(errString, DB_CACHE_ERR_BUFF_SIZE, "ZRTP cache: cannot allocate the database handle\n");
+        return SQLITE_NOMEM;
+    }
 
-    int rc = sqlite3_open_v2(name, pdb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
-    db = *pdb;
+    rc = sqlite3_open_v2(name, &cache->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    db = cache->db;
     if (rc) {
         ERRMSG;
+        freeCache(cache);
         return(rc);
     }
+    sqlite3_busy_timeout(db, DB_CACHE_BUSY_TIMEOUT_MS);
+
+    /* Ignore errors, the cache works with the default journal as well */
+    sqlite3_exec(db, journalModeSql, NULL, NULL, NULL);
+    sqlite3_exec(db, synchronousSql, NULL, NULL, NULL);
 
     /* check if ZRTP cache tables are already available, look if zrtpIdOwn is available */
     SQLITE_CHK(sqlite3_prepare_v2(db, lookupTables, strlen(lookupTables)+1, &stmt, NULL));
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    stmt = NULL;
 
     if (rc == SQLITE_ROW) {
         found++;
     }
     else if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
+        goto cleanup;
     }
     /* If table zrtpOwnId not found then we have an empty cache DB */
     if (found == 0) {
         rc = createTables(db, errString);
         if (rc)
-            return rc;
+            goto cleanup;
     }
+    rc = prepareStatements(cache, errString);
+    if (rc)
+        goto cleanup;
+
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_condattr_init(&attr);
+#if !defined(__APPLE__)
+    pthread_condattr_setclock(&attr, DB_CACHE_CLOCK);
+#endif
+    pthread_cond_init(&cache->wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* Without the commit thread every update commits on its own */
+    if (DB_CACHE_COMMIT_DELAY_MS > 0) {
+        cache->hasCommitter = (pthread_create(&cache->committer, NULL, commitThread, cache) == 0);
+    }
+
+    *vpdb = cache;
     return SQLITE_OK;
 
  cleanup:
     sqlite3_finalize(stmt);
+    freeCache(cache);
     return rc;
 }
 
 static int closeCache(void *vdb)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_close(db);
-    return SQLITE_OK;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    int rc;
+
+    if (cache->hasCommitter) {
+        pthread_mutex_lock(&cache->lock);
+        cache->closing = 1;
+        pthread_cond_signal(&cache->wakeup);
+        pthread_mutex_unlock(&cache->lock);
+        pthread_join(cache->committer, NULL);
+    }
+    rc = commitUpdates(cache, NULL);
+
+    pthread_cond_destroy(&cache->wakeup);
+    pthread_mutex_destroy(&cache->lock);
+    freeCache(cache);
+    return rc;
 }
 
 static int insertZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid,
                                const char *accountInfo, zidNameRecord_t *zidName, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_INSERT_NAMES];
     int rc = 0;
     char b64RemoteZid[IDENTIFIER_LEN*2] = {0};
     char b64LocalZid[IDENTIFIER_LEN*2] = {0};
@@ -570,7 +803,8 @@ static int insertZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_
     /* Get B64 code for localZid */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, insertZrtpNames, strlen(insertZrtpNames)+1, &stmt, NULL));
+    pthread_mutex_lock(&cache->lock);
+    SQLITE_CHK(beginUpdate(cache, errString));
 
     /* For *_bind_* methods: column index starts with 1 (one), not zero */
     SQLITE_CHK(sqlite3_bind_text(stmt,  1, b64RemoteZid, strlen(b64RemoteZid), SQLITE_STATIC));
@@ -585,25 +819,27 @@ static int insertZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_
         SQLITE_CHK(sqlite3_bind_text(stmt,   6, "_NO_NAME_", 9, SQLITE_STATIC));
     }
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
     }
-    return SQLITE_OK;
+    else {
+        rc = SQLITE_OK;
+    }
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    rc = finishUpdate(cache, rc, errString);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
-
 }
 
 
 static int updateZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid,
                                const char *accountInfo, zidNameRecord_t *zidName, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_UPDATE_NAMES];
     int rc = 0;
     char b64RemoteZid[IDENTIFIER_LEN*2] = {0};
     char b64LocalZid[IDENTIFIER_LEN*2] = {0};
@@ -618,7 +854,8 @@ static int updateZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_
     /* Get B64 code for localZid */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, updateZrtpNames, strlen(updateZrtpNames)+1, &stmt, NULL));
+    pthread_mutex_lock(&cache->lock);
+    SQLITE_CHK(beginUpdate(cache, errString));
 
     /* For *_bind_* methods: column index starts with 1 (one), not zero */
     /* Select for update with the following values */
@@ -636,24 +873,26 @@ static int updateZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_
         SQLITE_CHK(sqlite3_bind_text(stmt,   6, "_NO_NAME_", 9, SQLITE_STATIC));
     }
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
     }
-    return SQLITE_OK;
+    else {
+        rc = SQLITE_OK;
+    }
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    rc = finishUpdate(cache, rc, errString);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
-
 }
 
 static int readZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_t *localZid,
                              const char *accountInfo, zidNameRecord_t *zidName, char* errString)
 {
-    sqlite3 *db = (sqlite3*)vdb;
-    sqlite3_stmt *stmt;
+    sqliteCache_t *cache = (sqliteCache_t*)vdb;
+    sqlite3 *db = cache->db;
+    sqlite3_stmt *stmt = cache->stmts[STMT_SELECT_NAMES];
     int rc;
     int found = 0;
 
@@ -669,8 +908,7 @@ static int readZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_t
     /* Get B64 code for localZid */
     b64Encode(localZid, IDENTIFIER_LEN, b64LocalZid, IDENTIFIER_LEN*2);
 
-    SQLITE_CHK(sqlite3_prepare_v2(db, selectZrtpNames, strlen(selectZrtpNames)+1, &stmt, NULL));
-
+    pthread_mutex_lock(&cache->lock);
     SQLITE_CHK(sqlite3_bind_text(stmt, 1, b64RemoteZid, strlen(b64RemoteZid), SQLITE_STATIC));
     SQLITE_CHK(sqlite3_bind_text(stmt, 2, b64LocalZid, strlen(b64LocalZid), SQLITE_STATIC));
     SQLITE_CHK(sqlite3_bind_text(stmt, 3, accountInfo, strlen(accountInfo), SQLITE_STATIC));
@@ -682,23 +920,23 @@ static int readZidNameRecord(void *vdb, const uint8_t *remoteZid, const uint8_t
         zidName->nameLength = sqlite3_column_bytes(stmt, 2);    /* Return number of bytes in string */
         found++;
     }
-    sqlite3_finalize(stmt);
 
     if (rc != SQLITE_DONE) {
         ERRMSG;
-        return rc;
+        goto cleanup;
     }
+    rc = SQLITE_OK;
     if (found == 0)
         zidName->flags = 0;
     else if (found > 1) {
         if (errString)
             snprintf(errString, DB_CACHE_ERR_BUFF_SIZE, "ZRTP name cache inconsistent. More than one ZID name found: %d\n", found);
-        return 1;
+        rc = 1;
     }
-    return SQLITE_OK;
 
  cleanup:
-    sqlite3_finalize(stmt);
+    STMT_RELEASE(stmt);
+    pthread_mutex_unlock(&cache->lock);
     return rc;
 }
 
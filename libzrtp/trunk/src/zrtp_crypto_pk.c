@@ -349,3 +349,306 @@ zrtp_status_t zrtp_done_pkt(zrtp_global_t* zrtp)
     
     return zrtp_status_ok;
 }
+
+
+/*============================================================================*/
+/*    DH/ECDH key pairs pool												  */
+/*============================================================================*/
+
+/* Key pairs are computed on a separate thread where libzrtp knows how to create one */
+#if (defined(ZRTP_USE_BUILTIN_SCEHDULER) && (ZRTP_USE_BUILTIN_SCEHDULER == 1)) && \
+	(ZRTP_PLATFORM != ZP_SYMBIAN) && (ZRTP_PLATFORM != ZP_WIN32_KERNEL)
+#define ZRTP_PK_POOL_THREAD		1
+#else
+#define ZRTP_PK_POOL_THREAD		0
+#endif
+
+#define ZRTP_PK_POOL_SEM_LIMIT	0x7FFF
+
+typedef struct zrtp_pk_pair_t
+{
+	struct BigNum			sv;
+	struct BigNum			pv;
+} zrtp_pk_pair_t;
+
+/** Ready key pairs of a single PK scheme */
+typedef struct zrtp_pk_pool_slot_t
+{
+	zrtp_pk_scheme_t		*scheme;
+	zrtp_pk_pair_t			*pairs;		/** stack of ready pairs, pool#size items long */
+	uint32_t				count;		/** number of ready pairs */
+	uint32_t				hits;		/** streams which got a ready pair */
+	uint32_t				misses;		/** streams which had to compute the pair themselves */
+} zrtp_pk_pool_slot_t;
+
+typedef struct zrtp_pk_pool_t
+{
+	zrtp_pk_pool_slot_t		slots[ZRTP_MAX_COMP_COUNT];
+	uint32_t				slots_count;
+	uint32_t				size;		/** number of pairs to keep for every scheme */
+	zrtp_mutex_t			*protector;	/** protects slots and flags */
+	zrtp_sem_t				*refill;	/** wakes the generator up when a pair was taken */
+	zrtp_sem_t				*done;		/** posted by the generator when it exits */
+	uint8_t					is_running;
+	uint8_t					is_stopping;
+} zrtp_pk_pool_t;
+
+/*----------------------------------------------------------------------------*/
+static void _zrtp_pk_pool_free(zrtp_pk_pool_t *pool)
+{
+	uint32_t i, j;
+
+	for (i=0; i<pool->slots_count; i++) {
+		zrtp_pk_pool_slot_t *slot = &pool->slots[i];
+		if (!slot->pairs) {
+			continue;
+		}
+		/* bnEnd() wipes secret values */
+		for (j=0; j<slot->count; j++) {
+			bnEnd(&slot->pairs[j].sv);
+			bnEnd(&slot->pairs[j].pv);
+		}
+		zrtp_sys_free(slot->pairs);
+	}
+
+	if (pool->protector) {
+		zrtp_mutex_destroy(pool->protector);
+	}
+#if ZRTP_PK_POOL_THREAD
+	if (pool->refill) {
+		zrtp_sem_destroy(pool->refill);
+	}
+	if (pool->done) {
+		zrtp_sem_destroy(pool->done);
+	}
+#endif
+	zrtp_sys_free(pool);
+}
+
+#if ZRTP_PK_POOL_THREAD
+/*----------------------------------------------------------------------------*/
+#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
+static DWORD WINAPI _zrtp_pk_pool_generator(void* param)
+#else
+static void* _zrtp_pk_pool_generator(void* param)
+#endif
+{
+	zrtp_pk_pool_t *pool = (zrtp_pk_pool_t *)param;
+	zrtp_pk_pool_slot_t *slot = NULL;
+	zrtp_dh_crypto_context_t dh_cc;
+	zrtp_status_t s = zrtp_status_ok;
+	uint32_t i;
+
+	zrtp_mutex_lock(pool->protector);
+	while (!pool->is_stopping) {
+		/* Refill the emptiest pool first */
+		slot = NULL;
+		for (i=0; i<pool->slots_count; i++) {
+			if ((pool->slots[i].count < pool->size) && (!slot || (pool->slots[i].count < slot->count))) {
+				slot = &pool->slots[i];
+			}
+		}
+
+		if (!slot) {
+			zrtp_mutex_unlock(pool->protector);
+			zrtp_sem_wait(pool->refill);
+			zrtp_mutex_lock(pool->protector);
+			continue;
+		}
+
+		/* Schemes are immutable, compute the pair without holding the lock */
+		zrtp_mutex_unlock(pool->protector);
+		zrtp_memset(&dh_cc, 0, sizeof(dh_cc));
+		s = slot->scheme->initialize(slot->scheme, &dh_cc);
+		zrtp_mutex_lock(pool->protector);
+
+		if (zrtp_status_ok != s) {
+			ZRTP_LOG(1,(_ZTU_,"ERROR! Can't compute %.4s key pair for the pool: %s. Stop refilling.\n",
+						slot->scheme->base.type, zrtp_log_status2str(s)));
+			bnEnd(&dh_cc.sv);
+			bnEnd(&dh_cc.pv);
+			break;
+		}
+
+		slot->pairs[slot->count].sv = dh_cc.sv;
+		slot->pairs[slot->count].pv = dh_cc.pv;
+		slot->count++;
+	}
+	zrtp_mutex_unlock(pool->protector);
+
+	zrtp_sem_post(pool->done);
+	return 0;
+}
+#endif /* ZRTP_PK_POOL_THREAD */
+
+/*----------------------------------------------------------------------------*/
+zrtp_status_t zrtp_pk_pool_init(zrtp_global_t* zrtp, uint32_t size, const uint8_t* schemes)
+{
+#if ZRTP_PK_POOL_THREAD
+	zrtp_pk_pool_t *pool = NULL;
+	zrtp_status_t s = zrtp_status_ok;
+	uint32_t i = 0;
+
+	zrtp->pk_pool = NULL;
+	if (!size || !schemes || !schemes[0]) {
+		return zrtp_status_ok;
+	}
+
+	pool = zrtp_sys_alloc(sizeof(zrtp_pk_pool_t));
+	if (!pool) {
+		return zrtp_status_alloc_fail;
+	}
+	zrtp_memset(pool, 0, sizeof(zrtp_pk_pool_t));
+	pool->size = size;
+
+	do {
+		for (i=0; schemes[i] && (pool->slots_count < ZRTP_MAX_COMP_COUNT); i++) {
+			zrtp_pk_pool_slot_t *slot = &pool->slots[pool->slots_count];
+
+			/* Preshared and Multistream modes don't use key pairs */
+			if ((ZRTP_PKTYPE_PRESH == schemes[i]) || (ZRTP_PKTYPE_MULT == schemes[i])) {
+				continue;
+			}
+			slot->scheme = zrtp_comp_find(ZRTP_CC_PKT, schemes[i], zrtp);
+			if (!slot->scheme) {
+				continue;
+			}
+
+			slot->pairs = zrtp_sys_alloc(sizeof(zrtp_pk_pair_t) * size);
+			if (!slot->pairs) {
+				s = zrtp_status_alloc_fail;
+				break;
+			}
+			pool->slots_count++;
+		}
+		if (zrtp_status_ok != s) {
+			break;
+		}
+
+		s = zrtp_mutex_init(&pool->protector);
+		if (zrtp_status_ok != s) {
+			break;
+		}
+		s = zrtp_sem_init(&pool->refill, 0, ZRTP_PK_POOL_SEM_LIMIT);
+		if (zrtp_status_ok != s) {
+			break;
+		}
+		s = zrtp_sem_init(&pool->done, 0, 1);
+		if (zrtp_status_ok != s) {
+			break;
+		}
+
+		if (0 != zrtp_thread_create(_zrtp_pk_pool_generator, pool)) {
+			ZRTP_LOG(2,(_ZTU_,"WARNING! Can't start the key pairs generator. Streams will compute key pairs themselves.\n"));
+			s = zrtp_status_fail;
+			break;
+		}
+		pool->is_running = 1;
+	} while (0);
+
+	if (zrtp_status_ok != s) {
+		_zrtp_pk_pool_free(pool);
+		/* libzrtp works without the pool, only slower */
+		return (zrtp_status_alloc_fail == s) ? s : zrtp_status_ok;
+	}
+
+	ZRTP_LOG(3,(_ZTU_,"Keep %u pre-computed key pairs for %u PK schemes.\n", size, pool->slots_count));
+	zrtp->pk_pool = pool;
+	return zrtp_status_ok;
+#else
+	zrtp->pk_pool = NULL;
+	return zrtp_status_ok;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+void zrtp_pk_pool_down(zrtp_global_t* zrtp)
+{
+	zrtp_pk_pool_t *pool = (zrtp_pk_pool_t *)zrtp->pk_pool;
+
+	if (!pool) {
+		return;
+	}
+
+#if ZRTP_PK_POOL_THREAD
+	zrtp_mutex_lock(pool->protector);
+	pool->is_stopping = 1;
+	zrtp_mutex_unlock(pool->protector);
+
+	if (pool->is_running) {
+		zrtp_sem_post(pool->refill);
+		zrtp_sem_wait(pool->done);
+	}
+#endif
+
+	_zrtp_pk_pool_free(pool);
+	zrtp->pk_pool = NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+static zrtp_pk_pool_slot_t* _zrtp_pk_pool_find(zrtp_pk_pool_t *pool, uint8_t id)
+{
+	uint32_t i;
+
+	if (pool) {
+		for (i=0; i<pool->slots_count; i++) {
+			if (pool->slots[i].scheme->base.id == id) {
+				return &pool->slots[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+zrtp_status_t zrtp_pk_pool_take(zrtp_pk_scheme_t *self, zrtp_dh_crypto_context_t *dh_cc)
+{
+	zrtp_pk_pool_t *pool = (zrtp_pk_pool_t *)self->base.zrtp->pk_pool;
+	zrtp_pk_pool_slot_t *slot = _zrtp_pk_pool_find(pool, self->base.id);
+	uint8_t is_hit = 0;
+
+	if (slot) {
+		zrtp_mutex_lock(pool->protector);
+		if (slot->count) {
+			slot->count--;
+			dh_cc->sv = slot->pairs[slot->count].sv;
+			dh_cc->pv = slot->pairs[slot->count].pv;
+			slot->hits++;
+			is_hit = 1;
+		} else {
+			slot->misses++;
+		}
+		zrtp_mutex_unlock(pool->protector);
+
+#if ZRTP_PK_POOL_THREAD
+		zrtp_sem_post(pool->refill);
+#endif
+		if (is_hit) {
+			return zrtp_status_ok;
+		}
+	}
+
+	return self->initialize(self, dh_cc);
+}
+
+/*----------------------------------------------------------------------------*/
+zrtp_status_t zrtp_pk_pool_get_stats(zrtp_global_t* zrtp, uint8_t id, uint32_t* hits, uint32_t* misses)
+{
+	zrtp_pk_pool_t *pool = (zrtp_pk_pool_t *)zrtp->pk_pool;
+	zrtp_pk_pool_slot_t *slot = _zrtp_pk_pool_find(pool, id);
+
+	if (!slot) {
+		return zrtp_status_fail;
+	}
+
+	zrtp_mutex_lock(pool->protector);
+	if (hits) {
+		*hits = slot->hits;
+	}
+	if (misses) {
+		*misses = slot->misses;
+	}
+	zrtp_mutex_unlock(pool->protector);
+
+	return zrtp_status_ok;
+}
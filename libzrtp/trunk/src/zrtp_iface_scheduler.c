@@ -3,10 +3,18 @@
  * Copyright (c) 2006-2009 Philip R. Zimmermann.  All rights reserved.
  * Contact: http://philzimmermann.com
  * For licensing and other legal details, see the file zrtp_legal.c.
- * 
- * Viktor Krykun <v.krikun at zfoneproject.com> 
+ *
+ * Viktor Krykun <v.krikun at zfoneproject.com>
  */
 
+/*
+ * The library is built with -std=c99, which hides CLOCK_MONOTONIC, clock_gettime(),
+ * pthread_condattr_setclock() and usleep(). This must come before any system header.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "zrtp.h"
 
 #if (defined(ZRTP_USE_BUILTIN_SCEHDULER) && (ZRTP_USE_BUILTIN_SCEHDULER ==1))
@@ -19,46 +27,71 @@
 /* Windows kernel have it's own realization based on kernel timers */
 #if (ZRTP_PLATFORM != ZP_WIN32_KERNEL)
 
-#define ZRTP_SCHED_QUEUE_SIZE	ZRTP_MAX_STREAMS_PER_SESSION * 1000
-#define ZRTP_SCHED_LOOP_QVANT 20
+/*
+ * Tasks are kept in a hierarchical timing wheel: ZRTP_SCHED_WHEEL_LEVELS levels of
+ * ZRTP_SCHED_WHEEL_SIZE slots each, with 1 ms resolution at the lowest level. Every level
+ * covers ZRTP_SCHED_WHEEL_SIZE times the range of the previous one; entries of the upper levels
+ * are cascaded down when the lower level wraps. Insert and cancel are O(1), and the scheduler
+ * thread sleeps exactly until the next non-empty slot.
+ */
+#define ZRTP_SCHED_WHEEL_BITS	6
+#define ZRTP_SCHED_WHEEL_SIZE	(1 << ZRTP_SCHED_WHEEL_BITS)
+#define ZRTP_SCHED_WHEEL_MASK	(ZRTP_SCHED_WHEEL_SIZE - 1)
+#define ZRTP_SCHED_WHEEL_LEVELS	4
+#define ZRTP_SCHED_WHEEL_SPAN	((uint64_t)1 << (ZRTP_SCHED_WHEEL_BITS*ZRTP_SCHED_WHEEL_LEVELS))
 
-#define ZRTP_SCHED_SLEEP(count) zrtp_sleep(ZRTP_SCHED_LOOP_QVANT*count);
+/** Number of task nodes allocated at once when the pool runs dry */
+#define ZRTP_SCHED_POOL_CHUNK	256
+
+#define ZRTP_SCHED_NEVER		((uint64_t)-1)
 
 
 /** Schedulling tasks structure */
-typedef struct 
-{    
+typedef struct
+{
 	zrtp_stream_t   *ctx;		/** ZRTP stream context associated with the task */
 	zrtp_retry_task_t	*ztask;		/** ZRTP stream associated with the task */
 	uint64_t			wake_at;	/* Wake time in milliseconds */
-	mlist_t				_mlist;
+	mlist_t				_mlist;		/* Wheel slot, ready queue or free pool link */
 } zrtp_sched_task_t;
 
+/** Block of pooled task nodes */
+typedef struct
+{
+	mlist_t				_mlist;
+	zrtp_sched_task_t	tasks[ZRTP_SCHED_POOL_CHUNK];
+} zrtp_sched_chunk_t;
+
 /** Initiation flag. Protection from reinitialization.  (1 if initiated) */
 static uint8_t		inited = 0;
 
-/** Sorted by wake time tasks list.  First task to do at the begining */
-static mlist_t		tasks_head;
+static uint8_t		is_running = 0;
 
-/** Tasks queue protector againts race conditions on add/remove tasks */
-static zrtp_mutex_t* protector = NULL;
+/** Timing wheel slots */
+static mlist_t		wheel[ZRTP_SCHED_WHEEL_LEVELS][ZRTP_SCHED_WHEEL_SIZE];
 
-/** Main queue symaphore */
-static zrtp_sem_t* count = NULL;
+/** Time (in scheduler clock milliseconds) the wheel has been advanced to */
+static uint64_t		wheel_time = 0;
 
-static uint8_t is_running = 0;
-#if (ZRTP_PLATFORM == ZP_WIN32 || ZRTP_PLATFORM == ZP_WINCE)
-HANDLE scheduler_thread = NULL;
-#else
-static uint8_t is_working = 0;
-#endif
+/** Time the scheduler thread is going to wake up at */
+static uint64_t		sleep_until = ZRTP_SCHED_NEVER;
+
+/** Expired tasks waiting for the callback call, in expiration order */
+static mlist_t		ready_head;
+
+/** Free task nodes and allocated node blocks */
+static mlist_t		free_head;
+static mlist_t		chunks_head;
+
+/** Number of running scheduler and worker threads */
+static uint32_t		threads = 0;
 
 
 /*==========================================================================*/
 /*				   	     Platform Dependent Routine                         */
 /*==========================================================================*/
 
-#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WINCE)
+#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
 #include <Windows.h>
 
 int zrtp_sleep(unsigned int msec)
@@ -70,15 +103,81 @@ int zrtp_sleep(unsigned int msec)
 int zrtp_thread_create(zrtp_thread_routine_t start_routine, void *arg)
 {
 	DWORD	dwThreadId;
-	
-	scheduler_thread = CreateThread(NULL, 0, start_routine, 0, 0, &dwThreadId);
-	if (NULL == scheduler_thread) {
+	HANDLE	thread = CreateThread(NULL, 0, start_routine, arg, 0, &dwThreadId);
+	if (NULL == thread) {
 		return -1;
 	}
-	
+
+	CloseHandle(thread);
 	return 0;
 }
 
+static CRITICAL_SECTION	protector;
+
+#if (ZRTP_PLATFORM != ZP_WINCE)
+typedef CONDITION_VARIABLE	zrtp_sched_cond_t;
+
+static void sched_cond_init(zrtp_sched_cond_t* cond)	{ InitializeConditionVariable(cond); }
+static void sched_cond_destroy(zrtp_sched_cond_t* cond)	{ (void)cond; }
+static void sched_cond_signal(zrtp_sched_cond_t* cond)	{ WakeConditionVariable(cond); }
+static void sched_cond_broadcast(zrtp_sched_cond_t* cond)	{ WakeAllConditionVariable(cond); }
+
+static uint64_t sched_now()
+{
+	return (uint64_t)GetTickCount64();
+}
+
+static void sched_cond_wait(zrtp_sched_cond_t* cond, uint64_t deadline)
+{
+	DWORD msec = INFINITE;
+	if (ZRTP_SCHED_NEVER != deadline) {
+		uint64_t now = sched_now();
+		msec = (deadline > now) ? (DWORD)(deadline - now) : 0;
+	}
+	SleepConditionVariableCS(cond, &protector, msec);
+}
+#else
+/*
+ * Windows CE has no condition variables: waiters poll with a short sleep. All waits are done
+ * in loops which re-check their predicates, so missed signals only cost latency.
+ */
+typedef int	zrtp_sched_cond_t;
+
+#define ZRTP_SCHED_CE_POLL		10
+
+static void sched_cond_init(zrtp_sched_cond_t* cond)	{ (void)cond; }
+static void sched_cond_destroy(zrtp_sched_cond_t* cond)	{ (void)cond; }
+static void sched_cond_signal(zrtp_sched_cond_t* cond)	{ (void)cond; }
+static void sched_cond_broadcast(zrtp_sched_cond_t* cond)	{ (void)cond; }
+
+static uint64_t sched_now()
+{
+	return (uint64_t)zrtp_time_now();
+}
+
+static void sched_cond_wait(zrtp_sched_cond_t* cond, uint64_t deadline)
+{
+	DWORD msec = ZRTP_SCHED_CE_POLL;
+	if (ZRTP_SCHED_NEVER != deadline) {
+		uint64_t now = sched_now();
+		if (deadline <= now) {
+			msec = 0;
+		} else if (deadline - now < msec) {
+			msec = (DWORD)(deadline - now);
+		}
+	}
+	(void)cond;
+	LeaveCriticalSection(&protector);
+	Sleep(msec);
+	EnterCriticalSection(&protector);
+}
+#endif
+
+static void sched_lock_init()		{ InitializeCriticalSection(&protector); }
+static void sched_lock_destroy()	{ DeleteCriticalSection(&protector); }
+static void sched_lock()			{ EnterCriticalSection(&protector); }
+static void sched_unlock()			{ LeaveCriticalSection(&protector); }
+
 #elif (ZRTP_PLATFORM == ZP_LINUX) || (ZRTP_PLATFORM == ZP_DARWIN) || (ZRTP_PLATFORM == ZP_BSD) || (ZRTP_PLATFORM == ZP_ANDROID)
 #if ZRTP_HAVE_UNISTD_H == 1
 #include <unistd.h>
@@ -90,6 +189,7 @@ int zrtp_thread_create(zrtp_thread_routine_t start_routine, void *arg)
 #else
 #	error "Used environment dosn't have <pthread.h> - zrtp_scheduler can't be build."
 #endif
+#include <time.h>
 
 int zrtp_sleep(unsigned int msec)
 {
@@ -102,262 +202,525 @@ int zrtp_thread_create(zrtp_thread_routine_t start_routine, void *arg)
 	pthread_t thread;
 	return pthread_create(&thread, NULL, start_routine, arg);
 }
+
+/*
+ * Deadlines are measured on the monotonic clock where condition variables can wait on it, so
+ * wall clock adjustments don't stall or burst retries. Darwin falls back to the system time.
+ */
+#if (ZRTP_PLATFORM == ZP_DARWIN)
+#define ZRTP_SCHED_MONOTONIC	0
+#elif defined(CLOCK_MONOTONIC)
+#define ZRTP_SCHED_MONOTONIC	1
+#else
+#error "CLOCK_MONOTONIC is not declared - check the feature-test macros at the top of zrtp_iface_scheduler.c."
+#endif
+
+typedef pthread_cond_t	zrtp_sched_cond_t;
+
+static pthread_mutex_t	protector;
+
+static void sched_cond_init(zrtp_sched_cond_t* cond)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#if ZRTP_SCHED_MONOTONIC
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void sched_cond_destroy(zrtp_sched_cond_t* cond)	{ pthread_cond_destroy(cond); }
+static void sched_cond_signal(zrtp_sched_cond_t* cond)	{ pthread_cond_signal(cond); }
+static void sched_cond_broadcast(zrtp_sched_cond_t* cond)	{ pthread_cond_broadcast(cond); }
+
+static uint64_t sched_now()
+{
+#if ZRTP_SCHED_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+#else
+	return (uint64_t)zrtp_time_now();
+#endif
+}
+
+static void sched_cond_wait(zrtp_sched_cond_t* cond, uint64_t deadline)
+{
+	if (ZRTP_SCHED_NEVER == deadline) {
+		pthread_cond_wait(cond, &protector);
+	} else {
+		struct timespec ts;
+		ts.tv_sec  = (time_t)(deadline / 1000);
+		ts.tv_nsec = (long)(deadline % 1000) * 1000000;
+		pthread_cond_timedwait(cond, &protector, &ts);
+	}
+}
+
+static void sched_lock_init()		{ pthread_mutex_init(&protector, NULL); }
+static void sched_lock_destroy()	{ pthread_mutex_destroy(&protector); }
+static void sched_lock()			{ pthread_mutex_lock(&protector); }
+static void sched_unlock()			{ pthread_mutex_unlock(&protector); }
 #endif
 
+/** Wakes the scheduler thread when an earlier deadline appears or on shutdown */
+static zrtp_sched_cond_t	wake_cond;
+
+/** Wakes worker threads when the ready queue gets new tasks */
+static zrtp_sched_cond_t	ready_cond;
+
+/** Signalled when a callback finishes or a thread exits */
+static zrtp_sched_cond_t	idle_cond;
+
+
+/*==========================================================================*/
+/*				   	     Task Nodes Pool                                    */
+/*==========================================================================*/
+
+static zrtp_sched_task_t* sched_node_alloc()
+{
+	mlist_t* node = mlist_get(&free_head);
+	if (!node) {
+		int i = 0;
+		zrtp_sched_chunk_t* chunk = zrtp_sys_alloc(sizeof(zrtp_sched_chunk_t));
+		if (!chunk) {
+			return NULL;
+		}
+		mlist_add(&chunks_head, &chunk->_mlist);
+		for (i=0; i<ZRTP_SCHED_POOL_CHUNK; i++) {
+			mlist_add(&free_head, &chunk->tasks[i]._mlist);
+		}
+		node = mlist_get(&free_head);
+	}
+
+	mlist_del(node);
+	return mlist_get_struct(zrtp_sched_task_t, _mlist, node);
+}
+
+static void sched_node_free(zrtp_sched_task_t* task)
+{
+	task->ctx   = NULL;
+	task->ztask = NULL;
+	mlist_add(&free_head, &task->_mlist);
+}
+
+/** Removes the pending call of \c ztask, if any. Must be called under protector. */
+static void sched_unlink(zrtp_retry_task_t* ztask)
+{
+	zrtp_sched_task_t* task = (zrtp_sched_task_t*)ztask->_sched;
+	if (task) {
+		mlist_del(&task->_mlist);
+		sched_node_free(task);
+		ztask->_sched = NULL;
+	}
+}
+
+
+/*==========================================================================*/
+/*				   	     Timing Wheel                                       */
+/*==========================================================================*/
+
+static void sched_wheel_add(zrtp_sched_task_t* task)
+{
+	uint64_t expires = task->wake_at;
+	uint64_t delta = 0;
+	int level = 0;
+
+	if (expires <= wheel_time) {
+		mlist_add_tail(&ready_head, &task->_mlist);
+		return;
+	}
+
+	delta = expires - wheel_time;
+	if (delta >= ZRTP_SCHED_WHEEL_SPAN) {
+		/* Out of range tasks are parked at the farthest slot and re-sorted on cascade */
+		delta   = ZRTP_SCHED_WHEEL_SPAN - 1;
+		expires = wheel_time + delta;
+	}
+
+	while (delta >= ((uint64_t)1 << (ZRTP_SCHED_WHEEL_BITS*(level+1)))) {
+		level++;
+	}
+
+	mlist_add_tail( &wheel[level][(expires >> (ZRTP_SCHED_WHEEL_BITS*level)) & ZRTP_SCHED_WHEEL_MASK],
+					&task->_mlist );
+}
+
+/**
+ * Returns the earliest time something has to be done with the wheel: expiration of a lowest
+ * level slot or cascade of an upper level one. ZRTP_SCHED_NEVER for an empty wheel.
+ */
+static uint64_t sched_wheel_next()
+{
+	uint64_t next = ZRTP_SCHED_NEVER;
+	int level = 0;
+
+	for (level=0; level<ZRTP_SCHED_WHEEL_LEVELS; level++) {
+		int shift = ZRTP_SCHED_WHEEL_BITS*level;
+		uint64_t base = wheel_time >> shift;
+		int k = 0;
+
+		for (k=1; k<=ZRTP_SCHED_WHEEL_SIZE; k++) {
+			if (!mlist_isempty(&wheel[level][(base + k) & ZRTP_SCHED_WHEEL_MASK])) {
+				uint64_t at = (base + k) << shift;
+				if (at < next) {
+					next = at;
+				}
+				break;
+			}
+		}
+	}
+
+	return next;
+}
+
+static void sched_wheel_rehash(mlist_t* slot)
+{
+	mlist_t *node = 0, *tmp = 0;
+	mlist_t list;
+
+	init_mlist(&list);
+	mlist_for_each_safe(node, tmp, slot) {
+		mlist_del(node);
+		mlist_add_tail(&list, node);
+	}
+	mlist_for_each_safe(node, tmp, &list) {
+		mlist_del(node);
+		sched_wheel_add(mlist_get_struct(zrtp_sched_task_t, _mlist, node));
+	}
+}
+
+/** Moves the wheel to \c now, putting all expired tasks into the ready queue */
+static void sched_wheel_advance(uint64_t now)
+{
+	while (wheel_time < now) {
+		uint64_t next = sched_wheel_next();
+		int level = 1;
+
+		if (next > now) {
+			wheel_time = now;
+			break;
+		}
+
+		wheel_time = next;
+
+		/* Find the highest level which wrapped at this tick and cascade from the top down */
+		while ( (level < ZRTP_SCHED_WHEEL_LEVELS) &&
+				(0 == ((next >> (ZRTP_SCHED_WHEEL_BITS*(level-1))) & ZRTP_SCHED_WHEEL_MASK)) ) {
+			level++;
+		}
+		while (--level > 0) {
+			sched_wheel_rehash(&wheel[level][(next >> (ZRTP_SCHED_WHEEL_BITS*level)) & ZRTP_SCHED_WHEEL_MASK]);
+		}
+
+		sched_wheel_rehash(&wheel[0][next & ZRTP_SCHED_WHEEL_MASK]);
+	}
+}
+
 
 /*==========================================================================*/
 /*				   	     Scheduler Implementation                           */
 /*==========================================================================*/
+
+/**
+ * Takes the first ready task and runs its callback. The protector is released during the
+ * callback. Returns 0 if the ready queue was empty.
+ */
+static int sched_run_ready()
+{
+	zrtp_sched_task_t* task = NULL;
+	zrtp_stream_t* ctx = NULL;
+	zrtp_retry_task_t* ztask = NULL;
+	mlist_t* node = mlist_get(&ready_head);
+
+	if (!node) {
+		return 0;
+	}
+
+	task  = mlist_get_struct(zrtp_sched_task_t, _mlist, node);
+	ctx   = task->ctx;
+	ztask = task->ztask;
+
+	mlist_del(node);
+	sched_node_free(task);
+
+	/* The stream may have been wiped without cancel: drop stale nodes */
+	if (ztask->_sched != task) {
+		return 1;
+	}
+	ztask->_sched = NULL;
+
+	ztask->_is_busy = 1;
+	sched_unlock();
+
+	ztask->callback(ctx, ztask);
+
+	sched_lock();
+	ztask->_is_busy = 0;
+	sched_cond_broadcast(&idle_cond);
+
+	return 1;
+}
+
+static void sched_thread_enter()
+{
+#if (ZRTP_PLATFORM == ZP_LINUX) || (ZRTP_PLATFORM == ZP_DARWIN) || (ZRTP_PLATFORM == ZP_BSD) || (ZRTP_PLATFORM == ZP_ANDROID)
+	pthread_detach(pthread_self());
+#endif
+#if defined (ZRTP_DEBUG_WITH_PJSIP) && (ZRTP_DEBUG_WITH_PJSIP == 1)
+	{
+		/*
+			Register current thread if it was created by
+			external system call(not pj_sip call)
+		*/
+		pj_thread_desc desc;
+		pj_thread_t *sched_loop_thread;
+
+		if (pj_thread_is_registered()==PJ_FALSE){
+			pj_thread_register("zrtp_sched_loop_thread", desc, &sched_loop_thread);
+		}
+	}
+#endif
+}
+
+static void sched_thread_leave()
+{
+	threads--;
+	sched_cond_broadcast(&idle_cond);
+	sched_unlock();
+}
+
 #if   (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
 static DWORD WINAPI sched_loop(void* param)
-#elif (ZRTP_PLATFORM == ZP_SYMBIAN)
-static int sched_loop(void* param)
 #else
 static void* sched_loop(void* param)
 #endif
 {
-#if ZRTP_PLATFORM == ZP_LINUX
-pthread_detach((pthread_self()));
-printf("sched_loop, added by lee, for thread resource free\n");
-#endif
-#if defined (ZRTP_DEBUG_WITH_PJSIP) && (ZRTP_DEBUG_WITH_PJSIP == 1)
-    /*
-        Register current thread if it was created by 
-        external system call(not pj_sip call)
-    */
-    pj_thread_desc desc;
-    pj_thread_t *sched_loop_thread;
-
-    if (pj_thread_is_registered()==PJ_FALSE){
-        pj_thread_register("zrtp_sched_loop_thread", desc, &sched_loop_thread);
-    }
-#endif
-	
-#if (ZRTP_PLATFORM != ZP_WIN32 && ZRTP_PLATFORM != ZP_WINCE)
-	is_working = 1;
-#endif
+	sched_thread_enter();
+
+	sched_lock();
 	while (is_running)
 	{
-		zrtp_sched_task_t* task = NULL;		
-		zrtp_sched_task_t task2run;
-		int ready_2_run = 0;
-		mlist_t* node = 0;
-
-		/* Wait for tasks in queue */
-		zrtp_sem_wait(count);
-		 
-		zrtp_mutex_lock(protector);
-		
-		node = mlist_get(&tasks_head);
-		if (!node) {	
-			zrtp_mutex_unlock(protector);
-			continue;
-		}
+		sched_wheel_advance(sched_now());
 
-		task = mlist_get_struct(zrtp_sched_task_t, _mlist, node);
-		if (task->wake_at <= zrtp_time_now())
-		{
-			task2run.ctx = task->ctx;
-			task2run.ztask = task->ztask;
-			mlist_del(node);
-			zrtp_sys_free(task);
-			ready_2_run = 1;
+#if ZRTP_SCHED_WORKERS > 0
+		if (!mlist_isempty(&ready_head)) {
+			sched_cond_broadcast(&ready_cond);
 		}
-		
-		zrtp_mutex_unlock(protector);
-		
-		if (ready_2_run) {
-			task2run.ztask->_is_busy = 1;
-			task2run.ztask->callback(task2run.ctx, task2run.ztask);
-			task2run.ztask->_is_busy = 0;
-		} else {
-			zrtp_sem_post(count);
+#else
+		if (sched_run_ready()) {
+			continue;
 		}
-		
-		ZRTP_SCHED_SLEEP(1);
+#endif
+
+		sleep_until = sched_wheel_next();
+		sched_cond_wait(&wake_cond, sleep_until);
+		sleep_until = ZRTP_SCHED_NEVER;
 	}
-	
-#if (ZRTP_PLATFORM != ZP_WIN32)&& (ZRTP_PLATFORM != ZP_WINCE)
-	is_working = 0;
+	sched_thread_leave();
+
+#if   (ZRTP_PLATFORM != ZP_WIN32) && (ZRTP_PLATFORM != ZP_WIN64) && (ZRTP_PLATFORM != ZP_WINCE)
+	return NULL;
+#else
+	return 0;
 #endif
-	
+}
+
+#if ZRTP_SCHED_WORKERS > 0
+#if   (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WIN64) || (ZRTP_PLATFORM == ZP_WINCE)
+static DWORD WINAPI sched_worker(void* param)
+#else
+static void* sched_worker(void* param)
+#endif
+{
+	sched_thread_enter();
+
+	sched_lock();
+	while (is_running)
+	{
+		if (!sched_run_ready()) {
+			sched_cond_wait(&ready_cond, ZRTP_SCHED_NEVER);
+		}
+	}
+	sched_thread_leave();
+
 #if   (ZRTP_PLATFORM != ZP_WIN32) && (ZRTP_PLATFORM != ZP_WIN64) && (ZRTP_PLATFORM != ZP_WINCE)
 	return NULL;
 #else
 	return 0;
 #endif
 }
+#endif
 
 /*---------------------------------------------------------------------------*/
+static void sched_stop_threads()
+{
+	sched_lock();
+	is_running = 0;
+	sched_cond_broadcast(&wake_cond);
+	sched_cond_broadcast(&ready_cond);
+	while (threads > 0) {
+		sched_cond_wait(&idle_cond, ZRTP_SCHED_NEVER);
+	}
+	sched_unlock();
+}
+
+static void sched_release()
+{
+	mlist_t *node = 0, *tmp = 0;
+
+	mlist_for_each_safe(node, tmp, &chunks_head) {
+		zrtp_sys_free(mlist_get_struct(zrtp_sched_chunk_t, _mlist, node));
+	}
+	init_mlist(&chunks_head);
+	init_mlist(&free_head);
+
+	sched_cond_destroy(&idle_cond);
+	sched_cond_destroy(&ready_cond);
+	sched_cond_destroy(&wake_cond);
+	sched_lock_destroy();
+}
+
 zrtp_status_t zrtp_def_scheduler_init(zrtp_global_t* zrtp)
-{	
-	zrtp_status_t status = zrtp_status_ok;
-	
+{
+	int i = 0, j = 0;
+
 	if (inited) {
 		return zrtp_status_ok;
 	}
-	
-	do {
-		init_mlist(&tasks_head);
 
-		if (zrtp_status_ok != (status = zrtp_mutex_init(&protector))) {
-			break;
-		}		
-		if (zrtp_status_ok != (status = zrtp_sem_init(&count, 0, ZRTP_SCHED_QUEUE_SIZE))) {
-			break;
+	for (i=0; i<ZRTP_SCHED_WHEEL_LEVELS; i++) {
+		for (j=0; j<ZRTP_SCHED_WHEEL_SIZE; j++) {
+			init_mlist(&wheel[i][j]);
 		}
-
-		/* Starting processing loop */
-		is_running = 1;
-		
-		if (0 != zrtp_thread_create(sched_loop, NULL)) {
-			zrtp_sem_destroy(count);
-			zrtp_mutex_destroy(protector);
-			
-			status = zrtp_status_fail;
+	}
+	init_mlist(&ready_head);
+	init_mlist(&free_head);
+	init_mlist(&chunks_head);
+
+	sched_lock_init();
+	sched_cond_init(&wake_cond);
+	sched_cond_init(&ready_cond);
+	sched_cond_init(&idle_cond);
+
+	wheel_time  = sched_now();
+	sleep_until = ZRTP_SCHED_NEVER;
+
+	/* Starting processing loop and workers */
+	is_running = 1;
+
+	sched_lock();
+	for (i=0; i<1+ZRTP_SCHED_WORKERS; i++) {
+		zrtp_thread_routine_t routine = sched_loop;
+#if ZRTP_SCHED_WORKERS > 0
+		if (i > 0) {
+			routine = sched_worker;
+		}
+#endif
+		if (0 != zrtp_thread_create(routine, NULL)) {
 			break;
 		}
+		threads++;
+	}
+	sched_unlock();
 
-		inited  = 1;
-	} while (0);
+	if (i != 1+ZRTP_SCHED_WORKERS) {
+		sched_stop_threads();
+		sched_release();
+		return zrtp_status_fail;
+	}
 
-	return status;
+	inited  = 1;
+	return zrtp_status_ok;
 }
 
 /*---------------------------------------------------------------------------*/
 void zrtp_def_scheduler_down()
-{	
-	mlist_t *node = 0, *tmp = 0;
-	
+{
 	if (!inited) {
 		return;
 	}
 
-	/* Stop main thread */		
-	is_running = 0;	
-	zrtp_sem_post(count);
-#if (ZRTP_PLATFORM == ZP_WIN32) || (ZRTP_PLATFORM == ZP_WINCE)
-	if (NULL != scheduler_thread)
-	{
-		WaitForSingleObject(scheduler_thread, INFINITE);
-		CloseHandle(scheduler_thread);
-		scheduler_thread = NULL;
-	}
-#else
-	while (is_working) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-#endif
-	
-	/* Then destroy tasks queue and realease all other resources */
-	zrtp_mutex_lock(protector);
-
-	mlist_for_each_safe(node, tmp, &tasks_head) {
-		zrtp_sched_task_t* task = mlist_get_struct(zrtp_sched_task_t, _mlist, node);
-		zrtp_sys_free(task);
-	}
-	init_mlist(&tasks_head);
+	/* Stop all threads, then release task nodes and other resources */
+	sched_stop_threads();
+	sched_release();
 
-	zrtp_mutex_unlock(protector);
-	
-	zrtp_mutex_destroy(protector);
-	zrtp_sem_destroy(count);
-	
 	inited  = 0;
 }
 
 /*---------------------------------------------------------------------------*/
 void zrtp_def_scheduler_call_later(zrtp_stream_t *ctx, zrtp_retry_task_t* ztask)
-{	
-	mlist_t *node=0, *tmp=0;			
-	mlist_t* last = &tasks_head;
+{
+	zrtp_sched_task_t* task = NULL;
 
-	zrtp_mutex_lock(protector);
+	sched_lock();
 
 	if (!ztask->_is_enabled) {
-		zrtp_mutex_unlock(protector);
+		sched_unlock();
 		return;
 	}
 
-	do {
-		zrtp_sched_task_t* new_task = zrtp_sys_alloc(sizeof(zrtp_sched_task_t));
-		if (!new_task) {	
-			break;
-		}
+	/* Re-arming a pending task moves it instead of adding a duplicate */
+	task = (zrtp_sched_task_t*)ztask->_sched;
+	if (task) {
+		mlist_del(&task->_mlist);
+	} else {
+		task = sched_node_alloc();
+	}
 
-		new_task->ctx			= ctx;
-		new_task->ztask			= ztask;		
-		new_task->wake_at		= zrtp_time_now() + ztask->timeout;
-		
-		/* Try to find element with later wacked time than we have */
-		mlist_for_each_safe(node, tmp, &tasks_head) {
-			zrtp_sched_task_t* tmp_task = mlist_get_struct(zrtp_sched_task_t, _mlist, node);
-			if (tmp_task->wake_at >= new_task->wake_at) {
-				last = node;
-				break;
-			}
-		}
+	if (task) {
+		task->ctx		= ctx;
+		task->ztask		= ztask;
+		task->wake_at	= sched_now() + ztask->timeout;
+		ztask->_sched	= task;
 
-		/*
-		 * If packet wasn't inserted (empty queue or all elements are smaller)
-		 * Put them to the end of the queue.
-		 */
-		mlist_insert(last, &new_task->_mlist);		
+		sched_wheel_add(task);
 
-		zrtp_sem_post(count);
-	} while (0);
+		if (task->wake_at < sleep_until) {
+			sched_cond_signal(&wake_cond);
+		}
+	}
 
-	zrtp_mutex_unlock(protector);		
+	sched_unlock();
 }
 
 /*---------------------------------------------------------------------------*/
 void zrtp_def_scheduler_cancel_call_later(zrtp_stream_t* ctx, zrtp_retry_task_t* ztask)
 {
-	mlist_t *node=0, *tmp=0;
-
-	zrtp_mutex_lock(protector);
-
-	mlist_for_each_safe(node, tmp, &tasks_head) {
-		zrtp_sched_task_t* task = mlist_get_struct(zrtp_sched_task_t, _mlist, node);
-		if ((task->ctx == ctx) && ((task->ztask == ztask) || !ztask)) {
-			mlist_del(&task->_mlist);
-			zrtp_sys_free(task);
-			zrtp_sem_trtwait(count);
-			if (ztask) {
-				break;
-			}
-		}
+	sched_lock();
+
+	if (ztask) {
+		sched_unlink(ztask);
+	} else {
+		sched_unlink(&ctx->messages.hello_task);
+		sched_unlink(&ctx->messages.goclear_task);
+		sched_unlink(&ctx->messages.dh_task);
+		sched_unlink(&ctx->messages.commit_task);
+		sched_unlink(&ctx->messages.dhpart_task);
+		sched_unlink(&ctx->messages.confirm_task);
+		sched_unlink(&ctx->messages.error_task);
+		sched_unlink(&ctx->messages.errorack_task);
+		sched_unlink(&ctx->messages.sasrelay_task);
 	}
 
-	zrtp_mutex_unlock(protector);	
+	sched_unlock();
 }
 
 void zrtp_def_scheduler_wait_call_later(zrtp_stream_t* ctx)
 {
-	while (ctx->messages.hello_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.commit_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.dhpart_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.confirm_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.error_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.errorack_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
-	}
-	while (ctx->messages.goclear_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);	
-	}
-	while (ctx->messages.dh_task._is_busy) {
-		ZRTP_SCHED_SLEEP(1);
+	sched_lock();
+	while ( ctx->messages.hello_task._is_busy	||
+			ctx->messages.commit_task._is_busy	||
+			ctx->messages.dhpart_task._is_busy	||
+			ctx->messages.confirm_task._is_busy	||
+			ctx->messages.error_task._is_busy	||
+			ctx->messages.errorack_task._is_busy	||
+			ctx->messages.goclear_task._is_busy	||
+			ctx->messages.dh_task._is_busy		||
+			ctx->messages.sasrelay_task._is_busy ) {
+		sched_cond_wait(&idle_cond, ZRTP_SCHED_NEVER);
 	}
+	sched_unlock();
 }
 
 #endif /* not for windows kernel */
@@ -99,7 +99,7 @@ zrtp_status_t _zrtp_protocol_init(zrtp_stream_t *stream, uint8_t is_initiator, z
 		/* Create and Initialize DH crypto context	(for DH streams only) */
 		if (ZRTP_IS_STREAM_DH(stream)) {
 			if (stream->dh_cc.initialized_with != stream->pubkeyscheme->base.id) {				
-				stream->pubkeyscheme->initialize(stream->pubkeyscheme, &stream->dh_cc);
+				zrtp_pk_pool_take(stream->pubkeyscheme, &stream->dh_cc);
 				stream->dh_cc.initialized_with = stream->pubkeyscheme->base.id;
 			}
 		}
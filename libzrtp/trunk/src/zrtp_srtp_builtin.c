@@ -56,39 +56,135 @@
 /*===========================================================================*/
 
 
-/*! \brief Allocates and initializes replay protection context. Initialize
- * mutexes and linked lists.
+/*! \brief Initializes replay protection table with a given number of empty slots.
+ * \param table - table to initialize
+ * \param size - number of slots, power of two
+ * \return
+ * - zrtp_status_ok
+ * - zrtp_status_alloc_fail if error
+ */
+/*---------------------------------------------------------------------------*/
+static zrtp_status_t rp_table_init(zrtp_rp_table_t *table, uint32_t size)
+{
+	table->slots = zrtp_sys_alloc(size * sizeof(zrtp_rp_node_t*));
+	if(NULL == table->slots){
+		return zrtp_status_alloc_fail;
+	}
+	zrtp_memset(table->slots, 0, size * sizeof(zrtp_rp_node_t*));
+	table->size = size;
+	table->count = 0;
+	table->last = NULL;
+	return zrtp_status_ok;
+}
+
+/*! \brief Frees all replay protection nodes of the table and its slots. */
+/*---------------------------------------------------------------------------*/
+static void rp_table_down(zrtp_rp_table_t *table)
+{
+	uint32_t i;
+	if(NULL == table->slots){
+		return;
+	}
+	for(i=0; i<table->size; i++){
+		if(NULL != table->slots[i]){
+			zrtp_sys_free(table->slots[i]);
+		}
+	}
+	zrtp_sys_free(table->slots);
+	table->slots = NULL;
+	table->count = 0;
+	table->last = NULL;
+}
+
+/*! \brief Returns the first slot to probe for the ssrc: multiplicative hash, since SSRC values
+ * are random but tests and some endpoints use sequential ones.
+ */
+static uint32_t rp_table_hash(zrtp_rp_table_t *table, uint32_t ssrc)
+{
+	return (ssrc * 0x9E3779B1) & (table->size - 1);
+}
+
+/*! \brief Finds the slot holding the node with given ssrc or the empty slot where it belongs. */
+static uint32_t rp_table_probe(zrtp_rp_table_t *table, uint32_t ssrc)
+{
+	uint32_t i = rp_table_hash(table, ssrc);
+	while((NULL != table->slots[i]) && (ssrc != table->slots[i]->ssrc)){
+		i = (i + 1) & (table->size - 1);
+	}
+	return i;
+}
+
+/*! \brief Doubles the number of slots of the table, nodes stay where they are in memory.
+ * \return
+ * - zrtp_status_ok
+ * - zrtp_status_alloc_fail if error, the table is left untouched
+ */
+/*---------------------------------------------------------------------------*/
+static zrtp_status_t rp_table_grow(zrtp_rp_table_t *table)
+{
+	zrtp_rp_table_t grown;
+	uint32_t i;
+
+	if(zrtp_status_ok != rp_table_init(&grown, table->size * 2)){
+		return zrtp_status_alloc_fail;
+	}
+	for(i=0; i<table->size; i++){
+		if(NULL != table->slots[i]){
+			grown.slots[rp_table_probe(&grown, table->slots[i]->ssrc)] = table->slots[i];
+		}
+	}
+	grown.count = table->count;
+	grown.last = table->last;
+
+	zrtp_sys_free(table->slots);
+	*table = grown;
+	return zrtp_status_ok;
+}
+
+/*! \brief Returns the table for the given direction or NULL if the direction is unknown. */
+static zrtp_rp_table_t *rp_get_table(zrtp_rp_ctx_t *ctx, uint8_t direction)
+{
+	switch(direction){
+	case RP_INCOMING_DIRECTION:
+		return &ctx->inc;
+	case RP_OUTGOING_DIRECTION:
+		return &ctx->out;
+	default:
+		return NULL;
+	};
+}
+
+
+/*! \brief Allocates and initializes replay protection context with two empty tables.
+ * \param size - initial number of slots in each table, power of two
  * \return
  * - allocated replay protection context
  * - NULL if error
  */
 /*---------------------------------------------------------------------------*/
-zrtp_rp_ctx_t* rp_init()
+zrtp_rp_ctx_t* rp_init(uint32_t size)
 {
 	zrtp_rp_ctx_t *ctx = zrtp_sys_alloc(sizeof(zrtp_rp_ctx_t));
 	if(NULL == ctx){
 		return NULL;
 	}
 
-	if(zrtp_status_ok != zrtp_mutex_init(&ctx->inc_sync)){
+	if(zrtp_status_ok != rp_table_init(&ctx->inc, size)){
 		zrtp_sys_free(ctx);
 		return NULL;
 	}
 
-	if(zrtp_status_ok != zrtp_mutex_init(&ctx->out_sync)){
-		zrtp_mutex_destroy(ctx->inc_sync);
+	if(zrtp_status_ok != rp_table_init(&ctx->out, size)){
+		rp_table_down(&ctx->inc);
 		zrtp_sys_free(ctx);
 		return NULL;
 	}
 
-	init_mlist(&ctx->inc_head.mlist);
-	init_mlist(&ctx->out_head.mlist);
-
 	return ctx;
 }
 
 
-/*! \brief Deinitializes and deallocates replay protection context.
+/*! \brief Deinitializes and deallocates replay protection context with all its nodes.
  *	\param ctx - replay protection context
  *	\return
  *	- zrtp_status_ok
@@ -96,240 +192,107 @@ zrtp_rp_ctx_t* rp_init()
 /*---------------------------------------------------------------------------*/
 zrtp_status_t rp_destroy(zrtp_rp_ctx_t *ctx)
 {
-	mlist_t *pos, *n;
-	zrtp_rp_node_t *node = NULL;
-
-	/*free all existing replay protection nodes in the incoming list*/
-	zrtp_mutex_lock(ctx->inc_sync);
-	mlist_for_each_safe(pos, n, &ctx->inc_head.mlist){
-		node = mlist_get_struct(zrtp_rp_node_t, mlist, pos);
-		mlist_del(&node->mlist);
-		zrtp_sys_free(node);
-	}
-	zrtp_mutex_unlock(ctx->inc_sync);
-
-	zrtp_mutex_destroy(ctx->inc_sync);
-
-	/*free all existing replay protection nodes in the outgoing list*/
-	zrtp_mutex_lock(ctx->out_sync);
-	mlist_for_each_safe(pos, n, &ctx->out_head.mlist){
-		node = mlist_get_struct(zrtp_rp_node_t, mlist, pos);
-		mlist_del(&node->mlist);
-		zrtp_sys_free(node);
-	}
-	zrtp_mutex_unlock(ctx->out_sync);
-
-	zrtp_mutex_destroy(ctx->out_sync);
-
+	rp_table_down(&ctx->inc);
+	rp_table_down(&ctx->out);
 	zrtp_sys_free(ctx);
 	return zrtp_status_ok;
 }
 
 
-/*! \brief Finds replay protection node by given ssrc. Which linked list to search is
- * determined by the direction param.
- * \warning This function doesn't lock the linked list before search and is for internal usage.
- * To find necessary replay protection node use get_rp_node() function.
+/*! \brief Finds replay protection node by given ssrc. Which table to search is
+ * determined by the direction param. The node found last is checked first, so a session with
+ * a single SSRC in each direction never hashes.
  * \param ctx - pointer to replay protection context
- * \param direction - defines what list to search. It may have values:
+ * \param direction - defines what table to search. It may have values:
  * - RP_INCOMING_DIRECTION
  * - RP_OUTGOING_DIRECTION
+ * \param ssrc - value by which search will be made
  * \return
  * - pointer to found replay protection node
  * - NULL if node hasn't been found or if error
  */
 /*---------------------------------------------------------------------------*/
-zrtp_rp_node_t *get_rp_node_non_lock( zrtp_rp_ctx_t *ctx,
-									  uint8_t direction,
-									  uint32_t ssrc)
+zrtp_rp_node_t *get_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc)
 {
+	zrtp_rp_table_t *table = rp_get_table(ctx, direction);
 	zrtp_rp_node_t *node = NULL;
-	mlist_t *pos;
-	mlist_t *head = NULL;
 
-	switch(direction){
-	case RP_INCOMING_DIRECTION:
-		head = &ctx->inc_head.mlist;
-		break;
-	case RP_OUTGOING_DIRECTION:
-		head = &ctx->out_head.mlist;
-		break;
-	default:
-		head = NULL;
-		break;
-	};
+	if(NULL == table){
+		return NULL;
+	}
 
-	if(NULL != head){
-		mlist_for_each(pos, head){
-			node = mlist_get_struct(zrtp_rp_node_t, mlist, pos);
-			if(ssrc == node->ssrc){
-				break;
-			}else{
-				node = NULL;
-			}
-		}
+	if((NULL != table->last) && (ssrc == table->last->ssrc)){
+		return table->last;
 	}
 
+	node = table->slots[rp_table_probe(table, ssrc)];
+	if(NULL != node){
+		table->last = node;
+	}
 	return node;
 }
 
 
-///*! \brief Finds replay protection node by given ssrc. Linked list to search is
-// *  determined by direction param.  This function locks the linked list to
-// *  ensure exclusive access.
-// *
-// * \param ctx - pointer to replay protection context
-// * \param direction - defines what list to search. It may have values:
-// * - RP_INCOMING_DIRECTION
-// * - RP_OUTGOING_DIRECTION
-// * \param ssrc - value by which search will be made
-// * \return
-// * - pointer to found replay protection node
-// * - NULL if node hasn't been found or if error
-// */
-///*---------------------------------------------------------------------------*/
-//zrtp_rp_node_t *get_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc)
-//{
-//	zrtp_rp_node_t *node = NULL;
-//	zrtp_mutex_t *sync = NULL;
-//
-//	switch(direction){
-//	case RP_INCOMING_DIRECTION:
-//		sync = ctx->inc_sync;
-//		break;
-//	case RP_OUTGOING_DIRECTION:
-//		sync = ctx->out_sync;
-//		break;
-//	default:
-//		sync = NULL;
-//		break;
-//	};
-//
-//	if(NULL != sync){
-//		zrtp_mutex_lock(sync);
-//		node = get_rp_node_non_lock(ctx, direction, ssrc);
-//		zrtp_mutex_unlock(sync);
-//	}
-//
-//	return node;
-//}
-
-/*! \brief Allocates new replay protection node for given direction and ssrc and adds it into
- * appropriate linked list.
- * \warning This function is for internal usage. Use add_rp_node() and add_rp_node_unique().
- * \param srtp_ctx - pointer to SRTP ctx related with created node. Used for removing node on SRTP session destruction.
+/*! \brief Returns replay protection node for given direction and ssrc. Allocates the new one
+ * and adds it into appropriate table if the node doesn't exist yet.
  * \param ctx - pointer to replay protection context
- * \param direction - defines in which list newly created node will be inserted. It may have values:
+ * \param direction - defines in which table newly created node will be inserted. It may have values:
  * - RP_INCOMING_DIRECTION
  * - RP_OUTGOING_DIRECTION
  * \param ssrc - newly created replay protection node key value.
- * \param is_unique - defines what should be returned when replay protection node
- * with given direction and ssrc values already exists:
- * - pointer to existing node if is_unique == 0
- * - NULL if is_unique == 1
  * \return
  * - pointer to newly created replay protection node
  * - pointer to existing replay protection node
- * - NULL if is_unique == 1 and needed replay protection node already exists or if error
+ * - NULL if error
  */
 /*---------------------------------------------------------------------------*/
-zrtp_rp_node_t *add_rp_node_ex( zrtp_srtp_ctx_t *srtp_ctx,
-								zrtp_rp_ctx_t *ctx,
-							    uint8_t direction,
-								uint32_t ssrc,
-								uint8_t is_unique)
+zrtp_rp_node_t *add_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc)
 {
+	zrtp_rp_table_t *table = rp_get_table(ctx, direction);
 	zrtp_rp_node_t *node = NULL;
-	zrtp_mutex_t *sync = NULL;
-	mlist_t *head = NULL;
+	uint32_t i;
 
-	switch(direction){
-	case RP_INCOMING_DIRECTION:
-		sync = ctx->inc_sync;
-		head = &ctx->inc_head.mlist;
-		break;
-	case RP_OUTGOING_DIRECTION:
-		sync = ctx->out_sync;
-		head = &ctx->out_head.mlist;
-		break;
-	default:
-		sync = NULL;
-		head = NULL;
-		break;
-	};
+	if(NULL == table){
+		return NULL;
+	}
 
-	if(NULL != sync && NULL != head){
-		zrtp_mutex_lock(sync);
-		do{
-			node = get_rp_node_non_lock(ctx, direction, ssrc);
-
-			/*create new node if not found*/
-			if(NULL == node){
-				node = zrtp_sys_alloc(sizeof(zrtp_rp_node_t));
-				if(NULL == node){
-					break;
-				}
-				/*clean sliding window and on-top sequence number value*/
-				zrtp_memset(node, 0, sizeof(zrtp_rp_node_t));
-				node->ssrc = ssrc;
-				node->srtp_ctx = srtp_ctx;
-				mlist_add_tail(head, &node->mlist);
-#if ZRTP_DEBUG_SRTP_KEYS				
-				ZRTP_LOG(3,(_ZTU_,"\tadd %s rp node. ssrc[%u] srtp_ctx[0x%08x]", 
-							direction==RP_INCOMING_DIRECTION?"incoming":"outgoing\n",
-							zrtp_ntoh32(node->ssrc), node->srtp_ctx));
-#endif
-			}else if(is_unique){
-				// ???: why do we need unique mode at all?
-				node = NULL;
-			}
+	node = get_rp_node(ctx, direction, ssrc);
+	if(NULL != node){
+		return node;
+	}
 
-		}while(0);
-		zrtp_mutex_unlock(sync);
+	/* keep at least a half of the slots empty to keep probe sequences short */
+	if(2*(table->count + 1) > table->size){
+		if(zrtp_status_ok != rp_table_grow(table)){
+			return NULL;
+		}
+	}
+
+	node = zrtp_sys_alloc(sizeof(zrtp_rp_node_t));
+	if(NULL == node){
+		return NULL;
 	}
+	/*clean sliding window and on-top sequence number value*/
+	zrtp_memset(node, 0, sizeof(zrtp_rp_node_t));
+	node->ssrc = ssrc;
+
+	i = rp_table_probe(table, ssrc);
+	table->slots[i] = node;
+	table->count++;
+	table->last = node;
+#if ZRTP_DEBUG_SRTP_KEYS
+	ZRTP_LOG(3,(_ZTU_,"\tadd %s rp node. ssrc[%u] ctx[0x%08x]\n",
+				direction==RP_INCOMING_DIRECTION?"incoming":"outgoing",
+				zrtp_ntoh32(node->ssrc), ctx));
+#endif
 
 	return node;
 }
 
-/*! \brief Allocates new replay protection node for given direction and ssrc and adds it into
- * appropriate linked list. This function is based on add_rp_node_ex().
- * \param srtp_ctx - pointer to SRTP ctx related with created node. Used for removing node on SRTP session destruction.
- * \param ctx - pointer to replay protection context
- * \param direction - defines in which list newly created node will be inserted. It may have values:
- * - RP_INCOMING_DIRECTION
- * - RP_OUTGOING_DIRECTION
- * \param ssrc - newly created replay protection node key value.
- * \return
- * - pointer to newly created replay protection node
- * - pointer to existing replay protection node
- * - NULL if error
- */
-zrtp_rp_node_t *add_rp_node(zrtp_srtp_ctx_t *srtp_ctx, zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc){
-	/*not-unique mode*/	
-	// ???: why do we need unique mode at all?
-	return add_rp_node_ex(srtp_ctx, ctx, direction, ssrc, 0);
-}
 
-///*! \brief Allocates new replay protection node for given direction and ssrc and adds it into
-// * appropriate linked list. This function is based on add_rp_node_ex().
-// * \param srtp_ctx - pointer to SRTP ctx related with created node. Used for removing node on SRTP session destruction.
-// * \param ctx - pointer to replay protection context
-// * \param direction - defines in which list newly created node will be inserted. It may have values:
-// * - RP_INCOMING_DIRECTION
-// * - RP_OUTGOING_DIRECTION
-// * \param ssrc - newly created replay protection node key value.
-// * \return
-// * - pointer to newly created replay protection node
-// * - NULL if error or if needed node already exists
-// */
-//zrtp_rp_node_t *add_rp_node_unique(zrtp_srtp_ctx_t *srtp_ctx, zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc){
-//	/*unique mode*/
-//	return add_rp_node_ex(srtp_ctx, ctx, direction, ssrc, 1);
-//}
-
-/*! \brief Removes replay protection node with given ssrc from linked list defined by direction value.
+/*! \brief Removes replay protection node with given ssrc from the table defined by direction value.
  * \param ctx - pointer to replay protection context
- * \param direction - defines from which list replay protection node will be removed. It may have values:
+ * \param direction - defines from which table replay protection node will be removed. It may have values:
  * - RP_INCOMING_DIRECTION
  * - RP_OUTGOING_DIRECTION
  * \param ssrc - key value of replay protection node to remove
@@ -338,78 +301,44 @@ zrtp_rp_node_t *add_rp_node(zrtp_srtp_ctx_t *srtp_ctx, zrtp_rp_ctx_t *ctx, uint8
  * - zrtp_status_fail if node hasn't been found
  */
 /*---------------------------------------------------------------------------*/
-zrtp_status_t remove_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc){
-	zrtp_rp_node_t *node = NULL;
-	zrtp_mutex_t *sync = NULL;
-	zrtp_status_t res = zrtp_status_fail;
-
-	switch(direction){
-	case RP_INCOMING_DIRECTION:
-		sync = ctx->inc_sync;
-		break;
-	case RP_OUTGOING_DIRECTION:
-		sync = ctx->out_sync;
-		break;
-	default:
-		sync = NULL;
-		break;
-	};
+zrtp_status_t remove_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc)
+{
+	zrtp_rp_table_t *table = rp_get_table(ctx, direction);
+	uint32_t i, j, home;
 
-	if(NULL != sync){
-		zrtp_mutex_lock(sync);
-		node = get_rp_node_non_lock(ctx, direction, ssrc);
-		if(NULL != node){
-			mlist_del(&node->mlist);
-			zrtp_sys_free(node);
-			res = zrtp_status_ok;
-		}
-		zrtp_mutex_unlock(sync);
+	if(NULL == table){
+		return zrtp_status_fail;
 	}
 
-	return res;
-}
-
-
-zrtp_status_t remove_rp_nodes_by_srtp_ctx(zrtp_srtp_ctx_t *srtp_ctx, zrtp_rp_ctx_t *ctx){
-	zrtp_status_t res = zrtp_status_ok;
-	zrtp_rp_node_t *node = NULL;
-	mlist_t *pos, *n;
-
-	if((NULL == srtp_ctx) || (NULL == ctx)){
-		return zrtp_status_bad_param;
+	i = rp_table_probe(table, ssrc);
+	if(NULL == table->slots[i]){
+		return zrtp_status_fail;
 	}
 
-	/* Walk over incoming nodes list */
-	zrtp_mutex_lock(ctx->inc_sync);
-	mlist_for_each_safe(pos, n, &ctx->inc_head.mlist){
-		node = mlist_get_struct(zrtp_rp_node_t, mlist, pos);
-		if((NULL != node->srtp_ctx) && (node->srtp_ctx == srtp_ctx)){
-#if ZRTP_DEBUG_SRTP_KEYS
-			ZRTP_LOG(3,(_ZTU_,"\tremove incoming rp node. ssrc[%u] srtp_ctx[0x%08x]\n",
-						zrtp_ntoh32(node->ssrc), node->srtp_ctx));
-#endif
-			mlist_del(&node->mlist);
-			zrtp_sys_free(node);
-		}
+	if(table->last == table->slots[i]){
+		table->last = NULL;
 	}
-	zrtp_mutex_unlock(ctx->inc_sync);
-
-	/* Walk over outgoing nodes list */
-	zrtp_mutex_lock(ctx->out_sync);
-	mlist_for_each_safe(pos, n, &ctx->out_head.mlist){
-		node = mlist_get_struct(zrtp_rp_node_t, mlist, pos);
-		if((NULL != node->srtp_ctx) && (node->srtp_ctx == srtp_ctx)){
-#if ZRTP_DEBUG_SRTP_KEYS
-			ZRTP_LOG(3,(_ZTU_,"\tremove outgoing rp node. ssrc[%u] srtp_ctx[0x%08x]\n",
-						zrtp_ntoh32(node->ssrc), node->srtp_ctx));
-#endif
-			mlist_del(&node->mlist);
-			zrtp_sys_free(node);
+	zrtp_sys_free(table->slots[i]);
+	table->slots[i] = NULL;
+	table->count--;
+
+	/* Shift the rest of the probe sequence back so lookups don't stop at the hole */
+	j = i;
+	for(;;){
+		j = (j + 1) & (table->size - 1);
+		if(NULL == table->slots[j]){
+			break;
+		}
+		home = rp_table_hash(table, table->slots[j]->ssrc);
+		/* move the node unless its home slot lies cyclically within (i, j] */
+		if(((j - home) & (table->size - 1)) >= ((j - i) & (table->size - 1))){
+			table->slots[i] = table->slots[j];
+			table->slots[j] = NULL;
+			i = j;
 		}
 	}
-	zrtp_mutex_unlock(ctx->out_sync);
 
-	return res;
+	return zrtp_status_ok;
 }
 
 
@@ -612,13 +541,14 @@ void zrtp_dk_deinit(zrtp_dk_ctx *ctx)
 }
 
 
-/*! \brief This function allocates SRTP session and two stream contexts.
+/*! \brief This function allocates SRTP session, two stream contexts and replay protection data.
+ * \param srtp_global - pointer to SRTP engine global context
  * \return
  * - pointer to allocated SRTP session structure
  * - NULL if error
  */
 /*---------------------------------------------------------------------------*/
-zrtp_srtp_ctx_t * zrtp_srtp_alloc()
+zrtp_srtp_ctx_t * zrtp_srtp_alloc(zrtp_srtp_global_t *srtp_global)
 {
 	zrtp_srtp_ctx_t *srtp_ctx = NULL;
 
@@ -645,6 +575,16 @@ zrtp_srtp_ctx_t * zrtp_srtp_alloc()
 			break;
 		}
 
+		srtp_ctx->rp_ctx = rp_init(srtp_global->rp_table_size);
+		if(NULL == srtp_ctx->rp_ctx){
+			/*deallocate everything previously allocated on failure*/
+			zrtp_sys_free(srtp_ctx->outgoing_srtp);
+			zrtp_sys_free(srtp_ctx->incoming_srtp);
+			zrtp_sys_free(srtp_ctx);
+			srtp_ctx = NULL;
+			break;
+		}
+
 	}while(0);
 
 	return srtp_ctx;
@@ -661,6 +601,8 @@ void zrtp_srtp_free(zrtp_srtp_ctx_t * srtp_ctx)
 			zrtp_sys_free(srtp_ctx->incoming_srtp);
 		if (srtp_ctx->outgoing_srtp)
 			zrtp_sys_free(srtp_ctx->outgoing_srtp);
+		if (srtp_ctx->rp_ctx)
+			rp_destroy(srtp_ctx->rp_ctx);
 		zrtp_sys_free(srtp_ctx);
 	}
 }
@@ -898,11 +840,7 @@ zrtp_status_t zrtp_srtp_init(zrtp_global_t *zrtp){
 	if(NULL == srtp_global){
 		return zrtp_status_fail;
 	}
-	srtp_global->rp_ctx = rp_init();
-	if(NULL == srtp_global->rp_ctx){
-		zrtp_sys_free(srtp_global);
-		return zrtp_status_fail;
-	}
+	srtp_global->rp_table_size = ZRTP_SRTP_RP_TABLE_SIZE;
 
 	zrtp->srtp_global = srtp_global;
 
@@ -912,7 +850,6 @@ zrtp_status_t zrtp_srtp_init(zrtp_global_t *zrtp){
 zrtp_status_t zrtp_srtp_down(zrtp_global_t *zrtp){
 	zrtp_srtp_global_t *srtp_global = zrtp->srtp_global;
 
-	rp_destroy(srtp_global->rp_ctx);
 	zrtp_sys_free(srtp_global);
 	zrtp->srtp_global = NULL;
 	return zrtp_status_ok;
@@ -928,7 +865,7 @@ zrtp_srtp_ctx_t * zrtp_srtp_create(	zrtp_srtp_global_t *srtp_global,
 	}
 
 	do{
-		srtp_ctx = zrtp_srtp_alloc();
+		srtp_ctx = zrtp_srtp_alloc(srtp_global);
 		if(NULL == srtp_ctx){
 			break;
 		}
@@ -947,8 +884,6 @@ zrtp_srtp_ctx_t * zrtp_srtp_create(	zrtp_srtp_global_t *srtp_global,
 zrtp_status_t zrtp_srtp_destroy(zrtp_srtp_global_t *srtp_global, zrtp_srtp_ctx_t * srtp_ctx){
 	zrtp_status_t res = zrtp_status_ok;
 
-	remove_rp_nodes_by_srtp_ctx(srtp_ctx, srtp_global->rp_ctx);
-
 	zrtp_srtp_stream_deinit(srtp_global, srtp_ctx->incoming_srtp);
 	zrtp_srtp_stream_deinit(srtp_global, srtp_ctx->outgoing_srtp);
 	zrtp_srtp_free(srtp_ctx);
@@ -978,7 +913,7 @@ zrtp_status_t zrtp_srtp_protect(	zrtp_srtp_global_t *srtp_global,
 	void *hash_ctx = NULL;
 
 	/* add new replay protection node or get existing one */
-	rp_node = add_rp_node(srtp_ctx, srtp_global->rp_ctx, RP_OUTGOING_DIRECTION, packet->ssrc);
+	rp_node = add_rp_node(srtp_ctx->rp_ctx, RP_OUTGOING_DIRECTION, packet->ssrc);
 	if(NULL == rp_node){
 		return zrtp_status_rp_fail;
 	}
@@ -1109,7 +1044,7 @@ zrtp_status_t zrtp_srtp_unprotect(	zrtp_srtp_global_t *srtp_global,
 	int tag_len = 0;
 
 	/*add new replay protection node or get existing one*/
-	rp_node = add_rp_node(srtp_ctx, srtp_global->rp_ctx, RP_INCOMING_DIRECTION, packet->ssrc);
+	rp_node = add_rp_node(srtp_ctx->rp_ctx, RP_INCOMING_DIRECTION, packet->ssrc);
 	if(NULL == rp_node){
 		return zrtp_status_rp_fail;
 	}
@@ -1259,7 +1194,7 @@ zrtp_status_t zrtp_srtp_protect_rtcp(	zrtp_srtp_global_t *srtp_global,
 	zrtp_string64_t	auth_tag_str = ZSTR_INIT_EMPTY(auth_tag_str);
 
 	/*add new replay protection node or get existing one*/
-	rp_node = add_rp_node(srtp_ctx, srtp_global->rp_ctx, RP_OUTGOING_DIRECTION, packet->ssrc);
+	rp_node = add_rp_node(srtp_ctx->rp_ctx, RP_OUTGOING_DIRECTION, packet->ssrc);
 	if(NULL == rp_node){
 		return zrtp_status_rp_fail;
 	}
@@ -1373,7 +1308,7 @@ zrtp_status_t zrtp_srtp_unprotect_rtcp(	zrtp_srtp_global_t *srtp_global,
 	zrtp_v128_t iv;
 
 	/* add new replay protection node or get existing one */
-	rp_node = add_rp_node(srtp_ctx, srtp_global->rp_ctx, RP_INCOMING_DIRECTION, packet->ssrc);
+	rp_node = add_rp_node(srtp_ctx->rp_ctx, RP_INCOMING_DIRECTION, packet->ssrc);
 	if(NULL == rp_node){
 		return zrtp_status_rp_fail;
 	}
@@ -0,0 +1,137 @@
+/*
+ * libZRTP SDK library, implements the ZRTP secure VoIP protocol.
+ * Copyright (c) 2006-2009 Philip R. Zimmermann.  All rights reserved.
+ * Contact: http://philzimmermann.com
+ * For licensing and other legal details, see the file zrtp_legal.c.
+ *
+ * Viktor Krykun <v.krikun at zfoneproject.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zrtp.h"
+
+/*
+ * File cache benchmark: measures cache load, lookup and flush latency for caches of different
+ * sizes. Run with an optional path to the cache file to be used.
+ */
+
+#define BENCH_CACHE_PATH	"/tmp/zrtp_cache_bench.dat"
+#define BENCH_LOOKUPS		100000
+#define BENCH_FLUSHES		1000
+
+static zrtp_string16_t zid_my = ZSTR_INIT_WITH_CONST_CSTRING("000000000_00");
+
+static void make_zid(zrtp_string16_t* zid, uint32_t i)
+{
+	zrtp_memset(zid->buffer, 0, sizeof(zid->buffer));
+	zid->length = sizeof(zrtp_zid_t);
+	zid->max_length = sizeof(zid->buffer) - 1;
+	zrtp_memcpy(zid->buffer, "peer", 4);
+	zid->buffer[4] = (char)(i >> 24);
+	zid->buffer[5] = (char)(i >> 16);
+	zid->buffer[6] = (char)(i >> 8);
+	zid->buffer[7] = (char)i;
+}
+
+static void make_secret(zrtp_shared_secret_t* rs, uint32_t i)
+{
+	zrtp_memset(rs, 0, sizeof(*rs));
+	rs->value.length = ZRTP_HASH_SIZE;
+	rs->value.max_length = sizeof(rs->value.buffer) - 1;
+	zrtp_memset(rs->value.buffer, (char)i, ZRTP_HASH_SIZE);
+	rs->lastused_at = (uint32_t)(zrtp_time_now()/1000);
+	rs->ttl = 3600;
+}
+
+static zrtp_cache_t* open_cache(const char* path, unsigned auto_store)
+{
+	zrtp_cache_file_config_t config;
+	zrtp_cache_file_t* cache = NULL;
+
+	zrtp_memset(&config, 0, sizeof(config));
+	strcpy(config.cache_path, path);
+	config.cache_auto_store = auto_store;
+
+	if (zrtp_status_ok != zrtp_cache_file_create(ZSTR_GV(zid_my), &config, &cache)) {
+		return NULL;
+	}
+	return (zrtp_cache_t*)cache;
+}
+
+static int bench(const char* path, uint32_t count)
+{
+	zrtp_cache_t* cache = NULL;
+	zrtp_string16_t zid;
+	zrtp_shared_secret_t rs;
+	zrtp_time_t start, load_time, lookup_time, flush_time;
+	uint32_t i = 0;
+
+	remove(path);
+
+	/* Populate and store the cache in one go */
+	if (!(cache = open_cache(path, 0))) {
+		return -1;
+	}
+	for (i=0; i<count; i++) {
+		make_zid(&zid, i);
+		make_secret(&rs, i);
+		cache->op.put(cache, ZSTR_GV(zid), &rs);
+	}
+	zrtp_cache_file_destroy((zrtp_cache_file_t*)cache);
+
+	start = zrtp_time_now();
+	if (!(cache = open_cache(path, 1))) {
+		return -1;
+	}
+	load_time = zrtp_time_now() - start;
+
+	start = zrtp_time_now();
+	for (i=0; i<BENCH_LOOKUPS; i++) {
+		make_zid(&zid, (i * 7919) % count);
+		if (zrtp_status_ok != cache->op.get(cache, ZSTR_GV(zid), &rs, 0)) {
+			printf("lookup of entry %u failed\n", (i * 7919) % count);
+			return -1;
+		}
+	}
+	lookup_time = zrtp_time_now() - start;
+
+	/* Every put flushes the cache with auto-store enabled */
+	start = zrtp_time_now();
+	for (i=0; i<BENCH_FLUSHES; i++) {
+		make_zid(&zid, (i * 7919) % count);
+		make_secret(&rs, i + 1);
+		cache->op.put(cache, ZSTR_GV(zid), &rs);
+	}
+	flush_time = zrtp_time_now() - start;
+
+	zrtp_cache_file_destroy((zrtp_cache_file_t*)cache);
+
+	printf("%8u %12u %14.3f %14.3f\n", count, (uint32_t)load_time,
+		   (double)lookup_time * 1000.0 / BENCH_LOOKUPS,
+		   (double)flush_time * 1000.0 / BENCH_FLUSHES);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char* path = (argc > 1) ? argv[1] : BENCH_CACHE_PATH;
+	uint32_t sizes[] = {1000, 10000, 100000};
+	uint32_t i = 0;
+
+	/* Cache operations log every call, keep the output readable */
+	zrtp_log_set_log_engine(NULL);
+
+	printf("%8s %12s %14s %14s\n", "entries", "load, ms", "lookup, us", "flush, us");
+	for (i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+		if (0 != bench(path, sizes[i])) {
+			printf("ERROR! benchmark failed for %u entries\n", sizes[i]);
+			return 1;
+		}
+	}
+
+	remove(path);
+	return 0;
+}
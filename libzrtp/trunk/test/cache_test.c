@@ -403,6 +403,61 @@ void cache_name_test() {
     assert_false(zrtp_zstrcmp(ZSTR_GV(rs_my4mitm2_r.value), ZSTR_GV(rs_my4mitm2.value)));
 }
 
+/*
+ * File cache only: hammer one entry with auto-flushed updates until the log gets compacted. The
+ * last values must survive reopening and the file must stay close to the live data size.
+ */
+void cache_log_compaction_test() {
+    zrtp_status_t status;
+    zrtp_shared_secret_t rs_last;
+    FILE *f = NULL;
+    long file_size = 0;
+    unsigned i;
+
+    if (sqliteTest)
+        return;
+
+    status = zrtp_cache_file_destroy((zrtp_cache_file_t *)g_cache);
+    assert_int_equal(zrtp_status_ok, status);
+
+    g_file_config.cache_auto_store = 1;
+    status = zrtp_cache_file_create(ZSTR_GV(zid_my), &g_file_config, (zrtp_cache_file_t **)&g_cache);
+    g_file_config.cache_auto_store = g_cache_auto_store;
+    assert_int_equal(zrtp_status_ok, status);
+
+    for (i=0; i<2000; i++) {
+        init_rs_secret_(&rs_last, 'A' + i%26);
+        status = zrtp_cache_put(g_cache, ZSTR_GV(zid_a), &rs_last);
+        assert_int_equal(status, zrtp_status_ok);
+    }
+
+    status = zrtp_cache_file_destroy((zrtp_cache_file_t *)g_cache);
+    assert_int_equal(zrtp_status_ok, status);
+
+    f = fopen(TEST_CACHE_PATH, "rb");
+    assert_non_null(f);
+    fseek(f, 0, SEEK_END);
+    file_size = ftell(f);
+    fclose(f);
+    printf("==> Cache file size after 2000 updates: %ld bytes.\n", file_size);
+    assert_true(file_size < 256*1024);
+
+    status = zrtp_cache_file_create(ZSTR_GV(zid_my), &g_file_config, (zrtp_cache_file_t **)&g_cache);
+    assert_int_equal(zrtp_status_ok, status);
+
+    status = zrtp_cache_get(g_cache, ZSTR_GV(zid_a), &rs_my4a_r, 0);
+    assert_int_equal(status, zrtp_status_ok);
+    assert_false(zrtp_zstrcmp(ZSTR_GV(rs_my4a_r.value), ZSTR_GV(rs_last.value)));
+
+    status = zrtp_cache_get(g_cache, ZSTR_GV(zid_b), &rs_my4b_r, 0);
+    assert_int_equal(status, zrtp_status_ok);
+    assert_false(zrtp_zstrcmp(ZSTR_GV(rs_my4b_r.value), ZSTR_GV(rs_my4b.value)));
+
+    status = zrtp_cache_get_mitm(g_cache, ZSTR_GV(zid_mitm2), &rs_my4mitm2_r);
+    assert_int_equal(status, zrtp_status_ok);
+    assert_false(zrtp_zstrcmp(ZSTR_GV(rs_my4mitm2_r.value), ZSTR_GV(rs_my4mitm2.value)));
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -426,6 +481,7 @@ int main(int argc, char *argv[])
         unit_test_setup_teardown(cache_add2empty_test, cache_setup_file, cache_teardown_file),
         unit_test_setup_teardown(cache_save_unchanged_test, cache_setup_file, cache_teardown_file),
         unit_test_setup_teardown(cache_modify_and_save_test, cache_setup_file, cache_teardown_file),
+        unit_test_setup_teardown(cache_log_compaction_test, cache_setup_file, cache_teardown_file),
     };
 
     return run_tests(tests);
@@ -0,0 +1,163 @@
+/*
+ * libZRTP SDK library, implements the ZRTP secure VoIP protocol.
+ * Copyright (c) 2006-2009 Philip R. Zimmermann.  All rights reserved.
+ * Contact: http://philzimmermann.com
+ * For licensing and other legal details, see the file zrtp_legal.c.
+ *
+ * Viktor Krykun <v.krikun at zfoneproject.com>
+ */
+
+#include "engine_helpers.c"
+
+/*
+ * Key pairs pool benchmark: measures how long a stream waits for its key pair with and without the
+ * pool, then the time from the channel start to the SECURE state for a series of DH3k handshakes
+ * with and without pre-computed key pairs along with the pool counters.
+ */
+
+#define BENCH_HANDSHAKES		10
+#define BENCH_SECURE_TIMEOUT	10000
+#define BENCH_REFILL_PAUSE		1000
+#define BENCH_TAKES				10
+#define BENCH_CACHE_PATH		"./pk_pool_bench_cache.dat"
+
+static zrtp_global_t* endpoint_zrtp(zrtp_test_id_t session_id) {
+	zrtp_test_id_t stream_id = zrtp_test_session_get_stream_by_idx(session_id, 0);
+	return zrtp_stream_for_test_stream(stream_id)->zrtp;
+}
+
+static int bench_take() {
+	uint8_t schemes[] = {ZRTP_PKTYPE_EC256P, ZRTP_PKTYPE_DH2048, ZRTP_PKTYPE_DH3072, 0};
+	zrtp_config_t config;
+	zrtp_global_t* zrtp = NULL;
+	zrtp_pk_scheme_t* scheme;
+	zrtp_dh_crypto_context_t dh_cc;
+	zrtp_time_t start, inline_time, pooled_time;
+	unsigned i, j;
+
+	zrtp_config_defaults(&config);
+	config.cache_type = ZRTP_CACHE_FILE;
+	strcpy(config.cache_file_cfg.cache_path, BENCH_CACHE_PATH);
+	config.pk_pool_size = 1;
+	zrtp_memcpy(config.pk_pool_schemes, schemes, sizeof(schemes));
+
+	if (zrtp_status_ok != zrtp_init(&config, &zrtp)) {
+		return -1;
+	}
+
+	printf("%10s %14s %14s\n", "scheme", "inline, ms", "pooled, ms");
+	for (i=0; schemes[i]; i++) {
+		scheme = zrtp_comp_find(ZRTP_CC_PKT, schemes[i], zrtp);
+
+		start = zrtp_time_now();
+		for (j=0; j<BENCH_TAKES; j++) {
+			scheme->initialize(scheme, &dh_cc);
+			bnEnd(&dh_cc.sv);
+			bnEnd(&dh_cc.pv);
+		}
+		inline_time = zrtp_time_now() - start;
+
+		pooled_time = 0;
+		for (j=0; j<BENCH_TAKES; j++) {
+			/* Give the generator time to replace the pair taken on the previous round */
+			zrtp_sleep(inline_time / BENCH_TAKES * 2 + 10);
+			start = zrtp_time_now();
+			zrtp_pk_pool_take(scheme, &dh_cc);
+			pooled_time += zrtp_time_now() - start;
+			bnEnd(&dh_cc.sv);
+			bnEnd(&dh_cc.pv);
+		}
+
+		printf("%10.4s %14.1f %14.1f\n", scheme->base.type,
+			   (double)inline_time / BENCH_TAKES, (double)pooled_time / BENCH_TAKES);
+	}
+
+	zrtp_down(zrtp);
+	remove(BENCH_CACHE_PATH);
+	printf("\n");
+	return 0;
+}
+
+static int bench(uint32_t pool_size) {
+	zrtp_test_endpoint_cfg_t endpoint_cfg;
+	zrtp_test_session_cfg_t session_cfg;
+	zrtp_test_channel_info_t channel_info;
+	zrtp_time_t start, latency, total = 0, worst = 0;
+	uint32_t hits = 0, misses = 0;
+	unsigned i;
+
+	zrtp_test_endpoint_config_defaults(&endpoint_cfg);
+	endpoint_cfg.zrtp.pk_pool_size = pool_size;
+	zrtp_memset(endpoint_cfg.zrtp.pk_pool_schemes, 0, sizeof(endpoint_cfg.zrtp.pk_pool_schemes));
+	endpoint_cfg.zrtp.pk_pool_schemes[0] = ZRTP_PKTYPE_DH3072;
+
+	zrtp_test_session_config_defaults(&session_cfg);
+	zrtp_memset(session_cfg.zrtp.pk_schemes, 0, sizeof(session_cfg.zrtp.pk_schemes));
+	session_cfg.zrtp.pk_schemes[0] = ZRTP_PKTYPE_DH3072;
+	session_cfg.zrtp.pk_schemes[1] = ZRTP_PKTYPE_MULT;
+
+	if (zrtp_status_ok != zrtp_test_endpoint_create(&endpoint_cfg, "Alice", &g_alice) ||
+		zrtp_status_ok != zrtp_test_endpoint_create(&endpoint_cfg, "Bob", &g_bob)) {
+		return -1;
+	}
+
+	for (i=0; i<BENCH_HANDSHAKES; i++) {
+		/* Let the generator fill the pool up as it would between calls */
+		zrtp_sleep(BENCH_REFILL_PAUSE);
+
+		if (zrtp_status_ok != zrtp_test_session_create(g_alice, &session_cfg, &g_alice_sid) ||
+			zrtp_status_ok != zrtp_test_session_create(g_bob, &session_cfg, &g_bob_sid) ||
+			zrtp_status_ok != zrtp_test_channel_create2(g_alice_sid, g_bob_sid, 0, &g_secure_audio_channel)) {
+			return -1;
+		}
+
+		start = zrtp_time_now();
+		zrtp_test_channel_start(g_secure_audio_channel);
+		do {
+			zrtp_sleep(1);
+			zrtp_test_channel_get(g_secure_audio_channel, &channel_info);
+		} while (!channel_info.is_secure && (zrtp_time_now() - start < BENCH_SECURE_TIMEOUT));
+
+		if (!channel_info.is_secure) {
+			printf("handshake %u didn't go secure\n", i);
+			return -1;
+		}
+		latency = zrtp_time_now() - start;
+		total += latency;
+		worst = (latency > worst) ? latency : worst;
+
+		if (i == BENCH_HANDSHAKES-1) {
+			zrtp_pk_pool_get_stats(endpoint_zrtp(g_alice_sid), ZRTP_PKTYPE_DH3072, &hits, &misses);
+		}
+		release_alice_bob();
+	}
+
+	zrtp_test_endpoint_destroy(g_alice);
+	zrtp_test_endpoint_destroy(g_bob);
+
+	printf("%10u %14.1f %12u %8u %8u\n", pool_size, (double)total / BENCH_HANDSHAKES,
+		   (uint32_t)worst, hits, misses);
+	return 0;
+}
+
+int main(void) {
+	uint32_t sizes[] = {0, ZRTP_PK_POOL_SIZE};
+	unsigned i;
+
+	/* The protocol logs every packet, keep the output readable */
+	zrtp_log_set_log_engine(NULL);
+
+	if (0 != bench_take()) {
+		printf("ERROR! key pairs benchmark failed\n");
+		return 1;
+	}
+
+	printf("%10s %14s %12s %8s %8s\n", "pool size", "avg, ms", "worst, ms", "hits", "misses");
+	for (i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+		if (0 != bench(sizes[i])) {
+			printf("ERROR! benchmark failed for pool size %u\n", sizes[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
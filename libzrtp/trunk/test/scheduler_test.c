@@ -0,0 +1,220 @@
+/*
+ * libZRTP SDK library, implements the ZRTP secure VoIP protocol.
+ * Copyright (c) 2006-2009 Philip R. Zimmermann.  All rights reserved.
+ * Contact: http://philzimmermann.com
+ * For licensing and other legal details, see the file zrtp_legal.c.
+ *
+ * Viktor Krykun <v.krikun at zfoneproject.com>
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "zrtp.h"
+
+#define _UINTMAX_T
+#include "cmockery/cmockery.h"
+
+/*
+ * Stress test for the built-in scheduler: every stream arms its retry tasks the same way the
+ * protocol engine does, and the test checks that each task fires once, not earlier than asked and
+ * close to its deadline, and that canceled tasks never fire.
+ */
+
+#define TEST_STREAMS_COUNT		10000
+#define TEST_MAX_TIMEOUT		1500
+#define TEST_MAX_LATENESS		150
+#define TEST_WAIT_LIMIT			10000
+#define TEST_RETRIES			3
+
+static zrtp_stream_t	*g_streams = NULL;
+static zrtp_mutex_t		*g_protector = NULL;
+
+static uint32_t			g_fired = 0;
+static uint32_t			g_early = 0;
+static zrtp_time_t		g_max_lateness = 0;
+
+/* Per-stream expected wake time and number of calls */
+static zrtp_time_t		*g_expected = NULL;
+static uint32_t			*g_calls = NULL;
+
+
+static void sched_setup() {
+	zrtp_status_t s;
+
+	g_streams  = calloc(TEST_STREAMS_COUNT, sizeof(zrtp_stream_t));
+	g_expected = calloc(TEST_STREAMS_COUNT, sizeof(zrtp_time_t));
+	g_calls    = calloc(TEST_STREAMS_COUNT, sizeof(uint32_t));
+	assert_non_null(g_streams);
+	assert_non_null(g_expected);
+	assert_non_null(g_calls);
+
+	g_fired = 0;
+	g_early = 0;
+	g_max_lateness = 0;
+
+	s = zrtp_mutex_init(&g_protector);
+	assert_int_equal(zrtp_status_ok, s);
+
+	s = zrtp_def_scheduler_init(NULL);
+	assert_int_equal(zrtp_status_ok, s);
+}
+
+static void sched_teardown() {
+	zrtp_def_scheduler_down();
+	zrtp_mutex_destroy(g_protector);
+
+	free(g_streams);
+	free(g_expected);
+	free(g_calls);
+}
+
+static void on_task(zrtp_stream_t* ctx, zrtp_retry_task_t* ztask) {
+	zrtp_time_t now = zrtp_time_now();
+	uint32_t i = (uint32_t)(ctx - g_streams);
+
+	zrtp_mutex_lock(g_protector);
+	g_calls[i]++;
+	/* Both clocks have millisecond granularity */
+	if (now + 1 < g_expected[i]) {
+		g_early++;
+	} else if ((now > g_expected[i]) && (now - g_expected[i] > g_max_lateness)) {
+		g_max_lateness = now - g_expected[i];
+	}
+
+	if (++ztask->_retrys < (uint32_t)(uintptr_t)ztask->usr_data) {
+		g_expected[i] = zrtp_time_now() + ztask->timeout;
+		zrtp_mutex_unlock(g_protector);
+		zrtp_def_scheduler_call_later(ctx, ztask);
+		return;
+	}
+	g_fired++;
+	zrtp_mutex_unlock(g_protector);
+}
+
+static void arm_task(uint32_t i, zrtp_time_t timeout, uint32_t retries) {
+	zrtp_retry_task_t* task = &g_streams[i].messages.hello_task;
+
+	task->callback		= on_task;
+	task->timeout		= timeout;
+	task->usr_data		= (void*)(uintptr_t)retries;
+	task->_is_enabled	= 1;
+	task->_retrys		= 0;
+
+	zrtp_mutex_lock(g_protector);
+	g_expected[i] = zrtp_time_now() + timeout;
+	zrtp_mutex_unlock(g_protector);
+
+	zrtp_def_scheduler_call_later(&g_streams[i], task);
+}
+
+static uint32_t wait_fired(uint32_t expected, zrtp_time_t limit) {
+	zrtp_time_t start = zrtp_time_now();
+	uint32_t fired = 0;
+
+	do {
+		zrtp_sleep(10);
+		zrtp_mutex_lock(g_protector);
+		fired = g_fired;
+		zrtp_mutex_unlock(g_protector);
+	} while ((fired < expected) && (zrtp_time_now() - start < limit));
+
+	return fired;
+}
+
+void sched_fire_all_test() {
+	uint32_t i;
+
+	srand(1);
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		arm_task(i, 1 + rand() % TEST_MAX_TIMEOUT, 1);
+	}
+
+	assert_int_equal(TEST_STREAMS_COUNT, wait_fired(TEST_STREAMS_COUNT, TEST_WAIT_LIMIT));
+
+	/* Give duplicates a chance to show up */
+	zrtp_sleep(100);
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		assert_int_equal(1, g_calls[i]);
+	}
+
+	assert_int_equal(0, g_early);
+	printf("max lateness: %u ms\n", (uint32_t)g_max_lateness);
+	assert_true(g_max_lateness <= TEST_MAX_LATENESS);
+}
+
+void sched_retries_test() {
+	uint32_t i;
+
+	srand(2);
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		arm_task(i, 50 + rand() % 200, TEST_RETRIES);
+	}
+
+	assert_int_equal(TEST_STREAMS_COUNT, wait_fired(TEST_STREAMS_COUNT, TEST_WAIT_LIMIT));
+
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		assert_int_equal(TEST_RETRIES, g_calls[i]);
+	}
+	assert_int_equal(0, g_early);
+	assert_true(g_max_lateness <= TEST_MAX_LATENESS);
+}
+
+void sched_cancel_test() {
+	uint32_t i;
+
+	srand(3);
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		arm_task(i, 200 + rand() % 800, 1);
+	}
+
+	/* Cancel every second stream: half by task, half with all stream tasks at once */
+	for (i=0; i<TEST_STREAMS_COUNT; i+=2) {
+		g_streams[i].messages.hello_task._is_enabled = 0;
+		if (i % 4) {
+			zrtp_def_scheduler_cancel_call_later(&g_streams[i], &g_streams[i].messages.hello_task);
+		} else {
+			zrtp_def_scheduler_cancel_call_later(&g_streams[i], NULL);
+		}
+	}
+
+	assert_int_equal(TEST_STREAMS_COUNT/2, wait_fired(TEST_STREAMS_COUNT/2, TEST_WAIT_LIMIT));
+	zrtp_sleep(100);
+
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		assert_int_equal((i % 2) ? 1 : 0, g_calls[i]);
+		zrtp_def_scheduler_wait_call_later(&g_streams[i]);
+	}
+}
+
+void sched_rearm_test() {
+	uint32_t i;
+
+	/* Re-arming a pending task moves its deadline rather than adding a second call */
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		arm_task(i, 100, 1);
+		arm_task(i, 300, 1);
+	}
+
+	assert_int_equal(TEST_STREAMS_COUNT, wait_fired(TEST_STREAMS_COUNT, TEST_WAIT_LIMIT));
+	zrtp_sleep(100);
+
+	for (i=0; i<TEST_STREAMS_COUNT; i++) {
+		assert_int_equal(1, g_calls[i]);
+	}
+	assert_int_equal(0, g_early);
+}
+
+int main(void) {
+	const UnitTest tests[] = {
+		unit_test_setup_teardown(sched_fire_all_test, sched_setup, sched_teardown),
+		unit_test_setup_teardown(sched_retries_test, sched_setup, sched_teardown),
+		unit_test_setup_teardown(sched_cancel_test, sched_setup, sched_teardown),
+		unit_test_setup_teardown(sched_rearm_test, sched_setup, sched_teardown),
+	};
+
+	return run_tests(tests);
+}
@@ -26,8 +26,13 @@ zrtp_global_t *zrtp;
 
 #define FIRST_TEST_MAP_INIT_WIDTH 24
 
-extern zrtp_rp_node_t *get_rp_node_non_lock(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc);
-extern zrtp_rp_node_t *add_rp_node(zrtp_srtp_ctx_t *srtp_ctx, zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc);
+#define TEST_RP_NODES_COUNT 1000
+
+extern zrtp_rp_ctx_t* rp_init(uint32_t size);
+extern zrtp_status_t rp_destroy(zrtp_rp_ctx_t *ctx);
+extern zrtp_rp_node_t *get_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc);
+extern zrtp_rp_node_t *add_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc);
+extern zrtp_status_t remove_rp_node(zrtp_rp_ctx_t *ctx, uint8_t direction, uint32_t ssrc);
 extern zrtp_status_t zrtp_srtp_rp_check(zrtp_srtp_rp_t *srtp_rp, zrtp_rtp_info_t *packet);
 extern zrtp_status_t zrtp_srtp_rp_add(zrtp_srtp_rp_t *srtp_rp, zrtp_rtp_info_t *packet);
 
@@ -76,14 +81,14 @@ static void init_random_map(uint8_t *map, int width, zrtp_global_t *zrtp) {
 	}
 }
 
-void inject_from_map( zrtp_srtp_global_t *srtp_global, 
+void inject_from_map( zrtp_rp_ctx_t *rp_ctx, 
 					  uint32_t ssrc,
 					  uint8_t *src_map, uint8_t *dst_map, int width) {
 	zrtp_rp_node_t *rp_node;
 	int i;
 	zrtp_rtp_info_t pkt;
 	
-	rp_node = get_rp_node_non_lock(srtp_global->rp_ctx, RP_INCOMING_DIRECTION, ssrc);
+	rp_node = get_rp_node(rp_ctx, RP_INCOMING_DIRECTION, ssrc);
 	if (NULL == rp_node) {
 		return;	
 	}
@@ -111,9 +116,10 @@ static void srtp_replay_test() {
 	int delta, shift;
 		
 	zrtp_rp_node_t *rp_node;
-	zrtp_srtp_global_t *srtp = zrtp->srtp_global;
+	zrtp_rp_ctx_t *rp_ctx = rp_init(ZRTP_SRTP_RP_TABLE_SIZE);
+	assert_non_null(rp_ctx);
 	
-	rp_node = add_rp_node(NULL, srtp->rp_ctx, RP_INCOMING_DIRECTION, ssrc);
+	rp_node = add_rp_node(rp_ctx, RP_INCOMING_DIRECTION, ssrc);
 	assert_non_null(rp_node);
 		
 	for (i=0; i< TEST_MAP_WIDTH_BYTES; i++) {
@@ -125,7 +131,7 @@ static void srtp_replay_test() {
 	 * ----------------------------------------------------------------------
 	 */
 	init_random_map(test_map, FIRST_TEST_MAP_INIT_WIDTH, zrtp);
-	inject_from_map(srtp, ssrc, test_map, result_map, TEST_MAP_WIDTH);
+	inject_from_map(rp_ctx, ssrc, test_map, result_map, TEST_MAP_WIDTH);
 	
 	ZRTP_LOG(3, (_ZTU_,"1st test. Wnd[%i]...\n", ZRTP_SRTP_WINDOW_WIDTH));
 
@@ -170,7 +176,7 @@ static void srtp_replay_test() {
 	}
 
 	init_random_map(test_map, TEST_MAP_WIDTH, zrtp);
-	inject_from_map(srtp, ssrc, test_map, result_map, TEST_MAP_WIDTH);
+	inject_from_map(rp_ctx, ssrc, test_map, result_map, TEST_MAP_WIDTH);
 
 	ZRTP_LOG(3, (_ZTU_,"2nd test. Wnd[%i]...\n", ZRTP_SRTP_WINDOW_WIDTH));
 	ZRTP_LOG(3, (_ZTU_,"Test map: "));
@@ -228,12 +234,55 @@ static void srtp_replay_test() {
 		}
 	}
 	
+	rp_destroy(rp_ctx);
 	assert_int_equal(res, 0);
 }
 
+static void srtp_rp_table_test() {
+	zrtp_rp_ctx_t *rp_ctx = rp_init(ZRTP_SRTP_RP_TABLE_SIZE);
+	zrtp_rp_node_t *nodes[TEST_RP_NODES_COUNT];
+	uint32_t i;
+
+	assert_non_null(rp_ctx);
+
+	/* Sequential SSRCs in one direction, the table has to grow several times */
+	for (i=0; i<TEST_RP_NODES_COUNT; i++) {
+		nodes[i] = add_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i);
+		assert_non_null(nodes[i]);
+		nodes[i]->rtp_rp.seq = i;
+	}
+	assert_int_equal(TEST_RP_NODES_COUNT, rp_ctx->inc.count);
+	assert_int_equal(0, rp_ctx->out.count);
+	assert_true(NULL == get_rp_node(rp_ctx, RP_OUTGOING_DIRECTION, 1));
+
+	/* Nodes keep their place and state over growing */
+	for (i=0; i<TEST_RP_NODES_COUNT; i++) {
+		assert_true(nodes[i] == get_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i));
+		assert_true(nodes[i] == add_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i));
+		assert_int_equal(i, nodes[i]->rtp_rp.seq);
+	}
+
+	/* Removing every other node must not break probe sequences of the rest */
+	for (i=0; i<TEST_RP_NODES_COUNT; i+=2) {
+		assert_int_equal(zrtp_status_ok, remove_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i));
+	}
+	assert_int_equal(zrtp_status_fail, remove_rp_node(rp_ctx, RP_INCOMING_DIRECTION, 0));
+	for (i=0; i<TEST_RP_NODES_COUNT; i++) {
+		if (i % 2) {
+			assert_true(nodes[i] == get_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i));
+		} else {
+			assert_true(NULL == get_rp_node(rp_ctx, RP_INCOMING_DIRECTION, i));
+		}
+	}
+	assert_int_equal(TEST_RP_NODES_COUNT/2, rp_ctx->inc.count);
+
+	rp_destroy(rp_ctx);
+}
+
 int main(void) {
 	const UnitTest tests[] = {
 		unit_test_setup_teardown(srtp_replay_test, setup, teardown),
+		unit_test_setup_teardown(srtp_rp_table_test, setup, teardown),
   	};
 
 	return run_tests(tests);
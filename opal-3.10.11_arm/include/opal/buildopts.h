@@ -278,11 +278,10 @@
 // libSRTP support
 //
 
-/* Temporarily disabled as is currently broken, doesn't work,
-    probably doesn't even compile, need to sort out API to enable/disable,
-    add SDP and H.245 handling, and link into libsrtp
+/* Built against libsrtp2 for the SM4 security modes, there is still no SDP
+    or H.245 key negotiation, keys come from the TLS signalling channel
 */
-//#undef HAS_LIBSRTP
+#define HAS_LIBSRTP 1
 
 #if HAS_LIBSRTP && !OPAL_ZRTP && !defined(_WIN32_WCE)
 
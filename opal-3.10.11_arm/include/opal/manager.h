@@ -53,6 +53,8 @@
 
 class OpalEndPoint;
 class OpalMediaPatch;
+class RTP_Reactor;
+class OpalMediaClock;
 
 
 /**This class is the central manager for OPAL.
@@ -1366,6 +1368,44 @@ class OpalManager : public PObject
       PINDEX size
     ) { rtpPacketSizeMax = size; }
 
+    /**Get the reactor shared by RTP sessions for receiving.
+       Returns NULL if each RTP session reads in its own thread, which is
+       the default.
+      */
+    RTP_Reactor * GetRTPReactor() const { return m_useRTPReactor ? m_rtpReactor : NULL; }
+
+    /**Set whether RTP sessions receive on a shared RTP_Reactor.
+       The loops parameter is the number of event loops, zero being one per
+       CPU, and is only used when the reactor is first started. Only
+       sessions created after this call are affected.
+
+       Returns false if the reactor is not available on this platform.
+      */
+    bool SetRTPReactor(
+      bool enable,
+      unsigned loops = 0
+    );
+
+    /**Get the clock shared by media patches for pacing.
+       Returns NULL if each media patch runs in its own thread, which is the
+       default.
+      */
+    OpalMediaClock * GetMediaClock() const { return m_useMediaClock ? m_mediaClock : NULL; }
+
+    /**Set whether audio media patches are ticked by a shared OpalMediaClock.
+       Only patches with no stream to pace them, such as RTP to RTP, are
+       ticked, others keep their own thread. The workers parameter is the
+       number of worker threads, zero being one per CPU, and is only used
+       when the clock is first started. Only patches started after this call
+       are affected.
+
+       Returns false if the clock is not available on this platform.
+      */
+    bool SetMediaClock(
+      bool enable,
+      unsigned workers = 0
+    );
+
     /**Get the default maximum audio jitter delay parameter.
        Defaults to 50ms
      */
@@ -1544,6 +1584,10 @@ class OpalManager : public PObject
 
     PINDEX        rtpPayloadSizeMax;
     PINDEX        rtpPacketSizeMax;
+    RTP_Reactor * m_rtpReactor;
+    bool          m_useRTPReactor;
+    OpalMediaClock * m_mediaClock;
+    bool             m_useMediaClock;
     unsigned      minAudioJitterDelay;
     unsigned      maxAudioJitterDelay;
     PStringArray  mediaFormatOrder;
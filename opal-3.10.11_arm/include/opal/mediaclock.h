@@ -0,0 +1,219 @@
+/*
+ * mediaclock.h
+ *
+ * Shared timer for pacing media
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_OPAL_MEDIACLOCK_H
+#define OPAL_OPAL_MEDIACLOCK_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal/buildopts.h>
+
+#include <map>
+#include <vector>
+
+
+#if defined(P_LINUX)
+#define OPAL_MEDIA_CLOCK 1
+#else
+#define OPAL_MEDIA_CLOCK 0
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+/**This class calls many clients at regular intervals from a small number of
+   worker threads, by default one per CPU, instead of each client pacing a
+   thread of its own with sleeps. It is used to tick media patches that have
+   no sound device or other blocking stream to pace them, each tick reading
+   one frame from the jitter buffer and sending it on.
+
+   Each client has an absolute deadline for its next tick on the monotonic
+   clock, advanced by exactly its interval each time, so lateness in one
+   tick does not accumulate into the next. A worker sleeps on a timer set
+   for the earliest deadline of its clients. How late each tick was called
+   is kept as a histogram, see GetStatistics().
+
+   The clock is only available where timerfd is, elsewhere Start() fails and
+   media patches keep their own threads.
+  */
+class OpalMediaClock : public PObject
+{
+  PCLASSINFO(OpalMediaClock, PObject);
+
+  public:
+    /**Something to be called by the clock.
+      */
+    class Client
+    {
+      public:
+        virtual ~Client() { }
+
+        /**Called from a worker thread when the client is due.
+           This must not block, as other clients on the worker wait for it.
+
+           Returns false to stop being ticked. The client must still be
+           removed from the clock with Remove() before it is destroyed.
+          */
+        virtual bool OnMediaClockTick() = 0;
+    };
+
+  /**@name Construction */
+  //@{
+    /**Create a clock with the number of worker threads given.
+       If zero, one worker per online CPU is used.
+      */
+    OpalMediaClock(
+      unsigned workerCount = 0  ///< Number of worker threads
+    );
+
+    /**Stop all workers and drop any clients still added.
+      */
+    ~OpalMediaClock();
+  //@}
+
+  /**@name Overrides from PObject */
+  //@{
+    /**Output the worker and client counts, and the lateness histogram.
+      */
+    virtual void PrintOn(
+      ostream & strm    ///<  Stream to output text representation
+    ) const;
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Create the worker timers and start their threads.
+       Returns false if the platform has no timerfd or a timer could not be
+       created.
+      */
+    bool Start();
+
+    /**Stop the worker threads and wait for them to finish.
+      */
+    void Stop();
+
+    /**Start ticking a client every \p interval milliseconds, the first tick
+       being one interval from now. The client goes on the worker with the
+       fewest clients.
+      */
+    bool Add(
+      Client & client,    ///< Client to tick
+      unsigned interval   ///< Milliseconds between ticks
+    );
+
+    /**Stop ticking a client.
+       On return the workers will make no further calls into the client.
+       This may be called from within Client::OnMediaClockTick().
+
+       Returns true if the client was still being ticked, false if it was
+       never added, or had stopped by returning false from a tick.
+      */
+    bool Remove(
+      Client & client   ///< Client to stop ticking
+    );
+  //@}
+
+  /**@name Member variable access */
+  //@{
+    /**Indicate the worker threads are running.
+      */
+    bool IsRunning() const { return m_running; }
+
+    /**Get the number of worker threads.
+      */
+    unsigned GetWorkerCount() const { return m_workerCount; }
+
+    /**Get the number of clients added.
+      */
+    PINDEX GetClientCount() const;
+  //@}
+
+    enum {
+      /// Buckets in the tick lateness histogram.
+      LatenessBuckets = 8,
+      /// Most ticks a client may fall behind by before the missed ones are
+      /// skipped rather than called back to back to catch up.
+      MaxCatchUpTicks = 5
+    };
+
+    /**Counts of ticks since the clock was created, over all workers.
+      */
+    struct Statistics {
+      PUInt64  m_ticks;                     ///< Ticks called
+      PUInt64  m_skippedTicks;              ///< Ticks not called, as too far behind
+      unsigned m_maxLateness;               ///< Latest tick, in microseconds
+      PUInt64  m_lateness[LatenessBuckets]; ///< Ticks by lateness, see GetLatenessLimit()
+    };
+
+    /**Get the tick statistics.
+      */
+    Statistics GetStatistics() const;
+
+    /**Get the upper limit, in microseconds, of the lateness of ticks counted
+       in a histogram bucket. The last bucket has no limit and returns zero.
+      */
+    static unsigned GetLatenessLimit(
+      PINDEX bucket   ///< Index of bucket in Statistics::m_lateness
+    );
+
+  protected:
+    struct Registration {
+      Client  * m_client;
+      unsigned  m_worker;
+      PInt64    m_interval;   ///< Nanoseconds
+      PInt64    m_deadline;   ///< Nanoseconds on the monotonic clock
+      bool      m_removed;
+      bool      m_ended;
+    };
+
+    struct Worker {
+      Worker();
+
+      int        m_timer;
+      PInt64     m_timerDeadline;   ///< Deadline the timer is set for, zero if not set
+      PThread  * m_thread;
+      PMutex     m_mutex;           ///< Held while ticking clients
+      unsigned   m_clientCount;     ///< Protected by m_clientsMutex
+      Statistics m_statistics;
+      std::vector<Registration *> m_registrations;
+    };
+
+    void SetTimer(Worker & worker, PInt64 deadline);
+    void TickClients(Worker & worker, PInt64 now);
+
+    PDECLARE_NOTIFIER(PThread, OpalMediaClock, WorkerMain);
+
+    unsigned      m_workerCount;
+    bool          m_running;
+    Worker      * m_workers;
+
+    typedef std::map<Client *, Registration *> RegistrationMap;
+    RegistrationMap m_clients;
+    PMutex mutable  m_clientsMutex;
+};
+
+
+#endif // OPAL_OPAL_MEDIACLOCK_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -242,6 +242,19 @@ class OpalMediaStream : public PSafeObject
       RTP_DataFrame & packet
     );
 
+    /**Called by the patch before writing one frame, which the codecs may
+       turn into several packets. A packet based stream may hold the packets
+       written until EndWriteBatch() to send them together.
+       The default behaviour does nothing.
+      */
+    virtual void StartWriteBatch();
+
+    /**Called by the patch after writing one frame, to send any packets held
+       since StartWriteBatch().
+       The default behaviour does nothing and returns true.
+      */
+    virtual bool EndWriteBatch();
+
     /**Read raw media data from the source media stream.
        The default behaviour simply calls ReadPacket() on the data portion of the
        RTP_DataFrame and sets the frames timestamp and marker from the internal
@@ -308,6 +321,15 @@ class OpalMediaStream : public PSafeObject
     ) const;
     virtual PBoolean RequiresPatchThread() const; // For backward compatibility
 
+    /**Indicate if the media stream may be read or written from an
+       OpalMediaClock tick. This requires that neither blocks, nor paces
+       itself by sleeping, as that would hold up other patches on the clock.
+       Note this is not just the inverse of IsSynchronous().
+
+       The default behaviour returns false.
+      */
+    virtual bool CanBeClockTicked() const;
+
     /**Enable jitter buffer for the media stream.
        Returns true if a jitter buffer is enabled/disabled. Returns false if
        no jitter buffer exists for the media stream.
@@ -536,6 +558,12 @@ class OpalNullMediaStream : public OpalMediaStream, public OpalMediaStreamPacing
        Returns m_isSynchronous.
       */
     virtual PBoolean IsSynchronous() const;
+
+    /**Indicate if the media stream may be read or written from an
+       OpalMediaClock tick.
+       Returns true if not m_isSynchronous.
+      */
+    virtual bool CanBeClockTicked() const;
   //@}
 
   protected:
@@ -603,6 +631,16 @@ class OpalRTPMediaStream : public OpalMediaStream
       RTP_DataFrame & packet
     );
 
+    /**Start holding packets in the RTP session.
+       The new behaviour simply calls RTP_Session::StartWriteBatch().
+      */
+    virtual void StartWriteBatch();
+
+    /**Send packets held in the RTP session.
+       The new behaviour simply calls RTP_Session::EndWriteBatch().
+      */
+    virtual bool EndWriteBatch();
+
     /**Set the data size in bytes that is expected to be used.
       */
     virtual PBoolean SetDataSize(
@@ -615,6 +653,13 @@ class OpalRTPMediaStream : public OpalMediaStream
       */
     virtual PBoolean IsSynchronous() const;
 
+    /**Indicate if the media stream may be read or written from an
+       OpalMediaClock tick.
+       Returns true for sinks, and for sources whose session has a jitter
+       buffer, which is only known after OnStartMediaPatch().
+      */
+    virtual bool CanBeClockTicked() const;
+
     /**Indicate if the media stream requires a OpalMediaPatch thread (active patch).
        The default behaviour dermines if the media will be flowing between two
        RTP sessions within the same process. If so the
@@ -939,6 +939,12 @@ class OpalMixerMediaStream : public OpalMediaStream
       */
     virtual PBoolean IsSynchronous() const;
 
+    /**Indicate if the media stream may be read or written from an
+       OpalMediaClock tick.
+       Returns true, the mixer never blocks.
+      */
+    virtual bool CanBeClockTicked() const;
+
     /**Indicate if the media stream requires a OpalMediaPatch thread (active patch).
        This is called on the source/sink stream and is passed the sink/source
        stream that the patch will initially be using. The function could
@@ -39,6 +39,7 @@
 
 #include <opal/mediastrm.h>
 #include <opal/mediacmd.h>
+#include <opal/mediaclock.h>
 #include <codec/ratectl.h>
 
 #include <list>
@@ -55,8 +56,12 @@ class OpalTranscoder;
    Note the thread is not actually started straight away. It is expected that
    the Start() function is called on the patch when the creator code is
    ready for it to begin. For example all sink streams have been added.
+
+   If the OpalManager has a media clock, an audio patch whose streams can
+   all be clock ticked, see OpalMediaStream::CanBeClockTicked(), does not
+   have a thread, it is ticked by the clock instead.
   */
-class OpalMediaPatch : public PSafeObject
+class OpalMediaPatch : public PSafeObject, public OpalMediaClock::Client
 {
     PCLASSINFO(OpalMediaPatch, PObject);
   public:
@@ -87,11 +92,20 @@ class OpalMediaPatch : public PSafeObject
 
   /**@name Operations */
   //@{
-    /**Start the patch. The default implementation simply starts the
-       patch thread, which in turn calls Main()
+    /**Start the patch. The default implementation adds the patch to the
+       media clock, if there is one and nothing else paces the patch,
+       otherwise it starts the patch thread, which in turn calls Main()
       */
     virtual void Start();
 
+    /**Called from the media clock, in place of the patch thread, to
+       transfer one frame from the source to the sinks.
+
+       Returns false, to stop being ticked, when the source is closed or
+       the transfer failed.
+      */
+    virtual bool OnMediaClockTick();
+
     /**Indicate the patch has started. Typically called from the beginning
        of the patch thread.
 
@@ -239,6 +253,8 @@ class OpalMediaPatch : public PSafeObject
     /**Called from the associated patch thread */
     virtual void Main();
     void StopThread();
+    bool StartMediaClock();
+    bool TransferFrame(RTP_DataFrame & sourceFrame);
     bool DispatchFrame(RTP_DataFrame & frame);
     bool EnableJitterBuffer();
 
@@ -300,6 +316,11 @@ class OpalMediaPatch : public PSafeObject
     Thread * patchThread;
     PMutex patchThreadMutex;
 
+    OpalMediaClock * m_mediaClock;
+    RTP_DataFrame    m_clockFrame;          ///< Source frame kept between ticks, as Main() keeps it between reads
+    bool             m_mediaPatchStarted;   ///< OnStartMediaPatch() already called by Start()
+    bool             m_asynchronous;
+
     FILE *beforepatch;
 
   private:
@@ -499,6 +499,16 @@ class OpalRTPConnection : public OpalConnection
 
     virtual void SessionFailing(RTP_Session & session);
 
+    /**Set the security mode used for RTP sessions created from now on.
+       The mode is a PFactory<OpalSecurityMode> key, e.g. "SRTP|SM4_SKF_HY_ECB",
+       an empty string gives plain RTP.
+      */
+    void SetSecurityMode(const PString & mode) { securityMode = mode; }
+
+    /**Get the security mode used for new RTP sessions.
+      */
+    const PString & GetSecurityMode() const { return securityMode; }
+
   protected:
     PDECLARE_NOTIFIER(OpalRFC2833Info, OpalRTPConnection, OnUserInputInlineRFC2833);
     PDECLARE_NOTIFIER(OpalRFC2833Info, OpalRTPConnection, OnUserInputInlineCiscoNSE);
@@ -511,6 +521,7 @@ class OpalRTPConnection : public OpalConnection
 
     PBoolean remoteIsNAT;
     PBoolean useRTPAggregation;
+    PString  securityMode;
 
 #ifdef OPAL_ZRTP
     bool zrtpEnabled;
@@ -0,0 +1,108 @@
+/*
+ * framepool.h
+ *
+ * Pool of packet buffers for RTP data frames
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_RTP_FRAMEPOOL_H
+#define OPAL_RTP_FRAMEPOOL_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal/buildopts.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+/**Fixed capacity buffers for RTP_DataFrame, so packets do not go to the heap.
+
+   There are two sizes of block: one big enough for any packet on a normal
+   MTU, with room for SRTP and header extensions, and a jumbo one for the
+   largest UDP datagram, as video can use. Frames bigger than that stay on
+   the heap.
+
+   Each thread keeps a small cache of free blocks, so taking and giving back
+   a block needs no lock. A thread that frees more than it takes, such as a
+   media patch freeing what the receive thread read, hands a batch of blocks
+   on to a shared depot, from which a thread with an empty cache takes a
+   batch. The depot mutex is only touched once per batch.
+
+   Blocks are only returned to the heap when the process exits.
+  */
+class RTP_FramePool
+{
+  public:
+    enum {
+      PacketCapacity = 2048,    ///< Block size for packets on a normal MTU
+      JumboCapacity  = 65536    ///< Block size for anything up to a UDP datagram
+    };
+
+    struct Block;
+
+    /**Get a block with room for at least \p size bytes.
+       If \p data is not NULL, the first \p dataSize bytes of it are copied
+       into the block, and counted in the statistics as a copy.
+       Returns NULL if \p size is bigger than JumboCapacity.
+      */
+    static BYTE * Acquire(
+      PINDEX size,                  ///< Bytes needed
+      Block * & block,              ///< Block the buffer belongs to
+      const BYTE * data = NULL,     ///< Data to copy into buffer
+      PINDEX dataSize = 0           ///< Bytes of data to copy
+    );
+
+    /**Give a block back to the pool.
+      */
+    static void Release(
+      Block * block     ///< Block from Acquire()
+    );
+
+    /**Get the number of bytes a block can hold.
+      */
+    static PINDEX GetCapacity(
+      const Block * block     ///< Block from Acquire()
+    );
+
+    /**Get the buffer of a block, as returned by Acquire().
+      */
+    static BYTE * GetBuffer(
+      const Block * block     ///< Block from Acquire()
+    );
+
+    /**Counts of what the pool has done since the process started.
+       In steady state the block counts stop rising.
+      */
+    struct Statistics {
+      unsigned m_packetBlocks;  ///< Packet size blocks allocated from the heap
+      unsigned m_jumboBlocks;   ///< Jumbo blocks allocated from the heap
+      unsigned m_heapFrames;    ///< Frames too big for any block
+      unsigned m_copies;        ///< Frames copied into a new block
+    };
+
+    /**Get the pool statistics.
+      */
+    static Statistics GetStatistics();
+};
+
+
+#endif // OPAL_RTP_FRAMEPOOL_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -97,6 +97,8 @@ class OpalJitterBuffer : public PSafeObject
     void Reset();
 
     /**Write data frame from the RTP channel.
+       This is handed to ReadData() without a lock, so only one thread may
+       write to a jitter buffer, and only one read from it.
       */
     virtual PBoolean WriteData(
       const RTP_DataFrame & frame,   ///< Frame to feed into jitter buffer
@@ -183,9 +185,36 @@ class OpalJitterBuffer : public PSafeObject
       e_SynchronisationDone
     } m_synchronisationState;
 
-    typedef std::map<DWORD, RTP_DataFrame> FrameMap;
-    FrameMap m_frames;
-    PMutex   m_bufferMutex;
+    struct Slot {
+      DWORD           m_timestamp;
+      PTimeInterval   m_tick;
+      RTP_DataFrame * m_frame;
+    };
+
+    void ResizeSlots(std::vector<Slot> & slots, PINDEX size);
+    void ProcessQueuedFrames(bool discard);
+    bool AddFrame(Slot & queued, const PTimeInterval & tick);
+    void ResetBuffer();
+    void RemoveOldestFrame();
+    Slot & GetFrame(PINDEX index) { return m_frames[(m_oldestFrame+index)&(m_frames.size()-1)]; }
+
+    /* Frames written and not yet read, handed from the one thread calling
+       WriteData() to the one calling ReadData() without a lock. Only the
+       writer changes m_queueIn and only the reader m_queueOut. */
+    std::vector<Slot> m_queue;
+    PINDEX            m_queueIn;
+    PINDEX            m_queueOut;
+    PAtomicInteger    m_queuedFrames;
+
+    /* Frames waiting to be played, a circular buffer in timestamp order,
+       only touched by the reader with m_bufferMutex held. Every slot in
+       either buffer owns a frame, the reader moves frames from one to the
+       other by swapping them with empty ones, rather than copying. */
+    std::vector<Slot> m_frames;
+    PINDEX            m_oldestFrame;
+    PINDEX            m_frameCount;
+    RTP_DataFrame     m_emptyFrame;
+    PMutex            m_bufferMutex;
 
     RTP_JitterBufferAnalyser * m_analyser;
 };
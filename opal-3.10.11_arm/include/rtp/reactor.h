@@ -0,0 +1,177 @@
+/*
+ * reactor.h
+ *
+ * Shared event loops for receiving RTP/RTCP
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_RTP_REACTOR_H
+#define OPAL_RTP_REACTOR_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal/buildopts.h>
+
+#include <map>
+#include <vector>
+
+
+#if defined(P_LINUX)
+#define OPAL_RTP_REACTOR 1
+#else
+#define OPAL_RTP_REACTOR 0
+#endif
+
+
+class RTP_UDP;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/**This class receives for many RTP_UDP sessions from a small number of event
+   loops, by default one per CPU, instead of each session blocking a thread
+   of its own in PSocket::Select().
+
+   Each attached session has its data and control sockets registered with
+   the epoll set of one loop. When a socket becomes readable the loop calls
+   RTP_UDP::OnReactorReadable(), which reads the waiting datagrams and hands
+   data frames to the session's jitter buffer, or queues them for
+   RTP_Session::ReadData().
+
+   The reactor is only available where epoll is, elsewhere Start() fails and
+   sessions keep their own read threads.
+  */
+class RTP_Reactor : public PObject
+{
+  PCLASSINFO(RTP_Reactor, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a reactor with the number of event loops given.
+       If zero, one loop per online CPU is used.
+      */
+    RTP_Reactor(
+      unsigned loopCount = 0  ///< Number of event loops
+    );
+
+    /**Stop all loops and drop any sessions still attached.
+      */
+    ~RTP_Reactor();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Create the event loops and start their threads.
+       Returns false if the platform has no epoll or a loop could not be
+       created.
+      */
+    bool Start();
+
+    /**Stop the event loop threads and wait for them to finish.
+      */
+    void Stop();
+
+    /**Register the sockets of an open session with the least loaded loop.
+       This is normally done through RTP_UDP::AttachReactor().
+      */
+    bool Add(
+      RTP_UDP & session   ///< Session to receive for
+    );
+
+    /**Deregister the sockets of a session.
+       On return the loops will make no further calls into the session. This
+       may be called from within RTP_UDP::OnReactorReadable(), but must not
+       be called with the session dataMutex held.
+      */
+    void Remove(
+      RTP_UDP & session   ///< Session to stop receiving for
+    );
+  //@}
+
+  /**@name Member variable access */
+  //@{
+    /**Indicate the event loops are running.
+      */
+    bool IsRunning() const { return m_running; }
+
+    /**Get the number of event loops.
+      */
+    unsigned GetLoopCount() const { return m_loopCount; }
+
+    /**Get the number of sessions attached.
+      */
+    PINDEX GetSessionCount() const;
+  //@}
+
+    enum {
+      /// Most datagrams read from one socket per wake up, so a busy session
+      /// cannot starve the others on its loop.
+      MaxReadsPerEvent = 16,
+      /// Most events taken from epoll per wake up.
+      MaxEventsPerWait = 64
+    };
+
+  protected:
+    struct Registration;
+
+    struct Handle {
+      Registration * m_registration;
+      int            m_fd;
+      bool           m_isData;
+    };
+
+    struct Registration {
+      RTP_UDP  * m_session;
+      unsigned   m_loop;
+      bool       m_removed;
+      Handle     m_data;
+      Handle     m_control;
+    };
+
+    struct Loop {
+      Loop();
+
+      int       m_epoll;
+      int       m_wakeup;
+      PThread * m_thread;
+      PMutex    m_mutex;        ///< Held while dispatching a batch of events
+      unsigned  m_sessionCount;
+      std::vector<Registration *> m_removed; ///< Freed after the next batch
+    };
+
+    bool AddHandle(Loop & loop, Handle & handle);
+    void RemoveHandle(Loop & loop, Handle & handle);
+
+    PDECLARE_NOTIFIER(PThread, RTP_Reactor, LoopMain);
+
+    unsigned      m_loopCount;
+    bool          m_running;
+    Loop        * m_loops;
+
+    typedef std::map<RTP_UDP *, Registration *> RegistrationMap;
+    RegistrationMap m_registrations;
+    PMutex mutable  m_registrationsMutex;
+};
+
+
+#endif // OPAL_RTP_REACTOR_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -40,10 +40,13 @@
 
 #include <opal/buildopts.h>
 
+#include <rtp/framepool.h>
+
 #include <ptlib/sockets.h>
 #include <ptlib/safecoll.h>
 
 #include <list>
+#include <queue>
 
 #define gaoshaobo 1
 #define bruce	0
@@ -92,6 +95,7 @@ extern "C"
 
 
 class RTP_JitterBuffer;
+class RTP_Reactor;
 class PNatMethod;
 class OpalSecurityMode;
 class RTCP_XR_Metrics;
@@ -118,8 +122,24 @@ class RTP_DataFrame : public PBYTEArray
   PCLASSINFO(RTP_DataFrame, PBYTEArray);
 
   public:
+    /**Create a frame. The buffer comes from RTP_FramePool where it fits, as
+       do the copies made by MakeUnique() and growth by SetSize(). A frame
+       created with \p dynamic false uses \p data in place until it is
+       resized or made unique.
+      */
     RTP_DataFrame(PINDEX payloadSize = 0, PINDEX bufferSize = 0);
     RTP_DataFrame(const BYTE * data, PINDEX len, PBoolean dynamic = true);
+    ~RTP_DataFrame();
+
+    // Overrides from PContainer, to keep the buffer in the pool
+    virtual PBoolean SetSize(PINDEX newSize);
+    virtual PBoolean MakeUnique();
+
+#if !PMEMORY_CHECK
+    // Frames in lists are allocated per packet, so come from a pool too
+    void * operator new(size_t nSize);
+    void operator delete(void * ptr, size_t nSize);
+#endif
 
     enum {
       ProtocolVersion = 2,
@@ -217,10 +237,17 @@ class RTP_DataFrame : public PBYTEArray
     bool SetPacketSize(PINDEX sz);
 
   protected:
+    virtual void DestroyContents();
+    virtual void AssignContents(const PContainer & c);
+    bool AdoptPoolBuffer(PINDEX newSize);
+    bool UsingPoolBlock();
+
     PINDEX m_headerSize;
     PINDEX m_payloadSize;
     PINDEX m_paddingSize;
 
+    RTP_FramePool::Block * m_poolBlock;
+
 #if PTRACING
     friend ostream & operator<<(ostream & o, PayloadTypes t);
 #endif
@@ -607,6 +634,11 @@ class RTP_Session : public PObject
      */
     unsigned GetJitterTimeUnits() const { return m_timeUnits; }
 
+    /**Get the reactor receiving for this session.
+       Returns NULL if the session reads its sockets in its own thread.
+      */
+    virtual RTP_Reactor * GetReactor() const { return NULL; }
+
     /**Modifies the QOS specifications for this RTP session*/
     virtual PBoolean ModifyQOS(RTP_QOS * )
     { return false; }
@@ -647,6 +679,17 @@ class RTP_Session : public PObject
       bool rewriteTimeStamp = true
     );
 
+    /**Start holding the data frames written by this thread, to be sent
+       together by EndWriteBatch(). Frames written by other threads are sent
+       as usual. Audio sessions, where a frame is a single packet, do not
+       hold frames.
+      */
+    virtual void StartWriteBatch() { }
+
+    /**Send the data frames held since StartWriteBatch() and stop holding.
+      */
+    virtual bool EndWriteBatch() { return true; }
+
     /**Write a control frame from the RTP channel.
       */
     virtual PBoolean WriteControl(
@@ -1049,24 +1092,6 @@ class RTP_Session : public PObject
     typedef PSafePtr<RTP_JitterBuffer, PSafePtrMultiThreaded> JitterBufferPtr;
     JitterBufferPtr m_jitterBuffer;
 
-#if gaoshaobo
-    /*************************gaoshaobo for srtp */
-
-
-    srtp_policy_t 	policyOut_audio, policyIn_audio;
-    srtp_ctx_t		  *ctxOut_audio, *ctxIn_audio;
-
-public:
-//    static unsigned char* key_audio;
-    static PBoolean inited;
-    static int audio_srtp;
-  protected:
-    PBoolean createdOut_audio, createdIn_audio;
-
-
-    /*************************gaoshaobo for srtp */
-#endif
-
 #if bruce
 //    int zrtp_sender(const zrtp_stream_t * stream, char* packet, unsigned int length);
 //    void *zrtp_recv(void*);
@@ -1327,6 +1352,53 @@ class RTP_UDP : public RTP_Session
       PBoolean fromDataChannel
     );
 
+    /**Check the source of a PDU that has been read, learning the remote
+       address and port from it if not yet known.
+      */
+    virtual SendReceiveStatus OnReceivedPDU(
+      const PIPSocket::Address & addr,
+      WORD port,
+      bool fromDataChannel
+    );
+
+    /**Handle an error reading from the data or control socket.
+      */
+    virtual SendReceiveStatus OnReadError(
+      int errorNumber,
+      bool fromDataChannel,
+      PINDEX frameSize
+    );
+
+    virtual SendReceiveStatus OnReceivedDataPDU(RTP_DataFrame & frame, PINDEX pduSize);
+    virtual SendReceiveStatus OnReceivedControlPDU(RTP_ControlFrame & frame, PINDEX pduSize);
+
+  /**@name Shared reactor */
+  //@{
+    /**Have the reactor receive for this session instead of a thread of its
+       own. The session must be open and have no jitter buffer yet.
+      */
+    bool AttachReactor(
+      RTP_Reactor & reactor   ///< Reactor to receive on
+    );
+
+    /**Go back to reading the sockets in a thread of the session.
+       Must not be called with dataMutex held.
+      */
+    void DetachReactor();
+
+    /**Get the reactor receiving for this session.
+      */
+    virtual RTP_Reactor * GetReactor() const { return m_reactor; }
+
+    /**Called by the reactor when the data or control socket is readable.
+       Reads up to RTP_Reactor::MaxReadsPerEvent datagrams without blocking,
+       in a single batch for the data socket.
+      */
+    virtual void OnReactorReadable(
+      bool fromDataChannel
+    );
+  //@}
+
     virtual bool WriteDataPDU(RTP_DataFrame & frame);
     virtual bool WriteDataOrControlPDU(
       const BYTE * framePtr,
@@ -1334,27 +1406,30 @@ class RTP_UDP : public RTP_Session
       bool toDataChannel
     );
 
+    virtual void StartWriteBatch();
+    virtual bool EndWriteBatch();
+
     virtual void SetEncoding(const PString & newEncoding);
 
 #if bruce
 public:    
-//    static int zrtp_sender(const zrtp_stream_t * stream_audio,  char* packet, unsigned int length);
-   static int zrtp_sender_get(const zrtp_stream_t * stream_audio,  char* packet, unsigned int length);
-//    static void* zrtp_recv(void*);
-    int zrtp_recv();
-//    static PUDPSocket * sock_audio;
-    pthread_t thread_recv_zrtp_audio;
-    pthread_t thread_audio_stop;
-    static void* zrtp_audio_stop(void*);
-//    static PMutex zrtp_mutex;
-//    static int audio_zrtp;
-//    static PBoolean audio_zrtp_inited;
-
-//    PDECLARE_NOTIFIER(PThread, RTP_UDP, Recv_Thread);
-//    PThread * zrtp_recv_thread;	
-//    PMutex   zrtp_mutex;
-    static RTP_UDP* get_obj();
-    static RTP_UDP* rtp_udp_audio;	
+    /**libzrtp on_send_packet callback. The RTP_UDP the stream belongs to
+       is found through the stream user data.
+      */
+    static int zrtp_sender_get(const zrtp_stream_t * stream_audio,  char* packet, unsigned int length);
+
+  protected:
+    /**Held by zrtp_sender_get() while it uses the RTP_UDP, and by the
+       destructor while it detaches from the stream, as the callback runs on
+       the libzrtp scheduler thread.
+      */
+    static PMutex zrtpSenderMutex;
+
+    /**Pass a ZRTP protocol packet read on the data socket to libzrtp.
+       Returns true if the packet carried the ZRTP magic cookie and was
+       consumed, false if it is ordinary RTP.
+      */
+    bool HandleZRTPPacket(BYTE * packet, PINDEX length);
 #endif
   protected:
     PIPSocket::Address localAddress;
@@ -1381,6 +1456,27 @@ public:
 
     PTimer timerWriteDataIdle;
     PDECLARE_NOTIFIER(PTimer,  RTP_UDP, OnWriteDataIdle);
+
+    void ReadReactorBatch();
+    void QueueReactorFrame(const RTP_DataFrame & frame);
+    PBoolean ReadReactorFrame(RTP_DataFrame & frame);
+    bool SendPDU(const BYTE * framePtr, PINDEX frameSize, bool toDataChannel);
+    bool SendWriteBatch();
+
+    RTP_Reactor * m_reactor;
+    bool          m_reactorAborted;
+    std::queue<RTP_DataFrame> m_reactorFrames;
+    PMutex        m_reactorFramesMutex;
+    PSemaphore    m_reactorFramesAvailable;
+
+    PUDPSocket::Batch        * m_reactorBatch;
+    std::vector<RTP_DataFrame> m_reactorBatchFrames;
+
+    PUDPSocket::Batch        * m_writeBatch;
+    std::vector<PBYTEArray>    m_writeBatchBuffers;
+    PINDEX                     m_writeBatchCount;
+    bool                       m_writeBatching;
+    PThreadIdentifier          m_writeBatchThread;
 };
 
 /////////////////////////////////////////////////////////////////////////////
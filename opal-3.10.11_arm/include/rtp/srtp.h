@@ -63,6 +63,13 @@
 //     NULL_CIPHER_HMAC_SHA1_80
 //     STRONGHOLD
 //
+//  plus the SM4 modes, which use one shared key and leave RTCP in the clear:
+//
+//     SM4_SKF_HY_ECB, SM4_SKF_HY_CBC,
+//     SM4_SKF_ECB,    SM4_SKF_CBC,
+//     SM4_SDF_ECB,    SM4_SDF_CBC,    SM4_SDF_OFB,
+//     SM4_SOFT_ECB,   SM4_SOFT_CBC,   SM4_SOFT_OFB,   SM4_SOFT_CTR
+//
 
 class OpalSRTPSecurityMode : public OpalSecurityMode
 {
@@ -134,9 +141,14 @@ class LibSRTP_UDP : public OpalSRTP_UDP
     virtual SendReceiveStatus OnReceiveData(RTP_DataFrame & frame);
     virtual SendReceiveStatus OnSendControl(RTP_ControlFrame & frame, PINDEX & len);
     virtual SendReceiveStatus OnReceiveControl(RTP_ControlFrame & frame);
+
+  protected:
+    unsigned m_blockPadding;    ///< Pad RTP payloads to this block size, zero for none
+    bool     m_protectControl;  ///< RTCP is protected as well as RTP
 };
 
 PFACTORY_LOAD(LibSRTPSecurityMode_STRONGHOLD);
+PFACTORY_LOAD(LibSRTPSecurityMode_SM4_SKF_HY_ECB);
 
 
 #endif // OPAL_SRTP
@@ -103,7 +103,7 @@ OPAL_H450         = yes
 OPAL_H460         = yes
 OPAL_H501         = yes
 OPAL_T120DATA     = no
-OPAL_SRTP	  = no
+OPAL_SRTP	  = yes
 OPAL_RFC4175	  = yes
 OPAL_RFC2435	  = no
 OPAL_AEC          = yes
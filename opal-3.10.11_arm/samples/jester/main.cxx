@@ -94,6 +94,7 @@ void JesterProcess::Main()
   PArgList & args = GetArguments();
   args.Parse(
     "a-audiodevice:"
+    "B-benchmark:"
     "D-start-delta:"
     "d-drop."
     "j-jitter:"
@@ -131,6 +132,7 @@ void JesterProcess::Main()
             "  -i --init-gen-ts n    : Initial timestamp value for playback\n"
             "  -P --pcap file        : Read RTP data from PCAP file\n"
             "  -R                    : Non real time test\n"
+            "  -B --benchmark n      : Time jitter buffer write and read for n packets\n"
 #if PTRACING
             "  -t --trace            : Enable trace, use multiple times for more detail.\n"
             "  -o --output           : File for trace output, default is stderr.\n"
@@ -206,6 +208,11 @@ void JesterProcess::Main()
     m_generateJitter[change[0].AsUnsigned()] = change[1].AsUnsigned();
   }
 
+  if (args.HasOption('B')) {
+    Benchmark(args.GetOptionString('B').AsUnsigned());
+    return;
+  }
+
   if (!m_wavFile.Open(args.GetOptionString('w', "../callgen/ogm.wav"), PFile::ReadOnly)) {
     cerr << "the audio file " << m_wavFile.GetName() << " does not exist." << endl;
     return;
@@ -523,6 +530,62 @@ void JesterProcess::ManageUserInput()
 }
 
 
+void JesterProcess::Benchmark(unsigned packets)
+{
+  // Every this many packets, two arrive out of order
+  static const unsigned ReorderPeriod = 50;
+
+  DWORD frameTime = m_bytesPerBlock/2;
+  DWORD playbackTimestamp = m_playbackTimestamp;
+  unsigned delivered = 0;
+  PInt64 writeTime = 0;
+  PInt64 readTime = 0;
+  RTP_DataFrame readFrame(m_bytesPerBlock);
+
+  for (unsigned i = 0; i < packets; ++i) {
+    unsigned order = i;
+    if (i%ReorderPeriod == ReorderPeriod-2)
+      ++order;
+    else if (i%ReorderPeriod == ReorderPeriod-1)
+      --order;
+
+    // Made outside the timing, so only the jitter buffer is measured
+    RTP_DataFrame writeFrame(m_bytesPerBlock);
+    writeFrame.SetPayloadType(RTP_DataFrame::L16_Mono);
+    writeFrame.SetSequenceNumber((WORD)order);
+    writeFrame.SetTimestamp(m_generateTimestamp + order*frameTime);
+    writeFrame.SetMarker(order == 0);
+
+    readFrame.SetTimestamp(playbackTimestamp);
+
+    PInt64 writeStart = PTime().GetTimestamp();
+    m_jitterBuffer.WriteData(writeFrame);
+    PInt64 readStart = PTime().GetTimestamp();
+    m_jitterBuffer.ReadData(readFrame);
+    PInt64 readEnd = PTime().GetTimestamp();
+
+    writeTime += readStart - writeStart;
+    readTime += readEnd - readStart;
+
+    if (readFrame.GetPayloadSize() > 0)
+      ++delivered;
+    playbackTimestamp += frameTime;
+  }
+
+  cout << "  Packets written       = " << packets << "\n"
+          "  Packets delivered     = " << delivered << "\n"
+          "  Current Jitter Delay  = " << m_jitterBuffer.GetCurrentJitterDelay() << " ("
+       <<      m_jitterBuffer.GetCurrentJitterDelay()/SAMPLES_PER_MILLISECOND << "ms)\n"
+          "  Current packet depth  = " << m_jitterBuffer.GetCurrentDepth() << "\n"
+          "  Too late packet count = " << m_jitterBuffer.GetPacketsTooLate() << "\n"
+          "  Packet overrun count  = " << m_jitterBuffer.GetBufferOverruns() << "\n";
+  if (packets > 0)
+    cout << "  Write time per packet = " << writeTime*1000/packets << "ns\n"
+            "  Read time per packet  = " << readTime*1000/packets << "ns\n";
+  cout << endl;
+}
+
+
 void JesterProcess::Report()
 {
   cout << "  Generated jitter      = " << m_lastGeneratedJitter << "ms\n"
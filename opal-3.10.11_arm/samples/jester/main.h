@@ -60,7 +60,7 @@ class JesterJitterBuffer : public OpalJitterBuffer
  public:
     JesterJitterBuffer();
 
-    PINDEX GetCurrentDepth() const { return m_frames.size(); }
+    PINDEX GetCurrentDepth() const { return m_frameCount; }
     DWORD GetAverageFrameTime() const { return m_averageFrameTime; }
 };
 
@@ -96,6 +96,10 @@ class JesterProcess : public PProcess
 #endif
 
     void Report();
+
+    /**Time writing packets to, and reading them from, the jitter buffer,
+       one of each in turn as a media patch and RTP reader would. */
+    void Benchmark(unsigned packets);
     bool GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay);
 
     /**Handle user input, which is keys to describe the status of the program,
@@ -0,0 +1,308 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for RTP receive load testing
+ *
+ * Opens many audio RTP sessions on the loopback interface, each with a
+ * jitter buffer, and sends them a stream of packets at the audio frame
+ * rate. The sessions receive either with a thread each, as normal, or on a
+ * shared RTP_Reactor, so the CPU time and thread count of the two models
+ * can be compared at the same load. The RTP_FramePool counts show the
+ * buffer allocations and copies made while doing so. The jitter buffers
+ * can also be played out, on a shared OpalMediaClock, which reports how
+ * late its ticks were.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include "precompile.h"
+#include "main.h"
+
+#include <ptclib/delaychan.h>
+
+#include <sys/resource.h>
+
+
+PCREATE_PROCESS(RTPLoad);
+
+
+///////////////////////////////////////////////////////////////////////
+
+RTPLoad::RTPLoad()
+  : PProcess("OPAL RTP Load Tester", "RTPLoad", 1, 0, ReleaseCode, 0)
+  , m_sessionCount(100)
+  , m_seconds(10)
+  , m_frameTime(20)
+  , m_payloadSize(160)
+  , m_portBase(30000)
+  , m_reactor(NULL)
+  , m_clock(NULL)
+  , m_packetsSent(0)
+{
+}
+
+
+RTPLoad::~RTPLoad()
+{
+  if (m_clock != NULL) {
+    for (PList<Playout>::iterator it = m_playouts.begin(); it != m_playouts.end(); ++it)
+      m_clock->Remove(*it);
+    delete m_clock;
+  }
+  m_playouts.RemoveAll();
+
+  // Sessions detach themselves from the reactor as they are deleted
+  m_sessions.RemoveAll();
+  delete m_reactor;
+}
+
+
+void RTPLoad::Main()
+{
+  PArgList & args = GetArguments();
+
+  args.Parse("h-help."
+             "n-sessions:"
+             "s-seconds:"
+             "f-frame-time:"
+             "P-payload-size:"
+             "b-port-base:"
+             "r-reactor."
+             "l-loops:"
+             "c-clock."
+             "w-workers:"
+#if PTRACING
+             "o-output:"             "-no-output."
+             "t-trace."              "-no-trace."
+#endif
+             , FALSE);
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+         PTrace::Blocks | PTrace::Timestamp | PTrace::Thread | PTrace::FileAndLine);
+#endif
+
+  if (args.HasOption('h')) {
+    PError << "usage: " << GetFile().GetTitle() << " [ options ]\n"
+              "\n"
+              "Available options are:\n"
+              "  --help                   : print this help message.\n"
+              "  -n or --sessions N       : number of RTP sessions, default 100\n"
+              "  -s or --seconds N        : duration of test, default 10\n"
+              "  -f or --frame-time N     : milliseconds between packets per session, default 20\n"
+              "  -P or --payload-size N   : RTP payload bytes, default 160\n"
+              "  -b or --port-base N      : first local UDP port, default 30000\n"
+              "  -r or --reactor          : receive on a shared RTP_Reactor\n"
+              "  -l or --loops N          : reactor event loops, default one per CPU\n"
+              "  -c or --clock            : play out jitter buffers on a shared media clock\n"
+              "  -w or --workers N        : media clock workers, default one per CPU\n"
+#if PTRACING
+              "  -o or --output file     : file name for output of log messages\n"
+              "  -t or --trace           : degree of verbosity in error log (more times for more detail)\n"
+#endif
+              "\n"
+              "e.g. " << GetFile().GetTitle() << " -n 500 -r\n\n";
+    return;
+  }
+
+  if (args.HasOption('n'))
+    m_sessionCount = args.GetOptionString('n').AsUnsigned();
+  if (args.HasOption('s'))
+    m_seconds = args.GetOptionString('s').AsUnsigned();
+  if (args.HasOption('f'))
+    m_frameTime = args.GetOptionString('f').AsUnsigned();
+  if (args.HasOption('P'))
+    m_payloadSize = args.GetOptionString('P').AsUnsigned();
+  if (args.HasOption('b'))
+    m_portBase = (WORD)args.GetOptionString('b').AsUnsigned();
+
+  if (args.HasOption('r')) {
+    m_reactor = new RTP_Reactor(args.GetOptionString('l').AsUnsigned());
+    if (!m_reactor->Start()) {
+      cerr << "Could not start RTP reactor on this platform" << endl;
+      return;
+    }
+  }
+
+  if (args.HasOption('c')) {
+    m_clock = new OpalMediaClock(args.GetOptionString('w').AsUnsigned());
+    if (!m_clock->Start()) {
+      cerr << "Could not start media clock on this platform" << endl;
+      return;
+    }
+  }
+
+  if (!OpenSessions())
+    return;
+
+  cout << "Receiving " << m_sessionCount << " sessions "
+       << (m_reactor != NULL ? "on reactor with " + PString(m_reactor->GetLoopCount()) + " loops"
+                             : PString("with a thread each"))
+       << ", " << m_payloadSize << " bytes every " << m_frameTime << "ms for "
+       << m_seconds << " seconds" << endl;
+  if (m_clock != NULL)
+    cout << "Playing out on media clock with " << m_clock->GetWorkerCount() << " workers" << endl;
+
+  SendMedia();
+  Report();
+}
+
+
+bool RTPLoad::OpenSessions()
+{
+  PIPSocket::Address loopback(127, 0, 0, 1);
+  WORD port = m_portBase;
+
+  for (unsigned i = 0; i < m_sessionCount; ++i) {
+    RTP_Session::Params params;
+    params.id = 1;
+    params.encoding = "rtp/avp";
+    params.isAudio = true;
+
+    RTP_UDP * session = new RTP_UDP(params);
+    if (!session->Open(loopback, port, (WORD)(port + 999), 0)) {
+      cerr << "Could not open RTP session " << i << " from port " << port << endl;
+      delete session;
+      return false;
+    }
+    port = (WORD)(session->GetLocalControlPort() + 1);
+
+    if (m_reactor != NULL && !session->AttachReactor(*m_reactor)) {
+      cerr << "Could not attach RTP session " << i << " to reactor" << endl;
+      delete session;
+      return false;
+    }
+
+    // 40ms to 250ms at 8kHz, as an audio stream would have
+    session->SetJitterBufferSize(40*8, 250*8, 8);
+    m_sessions.Append(session);
+
+    if (m_clock != NULL) {
+      Playout * playout = new Playout(*session, m_frameTime);
+      m_playouts.Append(playout);
+      m_clock->Add(*playout, m_frameTime);
+    }
+  }
+
+  if (!m_sender.Listen(loopback)) {
+    cerr << "Could not open sender socket: " << m_sender.GetErrorText() << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+void RTPLoad::SendMedia()
+{
+  std::vector<RTP_DataFrame> frames(m_sessionCount);
+  for (unsigned i = 0; i < m_sessionCount; ++i) {
+    frames[i].SetPayloadSize(m_payloadSize);
+    frames[i].SetPayloadType(RTP_DataFrame::PCMU);
+    frames[i].SetSyncSource(0x10000 + i);
+    memset(frames[i].GetPayloadPtr(), 0xff, m_payloadSize);
+  }
+
+  PIPSocket::Address loopback(127, 0, 0, 1);
+  PAdaptiveDelay delay;
+  PTime endTime = PTime() + PTimeInterval(0, m_seconds);
+
+  for (WORD sequence = 0; PTime() < endTime; ++sequence) {
+    for (unsigned i = 0; i < m_sessionCount; ++i) {
+      frames[i].SetSequenceNumber(sequence);
+      frames[i].SetTimestamp(sequence*m_frameTime*8);
+      if (m_sender.WriteTo(frames[i].GetPointer(), frames[i].GetHeaderSize()+m_payloadSize,
+                           loopback, m_sessions[i].GetLocalDataPort()))
+        ++m_packetsSent;
+    }
+    delay.Delay(m_frameTime);
+  }
+
+  // Let the last packets arrive
+  PThread::Sleep(m_frameTime*2);
+}
+
+
+void RTPLoad::Report()
+{
+  DWORD received = 0;
+  for (PList<RTP_UDP>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it)
+    received += it->GetPacketsReceived();
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1e6 +
+               usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1e6;
+
+  PString threads = "?";
+  PTextFile status("/proc/self/status", PFile::ReadOnly);
+  PString line;
+  while (status.ReadLine(line)) {
+    if (line.NumCompare("Threads:") == EqualTo) {
+      threads = line.Mid(8).Trim();
+      break;
+    }
+  }
+
+  RTP_FramePool::Statistics pool = RTP_FramePool::GetStatistics();
+
+  cout << "Sent " << m_packetsSent << " packets, received " << received
+       << " (" << (m_packetsSent > 0 ? 100.0*received/m_packetsSent : 0.0) << "%)\n"
+          "CPU time " << cpu << "s, "
+       << (m_seconds > 0 ? 100.0*cpu/m_seconds : 0.0) << "% of one core, "
+       << threads << " threads\n"
+          "Frame pool allocated " << pool.m_packetBlocks << " packet and "
+       << pool.m_jumboBlocks << " jumbo blocks, "
+       << pool.m_heapFrames << " frames on heap, "
+       << pool.m_copies << " frame copies" << endl;
+
+  if (m_clock != NULL) {
+    DWORD played = 0;
+    for (PList<Playout>::iterator it = m_playouts.begin(); it != m_playouts.end(); ++it)
+      played += it->m_framesPlayed;
+
+    cout << "Played " << played << " frames from jitter buffers\n"
+            "Media clock " << *m_clock << endl;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+RTPLoad::Playout::Playout(RTP_UDP & session, unsigned frameTime)
+  : m_session(session)
+  , m_timestamp(0)
+  , m_timestampStep(frameTime*8)
+  , m_framesPlayed(0)
+{
+}
+
+
+bool RTPLoad::Playout::OnMediaClockTick()
+{
+  m_frame.SetTimestamp(m_timestamp);
+  m_timestamp += m_timestampStep;
+
+  if (!m_session.ReadBufferedData(m_frame))
+    return false;
+
+  if (m_frame.GetPayloadSize() > 0)
+    ++m_framesPlayed;
+  return true;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
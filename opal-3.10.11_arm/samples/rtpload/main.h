@@ -0,0 +1,78 @@
+/*
+ * main.h
+ *
+ * OPAL application source file for RTP receive load testing
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef _RTPLoad_MAIN_H
+#define _RTPLoad_MAIN_H
+
+
+class RTP_UDP;
+class RTP_Reactor;
+class OpalMediaClock;
+
+
+class RTPLoad : public PProcess
+{
+  PCLASSINFO(RTPLoad, PProcess)
+
+  public:
+    RTPLoad();
+    ~RTPLoad();
+
+    virtual void Main();
+
+  protected:
+    // Reads one frame from the jitter buffer of a session each tick, as a media patch would
+    class Playout : public PObject, public OpalMediaClock::Client
+    {
+      PCLASSINFO(Playout, PObject)
+      public:
+        Playout(RTP_UDP & session, unsigned frameTime);
+        virtual bool OnMediaClockTick();
+
+        RTP_UDP     & m_session;
+        RTP_DataFrame m_frame;
+        DWORD         m_timestamp;
+        DWORD         m_timestampStep;
+        DWORD         m_framesPlayed;
+    };
+
+    bool OpenSessions();
+    void SendMedia();
+    void Report();
+
+    unsigned m_sessionCount;
+    unsigned m_seconds;
+    unsigned m_frameTime;
+    unsigned m_payloadSize;
+    WORD     m_portBase;
+
+    RTP_Reactor        * m_reactor;
+    OpalMediaClock     * m_clock;
+    PList<RTP_UDP>       m_sessions;
+    PList<Playout>       m_playouts;
+    PUDPSocket           m_sender;
+    DWORD                m_packetsSent;
+};
+
+
+#endif  // _RTPLoad_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,31 @@
+/*
+ * precompile.h
+ *
+ * OPAL application source file for RTP receive load testing
+ *
+ * Precompiled header generation file.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/sockets.h>
+#include <rtp/rtp.h>
+#include <rtp/reactor.h>
+#include <opal/mediaclock.h>
+
+
+// End of File ///////////////////////////////////////////////////////////////
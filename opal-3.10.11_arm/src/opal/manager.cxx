@@ -47,6 +47,8 @@
 #include <codec/rfc4175.h>
 #include <codec/rfc2435.h>
 #include <codec/opalpluginmgr.h>
+#include <rtp/reactor.h>
+#include <opal/mediaclock.h>
 
 #if OPAL_HAS_H224
 #include <h224/h224.h>
@@ -215,6 +217,10 @@ OpalManager::OpalManager()
   , m_defaultMediaTypeOfService(0xb8)  // New DiffServ value for Expidited Forwarding as per RFC3246
   , rtpPayloadSizeMax(1400) // RFC879 recommends 576 bytes, but that is ancient history, 99.999% of the time 1400+ bytes is used.
   , rtpPacketSizeMax(2048)
+  , m_rtpReactor(NULL)
+  , m_useRTPReactor(false)
+  , m_mediaClock(NULL)
+  , m_useMediaClock(false)
   , minAudioJitterDelay(50)  // milliseconds
   , maxAudioJitterDelay(250) // milliseconds
   , mediaFormatOrder(PARRAYSIZE(DefaultMediaFormatOrder), DefaultMediaFormatOrder)
@@ -290,6 +296,10 @@ OpalManager::~OpalManager()
 
   delete garbageCollector;
 
+  // All sessions are gone with the calls, so the reactor can go too
+  delete m_rtpReactor;
+  delete m_mediaClock;
+
   delete stun;
   delete interfaceMonitor;
   delete m_imManager;
@@ -872,6 +882,50 @@ RTP_UDP * OpalManager::CreateRTPSession (const RTP_Session::Params & params)
 }
 
 
+bool OpalManager::SetRTPReactor(bool enable, unsigned loops)
+{
+  if (!enable) {
+    // Sessions already attached keep it until they close
+    m_useRTPReactor = false;
+    return true;
+  }
+
+  if (m_rtpReactor == NULL) {
+    m_rtpReactor = new RTP_Reactor(loops);
+    if (!m_rtpReactor->Start()) {
+      delete m_rtpReactor;
+      m_rtpReactor = NULL;
+      return false;
+    }
+  }
+
+  m_useRTPReactor = true;
+  return true;
+}
+
+
+bool OpalManager::SetMediaClock(bool enable, unsigned workers)
+{
+  if (!enable) {
+    // Patches already ticked keep it until they close
+    m_useMediaClock = false;
+    return true;
+  }
+
+  if (m_mediaClock == NULL) {
+    m_mediaClock = new OpalMediaClock(workers);
+    if (!m_mediaClock->Start()) {
+      delete m_mediaClock;
+      m_mediaClock = NULL;
+      return false;
+    }
+  }
+
+  m_useMediaClock = true;
+  return true;
+}
+
+
 void OpalManager::OnRTPStatistics(const OpalConnection & connection, const RTP_Session & session)
 {
   connection.GetCall().OnRTPStatistics(connection, session);
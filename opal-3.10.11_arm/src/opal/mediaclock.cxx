@@ -0,0 +1,411 @@
+/*
+ * mediaclock.cxx
+ *
+ * Shared timer for pacing media
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "mediaclock.h"
+#endif
+
+#include <opal/buildopts.h>
+
+#include <opal/mediaclock.h>
+
+#if OPAL_MEDIA_CLOCK
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+#define new PNEW
+
+
+static const unsigned LatenessLimits[OpalMediaClock::LatenessBuckets] = {
+  100, 250, 500, 1000, 2000, 5000, 10000, 0
+};
+
+
+// Nanoseconds on a clock that is not changed by setting the time of day
+static PInt64 GetMonotonicTime()
+{
+#if OPAL_MEDIA_CLOCK
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec*(PInt64)1000000000 + now.tv_nsec;
+#else
+  return PTimer::Tick().GetMilliSeconds()*1000000;
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalMediaClock::Worker::Worker()
+  : m_timer(-1)
+  , m_timerDeadline(0)
+  , m_thread(NULL)
+  , m_clientCount(0)
+{
+  memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+
+OpalMediaClock::OpalMediaClock(unsigned workerCount)
+  : m_workerCount(workerCount)
+  , m_running(false)
+  , m_workers(NULL)
+{
+#if OPAL_MEDIA_CLOCK
+  if (m_workerCount == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    m_workerCount = cpus > 0 ? (unsigned)cpus : 1;
+  }
+#else
+  if (m_workerCount == 0)
+    m_workerCount = 1;
+#endif
+}
+
+
+OpalMediaClock::~OpalMediaClock()
+{
+  Stop();
+
+  for (RegistrationMap::iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+    PTRACE(2, "MediaClock\tClient " << (void *)it->first << " still added on destruction");
+  }
+
+  if (m_workers != NULL) {
+    for (unsigned i = 0; i < m_workerCount; ++i) {
+      Worker & worker = m_workers[i];
+      for (std::vector<Registration *>::iterator it = worker.m_registrations.begin(); it != worker.m_registrations.end(); ++it)
+        delete *it;
+#if OPAL_MEDIA_CLOCK
+      if (worker.m_timer >= 0)
+        ::close(worker.m_timer);
+#endif
+    }
+  }
+
+  delete [] m_workers;
+}
+
+
+void OpalMediaClock::PrintOn(ostream & strm) const
+{
+  Statistics stats = GetStatistics();
+
+  strm << "workers=" << m_workerCount
+       << " clients=" << GetClientCount()
+       << " ticks=" << stats.m_ticks
+       << " skipped=" << stats.m_skippedTicks
+       << " max-late=" << stats.m_maxLateness << "us"
+       << " late:";
+
+  for (PINDEX i = 0; i < LatenessBuckets; ++i) {
+    if (LatenessLimits[i] != 0)
+      strm << " <" << LatenessLimits[i];
+    else
+      strm << " >=" << LatenessLimits[i-1];
+    strm << "us=" << stats.m_lateness[i];
+  }
+}
+
+
+bool OpalMediaClock::Start()
+{
+#if OPAL_MEDIA_CLOCK
+  if (m_running)
+    return true;
+
+  if (m_workers == NULL) {
+    m_workers = new Worker[m_workerCount];
+
+    for (unsigned i = 0; i < m_workerCount; ++i) {
+      m_workers[i].m_timer = timerfd_create(CLOCK_MONOTONIC, 0);
+      if (m_workers[i].m_timer < 0) {
+        PTRACE(1, "MediaClock\tCould not create timer: " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+        return false;
+      }
+    }
+  }
+
+  m_running = true;
+
+  for (unsigned i = 0; i < m_workerCount; ++i)
+    m_workers[i].m_thread = PThread::Create(PCREATE_NOTIFIER(WorkerMain), i,
+                                            PThread::NoAutoDeleteThread,
+                                            PThread::HighestPriority,
+                                            "Media Clock:%x");
+
+  PTRACE(3, "MediaClock\tStarted " << m_workerCount << " workers");
+  return true;
+#else
+  PTRACE(2, "MediaClock\tNot supported on this platform, media patches use their own threads");
+  return false;
+#endif
+}
+
+
+void OpalMediaClock::Stop()
+{
+  if (!m_running)
+    return;
+
+  m_running = false;
+
+  // Fire each timer now, so the worker wakes up and sees it is to stop
+  for (unsigned i = 0; i < m_workerCount; ++i) {
+    PWaitAndSignal mutex(m_workers[i].m_mutex);
+    SetTimer(m_workers[i], GetMonotonicTime());
+  }
+
+  for (unsigned i = 0; i < m_workerCount; ++i) {
+    Worker & worker = m_workers[i];
+    if (worker.m_thread != NULL) {
+      PAssert(worker.m_thread->WaitForTermination(10000), "Media clock thread did not terminate");
+      delete worker.m_thread;
+      worker.m_thread = NULL;
+    }
+  }
+
+  PTRACE(3, "MediaClock\tStopped workers: " << *this);
+}
+
+
+bool OpalMediaClock::Add(Client & client, unsigned interval)
+{
+  if (!m_running || !PAssert(interval > 0, PInvalidParameter))
+    return false;
+
+  Registration * registration;
+
+  {
+    PWaitAndSignal mutex(m_clientsMutex);
+
+    if (m_clients.find(&client) != m_clients.end())
+      return true;
+
+    unsigned index = 0;
+    for (unsigned i = 1; i < m_workerCount; ++i) {
+      if (m_workers[i].m_clientCount < m_workers[index].m_clientCount)
+        index = i;
+    }
+
+    registration = new Registration;
+    registration->m_client = &client;
+    registration->m_worker = index;
+    registration->m_interval = interval*(PInt64)1000000;
+    registration->m_deadline = GetMonotonicTime() + registration->m_interval;
+    registration->m_removed = false;
+    registration->m_ended = false;
+
+    ++m_workers[index].m_clientCount;
+    m_clients[&client] = registration;
+  }
+
+  /* The worker mutex is not taken with the clients mutex held, as a client
+     may call Remove() from within a tick, which is with the worker mutex
+     held. */
+  Worker & worker = m_workers[registration->m_worker];
+  PWaitAndSignal mutex(worker.m_mutex);
+
+  worker.m_registrations.push_back(registration);
+  if (worker.m_timerDeadline == 0 || registration->m_deadline < worker.m_timerDeadline)
+    SetTimer(worker, registration->m_deadline);
+
+  PTRACE(4, "MediaClock\tClient " << (void *)&client << " added to worker "
+         << registration->m_worker << " every " << interval << "ms");
+  return true;
+}
+
+
+bool OpalMediaClock::Remove(Client & client)
+{
+  Registration * registration;
+
+  {
+    PWaitAndSignal mutex(m_clientsMutex);
+
+    RegistrationMap::iterator it = m_clients.find(&client);
+    if (it == m_clients.end())
+      return false;
+
+    registration = it->second;
+    m_clients.erase(it);
+    --m_workers[registration->m_worker].m_clientCount;
+  }
+
+  /* Taking the worker mutex waits out any tick in progress. The worker frees
+     the registration after its next round of ticks, as it may be part way
+     through the list of them, if this is called from within a tick. */
+  PWaitAndSignal mutex(m_workers[registration->m_worker].m_mutex);
+
+  registration->m_removed = true;
+
+  PTRACE(4, "MediaClock\tClient " << (void *)&client << " removed from worker " << registration->m_worker);
+  return !registration->m_ended;
+}
+
+
+PINDEX OpalMediaClock::GetClientCount() const
+{
+  PWaitAndSignal mutex(m_clientsMutex);
+  return m_clients.size();
+}
+
+
+OpalMediaClock::Statistics OpalMediaClock::GetStatistics() const
+{
+  Statistics stats;
+  memset(&stats, 0, sizeof(stats));
+
+  for (unsigned i = 0; m_workers != NULL && i < m_workerCount; ++i) {
+    Worker & worker = m_workers[i];
+    PWaitAndSignal mutex(worker.m_mutex);
+
+    stats.m_ticks += worker.m_statistics.m_ticks;
+    stats.m_skippedTicks += worker.m_statistics.m_skippedTicks;
+    if (stats.m_maxLateness < worker.m_statistics.m_maxLateness)
+      stats.m_maxLateness = worker.m_statistics.m_maxLateness;
+    for (PINDEX bucket = 0; bucket < LatenessBuckets; ++bucket)
+      stats.m_lateness[bucket] += worker.m_statistics.m_lateness[bucket];
+  }
+
+  return stats;
+}
+
+
+unsigned OpalMediaClock::GetLatenessLimit(PINDEX bucket)
+{
+  return bucket >= 0 && bucket < LatenessBuckets ? LatenessLimits[bucket] : 0;
+}
+
+
+void OpalMediaClock::SetTimer(Worker & worker, PInt64 deadline)
+{
+  worker.m_timerDeadline = deadline;
+
+#if OPAL_MEDIA_CLOCK
+  // One shot, at an absolute time, so it does not drift with the time taken to set it
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = (time_t)(deadline/1000000000);
+  spec.it_value.tv_nsec = (long)(deadline%1000000000);
+  if (timerfd_settime(worker.m_timer, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+    PTRACE(1, "MediaClock\tCould not set timer: " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+  }
+#endif
+}
+
+
+void OpalMediaClock::TickClients(Worker & worker, PInt64 now)
+{
+  PWaitAndSignal mutex(worker.m_mutex);
+
+  PInt64 nextDeadline = 0;
+
+  // By index, as a client may add another to this worker from within a tick
+  for (size_t i = 0; i < worker.m_registrations.size(); ++i) {
+    Registration & registration = *worker.m_registrations[i];
+    if (registration.m_removed || registration.m_ended)
+      continue;
+
+    if (registration.m_deadline <= now) {
+      unsigned lateness = (unsigned)PMIN((now - registration.m_deadline)/1000, (PInt64)UINT_MAX);
+
+      Statistics & stats = worker.m_statistics;
+      ++stats.m_ticks;
+      if (stats.m_maxLateness < lateness)
+        stats.m_maxLateness = lateness;
+      PINDEX bucket = 0;
+      while (LatenessLimits[bucket] != 0 && lateness >= LatenessLimits[bucket])
+        ++bucket;
+      ++stats.m_lateness[bucket];
+
+      if (!registration.m_client->OnMediaClockTick()) {
+        registration.m_ended = true;
+        PTRACE(4, "MediaClock\tClient " << (void *)registration.m_client << " ended ticks");
+        continue;
+      }
+
+      registration.m_deadline += registration.m_interval;
+
+      // Anything still due is ticked again straight away, unless too far behind
+      now = GetMonotonicTime();
+      if (now - registration.m_deadline > MaxCatchUpTicks*registration.m_interval) {
+        PInt64 skipped = (now - registration.m_deadline)/registration.m_interval + 1;
+        registration.m_deadline += skipped*registration.m_interval;
+        stats.m_skippedTicks += skipped;
+        PTRACE(3, "MediaClock\tClient " << (void *)registration.m_client << " skipped " << skipped << " ticks");
+      }
+    }
+
+    if (nextDeadline == 0 || registration.m_deadline < nextDeadline)
+      nextDeadline = registration.m_deadline;
+  }
+
+  std::vector<Registration *>::iterator it = worker.m_registrations.begin();
+  while (it != worker.m_registrations.end()) {
+    if ((*it)->m_removed) {
+      delete *it;
+      it = worker.m_registrations.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  if (nextDeadline != 0)
+    SetTimer(worker, nextDeadline);
+  else
+    worker.m_timerDeadline = 0;
+}
+
+
+void OpalMediaClock::WorkerMain(PThread &, INT index)
+{
+#if OPAL_MEDIA_CLOCK
+  Worker & worker = m_workers[index];
+
+  PTRACE(4, "MediaClock\tWorker " << index << " started");
+
+  while (m_running) {
+    uint64_t expirations;
+    if (::read(worker.m_timer, &expirations, sizeof(expirations)) < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "MediaClock\tWorker " << index << " timer error: "
+             << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+      break;
+    }
+
+    if (m_running)
+      TickClients(worker, GetMonotonicTime());
+  }
+
+  PTRACE(4, "MediaClock\tWorker " << index << " finished");
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -339,6 +339,17 @@ bool OpalMediaStream::InternalWriteData(const BYTE * data, PINDEX length, PINDEX
 }
 
 
+void OpalMediaStream::StartWriteBatch()
+{
+}
+
+
+bool OpalMediaStream::EndWriteBatch()
+{
+  return true;
+}
+
+
 PBoolean OpalMediaStream::ReadData(BYTE * buffer, PINDEX size, PINDEX & length)
 {
   if (!isOpen) {
@@ -412,6 +423,12 @@ PBoolean OpalMediaStream::RequiresPatchThread() const
 }
 
 
+bool OpalMediaStream::CanBeClockTicked() const
+{
+  return false;
+}
+
+
 bool OpalMediaStream::EnableJitterBuffer(bool) const
 {
   return false;
@@ -631,6 +648,12 @@ PBoolean OpalNullMediaStream::IsSynchronous() const
 }
 
 
+bool OpalNullMediaStream::CanBeClockTicked() const
+{
+  return !m_isSynchronous;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 OpalRTPMediaStream::OpalRTPMediaStream(OpalRTPConnection & conn,
@@ -739,6 +762,19 @@ PBoolean OpalRTPMediaStream::WritePacket(RTP_DataFrame & packet)
 }
 
 
+void OpalRTPMediaStream::StartWriteBatch()
+{
+  if (IsSink())
+    rtpSession.StartWriteBatch();
+}
+
+
+bool OpalRTPMediaStream::EndWriteBatch()
+{
+  return !IsSink() || rtpSession.EndWriteBatch();
+}
+
+
 PBoolean OpalRTPMediaStream::SetDataSize(PINDEX PTRACE_PARAM(dataSize), PINDEX /*frameTime*/)
 {
   PTRACE(3, "Media\tRTP data size cannot be changed to " << dataSize << ", fixed at " << defaultDataSize);
@@ -753,6 +789,12 @@ PBoolean OpalRTPMediaStream::IsSynchronous() const
 }
 
 
+bool OpalRTPMediaStream::CanBeClockTicked() const
+{
+  return IsSink() || rtpSession.GetJitterBufferSize() > 0;
+}
+
+
 PBoolean OpalRTPMediaStream::RequiresPatchThread() const
 {
   return !dynamic_cast<OpalRTPEndPoint &>(connection.GetEndPoint()).CheckForLocalRTP(*this);
@@ -46,6 +46,10 @@
 #include <h323/channels.h>
 #endif
 
+#if OPAL_SRTP
+#include <rtp/srtp.h>
+#endif
+
 
 OPAL_INSTANTIATE_MEDIATYPE(audio, OpalAudioMediaType);
 
@@ -159,6 +163,18 @@ RTP_UDP * OpalMediaTypeDefinition::CreateRTPSession(OpalRTPConnection & connecti
   params.isAudio = m_mediaType == OpalMediaType::Audio();
   params.remoteIsNAT = remoteIsNAT;
 
+#if OPAL_SRTP
+  const PString & securityMode = connection.GetSecurityMode();
+  if (!securityMode.IsEmpty()) {
+    OpalSecurityMode * parms = PFactory<OpalSecurityMode>::CreateInstance(securityMode);
+    if (parms == NULL) {
+      PTRACE(1, "MediaType\tUnknown security mode " << securityMode);
+      return NULL;
+    }
+    return parms->CreateRTPSession(connection, params);
+  }
+#endif
+
   return connection.GetEndPoint().GetManager().CreateRTPSession(params);
 }
 
@@ -1055,6 +1055,12 @@ PBoolean OpalMixerMediaStream::IsSynchronous() const
 }
 
 
+bool OpalMixerMediaStream::CanBeClockTicked() const
+{
+  return true;
+}
+
+
 PBoolean OpalMixerMediaStream::RequiresPatchThread() const
 {
   return !isSource;
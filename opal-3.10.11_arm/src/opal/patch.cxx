@@ -41,6 +41,9 @@
 #include <opal/patch.h>
 #include <opal/mediastrm.h>
 #include <opal/transcoders.h>
+#include <opal/connection.h>
+#include <opal/endpoint.h>
+#include <opal/manager.h>
 
 #if OPAL_VIDEO
 #include <codec/vidcodec.h>
@@ -56,6 +59,11 @@ OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
   , m_bypassToPatch(NULL)
   , m_bypassFromPatch(NULL)
   , patchThread(NULL)
+  , m_mediaClock(NULL)
+  , m_clockFrame(0)
+  , m_mediaPatchStarted(false)
+  , m_asynchronous(false)
+  , beforepatch(NULL)
 {
   PTRACE(5, "Patch\tCreated media patch " << this << ", session " << src.GetSessionID());
   src.SetPatch(this);
@@ -97,7 +105,14 @@ void OpalMediaPatch::Start()
 {
   PWaitAndSignal m(patchThreadMutex);
 	
-  if(patchThread != NULL) 
+  if(patchThread != NULL || m_mediaClock != NULL) 
+    return;
+
+  startpatchrecord = 0;
+  if (source.GetMediaFormat()=="G.711-uLaw-64k")
+	  beforepatch = fopen("/home/root/record/beforepatch.g711","wb");
+
+  if (StartMediaClock())
     return;
 	
   patchThread = new Thread(*this);
@@ -107,13 +122,68 @@ void OpalMediaPatch::Start()
 }
 
 
+bool OpalMediaPatch::StartMediaClock()
+{
+  OpalMediaClock * clock = source.GetConnection().GetEndPoint().GetManager().GetMediaClock();
+  if (clock == NULL)
+    return false;
+
+  OpalMediaFormat format = source.GetMediaFormat();
+  if (format.GetMediaType() != OpalMediaType::Audio())
+    return false;
+
+  /* A source or sink that blocks or paces itself, such as a sound device or
+     file, would hold up all the other patches ticked by the same worker, so
+     those keep a thread. */
+  {
+    PSafeLockReadOnly mutex(*this);
+    for (PList<Sink>::iterator s = sinks.begin(); s != sinks.end(); ++s) {
+      if (!s->stream->CanBeClockTicked())
+        return false;
+    }
+  }
+
+  m_mediaPatchStarted = true;
+  m_asynchronous = OnStartMediaPatch();
+  if (!m_asynchronous)
+    return false;
+
+  // Whether the source has a jitter buffer to read from is only known now
+  if (!source.CanBeClockTicked())
+    return false;
+
+  /* Tick at the packet time, but no slower than the patch thread would
+     read, as the jitter buffer gives one packet per read whatever size the
+     remote sends. */
+  unsigned interval = format.GetFrameTime()*format.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1);
+  if (format.GetTimeUnits() > 0)
+    interval /= format.GetTimeUnits();
+  if (interval == 0 || interval > 10)
+    interval = 10;
+
+  if (!clock->Add(*this, interval))
+    return false;
+
+  m_mediaClock = clock;
+  PTRACE(4, "Patch\tTicking every " << interval << "ms from media clock " << *this);
+  return true;
+}
+
+
 void OpalMediaPatch::StopThread()
 {
   patchThreadMutex.Wait();
   PThread * thread = patchThread;
   patchThread = NULL;
+  OpalMediaClock * clock = m_mediaClock;
+  m_mediaClock = NULL;
+  m_mediaPatchStarted = false; // So the next Start() does it again
   patchThreadMutex.Signal();
 
+  // Still being ticked, so stop as the thread would have on the source closing
+  if (clock != NULL && clock->Remove(*this))
+    source.OnStopMediaPatch(*this);
+
   if (thread == NULL)
     return;
 
@@ -564,14 +634,15 @@ void OpalMediaPatch::Main()
 {
   PTRACE(4, "Patch\tThread started for " << *this);
 	
-  bool asynchronous = OnStartMediaPatch();
+  // Already done if the patch was offered to the media clock first
+  if (m_mediaPatchStarted)
+    m_mediaPatchStarted = false;
+  else
+    m_asynchronous = OnStartMediaPatch();
+  bool asynchronous = m_asynchronous;
   PAdaptiveDelay asynchPacing;
   PThread::Times lastThreadTimes;
   PTimeInterval lastTick;
-  startpatchrecord = 0;
-  beforepatch = NULL;
-  if (source.GetMediaFormat()=="G.711-uLaw-64k")
-	  beforepatch = fopen("/home/root/record/beforepatch.g711","wb");
 
   /* Note the RTP frame is outside loop so that a) it is more efficient
      for memory usage, the buffer is only ever increased and not allocated
@@ -593,30 +664,8 @@ void OpalMediaPatch::Main()
     	continue;
     }
 //////////////////////
-    sourceFrame.MakeUnique();
-    sourceFrame.SetPayloadType(source.GetMediaFormat().GetPayloadType());
-
-    // We do the following to make sure that the buffer size is large enough,
-    // in case something in previous loop adjusted it
-    sourceFrame.SetPayloadSize(source.GetDataSize());
-    sourceFrame.SetPayloadSize(0);
-
-    if (!source.ReadPacket(sourceFrame)) {
-      PTRACE(4, "Patch\tThread ended because source read failed");
+    if (!TransferFrame(sourceFrame))
       break;
-    }
-
-    if(startpatchrecord == 1 && beforepatch != NULL)
-    {
-	  BYTE * outputbytes = sourceFrame.GetPayloadPtr();
-	  int outputsize = sourceFrame.GetPayloadSize();
-	  fwrite((char *)outputbytes,1,outputsize,beforepatch);
-    }
- 
-    if (!DispatchFrame(sourceFrame)) {
-      PTRACE(4, "Patch\tThread ended because all sink writes failed");
-      break;
-    }
  
     if (asynchronous)
       asynchPacing.Delay(10);
@@ -656,6 +705,54 @@ void OpalMediaPatch::Main()
 }
 
 
+bool OpalMediaPatch::OnMediaClockTick()
+{
+  if (source.IsOpen()) {
+    // As in Main(), only the default audio session carries media
+    if (source.IsPaused() || source.GetSessionID() != H323Capability::DefaultAudioSessionID)
+      return true;
+    if (TransferFrame(m_clockFrame))
+      return true;
+  }
+
+  source.OnStopMediaPatch(*this);
+
+  PTRACE(4, "Patch\tMedia clock ticks ended for " << *this);
+  return false;
+}
+
+
+bool OpalMediaPatch::TransferFrame(RTP_DataFrame & sourceFrame)
+{
+  sourceFrame.MakeUnique();
+  sourceFrame.SetPayloadType(source.GetMediaFormat().GetPayloadType());
+
+  // We do the following to make sure that the buffer size is large enough,
+  // in case something in previous loop adjusted it
+  sourceFrame.SetPayloadSize(source.GetDataSize());
+  sourceFrame.SetPayloadSize(0);
+
+  if (!source.ReadPacket(sourceFrame)) {
+    PTRACE(4, "Patch\tEnded because source read failed");
+    return false;
+  }
+
+  if(startpatchrecord == 1 && beforepatch != NULL)
+  {
+	BYTE * outputbytes = sourceFrame.GetPayloadPtr();
+	int outputsize = sourceFrame.GetPayloadSize();
+	fwrite((char *)outputbytes,1,outputsize,beforepatch);
+  }
+
+  if (!DispatchFrame(sourceFrame)) {
+    PTRACE(4, "Patch\tEnded because all sink writes failed");
+    return false;
+  }
+
+  return true;
+}
+
+
 bool OpalMediaPatch::SetBypassPatch(OpalMediaPatch * patch)
 {
   PSafeLockReadWrite mutex(*this);
@@ -722,8 +819,11 @@ bool OpalMediaPatch::DispatchFrame(RTP_DataFrame & frame)
 
   if (m_bypassToPatch == NULL) {
     for (PList<Sink>::iterator s = sinks.begin(); s != sinks.end(); ++s) {
+      // Packets from one frame go out together where the stream can do so
+      s->stream->StartWriteBatch();
       if (s->WriteFrame(frame))
         written = true;
+      s->stream->EndWriteBatch();
     }
   }
   else {
@@ -55,6 +55,9 @@
 extern OpalZRTPConnectionInfo * OpalLibZRTPConnInfo_Create();
 #endif
 
+// Application wide switch for SM4 media encryption
+extern int srtp_use_audio;
+
 
 OpalRTPConnection::OpalRTPConnection(OpalCall & call,
                              OpalRTPEndPoint  & ep,
@@ -80,6 +83,11 @@ OpalRTPConnection::OpalRTPConnection(OpalCall & call,
   zrtpEnabled = ep.GetZRTPEnabled();
   zrtpConnInfo = NULL;
 #endif
+
+#if OPAL_SRTP
+  if (srtp_use_audio)
+    securityMode = "SRTP|SM4_SKF_HY_ECB";
+#endif
 }
 
 OpalRTPConnection::~OpalRTPConnection()
@@ -185,6 +193,10 @@ RTP_Session * OpalRTPConnection::CreateSession(const OpalTransport & transport,
   if (manager.TranslateIPAddress(localAddress, remoteAddress)){
     rtpSession->SetLocalAddress(localAddress);
   }
+
+  RTP_Reactor * reactor = manager.GetRTPReactor();
+  if (reactor != NULL)
+    rtpSession->AttachReactor(*reactor);
   
   return rtpSession;
 }
@@ -0,0 +1,283 @@
+/*
+ * framepool.cxx
+ *
+ * Pool of packet buffers for RTP data frames
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "framepool.h"
+#endif
+
+#include <opal/buildopts.h>
+
+#include <rtp/framepool.h>
+
+
+#define new PNEW
+
+
+enum {
+  PacketClass,
+  JumboClass,
+  NumClasses
+};
+
+// Blocks moved between a thread cache and the depot at a time
+static const unsigned BatchSize[NumClasses] = { 32, 4 };
+
+static const PINDEX Capacity[NumClasses] = {
+  RTP_FramePool::PacketCapacity,
+  RTP_FramePool::JumboCapacity
+};
+
+
+struct RTP_FramePool::Block
+{
+  Block  * m_next;        // Next free block in a cache or chain
+  Block  * m_nextChain;   // Next chain in the depot, first block of chain only
+  unsigned m_chainLength; // Blocks in chain, first block of chain only
+  unsigned m_class;
+};
+
+// Keep the buffer after the header aligned for any type
+static const size_t DataOffset = (sizeof(RTP_FramePool::Block)+15)&~15;
+
+#define BLOCK_DATA(block) ((BYTE *)(block)+DataOffset)
+
+
+static PAtomicInteger g_blocksAllocated[NumClasses];
+static PAtomicInteger g_heapFrames;
+static PAtomicInteger g_copies;
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+  class Depot
+  {
+    public:
+      Depot()
+      {
+        for (unsigned i = 0; i < NumClasses; ++i)
+          m_chains[i] = NULL;
+      }
+
+      void Push(unsigned cls, RTP_FramePool::Block * chain, unsigned length)
+      {
+        chain->m_chainLength = length;
+
+        PWaitAndSignal mutex(m_mutex);
+        chain->m_nextChain = m_chains[cls];
+        m_chains[cls] = chain;
+      }
+
+      RTP_FramePool::Block * Pop(unsigned cls, unsigned & length)
+      {
+        PWaitAndSignal mutex(m_mutex);
+
+        RTP_FramePool::Block * chain = m_chains[cls];
+        if (chain == NULL) {
+          length = 0;
+          return NULL;
+        }
+
+        m_chains[cls] = chain->m_nextChain;
+        length = chain->m_chainLength;
+        return chain;
+      }
+
+    private:
+      PMutex                 m_mutex;
+      RTP_FramePool::Block * m_chains[NumClasses];
+  };
+
+
+  // Never destroyed, frames may still be freed during static destruction
+  Depot & GetDepot()
+  {
+    static Depot * depot = new Depot;
+    return *depot;
+  }
+
+
+  struct Cache
+  {
+    RTP_FramePool::Block * m_head[NumClasses];
+    unsigned               m_count[NumClasses];
+  };
+
+
+#if defined(P_PTHREADS)
+
+  pthread_key_t  g_cacheKey;
+  pthread_once_t g_cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+  // Called on thread exit, so the blocks in its cache are not lost
+  void DestroyCache(void * ptr)
+  {
+    Cache * cache = (Cache *)ptr;
+    for (unsigned cls = 0; cls < NumClasses; ++cls) {
+      if (cache->m_head[cls] != NULL)
+        GetDepot().Push(cls, cache->m_head[cls], cache->m_count[cls]);
+    }
+    delete cache;
+  }
+
+
+  void CreateCacheKey()
+  {
+    pthread_key_create(&g_cacheKey, DestroyCache);
+  }
+
+
+  Cache * GetCache()
+  {
+    pthread_once(&g_cacheKeyOnce, CreateCacheKey);
+
+    Cache * cache = (Cache *)pthread_getspecific(g_cacheKey);
+    if (cache == NULL) {
+      cache = new Cache;
+      memset(cache, 0, sizeof(*cache));
+      pthread_setspecific(g_cacheKey, cache);
+    }
+    return cache;
+  }
+
+#else
+
+  // No thread local storage with clean up, every block goes via the depot
+  Cache * GetCache()
+  {
+    return NULL;
+  }
+
+#endif
+
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+BYTE * RTP_FramePool::Acquire(PINDEX size, Block * & block, const BYTE * data, PINDEX dataSize)
+{
+  unsigned cls;
+  if (size <= PacketCapacity)
+    cls = PacketClass;
+  else if (size <= JumboCapacity)
+    cls = JumboClass;
+  else {
+    ++g_heapFrames;
+    block = NULL;
+    return NULL;
+  }
+
+  block = NULL;
+
+  Cache * cache = GetCache();
+  if (cache != NULL) {
+    if (cache->m_head[cls] == NULL)
+      cache->m_head[cls] = GetDepot().Pop(cls, cache->m_count[cls]);
+
+    if ((block = cache->m_head[cls]) != NULL) {
+      cache->m_head[cls] = block->m_next;
+      --cache->m_count[cls];
+    }
+  }
+  else {
+    unsigned length;
+    if ((block = GetDepot().Pop(cls, length)) != NULL && --length > 0)
+      GetDepot().Push(cls, block->m_next, length);
+  }
+
+  if (block == NULL) {
+    block = (Block *)malloc(DataOffset + Capacity[cls]);
+    if (block == NULL)
+      return NULL;
+    block->m_class = cls;
+    ++g_blocksAllocated[cls];
+  }
+
+  if (data != NULL && dataSize > 0) {
+    memcpy(BLOCK_DATA(block), data, PMIN(dataSize, size));
+    ++g_copies;
+  }
+
+  return BLOCK_DATA(block);
+}
+
+
+void RTP_FramePool::Release(Block * block)
+{
+  if (block == NULL)
+    return;
+
+  unsigned cls = block->m_class;
+
+  Cache * cache = GetCache();
+  if (cache == NULL) {
+    block->m_next = NULL;
+    GetDepot().Push(cls, block, 1);
+    return;
+  }
+
+  block->m_next = cache->m_head[cls];
+  cache->m_head[cls] = block;
+
+  if (++cache->m_count[cls] < 2*BatchSize[cls])
+    return;
+
+  // Hand a batch on, so a thread that only frees does not hoard blocks
+  Block * last = block;
+  for (unsigned i = 1; i < BatchSize[cls]; ++i)
+    last = last->m_next;
+
+  cache->m_head[cls] = last->m_next;
+  cache->m_count[cls] -= BatchSize[cls];
+  last->m_next = NULL;
+  GetDepot().Push(cls, block, BatchSize[cls]);
+}
+
+
+PINDEX RTP_FramePool::GetCapacity(const Block * block)
+{
+  return block != NULL ? Capacity[block->m_class] : 0;
+}
+
+
+BYTE * RTP_FramePool::GetBuffer(const Block * block)
+{
+  return block != NULL ? BLOCK_DATA(block) : NULL;
+}
+
+
+RTP_FramePool::Statistics RTP_FramePool::GetStatistics()
+{
+  Statistics stats;
+  stats.m_packetBlocks = g_blocksAllocated[PacketClass];
+  stats.m_jumboBlocks = g_blocksAllocated[JumboClass];
+  stats.m_heapFrames = g_heapFrames;
+  stats.m_copies = g_copies;
+  return stats;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -46,6 +46,22 @@
 
 const unsigned JitterRoundingGuardBits = 4;
 
+// Shortest packet time, in milliseconds, the buffer is sized for
+const unsigned MinimumFrameTime = 5;
+
+// Smallest number of frames the buffer is sized for
+const PINDEX MinimumBufferFrames = 16;
+
+// An empty slot shares this, rather than keep a packet buffer from the pool
+static const BYTE EmptyFrameHeader[RTP_DataFrame::MinHeaderSize] = { 0x80, 0x7f };
+
+// The count of queued frames must be read before the frames it counts
+#ifdef _WIN32
+  #define QUEUE_READ_BARRIER() MemoryBarrier()
+#else
+  #define QUEUE_READ_BARRIER() __sync_synchronize()
+#endif
+
 
 #if !PTRACING && !defined(NO_ANALYSER)
 #define NO_ANALYSER 1
@@ -58,7 +74,7 @@ const unsigned JitterRoundingGuardBits = 4;
 
   #define ANALYSE(inout, time, extra) \
     if (PTrace::CanTrace(ANALYSER_TRACE_LEVEL)) \
-      m_analyser->inout(tick, time, m_frames.size(), extra)
+      m_analyser->inout(tick, time, m_frameCount, extra)
 
   class RTP_JitterBufferAnalyser : public PObject
   {
@@ -202,6 +218,19 @@ const unsigned JitterRoundingGuardBits = 4;
 
 /////////////////////////////////////////////////////////////////////////////
 
+/* Enough frames for the maximum delay at the shortest packet time, twice
+   over, as clock overrun is only checked for once that many are buffered.
+   A power of two, so wrapping an index round is a mask. */
+static PINDEX CalculateBufferFrames(unsigned maxJitterDelay, unsigned timeUnits)
+{
+  PINDEX needed = 2*maxJitterDelay/(MinimumFrameTime*timeUnits);
+  PINDEX frames = MinimumBufferFrames;
+  while (frames < needed)
+    frames *= 2;
+  return frames;
+}
+
+
 OpalJitterBuffer::OpalJitterBuffer(unsigned minJitter,
                                    unsigned maxJitter,
                                    unsigned units,
@@ -214,12 +243,20 @@ OpalJitterBuffer::OpalJitterBuffer(unsigned minJitter,
   , m_silenceShrinkTime(-20*units) // 20 milliseconds @ 8kHz
   , m_jitterDriftPeriod(500*units) // 0.5 second @ 8kHz
   , m_maxConsecutiveMarkerBits(10)
+  , m_queueIn(0)
+  , m_queueOut(0)
+  , m_oldestFrame(0)
+  , m_frameCount(0)
+  , m_emptyFrame(EmptyFrameHeader, sizeof(EmptyFrameHeader), false)
 #ifdef NO_ANALYSER
   , m_analyser(NULL)
 #else
   , m_analyser(new RTP_JitterBufferAnalyser)
 #endif
 {
+  // Cannot be resized later, as the writer does not take the mutex
+  ResizeSlots(m_queue, CalculateBufferFrames(PMAX(minJitter, maxJitter), units));
+
   SetDelay(minJitter, maxJitter, packetSize);
 
   PTRACE(4, "Jitter\tBuffer created:" << *this);
@@ -233,6 +270,9 @@ OpalJitterBuffer::~OpalJitterBuffer()
   delete m_analyser;
 #endif
 
+  ResizeSlots(m_queue, 0);
+  ResizeSlots(m_frames, 0);
+
   PTRACE(4, "Jitter\tBuffer destroyed:" << *this);
 }
 
@@ -240,7 +280,7 @@ OpalJitterBuffer::~OpalJitterBuffer()
 void OpalJitterBuffer::PrintOn(ostream & strm) const
 {
   strm << "this=" << (void *)this
-       << " packets=" << m_frames.size()
+       << " packets=" << m_frameCount
        << " delay=" << (m_minJitterDelay/m_timeUnits) << '-'
                     << (m_currentJitterDelay/m_timeUnits) << '-'
                     << (m_maxJitterDelay/m_timeUnits) << "ms";
@@ -265,6 +305,8 @@ void OpalJitterBuffer::SetDelay(unsigned minJitterDelay, unsigned maxJitterDelay
 
   Reset();
 
+  ResizeSlots(m_frames, CalculateBufferFrames(PMAX(minJitterDelay, maxJitterDelay), m_timeUnits));
+
   m_bufferMutex.Signal();
 }
 
@@ -273,6 +315,33 @@ void OpalJitterBuffer::Reset()
 {
   m_bufferMutex.Wait();
 
+  // Frames written but not yet read go too, as they would if already in the buffer
+  ProcessQueuedFrames(true);
+
+  ResetBuffer();
+
+  m_bufferMutex.Signal();
+}
+
+
+void OpalJitterBuffer::ResizeSlots(std::vector<Slot> & slots, PINDEX size)
+{
+  PINDEX oldSize = slots.size();
+
+  for (PINDEX i = size; i < oldSize; ++i)
+    delete slots[i].m_frame;
+
+  slots.resize(size);
+
+  for (PINDEX i = oldSize; i < size; ++i) {
+    slots[i].m_timestamp = 0;
+    slots[i].m_frame = new RTP_DataFrame(m_emptyFrame);
+  }
+}
+
+
+void OpalJitterBuffer::ResetBuffer()
+{
   m_averageFrameTime  = 0;
   m_lastTimestamp     = UINT_MAX;
   m_bufferFilledTime  = 0;
@@ -284,29 +353,64 @@ void OpalJitterBuffer::Reset()
 
   m_synchronisationState = e_SynchronisationStart;
 
-  m_frames.clear();
-
-  m_bufferMutex.Signal();
+  while (m_frameCount > 0)
+    RemoveOldestFrame();
+  m_oldestFrame = 0;
 }
 
 
-PBoolean OpalJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInterval & PTRACE_PARAM(tick))
+PBoolean OpalJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInterval & tick)
 {
   if (frame.GetSize() < RTP_DataFrame::MinHeaderSize) {
     PTRACE(2, "Jitter\tWriting invalid RTP data frame.");
     return true; // Don't abort, but ignore
   }
 
-  PWaitAndSignal mutex(m_bufferMutex);
-
-  DWORD timestamp = frame.GetTimestamp();
-
   /*Check for catastrophic failure, nothing removing packets from buffer! */
-  if (m_frames.size() > 100) {
+  if (m_queuedFrames >= (PAtomicInteger::IntegerType)m_queue.size()) {
     PTRACE(2, "Jitter\tNothing being removed from buffer, aborting!");
     return false;
   }
 
+  Slot & slot = m_queue[m_queueIn];
+  slot.m_timestamp = frame.GetTimestamp();
+  slot.m_tick = tick;
+  *slot.m_frame = frame;
+  m_queueIn = (m_queueIn+1)&(m_queue.size()-1);
+
+  // Atomic, so the slot is seen by the reader no later than the count
+  ++m_queuedFrames;
+  return true;
+}
+
+
+void OpalJitterBuffer::ProcessQueuedFrames(bool discard)
+{
+  PINDEX count = m_queuedFrames;
+  if (count == 0)
+    return;
+
+  QUEUE_READ_BARRIER();
+
+  while (count-- > 0) {
+    // A frame added to the buffer was swapped for an empty one, otherwise
+    // let go of it here, so it is not still shared when it is read
+    Slot & queued = m_queue[m_queueOut];
+    if (discard || !AddFrame(queued, queued.m_tick))
+      *queued.m_frame = m_emptyFrame;
+    m_queueOut = (m_queueOut+1)&(m_queue.size()-1);
+
+    // Atomic, so the slot is empty before the writer can reuse it
+    --m_queuedFrames;
+  }
+}
+
+
+bool OpalJitterBuffer::AddFrame(Slot & queued, const PTimeInterval & PTRACE_PARAM(tick))
+{
+  const RTP_DataFrame & frame = *queued.m_frame;
+  DWORD timestamp = queued.m_timestamp;
+
 
   /*Deal with naughty systems that send continuous marker bits, thus we
     cannot use it to determine start of talk burst, and the need to refill
@@ -314,7 +418,7 @@ PBoolean OpalJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInt
   if (m_consecutiveMarkerBits < m_maxConsecutiveMarkerBits) {
     if (frame.GetMarker()) {
       m_consecutiveMarkerBits++;
-      Reset();
+      ResetBuffer();
 
       // Have been told there is explicit silence by marker, take opportunity
       // to reduce the current jitter delay.
@@ -348,7 +452,7 @@ PBoolean OpalJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInt
     if (newFrameTime < -16000 || newFrameTime > 4800000) {
       PTRACE(3, "Jitter\tTimestamps abruptly changed from "
               << m_lastTimestamp << " to " << timestamp << ", resynching");
-      Reset();
+      ResetBuffer();
     }
     else if (m_averageFrameTime == 0 || m_averageFrameTime > (DWORD)newFrameTime) {
       m_averageFrameTime = newFrameTime;
@@ -361,26 +465,57 @@ PBoolean OpalJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInt
 
 
   if (frame.GetSyncSource() != m_lastSyncSource) {
-    Reset();
+    ResetBuffer();
     m_lastSyncSource = frame.GetSyncSource();
     PTRACE(4, "Jitter\tBuffer reset due to SSRC change.");
   }
 
 
-  // Add to buffer
-  pair<FrameMap::iterator,bool> result = m_frames.insert(FrameMap::value_type(timestamp, frame));
-  if (result.second) {
-    ANALYSE(In, timestamp, m_synchronisationState != e_SynchronisationDone ? "PreBuf" : "");
-    PTRACE(6, "Jitter\tReceived packet : ts=" << timestamp);
-  }
-  else {
+  // Add to buffer, nearly always in order, so look for the place from the newest
+  PINDEX position = m_frameCount;
+  while (position > 0 && GetFrame(position-1).m_timestamp > timestamp)
+    --position;
+
+  if (position > 0 && GetFrame(position-1).m_timestamp == timestamp) {
     PTRACE(2, "Jitter\tAttempt to insert two RTP packets with same timestamp: " << timestamp);
+    return false;
+  }
+
+  if (m_frameCount >= (PINDEX)m_frames.size()) {
+    PTRACE(2, "Jitter\tBuffer full, discarding packet: ts=" << timestamp);
+    ++m_bufferOverruns;
+    return false;
+  }
+
+  RTP_DataFrame * empty = GetFrame(m_frameCount).m_frame;
+
+  for (PINDEX i = m_frameCount; i > position; --i) {
+    Slot & later = GetFrame(i);
+    Slot & earlier = GetFrame(i-1);
+    later.m_timestamp = earlier.m_timestamp;
+    later.m_frame = earlier.m_frame;
   }
 
+  Slot & slot = GetFrame(position);
+  slot.m_timestamp = timestamp;
+  slot.m_frame = queued.m_frame;
+  queued.m_frame = empty;
+  ++m_frameCount;
+
+  ANALYSE(In, timestamp, m_synchronisationState != e_SynchronisationDone ? "PreBuf" : "");
+  PTRACE(6, "Jitter\tReceived packet : ts=" << timestamp);
   return true;
 }
 
 
+void OpalJitterBuffer::RemoveOldestFrame()
+{
+  *m_frames[m_oldestFrame].m_frame = m_emptyFrame;
+  m_oldestFrame = (m_oldestFrame+1)&(m_frames.size()-1);
+  --m_frameCount;
+}
+
+
 DWORD OpalJitterBuffer::CalculateRequiredTimestamp(DWORD playOutTimestamp) const
 {
   DWORD timestamp = playOutTimestamp + m_timestampDelta;
@@ -408,7 +543,7 @@ bool OpalJitterBuffer::AdjustCurrentJitterDelay(int delta)
 }
 
 
-#define COMMON_TRACE_INFO ": ts=" << requiredTimestamp << " (" << playOutTimestamp << "), size=" << m_frames.size()
+#define COMMON_TRACE_INFO ": ts=" << requiredTimestamp << " (" << playOutTimestamp << "), size=" << m_frameCount
 
 PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & PTRACE_PARAM(tick))
 {
@@ -417,11 +552,13 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
   PWaitAndSignal mutex(m_bufferMutex);
 
+  ProcessQueuedFrames(false);
+
   // Now we get the timestamp the caller wants
   DWORD playOutTimestamp = frame.GetTimestamp();
   DWORD requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
 
-  if (m_frames.empty()) {
+  if (m_frameCount == 0) {
     /*We ran the buffer down to empty, so have no data to play, play silence.
       This happens if packet is too late or completely missing. A too late
       packet will be picked up by later code.
@@ -440,7 +577,7 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
   }
   m_bufferEmptiedTime = playOutTimestamp;
 
-  size_t framesInBuffer = m_averageFrameTime > 0 ? m_currentJitterDelay/m_averageFrameTime : 2;
+  PINDEX framesInBuffer = m_averageFrameTime > 0 ? m_currentJitterDelay/m_averageFrameTime : 2;
   if (framesInBuffer < 2)
     framesInBuffer = 2;
 
@@ -448,7 +585,7 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
      means we have a sample clock drift problem, that is we have a clock of 8.01kHz and
      the remote has 7.99kHz so gradually the buffer drains as we take things out faster
      than they arrive. */
-  if (m_bufferLowTime == 0 || m_frames.size() > framesInBuffer/2)
+  if (m_bufferLowTime == 0 || m_frameCount > framesInBuffer/2)
     m_bufferLowTime = playOutTimestamp;
   else if ((playOutTimestamp - m_bufferLowTime) > m_jitterDriftPeriod) {
     m_bufferLowTime = playOutTimestamp;
@@ -460,7 +597,7 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
   /* Check for buffer full (or nearly so) and count them. If full for a while
      then it is time to reduce the size of the jitter buffer */
-  if (m_bufferFilledTime == 0 || m_frames.size() < framesInBuffer)
+  if (m_bufferFilledTime == 0 || m_frameCount < framesInBuffer)
     m_bufferFilledTime = playOutTimestamp;
   else if ((playOutTimestamp - m_bufferFilledTime) > m_jitterShrinkPeriod) {
     m_bufferFilledTime = playOutTimestamp;
@@ -474,14 +611,13 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
   }
 
   // Get the oldest packet
-  FrameMap::iterator oldestFrame = m_frames.begin();
-  PAssert(oldestFrame != m_frames.end(), PLogicError);
+  Slot * oldestFrame = &GetFrame(0);
 
   // Check current buffer state and act accordingly
   switch (m_synchronisationState) {
     case e_SynchronisationStart :
       /* First packet of talk burst, re-calculate the timestamp delta */
-      m_timestampDelta = oldestFrame->first - playOutTimestamp;
+      m_timestampDelta = oldestFrame->m_timestamp - playOutTimestamp;
       requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
       m_synchronisationState = e_SynchronisationFill;
       PTRACE(5, "Jitter\tSynchronising   " COMMON_TRACE_INFO);
@@ -489,9 +625,9 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
     case e_SynchronisationFill :
       /* Now see if we have buffered enough yet */
-      if (requiredTimestamp < oldestFrame->first) {
+      if (requiredTimestamp < oldestFrame->m_timestamp) {
         /* Nope, play out some silence */
-        ANALYSE(Out, oldestFrame->first, "PreBuf");
+        ANALYSE(Out, oldestFrame->m_timestamp, "PreBuf");
         return true;
       }
 
@@ -506,10 +642,10 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
     case e_SynchronisationDone :
       // Get rid of all the frames that are too late
-      while (requiredTimestamp >= oldestFrame->first + m_averageFrameTime) {
+      while (requiredTimestamp >= oldestFrame->m_timestamp + m_averageFrameTime) {
         if (++m_consecutiveLatePackets > 10) {
           PTRACE(4, "Jitter\tToo many late   " COMMON_TRACE_INFO);
-          Reset();
+          ResetBuffer();
           return true;
         }
 
@@ -519,14 +655,14 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 #endif
         AdjustCurrentJitterDelay(m_jitterGrowTime);
         PTRACE(4, "Jitter\tPacket too late " COMMON_TRACE_INFO
-                  << ", oldest=" << oldestFrame->first << ", "
+                  << ", oldest=" << oldestFrame->m_timestamp << ", "
                   << (adjusted ? "increasing" : "cannot increase") << " delay="
                   << m_currentJitterDelay << " (" << (m_currentJitterDelay/m_timeUnits) << "ms)");
-        ANALYSE(Out, oldestFrame->first, "Late");
-        m_frames.erase(oldestFrame);
+        ANALYSE(Out, oldestFrame->m_timestamp, "Late");
+        RemoveOldestFrame();
         ++m_packetsTooLate;
 
-        if (m_frames.empty()) {
+        if (m_frameCount == 0) {
           PTRACE(5, "Jitter\tBuffer emptied  " COMMON_TRACE_INFO);
           ANALYSE(Out, requiredTimestamp, "Emptied");
           return true;
@@ -534,15 +670,14 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
         requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
 
-        oldestFrame = m_frames.begin();
-        PAssert(oldestFrame != m_frames.end(), PLogicError);
+        oldestFrame = &GetFrame(0);
       }
 
       /* Check for buffer overfull due to clock mismatch. It is possible for the remote
          to have a clock of 8.01kHz and the receiver 7.99kHz so gradually the remote
          sends more data than we take out over time, gradually building up in the
          jitter buffer. So, drop a frame every now and then. */
-      if (m_frames.size() < framesInBuffer*2)
+      if (m_frameCount < framesInBuffer*2)
         break;
 
       PTRACE(4, "Jitter\tClock overrun   " COMMON_TRACE_INFO << " >= " << framesInBuffer << "*2");
@@ -551,12 +686,13 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
 
     case e_SynchronisationShrink :
       requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
-      if (requiredTimestamp >= oldestFrame->first + m_averageFrameTime) {
-        ANALYSE(Out, oldestFrame->first, "Shrink");
-        m_frames.erase(oldestFrame);
+      if (requiredTimestamp >= oldestFrame->m_timestamp + m_averageFrameTime) {
+        ANALYSE(Out, oldestFrame->m_timestamp, "Shrink");
+        RemoveOldestFrame();
         ++m_bufferOverruns;
-        oldestFrame = m_frames.begin();
-        PAssert(oldestFrame != m_frames.end(), PLogicError);
+        if (!PAssert(m_frameCount > 0, PLogicError))
+          return true;
+        oldestFrame = &GetFrame(0);
       }
 
       m_synchronisationState = e_SynchronisationDone;
@@ -567,17 +703,17 @@ PBoolean OpalJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval &
      packet (not arrived yet) in buffer. Can't wait for it, return no data.
      If the packet subsequently DOES arrive, it will get picked up by the
      too late section above. */
-  if (requiredTimestamp < oldestFrame->first) {
-    PTRACE(4, "Jitter\tPacket not ready" COMMON_TRACE_INFO << ", oldest=" << oldestFrame->first);
+  if (requiredTimestamp < oldestFrame->m_timestamp) {
+    PTRACE(4, "Jitter\tPacket not ready" COMMON_TRACE_INFO << ", oldest=" << oldestFrame->m_timestamp);
     ANALYSE(Out, requiredTimestamp, "Wait");
     return true;
   }
 
   // Finally can return the frame we have
-  ANALYSE(Out, oldestFrame->first, "");
+  ANALYSE(Out, oldestFrame->m_timestamp, "");
   PTRACE(6, "Jitter\tDelivered packet" COMMON_TRACE_INFO);
-  frame = oldestFrame->second;
-  m_frames.erase(oldestFrame);
+  frame = *oldestFrame->m_frame;
+  RemoveOldestFrame();
   frame.SetTimestamp(playOutTimestamp);
   m_consecutiveLatePackets = 0;
   return true;
@@ -0,0 +1,359 @@
+/*
+ * reactor.cxx
+ *
+ * Shared event loops for receiving RTP/RTCP
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "reactor.h"
+#endif
+
+#include <opal/buildopts.h>
+
+#include <rtp/reactor.h>
+#include <rtp/rtp.h>
+
+#if OPAL_RTP_REACTOR
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_Reactor::Loop::Loop()
+  : m_epoll(-1)
+  , m_wakeup(-1)
+  , m_thread(NULL)
+  , m_sessionCount(0)
+{
+}
+
+
+RTP_Reactor::RTP_Reactor(unsigned loopCount)
+  : m_loopCount(loopCount)
+  , m_running(false)
+  , m_loops(NULL)
+{
+#if OPAL_RTP_REACTOR
+  if (m_loopCount == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    m_loopCount = cpus > 0 ? (unsigned)cpus : 1;
+  }
+#else
+  if (m_loopCount == 0)
+    m_loopCount = 1;
+#endif
+}
+
+
+RTP_Reactor::~RTP_Reactor()
+{
+  Stop();
+
+  for (RegistrationMap::iterator it = m_registrations.begin(); it != m_registrations.end(); ++it) {
+    PTRACE(2, "RTP_Reactor\tSession " << it->first->GetSessionID() << " still attached on destruction");
+    delete it->second;
+  }
+
+#if OPAL_RTP_REACTOR
+  if (m_loops != NULL) {
+    for (unsigned i = 0; i < m_loopCount; ++i) {
+      if (m_loops[i].m_epoll >= 0)
+        ::close(m_loops[i].m_epoll);
+      if (m_loops[i].m_wakeup >= 0)
+        ::close(m_loops[i].m_wakeup);
+    }
+  }
+#endif
+
+  delete [] m_loops;
+}
+
+
+bool RTP_Reactor::Start()
+{
+#if OPAL_RTP_REACTOR
+  if (m_running)
+    return true;
+
+  if (m_loops == NULL) {
+    m_loops = new Loop[m_loopCount];
+
+    for (unsigned i = 0; i < m_loopCount; ++i) {
+      Loop & loop = m_loops[i];
+
+      loop.m_epoll = epoll_create(MaxEventsPerWait);
+      if (loop.m_epoll < 0) {
+        PTRACE(1, "RTP_Reactor\tCould not create epoll set: " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+        return false;
+      }
+
+      loop.m_wakeup = eventfd(0, 0);
+      if (loop.m_wakeup < 0) {
+        PTRACE(1, "RTP_Reactor\tCould not create event fd: " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+        return false;
+      }
+
+      struct epoll_event event;
+      event.events = EPOLLIN;
+      event.data.ptr = NULL;
+      if (epoll_ctl(loop.m_epoll, EPOLL_CTL_ADD, loop.m_wakeup, &event) < 0) {
+        PTRACE(1, "RTP_Reactor\tCould not add event fd: " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+        return false;
+      }
+    }
+  }
+
+  m_running = true;
+
+  for (unsigned i = 0; i < m_loopCount; ++i)
+    m_loops[i].m_thread = PThread::Create(PCREATE_NOTIFIER(LoopMain), i,
+                                          PThread::NoAutoDeleteThread,
+                                          PThread::HighestPriority,
+                                          "RTP Reactor:%x");
+
+  PTRACE(3, "RTP_Reactor\tStarted " << m_loopCount << " event loops");
+  return true;
+#else
+  PTRACE(2, "RTP_Reactor\tNot supported on this platform, sessions use their own read threads");
+  return false;
+#endif
+}
+
+
+void RTP_Reactor::Stop()
+{
+#if OPAL_RTP_REACTOR
+  if (!m_running)
+    return;
+
+  m_running = false;
+
+  for (unsigned i = 0; i < m_loopCount; ++i) {
+    Loop & loop = m_loops[i];
+    uint64_t value = 1;
+    if (::write(loop.m_wakeup, &value, sizeof(value)) < 0) {
+      PTRACE(2, "RTP_Reactor\tCould not wake event loop " << i);
+    }
+  }
+
+  for (unsigned i = 0; i < m_loopCount; ++i) {
+    Loop & loop = m_loops[i];
+    if (loop.m_thread != NULL) {
+      PAssert(loop.m_thread->WaitForTermination(10000), "RTP reactor thread did not terminate");
+      delete loop.m_thread;
+      loop.m_thread = NULL;
+    }
+
+    for (std::vector<Registration *>::iterator it = loop.m_removed.begin(); it != loop.m_removed.end(); ++it)
+      delete *it;
+    loop.m_removed.clear();
+  }
+
+  PTRACE(3, "RTP_Reactor\tStopped event loops");
+#endif
+}
+
+
+bool RTP_Reactor::Add(RTP_UDP & session)
+{
+  if (!m_running)
+    return false;
+
+  int dataHandle = session.GetDataSocketHandle();
+  int controlHandle = session.GetControlSocketHandle();
+  if (dataHandle < 0 || controlHandle < 0) {
+    PTRACE(3, "RTP_Reactor\tSession " << session.GetSessionID() << " has no open sockets to receive on");
+    return false;
+  }
+
+  PWaitAndSignal mutex(m_registrationsMutex);
+
+  if (m_registrations.find(&session) != m_registrations.end())
+    return true;
+
+  unsigned index = 0;
+  for (unsigned i = 1; i < m_loopCount; ++i) {
+    if (m_loops[i].m_sessionCount < m_loops[index].m_sessionCount)
+      index = i;
+  }
+  Loop & loop = m_loops[index];
+
+  Registration * registration = new Registration;
+  registration->m_session = &session;
+  registration->m_loop = index;
+  registration->m_removed = false;
+  registration->m_data.m_registration = registration;
+  registration->m_data.m_fd = dataHandle;
+  registration->m_data.m_isData = true;
+  registration->m_control.m_registration = registration;
+  registration->m_control.m_fd = controlHandle;
+  registration->m_control.m_isData = false;
+
+  if (!AddHandle(loop, registration->m_data)) {
+    delete registration;
+    return false;
+  }
+
+  if (!AddHandle(loop, registration->m_control)) {
+    RemoveHandle(loop, registration->m_data);
+    delete registration;
+    return false;
+  }
+
+  ++loop.m_sessionCount;
+  m_registrations[&session] = registration;
+
+  PTRACE(4, "RTP_Reactor\tSession " << session.GetSessionID() << " added to event loop " << index);
+  return true;
+}
+
+
+void RTP_Reactor::Remove(RTP_UDP & session)
+{
+  Registration * registration;
+
+  {
+    PWaitAndSignal mutex(m_registrationsMutex);
+
+    RegistrationMap::iterator it = m_registrations.find(&session);
+    if (it == m_registrations.end())
+      return;
+
+    registration = it->second;
+    m_registrations.erase(it);
+    --m_loops[registration->m_loop].m_sessionCount;
+  }
+
+  Loop & loop = m_loops[registration->m_loop];
+
+  /* Taking the loop mutex waits out any batch being dispatched. Events for
+     the session may still be sitting in a batch the loop has taken from
+     epoll but not yet dispatched, so the registration is only freed by the
+     loop after that batch. */
+  PWaitAndSignal mutex(loop.m_mutex);
+
+  RemoveHandle(loop, registration->m_data);
+  RemoveHandle(loop, registration->m_control);
+  registration->m_removed = true;
+
+  if (!m_running) {
+    delete registration;
+    return;
+  }
+
+  loop.m_removed.push_back(registration);
+
+#if OPAL_RTP_REACTOR
+  uint64_t value = 1;
+  if (::write(loop.m_wakeup, &value, sizeof(value)) < 0) {
+    PTRACE(2, "RTP_Reactor\tCould not wake event loop " << registration->m_loop);
+  }
+#endif
+
+  PTRACE(4, "RTP_Reactor\tSession " << session.GetSessionID() << " removed from event loop " << registration->m_loop);
+}
+
+
+PINDEX RTP_Reactor::GetSessionCount() const
+{
+  PWaitAndSignal mutex(m_registrationsMutex);
+  return m_registrations.size();
+}
+
+
+bool RTP_Reactor::AddHandle(Loop & loop, Handle & handle)
+{
+#if OPAL_RTP_REACTOR
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = &handle;
+  if (epoll_ctl(loop.m_epoll, EPOLL_CTL_ADD, handle.m_fd, &event) == 0)
+    return true;
+
+  PTRACE(1, "RTP_Reactor\tCould not add " << (handle.m_isData ? "data" : "control")
+         << " socket " << handle.m_fd << ": " << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+#endif
+  return false;
+}
+
+
+void RTP_Reactor::RemoveHandle(Loop & loop, Handle & handle)
+{
+#if OPAL_RTP_REACTOR
+  // The socket may already be closed, which removes it from the set anyway
+  struct epoll_event event;
+  epoll_ctl(loop.m_epoll, EPOLL_CTL_DEL, handle.m_fd, &event);
+#endif
+}
+
+
+void RTP_Reactor::LoopMain(PThread &, INT index)
+{
+#if OPAL_RTP_REACTOR
+  Loop & loop = m_loops[index];
+
+  PTRACE(4, "RTP_Reactor\tEvent loop " << index << " started");
+
+  struct epoll_event events[MaxEventsPerWait];
+
+  while (m_running) {
+    int count = epoll_wait(loop.m_epoll, events, MaxEventsPerWait, -1);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "RTP_Reactor\tEvent loop " << index << " wait error: "
+             << PChannel::GetErrorText(PChannel::Miscellaneous, errno));
+      break;
+    }
+
+    PWaitAndSignal mutex(loop.m_mutex);
+
+    for (int i = 0; i < count; ++i) {
+      Handle * handle = (Handle *)events[i].data.ptr;
+      if (handle == NULL) {
+        uint64_t value;
+        if (::read(loop.m_wakeup, &value, sizeof(value)) < 0) {
+          PTRACE(5, "RTP_Reactor\tEvent loop " << index << " spurious wake up");
+        }
+        continue;
+      }
+
+      if (!handle->m_registration->m_removed)
+        handle->m_registration->m_session->OnReactorReadable(handle->m_isData);
+    }
+
+    for (std::vector<Registration *>::iterator it = loop.m_removed.begin(); it != loop.m_removed.end(); ++it)
+      delete *it;
+    loop.m_removed.clear();
+  }
+
+  PTRACE(4, "RTP_Reactor\tEvent loop " << index << " finished");
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -42,6 +42,7 @@
 #include <rtp/rtp.h>
 
 #include <rtp/jitter.h>
+#include <rtp/reactor.h>
 
 #include <rtp/metrics.h>
 
@@ -63,133 +64,199 @@
 const unsigned SecondsFrom1900to1970 = (70*365+17)*24*60*60U;
 
 
-#if gaoshaobo
-char *defKey = "c1eec3717da76195bb878578790af71c4ee9f859e197a414a78d5abc7451";	//gaoshaobo for srtp
-char inputKey[96];								//gaoshaobo for srtp
-unsigned char pKey_audio[16] = {0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10};
-#endif
-
-extern unsigned char ssl_session_key[16];
-
 
 #define RTP_VIDEO_RX_BUFFER_SIZE 0x100000 // 1Mb
 #define RTP_AUDIO_RX_BUFFER_SIZE 0x4000   // 16kb
 #define RTP_DATA_TX_BUFFER_SIZE  0x2000   // 8kb
 #define RTP_CTRL_BUFFER_SIZE     0x1000   // 4kb
 
-#if gaoshaobo
-//gaoshaobo for srtp begin
-
-static inline int hex_char_to_nibble (uint8_t c)
-{
-    switch (c) {
-    case ('0'): return 0x0;
-    case ('1'): return 0x1;
-    case ('2'): return 0x2;
-    case ('3'): return 0x3;
-    case ('4'): return 0x4;
-    case ('5'): return 0x5;
-    case ('6'): return 0x6;
-    case ('7'): return 0x7;
-    case ('8'): return 0x8;
-    case ('9'): return 0x9;
-    case ('a'): return 0xa;
-    case ('A'): return 0xa;
-    case ('b'): return 0xb;
-    case ('B'): return 0xb;
-    case ('c'): return 0xc;
-    case ('C'): return 0xc;
-    case ('d'): return 0xd;
-    case ('D'): return 0xd;
-    case ('e'): return 0xe;
-    case ('E'): return 0xe;
-    case ('f'): return 0xf;
-    case ('F'): return 0xf;
-    default: return -1; 
-    }
-    
-    return -1; 
+#define RTP_REACTOR_PACKET_SIZE  2048     // Receive buffer for datagrams read by the reactor
+#define RTP_REACTOR_QUEUE_MAX    100      // Frames queued for ReadData() before the oldest is dropped
+#define RTP_WRITE_BATCH_SIZE     32       // Data frames held by StartWriteBatch() before they are sent anyway
+
+PFACTORY_CREATE(PFactory<RTP_Encoding>, RTP_Encoding, "rtp/avp", false);
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_DataFrame::RTP_DataFrame(PINDEX payloadSz, PINDEX bufferSz)
+  : m_headerSize(MinHeaderSize)
+  , m_payloadSize(payloadSz)
+  , m_paddingSize(0)
+  , m_poolBlock(NULL)
+{
+  SetSize(std::max(bufferSz, MinHeaderSize+payloadSz));
+  theArray[0] = '\x80'; // Default to version 2
+  theArray[1] = '\x7f'; // Default to MaxPayloadType
 }
 
-int hex_string_to_octet_string (char *raw, char *hex, int len)
+
+RTP_DataFrame::RTP_DataFrame(const BYTE * data, PINDEX len, PBoolean dynamic)
+  : PBYTEArray(dynamic ? NULL : data, dynamic ? 0 : len, false)
+  , m_headerSize(MinHeaderSize)
+  , m_payloadSize(0)
+  , m_paddingSize(0)
+  , m_poolBlock(NULL)
 {
-    uint8_t x;
-    int tmp;
-    int hex_len;
+  if (dynamic) {
+    if (AdoptPoolBuffer(len))
+      memcpy(theArray, data, len);
+    else
+      PBYTEArray::operator=(PBYTEArray(data, len));
+  }
 
-    hex_len = 0;
-    while (hex_len < len) {
-        tmp = hex_char_to_nibble(hex[0]);
-        if (tmp == -1) {
-            return hex_len;
-        }
-        x = (tmp << 4);
-        hex_len++;
-        tmp = hex_char_to_nibble(hex[1]);
-        if (tmp == -1) {
-            return hex_len;
-        }
-        x |= (tmp & 0xff);
-        hex_len++;
-        *raw++ = x;
-        hex += 2;
-    }
-    return hex_len;
+  SetPacketSize(len);
 }
 
 
-void set_Enc_pad(unsigned char* buf, unsigned int enc_len, unsigned char *pad_len)
+RTP_DataFrame::~RTP_DataFrame()
 {
-	int i;
-	*pad_len = 16 - (enc_len % 16);
-	for(i = 0; i < *pad_len - 1; i++)
-		*(buf + enc_len + i) = 0x00;
-	*(buf + enc_len + i) = (*pad_len) & 0xff;
+  // Here, rather than in the base class destructor, so DestroyContents() is ours
+  Destruct();
 }
 
-int check_Dec_pad(unsigned char* buf, unsigned int enc_len, unsigned char *pad_len)
+
+#if !PMEMORY_CHECK
+
+static PFixedPoolAllocator<RTP_DataFrame> RTP_DataFrame_allocator;
+
+void * RTP_DataFrame::operator new(size_t nSize)
 {
-	int i;
-	*pad_len = *(buf + enc_len - 1) & 0xff;
-	i = 0;
-	while(i < *pad_len - 1)
-	{
-		if(*(buf + enc_len - 2 - i) != 0x00)
-		{
-			*pad_len = 0;
-			return 0;
-		}
-		i++;
-	}
-	return 1;
+  // Derived classes are bigger than the pool's blocks
+  return nSize == sizeof(RTP_DataFrame) ? RTP_DataFrame_allocator.allocate(1) : ::operator new(nSize);
+}
+
+
+void RTP_DataFrame::operator delete(void * ptr, size_t nSize)
+{
+  if (nSize == sizeof(RTP_DataFrame))
+    RTP_DataFrame_allocator.deallocate((RTP_DataFrame *)ptr, 1);
+  else
+    ::operator delete(ptr);
 }
 
-//gaoshaobo for srtp end
 #endif
 
-PFACTORY_CREATE(PFactory<RTP_Encoding>, RTP_Encoding, "rtp/avp", false);
 
+PBoolean RTP_DataFrame::SetSize(PINDEX newSize)
+{
+  if (newSize < 0)
+    newSize = 0;
 
-/////////////////////////////////////////////////////////////////////////////
+  PINDEX oldSize = GetSize();
+  if (newSize == oldSize)
+    return true;
 
-RTP_DataFrame::RTP_DataFrame(PINDEX payloadSz, PINDEX bufferSz)
-  : PBYTEArray(std::max(bufferSz, MinHeaderSize+payloadSz))
-  , m_headerSize(MinHeaderSize)
-  , m_payloadSize(payloadSz)
-  , m_paddingSize(0)
+  if (m_poolBlock != NULL && !UsingPoolBlock())
+    return PBYTEArray::SetSize(newSize);
+
+  // Resizing in place is just a change of length
+  if (m_poolBlock != NULL && IsUnique() && newSize <= RTP_FramePool::GetCapacity(m_poolBlock)) {
+    if (newSize > oldSize)
+      memset(theArray+oldSize, 0, newSize-oldSize);
+    reference->size = newSize;
+    return true;
+  }
+
+  if (AdoptPoolBuffer(newSize))
+    return true;
+
+  // Too big for the pool, so to the heap it goes
+  RTP_FramePool::Block * block = m_poolBlock;
+  if (block == NULL)
+    return PBYTEArray::SetSize(newSize);
+
+  bool unique = IsUnique();
+  m_poolBlock = NULL;
+  if (!PBYTEArray::SetSize(newSize)) {
+    m_poolBlock = block;
+    return false;
+  }
+
+  // The base class does not free a buffer it did not allocate
+  if (unique)
+    RTP_FramePool::Release(block);
+  return true;
+}
+
+
+PBoolean RTP_DataFrame::MakeUnique()
 {
-  theArray[0] = '\x80'; // Default to version 2
-  theArray[1] = '\x7f'; // Default to MaxPayloadType
+  if (IsUnique())
+    return true;
+
+  if (m_poolBlock != NULL && !UsingPoolBlock())
+    return PBYTEArray::MakeUnique();
+
+  if (!AdoptPoolBuffer(GetSize())) {
+    m_poolBlock = NULL; // The heap copy is ours, the pooled buffer is not
+    PBYTEArray::MakeUnique();
+  }
+
+  return false;
 }
 
 
-RTP_DataFrame::RTP_DataFrame(const BYTE * data, PINDEX len, PBoolean dynamic)
-  : PBYTEArray(data, len, dynamic)
-  , m_headerSize(MinHeaderSize)
-  , m_payloadSize(0)
-  , m_paddingSize(0)
+void RTP_DataFrame::DestroyContents()
 {
-  SetPacketSize(len);
+  if (!UsingPoolBlock()) {
+    PBYTEArray::DestroyContents();
+    return;
+  }
+
+  RTP_FramePool::Release(m_poolBlock);
+  m_poolBlock = NULL;
+  theArray = NULL;
+}
+
+
+void RTP_DataFrame::AssignContents(const PContainer & c)
+{
+  PBYTEArray::AssignContents(c);
+
+  // Now sharing the other container's buffer, which may or may not be pooled
+  m_poolBlock = PIsDescendant(&c, RTP_DataFrame) ? ((const RTP_DataFrame &)c).m_poolBlock : NULL;
+}
+
+
+bool RTP_DataFrame::AdoptPoolBuffer(PINDEX newSize)
+{
+  // Copy before letting go, another owner may free the old buffer at once
+  PINDEX oldSize = GetSize();
+  RTP_FramePool::Block * block;
+  BYTE * buffer = RTP_FramePool::Acquire(newSize, block, (const BYTE *)theArray, PMIN(oldSize, newSize));
+  if (buffer == NULL)
+    return false;
+
+  if (newSize > oldSize)
+    memset(buffer+oldSize, 0, newSize-oldSize);
+
+  if (PContainer::MakeUnique())
+    DestroyContents();
+
+  theArray = (char *)buffer;
+  allocatedDynamically = false;
+  reference->size = newSize;
+  m_poolBlock = block;
+  return true;
+}
+
+
+bool RTP_DataFrame::UsingPoolBlock()
+{
+  if (m_poolBlock == NULL)
+    return false;
+
+  if (theArray == (char *)RTP_FramePool::GetBuffer(m_poolBlock))
+    return true;
+
+  /* Attach() is not virtual, so it can swap in another buffer without us
+     knowing. Nothing else frees the block, so give it back if it was ours
+     alone, and treat the frame as a plain PBYTEArray from then on. */
+  if (IsUnique())
+    RTP_FramePool::Release(m_poolBlock);
+  m_poolBlock = NULL;
+  return false;
 }
 
 
@@ -686,18 +753,6 @@ static PTimeInterval GetDefaultOutOfOrderWaitTime()
 #endif
 
 
-extern int srtp_use_audio;
-#if gaoshaobo
-/***********gaoshaobo for srtp********/
-
-PBoolean RTP_Session::inited = PFalse;
-//unsigned char* RTP_Session::key_audio = (unsigned char*)pKey_audio;
-int RTP_Session::audio_srtp = 0;
-extern int srtp_use_audio;
-//extern int srtp_use_video;
-/***********gaoshaobo for srtp********/
-#endif
-
 #if bruce
 PBoolean RTP_Session::audio_zrtp_inited = PFalse;
 int RTP_Session::audio_zrtp=0;
@@ -719,10 +774,6 @@ RTP_Session::RTP_Session(const Params & params)
   , m_reportTimer(0, 12)  // Seconds
   , failed(false)
 
-#if gaoshaobo
-  , createdOut_audio(false) //gaoshaobo for srtp
-  , createdIn_audio(false)//gaoshaobo for srtp
-#endif 
 {
   PAssert(params.id > 0, PInvalidParameter);
   sessionID = params.id;
@@ -763,37 +814,6 @@ RTP_Session::RTP_Session(const Params & params)
 
   m_encodingHandler = NULL;
   SetEncoding(params.encoding);
-#if gaoshaobo
-///////////////gaoshaobo for srtp/////////////
-
-  if(srtp_use_audio)
-  {
-	  RTP_Session::audio_srtp = srtp_use_audio;
-  }
-  else
-  {
-	  RTP_Session::audio_srtp = 0;
-  }
-
-  if (!RTP_Session::inited && RTP_Session::audio_srtp)
-  {
-	printf("initialize srtp library, in audio\n");
-    srtp_err_status_t err = srtp_init();
-	if (err)
-	{
-		printf("error: srtp init failed with error code %d\n", err);
-//		exit(1);
-		 RTP_Session::inited = PFalse;
-	}
-	else
-	{
-		RTP_Session::inited = PTrue;
-		printf("srtp audio init ok \n");
-	}
-  }
-
-////////////////////////////////////////////////
-#endif
 //
 
 //  printf("Get sdt_skf_hy_crypt status = %d\n", Get_hy_sd_dev_handle_status());
@@ -844,33 +864,6 @@ RTP_Session::~RTP_Session()
       "    averageJitter      = " << GetAvgJitterTime() << "\n"
       "    maximumJitter      = " << GetMaxJitterTime()
    );
-#if gaoshaobo
-  ///////////////gaoshaobo for srtp/////////////
-
-  if(createdOut_audio)
-  {
-	createdOut_audio = PFalse;
-  	srtp_dealloc(ctxOut_audio);
-  }
-  if(createdIn_audio)
-  {
-	createdIn_audio = PFalse;
-  	srtp_dealloc(ctxIn_audio);
-  }
-
-  if (inited)
-  {
-//	  printf("srtp_shutdown by audio, begin\n");
-//	  if(!srtp_use_video)
-	  {
-		  srtp_shutdown();
-		  printf("srtp_shutdown by audio\n");
-	  }
-	  inited = PFalse;
-  }
-  ////////////////////////////////////////////////
-#endif
-
 #if bruce
     if(RTP_Session::audio_zrtp_inited && RTP_Session::audio_zrtp)
     {
@@ -1038,7 +1031,9 @@ void RTP_Session::SetJitterBufferSize(unsigned minJitterDelay,
     else {
       m_jitterBuffer = new RTP_JitterBuffer(*this, minJitterDelay, maxJitterDelay, m_timeUnits, packetSize);
       PTRACE(4, "RTP\tCreated RTP jitter buffer " << *m_jitterBuffer);
-      m_jitterBuffer->StartThread();
+      // A reactor writes received frames straight into the jitter buffer
+      if (GetReactor() == NULL)
+        m_jitterBuffer->StartThread();
     }
   }
 }
@@ -1150,84 +1145,6 @@ void RTP_Session::AddReceiverReport(RTP_ControlFrame::ReceiverReport & receiver)
 RTP_Session::SendReceiveStatus RTP_Session::OnSendData(RTP_DataFrame & frame)
 {
 
-#if gaoshaobo
-	/************gaoshaobo for srtp*********************/
-	if(RTP_Session::audio_srtp)
-	{
-		srtp_err_status_t err;
-		SendReceiveStatus stat = EncodingLock(*this)->OnSendData(frame);
-		if (stat != e_ProcessPacket)
-		{
-			return stat;
-		}
-		if(!createdOut_audio && inited)
-		{
-			memset(&policyOut_audio, 0, sizeof(srtp_policy_t));
-			srtp_crypto_policy_set_sdt_skf_hy_sm4_ecb(&policyOut_audio.rtp);
-		//	srtp_crypto_policy_set_rtp_default(&policyOut_audio.rtp);
-			policyOut_audio.ssrc.type = ssrc_specific;
-			policyOut_audio.ssrc.value = frame.GetSyncSource();
-
-			if(strlen((char*)ssl_session_key) != 0)
-			{
-				policyOut_audio.key = (unsigned char*)ssl_session_key;
-				printf("srtp audio out use no default key\n");
-			}
-			else
-				policyOut_audio.key = (unsigned char*)pKey_audio;
-
-//			policyOut_audio.key = (unsigned char*)inputKey;
-			policyOut_audio.ekt = NULL;
-			policyOut_audio.next = NULL;
-			policyOut_audio.window_size = 128;
-			policyOut_audio.allow_repeat_tx = 0;
-			policyOut_audio.rtp.sec_serv =(srtp_sec_serv_t)(sec_serv_conf);
-//			policyOut_audio.rtcp.sec_serv = sec_serv_none;
-
-//			int iKeyLen = policyOut_audio.rtp.cipher_key_len*2;
-//			int keyLen = hex_string_to_octet_string(inputKey, defKey, iKeyLen);
-//			if(keyLen < iKeyLen)
-//			{
-//				return e_IgnorePacket;
-//			}
-
-			err = srtp_create(&ctxOut_audio, &policyOut_audio);
-			if(err != srtp_err_status_ok)
-			{
-				printf("\nsrtp created audio Out failed %d\n", err);
-			}else
-			{
-				printf("\n\nsrtp created audio Out ok \n");
-				createdOut_audio = PTrue;
-			}
-		}
-		if(createdOut_audio)
-		{
-//			int len = frame.GetHeaderSize() + frame.GetPayloadSize();
-//			printf("len = %d\n", len);
-			int payload_len = frame.GetPayloadSize();
-			unsigned char pad_len_in = 0;
-			if(payload_len % 16 != 0)
-			{
-				set_Enc_pad(frame.GetPayloadPtr(), payload_len, &pad_len_in);
-				payload_len += pad_len_in;
-			}
-			frame.SetPayloadSize(payload_len);
-			int len = frame.GetHeaderSize() + frame.GetPayloadSize();
-//			frame.SetPayloadSize(len + 144);
-			err = ::srtp_protect(ctxOut_audio, frame.GetPointer(), &len);
-			if (err != srtp_err_status_ok)
-			{
-				printf("\nsrtp protected audio failed Out, err = \n", err);
-				return RTP_Session::e_IgnorePacket;
-			}
-			frame.SetPayloadSize(len - frame.GetHeaderSize());
-		}
-		return e_ProcessPacket;
-	}
-	/************gaoshaobo for srtp*********************/
-#endif
-
 #if bruce
 		if(!RTP_Session::audio_zrtp)		//added by lee, for zrtp
 			return EncodingLock(*this)->OnSendData(frame);
@@ -1398,77 +1315,6 @@ RTP_Session::SendReceiveStatus RTP_Session::Internal_OnSendControl(RTP_ControlFr
 RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(RTP_DataFrame & frame)
 {
 
-#if gaoshaobo
-	/************gaoshaobo for srtp*********************/
-	if(RTP_Session::audio_srtp)
-	{
-		srtp_err_status_t err ;
-		if(!createdIn_audio && inited)
-		{
-			memset(&policyIn_audio, 0, sizeof(srtp_policy_t));
-			srtp_crypto_policy_set_sdt_skf_hy_sm4_ecb(&policyIn_audio.rtp);
-//			srtp_crypto_policy_set_rtp_default(&policyIn_audio.rtp);
-			policyIn_audio.ssrc.type = ssrc_specific;
-			policyIn_audio.ssrc.value = frame.GetSyncSource();
-
-			if(strlen((char*)ssl_session_key) != 0)
-			{
-				policyIn_audio.key = (unsigned char*)ssl_session_key;
-				printf("srtp audio in use no default key\n");
-			}
-			else
-				policyIn_audio.key = (unsigned char*)pKey_audio;//key;
-
-//			policyIn_audio.key = (unsigned char*)inputKey;//key;
-			policyIn_audio.ekt = NULL;
-			policyIn_audio.next = NULL;
-			policyIn_audio.window_size = 128;
-			policyIn_audio.allow_repeat_tx = 0;
-			policyIn_audio.rtp.sec_serv = (srtp_sec_serv_t)(sec_serv_conf);
-			//		policyIn_audio.rtcp.sec_serv = sec_serv_none;
-
-//			int iKeyLen = policyIn_audio.rtp.cipher_key_len*2;
-//			int keyLen = hex_string_to_octet_string(inputKey, defKey, iKeyLen);
-//			if(keyLen < iKeyLen)
-//			{
-//				return e_IgnorePacket;
-//			}
-
-			err = srtp_create(&ctxIn_audio, &policyIn_audio);
-			if(err != srtp_err_status_ok)
-			{
-				printf("\nsrtp created audio In failed %d\n", err);
-			}else
-			{
-				printf("\nsrtp created audio In ok \n\n");
-				createdIn_audio = PTrue;
-			}
-		}
-
-		if(createdIn_audio)
-		{
-			int len = frame.GetHeaderSize() + frame.GetPayloadSize();
-
-			err = ::srtp_unprotect(ctxIn_audio, frame.GetPointer(), &len);
-
-			if (err != srtp_err_status_ok)
-			{
-				printf("\nsrtp unprotected audio failed IN %d, frame len : %d\n", err, len);
-				return RTP_Session::e_IgnorePacket;
-			}
-
-			unsigned char pad_len_out= 0;
-			if(check_Dec_pad(frame.GetPointer(), len, &pad_len_out) == 1)
-			{
-				len -= pad_len_out;
-			}
-
-			frame.SetPayloadSize(len - frame.GetHeaderSize());
-		}
-	}
-	/************gaoshaobo for srtp*********************/
-#endif
-
 
 #if bruce
 //	zrtp_stream_info_t info;	//gaoshaobo for zrtp
@@ -2236,18 +2082,17 @@ static void SetMinBufferSize(PUDPSocket & sock, int buftype, int bufsz)
     PTRACE(1, "RTP_UDP\tSetOption(" << sock.GetHandle() << ',' << buftype << ',' << bufsz << ") failed, even though it said it succeeded!");
   }
 }
-#if bruce
-class RTP_UDP;
-//PUDPSocket * RTP_UDP::sock_audio=NULL;
-RTP_UDP* RTP_UDP::rtp_udp_audio=NULL;
-
-
-#endif
 RTP_UDP::RTP_UDP(const Params & params)
   : RTP_Session(params),
     remoteAddress(0),
     remoteTransmitAddress(0),
-    remoteIsNAT(params.remoteIsNAT)
+    remoteIsNAT(params.remoteIsNAT),
+    m_reactor(NULL),
+    m_reactorFramesAvailable(0, INT_MAX),
+    m_reactorBatch(NULL),
+    m_writeBatch(NULL),
+    m_writeBatchCount(0),
+    m_writeBatching(false)
 {
   PTRACE(4, "RTP_UDP\tSession " << sessionID << ", created with NAT flag set to " << remoteIsNAT);
   remoteDataPort    = 0;
@@ -2261,83 +2106,29 @@ RTP_UDP::RTP_UDP(const Params & params)
   badTransmitCounter = 0;
 
   timerWriteDataIdle.SetNotifier(PCREATE_NOTIFIER(OnWriteDataIdle));
-#if bruce
-//  zrtp_recv_thread=NULL;
-#endif
-}
-#if bruce
-void* RTP_UDP::zrtp_audio_stop(void*)
-{
-	pthread_detach(pthread_self());
-	printf("stop zrtp audio thread\n");
-	if(RTP_Session::audio_zrtp_inited && RTP_Session::audio_zrtp)
-    	{
-		RTP_UDP::rtp_udp_audio=NULL;
-		RTP_Session::audio_zrtp_inited = FALSE;
-		printf("111\n");
-//		get_obj()->dataMutex.Wait();
-		int error_num=0;
-		printf("222\n");
-		error_num=zrtp_stream_stop(stream_audio);
-		printf("check zrtp_stream_stop audio wheather has errors , return = %d\n", error_num);
-		printf("333\n");
-		zrtp_session_down(session_audio);
-		printf("444\n");
-		zrtp_down(zrtp_audio);
-		printf("555\n");
-//		get_obj()->dataMutex.Signal();
-		printf("666\n");
-
-      		
-    	}
-
 }
-#endif
 RTP_UDP::~RTP_UDP()
 {
 
 
 
 #if bruce
-/*
-  PAssert(zrtp_recv_thread->WaitForTermination(10000), "zrtp_recv_thread did not terminate");
-  delete zrtp_recv_thread;
-  zrtp_recv_thread=NULL;
-
-*/
-
   if(RTP_Session::audio_zrtp_inited && RTP_Session::audio_zrtp && isAudio)
   {
-//    	pthread_create(&thread_audio_stop, NULL, zrtp_audio_stop, NULL);
-	RTP_UDP::rtp_udp_audio=NULL;
+	// stop libzrtp sending through a socket that is about to go away, and
+	// wait out a send already in progress on the scheduler thread
+	PWaitAndSignal mutex(zrtpSenderMutex);
+	if (zrtp_stream_get_userdata(stream_audio) == this)
+		zrtp_stream_set_userdata(stream_audio, NULL);
 	RTP_Session::audio_zrtp_inited = FALSE;
   }
 
-/*	
-    if(RTP_Session::audio_zrtp_inited && RTP_Session::audio_zrtp && isAudio)
-    {
-		printf("111\n");
-		dataMutex.Wait();
-		int error_num=0;
-		printf("222\n");
-		error_num=zrtp_stream_stop(stream_audio);
-		printf("check zrtp_stream_stop audio wheather has errors , return = %d\n", error_num);
-		printf("333\n");
-		zrtp_session_down(session_audio);
-		printf("444\n");
-		zrtp_down(zrtp_audio);
-		printf("555\n");
-		RTP_Session::audio_zrtp_inited = FALSE;
-		dataMutex.Signal();
-		printf("666\n");
-      RTP_UDP::rtp_udp_audio=NULL;
-    }
-*/
 
 #endif
 
 
   timerWriteDataIdle.Stop();
+  DetachReactor();
   Close(true);
   Close(false);
 
@@ -2348,6 +2139,9 @@ RTP_UDP::~RTP_UDP()
 
   delete dataSocket;
   delete controlSocket;
+
+  delete m_reactorBatch;
+  delete m_writeBatch;
 }
 //dong change for h239 //dong MCU may send QOS, just for backup
 PQoS & RTP_UDP::GetQOS()
@@ -2388,176 +2182,50 @@ PBoolean RTP_UDP::ModifyQOS(RTP_QOS * rtpqos)
 
 
 #if bruce
-/*
-int RTP_UDP::zrtp_sender(const zrtp_stream_t * stream_audio, char* packet, unsigned int length)
-{
-//	PWaitAndSignal mutex(zrtp_mutex);
-	
-	zrtp_stream_t* tmpStr = (zrtp_stream_t*)stream_audio;
-	int lenSend;
-	status_audio = zrtp_process_rtp(tmpStr, packet, &length);
-	if(status_audio != zrtp_status_ok)
-	{
-		printf("[zrtp_main_sender] :\t Error when process rtp packet(s)");
-		return status_audio;
-	}
-
-	PBoolean send_ok=sock_audio->Write(packet,length);
-//	lenSend = sendto(sock->os_handle, packet, length, 0, (struct sockaddr*)&sendaddr_audio, sizeof(struct sockaddr_in));
-//	if(lenSend<=0)
-	if(!send_ok)
-	{
-		printf("[zrtp_main_sender] :\t Error when send rtp packet(s)");
-//		return 1;
-	}
-
-	return zrtp_status_ok;
-}
-*/
-
-RTP_UDP * RTP_UDP::get_obj()
-{
-	return RTP_UDP::rtp_udp_audio;
-}
+PMutex RTP_UDP::zrtpSenderMutex;
 
 int RTP_UDP::zrtp_sender_get(const zrtp_stream_t * stream_audio, char* packet, unsigned int length)
 {
+	PWaitAndSignal mutex(zrtpSenderMutex);
+	RTP_UDP * session = (RTP_UDP *)zrtp_stream_get_userdata(stream_audio);
+	if (session == NULL || session->dataSocket == NULL)
+		return zrtp_status_fail;
 
-//	PWaitAndSignal mutex(get_obj()->dataMutex);
-	
 	zrtp_stream_t* tmpStr = (zrtp_stream_t*)stream_audio;
-	int lenSend;
-	status_audio = zrtp_process_rtp(tmpStr, packet, &length);
-	if(status_audio != zrtp_status_ok)
+	zrtp_status_t status = zrtp_process_rtp(tmpStr, packet, &length);
+	if(status != zrtp_status_ok)
 	{
-		printf("[zrtp_main_sender] :\t Error when process rtp packet(s)");
-		return status_audio;
+		PTRACE(2, "RTP_UDP\tSession " << session->sessionID << ", ZRTP process rtp error " << status);
+		return status;
 	}
 
-	PBoolean send_ok=get_obj()->dataSocket->Write(packet,length);
-//	lenSend = sendto(sock->os_handle, packet, length, 0, (struct sockaddr*)&sendaddr_audio, sizeof(struct sockaddr_in));
-//	if(lenSend<=0)
-	if(!send_ok)
+	if (!session->dataSocket->Write(packet,length))
 	{
-		printf("[zrtp_main_sender] :\t Error when send rtp packet(s)");
-//		return 1;
+		PTRACE(2, "RTP_UDP\tSession " << session->sessionID << ", ZRTP packet send failed: " << session->dataSocket->GetErrorText());
 	}
 
 	return zrtp_status_ok;
 }
 
-/*
-void* RTP_UDP::zrtp_recv(void*)
-{
-	pthread_detach(pthread_self());
-//	PWaitAndSignal mutex(zrtp_mutex);
-	int lenRecv;
-	PBoolean zrtpOk = false;
-	int sockLen = sizeof(struct sockaddr);
-	char recvBuf[200];
-	zrtp_stream_info_t info;
-	unsigned int recv_len=200;
-
-	while(!zrtpOk)
-	{
-//		lenRecv = recvfrom(sock->os_handle, recvBuf, 200, 0, (struct sockaddr*)&recvaddr_audio, (unsigned int*)&sockLen);
-//		zrtp_mutex.Wait();
-		PBoolean recv_ok=sock_audio->Read(recvBuf,recv_len);
-//		printf("recvBuf=%s\n",recvBuf);
-		unsigned int read_len=sock_audio->GetLastReadCount();
-//		zrtp_mutex.Signal();
-//		if(lenRecv>0)
-		if(recv_ok)
-		{
-//			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&lenRecv);
-			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&(read_len));
-			zrtp_stream_get(stream_audio, &info);
-			if(info.state == ZRTP_STATE_SECURE)
-			{
-				zrtpOk = true;
-			}			
-		}
-	}
-	return NULL;
-}
-*/
 
-int RTP_UDP::zrtp_recv()
-{	
-	pthread_detach(pthread_self());
-//	PWaitAndSignal mutex(dataMutex);
-	int lenRecv;
-	PBoolean zrtpOk = false;
-	int sockLen = sizeof(struct sockaddr);
-	char recvBuf[200];
-	zrtp_stream_info_t info;
-	unsigned int recv_len=200;
-
-	while(!zrtpOk)
-	{
-//		lenRecv = recvfrom(sock->os_handle, recvBuf, 200, 0, (struct sockaddr*)&recvaddr_audio, (unsigned int*)&sockLen);
-		dataMutex.Wait();
-		PBoolean recv_ok=dataSocket->Read(recvBuf,recv_len);
-//		printf("recvBuf=%s\n",recvBuf);
-		unsigned int read_len=dataSocket->GetLastReadCount();
-		dataMutex.Signal();
-//		if(lenRecv>0)
-		if(recv_ok)
-		{
-//			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&lenRecv);
-			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&(read_len));
-			zrtp_stream_get(stream_audio, &info);
-			if(info.state == ZRTP_STATE_SECURE)
-			{
-				zrtpOk = true;
-			}			
-		}
-	}
-	return 0;
-}
+bool RTP_UDP::HandleZRTPPacket(BYTE * packet, PINDEX length)
+{
+	// ZRTP messages carry the magic cookie where RTP has its timestamp
+	if (length < RTP_DataFrame::MinHeaderSize ||
+	    *(PUInt32b *)(packet + 4) != (DWORD)ZRTP_PACKETS_MAGIC)
+		return false;
 
-static void* callback_zrtp_recv( void* arg )  
-{  
-    ((RTP_UDP*)arg)->zrtp_recv();
-    return NULL;  
-} 
+	if (!RTP_Session::audio_zrtp_inited || !RTP_Session::audio_zrtp || !isAudio)
+		return true;	// not ours to handle, but never valid RTP either
 
-/*
-void  RTP_UDP::Recv_Thread(PThread &, INT)
-{
-//	pthread_detach(pthread_self());
-	PWaitAndSignal mutex(zrtp_mutex);
-//	PSafeLockReadWrite safeLock(sock_audio);
-	int lenRecv;
-	PBoolean zrtpOk = false;
-	int sockLen = sizeof(struct sockaddr);
-	char recvBuf[200];
-	zrtp_stream_info_t info;
-	unsigned int recv_len=200;
-
-	while(!zrtpOk)
+	unsigned int len = length;
+	zrtp_status_t status = zrtp_process_srtp(stream_audio, (char*)packet, &len);
+	if (status != zrtp_status_ok && status != zrtp_status_drop)
 	{
-//		lenRecv = recvfrom(sock->os_handle, recvBuf, 200, 0, (struct sockaddr*)&recvaddr_audio, (unsigned int*)&sockLen);
-//		zrtp_mutex.Wait();
-		PBoolean recv_ok=dataSocket->Read(recvBuf,recv_len);
-//		printf("recvBuf=%s\n",recvBuf);
-		unsigned int read_len=dataSocket->GetLastReadCount();
-//		zrtp_mutex.Signal();
-//		if(lenRecv>0)
-		if(recv_ok)
-		{
-//			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&lenRecv);
-			status_audio = zrtp_process_srtp(stream_audio, recvBuf, (unsigned int*)&(read_len));
-			zrtp_stream_get(stream_audio, &info);
-			if(info.state == ZRTP_STATE_SECURE)
-			{
-				zrtpOk = true;
-			}			
-		}
+		PTRACE(2, "RTP_UDP\tSession " << sessionID << ", ZRTP packet processing error " << status);
 	}
-//	return NULL;
+	return true;
 }
-*/
 #endif
 
 
@@ -2739,6 +2407,9 @@ bool RTP_UDP::Close(PBoolean reading)
           PIPSocket::GetHostAddress(addr);
         dataSocket->WriteTo("", 1, addr, port);
       }
+
+      if (m_reactor != NULL)
+        m_reactorFramesAvailable.Signal();
     }
 
     SetJitterBufferSize(0, 0); // Kill jitter buffer too, but outside mutex
@@ -2824,8 +2495,6 @@ PBoolean RTP_UDP::SetRemoteSocketInfo(PIPSocket::Address address, WORD port, PBo
 			localDataPort,
 			remoteDataPort);
 	
-//      sock_audio=dataSocket;
-      RTP_UDP::rtp_udp_audio=this;
       unsigned int Remote_IP_Net=(unsigned int)(inet_addr(remoteAddress.AsString().GetPointer(0))+2);
       printf("zrtp_use_audio=%d\n",zrtp_use_audio);	
       if(zrtp_use_audio)
@@ -2873,6 +2542,8 @@ PBoolean RTP_UDP::SetRemoteSocketInfo(PIPSocket::Address address, WORD port, PBo
 			printf("[ZRTP_Error]:\t zrtp stream attach error, code : %d\n", status_audio);
 			exit(status_audio);
 		}
+		// zrtp_sender_get() finds its socket through this
+		zrtp_stream_set_userdata(stream_audio, this);
 		//begin zrtp stream
 		status_audio = zrtp_stream_start(stream_audio, 11);
 		if(status_audio != zrtp_status_ok)
@@ -2880,22 +2551,8 @@ PBoolean RTP_UDP::SetRemoteSocketInfo(PIPSocket::Address address, WORD port, PBo
 			printf("[ZRTP_Error]:\t zrtp stream start error, code : %d\n", status_audio);
 			exit(status_audio);
 		}
-		//create a thread for zrtp packet receiving
-//		zrtp_thread_create(zrtp_recv, NULL);
-//		dataMutex.Wait();
-		pthread_create(&thread_recv_zrtp_audio, NULL, callback_zrtp_recv, this);
-//		dataMutex.Signal();
-//  		zrtp_mutex.Wait();
-
-// 		if (zrtp_recv_thread == NULL) {
-//   			 zrtp_recv_thread = PThread::Create(PCREATE_NOTIFIER(Recv_Thread), "ZRTP RECV");
-//zrtp_recv_thread = PThread::Create(PCREATE_NOTIFIER(Recv_Thread), 0, PThread::AutoDeleteThread, PThread::NormalPriority, "ZRTP RECV", 65535*16);
-//    			 zrtp_recv_thread->Resume();
-//  		}
-
-//  		zrtp_mutex.Signal();
-
-
+		// ZRTP packets arrive on the data socket and are picked out by
+		// Internal_ReadDataPDU(), so no receive thread is needed here
 
 		RTP_Session::audio_zrtp_inited = TRUE;
 	    }
@@ -2934,6 +2591,9 @@ printf("ReadData_1, GetHeaderSize=%d, len1=%d, dataSocket->GetLastReadCount()=%d
 
 PBoolean RTP_UDP::Internal_ReadData(RTP_DataFrame & frame)
 {
+  if (m_reactor != NULL)
+    return ReadReactorFrame(frame);
+
   SendReceiveStatus receiveStatus = e_IgnorePacket;
   while (receiveStatus == e_IgnorePacket) {
     if (shutdownRead || PAssertNULL(dataSocket) == NULL || PAssertNULL(controlSocket) == NULL)
@@ -2970,6 +2630,12 @@ void RTP_UDP::FlushData()
   if (shutdownRead || dataSocket == NULL)
     return;
 
+  {
+    PWaitAndSignal mutex(m_reactorFramesMutex);
+    while (!m_reactorFrames.empty())
+      m_reactorFrames.pop();
+  }
+
   PTimeInterval oldTimeout = dataSocket->GetReadTimeout();
   dataSocket->SetReadTimeout(0);
 
@@ -2999,52 +2665,72 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadDataOrControlPDU(BYTE * framePtr,
                                                              PINDEX frameSize,
                                                              PBoolean fromDataChannel)
 {
-#if PTRACING
-  const char * channelName = fromDataChannel ? "Data" : "Control";
-#endif
   PUDPSocket & socket = *(fromDataChannel ? dataSocket : controlSocket);
   PIPSocket::Address addr;
   WORD port;
 
-  if (socket.ReadFrom(framePtr, frameSize, addr, port)) {
-    // If remote address never set from higher levels, then try and figure
-    // it out from the first packet received.
-    if (!remoteAddress.IsValid()) {
-      remoteAddress = addr;
-      PTRACE(4, "RTP\tSession " << sessionID << ", set remote address from first "
-             << channelName << " PDU from " << addr << ':' << port);
-    }
-    if (fromDataChannel) {
-      if (remoteDataPort == 0)
-        remoteDataPort = port;
-    }
-    else {
-      if (remoteControlPort == 0)
-        remoteControlPort = port;
-    }
+  if (socket.ReadFrom(framePtr, frameSize, addr, port))
+    return OnReceivedPDU(addr, port, fromDataChannel);
 
-    if (!remoteTransmitAddress.IsValid())
-      remoteTransmitAddress = addr;
-    else if (allowRemoteTransmitAddressChange && remoteAddress == addr) {
-      remoteTransmitAddress = addr;
-      allowRemoteTransmitAddressChange = false;
-    }
-    else if (remoteTransmitAddress != addr && !allowRemoteTransmitAddressChange) {
-      PTRACE(2, "RTP_UDP\tSession " << sessionID << ", "
-             << channelName << " PDU from incorrect host, "
-                " is " << addr << " should be " << remoteTransmitAddress);
-      return RTP_Session::e_IgnorePacket;
-    }
+  return OnReadError(socket.GetErrorNumber(PChannel::LastReadError), fromDataChannel, frameSize);
+}
 
-    if (remoteAddress.IsValid() && !appliedQOS) 
-      ApplyQOS(remoteAddress);
 
-    badTransmitCounter = 0;
+RTP_Session::SendReceiveStatus RTP_UDP::OnReceivedPDU(const PIPSocket::Address & addr,
+                                                      WORD port,
+                                                      bool fromDataChannel)
+{
+#if PTRACING
+  const char * channelName = fromDataChannel ? "Data" : "Control";
+#endif
+
+  // If remote address never set from higher levels, then try and figure
+  // it out from the first packet received.
+  if (!remoteAddress.IsValid()) {
+    remoteAddress = addr;
+    PTRACE(4, "RTP\tSession " << sessionID << ", set remote address from first "
+           << channelName << " PDU from " << addr << ':' << port);
+  }
+  if (fromDataChannel) {
+    if (remoteDataPort == 0)
+      remoteDataPort = port;
+  }
+  else {
+    if (remoteControlPort == 0)
+      remoteControlPort = port;
+  }
 
-    return RTP_Session::e_ProcessPacket;
+  if (!remoteTransmitAddress.IsValid())
+    remoteTransmitAddress = addr;
+  else if (allowRemoteTransmitAddressChange && remoteAddress == addr) {
+    remoteTransmitAddress = addr;
+    allowRemoteTransmitAddressChange = false;
   }
+  else if (remoteTransmitAddress != addr && !allowRemoteTransmitAddressChange) {
+    PTRACE(2, "RTP_UDP\tSession " << sessionID << ", "
+           << channelName << " PDU from incorrect host, "
+              " is " << addr << " should be " << remoteTransmitAddress);
+    return RTP_Session::e_IgnorePacket;
+  }
+
+  if (remoteAddress.IsValid() && !appliedQOS) 
+    ApplyQOS(remoteAddress);
 
-  switch (socket.GetErrorNumber(PChannel::LastReadError)) {
+  badTransmitCounter = 0;
+
+  return RTP_Session::e_ProcessPacket;
+}
+
+
+RTP_Session::SendReceiveStatus RTP_UDP::OnReadError(int errorNumber,
+                                                    bool fromDataChannel,
+                                                    PINDEX PTRACE_PARAM(frameSize))
+{
+#if PTRACING
+  const char * channelName = fromDataChannel ? "Data" : "Control";
+#endif
+
+  switch (errorNumber) {
     case ECONNRESET :
     case ECONNREFUSED :
       PTRACE(2, "RTP_UDP\tSession " << sessionID << ", " << channelName << " port on remote not ready.");
@@ -3076,8 +2762,8 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadDataOrControlPDU(BYTE * framePtr,
 
     default:
       PTRACE(1, "RTP_UDP\tSession " << sessionID << ", " << channelName
-             << " read error (" << socket.GetErrorNumber(PChannel::LastReadError) << "): "
-             << socket.GetErrorText(PChannel::LastReadError));
+             << " read error (" << errorNumber << "): "
+             << PChannel::GetErrorText(PChannel::Miscellaneous, errorNumber));
       return RTP_Session::e_AbortTransport;
   }
 }
@@ -3094,8 +2780,20 @@ RTP_Session::SendReceiveStatus RTP_UDP::Internal_ReadDataPDU(RTP_DataFrame & fra
   if (status != e_ProcessPacket)
     return status;
 
+  return OnReceivedDataPDU(frame, dataSocket->GetLastReadCount());
+}
+
+
+RTP_Session::SendReceiveStatus RTP_UDP::OnReceivedDataPDU(RTP_DataFrame & frame, PINDEX pduSize)
+{
+#if bruce
+  // ZRTP handshake shares the data port with media
+  if (HandleZRTPPacket(frame.GetPointer(), pduSize))
+    return e_IgnorePacket;
+#endif
+
   // Check received PDU is big enough
-  if (frame.SetPacketSize(dataSocket->GetLastReadCount()))
+  if (frame.SetPacketSize(pduSize))
     return OnReceiveData(frame);
   return e_IgnorePacket;
 }
@@ -3134,7 +2832,12 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadControlPDU()
   if (status != e_ProcessPacket)
     return status;
 
-  PINDEX pduSize = controlSocket->GetLastReadCount();
+  return OnReceivedControlPDU(frame, controlSocket->GetLastReadCount());
+}
+
+
+RTP_Session::SendReceiveStatus RTP_UDP::OnReceivedControlPDU(RTP_ControlFrame & frame, PINDEX pduSize)
+{
   if (pduSize < 4 || pduSize < 4+frame.GetPayloadSize()) {
     PTRACE_IF(2, pduSize != 1 || !m_firstControl, "RTP_UDP\tSession " << sessionID
               << ", Received control packet too small: " << pduSize << " bytes");
@@ -3147,6 +2850,209 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadControlPDU()
 }
 
 
+bool RTP_UDP::AttachReactor(RTP_Reactor & reactor)
+{
+  if (m_reactor != NULL)
+    return m_reactor == &reactor;
+
+  if (m_jitterBuffer != NULL) {
+    PTRACE(2, "RTP_UDP\tSession " << sessionID << ", cannot attach reactor after jitter buffer started");
+    return false;
+  }
+
+  m_reactor = &reactor;
+  if (reactor.Add(*this)) {
+    PTRACE(3, "RTP_UDP\tSession " << sessionID << ", receiving on shared reactor");
+    return true;
+  }
+
+  m_reactor = NULL;
+  return false;
+}
+
+
+void RTP_UDP::DetachReactor()
+{
+  RTP_Reactor * reactor = m_reactor;
+  if (reactor == NULL)
+    return;
+
+  reactor->Remove(*this);
+  m_reactor = NULL;
+
+  PTRACE(3, "RTP_UDP\tSession " << sessionID << ", detached from reactor");
+
+  // Nothing feeds the jitter buffer now, so it needs its own thread again
+  JitterBufferPtr jitter = m_jitterBuffer;
+  if (jitter != NULL)
+    jitter->StartThread();
+
+  // Wake any reader waiting on the reactor queue, it will go back to select
+  m_reactorFramesAvailable.Signal();
+}
+
+
+void RTP_UDP::OnReactorReadable(bool fromDataChannel)
+{
+  if (fromDataChannel) {
+    ReadReactorBatch();
+    return;
+  }
+
+  if (controlSocket == NULL)
+    return;
+
+  int handle = controlSocket->GetHandle();
+
+  for (unsigned count = 0; count < RTP_Reactor::MaxReadsPerEvent; ++count) {
+    RTP_ControlFrame control(RTP_REACTOR_PACKET_SIZE);
+
+    sockaddr_storage sa;
+    socklen_t saLen = sizeof(sa);
+
+    // MSG_TRUNC returns the real length of an oversized datagram, so it is
+    // reported as EMSGSIZE as the blocking read would.
+    ssize_t pduSize = ::recvfrom(handle, control.GetPointer(), control.GetSize(),
+                                 MSG_DONTWAIT|MSG_TRUNC, (sockaddr *)&sa, &saLen);
+    SendReceiveStatus status;
+    if (pduSize < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      status = OnReadError(errno, false, control.GetSize());
+    }
+    else if (pduSize > control.GetSize())
+      status = OnReadError(EMSGSIZE, false, control.GetSize());
+    else if (shutdownRead)
+      status = e_IgnorePacket; // Closed for reading, discard as a flush would
+    else {
+      PIPSocket::Address addr(sa.ss_family, saLen, (sockaddr *)&sa);
+      WORD port = ntohs(sa.ss_family == AF_INET ? ((sockaddr_in &)sa).sin_port
+                                                : ((sockaddr_in6 &)sa).sin6_port);
+      status = OnReceivedPDU(addr, port, false);
+      if (status == e_ProcessPacket)
+        status = OnReceivedControlPDU(control, pduSize);
+    }
+
+    if (status == e_AbortTransport) {
+      PTRACE(2, "RTP_UDP\tSession " << sessionID << ", aborting reads from reactor");
+      Close(true);
+      DetachReactor();
+      return;
+    }
+  }
+}
+
+
+void RTP_UDP::ReadReactorBatch()
+{
+  if (dataSocket == NULL)
+    return;
+
+  // Only ever called from the one reactor loop, so needs no lock
+  if (m_reactorBatch == NULL) {
+    m_reactorBatch = new PUDPSocket::Batch(RTP_Reactor::MaxReadsPerEvent);
+    m_reactorBatchFrames.resize(RTP_Reactor::MaxReadsPerEvent);
+  }
+
+  for (PINDEX i = 0; i < m_reactorBatch->GetSize(); ++i) {
+    RTP_DataFrame & frame = m_reactorBatchFrames[i];
+    frame.SetMinSize(RTP_REACTOR_PACKET_SIZE);
+    m_reactorBatch->SetBuffer(i, frame.GetPointer(), frame.GetSize());
+  }
+
+  if (!dataSocket->ReadBatch(*m_reactorBatch, false)) {
+    int error = dataSocket->GetErrorNumber(PChannel::LastReadError);
+    if (error == EAGAIN || error == EWOULDBLOCK)
+      return;
+
+    if (OnReadError(error, true, RTP_REACTOR_PACKET_SIZE) == e_AbortTransport) {
+      PTRACE(2, "RTP_UDP\tSession " << sessionID << ", aborting reads from reactor");
+      Close(true);
+      DetachReactor();
+    }
+    return;
+  }
+
+  for (PINDEX i = 0; i < m_reactorBatch->GetCount(); ++i) {
+    RTP_DataFrame & frame = m_reactorBatchFrames[i];
+    PINDEX pduSize = m_reactorBatch->GetLength(i);
+
+    SendReceiveStatus status;
+    if (m_reactorBatch->IsTruncated(i))
+      status = OnReadError(EMSGSIZE, true, frame.GetSize());
+    else if (shutdownRead)
+      status = e_IgnorePacket; // Closed for reading, discard as a flush would
+    else {
+      PIPSocket::Address addr;
+      WORD port;
+      m_reactorBatch->GetAddress(i, addr, port);
+      status = OnReceivedPDU(addr, port, true);
+      if (status == e_ProcessPacket && (status = OnReceivedDataPDU(frame, pduSize)) == e_ProcessPacket) {
+        QueueReactorFrame(frame);
+        // The queued copy shares the buffer, so the next read needs its own
+        frame = RTP_DataFrame(0, RTP_REACTOR_PACKET_SIZE);
+      }
+    }
+
+    if (status == e_AbortTransport) {
+      PTRACE(2, "RTP_UDP\tSession " << sessionID << ", aborting reads from reactor");
+      Close(true);
+      DetachReactor();
+      return;
+    }
+  }
+}
+
+
+void RTP_UDP::QueueReactorFrame(const RTP_DataFrame & frame)
+{
+  JitterBufferPtr jitter = m_jitterBuffer; // Increase reference count
+  if (jitter != NULL) {
+#if OPAL_RTCP_XR
+    RTCP_XR_Metrics * metrics = GetExtendedMetrics();
+    if (metrics != NULL)
+      metrics->SetJitterDelay(jitter->GetCurrentJitterDelay()/jitter->GetTimeUnits());
+#endif
+    jitter->WriteData(frame);
+    return;
+  }
+
+  PWaitAndSignal mutex(m_reactorFramesMutex);
+
+  if (m_reactorFrames.size() < RTP_REACTOR_QUEUE_MAX)
+    m_reactorFramesAvailable.Signal();
+  else {
+    PTRACE(4, "RTP_UDP\tSession " << sessionID << ", reader not keeping up, dropping oldest frame");
+    m_reactorFrames.pop();
+  }
+
+  m_reactorFrames.push(frame);
+}
+
+
+PBoolean RTP_UDP::ReadReactorFrame(RTP_DataFrame & frame)
+{
+  for (;;) {
+    if (shutdownRead)
+      return false;
+
+    {
+      PWaitAndSignal mutex(m_reactorFramesMutex);
+      if (!m_reactorFrames.empty()) {
+        frame = m_reactorFrames.front();
+        m_reactorFrames.pop();
+        return true;
+      }
+    }
+
+    if (m_reactor == NULL)
+      return Internal_ReadData(frame);
+
+    m_reactorFramesAvailable.Wait();
+  }
+}
+
+
 PBoolean RTP_UDP::WriteOOBData(RTP_DataFrame & frame, bool rewriteTimeStamp)
 {
   PWaitAndSignal m(dataMutex);
@@ -3266,6 +3172,10 @@ void RTP_UDP::SetEncoding(const PString & newEncoding)
   timerWriteDataIdle.Stop(false);
   dataMutex.Signal();
 
+  // Other encodings read their PDUs themselves, so need the session thread
+  if (m_reactor != NULL && newEncoding != "rtp/avp")
+    DetachReactor();
+
   RTP_Session::SetEncoding(newEncoding);
 }
 
@@ -3291,6 +3201,74 @@ PBoolean RTP_UDP::WriteControl(RTP_ControlFrame & frame)
 
 
 bool RTP_UDP::WriteDataOrControlPDU(const BYTE * framePtr, PINDEX frameSize, bool toDataChannel)
+{
+  if (!toDataChannel || !m_writeBatching || m_writeBatchThread != PThread::GetCurrentThreadId())
+    return SendPDU(framePtr, frameSize, toDataChannel);
+
+  // The caller reuses the frame once this returns, so hold a copy
+  PINDEX idx = m_writeBatchCount++;
+  BYTE * ptr = m_writeBatchBuffers[idx].GetPointer(frameSize);
+  memcpy(ptr, framePtr, frameSize);
+  m_writeBatch->SetBuffer(idx, ptr, frameSize);
+  m_writeBatch->SetAddress(idx, remoteAddress, remoteDataPort);
+
+  if (m_writeBatchCount < m_writeBatch->GetSize())
+    return true;
+
+  return SendWriteBatch();
+}
+
+
+void RTP_UDP::StartWriteBatch()
+{
+  // Holding frames only pays if they then go in one system call
+  if (dataSocket == NULL || !PUDPSocket::CanWriteBatch())
+    return;
+
+  /* An audio frame is one packet, so holding it would only add a copy and
+     still take a system call of its own. */
+  if (isAudio)
+    return;
+
+  if (m_writeBatch == NULL) {
+    m_writeBatch = new PUDPSocket::Batch(RTP_WRITE_BATCH_SIZE);
+    m_writeBatchBuffers.resize(RTP_WRITE_BATCH_SIZE);
+  }
+
+  m_writeBatchThread = PThread::GetCurrentThreadId();
+  m_writeBatching = true;
+}
+
+
+bool RTP_UDP::EndWriteBatch()
+{
+  if (!m_writeBatching)
+    return true;
+
+  m_writeBatching = false;
+  return SendWriteBatch();
+}
+
+
+bool RTP_UDP::SendWriteBatch()
+{
+  PINDEX count = m_writeBatchCount;
+  m_writeBatchCount = 0;
+
+  if (count == 0 || dataSocket->WriteBatch(*m_writeBatch, count))
+    return true;
+
+  // Send the rest singly, so errors get the usual retries and logging
+  for (PINDEX i = m_writeBatch->GetCount(); i < count; ++i) {
+    if (!SendPDU((const BYTE *)m_writeBatch->GetBuffer(i), m_writeBatch->GetLength(i), true))
+      return false;
+  }
+
+  return true;
+}
+
+
+bool RTP_UDP::SendPDU(const BYTE * framePtr, PINDEX frameSize, bool toDataChannel)
 {
   PUDPSocket & socket = *(toDataChannel ? dataSocket : controlSocket);
   WORD port = toDataChannel ? remoteDataPort : remoteControlPort;
@@ -45,6 +45,7 @@
 #include <opal/connection.h>
 #include <h323/h323caps.h>
 #include <h323/h235auth.h>
+#include <ptclib/random.h>
 
 
 class PNatMethod;
@@ -86,15 +87,52 @@ OpalSRTP_UDP::OpalSRTP_UDP(const Params & params)
 #endif
 
 extern "C" {
-#include "srtp/srtp.h"		
+#include <srtp2/srtp.h>
 };
 
+// Key exported from the TLS signalling channel, all zero if there was none
+extern unsigned char ssl_session_key[16];
+
+// Master key used by the SM4 modes when no key has been negotiated
+static const BYTE DefaultSM4Key[16] = {
+  0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+  0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+
+// srtp_init()/srtp_shutdown() are process wide, reference count them across sessions
+static PMutex   SRTPLibraryMutex;
+static unsigned SRTPLibraryRefs = 0;
+
+static bool AcquireSRTPLibrary()
+{
+  PWaitAndSignal m(SRTPLibraryMutex);
+  if (SRTPLibraryRefs == 0) {
+    srtp_err_status_t err = srtp_init();
+    if (err != srtp_err_status_ok) {
+      PTRACE(1, "SRTP\tLibrary initialisation failed, error " << err);
+      return false;
+    }
+  }
+  ++SRTPLibraryRefs;
+  return true;
+}
+
+static void ReleaseSRTPLibrary()
+{
+  PWaitAndSignal m(SRTPLibraryMutex);
+  if (SRTPLibraryRefs > 0 && --SRTPLibraryRefs == 0)
+    srtp_shutdown();
+}
+
 ///////////////////////////////////////////////////////
 
 class LibSRTPSecurityMode_Base : public OpalSRTPSecurityMode
 {
   PCLASSINFO(LibSRTPSecurityMode_Base, OpalSRTPSecurityMode);
   public:
+    LibSRTPSecurityMode_Base();
+    ~LibSRTPSecurityMode_Base();
+
     RTP_UDP * CreateRTPSession(
       OpalRTPConnection & connection,     ///< Connection creating session (may be needed by secure connections)
       const RTP_Session::Params & options ///< Parameters to construct with session.
@@ -112,39 +150,82 @@ class LibSRTPSecurityMode_Base : public OpalSRTPSecurityMode
 
     PBoolean Open();
 
+    /// Block size RTP payloads must be padded to before protection, zero for none
+    unsigned GetBlockPadding() const { return blockPadding; }
+
+    /// Indicate RTCP is protected as well as RTP
+    bool GetProtectControl() const { return protectControl; }
+
     srtp_t inboundSession;
     srtp_t outboundSession;
 
   protected:
     void Init();
+    void UseSharedKey();
+
     KeySalt incomingKey;
     KeySalt outgoingKey;
     srtp_policy_t inboundPolicy;
     srtp_policy_t outboundPolicy;
+    unsigned blockPadding;
+    bool protectControl;
 
   private:
-    static PBoolean inited;
-    static PMutex initMutex;
+    bool libraryInited;
 };
 
-PBoolean LibSRTPSecurityMode_Base::inited = PFalse;
-PMutex LibSRTPSecurityMode_Base::initMutex;
+
+LibSRTPSecurityMode_Base::LibSRTPSecurityMode_Base()
+  : inboundSession(NULL)
+  , outboundSession(NULL)
+  , blockPadding(0)
+  , protectControl(true)
+{
+  memset(&inboundPolicy, 0, sizeof(inboundPolicy));
+  memset(&outboundPolicy, 0, sizeof(outboundPolicy));
+  libraryInited = AcquireSRTPLibrary();
+}
+
+
+LibSRTPSecurityMode_Base::~LibSRTPSecurityMode_Base()
+{
+  if (outboundSession != NULL)
+    srtp_dealloc(outboundSession);
+  if (inboundSession != NULL)
+    srtp_dealloc(inboundSession);
+
+  if (libraryInited)
+    ReleaseSRTPLibrary();
+}
+
 
 void LibSRTPSecurityMode_Base::Init()
 {
-  {
-    PWaitAndSignal m(initMutex);
-    if (!inited) {
-      srtp_init();
-      inited = PTrue;
-    }
-  }
   inboundPolicy.ssrc.type  = ssrc_any_inbound;
+  inboundPolicy.window_size = 128;
   inboundPolicy.next       = NULL;
   outboundPolicy.ssrc.type = ssrc_any_outbound;
+  outboundPolicy.window_size = 128;
   outboundPolicy.next      = NULL;
 
-  crypto_get_random(outgoingKey.key.GetPointer(SRTP_MASTER_KEY_LEN), SRTP_MASTER_KEY_LEN);
+  BYTE * key = outgoingKey.key.GetPointer(SRTP_MASTER_KEY_LEN);
+  for (PINDEX i = 0; i < SRTP_MASTER_KEY_LEN; ++i)
+    key[i] = (BYTE)PRandom::Number();
+}
+
+
+void LibSRTPSecurityMode_Base::UseSharedKey()
+{
+  // Both directions use the same key, exported from TLS when available
+  PINDEX i = 0;
+  while (i < (PINDEX)sizeof(ssl_session_key) && ssl_session_key[i] == 0)
+    ++i;
+
+  if (i < (PINDEX)sizeof(ssl_session_key))
+    outgoingKey = KeySalt(ssl_session_key, sizeof(ssl_session_key));
+  else
+    outgoingKey = KeySalt(DefaultSM4Key, sizeof(DefaultSM4Key));
+  incomingKey = outgoingKey;
 }
 
 
@@ -190,15 +271,34 @@ PBoolean LibSRTPSecurityMode_Base::GetIncomingSSRC(DWORD & ssrc) const
 
 PBoolean LibSRTPSecurityMode_Base::Open()
 {
+  if (!libraryInited)
+    return PFalse;
+
+  // RTP_UDP::Open() may be retried on another port, keep the contexts from the first attempt
+  if (outboundSession != NULL && inboundSession != NULL)
+    return PTrue;
+
+  if (outgoingKey.key.GetSize() < outboundPolicy.rtp.cipher_key_len ||
+      incomingKey.key.GetSize() < inboundPolicy.rtp.cipher_key_len) {
+    PTRACE(1, "SRTP\tMaster key too short for " << GetClass());
+    return PFalse;
+  }
+
   outboundPolicy.key = outgoingKey.key.GetPointer();
-  err_status_t err = srtp_create(&outboundSession, &outboundPolicy);
-  if (err != ::err_status_ok)
+  srtp_err_status_t err = srtp_create(&outboundSession, &outboundPolicy);
+  if (err != srtp_err_status_ok) {
+    PTRACE(1, "SRTP\tCould not create outbound context, error " << err);
+    outboundSession = NULL;
     return PFalse;
+  }
 
   inboundPolicy.key = incomingKey.key.GetPointer();
   err = srtp_create(&inboundSession, &inboundPolicy);
-  if (err != ::err_status_ok)
+  if (err != srtp_err_status_ok) {
+    PTRACE(1, "SRTP\tCould not create inbound context, error " << err);
+    inboundSession = NULL;
     return PFalse;
+  }
 
   return PTrue;
 }
@@ -219,17 +319,51 @@ class LibSRTPSecurityMode_##name : public LibSRTPSecurityMode_Base \
 }; \
 PFACTORY_CREATE(PFactory<OpalSecurityMode>, LibSRTPSecurityMode_##name, "SRTP|" #name, false)
 
-DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_HMAC_SHA1_80,  crypto_policy_set_aes_cm_128_hmac_sha1_80);
-DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_HMAC_SHA1_32,  crypto_policy_set_aes_cm_128_hmac_sha1_32);
-DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_NULL_AUTH,     crypto_policy_set_aes_cm_128_null_auth);
-DECLARE_LIBSRTP_CRYPTO_ALG(NULL_CIPHER_HMAC_SHA1_80, crypto_policy_set_null_cipher_hmac_sha1_80);
+DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_HMAC_SHA1_80,  srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80);
+DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_HMAC_SHA1_32,  srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32);
+DECLARE_LIBSRTP_CRYPTO_ALG(AES_CM_128_NULL_AUTH,     srtp_crypto_policy_set_aes_cm_128_null_auth);
+DECLARE_LIBSRTP_CRYPTO_ALG(NULL_CIPHER_HMAC_SHA1_80, srtp_crypto_policy_set_null_cipher_hmac_sha1_80);
+
+DECLARE_LIBSRTP_CRYPTO_ALG(STRONGHOLD,               srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80);
+
+
+/* The SM4 modes encrypt RTP payloads only, with no authentication tag, and
+   leave RTCP in the clear. The block modes pad the payload to 16 bytes with
+   zeros and a trailing pad length byte. Both directions share one key. */
+#define DECLARE_LIBSRTP_SM4_CRYPTO_ALG(name, policy_fn, padding) \
+class LibSRTPSecurityMode_##name : public LibSRTPSecurityMode_Base \
+{ \
+  public: \
+  LibSRTPSecurityMode_##name() \
+    { \
+      policy_fn(&inboundPolicy.rtp); \
+      policy_fn(&outboundPolicy.rtp); \
+      blockPadding = padding; \
+      protectControl = false; \
+      Init(); \
+      UseSharedKey(); \
+    } \
+}; \
+PFACTORY_CREATE(PFactory<OpalSecurityMode>, LibSRTPSecurityMode_##name, "SRTP|" #name, false)
 
-DECLARE_LIBSRTP_CRYPTO_ALG(STRONGHOLD,               crypto_policy_set_aes_cm_128_hmac_sha1_80);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SKF_HY_ECB, srtp_crypto_policy_set_sdt_skf_hy_sm4_ecb, 16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SKF_HY_CBC, srtp_crypto_policy_set_sdt_skf_hy_sm4_cbc, 16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SKF_ECB,    srtp_crypto_policy_set_sdt_skf_sm4_ecb,    16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SKF_CBC,    srtp_crypto_policy_set_sdt_skf_sm4_cbc,    16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SDF_ECB,    srtp_crypto_policy_set_sdt_sm4_ecb,        16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SDF_CBC,    srtp_crypto_policy_set_sdt_sm4_cbc,        16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SDF_OFB,    srtp_crypto_policy_set_sdt_sm4_ofb,        0);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SOFT_ECB,   srtp_crypto_policy_set_sdt_soft_sm4_ecb,   16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SOFT_CBC,   srtp_crypto_policy_set_sdt_soft_sm4_cbc,   16);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SOFT_OFB,   srtp_crypto_policy_set_sdt_soft_sm4_ofb,   0);
+DECLARE_LIBSRTP_SM4_CRYPTO_ALG(SM4_SOFT_CTR,   srtp_crypto_policy_set_sdt_soft_sm4_ctr,   0);
 
 ///////////////////////////////////////////////////////
 
 LibSRTP_UDP::LibSRTP_UDP(const Params & params)
   : OpalSRTP_UDP(params)
+  , m_blockPadding(0)
+  , m_protectControl(true)
 {
 }
 
@@ -250,6 +384,13 @@ PBoolean LibSRTP_UDP::Open(
   if (srtp == NULL)
     return PFalse;
 
+  // all key setup is done here, once, so the media path only has to protect/unprotect
+  if (!srtp->Open())
+    return PFalse;
+
+  m_blockPadding   = srtp->GetBlockPadding();
+  m_protectControl = srtp->GetProtectControl();
+
   // get the inbound and outbound SSRC from the SRTP parms and into the RTP session
   srtp->GetOutgoingSSRC(syncSourceOut);
   srtp->GetIncomingSSRC(syncSourceIn);
@@ -266,10 +407,22 @@ RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnSendData(RTP_DataFrame & frame)
 
   LibSRTPSecurityMode_Base * srtp = (LibSRTPSecurityMode_Base *)securityParms;
 
+  if (m_blockPadding != 0) {
+    PINDEX payloadSize = frame.GetPayloadSize();
+    PINDEX padLen = payloadSize % m_blockPadding;
+    if (padLen != 0) {
+      padLen = m_blockPadding - padLen;
+      frame.SetPayloadSize(payloadSize + padLen);
+      BYTE * pad = frame.GetPayloadPtr() + payloadSize;
+      memset(pad, 0, padLen - 1);
+      pad[padLen - 1] = (BYTE)padLen;
+    }
+  }
+
   int len = frame.GetHeaderSize() + frame.GetPayloadSize();
   frame.SetPayloadSize(len + SRTP_MAX_TRAILER_LEN);
-  err_status_t err = ::srtp_protect(srtp->outboundSession, frame.GetPointer(), &len);
-  if (err != err_status_ok)
+  srtp_err_status_t err = ::srtp_protect(srtp->outboundSession, frame.GetPointer(), &len);
+  if (err != srtp_err_status_ok)
     return RTP_Session::e_IgnorePacket;
   frame.SetPayloadSize(len - frame.GetHeaderSize());
   return e_ProcessPacket;
@@ -280,9 +433,24 @@ RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnReceiveData(RTP_DataFrame & frame)
   LibSRTPSecurityMode_Base * srtp = (LibSRTPSecurityMode_Base *)securityParms;
 
   int len = frame.GetHeaderSize() + frame.GetPayloadSize();
-  err_status_t err = ::srtp_unprotect(srtp->inboundSession, frame.GetPointer(), &len);
-  if (err != err_status_ok)
+  srtp_err_status_t err = ::srtp_unprotect(srtp->inboundSession, frame.GetPointer(), &len);
+  if (err != srtp_err_status_ok)
     return RTP_Session::e_IgnorePacket;
+
+  if (m_blockPadding != 0 && len > frame.GetHeaderSize()) {
+    // strip the zero fill and pad length byte added by the sender, if present
+    const BYTE * payload = frame.GetPointer() + frame.GetHeaderSize();
+    int payloadSize = len - frame.GetHeaderSize();
+    int padLen = payload[payloadSize - 1];
+    if (padLen > 0 && padLen <= (int)m_blockPadding && padLen <= payloadSize) {
+      int i = 1;
+      while (i < padLen && payload[payloadSize - 1 - i] == 0)
+        ++i;
+      if (i == padLen)
+        len -= padLen;
+    }
+  }
+
   frame.SetPayloadSize(len - frame.GetHeaderSize());
 
   return RTP_UDP::OnReceiveData(frame);
@@ -291,7 +459,7 @@ RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnReceiveData(RTP_DataFrame & frame)
 RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnSendControl(RTP_ControlFrame & frame, PINDEX & transmittedLen)
 {
   SendReceiveStatus stat = RTP_UDP::OnSendControl(frame, transmittedLen);
-  if (stat != e_ProcessPacket)
+  if (stat != e_ProcessPacket || !m_protectControl)
     return stat;
 
   frame.SetMinSize(transmittedLen + SRTP_MAX_TRAILER_LEN);
@@ -299,8 +467,8 @@ RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnSendControl(RTP_ControlFrame & frame,
 
   LibSRTPSecurityMode_Base * srtp = (LibSRTPSecurityMode_Base *)securityParms;
 
-  err_status_t err = ::srtp_protect_rtcp(srtp->outboundSession, frame.GetPointer(), &len);
-  if (err != err_status_ok)
+  srtp_err_status_t err = ::srtp_protect_rtcp(srtp->outboundSession, frame.GetPointer(), &len);
+  if (err != srtp_err_status_ok)
     return RTP_Session::e_IgnorePacket;
   transmittedLen = len;
 
@@ -309,11 +477,14 @@ RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnSendControl(RTP_ControlFrame & frame,
 
 RTP_UDP::SendReceiveStatus LibSRTP_UDP::OnReceiveControl(RTP_ControlFrame & frame)
 {
+  if (!m_protectControl)
+    return RTP_UDP::OnReceiveControl(frame);
+
   LibSRTPSecurityMode_Base * srtp = (LibSRTPSecurityMode_Base *)securityParms;
 
   int len = frame.GetSize();
-  err_status_t err = ::srtp_unprotect_rtcp(srtp->inboundSession, frame.GetPointer(), &len);
-  if (err != err_status_ok)
+  srtp_err_status_t err = ::srtp_unprotect_rtcp(srtp->inboundSession, frame.GetPointer(), &len);
+  if (err != srtp_err_status_ok)
     return RTP_Session::e_IgnorePacket;
   frame.SetSize(len);
 
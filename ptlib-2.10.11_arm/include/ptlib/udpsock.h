@@ -166,6 +166,118 @@ class PUDPSocket : public PIPDatagramSocket
     static void EnableGQoS();
   //@}
 
+  /**@name Batched datagram I/O */
+  //@{
+    /** A set of datagram buffers and addresses for ReadBatch() and
+        WriteBatch(). The message headers and I/O vectors are allocated once
+        when the batch is constructed, so a batch should be kept and reused
+        for each call rather than created per call.
+
+        The batch does not own the buffers, they must remain valid while the
+        batch is in use.
+     */
+    class Batch
+    {
+      public:
+        /// Create a batch for up to \p size datagrams.
+        Batch(
+          PINDEX size   ///< Maximum datagrams per call.
+        );
+        ~Batch();
+
+        /// Get the maximum number of datagrams per call.
+        PINDEX GetSize() const { return m_size; }
+
+        /// Get the number of datagrams transferred by the last call.
+        PINDEX GetCount() const { return m_count; }
+
+        /** Set the buffer for a datagram. For a read this is the space
+            available, for a write it is the datagram to send.
+         */
+        void SetBuffer(
+          PINDEX idx,       ///< Index of datagram in batch.
+          void * buf,       ///< Buffer for datagram.
+          PINDEX len        ///< Length of buffer.
+        );
+
+        /// Get the buffer for a datagram.
+        void * GetBuffer(PINDEX idx) const;
+
+        /** Get the length of a datagram transferred by the last call, or
+            as set by SetBuffer() if it was not transferred.
+         */
+        PINDEX GetLength(PINDEX idx) const;
+
+        /// Indicate datagram read by the last call was larger than its buffer.
+        bool IsTruncated(PINDEX idx) const;
+
+        /// Set the destination of a datagram to be written.
+        void SetAddress(
+          PINDEX idx,               ///< Index of datagram in batch.
+          const Address & address,  ///< IP address to send datagram.
+          WORD port                 ///< Port to send datagram.
+        );
+
+        /// Get the source of a datagram read by the last call.
+        void GetAddress(
+          PINDEX idx,               ///< Index of datagram in batch.
+          Address & address,        ///< IP address datagram came from.
+          WORD & port               ///< Port datagram came from.
+        ) const;
+
+      protected:
+        struct Entry;
+
+        PINDEX  m_size;
+        PINDEX  m_count;
+        Entry * m_entries;
+        void  * m_headers;
+
+      private:
+        Batch(const Batch &) { }
+        void operator=(const Batch &) { }
+
+      friend class PUDPSocket;
+    };
+
+    /** Read as many datagrams as are available, up to the size of the
+        batch, into its buffers. Where the platform supports it this is a
+        single system call (recvmmsg), otherwise datagrams are read one at a
+        time.
+
+        If \p wait is true this waits up to the read timeout for the first
+        datagram, otherwise it returns immediately if there is none.
+
+        @return
+        true if at least one datagram was read, GetCount() on the batch
+        indicates how many.
+     */
+    PBoolean ReadBatch(
+      Batch & batch,        ///< Buffers to read into.
+      bool wait = true      ///< Wait for first datagram.
+    );
+
+    /** Write the first \p count datagrams in the batch, each to its own
+        address. Where the platform supports it this is a single system call
+        (sendmmsg), otherwise datagrams are written one at a time. Broadcast
+        addresses are not supported, use WriteTo() for those.
+
+        @return
+        true if all datagrams were written, otherwise GetCount() on the
+        batch indicates how many were.
+     */
+    PBoolean WriteBatch(
+      Batch & batch,        ///< Datagrams to write.
+      PINDEX count          ///< Number of datagrams in batch to write.
+    );
+
+    /// Indicate ReadBatch() reads the whole batch in one system call.
+    static bool CanReadBatch();
+
+    /// Indicate WriteBatch() writes the whole batch in one system call.
+    static bool CanWriteBatch();
+  //@}
+
   protected:
     // Open an IPv4 socket (for backward compatibility)
     virtual PBoolean OpenSocket();
@@ -0,0 +1,168 @@
+/*
+ * udpbatch.cxx
+ *
+ * Sample program to benchmark PUDPSocket batched datagram I/O.
+ *
+ * Sends datagrams over the loopback interface and drains them again, first
+ * one datagram per call and then a batch per call, and reports the packet
+ * rate and the number of socket calls per packet for each.
+ *
+ * Portable Windows Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Windows Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/sockets.h>
+
+
+#define new PNEW
+
+class UDPBatch : public PProcess
+{
+  PCLASSINFO(UDPBatch, PProcess)
+  public:
+    UDPBatch();
+    void Main();
+
+  protected:
+    bool Run(PINDEX batchSize);
+
+    PINDEX m_packets;
+    PINDEX m_payloadSize;
+};
+
+PCREATE_PROCESS(UDPBatch);
+
+
+UDPBatch::UDPBatch()
+  : PProcess("PTLib Example", "udpbatch", 1, 0, ReleaseCode, 0)
+  , m_packets(1000000)
+  , m_payloadSize(172)
+{
+}
+
+
+void UDPBatch::Main()
+{
+  PArgList & args = GetArguments();
+
+  args.Parse("h-help."
+             "n-packets:"
+             "b-batch:"
+             "P-payload-size:"
+             , FALSE);
+
+  if (args.HasOption('h')) {
+    PError << "usage: " << GetFile().GetTitle() << " [ options ]\n"
+              "\n"
+              "Available options are:\n"
+              "  --help                   : print this help message.\n"
+              "  -n or --packets N        : datagrams to send in each run, default 1000000\n"
+              "  -b or --batch N          : datagrams per batch call, default 32\n"
+              "  -P or --payload-size N   : datagram size, default 172 (20ms G.711 RTP)\n"
+              "\n";
+    return;
+  }
+
+  if (args.HasOption('n'))
+    m_packets = args.GetOptionString('n').AsUnsigned();
+  if (args.HasOption('P'))
+    m_payloadSize = args.GetOptionString('P').AsUnsigned();
+
+  PINDEX batchSize = args.HasOption('b') ? args.GetOptionString('b').AsUnsigned() : 32;
+  if (batchSize < 1)
+    batchSize = 1;
+
+  cout << "recvmmsg " << (PUDPSocket::CanReadBatch() ? "available" : "not available, reading singly") << ", "
+          "sendmmsg " << (PUDPSocket::CanWriteBatch() ? "available" : "not available, writing singly") << endl;
+
+  if (Run(1) && batchSize > 1)
+    Run(batchSize);
+}
+
+
+bool UDPBatch::Run(PINDEX batchSize)
+{
+  PIPSocket::Address loopback(127, 0, 0, 1);
+
+  PUDPSocket receiver, sender;
+  if (!receiver.Listen(loopback) || !sender.Listen(loopback)) {
+    cerr << "Could not open loopback sockets" << endl;
+    return false;
+  }
+
+  // Give the receiver room for a whole batch
+  receiver.SetOption(SO_RCVBUF, 1024*1024);
+
+  WORD port = receiver.GetPort();
+
+  PBYTEArray sendData(m_payloadSize);
+  PUDPSocket::Batch sendBatch(batchSize);
+  for (PINDEX i = 0; i < batchSize; ++i) {
+    sendBatch.SetBuffer(i, sendData.GetPointer(), m_payloadSize);
+    sendBatch.SetAddress(i, loopback, port);
+  }
+
+  const PINDEX MaxDatagram = 2048;
+  PBYTEArray receiveData(batchSize*MaxDatagram);
+  PUDPSocket::Batch receiveBatch(batchSize);
+  for (PINDEX i = 0; i < batchSize; ++i)
+    receiveBatch.SetBuffer(i, receiveData.GetPointer()+i*MaxDatagram, MaxDatagram);
+
+  PINDEX sent = 0;
+  PINDEX received = 0;
+  PINDEX writeCalls = 0;
+  PINDEX readCalls = 0;
+
+  PTimeInterval start = PTimer::Tick();
+
+  while (sent < m_packets) {
+    PINDEX count = PMIN(batchSize, m_packets - sent);
+    ++writeCalls;
+    bool ok = sender.WriteBatch(sendBatch, count);
+    sent += sendBatch.GetCount();
+    if (!ok) {
+      cerr << "Write failed: " << sender.GetErrorText(PChannel::LastWriteError) << endl;
+      return false;
+    }
+
+    // Loopback delivers at once, so drain until there is nothing left
+    do {
+      ++readCalls;
+      if (!receiver.ReadBatch(receiveBatch, false))
+        break;
+      received += receiveBatch.GetCount();
+    } while (receiveBatch.GetCount() == batchSize);
+  }
+
+  PTimeInterval elapsed = PTimer::Tick() - start;
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  if (seconds <= 0)
+    seconds = 0.001;
+
+  cout << setw(4) << batchSize << " per call: "
+       << sent << " sent, " << received << " received in " << elapsed << "s, "
+       << (PINDEX)(received/seconds) << " packets/s, "
+       << setprecision(3)
+       << (double)writeCalls/sent << " write and "
+       << (double)readCalls/(received > 0 ? received : 1) << " read calls/packet" << endl;
+
+  return true;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -100,6 +100,35 @@ static PIPSocket::Address any6(16,(const BYTE *)"\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\
 #define IPV6_PARAM(p)
 #endif
 
+/* recvmmsg() and sendmmsg() are called through syscall() as the C library
+   may be older than the kernel headers. If the running kernel is older still
+   the call fails with ENOSYS and the batch functions fall back to one
+   datagram at a time. */
+#if P_HAS_RECVMSG && defined(P_LINUX)
+#include <sys/syscall.h>
+#ifdef __NR_recvmmsg
+#define P_HAS_RECVMMSG 1
+#endif
+#ifdef __NR_sendmmsg
+#define P_HAS_SENDMMSG 1
+#endif
+#endif
+
+#if P_HAS_RECVMMSG || P_HAS_SENDMMSG
+// Same layout as the kernel struct mmsghdr
+struct PMultiMsgHeader {
+  msghdr   msg_hdr;
+  unsigned msg_len;
+};
+#endif
+
+#if P_HAS_RECVMMSG
+static bool g_recvMultiMsg = true;
+#endif
+#if P_HAS_SENDMMSG
+static bool g_sendMultiMsg = true;
+#endif
+
 
 void PIPSocket::SetSuppressCanonicalName(bool suppress)
 {
@@ -2930,6 +2959,294 @@ PBoolean PUDPSocket::DoPseudoRead(int & /*selectStatus*/)
    return false;
 }
 
+
+//////////////////////////////////////////////////////////////////////////////
+// PUDPSocket::Batch
+
+struct PUDPSocket::Batch::Entry {
+  PChannel::Slice  m_vector;
+  sockaddr_storage m_address;
+  PINDEX           m_addressLength;
+  PINDEX           m_length;
+  bool             m_truncated;
+};
+
+
+PUDPSocket::Batch::Batch(PINDEX size)
+  : m_size(size > 0 ? size : 1)
+  , m_count(0)
+  , m_entries(new Entry[m_size])
+  , m_headers(NULL)
+{
+  memset(m_entries, 0, m_size*sizeof(Entry));
+
+#if P_HAS_RECVMMSG || P_HAS_SENDMMSG
+  PMultiMsgHeader * headers = new PMultiMsgHeader[m_size];
+  memset(headers, 0, m_size*sizeof(PMultiMsgHeader));
+  for (PINDEX i = 0; i < m_size; ++i) {
+    headers[i].msg_hdr.msg_name = &m_entries[i].m_address;
+    headers[i].msg_hdr.msg_iov = &m_entries[i].m_vector;
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+  m_headers = headers;
+#endif
+}
+
+
+PUDPSocket::Batch::~Batch()
+{
+#if P_HAS_RECVMMSG || P_HAS_SENDMMSG
+  delete [] (PMultiMsgHeader *)m_headers;
+#endif
+  delete [] m_entries;
+}
+
+
+void PUDPSocket::Batch::SetBuffer(PINDEX idx, void * buf, PINDEX len)
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  m_entries[idx].m_vector.iov_base = (char *)buf;
+  m_entries[idx].m_vector.iov_len = len;
+  m_entries[idx].m_length = len;
+}
+
+
+void * PUDPSocket::Batch::GetBuffer(PINDEX idx) const
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  return m_entries[idx].m_vector.iov_base;
+}
+
+
+PINDEX PUDPSocket::Batch::GetLength(PINDEX idx) const
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  return m_entries[idx].m_length;
+}
+
+
+bool PUDPSocket::Batch::IsTruncated(PINDEX idx) const
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  return m_entries[idx].m_truncated;
+}
+
+
+void PUDPSocket::Batch::SetAddress(PINDEX idx, const Address & address, WORD port)
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  Entry & entry = m_entries[idx];
+
+#if P_HAS_IPV6
+  if (address.GetVersion() == 6) {
+    sockaddr_in6 & sin6 = (sockaddr_in6 &)entry.m_address;
+    memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = address;
+    sin6.sin6_port = htons(port);
+    sin6.sin6_scope_id = defaultIPv6ScopeId;
+    entry.m_addressLength = sizeof(sin6);
+    return;
+  }
+#endif
+
+  sockaddr_in & sin = (sockaddr_in &)entry.m_address;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr = address;
+  sin.sin_port = htons(port);
+  entry.m_addressLength = sizeof(sin);
+}
+
+
+void PUDPSocket::Batch::GetAddress(PINDEX idx, Address & address, WORD & port) const
+{
+  PAssert(idx < m_size, PInvalidParameter);
+  const Entry & entry = m_entries[idx];
+
+#if P_HAS_IPV6
+  if (entry.m_address.ss_family == AF_INET6) {
+    const sockaddr_in6 & sin6 = (const sockaddr_in6 &)entry.m_address;
+    address = sin6.sin6_addr;
+    port = ntohs(sin6.sin6_port);
+    return;
+  }
+#endif
+
+  const sockaddr_in & sin = (const sockaddr_in &)entry.m_address;
+  address = sin.sin_addr;
+  port = ntohs(sin.sin_port);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+PBoolean PUDPSocket::ReadBatch(Batch & batch, bool wait)
+{
+  batch.m_count = 0;
+  lastReadCount = 0;
+
+  if (!IsOpen())
+    return SetErrorValues(NotOpen, EBADF, LastReadError);
+
+#if P_HAS_RECVMMSG
+  if (g_recvMultiMsg) {
+    if (wait && !PXSetIOBlock(PXReadBlock, readTimeout))
+      return PFalse;
+
+    PMultiMsgHeader * headers = (PMultiMsgHeader *)batch.m_headers;
+    for (PINDEX i = 0; i < batch.m_size; ++i) {
+      headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+      headers[i].msg_hdr.msg_flags = 0;
+    }
+
+    int count = syscall(__NR_recvmmsg, os_handle, headers, batch.m_size, MSG_DONTWAIT, NULL);
+    if (count >= 0 || errno != ENOSYS) {
+      if (!ConvertOSError(count, LastReadError))
+        return PFalse;
+
+      for (int i = 0; i < count; ++i) {
+        Batch::Entry & entry = batch.m_entries[i];
+        entry.m_addressLength = headers[i].msg_hdr.msg_namelen;
+        entry.m_length = headers[i].msg_len;
+        entry.m_truncated = (headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        lastReadCount += entry.m_length;
+      }
+
+      batch.m_count = count;
+      return count > 0;
+    }
+
+    PTRACE(3, "PTLib\trecvmmsg not supported by kernel, reading datagrams singly");
+    g_recvMultiMsg = false;
+  }
+#endif
+
+  // Only the first read waits, the rest take what is already queued
+  PTimeInterval oldTimeout = readTimeout;
+  if (!wait)
+    readTimeout = 0;
+
+  PINDEX total = 0;
+  while (batch.m_count < batch.m_size) {
+    Batch::Entry & entry = batch.m_entries[batch.m_count];
+    entry.m_addressLength = sizeof(sockaddr_storage);
+    if (!os_recvfrom(entry.m_vector.iov_base, entry.m_vector.iov_len, 0,
+                     (sockaddr *)&entry.m_address, &entry.m_addressLength))
+      break;
+
+    entry.m_length = lastReadCount;
+    entry.m_truncated = false;
+    total += lastReadCount;
+    ++batch.m_count;
+    readTimeout = 0;
+  }
+
+  readTimeout = oldTimeout;
+  lastReadCount = total;
+
+  if (batch.m_count == 0) {
+    // Report nothing queued the same way as the single system call does
+    if (!wait && GetErrorCode(LastReadError) == Timeout)
+      SetErrorValues(Timeout, EAGAIN, LastReadError);
+    return PFalse;
+  }
+
+  // Running out of queued datagrams is not an error
+  SetErrorValues(NoError, 0, LastReadError);
+  return PTrue;
+}
+
+
+PBoolean PUDPSocket::WriteBatch(Batch & batch, PINDEX count)
+{
+  batch.m_count = 0;
+  lastWriteCount = 0;
+
+  if (!IsOpen())
+    return SetErrorValues(NotOpen, EBADF, LastWriteError);
+
+  if (count > batch.m_size)
+    count = batch.m_size;
+
+#if P_HAS_SENDMMSG
+  if (g_sendMultiMsg) {
+    PMultiMsgHeader * headers = (PMultiMsgHeader *)batch.m_headers;
+    for (PINDEX i = 0; i < count; ++i)
+      headers[i].msg_hdr.msg_namelen = batch.m_entries[i].m_addressLength;
+
+    PINDEX total = 0;
+    while (batch.m_count < count) {
+      int sent = syscall(__NR_sendmmsg, os_handle, headers+batch.m_count, count-batch.m_count, 0);
+      if (sent > 0) {
+        for (int i = 0; i < sent; ++i, ++batch.m_count) {
+          Batch::Entry & entry = batch.m_entries[batch.m_count];
+          entry.m_length = headers[batch.m_count].msg_len;
+          total += entry.m_length;
+        }
+        continue;
+      }
+
+      if (sent < 0 && errno == ENOSYS && batch.m_count == 0) {
+        PTRACE(3, "PTLib\tsendmmsg not supported by kernel, writing datagrams singly");
+        g_sendMultiMsg = false;
+        break;
+      }
+
+      if (sent < 0 && errno == EWOULDBLOCK) {
+        if (PXSetIOBlock(PXWriteBlock, writeTimeout))
+          continue;
+      }
+      else
+        ConvertOSError(-1, LastWriteError);
+
+      lastWriteCount = total;
+      return PFalse;
+    }
+
+    if (g_sendMultiMsg) {
+      lastWriteCount = total;
+      return ConvertOSError(0, LastWriteError);
+    }
+  }
+#endif
+
+  PINDEX total = 0;
+  while (batch.m_count < count) {
+    Batch::Entry & entry = batch.m_entries[batch.m_count];
+    if (!os_sendto(entry.m_vector.iov_base, entry.m_vector.iov_len, 0,
+                   (sockaddr *)&entry.m_address, entry.m_addressLength))
+      break;
+
+    entry.m_length = lastWriteCount;
+    total += lastWriteCount;
+    ++batch.m_count;
+  }
+
+  lastWriteCount = total;
+  return batch.m_count == count;
+}
+
+
+bool PUDPSocket::CanReadBatch()
+{
+#if P_HAS_RECVMMSG
+  return g_recvMultiMsg;
+#else
+  return false;
+#endif
+}
+
+
+bool PUDPSocket::CanWriteBatch()
+{
+#if P_HAS_SENDMMSG
+  return g_sendMultiMsg;
+#else
+  return false;
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 PBoolean PICMPSocket::OpenSocket(int)